@@ -26,7 +26,14 @@ HRESULT FDirectShowCallbackHandler::SampleCB(double Time, IMediaSample* Sample)
 		return S_OK;
 	}
 
-	OnSampleCB.ExecuteIfBound(Time, Sample);
+	if (SampleHandler != nullptr)
+	{
+		SampleHandler(SampleHandlerContext, Time, Sample);
+	}
+	else
+	{
+		OnSampleCB.ExecuteIfBound(Time, Sample);
+	}
 
 	return S_OK;
 }
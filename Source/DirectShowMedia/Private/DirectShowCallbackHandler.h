@@ -14,6 +14,7 @@ DECLARE_DELEGATE_ThreeParams(FOnBufferCB, double Time, char* Buffer, long Length
 
 class FDirectShowVideoDevice;
 typedef void(*FVideoCaptureCallback)(unsigned char* Data, int Length, int BitsPerPixel, FDirectShowVideoDevice* Device);
+typedef void(*FSampleHandler)(void* Context, double Time, IMediaSample* Sample);
 
 
 class FDirectShowCallbackHandler : public ISampleGrabberCB
@@ -28,7 +29,18 @@ public:
 	virtual ULONG __stdcall AddRef();
 	virtual ULONG __stdcall Release();
 	
+	/** Call a plain function for each sample instead of OnSampleCB, which keeps the per frame path to one indirect call. */
+	void SetSampleHandler(FSampleHandler InHandler, void* InContext)
+	{
+		SampleHandlerContext = InContext;
+		SampleHandler = InHandler;
+	}
+
 	FOnSampleCB OnSampleCB;
 	FOnBufferCB OnBufferCB;
 	bool bflipVertically = false;
+
+private:
+	FSampleHandler SampleHandler = nullptr;
+	void* SampleHandlerContext = nullptr;
 };
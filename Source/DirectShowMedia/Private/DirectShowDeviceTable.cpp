@@ -0,0 +1,725 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "DirectShowDeviceTable.h"
+
+#include "DirectShowMedia.h"
+#include "IMediaCaptureSupport.h"
+#include "Misc/Crc.h"
+#include "Misc/ScopeLock.h"
+
+
+/* FDirectShowDeviceTable static functions
+ *****************************************************************************/
+
+FDirectShowDeviceTable& FDirectShowDeviceTable::Get()
+{
+	static FDirectShowDeviceTable Table;
+	return Table;
+}
+
+
+bool FDirectShowDeviceTable::GetDeviceClass(const IID& Category, EDirectShowDeviceClass& OutDeviceClass)
+{
+	if (Category == CLSID_VideoInputDeviceCategory)
+	{
+		OutDeviceClass = EDirectShowDeviceClass::Video;
+		return true;
+	}
+
+	if (Category == CLSID_AudioInputDeviceCategory)
+	{
+		OutDeviceClass = EDirectShowDeviceClass::Audio;
+		return true;
+	}
+
+	return false;
+}
+
+
+/* FDirectShowDeviceTable interface
+ *****************************************************************************/
+
+void FDirectShowDeviceTable::Refresh(EDirectShowDeviceClass DeviceClass)
+{
+	FScopeLock Lock(&CriticalSection);
+
+	FClassTable& Table = Tables[(int32)DeviceClass];
+	Table.bEnumerated = true;
+
+	// devices keep their index across enumerations, the ones that are still there get marked again
+	for (FDevice& Device : Table.Devices)
+	{
+		Device.bPresent = false;
+		Device.Moniker.Reset();
+	}
+
+	// pairings depend on both classes
+	Tables[(int32)EDirectShowDeviceClass::Video].AudioPairs.Reset();
+
+	if (Enumerator)
+	{
+		Enumerator(DeviceClass);
+	}
+	else
+	{
+		EnumerateSystemDevices(DeviceClass);
+	}
+}
+
+
+void FDirectShowDeviceTable::SetEnumerator(TFunction<void(EDirectShowDeviceClass)> InEnumerator)
+{
+	FScopeLock Lock(&CriticalSection);
+	Enumerator = MoveTemp(InEnumerator);
+}
+
+
+void FDirectShowDeviceTable::Reset(EDirectShowDeviceClass DeviceClass)
+{
+	FScopeLock Lock(&CriticalSection);
+
+	FClassTable& Table = Tables[(int32)DeviceClass];
+
+	Table.Strings.Reset();
+	Table.StringIndex.Reset();
+	Table.Devices.Reset();
+	Table.UrlIndex.Reset();
+	Table.NameIndex.Reset();
+	Table.AudioPairs.Reset();
+	Table.bEnumerated = false;
+
+	Tables[(int32)EDirectShowDeviceClass::Video].AudioPairs.Reset();
+}
+
+
+void FDirectShowDeviceTable::AddDevice(EDirectShowDeviceClass DeviceClass, const TCHAR* FriendlyName, const TCHAR* Description, const TCHAR* DevicePath, IMoniker* Moniker, bool bHasCapturePin)
+{
+	FScopeLock Lock(&CriticalSection);
+
+	FClassTable& Table = Tables[(int32)DeviceClass];
+
+	const int32 DescriptionOffset = Intern(Table, Description);
+	int32 NameOffset = Intern(Table, FriendlyName);
+
+	// devices without a friendly name are listed by their description
+	if (NameOffset == INDEX_NONE)
+	{
+		NameOffset = DescriptionOffset;
+	}
+
+	if (NameOffset == INDEX_NONE)
+	{
+		return;
+	}
+
+	// virtual devices have no path, they are addressed by name instead
+	int32 UrlOffset = Intern(Table, DevicePath);
+
+	if (UrlOffset == INDEX_NONE)
+	{
+		UrlOffset = NameOffset;
+	}
+
+	// a device that was seen before keeps its identity
+	const TCHAR* UrlString = GetString(Table, UrlOffset);
+	int32 DeviceIndex = FindKnownByUrl(Table, UrlString);
+
+	if (DeviceIndex == INDEX_NONE)
+	{
+		DeviceIndex = Table.Devices.AddDefaulted();
+		Table.UrlIndex.Add(FCrc::StrCrc32(UrlString), DeviceIndex);
+	}
+
+	FDevice& Device = Table.Devices[DeviceIndex];
+
+	if (Device.Name != NameOffset)
+	{
+		Table.NameIndex.AddUnique(HashName(GetString(Table, NameOffset)), DeviceIndex);
+	}
+
+	if ((DescriptionOffset != INDEX_NONE) && (Device.Description != DescriptionOffset))
+	{
+		Table.NameIndex.AddUnique(HashName(GetString(Table, DescriptionOffset)), DeviceIndex);
+	}
+
+	Device.Name = NameOffset;
+	Device.Description = DescriptionOffset;
+	Device.Url = UrlOffset;
+	Device.Moniker = Moniker;
+	Device.bPresent = true;
+	Device.bHasCapturePin = bHasCapturePin;
+}
+
+
+void FDirectShowDeviceTable::GetDeviceInfos(EDirectShowDeviceClass DeviceClass, TArray<FMediaCaptureDeviceInfo>& OutDeviceInfos)
+{
+	FScopeLock Lock(&CriticalSection);
+
+	FClassTable& Table = Tables[(int32)DeviceClass];
+
+	if (!Table.bEnumerated)
+	{
+		Refresh(DeviceClass);
+	}
+
+	OutDeviceInfos.Reserve(OutDeviceInfos.Num() + Table.Devices.Num());
+
+	for (const FDevice& Device : Table.Devices)
+	{
+		if (!Device.bPresent || !Device.bHasCapturePin)
+		{
+			continue;
+		}
+
+		FMediaCaptureDeviceInfo& Info = OutDeviceInfos.AddDefaulted_GetRef();
+		Info.Type = (DeviceClass == EDirectShowDeviceClass::Video) ? EMediaCaptureDeviceType::Video : EMediaCaptureDeviceType::Audio;
+		Info.DisplayName = FText::FromString(GetString(Table, Device.Name));
+		Info.Url = GetString(Table, Device.Url);
+	}
+}
+
+
+bool FDirectShowDeviceTable::Resolve(EDirectShowDeviceClass DeviceClass, const FString& UrlOrName, FDirectShowDeviceId& OutDeviceId)
+{
+	FScopeLock Lock(&CriticalSection);
+
+	const int32 DeviceIndex = FindWithRefresh(DeviceClass, [&UrlOrName](const FClassTable& Table) { return FindByUrlOrName(Table, UrlOrName); });
+
+	if (DeviceIndex == INDEX_NONE)
+	{
+		return false;
+	}
+
+	OutDeviceId.DeviceClass = DeviceClass;
+	OutDeviceId.Index = DeviceIndex;
+
+	return true;
+}
+
+
+bool FDirectShowDeviceTable::FindAudioDevice(const FDirectShowDeviceId& VideoDeviceId, FDirectShowDeviceId& OutAudioDeviceId)
+{
+	FScopeLock Lock(&CriticalSection);
+
+	if ((VideoDeviceId.DeviceClass != EDirectShowDeviceClass::Video) || (GetDevice(VideoDeviceId) == nullptr))
+	{
+		return false;
+	}
+
+	FClassTable& VideoTable = Tables[(int32)EDirectShowDeviceClass::Video];
+	const FClassTable& AudioTable = Tables[(int32)EDirectShowDeviceClass::Audio];
+
+	if (!AudioTable.bEnumerated)
+	{
+		Refresh(EDirectShowDeviceClass::Audio);
+	}
+
+	int32 AudioIndex = INDEX_NONE;
+
+	if (const int32* CachedIndex = VideoTable.AudioPairs.Find(VideoDeviceId.Index))
+	{
+		AudioIndex = *CachedIndex;
+	}
+	else
+	{
+		const FDevice& VideoDevice = VideoTable.Devices[VideoDeviceId.Index];
+		int32 BestScore = 0;
+
+		for (int32 Index = 0; Index < AudioTable.Devices.Num(); ++Index)
+		{
+			const FDevice& AudioDevice = AudioTable.Devices[Index];
+
+			if (!AudioDevice.bPresent)
+			{
+				continue;
+			}
+
+			const int32 Score = ScoreAudioPair(VideoTable, VideoDevice, AudioTable, AudioDevice);
+
+			if (Score > BestScore)
+			{
+				BestScore = Score;
+				AudioIndex = Index;
+			}
+		}
+
+		VideoTable.AudioPairs.Add(VideoDeviceId.Index, AudioIndex);
+	}
+
+	if (AudioIndex == INDEX_NONE)
+	{
+		return false;
+	}
+
+	OutAudioDeviceId.DeviceClass = EDirectShowDeviceClass::Audio;
+	OutAudioDeviceId.Index = AudioIndex;
+
+	return true;
+}
+
+
+bool FDirectShowDeviceTable::GetFriendlyName(const FDirectShowDeviceId& DeviceId, FString& OutFriendlyName)
+{
+	FScopeLock Lock(&CriticalSection);
+
+	const FDevice* Device = GetDevice(DeviceId);
+
+	if (Device == nullptr)
+	{
+		return false;
+	}
+
+	OutFriendlyName = GetString(Tables[(int32)DeviceId.DeviceClass], Device->Name);
+
+	return true;
+}
+
+
+bool FDirectShowDeviceTable::BindFilter(const FDirectShowDeviceId& DeviceId, IBaseFilter** OutFilter)
+{
+	FScopeLock Lock(&CriticalSection);
+
+	const FDevice* Device = GetDevice(DeviceId);
+
+	// the device may have come back since the last enumeration
+	if ((Device != nullptr) && !Device->bPresent)
+	{
+		Refresh(DeviceId.DeviceClass);
+		Device = GetDevice(DeviceId);
+	}
+
+	return (Device != nullptr) && Device->bPresent && BindDevice(*Device, OutFilter);
+}
+
+
+bool FDirectShowDeviceTable::GetFriendlyName(EDirectShowDeviceClass DeviceClass, const FString& Url, FString& OutFriendlyName)
+{
+	FScopeLock Lock(&CriticalSection);
+
+	const int32 DeviceIndex = FindWithRefresh(DeviceClass, [&Url](const FClassTable& Table) { return FindByUrl(Table, Url); });
+
+	if (DeviceIndex == INDEX_NONE)
+	{
+		return false;
+	}
+
+	const FClassTable& Table = Tables[(int32)DeviceClass];
+	OutFriendlyName = GetString(Table, Table.Devices[DeviceIndex].Name);
+
+	return true;
+}
+
+
+bool FDirectShowDeviceTable::BindFilterByUrl(EDirectShowDeviceClass DeviceClass, const FString& Url, IBaseFilter** OutFilter)
+{
+	FScopeLock Lock(&CriticalSection);
+
+	const int32 DeviceIndex = FindWithRefresh(DeviceClass, [&Url](const FClassTable& Table) { return FindByUrl(Table, Url); });
+
+	return (DeviceIndex != INDEX_NONE) && BindDevice(Tables[(int32)DeviceClass].Devices[DeviceIndex], OutFilter);
+}
+
+
+bool FDirectShowDeviceTable::BindFilterByName(EDirectShowDeviceClass DeviceClass, const FString& Name, IBaseFilter** OutFilter)
+{
+	FScopeLock Lock(&CriticalSection);
+
+	const int32 DeviceIndex = FindWithRefresh(DeviceClass, [&Name](const FClassTable& Table) { return FindByName(Table, Name); });
+
+	return (DeviceIndex != INDEX_NONE) && BindDevice(Tables[(int32)DeviceClass].Devices[DeviceIndex], OutFilter);
+}
+
+
+/* FDirectShowDeviceTable implementation
+ *****************************************************************************/
+
+int32 FDirectShowDeviceTable::Intern(FClassTable& Table, const TCHAR* String)
+{
+	if ((String == nullptr) || (String[0] == TEXT('\0')))
+	{
+		return INDEX_NONE;
+	}
+
+	const uint32 Hash = FCrc::StrCrc32(String);
+
+	for (auto It = Table.StringIndex.CreateConstKeyIterator(Hash); It; ++It)
+	{
+		if (FCString::Strcmp(GetString(Table, It.Value()), String) == 0)
+		{
+			return It.Value();
+		}
+	}
+
+	const int32 Offset = Table.Strings.Num();
+	Table.Strings.Append(String, FCString::Strlen(String) + 1);
+	Table.StringIndex.Add(Hash, Offset);
+
+	return Offset;
+}
+
+
+const TCHAR* FDirectShowDeviceTable::GetString(const FClassTable& Table, int32 Offset)
+{
+	return (Offset != INDEX_NONE) ? Table.Strings.GetData() + Offset : TEXT("");
+}
+
+
+uint32 FDirectShowDeviceTable::HashName(const TCHAR* Name)
+{
+	// FNV-1a over the lower case characters
+	uint32 Hash = 2166136261u;
+
+	for (; *Name != TEXT('\0'); ++Name)
+	{
+		Hash = (Hash ^ (uint32)FChar::ToLower(*Name)) * 16777619u;
+	}
+
+	return Hash;
+}
+
+
+int32 FDirectShowDeviceTable::FindByUrl(const FClassTable& Table, const FString& Url)
+{
+	if (Url.IsEmpty())
+	{
+		return INDEX_NONE;
+	}
+
+	for (auto It = Table.UrlIndex.CreateConstKeyIterator(FCrc::StrCrc32(*Url)); It; ++It)
+	{
+		const FDevice& Device = Table.Devices[It.Value()];
+
+		if (Device.bPresent && Url.Equals(GetString(Table, Device.Url)))
+		{
+			return It.Value();
+		}
+	}
+
+	return INDEX_NONE;
+}
+
+
+int32 FDirectShowDeviceTable::FindKnownByUrl(const FClassTable& Table, const TCHAR* Url)
+{
+	for (auto It = Table.UrlIndex.CreateConstKeyIterator(FCrc::StrCrc32(Url)); It; ++It)
+	{
+		if (FCString::Strcmp(GetString(Table, Table.Devices[It.Value()].Url), Url) == 0)
+		{
+			return It.Value();
+		}
+	}
+
+	return INDEX_NONE;
+}
+
+
+int32 FDirectShowDeviceTable::FindByName(const FClassTable& Table, const FString& Name)
+{
+	if (Name.IsEmpty())
+	{
+		return INDEX_NONE;
+	}
+
+	// exact names first
+	int32 DescriptionMatch = INDEX_NONE;
+
+	for (auto It = Table.NameIndex.CreateConstKeyIterator(HashName(*Name)); It; ++It)
+	{
+		const FDevice& Device = Table.Devices[It.Value()];
+
+		if (!Device.bPresent)
+		{
+			continue;
+		}
+
+		if (FCString::Stricmp(GetString(Table, Device.Name), *Name) == 0)
+		{
+			return It.Value();
+		}
+
+		if ((DescriptionMatch == INDEX_NONE) && (FCString::Stricmp(GetString(Table, Device.Description), *Name) == 0))
+		{
+			DescriptionMatch = It.Value();
+		}
+	}
+
+	if (DescriptionMatch != INDEX_NONE)
+	{
+		return DescriptionMatch;
+	}
+
+	// then partial ones
+	for (int32 DeviceIndex = 0; DeviceIndex < Table.Devices.Num(); ++DeviceIndex)
+	{
+		const FDevice& Device = Table.Devices[DeviceIndex];
+
+		if (Device.bPresent && ((FCString::Stristr(GetString(Table, Device.Name), *Name) != nullptr) || (FCString::Stristr(GetString(Table, Device.Description), *Name) != nullptr)))
+		{
+			return DeviceIndex;
+		}
+	}
+
+	return INDEX_NONE;
+}
+
+
+int32 FDirectShowDeviceTable::FindByUrlOrName(const FClassTable& Table, const FString& UrlOrName)
+{
+	const int32 DeviceIndex = FindByUrl(Table, UrlOrName);
+
+	return (DeviceIndex != INDEX_NONE) ? DeviceIndex : FindByName(Table, UrlOrName);
+}
+
+
+namespace DirectShowDeviceTable
+{
+	/** Split a device name into its lower case words, leaving out the ones that say nothing about the device. */
+	void GetNameTokens(const TCHAR* Name, TArray<FString>& OutTokens)
+	{
+		static const TCHAR* GenericTokens[] = { TEXT("audio"), TEXT("video"), TEXT("capture"), TEXT("device"), TEXT("input"), TEXT("interface"), TEXT("digital"), TEXT("microphone"), TEXT("mic"), TEXT("line"), TEXT("in"), TEXT("usb"), TEXT("the") };
+
+		FString Token;
+
+		for (const TCHAR* Char = Name; ; ++Char)
+		{
+			if (FChar::IsAlnum(*Char))
+			{
+				Token.AppendChar(FChar::ToLower(*Char));
+				continue;
+			}
+
+			if (!Token.IsEmpty())
+			{
+				bool bGeneric = false;
+
+				for (const TCHAR* GenericToken : GenericTokens)
+				{
+					if (Token.Equals(GenericToken))
+					{
+						bGeneric = true;
+						break;
+					}
+				}
+
+				if (!bGeneric)
+				{
+					OutTokens.AddUnique(Token);
+				}
+
+				Token.Reset();
+			}
+
+			if (*Char == TEXT('\0'))
+			{
+				break;
+			}
+		}
+	}
+
+	/** Get the USB vendor and product id from a device path (i.e. "vid_0fd9&pid_0066"), or an empty string. */
+	FString GetUsbId(const TCHAR* DevicePath)
+	{
+		const TCHAR* Vid = FCString::Stristr(DevicePath, TEXT("vid_"));
+
+		if ((Vid == nullptr) || (FCString::Strlen(Vid) < 17) || (FCString::Strnicmp(Vid + 8, TEXT("&pid_"), 5) != 0))
+		{
+			return FString();
+		}
+
+		return FString(17, Vid).ToLower();
+	}
+}
+
+
+int32 FDirectShowDeviceTable::ScoreAudioPair(const FClassTable& VideoTable, const FDevice& VideoDevice, const FClassTable& AudioTable, const FDevice& AudioDevice)
+{
+	const TCHAR* VideoName = GetString(VideoTable, VideoDevice.Name);
+	const TCHAR* AudioName = GetString(AudioTable, AudioDevice.Name);
+	const TCHAR* AudioDescription = GetString(AudioTable, AudioDevice.Description);
+
+	// the same USB function
+	const FString VideoUsbId = DirectShowDeviceTable::GetUsbId(GetString(VideoTable, VideoDevice.Url));
+
+	if (!VideoUsbId.IsEmpty() && VideoUsbId.Equals(DirectShowDeviceTable::GetUsbId(GetString(AudioTable, AudioDevice.Url))))
+	{
+		return 100;
+	}
+
+	if (FCString::Stricmp(AudioName, VideoName) == 0)
+	{
+		return 90;
+	}
+
+	// i.e. "Cam Link 4K" and "Digital Audio Interface (Cam Link 4K)"
+	if ((FCString::Stristr(AudioName, VideoName) != nullptr) || (FCString::Stristr(AudioDescription, VideoName) != nullptr))
+	{
+		return 80;
+	}
+
+	// otherwise most of the meaningful words have to match
+	TArray<FString> VideoTokens;
+	TArray<FString> AudioTokens;
+	DirectShowDeviceTable::GetNameTokens(VideoName, VideoTokens);
+	DirectShowDeviceTable::GetNameTokens(AudioName, AudioTokens);
+
+	int32 NumShared = 0;
+
+	for (const FString& Token : AudioTokens)
+	{
+		if (VideoTokens.Contains(Token))
+		{
+			++NumShared;
+		}
+	}
+
+	const int32 NumTotal = VideoTokens.Num() + AudioTokens.Num() - NumShared;
+
+	if ((NumShared == 0) || (2 * NumShared < NumTotal))
+	{
+		return 0;
+	}
+
+	return 10 + (50 * NumShared) / NumTotal;
+}
+
+
+void FDirectShowDeviceTable::EnumerateSystemDevices(EDirectShowDeviceClass DeviceClass)
+{
+	const IID& Category = (DeviceClass == EDirectShowDeviceClass::Video) ? CLSID_VideoInputDeviceCategory : CLSID_AudioInputDeviceCategory;
+
+	TComPtr<ICreateDevEnum> DevEnum;
+	HRESULT HResult = CoCreateInstance(CLSID_SystemDeviceEnum, NULL, CLSCTX_INPROC_SERVER, IID_ICreateDevEnum, (void**)&DevEnum);
+	if (FAILED(HResult) || !DevEnum.IsValid())
+	{
+		UE_LOG(LogDirectShowMedia, Warning, TEXT("Failed to CoCreateInstance(CLSID_SystemDeviceEnum) in FDirectShowDeviceTable::EnumerateSystemDevices(): %d"), HResult);
+		return;
+	}
+
+	TComPtr<IEnumMoniker> EnumMoniker;
+	HResult = DevEnum->CreateClassEnumerator(Category, &EnumMoniker, 0);
+	if (FAILED(HResult))
+	{
+		UE_LOG(LogDirectShowMedia, Warning, TEXT("Failed to CreateClassEnumerator() in FDirectShowDeviceTable::EnumerateSystemDevices(): %d"), HResult);
+		return;
+	}
+
+	// S_FALSE means there are no devices in this category
+	if (HResult == S_FALSE || !EnumMoniker.IsValid())
+	{
+		return;
+	}
+
+	while (true)
+	{
+		TComPtr<IMoniker> Moniker;
+		if (EnumMoniker->Next(1, &Moniker, nullptr) != S_OK)
+		{
+			break;
+		}
+
+		if (!Moniker.IsValid())
+		{
+			continue;
+		}
+
+		TComPtr<IPropertyBag> PropertyBag;
+		if (FAILED(Moniker->BindToStorage(0, 0, IID_IPropertyBag, (void**)&PropertyBag)))
+		{
+			continue;
+		}
+
+		// read everything we need from the bag at once, the strings go straight into the pool
+		VARIANT FriendlyName;
+		VARIANT Description;
+		VARIANT DevicePath;
+		VariantInit(&FriendlyName);
+		VariantInit(&Description);
+		VariantInit(&DevicePath);
+
+		const bool bHasFriendlyName = (PropertyBag->Read(L"FriendlyName", &FriendlyName, 0) == S_OK) && (FriendlyName.vt == VT_BSTR);
+		const bool bHasDescription = (PropertyBag->Read(L"Description", &Description, 0) == S_OK) && (Description.vt == VT_BSTR);
+		const bool bHasDevicePath = (PropertyBag->Read(L"DevicePath", &DevicePath, 0) == S_OK) && (DevicePath.vt == VT_BSTR);
+
+		// binding the filter to look at its pins is slow, so devices that had a capture pin before are not checked again
+		bool bHasCapturePin = true;
+
+		if (DeviceClass == EDirectShowDeviceClass::Video)
+		{
+			const TCHAR* Url = bHasDevicePath ? DevicePath.bstrVal : bHasFriendlyName ? FriendlyName.bstrVal : bHasDescription ? Description.bstrVal : nullptr;
+			const int32 KnownIndex = (Url != nullptr) ? FindKnownByUrl(Tables[(int32)DeviceClass], Url) : INDEX_NONE;
+
+			bHasCapturePin = ((KnownIndex != INDEX_NONE) && Tables[(int32)DeviceClass].Devices[KnownIndex].bHasCapturePin) || HasVideoCapturePin(Moniker);
+		}
+
+		AddDevice(
+			DeviceClass,
+			bHasFriendlyName ? FriendlyName.bstrVal : nullptr,
+			bHasDescription ? Description.bstrVal : nullptr,
+			bHasDevicePath ? DevicePath.bstrVal : nullptr,
+			Moniker,
+			bHasCapturePin);
+
+		VariantClear(&FriendlyName);
+		VariantClear(&Description);
+		VariantClear(&DevicePath);
+	}
+}
+
+
+bool FDirectShowDeviceTable::BindDevice(const FDevice& Device, IBaseFilter** OutFilter)
+{
+	if (!Device.Moniker.IsValid())
+	{
+		return false;
+	}
+
+	return SUCCEEDED(Device.Moniker->BindToObject(NULL, NULL, IID_IBaseFilter, (void**)OutFilter));
+}
+
+
+bool FDirectShowDeviceTable::HasVideoCapturePin(IMoniker* Moniker)
+{
+	TComPtr<IBaseFilter> Filter;
+	if (FAILED(Moniker->BindToObject(NULL, NULL, IID_IBaseFilter, (void**)&Filter)))
+	{
+		return false;
+	}
+
+	TComPtr<IPin> Pin;
+	return GetPin(Filter, PINDIR_OUTPUT, MEDIATYPE_Video, PIN_CATEGORY_CAPTURE, &Pin);
+}
+
+
+const FDirectShowDeviceTable::FDevice* FDirectShowDeviceTable::GetDevice(const FDirectShowDeviceId& DeviceId) const
+{
+	if (!DeviceId.IsValid())
+	{
+		return nullptr;
+	}
+
+	const FClassTable& Table = Tables[(int32)DeviceId.DeviceClass];
+
+	return Table.Devices.IsValidIndex(DeviceId.Index) ? &Table.Devices[DeviceId.Index] : nullptr;
+}
+
+
+template<typename FindType>
+int32 FDirectShowDeviceTable::FindWithRefresh(EDirectShowDeviceClass DeviceClass, FindType&& Find)
+{
+	const FClassTable& Table = Tables[(int32)DeviceClass];
+
+	if (Table.bEnumerated)
+	{
+		const int32 DeviceIndex = Find(Table);
+
+		if (DeviceIndex != INDEX_NONE)
+		{
+			return DeviceIndex;
+		}
+	}
+
+	// not enumerated yet, or the device was plugged in since
+	Refresh(DeviceClass);
+
+	return Find(Table);
+}
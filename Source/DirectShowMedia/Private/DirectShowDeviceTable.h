@@ -0,0 +1,299 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreTypes.h"
+#include "Containers/Array.h"
+#include "Containers/Map.h"
+#include "Containers/UnrealString.h"
+#include "HAL/CriticalSection.h"
+#include "Templates/Function.h"
+
+#include "DirectShowMediaCommon.h"
+
+struct FMediaCaptureDeviceInfo;
+
+
+/** Device categories kept in the device table. */
+enum class EDirectShowDeviceClass : uint8
+{
+	Video,
+	Audio,
+
+	Num
+};
+
+
+/**
+ * Identity of a device in the device table.
+ *
+ * Devices are matched by url across re-enumerations and never removed from the table, so an identity stays
+ * valid (and refers to the same device) for the lifetime of the process, even if the device is unplugged.
+ */
+struct FDirectShowDeviceId
+{
+	/** The device's class. */
+	EDirectShowDeviceClass DeviceClass = EDirectShowDeviceClass::Num;
+
+	/** Index of the device in its class table. */
+	int32 Index = INDEX_NONE;
+
+	/** Whether this identifies a device. */
+	bool IsValid() const
+	{
+		return (DeviceClass != EDirectShowDeviceClass::Num) && (Index != INDEX_NONE);
+	}
+};
+
+
+/**
+ * Process wide cache of the DirectShow capture devices.
+ *
+ * Each device category is enumerated in a single COM pass that reads all properties of a device at once.
+ * Names and paths are stored once in a shared character pool, devices are looked up through hashes of
+ * their url and (case insensitive) names, and the device monikers are kept so filters can be bound without
+ * walking the system enumerator again. The enumeration helpers, the pin lookups and the friendly name
+ * queries all share this table; a lookup that misses re-enumerates once to pick up devices that were
+ * plugged in since.
+ *
+ * Urls, device paths and names are resolved to an FDirectShowDeviceId once, after which all queries on
+ * the device are direct.
+ */
+class FDirectShowDeviceTable
+{
+public:
+
+	/** Get the shared table. */
+	static FDirectShowDeviceTable& Get();
+
+	/**
+	 * Map a DirectShow device category to a device class.
+	 *
+	 * @param Category CLSID_VideoInputDeviceCategory or CLSID_AudioInputDeviceCategory.
+	 * @param OutDeviceClass Will contain the device class.
+	 * @return true if the category is known, false otherwise.
+	 */
+	static bool GetDeviceClass(const IID& Category, EDirectShowDeviceClass& OutDeviceClass);
+
+public:
+
+	/**
+	 * Re-enumerate all devices of the given class.
+	 *
+	 * Devices that are gone keep their identity, but are no longer resolved or bound.
+	 *
+	 * @param DeviceClass The devices to enumerate.
+	 */
+	void Refresh(EDirectShowDeviceClass DeviceClass);
+
+	/**
+	 * Replace the enumeration of the system's devices (i.e. with a fixed set of devices in tests).
+	 *
+	 * Refresh calls the enumerator, which adds the devices it finds with AddDevice.
+	 *
+	 * @param InEnumerator The enumerator, or an unset function to enumerate the system's devices again.
+	 */
+	void SetEnumerator(TFunction<void(EDirectShowDeviceClass)> InEnumerator);
+
+	/**
+	 * Remove all devices of the given class.
+	 *
+	 * This invalidates all identities of the class.
+	 *
+	 * @param DeviceClass The devices to remove.
+	 */
+	void Reset(EDirectShowDeviceClass DeviceClass);
+
+	/**
+	 * Add a device to the table (called by Refresh for every moniker).
+	 *
+	 * Devices without a name are ignored. Devices without a path use their name as url. A device whose url
+	 * is already known is updated and keeps its identity.
+	 *
+	 * @param DeviceClass The device's class.
+	 * @param FriendlyName The FriendlyName property, or nullptr.
+	 * @param Description The Description property, or nullptr.
+	 * @param DevicePath The DevicePath property, or nullptr.
+	 * @param Moniker The device's moniker, or nullptr.
+	 * @param bHasCapturePin Whether the device's filter has a capture pin of the device's class.
+	 */
+	void AddDevice(EDirectShowDeviceClass DeviceClass, const TCHAR* FriendlyName, const TCHAR* Description, const TCHAR* DevicePath, IMoniker* Moniker, bool bHasCapturePin = true);
+
+	/**
+	 * Get the media framework's description of all devices of the given class.
+	 *
+	 * Devices without a capture pin are left out.
+	 *
+	 * @param DeviceClass The devices to describe.
+	 * @param OutDeviceInfos Will contain the device descriptions.
+	 */
+	void GetDeviceInfos(EDirectShowDeviceClass DeviceClass, TArray<FMediaCaptureDeviceInfo>& OutDeviceInfos);
+
+	/**
+	 * Resolve a url, device path or name to a device.
+	 *
+	 * Urls are matched exactly, names case insensitively against the friendly name and the description.
+	 * If nothing matches, the first device whose name or description contains the given string is used.
+	 *
+	 * @param DeviceClass The device's class.
+	 * @param UrlOrName The string to resolve.
+	 * @param OutDeviceId Will contain the device.
+	 * @return true if a device was found, false otherwise.
+	 */
+	bool Resolve(EDirectShowDeviceClass DeviceClass, const FString& UrlOrName, FDirectShowDeviceId& OutDeviceId);
+
+	/**
+	 * Find the audio device that belongs to a video device.
+	 *
+	 * Capture cards and webcams usually list their audio input under a name that contains (or shares most
+	 * words with) the video device's name, or under the same USB vendor and product id. The pairing is
+	 * cached until the next enumeration.
+	 *
+	 * @param VideoDeviceId The video device.
+	 * @param OutAudioDeviceId Will contain the audio device.
+	 * @return true if an audio device was paired, false otherwise.
+	 */
+	bool FindAudioDevice(const FDirectShowDeviceId& VideoDeviceId, FDirectShowDeviceId& OutAudioDeviceId);
+
+	/**
+	 * Get the name of a device.
+	 *
+	 * @param DeviceId The device.
+	 * @param OutFriendlyName Will contain the name.
+	 * @return true if the device is known, false otherwise.
+	 */
+	bool GetFriendlyName(const FDirectShowDeviceId& DeviceId, FString& OutFriendlyName);
+
+	/**
+	 * Create the source filter of a device.
+	 *
+	 * @param DeviceId The device.
+	 * @param OutFilter Will contain the filter.
+	 * @return true if the filter was created, false otherwise.
+	 */
+	bool BindFilter(const FDirectShowDeviceId& DeviceId, IBaseFilter** OutFilter);
+
+	/**
+	 * Get the name of a device.
+	 *
+	 * @param DeviceClass The device's class.
+	 * @param Url The device's url.
+	 * @param OutFriendlyName Will contain the name.
+	 * @return true if the device was found, false otherwise.
+	 */
+	bool GetFriendlyName(EDirectShowDeviceClass DeviceClass, const FString& Url, FString& OutFriendlyName);
+
+	/**
+	 * Create the source filter of a device.
+	 *
+	 * @param DeviceClass The device's class.
+	 * @param Url The device's url.
+	 * @param OutFilter Will contain the filter.
+	 * @return true if the filter was created, false otherwise.
+	 */
+	bool BindFilterByUrl(EDirectShowDeviceClass DeviceClass, const FString& Url, IBaseFilter** OutFilter);
+
+	/**
+	 * Create the source filter of the device whose name best matches.
+	 *
+	 * @param DeviceClass The device's class.
+	 * @param Name The name to look for.
+	 * @param OutFilter Will contain the filter.
+	 * @return true if the filter was created, false otherwise.
+	 * @see Resolve
+	 */
+	bool BindFilterByName(EDirectShowDeviceClass DeviceClass, const FString& Name, IBaseFilter** OutFilter);
+
+private:
+
+	/** A device, its strings are offsets into the class's string pool. */
+	struct FDevice
+	{
+		int32 Name = INDEX_NONE;
+		int32 Description = INDEX_NONE;
+		int32 Url = INDEX_NONE;
+		TComPtr<IMoniker> Moniker;
+
+		/** Whether the device was found by the last enumeration. */
+		bool bPresent = false;
+
+		/** Whether the device's filter has a capture pin, found when the device is enumerated. */
+		bool bHasCapturePin = false;
+	};
+
+	/** All devices of one class. */
+	struct FClassTable
+	{
+		/** Null terminated strings of all devices, each stored once. */
+		TArray<TCHAR> Strings;
+
+		/** String hash to string pool offset. */
+		TMultiMap<uint32, int32> StringIndex;
+
+		/** The devices. */
+		TArray<FDevice> Devices;
+
+		/** Url hash to device index. */
+		TMultiMap<uint32, int32> UrlIndex;
+
+		/** Case insensitive hash of the friendly name and the description to device index. */
+		TMultiMap<uint32, int32> NameIndex;
+
+		/** Video device index to paired audio device index (INDEX_NONE if there is none), video class only. */
+		TMap<int32, int32> AudioPairs;
+
+		/** Whether the class was enumerated at least once. */
+		bool bEnumerated = false;
+	};
+
+	/** Store a string in the pool, returning the offset of an existing copy if there is one. */
+	static int32 Intern(FClassTable& Table, const TCHAR* String);
+
+	/** Get a string from the pool. */
+	static const TCHAR* GetString(const FClassTable& Table, int32 Offset);
+
+	/** Case insensitive hash of a name. */
+	static uint32 HashName(const TCHAR* Name);
+
+	/** Find a present device by url, or INDEX_NONE. */
+	static int32 FindByUrl(const FClassTable& Table, const FString& Url);
+
+	/** Find a device by url, present or not, or INDEX_NONE. */
+	static int32 FindKnownByUrl(const FClassTable& Table, const TCHAR* Url);
+
+	/** Find a present device by name, or INDEX_NONE. */
+	static int32 FindByName(const FClassTable& Table, const FString& Name);
+
+	/** Find a present device by url or name, or INDEX_NONE. */
+	static int32 FindByUrlOrName(const FClassTable& Table, const FString& UrlOrName);
+
+	/** Score how likely an audio device belongs to a video device (0 if it doesn't). */
+	static int32 ScoreAudioPair(const FClassTable& VideoTable, const FDevice& VideoDevice, const FClassTable& AudioTable, const FDevice& AudioDevice);
+
+	/** Add all devices of a class from the system device enumerator. */
+	void EnumerateSystemDevices(EDirectShowDeviceClass DeviceClass);
+
+	/** Bind a device's moniker to its source filter. */
+	static bool BindDevice(const FDevice& Device, IBaseFilter** OutFilter);
+
+	/** Check whether a device's source filter has a video capture pin. */
+	static bool HasVideoCapturePin(IMoniker* Moniker);
+
+	/** Get a device by identity, or nullptr. */
+	const FDevice* GetDevice(const FDirectShowDeviceId& DeviceId) const;
+
+	/** Find a device, enumerating first if needed and once more on a miss. */
+	template<typename FindType>
+	int32 FindWithRefresh(EDirectShowDeviceClass DeviceClass, FindType&& Find);
+
+private:
+
+	/** Synchronizes access from the game thread and the player's initialization tasks. */
+	mutable FCriticalSection CriticalSection;
+
+	/** One table per device class. */
+	FClassTable Tables[(int32)EDirectShowDeviceClass::Num];
+
+	/** Replaces the system enumeration if set. */
+	TFunction<void(EDirectShowDeviceClass)> Enumerator;
+};
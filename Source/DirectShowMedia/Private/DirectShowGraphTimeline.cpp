@@ -0,0 +1,229 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "DirectShowGraphTimeline.h"
+
+#include "HAL/PlatformTime.h"
+#include "Math/UnrealMathUtility.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Misc/ScopeLock.h"
+
+#include "DirectShowMedia.h"
+
+
+namespace DirectShowGraphTimeline
+{
+	/** Escape a string for a JSON string literal. */
+	FString EscapeJson(const FString& String)
+	{
+		FString Escaped;
+		Escaped.Reserve(String.Len());
+
+		for (const TCHAR Char : String)
+		{
+			switch (Char)
+			{
+			case TEXT('"'): Escaped += TEXT("\\\""); break;
+			case TEXT('\\'): Escaped += TEXT("\\\\"); break;
+			case TEXT('\n'): Escaped += TEXT("\\n"); break;
+			case TEXT('\r'): Escaped += TEXT("\\r"); break;
+			case TEXT('\t'): Escaped += TEXT("\\t"); break;
+			default:
+				if (Char < 0x20)
+				{
+					Escaped += FString::Printf(TEXT("\\u%04x"), (uint32)Char);
+				}
+				else
+				{
+					Escaped += Char;
+				}
+			}
+		}
+
+		return Escaped;
+	}
+}
+
+
+/* FDirectShowGraphTimeline structors
+ *****************************************************************************/
+
+FDirectShowGraphTimeline::FDirectShowGraphTimeline()
+	: OpenTime(0.0)
+	, Depth(0)
+	, NumOpens(0)
+{ }
+
+
+/* FDirectShowGraphTimeline interface
+ *****************************************************************************/
+
+int32 FDirectShowGraphTimeline::BeginStep(const TCHAR* Name)
+{
+	const double Now = FPlatformTime::Seconds();
+
+	FScopeLock Lock(&CriticalSection);
+
+	// the outermost step is the open itself
+	if (Depth == 0)
+	{
+		Steps.Reset();
+		OpenTime = Now;
+	}
+
+	FDirectShowGraphStep& Step = Steps.AddDefaulted_GetRef();
+	Step.Name = Name;
+	Step.Depth = Depth++;
+	Step.StartTime = Now - OpenTime;
+
+	return Steps.Num() - 1;
+}
+
+
+void FDirectShowGraphTimeline::EndStep(int32 Step, bool bSucceeded, HRESULT Result)
+{
+	const double Now = FPlatformTime::Seconds();
+
+	FString Filename;
+	{
+		FScopeLock Lock(&CriticalSection);
+
+		if (!Steps.IsValidIndex(Step))
+		{
+			return;
+		}
+
+		FDirectShowGraphStep& EndedStep = Steps[Step];
+		EndedStep.Duration = Now - OpenTime - EndedStep.StartTime;
+		EndedStep.Result = Result;
+		EndedStep.bSucceeded = bSucceeded;
+
+		if (--Depth > 0)
+		{
+			return;
+		}
+
+		Depth = 0;
+		++NumOpens;
+		Filename = TraceFile;
+
+		UE_LOG(LogDirectShowMedia, Verbose, TEXT("Opened %s in %.1f ms (%s)"), *Label, EndedStep.Duration * 1000.0, bSucceeded ? TEXT("succeeded") : TEXT("failed"));
+	}
+
+	// the file is written outside the lock, the stats don't wait for the disk
+	if (!Filename.IsEmpty() && !SaveChromeTrace(Filename))
+	{
+		UE_LOG(LogDirectShowMedia, Warning, TEXT("Failed to write the graph trace to %s"), *Filename);
+	}
+}
+
+
+void FDirectShowGraphTimeline::SetLabel(const FString& InLabel)
+{
+	FScopeLock Lock(&CriticalSection);
+	Label = InLabel;
+}
+
+
+void FDirectShowGraphTimeline::SetTraceFile(const FString& InTraceFile)
+{
+	FScopeLock Lock(&CriticalSection);
+	TraceFile = InTraceFile;
+}
+
+
+void FDirectShowGraphTimeline::GetSteps(TArray<FDirectShowGraphStep>& OutSteps) const
+{
+	FScopeLock Lock(&CriticalSection);
+	OutSteps = Steps;
+}
+
+
+FString FDirectShowGraphTimeline::GetLabel() const
+{
+	FScopeLock Lock(&CriticalSection);
+	return Label;
+}
+
+
+uint32 FDirectShowGraphTimeline::GetNumOpens() const
+{
+	FScopeLock Lock(&CriticalSection);
+	return NumOpens;
+}
+
+
+FString FDirectShowGraphTimeline::ToChromeTrace() const
+{
+	FScopeLock Lock(&CriticalSection);
+
+	FString Trace = TEXT("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	Trace += FString::Printf(TEXT("{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"DirectShowMedia open %s\"}}"), *DirectShowGraphTimeline::EscapeJson(Label));
+
+	// complete events nest by time on the same thread, which rebuilds the step tree
+	for (const FDirectShowGraphStep& Step : Steps)
+	{
+		Trace += FString::Printf(TEXT(",\n{\"name\":\"%s\",\"cat\":\"DirectShowMedia\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.1f,\"dur\":%.1f,\"args\":{\"succeeded\":%s,\"hresult\":\"0x%08x\",\"depth\":%d}}"),
+			*DirectShowGraphTimeline::EscapeJson(Step.Name), Step.StartTime * 1.0e6, FMath::Max(0.0, Step.Duration) * 1.0e6,
+			Step.bSucceeded ? TEXT("true") : TEXT("false"), (uint32)Step.Result, Step.Depth);
+	}
+
+	Trace += TEXT("\n]}\n");
+
+	return Trace;
+}
+
+
+bool FDirectShowGraphTimeline::SaveChromeTrace(const FString& Filename) const
+{
+	const FString Path = FPaths::IsRelative(Filename) ? FPaths::Combine(FPaths::ProjectSavedDir(), Filename) : Filename;
+
+	return FFileHelper::SaveStringToFile(ToChromeTrace(), *Path);
+}
+
+
+/* FDirectShowGraphScopedStep structors
+ *****************************************************************************/
+
+FDirectShowGraphScopedStep::FDirectShowGraphScopedStep(FDirectShowGraphTimeline& InTimeline, const TCHAR* Name)
+	: Timeline(InTimeline)
+	, Step(InTimeline.BeginStep(Name))
+	, TrackedResult(nullptr)
+	, Result(S_OK)
+	, bSucceeded(false)
+{ }
+
+
+FDirectShowGraphScopedStep::FDirectShowGraphScopedStep(FDirectShowGraphTimeline& InTimeline, const TCHAR* Name, const HRESULT& InTrackedResult)
+	: Timeline(InTimeline)
+	, Step(InTimeline.BeginStep(Name))
+	, TrackedResult(&InTrackedResult)
+	, Result(S_OK)
+	, bSucceeded(false)
+{ }
+
+
+FDirectShowGraphScopedStep::~FDirectShowGraphScopedStep()
+{
+	End();
+}
+
+
+/* FDirectShowGraphScopedStep interface
+ *****************************************************************************/
+
+void FDirectShowGraphScopedStep::End()
+{
+	if (Step == INDEX_NONE)
+	{
+		return;
+	}
+
+	if (TrackedResult != nullptr)
+	{
+		SetResult(*TrackedResult);
+	}
+
+	Timeline.EndStep(Step, bSucceeded, Result);
+	Step = INDEX_NONE;
+}
@@ -0,0 +1,219 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreTypes.h"
+#include "Containers/Array.h"
+#include "Containers/UnrealString.h"
+#include "HAL/CriticalSection.h"
+
+#include "Windows/AllowWindowsPlatformTypes.h"
+#include "Windows/WindowsHWrapper.h"
+#include "Windows/HideWindowsPlatformTypes.h"
+
+
+/** A step of building and starting a filter graph. */
+struct FDirectShowGraphStep
+{
+	/** Name of the step (a string literal). */
+	const TCHAR* Name = nullptr;
+
+	/** Nesting depth, zero for the open itself. */
+	int32 Depth = 0;
+
+	/** Time the step began, relative to the start of the open (in seconds). */
+	double StartTime = 0.0;
+
+	/** Wall time of the step (in seconds), negative while it runs. */
+	double Duration = -1.0;
+
+	/** The HRESULT the step reported, S_OK if it only reported success or failure. */
+	HRESULT Result = S_OK;
+
+	/** Whether the step succeeded. */
+	bool bSucceeded = false;
+};
+
+
+/**
+ * Timeline of the last time a device's filter graph was opened.
+ *
+ * Each open is recorded as a tree of timed steps (creating the graph, binding the device, setting the format,
+ * adding and connecting filters, starting the graph) with the outcome and HRESULT of each. The outermost step
+ * is the open itself; beginning it clears the previous open. The timeline is reported in the player stats,
+ * and written as a Chrome trace (chrome://tracing, Perfetto) after every open if a trace file is set.
+ *
+ * Steps are recorded through FDirectShowGraphScopedStep.
+ */
+class FDirectShowGraphTimeline
+{
+public:
+
+	/** Default constructor. */
+	FDirectShowGraphTimeline();
+
+public:
+
+	/**
+	 * Begin a step.
+	 *
+	 * @param Name Name of the step (a string literal).
+	 * @return The step, to pass to EndStep.
+	 */
+	int32 BeginStep(const TCHAR* Name);
+
+	/**
+	 * End a step, and the open if it is the outermost step.
+	 *
+	 * @param Step The step returned by BeginStep.
+	 * @param bSucceeded Whether the step succeeded.
+	 * @param Result The HRESULT the step reported.
+	 */
+	void EndStep(int32 Step, bool bSucceeded, HRESULT Result);
+
+	/**
+	 * Set what is being opened, shown in the stats and the trace.
+	 *
+	 * @param InLabel The label (i.e. the device url).
+	 */
+	void SetLabel(const FString& InLabel);
+
+	/**
+	 * Set the file the timeline is written to after every open.
+	 *
+	 * @param InTraceFile The file, relative to the project's Saved directory, or empty to write none.
+	 */
+	void SetTraceFile(const FString& InTraceFile);
+
+	/**
+	 * Get the steps of the last open.
+	 *
+	 * @param OutSteps Will contain the steps, in the order they began.
+	 */
+	void GetSteps(TArray<FDirectShowGraphStep>& OutSteps) const;
+
+	/** Get what was opened last. */
+	FString GetLabel() const;
+
+	/** Get the number of completed opens. */
+	uint32 GetNumOpens() const;
+
+	/**
+	 * Convert the last open to a Chrome trace.
+	 *
+	 * @return The trace (JSON), with one complete event per step.
+	 */
+	FString ToChromeTrace() const;
+
+	/**
+	 * Write the last open as a Chrome trace.
+	 *
+	 * @param Filename The file, relative to the project's Saved directory.
+	 * @return true on success, false otherwise.
+	 */
+	bool SaveChromeTrace(const FString& Filename) const;
+
+private:
+
+	/** Synchronizes the thread opening the graph with the stats. */
+	mutable FCriticalSection CriticalSection;
+
+	/** What is being opened. */
+	FString Label;
+
+	/** The steps of the last open. */
+	TArray<FDirectShowGraphStep> Steps;
+
+	/** Time the last open began (in seconds). */
+	double OpenTime;
+
+	/** Number of steps currently running. */
+	int32 Depth;
+
+	/** Number of completed opens. */
+	uint32 NumOpens;
+
+	/** The file written after every open, empty for none. */
+	FString TraceFile;
+};
+
+
+/**
+ * Times a step of the open for as long as it is in scope, or until End is called.
+ *
+ * A step fails unless it reports success, either explicitly through SetResult and SetSucceeded, or through an
+ * HRESULT variable it tracks and reads when it ends.
+ */
+class FDirectShowGraphScopedStep
+{
+public:
+
+	/**
+	 * Begin a step that reports its outcome through SetResult or SetSucceeded.
+	 *
+	 * @param InTimeline The timeline to record into.
+	 * @param Name Name of the step (a string literal).
+	 */
+	FDirectShowGraphScopedStep(FDirectShowGraphTimeline& InTimeline, const TCHAR* Name);
+
+	/**
+	 * Begin a step that reports the value of an HRESULT variable when it ends.
+	 *
+	 * @param InTimeline The timeline to record into.
+	 * @param Name Name of the step (a string literal).
+	 * @param InTrackedResult The variable, which must outlive the step.
+	 */
+	FDirectShowGraphScopedStep(FDirectShowGraphTimeline& InTimeline, const TCHAR* Name, const HRESULT& InTrackedResult);
+
+	/** End the step if it wasn't ended yet. */
+	~FDirectShowGraphScopedStep();
+
+public:
+
+	/** End the step before it goes out of scope. */
+	void End();
+
+	/**
+	 * Report an HRESULT, which also decides whether the step succeeded.
+	 *
+	 * @param InResult The HRESULT.
+	 * @return The HRESULT.
+	 */
+	HRESULT SetResult(HRESULT InResult)
+	{
+		Result = InResult;
+		bSucceeded = SUCCEEDED(InResult);
+
+		return InResult;
+	}
+
+	/**
+	 * Report whether the step succeeded, keeping the reported HRESULT.
+	 *
+	 * @param bInSucceeded Whether the step succeeded.
+	 * @return The same value.
+	 */
+	bool SetSucceeded(bool bInSucceeded)
+	{
+		bSucceeded = bInSucceeded;
+
+		return bInSucceeded;
+	}
+
+private:
+
+	/** The timeline. */
+	FDirectShowGraphTimeline& Timeline;
+
+	/** The step, INDEX_NONE once it ended. */
+	int32 Step;
+
+	/** The HRESULT variable read when the step ends, or nullptr. */
+	const HRESULT* TrackedResult;
+
+	/** The reported HRESULT. */
+	HRESULT Result;
+
+	/** Whether the step reported success. */
+	bool bSucceeded;
+};
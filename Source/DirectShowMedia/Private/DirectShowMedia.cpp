@@ -5,9 +5,12 @@
 #include <dshow.h>
 
 #include "DirectShowMediaCommon.h"
+#include "DirectShowDeviceTable.h"
 #include "IMediaModule.h"
 #include "Microsoft/COMPointer.h"
+#include "Misc/ConfigCacheIni.h"
 #include "Windows/HideWindowsPlatformTypes.h"
+#include "Player/DirectShowMediaFrameArena.h"
 #include "Player/DirectShowMediaPlayer.h"
 
 #define LOCTEXT_NAMESPACE "FDirectShowMediaModule"
@@ -26,207 +29,51 @@ void FDirectShowMediaModule::StartupModule()
 		MediaModule->RegisterCaptureSupport(*this);
 	}
 
+	// frame arenas on large pages need the "Lock pages in memory" right enabled for the whole process, so it's opt-in:
+	// [DirectShowMedia] bLockPagesInMemory=True in the engine configuration
+	bool bLockPagesInMemory = false;
+	GConfig->GetBool(TEXT("DirectShowMedia"), TEXT("bLockPagesInMemory"), bLockPagesInMemory, GEngineIni);
+
+	if (bLockPagesInMemory)
+	{
+		if (FDirectShowMediaFrameArena::EnableLargePages())
+		{
+			UE_LOG(LogDirectShowMedia, Log, TEXT("Frame arenas use large pages"));
+		}
+		else
+		{
+			UE_LOG(LogDirectShowMedia, Warning, TEXT("Frame arenas can't use large pages, the account may lack the \"Lock pages in memory\" right"));
+		}
+	}
+
 	Initialized = true;
 }
 
 void FDirectShowMediaModule::ShutdownModule()
 {
+	// the device table outlives the module, but its monikers must be released while COM is still up
+	FDirectShowDeviceTable& DeviceTable = FDirectShowDeviceTable::Get();
+	DeviceTable.Reset(EDirectShowDeviceClass::Video);
+	DeviceTable.Reset(EDirectShowDeviceClass::Audio);
+
 	FPlatformMisc::CoUninitialize();
 }
 
 void FDirectShowMediaModule::EnumerateAudioCaptureDevices(TArray<FMediaCaptureDeviceInfo>& OutDeviceInfos)
 {
-	HRESULT HResult;
-	VARIANT Info;
-	TComPtr<ICreateDevEnum> DevEnum;
-	TComPtr<IEnumMoniker> EnumMoniker;
-	TComPtr<IMoniker> Moniker;
-	TComPtr<IPropertyBag> PropertyBag;
-	
-	//create an enumerator for video input devices
-	HResult = CoCreateInstance(CLSID_SystemDeviceEnum, NULL, CLSCTX_INPROC_SERVER, IID_ICreateDevEnum, (void**)&DevEnum);
-	if (HResult < 0)
-	{
-		UE_LOG(LogDirectShowMedia, Warning, TEXT("Failed to CoCreateInstance(CLSID_SystemDeviceEnum) in EnumerateAudioCaptureDevices: %d"), HResult);
-		return;
-	}	
-
-	HResult = DevEnum->CreateClassEnumerator(CLSID_AudioInputDeviceCategory, &EnumMoniker, NULL);
-	if (HResult < 0)
-	{
-		UE_LOG(LogDirectShowMedia, Warning, TEXT("Failed to CreateClassEnumerator() in EnumerateAudioCaptureDevices: %d"), HResult);
-		return;
-	}
-
-	if (HResult == S_FALSE)
-	{
-		return;
-	}
-	
-	while (EnumMoniker->Next(1, &Moniker, 0) == S_OK)
-	{
-		HResult = Moniker->BindToStorage(0, 0, IID_IPropertyBag, (void**)&PropertyBag);
-		if (HResult >= 0)
-		{
-			VariantInit(&Info);
-
-			FMediaCaptureDeviceInfo NewInfo;
-			bool InfoValid = true;
-			NewInfo.Type = EMediaCaptureDeviceType::Audio;
-
-			HResult = PropertyBag->Read(L"FriendlyName", &Info, 0);
-			if(HResult == S_OK)
-			{
-				// convert to FText
-				BSTR infoBSTR = Info.bstrVal;
-				std::wstring infowstring(infoBSTR);
-				NewInfo.DisplayName = FText::FromString(FString(infowstring.c_str()));
-			}
-			else
-			{
-				//get the description  "Description"
-				HResult = PropertyBag->Read(L"Description", &Info, 0);
-				if(HResult == S_OK)
-				{
-					// convert to FString
-					BSTR infoBSTR = Info.bstrVal;
-					std::wstring infowstring(infoBSTR);
-					NewInfo.DisplayName = FText::FromString(FString(infowstring.c_str()));
-				}
-				else
-					InfoValid = false;
-			}
-						
-			FString tempUrl = "";
-			HResult = PropertyBag->Read(L"DevicePath", &Info, 0);
-			if(HResult >= 0)
-			{
-				// convert to FString
-				BSTR infoBSTR = Info.bstrVal;
-				std::wstring infowstring(infoBSTR);
-				NewInfo.Url = FString(infowstring.c_str());
-			}
-
-			// Can occur from virtual devices which have no path, instead use name
-			if(NewInfo.Url.IsEmpty())
-			{
-				NewInfo.Url = NewInfo.DisplayName.ToString();
-			}
-
-			if(InfoValid)
-				OutDeviceInfos.Add(NewInfo);
-			
-			VariantClear(&Info);
+	FDirectShowDeviceTable& DeviceTable = FDirectShowDeviceTable::Get();
 
-		}
-
-	}
+	DeviceTable.Refresh(EDirectShowDeviceClass::Audio);
+	DeviceTable.GetDeviceInfos(EDirectShowDeviceClass::Audio, OutDeviceInfos);
 }
 
 void FDirectShowMediaModule::EnumerateVideoCaptureDevices(TArray<FMediaCaptureDeviceInfo>& OutDeviceInfos)
 {
-	HRESULT HResult;
-	VARIANT Info;
-	TComPtr<ICreateDevEnum> DevEnum;
-	TComPtr<IEnumMoniker> EnumMoniker;
-	TComPtr<IMoniker> Moniker;
-	TComPtr<IPropertyBag> PropertyBag;
-	
-	//create an enumerator for video input devices
-	HResult = CoCreateInstance(CLSID_SystemDeviceEnum, NULL, CLSCTX_INPROC_SERVER, IID_ICreateDevEnum, (void**)&DevEnum);
-	if (HResult < 0)
-	{
-		UE_LOG(LogDirectShowMedia, Warning, TEXT("Failed to CoCreateInstance(CLSID_SystemDeviceEnum) in EnumerateVideoCaptureDevices: %d"), HResult);
-		return;
-	}	
+	FDirectShowDeviceTable& DeviceTable = FDirectShowDeviceTable::Get();
 
-	if(!DevEnum.IsValid())
-	{
-		UE_LOG(LogDirectShowMedia, Warning, TEXT("Invalid DevEnum in EnumerateVideoCaptureDevices"));
-		return;
-	}
-	
-	HResult = DevEnum->CreateClassEnumerator(CLSID_VideoInputDeviceCategory, &EnumMoniker, NULL);
-	if (HResult < 0)
-	{
-		UE_LOG(LogDirectShowMedia, Warning, TEXT("Failed to CreateClassEnumerator() in EnumerateVideoCaptureDevices: %d"), HResult);
-		return;
-	}
-
-	if(!EnumMoniker.IsValid())
-	{
-		UE_LOG(LogDirectShowMedia, Warning, TEXT("Invalid EnumMoniker in EnumerateVideoCaptureDevices"));
-		return;
-	}
-
-	while (EnumMoniker->Next(1, &Moniker, 0) == S_OK)
-	{
-		if(!Moniker.IsValid())
-		{
-			UE_LOG(LogDirectShowMedia, Warning, TEXT("Invalid Moniker in EnumerateVideoCaptureDevices"));
-			return;
-			
-		}
-		HResult = Moniker->BindToStorage(0, 0, IID_IPropertyBag, (void**)&PropertyBag);
-		if (HResult >= 0)
-		{			
-			VariantInit(&Info);
-
-			FMediaCaptureDeviceInfo NewInfo;
-			bool InfoValid = true;
-			NewInfo.Type = EMediaCaptureDeviceType::Video;  
-
-			HResult = PropertyBag->Read(L"FriendlyName", &Info, 0);
-			if(HResult == S_OK)
-			{
-				// convert to FText
-				BSTR infoBSTR = Info.bstrVal;
-				std::wstring infowstring(infoBSTR);
-				NewInfo.DisplayName = FText::FromString(FString(infowstring.c_str()));
-			}
-			else
-			{
-				//get the description  "Description"
-				HResult = PropertyBag->Read(L"Description", &Info, 0);
-				if(HResult == S_OK)
-				{
-					// convert to FString
-					BSTR infoBSTR = Info.bstrVal;
-					std::wstring infowstring(infoBSTR);
-					NewInfo.DisplayName = FText::FromString(FString(infowstring.c_str()));
-				}
-				else
-					InfoValid = false;
-			}
-						
-			FString tempUrl = "";
-			HResult = PropertyBag->Read(L"DevicePath", &Info, 0);
-			if(HResult >= 0)
-			{
-				// convert to FString
-				BSTR infoBSTR = Info.bstrVal;
-				std::wstring infowstring(infoBSTR);
-				NewInfo.Url = FString(infowstring.c_str());
-			}
-
-			// Can occur from virtual devices which have no path, instead use name
-			if(NewInfo.Url.IsEmpty())
-			{
-				NewInfo.Url = NewInfo.DisplayName.ToString();
-			}
-
-			TComPtr<IPin> sourcePin;
-			if(!GetPin(NewInfo.Url, CLSID_VideoInputDeviceCategory,MEDIATYPE_Video,PINDIR_OUTPUT, &sourcePin))
-			{
-				InfoValid = false;
-			}
-
-			if(InfoValid)
-				OutDeviceInfos.Add(NewInfo);
-			
-			VariantClear(&Info);
-		}
-	}
+	// the enumeration finds which devices actually have a video capture pin, the others aren't listed
+	DeviceTable.Refresh(EDirectShowDeviceClass::Video);
+	DeviceTable.GetDeviceInfos(EDirectShowDeviceClass::Video, OutDeviceInfos);
 }
 
 TSharedPtr<IMediaPlayer, ESPMode::ThreadSafe> FDirectShowMediaModule::CreatePlayer(ISinkMediaEvent& EventSink)
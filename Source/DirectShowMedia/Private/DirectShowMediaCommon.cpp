@@ -1,6 +1,11 @@
 #include "DirectShowMediaCommon.h"
 #include "DirectShowMediaType.h"
 #include "DirectShowMedia.h"
+#include "DirectShowDeviceTable.h"
+
+#include "Windows/AllowWindowsPlatformTypes.h"
+#include <mmreg.h>
+#include "Windows/HideWindowsPlatformTypes.h"
 
 
 FString GUIDToUEString(const GUID& guid)
@@ -14,6 +19,13 @@ FString GUIDToUEString(const GUID& guid)
 	else if (guid == MEDIASUBTYPE_RGB32) return TEXT("MEDIASUBTYPE_RGB32");
 	else if (guid == MEDIASUBTYPE_YUY2) return TEXT("MEDIASUBTYPE_YUY2");
 	else if (guid == MEDIASUBTYPE_UYVY) return TEXT("MEDIASUBTYPE_UYVY");
+	else if (guid == DSMEDIASUBTYPE_P010) return TEXT("MEDIASUBTYPE_P010");
+	else if (guid == DSMEDIASUBTYPE_Y210) return TEXT("MEDIASUBTYPE_Y210");
+	else if (guid == DSMEDIASUBTYPE_v210) return TEXT("MEDIASUBTYPE_v210");
+	else if (guid == MEDIASUBTYPE_IYUV) return TEXT("MEDIASUBTYPE_IYUV");
+	else if (guid == DSMEDIASUBTYPE_I420) return TEXT("MEDIASUBTYPE_I420");
+	else if (guid == MEDIASUBTYPE_YV12) return TEXT("MEDIASUBTYPE_YV12");
+	else if (guid == DSMEDIASUBTYPE_NV21) return TEXT("MEDIASUBTYPE_NV21");
 	// Add more GUIDs as necessary...
 	else return FString::Printf(TEXT("{%08X-%04X-%04X-%02X%02X-%02X%02X%02X%02X%02X%02X}"),
 								guid.Data1, guid.Data2, guid.Data3, 
@@ -229,278 +241,69 @@ bool GetPin(TComPtr<IBaseFilter> pFilter, PIN_DIRECTION PinDir, GUID MajorType,
 
 bool GetPin(const FString& Url, const IID& clsidDeviceClass, const GUID& MajorType, PIN_DIRECTION PinDir, IPin** Pin)
 {
-	HRESULT HResult;
-	VARIANT Name;
-	TComPtr<ICreateDevEnum> DevEnum;
-	TComPtr<IEnumMoniker> EnumMoniker;
-	TComPtr<IMoniker> Moniker;
-	TComPtr<IPropertyBag> PropertyBag;
-	bool DeviceFound = false;
-	
-	//create an enumerator for video input devices
-	HResult = CoCreateInstance(CLSID_SystemDeviceEnum, NULL, CLSCTX_INPROC_SERVER, IID_ICreateDevEnum, (void**)&DevEnum);
-	if (HResult < 0)
-	{
-		UE_LOG(LogDirectShowMedia, Warning, TEXT("Failed to CoCreateInstance(CLSID_SystemDeviceEnum) in GetPin(): %d"), HResult);
-		return false;
-	}
-	
-	if(!DevEnum.IsValid())
+	EDirectShowDeviceClass DeviceClass;
+	if (!FDirectShowDeviceTable::GetDeviceClass(clsidDeviceClass, DeviceClass))
 	{
-		UE_LOG(LogDirectShowMedia, Warning, TEXT("Invalid DevEnum in GetPin()"));
+		UE_LOG(LogDirectShowMedia, Warning, TEXT("Unsupported device category %s in GetPin()"), *GUIDToUEString(clsidDeviceClass));
 		return false;
 	}
 
-	HResult = DevEnum->CreateClassEnumerator(clsidDeviceClass, &EnumMoniker, NULL);
-	if (HResult < 0)
+	TComPtr<IBaseFilter> pFilter;
+	if (!FDirectShowDeviceTable::Get().BindFilterByUrl(DeviceClass, Url, &pFilter))
 	{
-		UE_LOG(LogDirectShowMedia, Warning, TEXT("Failed to CreateClassEnumerator() in GetPin(): %d"), HResult);
 		return false;
 	}
-	
-	if(!EnumMoniker.IsValid())
-	{
-		UE_LOG(LogDirectShowMedia, Warning, TEXT("Invalid EnumMoniker in GetPin()"));
-		return false;
-	}
-	
-	while (EnumMoniker->Next(1, &Moniker, 0) == S_OK && !DeviceFound)
-	{
-		if(!Moniker.IsValid())
-		{
-			UE_LOG(LogDirectShowMedia, Warning, TEXT("Invalid Moniker in GetPin()"));
-			continue;
-		}
-		
-		HResult = Moniker->BindToStorage(0, 0, IID_IPropertyBag, (void**)&PropertyBag);
-		if (HResult >= 0)
-		{
-			VariantInit(&Name);
-
-			//get the description
-			HResult = PropertyBag->Read(L"Description", &Name, 0);
-			if (HResult < 0)
-			{
-				HResult = PropertyBag->Read(L"FriendlyName", &Name, 0);
-			}
-
-			if (HResult >= 0)
-			{
-				FString tempUrl = "";
-				HResult = PropertyBag->Read(L"DevicePath", &Name, 0);
-				if(HResult >= 0)
-				{
-					// Assuming the DevicePath is a BSTR (you may need to confirm this is the case for your specific device)
-					BSTR bstrDevicePath = Name.bstrVal;
-
-					// Convert BSTR to a wide string
-					std::wstring wideDevicePath(bstrDevicePath);
-
-					// Convert wide string to FString
-					tempUrl = FString(wideDevicePath.c_str());
-				}
-
-				// Can occur from virtual devices which have no path, instead use name
-				if(tempUrl.IsEmpty())
-				{
-					tempUrl = Name.bstrVal;
-				}
-
-				// Check Device URL
-				if(!tempUrl.Equals(Url))
-					continue;
-
-				// Found device, now get media types
-				TComPtr<IBaseFilter> pFilter = NULL;
-				HResult = Moniker->BindToObject(NULL, NULL, IID_IBaseFilter, (void**)&pFilter);
-				if (SUCCEEDED(HResult))
-				{
-					return GetPin(pFilter, PinDir, MajorType, PIN_CATEGORY_CAPTURE, Pin);
-				}
-				
-			}
-			VariantClear(&Name);
-		}
-	}
 
-	return false;
+	return GetPin(pFilter, PinDir, MajorType, PIN_CATEGORY_CAPTURE, Pin);
 }
 
 bool TryGetAudioPinByFriendlyName(const FString& InFriendlyName, IPin** Pin)
 {
-	HRESULT HResult;
-	VARIANT Name;
-	TComPtr<ICreateDevEnum> DevEnum;
-	TComPtr<IEnumMoniker> EnumMoniker;
-	TComPtr<IMoniker> Moniker;
-	TComPtr<IPropertyBag> PropertyBag;
-	bool DeviceFound = false;
-	
-	//create an enumerator for video input devices
-	HResult = CoCreateInstance(CLSID_SystemDeviceEnum, NULL, CLSCTX_INPROC_SERVER, IID_ICreateDevEnum, (void**)&DevEnum);
-	if (HResult < 0)
+	TComPtr<IBaseFilter> pFilter;
+	if (!FDirectShowDeviceTable::Get().BindFilterByName(EDirectShowDeviceClass::Audio, InFriendlyName, &pFilter))
 	{
-		UE_LOG(LogDirectShowMedia, Warning, TEXT("Failed to CoCreateInstance(CLSID_SystemDeviceEnum) in TryGetAudioPinByFriendlyName(): %d"), HResult);
-		return false;
-	}
-	
-	if(!DevEnum.IsValid())
-	{
-		UE_LOG(LogDirectShowMedia, Warning, TEXT("Invalid DevEnum in TryGetAudioPinByFriendlyName()"));
 		return false;
 	}
 
-	HResult = DevEnum->CreateClassEnumerator(CLSID_AudioInputDeviceCategory, &EnumMoniker, NULL);
-	if (HResult < 0)
-	{
-		UE_LOG(LogDirectShowMedia, Warning, TEXT("Failed to CreateClassEnumerator() in TryGetAudioPinByFriendlyName(): %d"), HResult);
-		return false;
-	}
-	
-	if(!EnumMoniker.IsValid())
+	return GetPin(pFilter, PINDIR_OUTPUT, MEDIATYPE_Audio, PIN_CATEGORY_CAPTURE, Pin);
+}
+
+bool GetDeviceFriendlyName(const FString& Url, const IID& clsidDeviceClass, FString& OutFriendlyName)
+{
+	EDirectShowDeviceClass DeviceClass;
+	if (!FDirectShowDeviceTable::GetDeviceClass(clsidDeviceClass, DeviceClass))
 	{
-		UE_LOG(LogDirectShowMedia, Warning, TEXT("Invalid EnumMoniker in TryGetAudioPinByFriendlyName()"));
+		UE_LOG(LogDirectShowMedia, Warning, TEXT("Unsupported device category %s in GetDeviceFriendlyName()"), *GUIDToUEString(clsidDeviceClass));
 		return false;
 	}
-	
-	while (EnumMoniker->Next(1, &Moniker, 0) == S_OK && !DeviceFound)
-	{
-		if(!Moniker.IsValid())
-		{
-			UE_LOG(LogDirectShowMedia, Warning, TEXT("Invalid Moniker in TryGetAudioPinByFriendlyName()"));
-			continue;
-		}
-		
-		HResult = Moniker->BindToStorage(0, 0, IID_IPropertyBag, (void**)&PropertyBag);
-		if (HResult >= 0)
-		{
-			VariantInit(&Name);
-
-			//get the description
-			HResult = PropertyBag->Read(L"Description", &Name, 0);
-			if (HResult < 0)
-			{
-				HResult = PropertyBag->Read(L"FriendlyName", &Name, 0);
-			}
-
-			if (HResult >= 0)
-			{
-				FString strFriendlyName = Name.bstrVal;
-				if(!strFriendlyName.Contains(InFriendlyName, ESearchCase::IgnoreCase))
-					continue;
-
-				// Found device, now get media types
-				TComPtr<IBaseFilter> pFilter = NULL;
-				HResult = Moniker->BindToObject(NULL, NULL, IID_IBaseFilter, (void**)&pFilter);
-				if (SUCCEEDED(HResult))
-				{
-					return GetPin(pFilter, PINDIR_OUTPUT, MEDIATYPE_Audio, PIN_CATEGORY_CAPTURE, Pin);
-				}
-				
-			}
-			VariantClear(&Name);
-		}
-	}
 
-	return false;
+	return FDirectShowDeviceTable::Get().GetFriendlyName(DeviceClass, Url, OutFriendlyName);
 }
 
-bool GetDeviceFriendlyName(const FString& Url, const IID& clsidDeviceClass, FString& OutFriendlyName)
+EMediaAudioSampleFormat GetAudioSampleFormatBits(const WAVEFORMATEX* wfex)
 {
-	HRESULT HResult;
-	VARIANT Name;
-	TComPtr<ICreateDevEnum> DevEnum;
-	TComPtr<IEnumMoniker> EnumMoniker;
-	TComPtr<IMoniker> Moniker;
-	TComPtr<IPropertyBag> PropertyBag;
-	bool DeviceFound = false;
-	
-	//create an enumerator for video input devices
-	HResult = CoCreateInstance(CLSID_SystemDeviceEnum, NULL, CLSCTX_INPROC_SERVER, IID_ICreateDevEnum, (void**)&DevEnum);
-	if (HResult < 0)
-	{
-		UE_LOG(LogDirectShowMedia, Warning, TEXT("Failed to CoCreateInstance(CLSID_SystemDeviceEnum) in GetDeviceFriendlyName(): %d"), HResult);
-		return false;
-	}	
+	// the bit depth alone doesn't tell 32 bit integer and float PCM apart, the format tag does
+	WORD FormatTag = wfex->wFormatTag;
 
-	if(!DevEnum.IsValid())
-	{
-		UE_LOG(LogDirectShowMedia, Warning, TEXT("Invalid DevEnum in GetDeviceFriendlyName()"));
-		return false;
-	}
-	
-	HResult = DevEnum->CreateClassEnumerator(clsidDeviceClass, &EnumMoniker, NULL);
-	if (HResult < 0)
+	if (FormatTag == WAVE_FORMAT_EXTENSIBLE && wfex->cbSize >= sizeof(WAVEFORMATEXTENSIBLE) - sizeof(WAVEFORMATEX))
 	{
-		UE_LOG(LogDirectShowMedia, Warning, TEXT("Failed to CreateClassEnumerator() in GetDeviceFriendlyName(): %d"), HResult);
-		return false;
+		// extensible sub formats carry the plain format tag in their first field
+		FormatTag = (WORD)reinterpret_cast<const WAVEFORMATEXTENSIBLE*>(wfex)->SubFormat.Data1;
 	}
 
-	if(!EnumMoniker.IsValid())
-	{
-		UE_LOG(LogDirectShowMedia, Warning, TEXT("Invalid EnumMoniker in GetDeviceFriendlyName()"));
-		return false;
-	}
-	
-	while (EnumMoniker->Next(1, &Moniker, 0) == S_OK && !DeviceFound)
+	if (FormatTag == WAVE_FORMAT_IEEE_FLOAT)
 	{
-		if(!Moniker.IsValid())
+		switch (wfex->wBitsPerSample)
 		{
-			UE_LOG(LogDirectShowMedia, Warning, TEXT("Invalid Moniker in GetDeviceFriendlyName()"));
-			continue;
-		}
-		
-		HResult = Moniker->BindToStorage(0, 0, IID_IPropertyBag, (void**)&PropertyBag);
-		if (HResult >= 0)
-		{
-			VariantInit(&Name);
-
-			//get the description
-			HResult = PropertyBag->Read(L"Description", &Name, 0);
-			if (HResult < 0)
-			{
-				HResult = PropertyBag->Read(L"FriendlyName", &Name, 0);
-				OutFriendlyName = Name.bstrVal;
-			}
-
-			if (HResult >= 0)
-			{
-				FString tempUrl = "";
-				HResult = PropertyBag->Read(L"DevicePath", &Name, 0);
-				if(HResult >= 0)
-				{
-					// Assuming the DevicePath is a BSTR (you may need to confirm this is the case for your specific device)
-					BSTR bstrDevicePath = Name.bstrVal;
-
-					// Convert BSTR to a wide string
-					std::wstring wideDevicePath(bstrDevicePath);
-
-					// Convert wide string to FString
-					tempUrl = FString(wideDevicePath.c_str());
-				}
-
-				// Can occur from virtual devices which have no path, instead use name
-				if(tempUrl.IsEmpty())
-				{
-					tempUrl = Name.bstrVal;
-				}
-
-				// Check Device URL
-				if(!tempUrl.Equals(Url))
-					continue;
-				
-				return true;
-				
-			}
-			VariantClear(&Name);
+		case 32:
+			return EMediaAudioSampleFormat::Float;
+		case 64:
+			return EMediaAudioSampleFormat::Double;
+		default:
+			return EMediaAudioSampleFormat::Undefined;
 		}
 	}
 
-	return false;
-}
-
-EMediaAudioSampleFormat GetAudioSampleFormatBits(const WAVEFORMATEX* wfex)
-{
 	switch (wfex->wBitsPerSample)
 	{
 	case 8:
@@ -508,7 +311,7 @@ EMediaAudioSampleFormat GetAudioSampleFormatBits(const WAVEFORMATEX* wfex)
 	case 16:
 		return EMediaAudioSampleFormat::Int16;
 	case 32:
-		return EMediaAudioSampleFormat::Float;
+		return EMediaAudioSampleFormat::Int32;
 		
 	default:
 		return EMediaAudioSampleFormat::Undefined;
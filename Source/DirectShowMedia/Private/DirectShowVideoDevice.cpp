@@ -6,11 +6,16 @@
 
 #include "DirectShowMedia.h"
 #include "DirectShowMediaCommon.h"
+#include "DirectShowDeviceTable.h"
+#include "DirectShowMediaFrameMetadata.h"
+#include "HAL/PlatformTime.h"
 
 #include "Windows/AllowWindowsPlatformTypes.h"
 #include "uuids.h"
+#include <dvdmedia.h>
 #include "Windows/HideWindowsPlatformTypes.h"
 #include "DirectShowCallbackHandler.h"
+#include "Player/DirectShowMediaAudioConverter.h"
 
 #define LOCTEXT_NAMESPACE "DirectShowMediaTracks"
 
@@ -24,13 +29,24 @@ FDirectShowVideoDevice::FDirectShowVideoDevice()
 	:bHasAudio(false),
 	CurrentSample(nullptr),
 	CurrentBuffer(nullptr),
+	SamplePitch(0),
+	SampleBufferCount(0),
 	CurrentFPS(0.f),
+	FormatSerial(0),
+	AudioBufferMs(20.f),
 	CurrentSubtype(MEDIASUBTYPE_None),
+	SampleSubtype(MEDIASUBTYPE_None),
+	PreferredSinkSubtype(MEDIASUBTYPE_ARGB32),
 	CurrentSelectedAudioTrack(INDEX_NONE),
 	CurrentSelectedCaptionTrack(INDEX_NONE),
 	CurrentSelectedMetadataTrack(INDEX_NONE),
 	CurrentSelectedVideoTrack(INDEX_NONE),
-	Demux(nullptr)
+	Demux(nullptr),
+	LastSideDataPollTime(0.0),
+	CachedExposure(0),
+	CachedGain(0),
+	bHasExposure(false),
+	bHasGain(false)
 {
 	// Filtername = (WCHAR*)FMemory::Malloc(MAX_DEVICE_NAME * sizeof(WCHAR));
 	// AudioFiltername = (WCHAR*)FMemory::Malloc(MAX_DEVICE_NAME * sizeof(WCHAR));
@@ -160,270 +176,108 @@ void FDirectShowVideoDevice::SetAudioBuffer(float delayMs)
 	}
 }
 
-bool FDirectShowVideoDevice::Initialize(const FString& Url, AM_MEDIA_TYPE* Format, AM_MEDIA_TYPE* AudioFormat)
+bool FDirectShowVideoDevice::RenegotiateAudioBuffer(float delayMs)
 {
-	HRESULT HResult;
-	VARIANT Name;
-	TComPtr<ICreateDevEnum> DevEnum;
-	TComPtr<IEnumMoniker> EnumMoniker;
-	TComPtr<IMoniker> Moniker;
-	TComPtr<IPropertyBag> PropertyBag;
-	bool DeviceFound = false;
+	if(!bIsInitialized || !bHasAudio || !Graph.IsValid() || !Control.IsValid() || !AudioSourcefilter.IsValid())
+		return false;
 
-	Stop();
-	bIsInitialized = false;
-	
-	Width = 0;
-	Height = 0;
-	CurrentSubtype = MEDIASUBTYPE_None;
-	CurrentFPS = 0;
+	TComPtr<IPin> SourcePin;
+	if(!GetPin(AudioSourcefilter, PINDIR_OUTPUT, &SourcePin))
+		return false;
 
-	if(!InitializeGraph())
-	{
+	TComPtr<IPin> ConnectedPin;
+	HRESULT HResult = SourcePin->ConnectedTo(&ConnectedPin);
+	if(FAILED(HResult))
 		return false;
-	}
-	
-	//create an enumerator for video input devices
-	HResult = CoCreateInstance(CLSID_SystemDeviceEnum, NULL, CLSCTX_INPROC_SERVER, IID_ICreateDevEnum, (void**)&DevEnum);
-	if (HResult < 0)
-	{
-		UE_LOG(LogDirectShowMedia, Error, TEXT("Failed to CoCreateInstance(CLSID_SystemDeviceEnum): %d"), HResult);
-		return false;;
-	}
 
-	if(!DevEnum.IsValid())
+	// allocator properties are only picked up when the pin connects, so reconnect it with the graph stopped
+	HResult = Control->Stop();
+	if(FAILED(HResult))
 	{
-		UE_LOG(LogDirectShowMedia, Warning, TEXT("Invalid DevEnum in FDirectShowVideoDevice::Initialize()"));
+		UE_LOG(LogDirectShowMedia, Error, TEXT("Audio!! Failed to stop the graph for buffer renegotiation: %d"), HResult);
 		return false;
 	}
 
-	HResult = DevEnum->CreateClassEnumerator(CLSID_VideoInputDeviceCategory, &EnumMoniker, NULL);
-	if (HResult < 0)
+	Graph->Disconnect(SourcePin);
+	Graph->Disconnect(ConnectedPin);
+
+	AudioBufferMs = delayMs;
+	SetAudioBuffer(AudioBufferMs);
+
+	const HRESULT ConnectResult = Graph->ConnectDirect(SourcePin, ConnectedPin, nullptr);
+	if(FAILED(ConnectResult))
 	{
-		UE_LOG(LogDirectShowMedia, Error, TEXT("Failed to DevEnum->CreateClassEnumerator(CLSID_VideoInputDeviceCategory): %d"), HResult);
-		return false;;
+		UE_LOG(LogDirectShowMedia, Error, TEXT("Audio!! Failed to reconnect audio source after buffer renegotiation: %d"), ConnectResult);
 	}
 
-	if(!EnumMoniker.IsValid())
+	HResult = Control->Run();
+	if(FAILED(HResult))
 	{
-		UE_LOG(LogDirectShowMedia, Warning, TEXT("Invalid EnumMoniker in FDirectShowVideoDevice::Initialize()"));
+		UE_LOG(LogDirectShowMedia, Error, TEXT("Failed to Control->Run() after buffer renegotiation %d"), HResult);
 		return false;
 	}
-	
-	while (EnumMoniker->Next(1, &Moniker, 0) == S_OK && !DeviceFound)
-	{
-		if(!Moniker.IsValid())
-		{
-			UE_LOG(LogDirectShowMedia, Warning, TEXT("Invalid Moniker in FDirectShowVideoDevice::Initialize()"));
-			return false;
-		}
-	
-		HResult = Moniker->BindToStorage(0, 0, IID_IPropertyBag, (void**)&PropertyBag);
-		if (HResult >= 0)
-		{
-			VariantInit(&Name);
 
-			//get the description
-			HResult = PropertyBag->Read(L"Description", &Name, 0);
-			if (HResult < 0)
-			{
-				HResult = PropertyBag->Read(L"FriendlyName", &Name, 0);
-			}
-
-			if (HResult >= 0)
-			{
-				//Initialize the VideoDevice struct
-				Friendlyname = Name.bstrVal;
-				
-				FString tempUrl = "";
-				HResult = PropertyBag->Read(L"DevicePath", &Name, 0);
-				if(HResult >= 0)
-				{
-					// Assuming the DevicePath is a BSTR (you may need to confirm this is the case for your specific device)
-					BSTR bstrDevicePath = Name.bstrVal;
-
-					// Convert BSTR to a wide string
-					std::wstring wideDevicePath(bstrDevicePath);
-
-					// Convert wide string to FString
-					tempUrl = FString(wideDevicePath.c_str());
-				}
-
-				// Can occur from virtual devices which have no path, instead use name
-				if(tempUrl.IsEmpty())
-				{
-					tempUrl = Name.bstrVal;
-				}
+	return SUCCEEDED(ConnectResult);
+}
 
-				// Check Device URL
-				if(!tempUrl.Equals(Url))
-					continue;
+bool FDirectShowVideoDevice::Initialize(const FString& Url, AM_MEDIA_TYPE* Format, AM_MEDIA_TYPE* AudioFormat)
+{
+	HRESULT HResult;
+	bool DeviceFound = false;
 
-				URL = Url; 
-				
-				//add a filter for the device
-				HResult = Graph->AddSourceFilterForMoniker(Moniker, 0, GetData(Friendlyname), &VideoSourcefilter);
-				if (HResult != S_OK)
-				{
-					UE_LOG(LogDirectShowMedia, Error, TEXT("Failed to Graph->AddSourceFilterForMoniker: %d"), HResult);
-					continue;
-				}
-				
-				//create a samplegrabber filter for the device
-				HResult = CoCreateInstance(CLSID_SampleGrabber, NULL, CLSCTX_INPROC_SERVER, IID_IBaseFilter, (void**)&VideoSamplegrabberfilter);
-				if (HResult < 0)
-				{
-					UE_LOG(LogDirectShowMedia, Error, TEXT("Failed to query samplegrabber from samplegrabberfilter: %d"), HResult);
-					continue;
-				}
-				
-				//set mediatype on the samplegrabber
-				HResult = VideoSamplegrabberfilter->QueryInterface(IID_ISampleGrabber, (void**)&VideoSamplegrabber);
-				if (HResult != S_OK)
-				{
-					UE_LOG(LogDirectShowMedia, Error, TEXT("Failed to query samplegrabber from samplegrabberfilter: %d"), HResult);
-					continue;
-				}
+	Stop();
+	bIsInitialized = false;
+	
+	Width = 0;
+	Height = 0;
+	SamplePitch = 0;
+	SampleBufferCount = 0;
+	CurrentSubtype = MEDIASUBTYPE_None;
+	SampleSubtype = MEDIASUBTYPE_None;
+	CurrentFPS = 0;
 
-				FString VideoSGName = Friendlyname + " SG";
-				Graph->AddFilter(VideoSamplegrabberfilter, GetData(VideoSGName));
+	OpenTimeline.SetLabel(Url);
+	FDirectShowGraphScopedStep OpenStep(OpenTimeline, TEXT("Open"));
 
-				//set the media type
-				DShowMediaType tempmt(*Format);
-				TComPtr<IPin> Pin;
-				if (GetPin(VideoSourcefilter, PINDIR_OUTPUT, MEDIATYPE_Video, PIN_CATEGORY_CAPTURE, &Pin))
-				{
-					TComPtr<IAMStreamConfig> StreamConfig;
-					HResult = Pin->QueryInterface(IID_IAMStreamConfig, (void**)&StreamConfig);
-					if (SUCCEEDED(HResult) && StreamConfig.IsValid())
-					{
-						//LogMediaType(tempmt);
-						HResult = StreamConfig->SetFormat(Format);
-						if(FAILED(HResult) && HResult != E_NOTIMPL)
-						{
-							UE_LOG(LogDirectShowMedia, Error, TEXT("Failed to set format format: %d"), HResult);
-							continue;
-						}
-					}
-				}
-				else
-				{
-					UE_LOG(LogDirectShowMedia, Error, TEXT("Failed to GetPin(Sourcefilter, PINDIR_OUTPUT, MEDIATYPE_Video, PIN_CATEGORY_CAPTURE, &Pin)"));
-					continue;
-				}
-				
-				if(tempmt->subtype == MEDIASUBTYPE_MJPG || tempmt->subtype == MEDIASUBTYPE_H264)
-				{
-					tempmt->subtype = MEDIASUBTYPE_ARGB32;
-				}
-				
-				HResult = VideoSamplegrabber->SetMediaType(tempmt);
-				if (HResult != S_OK)
-				{
-					UE_LOG(LogDirectShowMedia, Error, TEXT("Failed to set SetMediaType: %d"), HResult);
-					continue;
-				}
-				
-				// Setup demux Video Input Pin
-				if(Demux)
-				{
-					TComPtr<IMpeg2Demultiplexer> Demuxiplier;
-					HResult = Demux->QueryInterface(IID_IMpeg2Demultiplexer, (void**)&Demuxiplier);
-					if(HResult != S_OK)
-					{
-						UE_LOG(LogDirectShowMedia, Error, TEXT("Audio!! Failed to QueryInterface(IID_IMpeg2Demultiplexer) on audio demux"));
-						continue;
-					}
-					
-					TComPtr<IPin> pin;
-				
-					// use tempmt as its suited for output of decoders
-					VIDEOINFOHEADER *vih = reinterpret_cast<VIDEOINFOHEADER*>(tempmt->pbFormat);
-					VIDEOINFOHEADER *Formatvih = reinterpret_cast<VIDEOINFOHEADER*>(Format->pbFormat);
-					vih->bmiHeader.biSize = sizeof(vih->bmiHeader);
-					vih->bmiHeader.biWidth = Formatvih->bmiHeader.biWidth;
-					vih->bmiHeader.biHeight = Formatvih->bmiHeader.biHeight;
-					vih->bmiHeader.biCompression = Formatvih->bmiHeader.biCompression;
-					vih->rcSource.right = Formatvih->rcSource.right;
-					vih->rcSource.bottom = Formatvih->rcSource.bottom;
-					vih->AvgTimePerFrame = Formatvih->AvgTimePerFrame;
-
-					if (!vih->bmiHeader.biCompression)
-					{
-						UE_LOG(LogDirectShowMedia, Error, TEXT("Invalid video format when making demux Video INput pin"));
-						return false;
-					}
+	FDirectShowGraphScopedStep GraphStep(OpenTimeline, TEXT("InitializeGraph"));
+	if(!GraphStep.SetSucceeded(InitializeGraph()))
+	{
+		return false;
+	}
+	GraphStep.End();
+	
+	// the device table enumerated the devices already, and only walks them again if the url is new
+	FDirectShowGraphScopedStep ResolveStep(OpenTimeline, TEXT("ResolveDevice"));
+	FDirectShowDeviceId DeviceId;
+	if(!ResolveStep.SetSucceeded(FDirectShowDeviceTable::Get().Resolve(EDirectShowDeviceClass::Video, Url, DeviceId)))
+	{
+		UE_LOG(LogDirectShowMedia, Warning, TEXT("No video capture device found for %s in FDirectShowVideoDevice::Initialize()"), *Url);
+		return false;
+	}
+	ResolveStep.End();
 
-					tempmt->majortype = MEDIATYPE_Audio;
-					tempmt->subtype = Format->subtype;
-					tempmt->formattype = FORMAT_WaveFormatEx;
-					tempmt->bTemporalCompression = true;
-					
-					FString VideoDemuxName(DEMUX_VIDEO_PINNAME);
-					HResult = Demuxiplier->CreateOutputPin(Format, GetData(VideoDemuxName), &pin);
-					if(HResult != S_OK)
-					{
-						UE_LOG(LogDirectShowMedia, Error, TEXT("Failed to Demuxiplier->CreateOutputPin(tempmt, GetData(VideoDemuxName), &pin)"));
-						continue;
-					}
-				}
-				
-				// Setup Audio components 
-				if(bHasAudio && !AudioDeviceFriendlyName.IsEmpty())
-				{
-					bHasAudio = TryInitializeAudio(AudioDeviceFriendlyName, AudioFormat);
-				}
+	FDirectShowDeviceTable::Get().GetFriendlyName(DeviceId, Friendlyname);
+	URL = Url;
 
-				// setup video connections
-				if( Format->subtype == MEDIASUBTYPE_MJPG)
-					SetupMjpegDecompressorGraph();
-				else if( Format->subtype == MEDIASUBTYPE_H264)
-					SetupH264Graph();
-				else
-					ConnectVideoGraph();
-					
-				//add the callback to the sample grabber
-				HResult = VideoSamplegrabber->SetCallback(VideoCallbackhandler, 0);
-				if (HResult != S_OK)
-				{
-					UE_LOG(LogDirectShowMedia, Error, TEXT("Failed to set callback on samplegrabber: %d"), HResult);
-					continue;
-				}
-				
-				DeviceFound = true;
-				
-				//set the render path
-				// these can fail and everything will be fine if device was called to change format TODO: figure out why
-				HResult = Capture->RenderStream(&PIN_CATEGORY_CAPTURE, &MEDIATYPE_Video, VideoSourcefilter, NULL, VideoSamplegrabberfilter);
-				if (HResult < 0)
-				{
-					UE_LOG(LogDirectShowMedia, Error, TEXT("Failed to call Capture->RenderStream: %d"), HResult)
-					//continue;
-				}
-				if(bHasAudio)
-				{
-					HResult = Capture->RenderStream(&PIN_CATEGORY_CAPTURE, &MEDIATYPE_Audio, AudioSourcefilter, NULL, AudioSamplegrabberfilter);
-					if (HResult < 0)
-					{
-						UE_LOG(LogDirectShowMedia, Error, TEXT("Audio!! Failed to call Capture->RenderStream: %d"), HResult)
-						//continue;
-					}
-				}
-				
-			}
-			VariantClear(&Name);
-		}
-	}
+	DeviceFound = ConnectVideoSource(DeviceId, Format, AudioFormat);
 
 	if(DeviceFound)
 	{
-		HResult = Control->Run();
+		FDirectShowGraphScopedStep StartStep(OpenTimeline, TEXT("Start"));
+		HResult = StartStep.SetResult(Control->Run());
 		if (HResult != S_OK)
 		{
 			UE_LOG(LogTemp, Error, TEXT("Failed to Control->Run() %d"), HResult);
 		}
+		StartStep.End();
 		
 		bIsInitialized = true;
+
+		// side data for the metadata track, most webcams have the first two, capture cards with timecode the last
+		VideoSourcefilter->QueryInterface(IID_IAMCameraControl, (void**)&CameraControl);
+		VideoSourcefilter->QueryInterface(IID_IAMVideoProcAmp, (void**)&VideoProcAmp);
+		VideoSourcefilter->QueryInterface(IID_IAMTimecodeReader, (void**)&TimecodeReader);
+		LastSideDataPollTime = 0.0;
 		
 		// look up the media type:
 		TComPtr<IPin> Pin;
@@ -442,7 +296,39 @@ bool FDirectShowVideoDevice::Initialize(const FString& Url, AM_MEDIA_TYPE* Forma
 					Height = VideoInfo->bmiHeader.biHeight;
 					CurrentFPS = 1.0 / (VideoInfo->AvgTimePerFrame * 1.0e-7);
 				}
+				else if (cmt->formattype == FORMAT_VideoInfo2)
+				{
+					const VIDEOINFOHEADER2 * VideoInfo = reinterpret_cast<VIDEOINFOHEADER2*>(cmt->pbFormat);
+					Width = VideoInfo->bmiHeader.biWidth;
+					Height = VideoInfo->bmiHeader.biHeight;
+					CurrentFPS = 1.0 / (VideoInfo->AvgTimePerFrame * 1.0e-7);
+				}
 				CurrentSubtype = cmt->subtype;
+				SampleSubtype = cmt->subtype;
+				UpdateColorimetry(Pin, *cmt);
+
+				// the sample buffers are laid out as the sample grabber is connected, and compressed formats
+				// reach the callback as whatever the decoder was negotiated to
+				DShowMediaType GrabberType;
+				if(VideoSamplegrabber && SUCCEEDED(VideoSamplegrabber->GetConnectedMediaType(GrabberType)))
+				{
+					UpdateSamplePitch(*GrabberType);
+
+					if(DecompressorFilter)
+					{
+						SampleSubtype = GrabberType->subtype;
+						UE_LOG(LogDirectShowMedia, Log, TEXT("Decoding %s to %s"), *GetFormatTypeFromGUID(CurrentSubtype), *GetFormatTypeFromGUID(SampleSubtype));
+					}
+				}
+				else
+				{
+					UpdateSamplePitch(*cmt);
+				}
+
+				UpdateSampleBufferCount();
+
+				// publish the new format to the sample callback
+				++FormatSerial;
 			}
 			else
 			{
@@ -490,179 +376,308 @@ bool FDirectShowVideoDevice::Initialize(const FString& Url, AM_MEDIA_TYPE* Forma
 		this->Stop();
 	}
 
+	OpenStep.SetSucceeded(DeviceFound);
+
 	return DeviceFound;
 }
 
-bool FDirectShowVideoDevice::TryInitializeAudio(const FString& InFriendlyName, AM_MEDIA_TYPE* Format)
+bool FDirectShowVideoDevice::TryInitializeAudio(const FDirectShowDeviceId& InDeviceId, AM_MEDIA_TYPE* Format)
 {
 	HRESULT HResult;
-	VARIANT Name;
-	TComPtr<ICreateDevEnum> DevEnum;
-	TComPtr<IEnumMoniker> EnumMoniker;
-	TComPtr<IMoniker> Moniker;
-	TComPtr<IPropertyBag> PropertyBag;
-	bool DeviceFound = false;
+	FDirectShowDeviceTable& DeviceTable = FDirectShowDeviceTable::Get();
+
+	if (!DeviceTable.GetFriendlyName(InDeviceId, AudioDeviceFriendlyName))
+	{
+		UE_LOG(LogDirectShowMedia, Error, TEXT("Audio!! Unknown audio device in TryInitializeAudio()"));
+		return false;
+	}
+
+	//add a filter for the device
+	if (!DeviceTable.BindFilter(InDeviceId, &AudioSourcefilter))
+	{
+		UE_LOG(LogDirectShowMedia, Error, TEXT("Audio!! Failed to bind the source filter of %s"), *AudioDeviceFriendlyName);
+		return false;
+	}
+
+	HResult = Graph->AddFilter(AudioSourcefilter, GetData(AudioDeviceFriendlyName));
+	if (HResult != S_OK)
+	{
+		UE_LOG(LogDirectShowMedia, Error, TEXT("Audio!! Failed to Graph->AddFilter(AudioSourcefilter): %d"), HResult);
+		return false;
+	}
 	
-	//create an enumerator for video input devices
-	HResult = CoCreateInstance(CLSID_SystemDeviceEnum, NULL, CLSCTX_INPROC_SERVER, IID_ICreateDevEnum, (void**)&DevEnum);
+	//create a samplegrabber filter for the device
+	HResult = CoCreateInstance(CLSID_SampleGrabber, NULL, CLSCTX_INPROC_SERVER, IID_IBaseFilter, (void**)&AudioSamplegrabberfilter);
 	if (HResult < 0)
 	{
-		UE_LOG(LogDirectShowMedia, Error, TEXT("Audio!! Failed to CoCreateInstance(CLSID_SystemDeviceEnum): %d"), HResult);
-		return false;;
-	}	
+		return false;
+	}
 
-	HResult = DevEnum->CreateClassEnumerator(CLSID_AudioInputDeviceCategory, &EnumMoniker, NULL);
-	if (HResult < 0)
+	//set mediatype on the samplegrabber
+	HResult = AudioSamplegrabberfilter->QueryInterface(IID_ISampleGrabber, (void**)&AudioSamplegrabber);
+	if (HResult != S_OK)
 	{
-		UE_LOG(LogDirectShowMedia, Error, TEXT("Audio!! Failed to DevEnum->CreateClassEnumerator(CLSID_AudioInputDeviceCategory): %d"), HResult);
-		return false;;
+		return false;
 	}
+
+	FString AudioSGName = AudioDeviceFriendlyName + " SG";
+	Graph->AddFilter(AudioSamplegrabberfilter, GetData(AudioSGName));
 	
-	while (EnumMoniker->Next(1, &Moniker, 0) == S_OK && !DeviceFound)
+	//set the media type
+	if(Format)
 	{
-		HResult = Moniker->BindToStorage(0, 0, IID_IPropertyBag, (void**)&PropertyBag);
-		if (HResult >= 0)
+		TComPtr<IPin> Pin;
+		if (GetPin(AudioSourcefilter, PINDIR_OUTPUT, &Pin))
 		{
-			VariantInit(&Name);
-
-			//get the description
-			HResult = PropertyBag->Read(L"Description", &Name, 0);
-			if (HResult < 0)
+			TComPtr<IAMStreamConfig> StreamConfig;
+			HResult = Pin->QueryInterface(IID_IAMStreamConfig, (void**)&StreamConfig);
+			if (SUCCEEDED(HResult) && StreamConfig.IsValid())
 			{
-				HResult = PropertyBag->Read(L"FriendlyName", &Name, 0);
-			}
-
-			if (HResult >= 0)
-			{
-				//Initialize the VideoDevice struct
-				FString strFriendlyName = Name.bstrVal;
-				if(!strFriendlyName.Contains(InFriendlyName, ESearchCase::IgnoreCase))
-					continue;
-				
-				AudioDeviceFriendlyName = strFriendlyName;
-
-				DeviceFound = true;
-				
-				//add a filter for the device
-				HResult = Graph->AddSourceFilterForMoniker(Moniker, 0, GetData(AudioDeviceFriendlyName), &AudioSourcefilter);
-				if (HResult != S_OK)
+				HResult = StreamConfig->SetFormat(Format);
+				if(FAILED(HResult) && HResult != E_NOTIMPL)
 				{
-					continue;
-				}
-				
-				//create a samplegrabber filter for the device
-				HResult = CoCreateInstance(CLSID_SampleGrabber, NULL, CLSCTX_INPROC_SERVER, IID_IBaseFilter, (void**)&AudioSamplegrabberfilter);
-				if (HResult < 0)
-				{
-					continue;
+					UE_LOG(LogDirectShowMedia, Error, TEXT("Audio!! Failed to set format format: %d"), HResult);
+					return false;
 				}
+			}
+		}
+		else
+		{
+			UE_LOG(LogDirectShowMedia, Error, TEXT("Audio!! Failed to GetPin(Sourcefilter, PINDIR_OUTPUT, MEDIATYPE_Video, PIN_CATEGORY_CAPTURE, &Pin)"));
+			return false;
+		}
+	}
 
-				//set mediatype on the samplegrabber
-				HResult = AudioSamplegrabberfilter->QueryInterface(IID_ISampleGrabber, (void**)&AudioSamplegrabber);
-				if (HResult != S_OK)
-				{
-					continue;
-				}
+	// Fix audio delay through custom bufffer size
+	SetAudioBuffer(AudioBufferMs);
+	
+	//Samplegrabber->SetBufferSamples(true);
 
-				FString AudioSGName = AudioDeviceFriendlyName + " SG";
-				Graph->AddFilter(AudioSamplegrabberfilter, GetData(AudioSGName));
-				
-				//set the media type
-				if(Format)
-				{
-					TComPtr<IPin> Pin;
-					if (GetPin(AudioSourcefilter, PINDIR_OUTPUT, &Pin))
-					{
-						TComPtr<IAMStreamConfig> StreamConfig;
-						HResult = Pin->QueryInterface(IID_IAMStreamConfig, (void**)&StreamConfig);
-						if (SUCCEEDED(HResult) && StreamConfig.IsValid())
-						{
-							HResult = StreamConfig->SetFormat(Format);
-							if(FAILED(HResult) && HResult != E_NOTIMPL)
-							{
-								UE_LOG(LogDirectShowMedia, Error, TEXT("Audio!! Failed to set format format: %d"), HResult);
-								continue;
-							}
-						}
-					}
-					else
-					{
-						UE_LOG(LogDirectShowMedia, Error, TEXT("Audio!! Failed to GetPin(Sourcefilter, PINDIR_OUTPUT, MEDIATYPE_Video, PIN_CATEGORY_CAPTURE, &Pin)"));
-						continue;
-					}
-				}
+	//add the callback to the sample grabber
+	HResult = AudioSamplegrabber->SetCallback(AudioCallbackhandler, 0);
+	if (HResult != S_OK)
+	{
+		return false;
+	}
 
-				// Fix audio delay through custom bufffer size
-				SetAudioBuffer(20);
-				
-				//Samplegrabber->SetBufferSamples(true);
+	// Setup demux Audio Input Pin
+	if(Demux)
+	{
+		TComPtr<IMpeg2Demultiplexer> Demuxiplier;
+		HResult = Demux->QueryInterface(IID_IMpeg2Demultiplexer, (void**)&Demuxiplier);
+		if(HResult != S_OK)
+		{
+			UE_LOG(LogDirectShowMedia, Error, TEXT("Audio!! Failed to QueryInterface(IID_IMpeg2Demultiplexer) on audio demux"));
+			return false;
+		}
+		
+		TComPtr<IPin> pin;
+	
+		// use tempmt as its suited for output of decoders
+		DShowMediaType tempmt(*Format);
+		WAVEFORMATEX *wfex = reinterpret_cast<WAVEFORMATEX*>(tempmt->pbFormat);
+		WAVEFORMATEX *Formatwfex = reinterpret_cast<WAVEFORMATEX*>(Format->pbFormat);
+		wfex->wFormatTag = Formatwfex->wFormatTag;
+		wfex->nChannels = 2;
+		wfex->nSamplesPerSec = Formatwfex->nSamplesPerSec;
+		wfex->wBitsPerSample = 16;
+
+		if (!wfex->wFormatTag)
+		{
+			UE_LOG(LogDirectShowMedia, Error, TEXT("CreateDemuxAudioPin: Invalid audio format"));
+			return false;
+		}
 
-				//add the callback to the sample grabber
-				HResult = AudioSamplegrabber->SetCallback(AudioCallbackhandler, 0);
-				if (HResult != S_OK)
-				{
-					continue;
-				}
+		tempmt->majortype = MEDIATYPE_Audio;
+		tempmt->subtype = Format->subtype;
+		tempmt->formattype = FORMAT_WaveFormatEx;
+		tempmt->bTemporalCompression = true;
+		
+		FString AudioDemuxName(DEMUX_AUDIO_PINNAME);
 
-				// Setup demux Audio Input Pin
-				if(Demux)
-				{
-					TComPtr<IMpeg2Demultiplexer> Demuxiplier;
-					HResult = Demux->QueryInterface(IID_IMpeg2Demultiplexer, (void**)&Demuxiplier);
-					if(HResult != S_OK)
-					{
-						UE_LOG(LogDirectShowMedia, Error, TEXT("Audio!! Failed to QueryInterface(IID_IMpeg2Demultiplexer) on audio demux"));
-						continue;
-					}
-					
-					TComPtr<IPin> pin;
-				
-					// use tempmt as its suited for output of decoders
-					DShowMediaType tempmt(*Format);
-					WAVEFORMATEX *wfex = reinterpret_cast<WAVEFORMATEX*>(tempmt->pbFormat);
-					WAVEFORMATEX *Formatwfex = reinterpret_cast<WAVEFORMATEX*>(Format->pbFormat);
-					wfex->wFormatTag = Formatwfex->wFormatTag;
-					wfex->nChannels = 2;
-					wfex->nSamplesPerSec = Formatwfex->nSamplesPerSec;
-					wfex->wBitsPerSample = 16;
-
-					if (!wfex->wFormatTag)
-					{
-						UE_LOG(LogDirectShowMedia, Error, TEXT("CreateDemuxAudioPin: Invalid audio format"));
-						return false;
-					}
+		//UE_LOG(LogDirectShowMedia, Log, TEXT("\n\n	Audio!! Creating Audio Demux Pin... Format:\n"));
+		//LogAudioMediaType(*Format);
+		HResult = Demuxiplier->CreateOutputPin(Format, GetData(AudioDemuxName), &pin);
+		if(HResult != S_OK)
+		{
+			UE_LOG(LogDirectShowMedia, Error, TEXT("Audio!! Failed to Demuxiplier->CreateOutputPin(tempmt, GetData(AudioDemuxName), &pin): %d"), HResult);
+			return false;
+		}
+	}
+	ConnectAudioGraph();
 
-					tempmt->majortype = MEDIATYPE_Audio;
-					tempmt->subtype = Format->subtype;
-					tempmt->formattype = FORMAT_WaveFormatEx;
-					tempmt->bTemporalCompression = true;
-					
-					FString AudioDemuxName(DEMUX_AUDIO_PINNAME);
+	return true;
+}
 
-					//UE_LOG(LogDirectShowMedia, Log, TEXT("\n\n	Audio!! Creating Audio Demux Pin... Format:\n"));
-					//LogAudioMediaType(*Format);
-					HResult = Demuxiplier->CreateOutputPin(Format, GetData(AudioDemuxName), &pin);
-					if(HResult != S_OK)
-					{
-						UE_LOG(LogDirectShowMedia, Error, TEXT("Audio!! Failed to Demuxiplier->CreateOutputPin(tempmt, GetData(AudioDemuxName), &pin): %d"), HResult);
-						continue;
-					}
-				}
-				ConnectAudioGraph();
-				
-				//set the render path
-				// HResult = Capture->RenderStream(&PIN_CATEGORY_CAPTURE, &MEDIATYPE_Audio, AudioSourcefilter, NULL, AudioSamplegrabberfilter);
-				// if (HResult < 0)
-				// {
-				// 	UE_LOG(LogDirectShowMedia, Error, TEXT("Audio!! Failed to call Capture->RenderStream: %d"), HResult)
-				// 	continue;
-				// }
+
+bool FDirectShowVideoDevice::ConnectVideoSource(const FDirectShowDeviceId& DeviceId, AM_MEDIA_TYPE* Format, AM_MEDIA_TYPE* AudioFormat)
+{
+	HRESULT HResult;
+
+	//add a filter for the device, bound from the moniker the device table keeps
+	FDirectShowGraphScopedStep BindStep(OpenTimeline, TEXT("BindDevice"));
+	if (!BindStep.SetSucceeded(FDirectShowDeviceTable::Get().BindFilter(DeviceId, &VideoSourcefilter)))
+	{
+		UE_LOG(LogDirectShowMedia, Error, TEXT("Failed to bind the source filter of %s"), *Friendlyname);
+		return false;
+	}
+
+	HResult = BindStep.SetResult(Graph->AddFilter(VideoSourcefilter, GetData(Friendlyname)));
+	if (HResult != S_OK)
+	{
+		UE_LOG(LogDirectShowMedia, Error, TEXT("Failed to Graph->AddFilter(VideoSourcefilter): %d"), HResult);
+		return false;
+	}
+	BindStep.End();
+	
+	//create a samplegrabber filter for the device
+	FDirectShowGraphScopedStep GrabberStep(OpenTimeline, TEXT("AddSampleGrabber"));
+	HResult = GrabberStep.SetResult(CoCreateInstance(CLSID_SampleGrabber, NULL, CLSCTX_INPROC_SERVER, IID_IBaseFilter, (void**)&VideoSamplegrabberfilter));
+	if (HResult < 0)
+	{
+		UE_LOG(LogDirectShowMedia, Error, TEXT("Failed to query samplegrabber from samplegrabberfilter: %d"), HResult);
+		return false;
+	}
+	
+	//set mediatype on the samplegrabber
+	HResult = GrabberStep.SetResult(VideoSamplegrabberfilter->QueryInterface(IID_ISampleGrabber, (void**)&VideoSamplegrabber));
+	if (HResult != S_OK)
+	{
+		UE_LOG(LogDirectShowMedia, Error, TEXT("Failed to query samplegrabber from samplegrabberfilter: %d"), HResult);
+		return false;
+	}
+
+	FString VideoSGName = Friendlyname + " SG";
+	GrabberStep.SetResult(Graph->AddFilter(VideoSamplegrabberfilter, GetData(VideoSGName)));
+	GrabberStep.End();
+
+	//set the media type
+	FDirectShowGraphScopedStep FormatStep(OpenTimeline, TEXT("SetFormat"));
+	DShowMediaType tempmt(*Format);
+	TComPtr<IPin> Pin;
+	if (GetPin(VideoSourcefilter, PINDIR_OUTPUT, MEDIATYPE_Video, PIN_CATEGORY_CAPTURE, &Pin))
+	{
+		TComPtr<IAMStreamConfig> StreamConfig;
+		HResult = Pin->QueryInterface(IID_IAMStreamConfig, (void**)&StreamConfig);
+		if (SUCCEEDED(HResult) && StreamConfig.IsValid())
+		{
+			//LogMediaType(tempmt);
+			HResult = FormatStep.SetResult(StreamConfig->SetFormat(Format));
+			if(!FormatStep.SetSucceeded(SUCCEEDED(HResult) || HResult == E_NOTIMPL))
+			{
+				UE_LOG(LogDirectShowMedia, Error, TEXT("Failed to set format format: %d"), HResult);
+				return false;
 			}
-			VariantClear(&Name);
 		}
 	}
+	else
+	{
+		UE_LOG(LogDirectShowMedia, Error, TEXT("Failed to GetPin(Sourcefilter, PINDIR_OUTPUT, MEDIATYPE_Video, PIN_CATEGORY_CAPTURE, &Pin)"));
+		return false;
+	}
+	
+	if(tempmt->subtype == MEDIASUBTYPE_MJPG || tempmt->subtype == MEDIASUBTYPE_H264)
+	{
+		tempmt->subtype = MEDIASUBTYPE_ARGB32;
+	}
+	
+	HResult = FormatStep.SetResult(VideoSamplegrabber->SetMediaType(tempmt));
+	if (HResult != S_OK)
+	{
+		UE_LOG(LogDirectShowMedia, Error, TEXT("Failed to set SetMediaType: %d"), HResult);
+		return false;
+	}
+	FormatStep.End();
+	
+	// Setup demux Video Input Pin
+	if(Demux)
+	{
+		TComPtr<IMpeg2Demultiplexer> Demuxiplier;
+		HResult = Demux->QueryInterface(IID_IMpeg2Demultiplexer, (void**)&Demuxiplier);
+		if(HResult != S_OK)
+		{
+			UE_LOG(LogDirectShowMedia, Error, TEXT("Audio!! Failed to QueryInterface(IID_IMpeg2Demultiplexer) on audio demux"));
+			return false;
+		}
+		
+		TComPtr<IPin> pin;
+	
+		// use tempmt as its suited for output of decoders
+		VIDEOINFOHEADER *vih = reinterpret_cast<VIDEOINFOHEADER*>(tempmt->pbFormat);
+		VIDEOINFOHEADER *Formatvih = reinterpret_cast<VIDEOINFOHEADER*>(Format->pbFormat);
+		vih->bmiHeader.biSize = sizeof(vih->bmiHeader);
+		vih->bmiHeader.biWidth = Formatvih->bmiHeader.biWidth;
+		vih->bmiHeader.biHeight = Formatvih->bmiHeader.biHeight;
+		vih->bmiHeader.biCompression = Formatvih->bmiHeader.biCompression;
+		vih->rcSource.right = Formatvih->rcSource.right;
+		vih->rcSource.bottom = Formatvih->rcSource.bottom;
+		vih->AvgTimePerFrame = Formatvih->AvgTimePerFrame;
+
+		if (!vih->bmiHeader.biCompression)
+		{
+			UE_LOG(LogDirectShowMedia, Error, TEXT("Invalid video format when making demux Video INput pin"));
+			return false;
+		}
 
-	return DeviceFound;
+		tempmt->majortype = MEDIATYPE_Audio;
+		tempmt->subtype = Format->subtype;
+		tempmt->formattype = FORMAT_WaveFormatEx;
+		tempmt->bTemporalCompression = true;
+		
+		FString VideoDemuxName(DEMUX_VIDEO_PINNAME);
+		HResult = Demuxiplier->CreateOutputPin(Format, GetData(VideoDemuxName), &pin);
+		if(HResult != S_OK)
+		{
+			UE_LOG(LogDirectShowMedia, Error, TEXT("Failed to Demuxiplier->CreateOutputPin(tempmt, GetData(VideoDemuxName), &pin)"));
+			return false;
+		}
+	}
+	
+	// Setup Audio components 
+	if(bHasAudio && AudioDeviceId.IsValid())
+	{
+		FDirectShowGraphScopedStep AudioStep(OpenTimeline, TEXT("InitializeAudio"));
+		bHasAudio = AudioStep.SetSucceeded(TryInitializeAudio(AudioDeviceId, AudioFormat));
+	}
+
+	// setup video connections
+	if( Format->subtype == MEDIASUBTYPE_MJPG)
+		SetupMjpegDecompressorGraph();
+	else if( Format->subtype == MEDIASUBTYPE_H264)
+		SetupH264Graph();
+	else
+		ConnectVideoGraph();
+		
+	//add the callback to the sample grabber
+	HResult = VideoSamplegrabber->SetCallback(VideoCallbackhandler, 0);
+	if (HResult != S_OK)
+	{
+		UE_LOG(LogDirectShowMedia, Error, TEXT("Failed to set callback on samplegrabber: %d"), HResult);
+		return false;
+	}
+	
+	//set the render path
+	// these can fail and everything will be fine if device was called to change format TODO: figure out why
+	FDirectShowGraphScopedStep RenderStep(OpenTimeline, TEXT("RenderVideoStream"));
+	HResult = RenderStep.SetResult(Capture->RenderStream(&PIN_CATEGORY_CAPTURE, &MEDIATYPE_Video, VideoSourcefilter, NULL, VideoSamplegrabberfilter));
+	if (HResult < 0)
+	{
+		UE_LOG(LogDirectShowMedia, Error, TEXT("Failed to call Capture->RenderStream: %d"), HResult)
+		//continue;
+	}
+	RenderStep.End();
+	if(bHasAudio)
+	{
+		FDirectShowGraphScopedStep AudioRenderStep(OpenTimeline, TEXT("RenderAudioStream"));
+		HResult = AudioRenderStep.SetResult(Capture->RenderStream(&PIN_CATEGORY_CAPTURE, &MEDIATYPE_Audio, AudioSourcefilter, NULL, AudioSamplegrabberfilter));
+		if (HResult < 0)
+		{
+			UE_LOG(LogDirectShowMedia, Error, TEXT("Audio!! Failed to call Capture->RenderStream: %d"), HResult)
+			//continue;
+		}
+	}
+
+	return true;
 }
 
 
@@ -854,44 +869,58 @@ void FDirectShowVideoDevice::FillAudioFormatData(IPin* SourcePin)
 
 void FDirectShowVideoDevice::FillFormatDataFromURL(const FString& Url, const FString& OptionalAudioDeviceName)
 {
+	FDirectShowDeviceTable& DeviceTable = FDirectShowDeviceTable::Get();
+
+	// resolve the devices once, everything below binds them directly
+	FDirectShowDeviceId VideoDeviceId;
+	TComPtr<IBaseFilter> sourceFilter;
 	TComPtr<IPin> sourcePin;
-	if(GetPin(Url, CLSID_VideoInputDeviceCategory,MEDIATYPE_Video,PINDIR_OUTPUT, &sourcePin))
+	if(DeviceTable.Resolve(EDirectShowDeviceClass::Video, Url, VideoDeviceId) && DeviceTable.BindFilter(VideoDeviceId, &sourceFilter)
+		&& GetPin(sourceFilter, PINDIR_OUTPUT, MEDIATYPE_Video, PIN_CATEGORY_CAPTURE, &sourcePin))
 	{
 		FillVideoFormatData(sourcePin);
 	}
+
+	FDirectShowDeviceId FoundAudioDeviceId;
 	if(!OptionalAudioDeviceName.IsEmpty() && !OptionalAudioDeviceName.Equals("Auto"))
 	{
 		if(OptionalAudioDeviceName.Equals("None"))
 		{
 			bHasAudio = false;
 			AudioDeviceFriendlyName = "";
+			AudioDeviceId = FDirectShowDeviceId();
 			return;
 		}
 		
-		if(TryGetAudioPinByFriendlyName(*OptionalAudioDeviceName, &sourcePin))
-		{
-			FillAudioFormatData(sourcePin);
-			AudioDeviceFriendlyName = OptionalAudioDeviceName;
-			bHasAudio = true;
-		}
-		else
+		if(!DeviceTable.Resolve(EDirectShowDeviceClass::Audio, OptionalAudioDeviceName, FoundAudioDeviceId))
 		{
 			UE_LOG(LogDirectShowMedia, Error, TEXT("Failed to fill AUdio format data for device: %s"), *OptionalAudioDeviceName)
+			return;
 		}
 	}
 	else
 	{
-		// try find device by video's friendlyname
-		FString videoDeviceName;
-		if(!GetDeviceFriendlyName(Url, CLSID_VideoInputDeviceCategory, videoDeviceName))
+		// try find the audio device that belongs to the video device
+		if(!VideoDeviceId.IsValid() || !DeviceTable.FindAudioDevice(VideoDeviceId, FoundAudioDeviceId))
 			return;
+	}
 
-		if(TryGetAudioPinByFriendlyName(videoDeviceName, &sourcePin))
-		{
-			FillAudioFormatData(sourcePin);
-			AudioDeviceFriendlyName = videoDeviceName;
-			bHasAudio = true;
-		}
+	// the device's own name for display, the graph binds the device by its identity
+	FString audioDeviceName;
+	DeviceTable.GetFriendlyName(FoundAudioDeviceId, audioDeviceName);
+
+	TComPtr<IBaseFilter> audioFilter;
+	TComPtr<IPin> audioPin;
+	if(DeviceTable.BindFilter(FoundAudioDeviceId, &audioFilter) && GetPin(audioFilter, PINDIR_OUTPUT, MEDIATYPE_Audio, PIN_CATEGORY_CAPTURE, &audioPin))
+	{
+		FillAudioFormatData(audioPin);
+		AudioDeviceFriendlyName = audioDeviceName;
+		AudioDeviceId = FoundAudioDeviceId;
+		bHasAudio = true;
+	}
+	else
+	{
+		UE_LOG(LogDirectShowMedia, Error, TEXT("Failed to fill AUdio format data for device: %s"), *audioDeviceName)
 	}
 }
 
@@ -971,7 +1000,8 @@ bool FDirectShowVideoDevice::TrySetupAudioTrack(FDShowTrack& Track, AM_MEDIA_TYP
 	if(TypeName.Equals("Possibly Unsupported Format"))
 		return false;
 
-	if(GetAudioSampleFormatBits(wfex) != EMediaAudioSampleFormat::Int16)
+	// anything the audio converter can turn into float is fine
+	if(!FDirectShowMediaAudioConverter::IsSupportedFormat(GetAudioSampleFormatBits(wfex), wfex->wBitsPerSample))
 		return false;
 					
 	// Create new index
@@ -1027,7 +1057,7 @@ bool FDirectShowVideoDevice::SetFormatInfo(const FString& Url, const FDShowForma
 			AudioFormat = AudioTracks[0].Formats[0];
 		}
 
-		if(!GetAudioFormatFromInfo(AudioDeviceFriendlyName, AudioFormat, Audiopmt))
+		if(!GetAudioFormatFromInfo(AudioDeviceId, AudioFormat, Audiopmt))
 		{
 			UE_LOG(LogDirectShowMedia, Error, TEXT("SetFormatInfo failed when getting Audio format"))
 			return false;
@@ -1111,12 +1141,13 @@ bool FDirectShowVideoDevice::GetVideoFormatFromInfo(const FString& Url, const FD
 	return false;
 }
 
-bool FDirectShowVideoDevice::GetAudioFormatFromInfo(const FString& FriendlyName, const FDShowFormat& FormatInfo, AM_MEDIA_TYPE* MediaType)
+bool FDirectShowVideoDevice::GetAudioFormatFromInfo(const FDirectShowDeviceId& InDeviceId, const FDShowFormat& FormatInfo, AM_MEDIA_TYPE* MediaType)
 {
 	DShowMediaTypePtr pmt;
+	TComPtr<IBaseFilter> Filter;
 	TComPtr<IPin> Pin;
 	
-	if (TryGetAudioPinByFriendlyName(FriendlyName, &Pin))
+	if (FDirectShowDeviceTable::Get().BindFilter(InDeviceId, &Filter) && GetPin(Filter, PINDIR_OUTPUT, MEDIATYPE_Audio, PIN_CATEGORY_CAPTURE, &Pin))
 	{
 		TComPtr<IAMStreamConfig> StreamConfig;
 		HRESULT hr = Pin->QueryInterface(IID_IAMStreamConfig, (void**)&StreamConfig);
@@ -1208,9 +1239,110 @@ bool FDirectShowVideoDevice::IsFormatValid(const FDShowFormat& FormatInfo, AM_ME
 	return true;
 }
 
+void FDirectShowVideoDevice::UpdateColorimetry(IPin* Pin, const AM_MEDIA_TYPE& ConnectionType)
+{
+	Colorimetry = FDirectShowMediaColorimetry::GetDefault(FMath::Abs(Height));
+
+	// the colorimetry lives in the extended format flags of VIDEOINFOHEADER2 (laid out like DXVA_ExtendedFormat)
+	auto ReadColorInfo = [this](const AM_MEDIA_TYPE& MediaType) -> bool
+	{
+		if (MediaType.formattype != FORMAT_VideoInfo2 || MediaType.pbFormat == nullptr || MediaType.cbFormat < sizeof(VIDEOINFOHEADER2))
+			return false;
+
+		const VIDEOINFOHEADER2* VideoInfo = reinterpret_cast<const VIDEOINFOHEADER2*>(MediaType.pbFormat);
+		return Colorimetry.ApplyControlFlags(VideoInfo->dwControlFlags);
+	};
+
+	// connected through a plain VIDEOINFOHEADER, look for the extended variant of the same format
+	TComPtr<IEnumMediaTypes> MediaTypes;
+	if (!ReadColorInfo(ConnectionType) && Pin != nullptr && SUCCEEDED(Pin->EnumMediaTypes(&MediaTypes)))
+	{
+		DShowMediaTypePtr pmt;
+		ULONG count = 0;
+		while (MediaTypes->Next(1, pmt, &count) == S_OK)
+		{
+			if (pmt.IsValid() && pmt->subtype == ConnectionType.subtype && pmt->formattype == FORMAT_VideoInfo2 && pmt->cbFormat >= sizeof(VIDEOINFOHEADER2))
+			{
+				const VIDEOINFOHEADER2* VideoInfo = reinterpret_cast<const VIDEOINFOHEADER2*>(pmt->pbFormat);
+				if (VideoInfo->bmiHeader.biWidth == Width && FMath::Abs(VideoInfo->bmiHeader.biHeight) == FMath::Abs(Height) && ReadColorInfo(*pmt))
+					break;
+			}
+		}
+	}
+
+	UE_LOG(LogDirectShowMedia, Verbose, TEXT("Video colorimetry: %s"), *Colorimetry.ToString());
+}
+
+void FDirectShowVideoDevice::UpdateSamplePitch(const AM_MEDIA_TYPE& SampleType)
+{
+	SamplePitch = Width;
+
+	const BITMAPINFOHEADER* BitmapInfo = nullptr;
+	const RECT* TargetRect = nullptr;
+
+	if (SampleType.formattype == FORMAT_VideoInfo && SampleType.pbFormat != nullptr && SampleType.cbFormat >= sizeof(VIDEOINFOHEADER))
+	{
+		const VIDEOINFOHEADER* VideoInfo = reinterpret_cast<const VIDEOINFOHEADER*>(SampleType.pbFormat);
+		BitmapInfo = &VideoInfo->bmiHeader;
+		TargetRect = &VideoInfo->rcTarget;
+	}
+	else if (SampleType.formattype == FORMAT_VideoInfo2 && SampleType.pbFormat != nullptr && SampleType.cbFormat >= sizeof(VIDEOINFOHEADER2))
+	{
+		const VIDEOINFOHEADER2* VideoInfo = reinterpret_cast<const VIDEOINFOHEADER2*>(SampleType.pbFormat);
+		BitmapInfo = &VideoInfo->bmiHeader;
+		TargetRect = &VideoInfo->rcTarget;
+	}
+
+	if (BitmapInfo == nullptr || BitmapInfo->biWidth <= 0)
+		return;
+
+	// biWidth is the pitch of the buffer rows (in pixels); a driver that pads them puts the image in rcTarget
+	const int32 TargetWidth = TargetRect->right - TargetRect->left;
+	const int32 TargetHeight = TargetRect->bottom - TargetRect->top;
+
+	if (TargetRect->left == 0 && TargetRect->top == 0 && TargetWidth > 0 && TargetHeight > 0 && TargetWidth <= BitmapInfo->biWidth && TargetHeight <= FMath::Abs(BitmapInfo->biHeight))
+	{
+		Width = TargetWidth;
+		Height = (BitmapInfo->biHeight < 0) ? -TargetHeight : TargetHeight;
+	}
+
+	SamplePitch = FMath::Max<int32>(Width, BitmapInfo->biWidth);
+
+	if (SamplePitch != Width)
+	{
+		UE_LOG(LogDirectShowMedia, Log, TEXT("Video rows are padded to %d pixels for a width of %d"), SamplePitch, Width);
+	}
+}
+
+void FDirectShowVideoDevice::UpdateSampleBufferCount()
+{
+	SampleBufferCount = 0;
+
+	TComPtr<IPin> Pin;
+	if (!VideoSamplegrabberfilter || !GetPin(VideoSamplegrabberfilter, PINDIR_INPUT, &Pin))
+		return;
+
+	TComPtr<IMemInputPin> MemInputPin;
+	if (FAILED(Pin->QueryInterface(IID_IMemInputPin, (void**)&MemInputPin)))
+		return;
+
+	TComPtr<IMemAllocator> Allocator;
+	if (FAILED(MemInputPin->GetAllocator(&Allocator)))
+		return;
+
+	ALLOCATOR_PROPERTIES Properties;
+	if (FAILED(Allocator->GetProperties(&Properties)))
+		return;
+
+	SampleBufferCount = FMath::Max<int32>(0, Properties.cBuffers);
+
+	UE_LOG(LogDirectShowMedia, Log, TEXT("Video samples are captured into %d buffers of %ld bytes"), SampleBufferCount, Properties.cbBuffer);
+}
+
 HRESULT FDirectShowVideoDevice::SetupMjpegDecompressorGraph()
 {
 	HRESULT hr = S_OK;
+	FDirectShowGraphScopedStep Step(OpenTimeline, TEXT("SetupMjpegDecompressorGraph"), hr);
 	
 	// Create the MJPG Decompressor filter.
 	hr = CoCreateInstance(CLSID_MjpegDec, NULL, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&DecompressorFilter));
@@ -1227,6 +1359,13 @@ HRESULT FDirectShowVideoDevice::SetupMjpegDecompressorGraph()
 		return hr;
 	}
 
+	// the decoder delivers the preferred format itself
+	if (NegotiateDecoderOutput() != MEDIASUBTYPE_ARGB32)
+	{
+		ConnectVideoGraph();
+		return hr;
+	}
+
 	 // Create the Color Space Converter filter.
     hr = CoCreateInstance(CLSID_Colour, NULL, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&ColorConverterFilter));
     if (FAILED(hr)) 
@@ -1261,6 +1400,7 @@ HRESULT FDirectShowVideoDevice::SetupMjpegDecompressorGraph()
 HRESULT FDirectShowVideoDevice::SetupH264Graph()
 {
 	HRESULT hr = S_OK;
+	FDirectShowGraphScopedStep Step(OpenTimeline, TEXT("SetupH264Graph"), hr);
 	
 	// Create the MJPG Decompressor filter.
 	hr = CoCreateInstance(CLSID_MSDTV, NULL, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&DecompressorFilter));
@@ -1275,6 +1415,13 @@ HRESULT FDirectShowVideoDevice::SetupH264Graph()
 		return hr;
 	}
 
+	// the decoder delivers the preferred format itself
+	if (NegotiateDecoderOutput() != MEDIASUBTYPE_ARGB32)
+	{
+		ConnectVideoGraph();
+		return hr;
+	}
+
 	 // Create the Color Space Converter filter.
     hr = CoCreateInstance(CLSID_Colour, NULL, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&ColorConverterFilter));
     if (FAILED(hr)) 
@@ -1299,9 +1446,69 @@ HRESULT FDirectShowVideoDevice::SetupH264Graph()
 	return hr;
 }
 
+GUID FDirectShowVideoDevice::NegotiateDecoderOutput()
+{
+	if (PreferredSinkSubtype == MEDIASUBTYPE_ARGB32 || !DecompressorFilter || !VideoSamplegrabber)
+	{
+		return MEDIASUBTYPE_ARGB32;
+	}
+
+	TComPtr<IPin> SourceOut;
+	TComPtr<IPin> DecoderIn;
+	TComPtr<IPin> DecoderOut;
+	if (!GetPin(VideoSourcefilter, PINDIR_OUTPUT, MEDIATYPE_Video, PIN_CATEGORY_CAPTURE, &SourceOut) || !GetPin(DecompressorFilter, PINDIR_INPUT, &DecoderIn) || !GetPin(DecompressorFilter, PINDIR_OUTPUT, &DecoderOut))
+	{
+		return MEDIASUBTYPE_ARGB32;
+	}
+
+	// the decoder only lists its output formats once its input is connected
+	HRESULT hr = Graph->ConnectDirect(SourceOut, DecoderIn, nullptr);
+	if (FAILED(hr))
+	{
+		UE_LOG(LogDirectShowMedia, Warning, TEXT("Failed to connect the decoder to query its output formats: %d"), hr);
+		return MEDIASUBTYPE_ARGB32;
+	}
+
+	bool bOffered = false;
+	TComPtr<IEnumMediaTypes> MediaTypes;
+	if (SUCCEEDED(DecoderOut->EnumMediaTypes(&MediaTypes)))
+	{
+		DShowMediaTypePtr MediaType;
+		while (!bOffered && MediaTypes->Next(1, MediaType, nullptr) == S_OK)
+		{
+			bOffered = (MediaType->majortype == MEDIATYPE_Video) && (MediaType->subtype == PreferredSinkSubtype);
+			MediaType.Free();
+		}
+	}
+
+	// RenderStream makes the connections, as it does for every other format
+	Graph->Disconnect(DecoderIn);
+	Graph->Disconnect(SourceOut);
+
+	if (!bOffered)
+	{
+		UE_LOG(LogDirectShowMedia, Log, TEXT("Decoder doesn't output %s, decoding to ARGB32"), *GetFormatTypeFromGUID(PreferredSinkSubtype));
+		return MEDIASUBTYPE_ARGB32;
+	}
+
+	DShowMediaType SinkType;
+	SinkType->majortype = MEDIATYPE_Video;
+	SinkType->subtype = PreferredSinkSubtype;
+
+	hr = VideoSamplegrabber->SetMediaType(SinkType);
+	if (FAILED(hr))
+	{
+		UE_LOG(LogDirectShowMedia, Warning, TEXT("Failed to set the sample grabber to %s: %d"), *GetFormatTypeFromGUID(PreferredSinkSubtype), hr);
+		return MEDIASUBTYPE_ARGB32;
+	}
+
+	return PreferredSinkSubtype;
+}
+
 HRESULT FDirectShowVideoDevice::ConnectVideoGraph()
 {
-	HRESULT hr;
+	HRESULT hr = S_OK;
+	FDirectShowGraphScopedStep Step(OpenTimeline, TEXT("ConnectVideoGraph"), hr);
 	
 	if(DecompressorFilter && ColorConverterFilter)
 	{
@@ -1412,7 +1619,8 @@ HRESULT FDirectShowVideoDevice::ConnectVideoGraph()
 
 HRESULT FDirectShowVideoDevice::ConnectAudioGraph()
 {
-	HRESULT hr;
+	HRESULT hr = S_OK;
+	FDirectShowGraphScopedStep Step(OpenTimeline, TEXT("ConnectAudioGraph"), hr);
 
 	if(Demux)
 	{
@@ -1493,6 +1701,47 @@ FIntPoint FDirectShowVideoDevice::GetAspectRatio() const
 	return FIntPoint(Width / divisor, Height / divisor);
 }
 
+void FDirectShowVideoDevice::GetFrameSideData(FDirectShowMediaFrameMetadata& OutMetadata)
+{
+	const double Now = FPlatformTime::Seconds();
+
+	if (Now - LastSideDataPollTime >= 0.5)
+	{
+		LastSideDataPollTime = Now;
+		long Flags = 0;
+
+		bHasExposure = CameraControl.IsValid() && SUCCEEDED(CameraControl->Get(CameraControl_Exposure, &CachedExposure, &Flags));
+		bHasGain = VideoProcAmp.IsValid() && SUCCEEDED(VideoProcAmp->Get(VideoProcAmp_Gain, &CachedGain, &Flags));
+	}
+
+	if (bHasExposure)
+	{
+		OutMetadata.Exposure = CachedExposure;
+		OutMetadata.Flags |= EDirectShowMediaFrameMetadataFlags::Exposure;
+	}
+
+	if (bHasGain)
+	{
+		OutMetadata.Gain = CachedGain;
+		OutMetadata.Flags |= EDirectShowMediaFrameMetadataFlags::Gain;
+	}
+
+	if (TimecodeReader.IsValid())
+	{
+		TIMECODE_SAMPLE TimecodeSample = { };
+		TimecodeSample.dwFlags = ED_DEVCAP_TIMECODE_READ;
+
+		if (TimecodeReader->GetTimecode(&TimecodeSample) == S_OK)
+		{
+			OutMetadata.TimecodeFrames = TimecodeSample.timecode.dwFrames;
+			OutMetadata.TimecodeFormat = TimecodeSample.timecode.wFrameRate;
+			OutMetadata.TimecodeFrameFraction = TimecodeSample.timecode.wFrameFraction;
+			OutMetadata.TimecodeUserBits = TimecodeSample.dwUser;
+			OutMetadata.Flags |= EDirectShowMediaFrameMetadataFlags::Timecode;
+		}
+	}
+}
+
 
 
 void FDirectShowVideoDevice::Start()
@@ -1560,7 +1809,8 @@ void FDirectShowVideoDevice::Stop()
 	// 	HResult = Samplegrabberfilter->Stop();
 	// }
 	
-	if(Control.IsValid() && bIsInitialized)
+	// the graph runs before the open completes, so it is stopped whether or not the device is initialized
+	if(Control.IsValid())
 	{
 		HResult = Control->Stop();
 		if (FAILED(HResult)) 
@@ -1627,14 +1877,23 @@ void FDirectShowVideoDevice::Stop()
 	//ReleaseFilters();
 	Width = 0;
 	Height = 0;
+	SamplePitch = 0;
+	SampleBufferCount = 0;
 	CurrentSubtype = MEDIASUBTYPE_None;
 	CurrentFPS = 0;
+	++FormatSerial;
 	
 	VideoSourcefilter.Reset();
 	DecompressorFilter.Reset();
 	ColorConverterFilter.Reset();
 	VideoSamplegrabberfilter.Reset();
 	VideoSamplegrabber.Reset();
+
+	CameraControl.Reset();
+	VideoProcAmp.Reset();
+	TimecodeReader.Reset();
+	bHasExposure = false;
+	bHasGain = false;
 	
 	AudioSourcefilter.Reset();
 	AudioSamplegrabberfilter.Reset();
@@ -1668,6 +1927,18 @@ FString FDirectShowVideoDevice::GetFormatTypeFromGUID(const GUID& Id) const
 		return FString("ARGB32");
 	else if( Id == MEDIASUBTYPE_RGB32)
 		return FString("RGB32");
+	else if( Id == DSMEDIASUBTYPE_P010)
+		return FString("P010");
+	else if( Id == DSMEDIASUBTYPE_Y210)
+		return FString("Y210");
+	else if( Id == DSMEDIASUBTYPE_v210)
+		return FString("v210");
+	else if( Id == MEDIASUBTYPE_IYUV || Id == DSMEDIASUBTYPE_I420)
+		return FString("I420");
+	else if( Id == MEDIASUBTYPE_YV12)
+		return FString("YV12");
+	else if( Id == DSMEDIASUBTYPE_NV21)
+		return FString("NV21");
 	if(Id == MEDIASUBTYPE_PCM)
 		return FString("PCM");
 
@@ -1703,6 +1974,14 @@ EMediaTextureSampleFormat FDirectShowVideoDevice::GetTextureSampleFormatTypeFrom
 		return EMediaTextureSampleFormat::CharBGRA;
 	else if(Id == MEDIASUBTYPE_RGB32)
 		return EMediaTextureSampleFormat::CharBGRA;
+	else if(Id == DSMEDIASUBTYPE_P010 || Id == DSMEDIASUBTYPE_Y210)
+		return EMediaTextureSampleFormat::Y416;
+	else if(Id == DSMEDIASUBTYPE_v210)
+		return EMediaTextureSampleFormat::YUVv210;
+	else if(Id == MEDIASUBTYPE_IYUV || Id == DSMEDIASUBTYPE_I420 || Id == MEDIASUBTYPE_YV12)
+		return EMediaTextureSampleFormat::CharNV12;
+	else if(Id == DSMEDIASUBTYPE_NV21)
+		return EMediaTextureSampleFormat::CharNV21;
 	
 	return EMediaTextureSampleFormat::Undefined;
 }
@@ -1,17 +1,22 @@
 ﻿#pragma once
 
+#include <atomic>
 
 #include "Windows/AllowWindowsPlatformTypes.h"
 #include <dshow.h>
 #include "Windows/HideWindowsPlatformTypes.h"
+#include "DirectShowDeviceTable.h"
+#include "DirectShowGraphTimeline.h"
 #include "DirectShowMediaType.h"
 #include "IMediaAudioSample.h"
 #include "Microsoft/COMPointer.h"
 #include "IMediaTextureSample.h"
 #include "IMediaTracks.h"
 #include "MediaPlayerOptions.h"
+#include "Player/DirectShowMediaColorConverter.h"
 
 struct ISampleGrabber;
+struct FDirectShowMediaFrameMetadata;
 class FDirectShowCallbackHandler;
 struct IBaseFilter;
 
@@ -72,10 +77,22 @@ public:
  	* @see IsInitialized, Shutdown
  	*/
 	bool Initialize(const FString& Url, AM_MEDIA_TYPE* Format, AM_MEDIA_TYPE* AudioFormat = nullptr);
-	bool TryInitializeAudio(const FString& InFriendlyName, AM_MEDIA_TYPE* Format);
+	/** Add the source of an audio device to the graph, as the device table resolved or paired it. */
+	bool TryInitializeAudio(const FDirectShowDeviceId& InDeviceId, AM_MEDIA_TYPE* Format);
 	bool InitializeGraph();
 
 	void SetAudioBuffer(float delayMs);
+	/** Set the audio buffer size used when the graph is built (in milliseconds). */
+	void SetAudioBufferDuration(float delayMs) { AudioBufferMs = delayMs; }
+	float GetAudioBufferDuration() const { return AudioBufferMs; }
+	/** Set the format compressed video is decoded to when the graph is built (MEDIASUBTYPE_ARGB32, _NV12 or _YUY2). */
+	void SetPreferredSinkSubtype(const GUID& InSubtype) { PreferredSinkSubtype = InSubtype; }
+	/** Set the file the graph open timeline is written to as a Chrome trace, relative to the Saved directory (empty for none). */
+	void SetGraphTraceFile(const FString& Filename) { OpenTimeline.SetTraceFile(Filename); }
+	/** Get the timeline of the last time the graph was opened. */
+	const FDirectShowGraphTimeline& GetOpenTimeline() const { return OpenTimeline; }
+	/** Change the audio buffer size of a running graph, briefly stopping it. */
+	bool RenegotiateAudioBuffer(float delayMs);
 	
 	void FillVideoFormatData(IPin* SourcePin);
 	void FillAudioFormatData(IPin* SourcePin);
@@ -91,12 +108,23 @@ public:
 
 	FIntPoint GetTextureSize() const { return FIntPoint(Width, Height); }
 	int32 GetTextureSizeX() const { return Width; }
+	/** Get the width of the rows of the sample buffers (in pixels), which drivers may pad beyond the texture width. */
+	int32 GetSamplePitch() const { return SamplePitch; }
 	float GetFramerate() const { return CurrentFPS; }
 	GUID GetCurrentSubtype() const { return CurrentSubtype; }
+	/** Get the format of the samples handed to the callback, which is the decoder's output for compressed formats. */
+	GUID GetSampleSubtype() const { return SampleSubtype; }
+	/** Get the number of buffers the sample grabber's allocator captures into, or 0 if unknown. */
+	int32 GetSampleBufferCount() const { return SampleBufferCount; }
 	FIntPoint GetAspectRatio() const;
+	/** Get the colorimetry of the connected video format. */
+	const FDirectShowMediaColorimetry& GetColorimetry() const { return Colorimetry; }
+	/** Get a number that changes whenever the sample format is negotiated, so callers can cache what they derive from it. */
+	uint32 GetFormatSerial() const { return FormatSerial.load(std::memory_order_acquire); }
 	
 	uint32 GetSampleRate() const { return SampleRate; }
 	uint32 GetNumChannels() const { return NumChannels; }
+	uint32 GetBitsPerSample() const { return BitsPerSample; }
 
 	FString GetFriendlyName() const { return Friendlyname; }
 	FString GetAudioFriendlyName() const { return AudioDeviceFriendlyName; }
@@ -109,7 +137,7 @@ public:
 	bool SetFormatInfo(const FString& Url, const FDShowFormat& VideoFormatInfo, const FDShowFormat* AudioFormatInfo = nullptr);
 
 	bool GetVideoFormatFromInfo(const FString& Url, const FDShowFormat& FormatInfo, AM_MEDIA_TYPE* MediaType);
-	bool GetAudioFormatFromInfo(const FString& FriendlyName, const FDShowFormat& FormatInfo, AM_MEDIA_TYPE* MediaType);
+	bool GetAudioFormatFromInfo(const FDirectShowDeviceId& InDeviceId, const FDShowFormat& FormatInfo, AM_MEDIA_TYPE* MediaType);
 	//bool GetMediaTypeFromFormatInfo(const FString& Url, FDShowFormat& FormatInfo, DShowMediaType& outMediaType);
 
 	bool RequestFrameRateChange(int32 TrackIndex, int32 FormatIndex, float newFrameRate);
@@ -117,10 +145,29 @@ public:
 	
 	HRESULT SetupMjpegDecompressorGraph();
 	HRESULT SetupH264Graph();
+	/**
+	 * Pick the format the decoder delivers to the sample grabber.
+	 *
+	 * The decoder is connected to the source to see what it can output. If it offers the preferred format, the
+	 * sample grabber is set to it and no color space converter is needed; otherwise the graph decodes to ARGB32.
+	 *
+	 * @return The negotiated subtype.
+	 */
+	GUID NegotiateDecoderOutput();
 	HRESULT ConnectVideoGraph();
 	HRESULT ConnectAudioGraph();   
 	
 
+	/**
+	 * Add the side data the capture filter reports next to the frames (exposure, gain and timecode).
+	 *
+	 * Called for every frame on the streaming thread. Exposure and gain are read from the driver at most
+	 * every half second, since they change rarely and each read is a round trip to the driver.
+	 *
+	 * @param OutMetadata The metadata to add the side data to.
+	 */
+	void GetFrameSideData(FDirectShowMediaFrameMetadata& OutMetadata);
+
 	FDirectShowCallbackHandler* GetVideoCallbackHandler() const { return VideoCallbackhandler; }
 	FDirectShowCallbackHandler* GetAudioCallbackHandler() const { return AudioCallbackhandler; }
 
@@ -139,6 +186,18 @@ protected:
 	// bool GetPin(const FString& Url, PIN_DIRECTION PinDir, IPin** Pin);
 
 	bool IsFormatValid(const FDShowFormat& FormatInfo, AM_MEDIA_TYPE& MediaType, const BYTE *ConfigCaps = nullptr);
+
+	/** Add the device's source filter and sample grabber to the graph and connect them, for the given formats. */
+	bool ConnectVideoSource(const FDirectShowDeviceId& DeviceId, AM_MEDIA_TYPE* Format, AM_MEDIA_TYPE* AudioFormat);
+
+	/** Read the colorimetry of the connected format, from its extended format flags if the pin reports any. */
+	void UpdateColorimetry(IPin* Pin, const AM_MEDIA_TYPE& ConnectionType);
+
+	/** Read the pitch of the sample buffers, and the image inside them, from the format the sample grabber is connected with. */
+	void UpdateSamplePitch(const AM_MEDIA_TYPE& SampleType);
+
+	/** Read the number of sample buffers from the allocator the sample grabber's input pin was connected with. */
+	void UpdateSampleBufferCount();
 	
 	FCriticalSection CriticalSection;
 	
@@ -156,17 +215,33 @@ protected:
 
 	int32 Width;
 	int32 Height;
+	/** Width of the sample buffer rows (in pixels), at least Width. */
+	int32 SamplePitch;
+	/** Number of buffers of the sample grabber's allocator, 0 if unknown. */
+	int32 SampleBufferCount;
 	float CurrentFPS;
+	/** Timed steps of the last graph open. */
+	FDirectShowGraphTimeline OpenTimeline;
+	/** Bumped after the sample format was negotiated or released. */
+	std::atomic<uint32> FormatSerial;
+	FDirectShowMediaColorimetry Colorimetry;
 
 	EMediaAudioSampleFormat SampleFormat;
 	uint32 BitsPerSample;
 	uint32 NumChannels;
 	uint32 SampleRate;
+	float AudioBufferMs;
 	
 	GUID CurrentSubtype;
+	/** The format of the samples, after decoding. */
+	GUID SampleSubtype;
+	/** The format compressed video should be decoded to. */
+	GUID PreferredSinkSubtype;
 	GUID CurrentAudioSubtype;
 	FString Friendlyname = "";
 	FString AudioDeviceFriendlyName = "";
+	/** The audio device picked or paired when the formats were filled in, bound by identity when the graph is built. */
+	FDirectShowDeviceId AudioDeviceId;
 	//WCHAR* Filtername;
 	//WCHAR* AudioFiltername;
 	FString URL;
@@ -193,6 +268,17 @@ protected:
 	TComPtr<IBaseFilter> VideoSamplegrabberfilter;	
 	TComPtr<ISampleGrabber> VideoSamplegrabber;
 	FDirectShowCallbackHandler* VideoCallbackhandler;
+
+	// Side data, null if the capture filter doesn't expose it
+	TComPtr<IAMCameraControl> CameraControl;
+	TComPtr<IAMVideoProcAmp> VideoProcAmp;
+	TComPtr<IAMTimecodeReader> TimecodeReader;
+	/** Time exposure and gain were last read (in seconds). */
+	double LastSideDataPollTime;
+	long CachedExposure;
+	long CachedGain;
+	bool bHasExposure;
+	bool bHasGain;
 	
 	// Audio stuff
 	TComPtr<IBaseFilter> AudioSourcefilter;
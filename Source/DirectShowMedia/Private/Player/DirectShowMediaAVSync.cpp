@@ -0,0 +1,87 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "DirectShowMediaAVSync.h"
+
+#include "Math/UnrealMathUtility.h"
+
+
+/* loop bandwidth (in Hz), low enough to average out callback jitter over several seconds */
+#define AV_SYNC_LOOP_BANDWIDTH 0.02
+/* largest clock rate difference that will be corrected (1000 ppm) */
+#define AV_SYNC_MAX_RATE_DEVIATION 0.001
+/* errors above this (in seconds) are treated as discontinuities and re-anchor the loop */
+#define AV_SYNC_RESYNC_THRESHOLD 0.5
+/* smoothing factor for the reported sync error */
+#define AV_SYNC_ERROR_SMOOTHING 0.01
+
+
+/* FDirectShowMediaAVSync structors
+ *****************************************************************************/
+
+FDirectShowMediaAVSync::FDirectShowMediaAVSync()
+	: bLocked(false)
+	, FilteredTime(0.0)
+	, PreviousPeriod(0.0)
+	, RateRatio(1.0)
+	, SyncError(0.0)
+	, NumResyncs(0)
+{ }
+
+
+/* FDirectShowMediaAVSync interface
+ *****************************************************************************/
+
+void FDirectShowMediaAVSync::Reset()
+{
+	bLocked = false;
+	FilteredTime = 0.0;
+	PreviousPeriod = 0.0;
+	RateRatio = 1.0;
+	SyncError = 0.0;
+}
+
+
+void FDirectShowMediaAVSync::ProcessAudio(double CallbackTime, uint32 NumFrames, uint32 SampleRate, FTimespan& OutTime, FTimespan& OutDuration)
+{
+	const double Period = (SampleRate > 0) ? (double)NumFrames / (double)SampleRate : 0.0;
+
+	if (bLocked && (PreviousPeriod > 0.0))
+	{
+		// where the audio device clock says this buffer should have arrived
+		const double PredictedTime = FilteredTime + PreviousPeriod * RateRatio;
+		const double Error = CallbackTime - PredictedTime;
+
+		if (FMath::Abs(Error) < AV_SYNC_RESYNC_THRESHOLD)
+		{
+			const double Omega = 2.0 * PI * AV_SYNC_LOOP_BANDWIDTH * PreviousPeriod;
+
+			// slew the timeline a fraction of the error and adjust the rate estimate
+			FilteredTime = PredictedTime + UE_SQRT_2 * Omega * Error;
+			RateRatio = FMath::Clamp(RateRatio + Omega * Omega * Error / PreviousPeriod, 1.0 - AV_SYNC_MAX_RATE_DEVIATION, 1.0 + AV_SYNC_MAX_RATE_DEVIATION);
+			SyncError += AV_SYNC_ERROR_SMOOTHING * (Error - SyncError);
+			PreviousPeriod = Period;
+
+			OutTime = FTimespan::FromSeconds(FilteredTime);
+			OutDuration = FTimespan::FromSeconds(Period * RateRatio);
+
+			return;
+		}
+
+		++NumResyncs;
+	}
+
+	// anchor the loop on the current callback
+	bLocked = true;
+	FilteredTime = CallbackTime;
+	PreviousPeriod = Period;
+	SyncError = 0.0;
+
+	OutTime = FTimespan::FromSeconds(FilteredTime);
+	OutDuration = FTimespan::FromSeconds(Period * RateRatio);
+}
+
+
+#undef AV_SYNC_LOOP_BANDWIDTH
+#undef AV_SYNC_MAX_RATE_DEVIATION
+#undef AV_SYNC_RESYNC_THRESHOLD
+#undef AV_SYNC_ERROR_SMOOTHING
@@ -0,0 +1,82 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreTypes.h"
+#include "Misc/Timespan.h"
+
+
+/**
+ * Keeps audio sample timestamps locked to the video timeline.
+ *
+ * Video samples are stamped with the graph stream time at which the sample grabber fires. Audio buffers
+ * arrive on the same timeline, but when the audio comes from a separate device its sample clock runs at a
+ * slightly different rate, so counting samples drifts away from the graph clock over long sessions, while
+ * using the raw callback times directly carries all of the callback jitter.
+ *
+ * This controller runs a second order delay-locked loop over the callback times: it measures the offset
+ * between the audio device clock (samples delivered) and the video timeline, estimates the rate ratio
+ * between both clocks, and slews the audio timestamps towards the video timeline so that consecutive
+ * audio samples stay contiguous while the accumulated error is corrected gradually.
+ */
+class FDirectShowMediaAVSync
+{
+public:
+
+	/** Default constructor. */
+	FDirectShowMediaAVSync();
+
+public:
+
+	/** Forget all measurements, i.e. after the graph was restarted. */
+	void Reset();
+
+	/**
+	 * Process an audio buffer that arrived on the video timeline.
+	 *
+	 * @param CallbackTime Graph stream time (in seconds) at which the buffer was delivered.
+	 * @param NumFrames Number of audio frames in the buffer.
+	 * @param SampleRate Nominal sample rate of the audio device.
+	 * @param OutTime Will contain the corrected presentation time of the buffer.
+	 * @param OutDuration Will contain the corrected duration of the buffer.
+	 */
+	void ProcessAudio(double CallbackTime, uint32 NumFrames, uint32 SampleRate, FTimespan& OutTime, FTimespan& OutDuration);
+
+	/** Get the smoothed offset between the measured and corrected audio timeline (in seconds). */
+	double GetSyncError() const
+	{
+		return SyncError;
+	}
+
+	/** Get the estimated rate difference of the audio device clock relative to the video timeline (in ppm). */
+	double GetDriftPpm() const
+	{
+		return (RateRatio - 1.0) * 1.0e6;
+	}
+
+	/** Get the number of times the loop was re-anchored because the error was too large. */
+	uint32 GetNumResyncs() const
+	{
+		return NumResyncs;
+	}
+
+private:
+
+	/** Whether the loop has been anchored. */
+	bool bLocked;
+
+	/** Corrected presentation time of the previous audio buffer (in seconds). */
+	double FilteredTime;
+
+	/** Nominal duration of the previous audio buffer (in seconds). */
+	double PreviousPeriod;
+
+	/** Estimated video timeline seconds per audio device second. */
+	double RateRatio;
+
+	/** Smoothed difference between measured and predicted callback times (in seconds). */
+	double SyncError;
+
+	/** Number of times the loop was re-anchored. */
+	uint32 NumResyncs;
+};
@@ -0,0 +1,231 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "DirectShowMediaAudioBufferController.h"
+
+#include "Math/UnrealMathUtility.h"
+#include "Misc/ScopeLock.h"
+
+
+/* how long a jitter peak is remembered (half life in seconds) */
+#define AUDIO_BUFFER_JITTER_HALF_LIFE 10.0
+/* how long an underrun keeps the buffer enlarged (half life in seconds) */
+#define AUDIO_BUFFER_UNDERRUN_HALF_LIFE 30.0
+/* extra buffering per underrun (in milliseconds) */
+#define AUDIO_BUFFER_UNDERRUN_PENALTY_MS 10.0
+/* how much of the peak jitter the device buffer has to cover */
+#define AUDIO_BUFFER_JITTER_SAFETY 1.5
+/* buffer sizes are picked in steps of this (in milliseconds) */
+#define AUDIO_BUFFER_STEP_MS 5.0
+/* time after a renegotiation during which the graph restart is not measured (in seconds) */
+#define AUDIO_BUFFER_SETTLE_TIME 1.0
+/* shortest time between two renegotiations that grow the buffer (in seconds) */
+#define AUDIO_BUFFER_GROW_INTERVAL 2.0
+/* time without underruns or renegotiations before the buffer may shrink (in seconds) */
+#define AUDIO_BUFFER_SHRINK_INTERVAL 20.0
+/* the buffer only shrinks when the target is at most this fraction of the current size */
+#define AUDIO_BUFFER_SHRINK_RATIO 0.75
+/* deepest jitter buffer on our side */
+#define AUDIO_BUFFER_MAX_QUEUE_DEPTH 8
+
+
+/* FDirectShowMediaAudioBufferController structors
+ *****************************************************************************/
+
+FDirectShowMediaAudioBufferController::FDirectShowMediaAudioBufferController()
+	: bAdaptive(false)
+	, BufferMs(20.0f)
+	, MinBufferMs(10.0f)
+	, MaxBufferMs(200.0f)
+	, LastArrivalTime(-1.0)
+	, LastBufferPeriod(0.0)
+	, PeakJitter(0.0)
+	, WindowStart(0.0)
+	, ObservationStart(-1.0)
+	, UnderrunPenaltyMs(0.0)
+	, LastUnderrunTime(-1.0e9)
+	, LastRenegotiationTime(-1.0e9)
+	, PendingUnderruns(0)
+	, NumUnderruns(0)
+	, NumRenegotiations(0)
+{
+	WindowJitter[0] = WindowJitter[1] = 0.0;
+}
+
+
+/* FDirectShowMediaAudioBufferController interface
+ *****************************************************************************/
+
+void FDirectShowMediaAudioBufferController::Reset(float InBufferMs, float InMinBufferMs, float InMaxBufferMs, bool bInAdaptive)
+{
+	FScopeLock Lock(&CriticalSection);
+
+	bAdaptive = bInAdaptive;
+	MinBufferMs = FMath::Max(1.0f, InMinBufferMs);
+	MaxBufferMs = FMath::Max(MinBufferMs, InMaxBufferMs);
+	BufferMs.store(InBufferMs, std::memory_order_relaxed);
+
+	LastArrivalTime = -1.0;
+	LastBufferPeriod = 0.0;
+	PeakJitter = 0.0;
+	WindowJitter[0] = WindowJitter[1] = 0.0;
+	WindowStart = 0.0;
+	ObservationStart = -1.0;
+	UnderrunPenaltyMs = 0.0;
+	LastUnderrunTime = -1.0e9;
+	LastRenegotiationTime = -1.0e9;
+	PendingUnderruns.store(0, std::memory_order_relaxed);
+	NumUnderruns.store(0, std::memory_order_relaxed);
+	NumRenegotiations = 0;
+}
+
+
+void FDirectShowMediaAudioBufferController::AddCallback(double ArrivalTime, double BufferPeriod)
+{
+	FScopeLock Lock(&CriticalSection);
+
+	const double Interval = ArrivalTime - LastArrivalTime;
+	const bool bSettling = (ArrivalTime - LastRenegotiationTime) < AUDIO_BUFFER_SETTLE_TIME;
+
+	// the first callback and the ones after a stall (i.e. a graph restart) have nothing to compare with
+	if ((LastArrivalTime >= 0.0) && !bSettling && (Interval > 0.0) && (Interval < 2.0 * LastBufferPeriod + 0.5))
+	{
+		const double Deviation = FMath::Abs(Interval - LastBufferPeriod);
+		const double Decay = FMath::Pow(0.5, Interval / AUDIO_BUFFER_JITTER_HALF_LIFE);
+
+		PeakJitter = FMath::Max(Deviation, PeakJitter * Decay);
+
+		// sliding maximum over one to two shrink intervals, so a quiet spell shorter than that doesn't shrink the buffer
+		if (ArrivalTime - WindowStart >= AUDIO_BUFFER_SHRINK_INTERVAL)
+		{
+			WindowJitter[1] = WindowJitter[0];
+			WindowJitter[0] = 0.0;
+			WindowStart = ArrivalTime;
+		}
+
+		WindowJitter[0] = FMath::Max(WindowJitter[0], Deviation);
+
+		if (ObservationStart < 0.0)
+		{
+			ObservationStart = ArrivalTime;
+		}
+	}
+
+	LastArrivalTime = ArrivalTime;
+	LastBufferPeriod = BufferPeriod;
+}
+
+
+void FDirectShowMediaAudioBufferController::AddUnderrun()
+{
+	PendingUnderruns.fetch_add(1, std::memory_order_relaxed);
+	NumUnderruns.fetch_add(1, std::memory_order_relaxed);
+}
+
+
+bool FDirectShowMediaAudioBufferController::PollRenegotiation(double Now, float& OutBufferMs)
+{
+	FScopeLock Lock(&CriticalSection);
+
+	const uint32 NewUnderruns = PendingUnderruns.exchange(0, std::memory_order_relaxed);
+
+	// underruns caused by the restart itself say nothing about the buffer size
+	if ((NewUnderruns > 0) && ((Now - LastRenegotiationTime) >= AUDIO_BUFFER_SETTLE_TIME))
+	{
+		UnderrunPenaltyMs = UnderrunPenaltyMs * FMath::Pow(0.5, (Now - LastUnderrunTime) / AUDIO_BUFFER_UNDERRUN_HALF_LIFE) + NewUnderruns * AUDIO_BUFFER_UNDERRUN_PENALTY_MS;
+		LastUnderrunTime = Now;
+	}
+
+	if (!bAdaptive)
+	{
+		return false;
+	}
+
+	if (ObservationStart < 0.0)
+	{
+		return false; // nothing measured yet
+	}
+
+	const float CurrentMs = BufferMs.load(std::memory_order_relaxed);
+	const double Observed = Now - ObservationStart;
+
+	// grow on the recent peak
+	const float GrowMs = ComputeTargetBufferMs(Now, PeakJitter);
+
+	if ((GrowMs > CurrentMs) && (Observed >= AUDIO_BUFFER_GROW_INTERVAL))
+	{
+		OutBufferMs = GrowMs;
+		return true;
+	}
+
+	// shrink only if the whole window was quiet, and keep one step of headroom so the next peak doesn't grow it right back
+	const float ShrinkMs = FMath::Min(CurrentMs, ComputeTargetBufferMs(Now, FMath::Max(WindowJitter[0], WindowJitter[1])) + (float)AUDIO_BUFFER_STEP_MS);
+
+	if ((ShrinkMs <= CurrentMs * AUDIO_BUFFER_SHRINK_RATIO) && (Observed >= AUDIO_BUFFER_SHRINK_INTERVAL) && ((Now - LastUnderrunTime) >= AUDIO_BUFFER_SHRINK_INTERVAL))
+	{
+		OutBufferMs = ShrinkMs;
+		return true;
+	}
+
+	return false;
+}
+
+
+void FDirectShowMediaAudioBufferController::OnRenegotiated(double Now, float InBufferMs)
+{
+	FScopeLock Lock(&CriticalSection);
+
+	BufferMs.store(InBufferMs, std::memory_order_relaxed);
+	LastRenegotiationTime = Now;
+	LastArrivalTime = -1.0;
+	ObservationStart = -1.0;
+	++NumRenegotiations;
+}
+
+
+int32 FDirectShowMediaAudioBufferController::GetJitterBufferDepth(double Now) const
+{
+	FScopeLock Lock(&CriticalSection);
+
+	const double Period = FMath::Max(0.001, (double)BufferMs.load(std::memory_order_relaxed) / 1000.0);
+	int32 Depth = FMath::CeilToInt32(PeakJitter / Period) + 1;
+
+	// ride out the restart gap after a renegotiation
+	if ((Now - LastRenegotiationTime) < AUDIO_BUFFER_SETTLE_TIME)
+	{
+		++Depth;
+	}
+
+	return FMath::Clamp(Depth, 1, AUDIO_BUFFER_MAX_QUEUE_DEPTH);
+}
+
+
+float FDirectShowMediaAudioBufferController::GetJitterMs() const
+{
+	FScopeLock Lock(&CriticalSection);
+	return (float)(PeakJitter * 1000.0);
+}
+
+
+/* FDirectShowMediaAudioBufferController implementation
+ *****************************************************************************/
+
+float FDirectShowMediaAudioBufferController::ComputeTargetBufferMs(double Now, double Jitter) const
+{
+	const double Penalty = UnderrunPenaltyMs * FMath::Pow(0.5, (Now - LastUnderrunTime) / AUDIO_BUFFER_UNDERRUN_HALF_LIFE);
+	const double Target = MinBufferMs + AUDIO_BUFFER_JITTER_SAFETY * Jitter * 1000.0 + Penalty;
+	const double Quantized = FMath::CeilToDouble(Target / AUDIO_BUFFER_STEP_MS) * AUDIO_BUFFER_STEP_MS;
+
+	return (float)FMath::Clamp(Quantized, (double)MinBufferMs, (double)MaxBufferMs);
+}
+
+
+#undef AUDIO_BUFFER_JITTER_HALF_LIFE
+#undef AUDIO_BUFFER_UNDERRUN_HALF_LIFE
+#undef AUDIO_BUFFER_UNDERRUN_PENALTY_MS
+#undef AUDIO_BUFFER_JITTER_SAFETY
+#undef AUDIO_BUFFER_STEP_MS
+#undef AUDIO_BUFFER_SETTLE_TIME
+#undef AUDIO_BUFFER_GROW_INTERVAL
+#undef AUDIO_BUFFER_SHRINK_INTERVAL
+#undef AUDIO_BUFFER_SHRINK_RATIO
+#undef AUDIO_BUFFER_MAX_QUEUE_DEPTH
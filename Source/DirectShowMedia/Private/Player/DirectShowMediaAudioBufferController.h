@@ -0,0 +1,157 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include <atomic>
+
+#include "CoreTypes.h"
+#include "HAL/CriticalSection.h"
+
+
+/**
+ * Picks the capture device's audio buffer size from measured conditions.
+ *
+ * Small device buffers mean low latency, but every late audio callback then starves the consumer. The
+ * controller measures how far callbacks arrive from their expected time (a decaying peak, so a single
+ * hiccup is remembered for a while) and counts consumer underruns, and derives the smallest buffer that
+ * covers both. Growing is allowed quickly, shrinking only after a long stable period, and renegotiations
+ * are rate limited because every one of them restarts the graph.
+ *
+ * Callbacks are reported from the streaming thread, underruns from the consumer thread and decisions are
+ * polled from the game thread.
+ */
+class FDirectShowMediaAudioBufferController
+{
+public:
+
+	/** Default constructor. */
+	FDirectShowMediaAudioBufferController();
+
+public:
+
+	/**
+	 * Start over with the given device buffer size.
+	 *
+	 * @param InBufferMs The buffer size the device was set up with (in milliseconds).
+	 * @param InMinBufferMs Smallest buffer the controller may pick.
+	 * @param InMaxBufferMs Largest buffer the controller may pick.
+	 * @param bInAdaptive Whether renegotiations should be requested at all.
+	 */
+	void Reset(float InBufferMs, float InMinBufferMs, float InMaxBufferMs, bool bInAdaptive);
+
+	/**
+	 * Record the arrival of an audio buffer.
+	 *
+	 * @param ArrivalTime Wall clock time of the callback (in seconds).
+	 * @param BufferPeriod Duration of the audio in the buffer (in seconds).
+	 */
+	void AddCallback(double ArrivalTime, double BufferPeriod);
+
+	/** Record that the consumer ran out of audio. */
+	void AddUnderrun();
+
+	/**
+	 * Check whether the device buffer should be renegotiated.
+	 *
+	 * @param Now Wall clock time (in seconds).
+	 * @param OutBufferMs Will contain the new buffer size.
+	 * @return true if a renegotiation is due, false otherwise.
+	 * @see OnRenegotiated
+	 */
+	bool PollRenegotiation(double Now, float& OutBufferMs);
+
+	/**
+	 * Notify the controller that the device buffer was changed.
+	 *
+	 * @param Now Wall clock time (in seconds).
+	 * @param BufferMs The new buffer size (in milliseconds).
+	 */
+	void OnRenegotiated(double Now, float BufferMs);
+
+	/**
+	 * Get the number of buffers to keep queued on our side before old ones are dropped.
+	 *
+	 * @param Now Wall clock time (in seconds).
+	 * @return Queue depth (at least one).
+	 */
+	int32 GetJitterBufferDepth(double Now) const;
+
+	/** Get the current device buffer size (in milliseconds). */
+	float GetBufferMs() const
+	{
+		return BufferMs.load(std::memory_order_relaxed);
+	}
+
+	/** Get the peak callback jitter (in milliseconds). */
+	float GetJitterMs() const;
+
+	/** Get the number of consumer underruns. */
+	uint32 GetNumUnderruns() const
+	{
+		return NumUnderruns.load(std::memory_order_relaxed);
+	}
+
+	/** Get the number of renegotiations. */
+	uint32 GetNumRenegotiations() const
+	{
+		return NumRenegotiations;
+	}
+
+private:
+
+	/** Compute the buffer size the given jitter calls for. */
+	float ComputeTargetBufferMs(double Now, double Jitter) const;
+
+private:
+
+	/** Synchronizes measurements between the streaming and game threads. */
+	mutable FCriticalSection CriticalSection;
+
+	/** Whether renegotiations are requested. */
+	bool bAdaptive;
+
+	/** Current device buffer size (in milliseconds). */
+	std::atomic<float> BufferMs;
+
+	/** Smallest buffer size that may be picked (in milliseconds). */
+	float MinBufferMs;
+
+	/** Largest buffer size that may be picked (in milliseconds). */
+	float MaxBufferMs;
+
+	/** Arrival time of the previous callback, or a negative value if unknown. */
+	double LastArrivalTime;
+
+	/** Expected interval until the next callback (in seconds). */
+	double LastBufferPeriod;
+
+	/** Decaying peak of the callback arrival jitter (in seconds). */
+	double PeakJitter;
+
+	/** Largest jitter in the current and the previous shrink window (in seconds). */
+	double WindowJitter[2];
+
+	/** Start time of the current shrink window. */
+	double WindowStart;
+
+	/** Time of the first callback measured after a reset or renegotiation, or a negative value. */
+	double ObservationStart;
+
+	/** Extra buffering added after underruns (in milliseconds). */
+	double UnderrunPenaltyMs;
+
+	/** Time of the last underrun that was accounted for. */
+	double LastUnderrunTime;
+
+	/** Time of the last renegotiation. */
+	double LastRenegotiationTime;
+
+	/** Number of underruns that haven't been accounted for yet. */
+	std::atomic<uint32> PendingUnderruns;
+
+	/** Total number of underruns. */
+	std::atomic<uint32> NumUnderruns;
+
+	/** Total number of renegotiations. */
+	uint32 NumRenegotiations;
+};
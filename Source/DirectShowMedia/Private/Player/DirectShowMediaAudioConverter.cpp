@@ -0,0 +1,531 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "DirectShowMediaAudioConverter.h"
+
+#include "HAL/UnrealMemory.h"
+#include "Math/UnrealMathUtility.h"
+#include "Math/VectorRegister.h"
+
+
+/* number of filter taps per output sample (multiple of four for the vector kernel) */
+#define AUDIO_CONVERTER_NUM_TAPS 32
+/* number of filter phases between two input samples */
+#define AUDIO_CONVERTER_NUM_PHASES 256
+/* Kaiser window shape, ~80 dB stop band attenuation */
+#define AUDIO_CONVERTER_KAISER_BETA 8.0
+/* pass band edge relative to the lower Nyquist frequency, leaves room for the transition band */
+#define AUDIO_CONVERTER_CUTOFF 0.92
+/* most channels the converter handles */
+#define AUDIO_CONVERTER_MAX_CHANNELS 8
+/* input frames decoded at a time before they are remapped, sized for the stack */
+#define AUDIO_CONVERTER_BLOCK_FRAMES 128
+
+
+namespace DirectShowMediaAudioConverter
+{
+	/** Zeroth order modified Bessel function of the first kind, used by the Kaiser window. */
+	double BesselI0(double X)
+	{
+		double Sum = 1.0;
+		double Term = 1.0;
+		const double HalfX = 0.5 * X;
+
+		for (int32 K = 1; K < 32; ++K)
+		{
+			Term *= (HalfX / K) * (HalfX / K);
+			Sum += Term;
+
+			if (Term < Sum * 1.0e-12)
+			{
+				break;
+			}
+		}
+
+		return Sum;
+	}
+
+	/** Dot product of one filter row with the input window. */
+	FORCEINLINE float DotProduct(const float* RESTRICT Samples, const float* RESTRICT Row)
+	{
+		VectorRegister4Float Acc0 = VectorZeroFloat();
+		VectorRegister4Float Acc1 = VectorZeroFloat();
+
+		for (int32 Tap = 0; Tap < AUDIO_CONVERTER_NUM_TAPS; Tap += 8)
+		{
+			Acc0 = VectorMultiplyAdd(VectorLoad(Samples + Tap), VectorLoad(Row + Tap), Acc0);
+			Acc1 = VectorMultiplyAdd(VectorLoad(Samples + Tap + 4), VectorLoad(Row + Tap + 4), Acc1);
+		}
+
+		alignas(16) float Lanes[4];
+		VectorStoreAligned(VectorAdd(Acc0, Acc1), Lanes);
+
+		return (Lanes[0] + Lanes[1]) + (Lanes[2] + Lanes[3]);
+	}
+
+	/**
+	 * Convert interleaved input samples to float.
+	 *
+	 * The format is resolved once per call. 16 and 32 bit integers are converted four or eight at a time,
+	 * 8 and 24 bit samples (which have no vector load) one at a time.
+	 */
+	void DecodeSamples(EMediaAudioSampleFormat Format, uint32 BytesPerSample, const uint8* RESTRICT Input, uint32 NumSamples, float* RESTRICT Output)
+	{
+		uint32 Index = 0;
+
+		switch (BytesPerSample)
+		{
+		case 1:
+			for (; Index < NumSamples; ++Index)
+			{
+				Output[Index] = ((int32)Input[Index] - 128) * (1.0f / 128.0f);
+			}
+			break;
+
+		case 2:
+			{
+				const VectorRegister4Float Scale = VectorSetFloat1(1.0f / 32768.0f);
+
+				// each 32 bit lane holds two samples, the even one in its low half
+				for (; Index + 8 <= NumSamples; Index += 8)
+				{
+					const VectorRegister4Int Pairs = VectorIntLoad(Input + Index * 2);
+					const VectorRegister4Float Even = VectorMultiply(VectorIntToFloat(VectorShiftRightImmArithmetic(VectorShiftLeftImm(Pairs, 16), 16)), Scale);
+					const VectorRegister4Float Odd = VectorMultiply(VectorIntToFloat(VectorShiftRightImmArithmetic(Pairs, 16)), Scale);
+
+					VectorStore(VectorSwizzle(VectorShuffle(Even, Odd, 0, 1, 0, 1), 0, 2, 1, 3), Output + Index);
+					VectorStore(VectorSwizzle(VectorShuffle(Even, Odd, 2, 3, 2, 3), 0, 2, 1, 3), Output + Index + 4);
+				}
+
+				for (; Index < NumSamples; ++Index)
+				{
+					int16 Value;
+					FMemory::Memcpy(&Value, Input + Index * 2, sizeof(Value));
+
+					Output[Index] = Value * (1.0f / 32768.0f);
+				}
+			}
+			break;
+
+		case 3:
+			for (; Index < NumSamples; ++Index, Input += 3)
+			{
+				const int32 Value = (int32)(((uint32)Input[0] << 8) | ((uint32)Input[1] << 16) | ((uint32)Input[2] << 24)) >> 8;
+				Output[Index] = Value * (1.0f / 8388608.0f);
+			}
+			break;
+
+		case 4:
+			if (Format == EMediaAudioSampleFormat::Float)
+			{
+				FMemory::Memcpy(Output, Input, NumSamples * sizeof(float));
+			}
+			else
+			{
+				const VectorRegister4Float Scale = VectorSetFloat1(1.0f / 2147483648.0f);
+
+				for (; Index + 4 <= NumSamples; Index += 4)
+				{
+					VectorStore(VectorMultiply(VectorIntToFloat(VectorIntLoad(Input + Index * 4)), Scale), Output + Index);
+				}
+
+				for (; Index < NumSamples; ++Index)
+				{
+					int32 Value;
+					FMemory::Memcpy(&Value, Input + Index * 4, sizeof(Value));
+
+					Output[Index] = Value * (1.0f / 2147483648.0f);
+				}
+			}
+			break;
+
+		default:
+			FMemory::Memzero(Output, NumSamples * sizeof(float));
+			break;
+		}
+	}
+
+	/** Remap decoded frames to the output channels (OutputChannels x InputChannels gains). */
+	void MixFrames(const float* RESTRICT Input, uint32 NumFrames, uint32 InputChannels, const float* RESTRICT Gains, uint32 OutputChannels, float* RESTRICT Output)
+	{
+		for (uint32 Frame = 0; Frame < NumFrames; ++Frame, Input += InputChannels)
+		{
+			const float* ChannelGains = Gains;
+
+			for (uint32 OutChannel = 0; OutChannel < OutputChannels; ++OutChannel, ChannelGains += InputChannels)
+			{
+				float Value = 0.0f;
+
+				for (uint32 InChannel = 0; InChannel < InputChannels; ++InChannel)
+				{
+					Value += ChannelGains[InChannel] * Input[InChannel];
+				}
+
+				*Output++ = Value;
+			}
+		}
+	}
+}
+
+
+/* FDirectShowMediaAudioConverter structors
+ *****************************************************************************/
+
+FDirectShowMediaAudioConverter::FDirectShowMediaAudioConverter()
+	: InputFormat(EMediaAudioSampleFormat::Undefined)
+	, InputBytesPerSample(0)
+	, InputChannels(0)
+	, InputSampleRate(0)
+	, OutputChannels(0)
+	, OutputSampleRate(0)
+	, bIdentityMix(true)
+	, PlaneStride(0)
+	, PlaneCount(0)
+	, ReadIndex(0)
+	, ReadRemainder(0)
+{ }
+
+
+/* FDirectShowMediaAudioConverter interface
+ *****************************************************************************/
+
+bool FDirectShowMediaAudioConverter::IsSupportedFormat(EMediaAudioSampleFormat Format, uint32 BitsPerSample)
+{
+	if (Format == EMediaAudioSampleFormat::Float)
+	{
+		return (BitsPerSample == 32);
+	}
+
+	if (Format == EMediaAudioSampleFormat::Double)
+	{
+		return false;
+	}
+
+	// 24 bit PCM has no sample format of its own
+	return (BitsPerSample == 8) || (BitsPerSample == 16) || (BitsPerSample == 24) || (BitsPerSample == 32);
+}
+
+
+bool FDirectShowMediaAudioConverter::Configure(EMediaAudioSampleFormat InFormat, uint32 InBitsPerSample, uint32 InChannels, uint32 InSampleRate, uint32 InOutputChannels, uint32 InOutputSampleRate)
+{
+	const uint32 NewOutputChannels = (InOutputChannels > 0) ? InOutputChannels : InChannels;
+	const uint32 NewOutputSampleRate = (InOutputSampleRate > 0) ? InOutputSampleRate : InSampleRate;
+
+	if (IsConfigured() && (InputFormat == InFormat) && (InputBytesPerSample * 8 == InBitsPerSample) && (InputChannels == InChannels) &&
+		(InputSampleRate == InSampleRate) && (OutputChannels == NewOutputChannels) && (OutputSampleRate == NewOutputSampleRate))
+	{
+		return true;
+	}
+
+	InputChannels = 0;
+
+	if (!IsSupportedFormat(InFormat, InBitsPerSample) || (InChannels == 0) || (InChannels > AUDIO_CONVERTER_MAX_CHANNELS) ||
+		(NewOutputChannels > AUDIO_CONVERTER_MAX_CHANNELS) || (InSampleRate == 0))
+	{
+		return false;
+	}
+
+	InputFormat = InFormat;
+	InputBytesPerSample = InBitsPerSample / 8;
+	InputChannels = InChannels;
+	InputSampleRate = InSampleRate;
+	OutputChannels = NewOutputChannels;
+	OutputSampleRate = NewOutputSampleRate;
+
+	// mono is spread to all outputs, downmixing to mono averages, anything else maps channels by index
+	bIdentityMix = (InputChannels == OutputChannels);
+	MixMatrix.SetNumZeroed(OutputChannels * InputChannels);
+
+	for (uint32 OutChannel = 0; OutChannel < OutputChannels; ++OutChannel)
+	{
+		float* Gains = MixMatrix.GetData() + OutChannel * InputChannels;
+
+		if (InputChannels == 1)
+		{
+			Gains[0] = 1.0f;
+		}
+		else if (OutputChannels == 1)
+		{
+			for (uint32 InChannel = 0; InChannel < InputChannels; ++InChannel)
+			{
+				Gains[InChannel] = 1.0f / InputChannels;
+			}
+		}
+		else if (OutChannel < InputChannels)
+		{
+			Gains[OutChannel] = 1.0f;
+		}
+	}
+
+	if (InputSampleRate != OutputSampleRate)
+	{
+		BuildFilter();
+
+		// room for 100 ms of input, larger device buffers grow the planes once
+		PlaneStride = AUDIO_CONVERTER_NUM_TAPS * 2 + InputSampleRate / 10;
+		Planes.SetNumZeroed(PlaneStride * OutputChannels);
+	}
+	else
+	{
+		Coefficients.Empty();
+		Planes.Empty();
+		PlaneStride = 0;
+	}
+
+	Reset();
+
+	return true;
+}
+
+
+uint32 FDirectShowMediaAudioConverter::Convert(const uint8* InBuffer, uint32 InSize, TArray<uint8>& OutBuffer)
+{
+	OutBuffer.Reset();
+
+	if (!IsConfigured() || (InBuffer == nullptr))
+	{
+		return 0;
+	}
+
+	const uint32 NumFrames = InSize / (InputBytesPerSample * InputChannels);
+
+	if (NumFrames == 0)
+	{
+		return 0;
+	}
+
+	if (InputSampleRate == OutputSampleRate)
+	{
+		OutBuffer.AddUninitialized(NumFrames * OutputChannels * sizeof(float));
+		ConvertDirect(InBuffer, NumFrames, reinterpret_cast<float*>(OutBuffer.GetData()));
+
+		return NumFrames;
+	}
+
+	// make room for the new input, only happens when the device delivers a larger buffer than before
+	if (PlaneCount + (int32)NumFrames > PlaneStride)
+	{
+		const int32 NewStride = PlaneCount + (int32)NumFrames + AUDIO_CONVERTER_NUM_TAPS;
+		TArray<float> NewPlanes;
+		NewPlanes.SetNumZeroed(NewStride * OutputChannels);
+
+		for (uint32 Channel = 0; Channel < OutputChannels; ++Channel)
+		{
+			FMemory::Memcpy(NewPlanes.GetData() + Channel * NewStride, Planes.GetData() + Channel * PlaneStride, PlaneCount * sizeof(float));
+		}
+
+		Planes = MoveTemp(NewPlanes);
+		PlaneStride = NewStride;
+	}
+
+	Deinterleave(InBuffer, NumFrames, PlaneCount);
+	PlaneCount += NumFrames;
+
+	// exact number of output frames whose filter window is fully buffered
+	const int32 LastCenter = PlaneCount - 1 - AUDIO_CONVERTER_NUM_TAPS / 2;
+	uint32 NumOutputFrames = 0;
+
+	if (LastCenter >= ReadIndex)
+	{
+		const uint64 Span = (uint64)(LastCenter - ReadIndex + 1) * OutputSampleRate - ReadRemainder;
+		NumOutputFrames = (uint32)((Span + InputSampleRate - 1) / InputSampleRate);
+	}
+
+	if (NumOutputFrames > 0)
+	{
+		OutBuffer.AddUninitialized(NumOutputFrames * OutputChannels * sizeof(float));
+		Resample(reinterpret_cast<float*>(OutBuffer.GetData()), NumOutputFrames);
+	}
+
+	// drop the input that no longer falls into any future filter window
+	const int32 NumConsumed = ReadIndex - (AUDIO_CONVERTER_NUM_TAPS / 2 - 1);
+
+	if (NumConsumed > 0)
+	{
+		for (uint32 Channel = 0; Channel < OutputChannels; ++Channel)
+		{
+			float* Plane = Planes.GetData() + Channel * PlaneStride;
+			FMemory::Memmove(Plane, Plane + NumConsumed, (PlaneCount - NumConsumed) * sizeof(float));
+		}
+
+		PlaneCount -= NumConsumed;
+		ReadIndex -= NumConsumed;
+	}
+
+	return NumOutputFrames;
+}
+
+
+void FDirectShowMediaAudioConverter::Reset()
+{
+	if (PlaneStride == 0)
+	{
+		return;
+	}
+
+	// prime the filter with silence so the output is delayed by exactly half the filter length
+	PlaneCount = AUDIO_CONVERTER_NUM_TAPS - 1;
+	ReadIndex = AUDIO_CONVERTER_NUM_TAPS / 2 - 1;
+	ReadRemainder = 0;
+
+	FMemory::Memzero(Planes.GetData(), Planes.Num() * sizeof(float));
+}
+
+
+FTimespan FDirectShowMediaAudioConverter::GetLatency() const
+{
+	if ((PlaneStride == 0) || (InputSampleRate == 0))
+	{
+		return FTimespan::Zero();
+	}
+
+	return FTimespan((int64)(AUDIO_CONVERTER_NUM_TAPS / 2) * ETimespan::TicksPerSecond / InputSampleRate);
+}
+
+
+/* FDirectShowMediaAudioConverter implementation
+ *****************************************************************************/
+
+void FDirectShowMediaAudioConverter::Deinterleave(const uint8* InBuffer, uint32 NumFrames, int32 PlaneOffset)
+{
+	const uint32 FrameSize = InputBytesPerSample * InputChannels;
+
+	float Decoded[AUDIO_CONVERTER_BLOCK_FRAMES * AUDIO_CONVERTER_MAX_CHANNELS];
+	float Mixed[AUDIO_CONVERTER_BLOCK_FRAMES * AUDIO_CONVERTER_MAX_CHANNELS];
+
+	for (uint32 BlockStart = 0; BlockStart < NumFrames; BlockStart += AUDIO_CONVERTER_BLOCK_FRAMES)
+	{
+		const uint32 BlockFrames = FMath::Min<uint32>(NumFrames - BlockStart, AUDIO_CONVERTER_BLOCK_FRAMES);
+		const float* Frames = Decoded;
+
+		DirectShowMediaAudioConverter::DecodeSamples(InputFormat, InputBytesPerSample, InBuffer + BlockStart * FrameSize, BlockFrames * InputChannels, Decoded);
+
+		if (!bIdentityMix)
+		{
+			DirectShowMediaAudioConverter::MixFrames(Decoded, BlockFrames, InputChannels, MixMatrix.GetData(), OutputChannels, Mixed);
+			Frames = Mixed;
+		}
+
+		// the planes are read by the filter, one channel at a time
+		for (uint32 Channel = 0; Channel < OutputChannels; ++Channel)
+		{
+			float* RESTRICT Plane = Planes.GetData() + Channel * PlaneStride + PlaneOffset + BlockStart;
+			const float* RESTRICT Source = Frames + Channel;
+
+			for (uint32 Frame = 0; Frame < BlockFrames; ++Frame)
+			{
+				Plane[Frame] = Source[Frame * OutputChannels];
+			}
+		}
+	}
+}
+
+
+void FDirectShowMediaAudioConverter::ConvertDirect(const uint8* InBuffer, uint32 NumFrames, float* Output) const
+{
+	const uint32 FrameSize = InputBytesPerSample * InputChannels;
+
+	if (bIdentityMix)
+	{
+		DirectShowMediaAudioConverter::DecodeSamples(InputFormat, InputBytesPerSample, InBuffer, NumFrames * InputChannels, Output);
+		return;
+	}
+
+	float Decoded[AUDIO_CONVERTER_BLOCK_FRAMES * AUDIO_CONVERTER_MAX_CHANNELS];
+
+	for (uint32 BlockStart = 0; BlockStart < NumFrames; BlockStart += AUDIO_CONVERTER_BLOCK_FRAMES)
+	{
+		const uint32 BlockFrames = FMath::Min<uint32>(NumFrames - BlockStart, AUDIO_CONVERTER_BLOCK_FRAMES);
+
+		DirectShowMediaAudioConverter::DecodeSamples(InputFormat, InputBytesPerSample, InBuffer + BlockStart * FrameSize, BlockFrames * InputChannels, Decoded);
+		DirectShowMediaAudioConverter::MixFrames(Decoded, BlockFrames, InputChannels, MixMatrix.GetData(), OutputChannels, Output + BlockStart * OutputChannels);
+	}
+}
+
+
+uint32 FDirectShowMediaAudioConverter::Resample(float* Output, uint32 MaxFrames)
+{
+	const float* Rows = Coefficients.GetData();
+
+	for (uint32 Frame = 0; Frame < MaxFrames; ++Frame)
+	{
+		// pick the two nearest filter phases for the fractional read position
+		const uint64 PhasePosition = (uint64)ReadRemainder * AUDIO_CONVERTER_NUM_PHASES;
+		const uint32 Phase = (uint32)(PhasePosition / OutputSampleRate);
+		const float Blend = (float)(PhasePosition % OutputSampleRate) / (float)OutputSampleRate;
+
+		const float* Row0 = Rows + Phase * AUDIO_CONVERTER_NUM_TAPS;
+		const float* Row1 = Row0 + AUDIO_CONVERTER_NUM_TAPS;
+		const int32 WindowStart = ReadIndex - (AUDIO_CONVERTER_NUM_TAPS / 2 - 1);
+
+		for (uint32 Channel = 0; Channel < OutputChannels; ++Channel)
+		{
+			const float* Window = Planes.GetData() + Channel * PlaneStride + WindowStart;
+			const float Value0 = DirectShowMediaAudioConverter::DotProduct(Window, Row0);
+			const float Value1 = DirectShowMediaAudioConverter::DotProduct(Window, Row1);
+
+			*Output++ = Value0 + Blend * (Value1 - Value0);
+		}
+
+		// advance by InputSampleRate / OutputSampleRate input samples without accumulating rounding errors
+		ReadRemainder += InputSampleRate;
+
+		while (ReadRemainder >= OutputSampleRate)
+		{
+			ReadRemainder -= OutputSampleRate;
+			++ReadIndex;
+		}
+	}
+
+	return MaxFrames;
+}
+
+
+void FDirectShowMediaAudioConverter::BuildFilter()
+{
+	const int32 HalfTaps = AUDIO_CONVERTER_NUM_TAPS / 2;
+	const double Cutoff = AUDIO_CONVERTER_CUTOFF * FMath::Min(1.0, (double)OutputSampleRate / (double)InputSampleRate);
+	const double WindowScale = 1.0 / DirectShowMediaAudioConverter::BesselI0(AUDIO_CONVERTER_KAISER_BETA);
+
+	Coefficients.SetNumUninitialized((AUDIO_CONVERTER_NUM_PHASES + 1) * AUDIO_CONVERTER_NUM_TAPS);
+
+	for (int32 Phase = 0; Phase <= AUDIO_CONVERTER_NUM_PHASES; ++Phase)
+	{
+		float* Row = Coefficients.GetData() + Phase * AUDIO_CONVERTER_NUM_TAPS;
+		const double Fraction = (double)Phase / AUDIO_CONVERTER_NUM_PHASES;
+		double Sum = 0.0;
+
+		for (int32 Tap = 0; Tap < AUDIO_CONVERTER_NUM_TAPS; ++Tap)
+		{
+			// distance between the tap's input sample and the output position
+			const double Distance = Fraction + (HalfTaps - 1 - Tap);
+			const double Relative = Distance / HalfTaps;
+			double Value = 0.0;
+
+			if (FMath::Abs(Relative) < 1.0)
+			{
+				const double X = PI * Cutoff * Distance;
+				const double Sinc = (FMath::Abs(X) < 1.0e-9) ? 1.0 : FMath::Sin(X) / X;
+				const double Window = DirectShowMediaAudioConverter::BesselI0(AUDIO_CONVERTER_KAISER_BETA * FMath::Sqrt(1.0 - Relative * Relative)) * WindowScale;
+
+				Value = Cutoff * Sinc * Window;
+			}
+
+			Row[Tap] = (float)Value;
+			Sum += Value;
+		}
+
+		// unity gain at DC for every phase
+		for (int32 Tap = 0; Tap < AUDIO_CONVERTER_NUM_TAPS; ++Tap)
+		{
+			Row[Tap] = (float)(Row[Tap] / Sum);
+		}
+	}
+}
+
+
+#undef AUDIO_CONVERTER_NUM_TAPS
+#undef AUDIO_CONVERTER_NUM_PHASES
+#undef AUDIO_CONVERTER_KAISER_BETA
+#undef AUDIO_CONVERTER_CUTOFF
+#undef AUDIO_CONVERTER_MAX_CHANNELS
+#undef AUDIO_CONVERTER_BLOCK_FRAMES
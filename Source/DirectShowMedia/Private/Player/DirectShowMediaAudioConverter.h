@@ -0,0 +1,143 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreTypes.h"
+#include "Containers/Array.h"
+#include "IMediaAudioSample.h"
+#include "Misc/Timespan.h"
+
+
+/**
+ * Streaming audio format converter.
+ *
+ * Turns the capture device's PCM buffers (8/16/24/32 bit integer or 32 bit float) into interleaved 32 bit
+ * float, remaps the channel layout and resamples to the requested output rate with a polyphase windowed
+ * sinc filter, so that the engine's mixer receives audio it can consume without converting it again.
+ *
+ * The converter keeps the filter history between buffers, so it must be fed one contiguous stream. All
+ * working memory is allocated in Configure; converting buffers of a steady size doesn't allocate.
+ */
+class FDirectShowMediaAudioConverter
+{
+public:
+
+	/** Default constructor. */
+	FDirectShowMediaAudioConverter();
+
+public:
+
+	/**
+	 * Check whether the converter can read the given input format.
+	 *
+	 * @param Format The sample format reported by the device.
+	 * @param BitsPerSample Number of bits per sample reported by the device.
+	 * @return true if the format is supported, false otherwise.
+	 */
+	static bool IsSupportedFormat(EMediaAudioSampleFormat Format, uint32 BitsPerSample);
+
+	/**
+	 * Set up the conversion, resetting the stream if anything changed.
+	 *
+	 * @param InFormat Input sample format.
+	 * @param InBitsPerSample Input bits per sample (needed to tell 24 bit PCM apart).
+	 * @param InChannels Number of input channels.
+	 * @param InSampleRate Input sample rate.
+	 * @param InOutputChannels Number of output channels, or zero to keep the input layout.
+	 * @param InOutputSampleRate Output sample rate, or zero to keep the input rate.
+	 * @return true if the conversion is supported, false otherwise.
+	 */
+	bool Configure(EMediaAudioSampleFormat InFormat, uint32 InBitsPerSample, uint32 InChannels, uint32 InSampleRate, uint32 InOutputChannels, uint32 InOutputSampleRate);
+
+	/**
+	 * Convert the next buffer of the stream.
+	 *
+	 * @param InBuffer The input buffer.
+	 * @param InSize Size of the input buffer (in bytes).
+	 * @param OutBuffer Will contain the interleaved float output (existing allocation is reused).
+	 * @return Number of output frames written.
+	 */
+	uint32 Convert(const uint8* InBuffer, uint32 InSize, TArray<uint8>& OutBuffer);
+
+	/** Forget the filter history, i.e. after a discontinuity. */
+	void Reset();
+
+	/** Get the number of output channels. */
+	uint32 GetOutputChannels() const
+	{
+		return OutputChannels;
+	}
+
+	/** Get the output sample rate. */
+	uint32 GetOutputSampleRate() const
+	{
+		return OutputSampleRate;
+	}
+
+	/** Get the delay the resampling filter adds to the stream. */
+	FTimespan GetLatency() const;
+
+	/** Whether Configure succeeded. */
+	bool IsConfigured() const
+	{
+		return (InputChannels > 0);
+	}
+
+private:
+
+	/** Decode and remap interleaved input frames into the channel planes, starting at the given plane offset. */
+	void Deinterleave(const uint8* InBuffer, uint32 NumFrames, int32 PlaneOffset);
+
+	/** Decode and remap interleaved input frames straight into the interleaved output. */
+	void ConvertDirect(const uint8* InBuffer, uint32 NumFrames, float* Output) const;
+
+	/** Run the polyphase filter over the buffered input. */
+	uint32 Resample(float* Output, uint32 MaxFrames);
+
+	/** Build the filter coefficients for the current rates. */
+	void BuildFilter();
+
+private:
+
+	/** Input sample format. */
+	EMediaAudioSampleFormat InputFormat;
+
+	/** Input sample size (in bytes). */
+	uint32 InputBytesPerSample;
+
+	/** Number of input channels. */
+	uint32 InputChannels;
+
+	/** Input sample rate. */
+	uint32 InputSampleRate;
+
+	/** Number of output channels. */
+	uint32 OutputChannels;
+
+	/** Output sample rate. */
+	uint32 OutputSampleRate;
+
+	/** Whether the channel layout is passed through unchanged. */
+	bool bIdentityMix;
+
+	/** Output channel gains per input channel (OutputChannels x InputChannels). */
+	TArray<float> MixMatrix;
+
+	/** Filter coefficients, one row of NumTaps per phase (plus one extra row for interpolation). */
+	TArray<float> Coefficients;
+
+	/** Buffered input, one plane per output channel, each PlaneStride long. */
+	TArray<float> Planes;
+
+	/** Length of each channel plane. */
+	int32 PlaneStride;
+
+	/** Number of valid samples in each plane. */
+	int32 PlaneCount;
+
+	/** Plane index of the input sample the next output frame is centered on. */
+	int32 ReadIndex;
+
+	/** Fractional read position, in units of 1 / OutputSampleRate input samples. */
+	uint32 ReadRemainder;
+};
@@ -4,6 +4,7 @@
 
 #include "CoreTypes.h"
 #include "Containers/Array.h"
+#include "DirectShowMediaAudioConverter.h"
 #include "IMediaAudioSample.h"
 #include "MediaObjectPool.h"
 #include "MediaSampleQueue.h"
@@ -24,6 +25,7 @@ public:
 	FDirectShowMediaAudioSample()
 		: Channels(0)
 		, Duration(FTimespan::Zero())
+		, Format(EMediaAudioSampleFormat::Undefined)
 		, SampleRate(0)
 		, Time(FTimespan::Zero())
 	{ }
@@ -67,6 +69,38 @@ public:
 		return true;
 	}
 
+	/**
+	 * Initialize the sample from a converted device buffer.
+	 *
+	 * The converter writes straight into the sample's buffer, so recycled samples don't allocate.
+	 *
+	 * @param Converter The converter set up for the device's format.
+	 * @param InBuffer The device's data buffer.
+	 * @param InSize The size of the device buffer (in bytes).
+	 * @param InTime The sample time (relative to presentation clock).
+	 * @param InDuration The duration for which the sample is valid.
+	 */
+	bool Initialize(
+		FDirectShowMediaAudioConverter& Converter,
+		const uint8* InBuffer,
+		uint32 InSize,
+		FTimespan InTime,
+		FTimespan InDuration)
+	{
+		if (Converter.Convert(InBuffer, InSize, Buffer) == 0)
+		{
+			return false;
+		}
+
+		Format = EMediaAudioSampleFormat::Float;
+		Channels = Converter.GetOutputChannels();
+		Duration = InDuration;
+		SampleRate = Converter.GetOutputSampleRate();
+		Time = InTime;
+
+		return true;
+	}
+
 public:
 
 	//~ IMediaAudioSample interface
@@ -93,7 +127,25 @@ public:
 
 	virtual uint32 GetFrames() const override
 	{
-		return Buffer.Num() / (Channels * sizeof(int16));
+		uint32 BytesPerSample;
+
+		switch (Format)
+		{
+		case EMediaAudioSampleFormat::Int8:
+			BytesPerSample = 1;
+			break;
+		case EMediaAudioSampleFormat::Int16:
+			BytesPerSample = 2;
+			break;
+		case EMediaAudioSampleFormat::Double:
+			BytesPerSample = 8;
+			break;
+		default:
+			BytesPerSample = 4;
+			break;
+		}
+
+		return (Channels > 0) ? Buffer.Num() / (Channels * BytesPerSample) : 0;
 	}
 
 	virtual uint32 GetSampleRate() const override
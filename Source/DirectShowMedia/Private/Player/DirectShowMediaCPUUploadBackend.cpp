@@ -0,0 +1,151 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "DirectShowMediaCPUUploadBackend.h"
+
+#include "Math/UnrealMathUtility.h"
+#include "Misc/ScopeLock.h"
+
+
+/* FDirectShowMediaCPUUploadBackend structors
+ *****************************************************************************/
+
+FDirectShowMediaCPUUploadBackend::FDirectShowMediaCPUUploadBackend(uint32 InPitchAlignment, bool bInDeferMapping)
+	: PitchAlignment(FMath::Max(1u, InPitchAlignment))
+	, bDeferMapping(bInDeferMapping)
+	, Pitch(0)
+{ }
+
+
+/* FDirectShowMediaCPUUploadBackend interface
+ *****************************************************************************/
+
+void FDirectShowMediaCPUUploadBackend::SignalFences()
+{
+	FScopeLock Lock(&CriticalSection);
+
+	for (FSlot& Slot : Slots)
+	{
+		if (Slot.bMapPending)
+		{
+			Slot.bMapPending = false;
+			Slot.bMapped = true;
+			++Slot.NumMaps;
+		}
+	}
+}
+
+
+const uint8* FDirectShowMediaCPUUploadBackend::GetUploadedData(int32 SlotIndex, uint32& OutStride) const
+{
+	FScopeLock Lock(&CriticalSection);
+
+	if (!Slots.IsValidIndex(SlotIndex) || (Slots[SlotIndex].NumSubmits == 0))
+	{
+		return nullptr;
+	}
+
+	OutStride = Pitch;
+
+	return Slots[SlotIndex].Uploaded.GetData();
+}
+
+
+int32 FDirectShowMediaCPUUploadBackend::GetNumSubmits(int32 SlotIndex) const
+{
+	FScopeLock Lock(&CriticalSection);
+	return Slots.IsValidIndex(SlotIndex) ? Slots[SlotIndex].NumSubmits : 0;
+}
+
+
+int32 FDirectShowMediaCPUUploadBackend::GetNumMaps(int32 SlotIndex) const
+{
+	FScopeLock Lock(&CriticalSection);
+	return Slots.IsValidIndex(SlotIndex) ? Slots[SlotIndex].NumMaps : 0;
+}
+
+
+/* IDirectShowMediaUploadBackend interface
+ *****************************************************************************/
+
+bool FDirectShowMediaCPUUploadBackend::CreateSlots(int32 NumSlots, const FIntPoint& Dim, EMediaTextureSampleFormat Format)
+{
+	// the same formats as the RHI backend, four bytes per texel
+	if ((Format != EMediaTextureSampleFormat::CharBGRA) && (Format != EMediaTextureSampleFormat::CharYUY2) && (Format != EMediaTextureSampleFormat::CharUYVY))
+	{
+		return false;
+	}
+
+	FScopeLock Lock(&CriticalSection);
+
+	Pitch = Align((uint32)Dim.X * 4, PitchAlignment);
+	Slots.SetNum(NumSlots);
+
+	for (FSlot& Slot : Slots)
+	{
+		Slot.Staging.SetNumZeroed(Pitch * Dim.Y);
+		Slot.Uploaded.SetNumZeroed(Pitch * Dim.Y);
+	}
+
+	return true;
+}
+
+
+void FDirectShowMediaCPUUploadBackend::ReleaseSlots()
+{
+	FScopeLock Lock(&CriticalSection);
+	Slots.Empty();
+}
+
+
+void FDirectShowMediaCPUUploadBackend::MapSlot(int32 SlotIndex)
+{
+	FScopeLock Lock(&CriticalSection);
+
+	FSlot& Slot = Slots[SlotIndex];
+
+	if (bDeferMapping)
+	{
+		Slot.bMapPending = true;
+	}
+	else
+	{
+		Slot.bMapped = true;
+		++Slot.NumMaps;
+	}
+}
+
+
+uint8* FDirectShowMediaCPUUploadBackend::GetMappedData(int32 SlotIndex, uint32& OutStride) const
+{
+	FScopeLock Lock(&CriticalSection);
+
+	const FSlot& Slot = Slots[SlotIndex];
+
+	if (!Slot.bMapped)
+	{
+		return nullptr;
+	}
+
+	OutStride = Pitch;
+
+	// the staging memory belongs to the writer while the slot is mapped
+	return const_cast<uint8*>(Slot.Staging.GetData());
+}
+
+
+void FDirectShowMediaCPUUploadBackend::SubmitSlot(int32 SlotIndex)
+{
+	FScopeLock Lock(&CriticalSection);
+
+	FSlot& Slot = Slots[SlotIndex];
+
+	Slot.bMapped = false;
+	Slot.Uploaded = Slot.Staging;
+	++Slot.NumSubmits;
+}
+
+
+FRHITexture* FDirectShowMediaCPUUploadBackend::GetTexture(int32 SlotIndex) const
+{
+	return nullptr;
+}
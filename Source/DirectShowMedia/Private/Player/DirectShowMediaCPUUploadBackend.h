@@ -0,0 +1,103 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreTypes.h"
+#include "Containers/Array.h"
+#include "HAL/CriticalSection.h"
+#include "IDirectShowMediaUploadBackend.h"
+
+
+/**
+ * Upload backend that keeps its slots in system memory.
+ *
+ * Each slot is a staging buffer and a "texture" buffer the staging memory is copied into when the slot is
+ * submitted. Rows are padded to a pitch alignment, like the lock pitch of a texture, so kernels writing into
+ * the ring see a stride that differs from the frame's. Mappings complete right away, or only once SignalFences
+ * is called, which stands in for the render thread catching up.
+ *
+ * The backend creates no textures; it drives the ring without an RHI (i.e. in automation tests).
+ */
+class FDirectShowMediaCPUUploadBackend
+	: public IDirectShowMediaUploadBackend
+{
+public:
+
+	/**
+	 * Create and initialize a new instance.
+	 *
+	 * @param InPitchAlignment Alignment of the staging rows (in bytes).
+	 * @param bInDeferMapping Whether mappings only complete in SignalFences.
+	 */
+	FDirectShowMediaCPUUploadBackend(uint32 InPitchAlignment, bool bInDeferMapping);
+
+public:
+
+	/** Complete the requested mappings. */
+	void SignalFences();
+
+	/**
+	 * Get the memory a slot was last uploaded from.
+	 *
+	 * @param SlotIndex The slot.
+	 * @param OutStride Will contain the number of bytes per row.
+	 * @return The memory, or nullptr if the slot was never submitted.
+	 */
+	const uint8* GetUploadedData(int32 SlotIndex, uint32& OutStride) const;
+
+	/** Number of times a slot was submitted. */
+	int32 GetNumSubmits(int32 SlotIndex) const;
+
+	/** Number of times a slot was mapped. */
+	int32 GetNumMaps(int32 SlotIndex) const;
+
+public:
+
+	//~ IDirectShowMediaUploadBackend interface
+
+	virtual bool CreateSlots(int32 NumSlots, const FIntPoint& Dim, EMediaTextureSampleFormat Format) override;
+	virtual void ReleaseSlots() override;
+	virtual void MapSlot(int32 SlotIndex) override;
+	virtual uint8* GetMappedData(int32 SlotIndex, uint32& OutStride) const override;
+	virtual void SubmitSlot(int32 SlotIndex) override;
+	virtual FRHITexture* GetTexture(int32 SlotIndex) const override;
+
+private:
+
+	/** A slot's memory. */
+	struct FSlot
+	{
+		/** The staging memory. */
+		TArray<uint8> Staging;
+
+		/** The memory the staging memory was last uploaded into. */
+		TArray<uint8> Uploaded;
+
+		/** Whether the staging memory is mapped. */
+		bool bMapped = false;
+
+		/** Whether a mapping was requested and waits for SignalFences. */
+		bool bMapPending = false;
+
+		/** Number of times the slot was mapped. */
+		int32 NumMaps = 0;
+
+		/** Number of times the slot was submitted. */
+		int32 NumSubmits = 0;
+	};
+
+	/** Alignment of the staging rows (in bytes). */
+	uint32 PitchAlignment;
+
+	/** Whether mappings only complete in SignalFences. */
+	bool bDeferMapping;
+
+	/** Number of bytes per staging row. */
+	uint32 Pitch;
+
+	/** Protects the slots (the ring calls from the streaming thread and the releasing thread). */
+	mutable FCriticalSection CriticalSection;
+
+	/** The slots. */
+	TArray<FSlot> Slots;
+};
@@ -0,0 +1,673 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "DirectShowMediaCaptionDecoder.h"
+
+#include "HAL/UnrealMemory.h"
+#include "Math/UnrealMathUtility.h"
+
+
+namespace DirectShowMediaCaptionDecoder
+{
+	/** CEA-608 characters that differ from ASCII, indexed by code - 0x20 (0 where ASCII applies). */
+	static const uint16 BasicChars[96] =
+	{
+		0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x00E1, 0, 0, 0, 0, 0,
+		0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+		0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+		0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x00E9, 0, 0x00ED, 0x00F3,
+		0x00FA, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+		0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x00E7, 0x00F7, 0x00D1, 0x00F1, 0x2588
+	};
+
+	/** CEA-608 special characters (0x11 0x30-0x3F). */
+	static const uint16 SpecialChars[16] =
+	{
+		0x00AE, 0x00B0, 0x00BD, 0x00BF, 0x2122, 0x00A2, 0x00A3, 0x266A,
+		0x00E0, 0x0020, 0x00E8, 0x00E2, 0x00EA, 0x00EE, 0x00F4, 0x00FB
+	};
+
+	/** CEA-608 extended characters (0x12 0x20-0x3F, then 0x13 0x20-0x3F). */
+	static const uint16 ExtendedChars[64] =
+	{
+		0x00C1, 0x00C9, 0x00D3, 0x00DA, 0x00DC, 0x00FC, 0x2018, 0x00A1, 0x002A, 0x0027, 0x2014, 0x00A9, 0x2120, 0x2022, 0x201C, 0x201D,
+		0x00C0, 0x00C2, 0x00C7, 0x00C8, 0x00CA, 0x00CB, 0x00EB, 0x00CE, 0x00CF, 0x00EF, 0x00D4, 0x00D9, 0x00F9, 0x00DB, 0x00AB, 0x00BB,
+		0x00C3, 0x00E3, 0x00CD, 0x00CC, 0x00EC, 0x00D2, 0x00F2, 0x00D5, 0x00F5, 0x007B, 0x007D, 0x005C, 0x005E, 0x005F, 0x007C, 0x007E,
+		0x00C4, 0x00E4, 0x00D6, 0x00F6, 0x00DF, 0x00A5, 0x00A4, 0x00A6, 0x00C5, 0x00E5, 0x00D8, 0x00F8, 0x250C, 0x2510, 0x2514, 0x2518
+	};
+
+	/** Number of parameter bytes of the CEA-708 C1 commands (0x80-0x9F). */
+	static const uint8 C1ParameterCounts[32] =
+	{
+		0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 0, 0,
+		2, 3, 2, 0, 0, 0, 0, 4, 6, 6, 6, 6, 6, 6, 6, 6
+	};
+
+	/** Check the odd parity of a CEA-608 byte. */
+	FORCEINLINE bool HasOddParity(uint8 Byte)
+	{
+		Byte ^= Byte >> 4;
+		Byte ^= Byte >> 2;
+		Byte ^= Byte >> 1;
+
+		return (Byte & 1) != 0;
+	}
+
+	/** Find the '>' closing a tag whose name starts at Index, or INDEX_NONE. */
+	int32 FindTagEnd(const ANSICHAR* Text, int32 TextLength, int32 Index)
+	{
+		while (Index < TextLength)
+		{
+			const ANSICHAR Char = Text[Index];
+
+			if (Char == '>')
+			{
+				return Index;
+			}
+
+			if (Char != '=')
+			{
+				++Index;
+				continue;
+			}
+
+			// attribute value, which may contain '>' if quoted
+			if (++Index >= TextLength)
+			{
+				return INDEX_NONE;
+			}
+
+			const ANSICHAR Quote = Text[Index];
+
+			if ((Quote == '\'') || (Quote == '"'))
+			{
+				do
+				{
+					++Index;
+				}
+				while ((Index < TextLength) && (Text[Index] != Quote));
+
+				if (Index >= TextLength)
+				{
+					return INDEX_NONE;
+				}
+
+				++Index;
+			}
+			else
+			{
+				do
+				{
+					++Index;
+				}
+				while ((Index < TextLength) && (Text[Index] != '>') && (Text[Index] != ' ') && ((Text[Index] < '\t') || (Text[Index] > '\r')));
+			}
+		}
+
+		return INDEX_NONE;
+	}
+}
+
+
+/* FDirectShowMediaCaptionDecoder structors
+ *****************************************************************************/
+
+FDirectShowMediaCaptionDecoder::FDirectShowMediaCaptionDecoder()
+{
+	Reset();
+}
+
+
+/* FDirectShowMediaCaptionDecoder interface
+ *****************************************************************************/
+
+void FDirectShowMediaCaptionDecoder::Decode(EDirectShowMediaCaptionFormat Format, const uint8* Data, uint32 Size, FOnCaption OnCaption)
+{
+	using namespace DirectShowMediaCaptionDecoder;
+
+	if (Data == nullptr)
+	{
+		return;
+	}
+
+	switch (Format)
+	{
+	case EDirectShowMediaCaptionFormat::Text:
+		{
+			FCaptionMemory Memory;
+			int32 TextLength = 0;
+
+			while ((TextLength < (int32)Size) && (Data[TextLength] != 0))
+			{
+				++TextLength;
+			}
+
+			Memory.Length = StripMarkup((const ANSICHAR*)Data, TextLength, Memory.Chars, MaxCaptionLength);
+			Emit(Memory, OnCaption);
+		}
+		break;
+
+	case EDirectShowMediaCaptionFormat::CEA608:
+		for (uint32 Index = 0; Index + 1 < Size; Index += 2)
+		{
+			// pairs with transmission errors are dropped
+			if (HasOddParity(Data[Index]) && HasOddParity(Data[Index + 1]))
+			{
+				Decode608Pair(Data[Index] & 0x7f, Data[Index + 1] & 0x7f, OnCaption);
+			}
+		}
+		break;
+
+	case EDirectShowMediaCaptionFormat::CEA708:
+		for (uint32 Index = 0; Index + 2 < Size; Index += 3)
+		{
+			const uint8 Flags = Data[Index];
+
+			if ((Flags & 0x04) == 0)
+			{
+				continue; // cc_valid not set
+			}
+
+			switch (Flags & 0x03)
+			{
+			case 0: // 608 field 1
+				if (HasOddParity(Data[Index + 1]) && HasOddParity(Data[Index + 2]))
+				{
+					Decode608Pair(Data[Index + 1] & 0x7f, Data[Index + 2] & 0x7f, OnCaption);
+				}
+				break;
+
+			case 2: // caption channel packet data
+				if (Packet708Expected > 0)
+				{
+					Add708PacketByte(Data[Index + 1], OnCaption);
+					Add708PacketByte(Data[Index + 2], OnCaption);
+				}
+				break;
+
+			case 3: // caption channel packet start
+				{
+					if (Packet708Expected > 0)
+					{
+						Decode708Packet(OnCaption); // unterminated packet, decode what arrived
+					}
+
+					const int32 SizeCode = Data[Index + 1] & 0x3f;
+					Packet708Expected = (SizeCode == 0) ? 128 : SizeCode * 2;
+					Packet708Size = 0;
+
+					Add708PacketByte(Data[Index + 1], OnCaption);
+					Add708PacketByte(Data[Index + 2], OnCaption);
+				}
+				break;
+
+			default: // 608 field 2 carries CC3/CC4 and text services, which aren't shown
+				break;
+			}
+		}
+		break;
+
+	default:
+		break;
+	}
+
+	// paint-on captions update as they are drawn
+	if (bPaintOnChanged)
+	{
+		bPaintOnChanged = false;
+		Emit(Displayed608, OnCaption);
+	}
+}
+
+
+void FDirectShowMediaCaptionDecoder::Reset()
+{
+	Displayed608.Clear();
+	NonDisplayed608.Clear();
+	Mode608 = E608Mode::PopOn;
+	RollUpRows608 = 2;
+	bChannel1 = true;
+	bPaintOnChanged = false;
+	LastControl608 = 0;
+
+	Window708.Clear();
+	Packet708Size = 0;
+	Packet708Expected = 0;
+}
+
+
+int32 FDirectShowMediaCaptionDecoder::StripMarkup(const ANSICHAR* Text, int32 TextLength, TCHAR* OutText, int32 OutCapacity)
+{
+	int32 OutLength = 0;
+	int32 Index = 0;
+
+	if ((Text == nullptr) || (OutText == nullptr))
+	{
+		return 0;
+	}
+
+	while ((Index < TextLength) && (OutLength < OutCapacity))
+	{
+		if (Text[Index] == '<')
+		{
+			const int32 TagEnd = DirectShowMediaCaptionDecoder::FindTagEnd(Text, TextLength, Index + 1);
+
+			if (TagEnd != INDEX_NONE)
+			{
+				Index = TagEnd + 1;
+				continue;
+			}
+		}
+
+		OutText[OutLength++] = (TCHAR)(uint8)Text[Index++];
+	}
+
+	return OutLength;
+}
+
+
+/* FDirectShowMediaCaptionDecoder implementation
+ *****************************************************************************/
+
+void FDirectShowMediaCaptionDecoder::FCaptionMemory::Append(TCHAR Char)
+{
+	if (Length < MaxCaptionLength)
+	{
+		Chars[Length++] = Char;
+	}
+}
+
+
+void FDirectShowMediaCaptionDecoder::FCaptionMemory::Backspace()
+{
+	if ((Length > 0) && (Chars[Length - 1] != TEXT('\n')))
+	{
+		--Length;
+	}
+}
+
+
+void FDirectShowMediaCaptionDecoder::FCaptionMemory::Clear()
+{
+	Length = 0;
+}
+
+
+void FDirectShowMediaCaptionDecoder::FCaptionMemory::NewLine()
+{
+	if ((Length > 0) && (Chars[Length - 1] != TEXT('\n')))
+	{
+		Append(TEXT('\n'));
+	}
+}
+
+
+void FDirectShowMediaCaptionDecoder::FCaptionMemory::LimitRows(int32 MaxRows)
+{
+	int32 NumBreaks = 0;
+
+	for (int32 Index = 0; Index < Length; ++Index)
+	{
+		NumBreaks += (Chars[Index] == TEXT('\n')) ? 1 : 0;
+	}
+
+	// the last row is the one being written
+	int32 Start = 0;
+
+	while ((NumBreaks >= MaxRows) && (Start < Length))
+	{
+		if (Chars[Start++] == TEXT('\n'))
+		{
+			--NumBreaks;
+		}
+	}
+
+	if (Start > 0)
+	{
+		Length -= Start;
+		FMemory::Memmove(Chars, Chars + Start, Length * sizeof(TCHAR));
+	}
+}
+
+
+void FDirectShowMediaCaptionDecoder::Decode608Pair(uint8 Byte1, uint8 Byte2, FOnCaption OnCaption)
+{
+	using namespace DirectShowMediaCaptionDecoder;
+
+	if (Byte1 == 0)
+	{
+		return; // padding
+	}
+
+	if ((Byte1 >= 0x10) && (Byte1 <= 0x1f))
+	{
+		// control codes are repeated for robustness, the repetition is ignored
+		const uint16 Control = ((uint16)Byte1 << 8) | Byte2;
+
+		if (Control == LastControl608)
+		{
+			LastControl608 = 0;
+			return;
+		}
+
+		LastControl608 = Control;
+		bChannel1 = ((Byte1 & 0x08) == 0);
+
+		if (bChannel1)
+		{
+			Decode608Control(Byte1, Byte2, OnCaption);
+		}
+
+		return;
+	}
+
+	LastControl608 = 0;
+
+	if (!bChannel1 || (Mode608 == E608Mode::Text))
+	{
+		return;
+	}
+
+	FCaptionMemory& Target = Get608Target();
+
+	for (const uint8 Code : { Byte1, Byte2 })
+	{
+		if (Code >= 0x20)
+		{
+			const uint16 Mapped = BasicChars[Code - 0x20];
+			Target.Append(Mapped ? (TCHAR)Mapped : (TCHAR)Code);
+		}
+	}
+
+	bPaintOnChanged |= (Mode608 == E608Mode::PaintOn);
+}
+
+
+void FDirectShowMediaCaptionDecoder::Decode608Control(uint8 Code1, uint8 Code2, FOnCaption OnCaption)
+{
+	using namespace DirectShowMediaCaptionDecoder;
+
+	const uint8 Code = Code1 & 0x17; // the field 2 variants (0x15, 0x1d) share the field 1 meanings
+
+	// preamble address codes start a new row
+	if (Code2 >= 0x40)
+	{
+		if (Mode608 != E608Mode::RollUp)
+		{
+			Get608Target().NewLine();
+		}
+
+		return;
+	}
+
+	if (Code == 0x11)
+	{
+		if ((Code2 >= 0x30) && (Code2 <= 0x3f))
+		{
+			Get608Target().Append((TCHAR)SpecialChars[Code2 - 0x30]);
+		}
+		else if ((Code2 >= 0x20) && (Code2 <= 0x2f))
+		{
+			Get608Target().Append(TEXT(' ')); // mid-row style change, shown as a space
+		}
+
+		bPaintOnChanged |= (Mode608 == E608Mode::PaintOn);
+
+		return;
+	}
+
+	if ((Code == 0x12) || (Code == 0x13))
+	{
+		if ((Code2 >= 0x20) && (Code2 <= 0x3f))
+		{
+			// replaces the standard character sent before it for older decoders
+			FCaptionMemory& Target = Get608Target();
+			Target.Backspace();
+			Target.Append((TCHAR)ExtendedChars[(Code - 0x12) * 32 + (Code2 - 0x20)]);
+			bPaintOnChanged |= (Mode608 == E608Mode::PaintOn);
+		}
+
+		return;
+	}
+
+	if (((Code == 0x14) || (Code == 0x15)) && (Code2 >= 0x20) && (Code2 <= 0x2f))
+	{
+		switch (Code2)
+		{
+		case 0x20: // resume caption loading
+			Mode608 = E608Mode::PopOn;
+			break;
+
+		case 0x21: // backspace
+			Get608Target().Backspace();
+			bPaintOnChanged |= (Mode608 == E608Mode::PaintOn);
+			break;
+
+		case 0x25: // roll-up, 2 to 4 rows
+		case 0x26:
+		case 0x27:
+			if (Mode608 != E608Mode::RollUp)
+			{
+				Displayed608.Clear();
+			}
+
+			Mode608 = E608Mode::RollUp;
+			RollUpRows608 = Code2 - 0x23;
+			break;
+
+		case 0x29: // resume direct captioning
+			Mode608 = E608Mode::PaintOn;
+			break;
+
+		case 0x2a: // text restart, text display
+		case 0x2b:
+			Mode608 = E608Mode::Text;
+			break;
+
+		case 0x2c: // erase displayed memory
+			Displayed608.Clear();
+			bPaintOnChanged = false;
+			break;
+
+		case 0x2d: // carriage return
+			if (Mode608 == E608Mode::RollUp)
+			{
+				Emit(Displayed608, OnCaption);
+				Displayed608.NewLine();
+				Displayed608.LimitRows(RollUpRows608);
+			}
+			else
+			{
+				Get608Target().NewLine();
+			}
+			break;
+
+		case 0x2e: // erase non-displayed memory
+			NonDisplayed608.Clear();
+			break;
+
+		case 0x2f: // end of caption, flip memories
+			{
+				const int32 Length = NonDisplayed608.Length;
+				FMemory::Memcpy(Displayed608.Chars, NonDisplayed608.Chars, Length * sizeof(TCHAR));
+				Displayed608.Length = Length;
+				NonDisplayed608.Clear();
+
+				Mode608 = E608Mode::PopOn;
+				Emit(Displayed608, OnCaption);
+			}
+			break;
+
+		default: // delete to end of row, flash on, alarms
+			break;
+		}
+	}
+
+	// tab offsets (0x17 0x21-0x23) and attribute codes don't change the text
+}
+
+
+void FDirectShowMediaCaptionDecoder::Add708PacketByte(uint8 Byte, FOnCaption OnCaption)
+{
+	if (Packet708Size < Packet708Expected)
+	{
+		Packet708[Packet708Size++] = Byte;
+	}
+
+	if (Packet708Size == Packet708Expected)
+	{
+		Decode708Packet(OnCaption);
+	}
+}
+
+
+void FDirectShowMediaCaptionDecoder::Decode708Packet(FOnCaption OnCaption)
+{
+	int32 Index = 1; // skip the packet header
+
+	while (Index < Packet708Size)
+	{
+		int32 ServiceNumber = Packet708[Index] >> 5;
+		const int32 BlockSize = Packet708[Index] & 0x1f;
+		++Index;
+
+		if (ServiceNumber == 0)
+		{
+			break; // null block, padding follows
+		}
+
+		if ((ServiceNumber == 7) && (Index < Packet708Size))
+		{
+			ServiceNumber = Packet708[Index++] & 0x3f;
+		}
+
+		const int32 Available = FMath::Min(BlockSize, Packet708Size - Index);
+
+		if (ServiceNumber == 1)
+		{
+			Decode708ServiceBlock(Packet708 + Index, Available, OnCaption);
+		}
+
+		Index += BlockSize;
+	}
+
+	Packet708Size = 0;
+	Packet708Expected = 0;
+}
+
+
+void FDirectShowMediaCaptionDecoder::Decode708ServiceBlock(const uint8* Data, int32 Size, FOnCaption OnCaption)
+{
+	using namespace DirectShowMediaCaptionDecoder;
+
+	int32 Index = 0;
+
+	while (Index < Size)
+	{
+		const uint8 Code = Data[Index++];
+
+		if (Code < 0x20)
+		{
+			// C0 codes
+			switch (Code)
+			{
+			case 0x03: // end of text
+				Emit(Window708, OnCaption);
+				break;
+
+			case 0x08: // backspace
+				Window708.Backspace();
+				break;
+
+			case 0x0c: // form feed
+				Window708.Clear();
+				break;
+
+			case 0x0d: // carriage return
+				Window708.NewLine();
+				break;
+
+			case 0x10: // extended code set
+				if (Index < Size)
+				{
+					const uint8 ExtendedCode = Data[Index++];
+
+					if (ExtendedCode < 0x20)
+					{
+						Index += (ExtendedCode < 0x08) ? 0 : (ExtendedCode < 0x10) ? 1 : (ExtendedCode < 0x18) ? 2 : 3;
+					}
+					else if ((ExtendedCode >= 0x80) && (ExtendedCode < 0xa0))
+					{
+						Index += (ExtendedCode < 0x88) ? 4 : (ExtendedCode < 0x90) ? 5 : ((Index < Size) ? 1 + (Data[Index] & 0x3f) : 1);
+					}
+					else if ((ExtendedCode == 0x20) || (ExtendedCode == 0x21))
+					{
+						Window708.Append(TEXT(' ')); // transparent and non-breaking space
+					}
+					else if (ExtendedCode == 0x7f)
+					{
+						Window708.Append((TCHAR)0x266A);
+					}
+
+					// other G2 and G3 symbols are rare and dropped
+				}
+				break;
+
+			default:
+				// P16 and the other codes with parameters
+				Index += (Code >= 0x18) ? 2 : (Code >= 0x10) ? 1 : 0;
+				break;
+			}
+		}
+		else if (Code < 0x80)
+		{
+			Window708.Append((Code == 0x7f) ? (TCHAR)0x266A : (TCHAR)Code);
+		}
+		else if (Code < 0xa0)
+		{
+			// C1 window commands
+			switch (Code)
+			{
+			case 0x88: // clear windows
+			case 0x8c: // delete windows
+			case 0x8f: // reset
+				Window708.Clear();
+				break;
+
+			case 0x89: // display windows
+			case 0x8b: // toggle windows
+				Emit(Window708, OnCaption);
+				break;
+
+			case 0x92: // set pen location
+				Window708.NewLine();
+				break;
+
+			default:
+				break;
+			}
+
+			Index += C1ParameterCounts[Code - 0x80];
+		}
+		else
+		{
+			Window708.Append((TCHAR)Code); // G1 is Latin-1
+		}
+	}
+}
+
+
+void FDirectShowMediaCaptionDecoder::Emit(const FCaptionMemory& Memory, FOnCaption OnCaption)
+{
+	int32 Length = Memory.Length;
+
+	// trailing row breaks don't show
+	while ((Length > 0) && (Memory.Chars[Length - 1] == TEXT('\n')))
+	{
+		--Length;
+	}
+
+	if (Length > 0)
+	{
+		OnCaption(Memory.Chars, Length);
+	}
+}
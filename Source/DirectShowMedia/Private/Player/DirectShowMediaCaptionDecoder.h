@@ -0,0 +1,158 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreTypes.h"
+#include "Templates/Function.h"
+
+
+/** Formats of caption data handed to the caption decoder. */
+enum class EDirectShowMediaCaptionFormat : uint8
+{
+	/** Null terminated ANSI text, possibly with HTML style markup. */
+	Text,
+
+	/** CEA-608 (line 21) byte pairs with parity bits, as in MEDIASUBTYPE_Line21_BytePair. */
+	CEA608,
+
+	/** CEA-708 cc_data triplets (flags/type byte followed by two data bytes). */
+	CEA708
+};
+
+
+/**
+ * Streaming decoder for closed captions.
+ *
+ * Decodes CEA-608 channel 1 (pop-on, roll-up and paint-on captions) and CEA-708 service 1, and strips markup
+ * from plain text captions. Decoding is a single pass over the data into fixed size caption memories; nothing
+ * is allocated while decoding. Completed captions are handed to a callback as a pointer into those memories.
+ */
+class FDirectShowMediaCaptionDecoder
+{
+public:
+
+	/** Maximum number of characters of a caption (608 has 4 rows of 32 columns on screen, 708 windows are larger). */
+	static constexpr int32 MaxCaptionLength = 512;
+
+	/** Callback for completed captions, the text is only valid during the call and not null terminated. */
+	typedef TFunctionRef<void(const TCHAR* Text, int32 Length)> FOnCaption;
+
+	/** Default constructor. */
+	FDirectShowMediaCaptionDecoder();
+
+public:
+
+	/**
+	 * Decode caption data.
+	 *
+	 * State carries over between calls, so data can be passed in as it arrives (i.e. one field or frame at a time).
+	 *
+	 * @param Format The format of the data.
+	 * @param Data The caption data.
+	 * @param Size Size of the data (in bytes).
+	 * @param OnCaption Called for every caption completed by the data.
+	 */
+	void Decode(EDirectShowMediaCaptionFormat Format, const uint8* Data, uint32 Size, FOnCaption OnCaption);
+
+	/** Clear all caption memories and decoder state. */
+	void Reset();
+
+	/**
+	 * Copy text with all markup tags removed.
+	 *
+	 * A tag is a '<' followed by a '>', skipping over attribute values in quotes. A '<' without a matching '>'
+	 * is kept as text.
+	 *
+	 * @param Text The text to strip.
+	 * @param TextLength Length of the text (in characters).
+	 * @param OutText Will contain the stripped text (not null terminated).
+	 * @param OutCapacity Maximum number of characters to write.
+	 * @return Number of characters written.
+	 */
+	static int32 StripMarkup(const ANSICHAR* Text, int32 TextLength, TCHAR* OutText, int32 OutCapacity);
+
+private:
+
+	/** A fixed size caption memory. */
+	struct FCaptionMemory
+	{
+		TCHAR Chars[MaxCaptionLength];
+		int32 Length = 0;
+
+		void Append(TCHAR Char);
+		void Backspace();
+		void Clear();
+		void NewLine();
+
+		/** Drop the oldest rows until at most the given number remain. */
+		void LimitRows(int32 MaxRows);
+	};
+
+	/** CEA-608 caption styles. */
+	enum class E608Mode : uint8
+	{
+		PopOn,
+		RollUp,
+		PaintOn,
+		Text
+	};
+
+	/** Decode a CEA-608 byte pair (parity already checked). */
+	void Decode608Pair(uint8 Byte1, uint8 Byte2, FOnCaption OnCaption);
+
+	/** Decode a CEA-608 control code. */
+	void Decode608Control(uint8 Code1, uint8 Code2, FOnCaption OnCaption);
+
+	/** Get the memory CEA-608 characters currently go to. */
+	FCaptionMemory& Get608Target()
+	{
+		return (Mode608 == E608Mode::PopOn) ? NonDisplayed608 : Displayed608;
+	}
+
+	/** Add a byte to the current CEA-708 caption channel packet, decoding the packet when it is complete. */
+	void Add708PacketByte(uint8 Byte, FOnCaption OnCaption);
+
+	/** Decode a complete CEA-708 caption channel packet. */
+	void Decode708Packet(FOnCaption OnCaption);
+
+	/** Decode the service block of service 1. */
+	void Decode708ServiceBlock(const uint8* Data, int32 Size, FOnCaption OnCaption);
+
+	/** Hand a memory to the callback if it isn't empty. */
+	static void Emit(const FCaptionMemory& Memory, FOnCaption OnCaption);
+
+private:
+
+	/** CEA-608 displayed memory. */
+	FCaptionMemory Displayed608;
+
+	/** CEA-608 memory pop-on captions are built in. */
+	FCaptionMemory NonDisplayed608;
+
+	/** Current CEA-608 caption style. */
+	E608Mode Mode608;
+
+	/** Number of rows shown by roll-up captions. */
+	int32 RollUpRows608;
+
+	/** Whether the last CEA-608 control code selected channel 1. */
+	bool bChannel1;
+
+	/** Whether the displayed memory changed since the last paint-on caption was emitted. */
+	bool bPaintOnChanged;
+
+	/** Last CEA-608 control code, control codes are sent twice. */
+	uint16 LastControl608;
+
+	/** Text of the CEA-708 windows. */
+	FCaptionMemory Window708;
+
+	/** The CEA-708 caption channel packet being assembled. */
+	uint8 Packet708[128];
+
+	/** Number of bytes in Packet708. */
+	int32 Packet708Size;
+
+	/** Size of the packet being assembled, zero if none. */
+	int32 Packet708Expected;
+};
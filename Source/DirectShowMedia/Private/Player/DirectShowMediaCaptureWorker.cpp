@@ -0,0 +1,209 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "DirectShowMediaCaptureWorker.h"
+
+#include "HAL/Event.h"
+#include "HAL/PlatformProcess.h"
+#include "HAL/PlatformTime.h"
+#include "HAL/RunnableThread.h"
+#include "Math/UnrealMathUtility.h"
+
+
+/* FDirectShowMediaCaptureWorker structors
+ *****************************************************************************/
+
+FDirectShowMediaCaptureWorker::FDirectShowMediaCaptureWorker()
+	: QueueDepth(0)
+	, Head(0)
+	, Tail(0)
+	, Generation(0)
+	, bRunning(false)
+	, bStopping(false)
+	, NumPosting(0)
+	, WorkEvent(nullptr)
+	, Thread(nullptr)
+	, NumPosted(0)
+	, NumDropped(0)
+	, NumHandled(0)
+	, TotalLatency(0.0)
+	, MaxLatency(0.0)
+{ }
+
+
+FDirectShowMediaCaptureWorker::~FDirectShowMediaCaptureWorker()
+{
+	Shutdown();
+}
+
+
+/* FDirectShowMediaCaptureWorker interface
+ *****************************************************************************/
+
+bool FDirectShowMediaCaptureWorker::Start(FHandler InHandler, int32 InQueueDepth, EThreadPriority Priority, uint64 AffinityMask)
+{
+	Shutdown();
+
+	QueueDepth = (uint32)FMath::Max(1, InQueueDepth);
+	Ring.SetNumZeroed(FMath::RoundUpToPowerOfTwo(QueueDepth));
+	Head = 0;
+	Tail = 0;
+
+	Handler = MoveTemp(InHandler);
+	NumPosted = 0;
+	NumDropped = 0;
+	NumHandled = 0;
+	TotalLatency = 0.0;
+	MaxLatency = 0.0;
+
+	bStopping = false;
+	WorkEvent = FPlatformProcess::GetSynchEventFromPool(false);
+	Thread = FRunnableThread::Create(this, TEXT("DirectShowMediaCapture"), 0, Priority, (AffinityMask != 0) ? AffinityMask : FPlatformAffinity::GetNoAffinityMask());
+
+	if (Thread == nullptr)
+	{
+		FPlatformProcess::ReturnSynchEventToPool(WorkEvent);
+		WorkEvent = nullptr;
+		Handler = nullptr;
+
+		return false;
+	}
+
+	bRunning = true;
+
+	return true;
+}
+
+
+void FDirectShowMediaCaptureWorker::Shutdown()
+{
+	if (Thread == nullptr)
+	{
+		return;
+	}
+
+	bRunning = false;
+
+	// a producer that saw the worker running may still be queuing
+	while (NumPosting > 0)
+	{
+		FPlatformProcess::YieldThread();
+	}
+
+	Thread->Kill(true);
+	delete Thread;
+	Thread = nullptr;
+
+	Drain();
+
+	FPlatformProcess::ReturnSynchEventToPool(WorkEvent);
+	WorkEvent = nullptr;
+	Handler = nullptr;
+}
+
+
+void FDirectShowMediaCaptureWorker::Flush()
+{
+	++Generation;
+}
+
+
+bool FDirectShowMediaCaptureWorker::Post(double Time, IMediaSample* Sample)
+{
+	++NumPosting;
+
+	bool bPosted = false;
+
+	if (bRunning && (Sample != nullptr))
+	{
+		const uint32 CurrentTail = Tail.load(std::memory_order_relaxed);
+
+		if (CurrentTail - Head.load(std::memory_order_acquire) < QueueDepth)
+		{
+			Sample->AddRef();
+
+			FItem& Item = Ring[CurrentTail & (Ring.Num() - 1)];
+			Item.Sample = Sample;
+			Item.Time = Time;
+			Item.PostTime = FPlatformTime::Seconds();
+			Item.Generation = Generation.load(std::memory_order_relaxed);
+
+			Tail.store(CurrentTail + 1, std::memory_order_release);
+			WorkEvent->Trigger();
+
+			++NumPosted;
+			bPosted = true;
+		}
+		else
+		{
+			++NumDropped;
+		}
+	}
+
+	--NumPosting;
+
+	return bPosted;
+}
+
+
+/* FRunnable interface
+ *****************************************************************************/
+
+uint32 FDirectShowMediaCaptureWorker::Run()
+{
+	while (!bStopping)
+	{
+		const uint32 CurrentHead = Head.load(std::memory_order_relaxed);
+
+		if (CurrentHead == Tail.load(std::memory_order_acquire))
+		{
+			WorkEvent->Wait();
+			continue;
+		}
+
+		FItem Item = Ring[CurrentHead & (Ring.Num() - 1)];
+		Head.store(CurrentHead + 1, std::memory_order_release);
+
+		if (Item.Generation == Generation.load(std::memory_order_relaxed))
+		{
+			const double Latency = FPlatformTime::Seconds() - Item.PostTime;
+
+			TotalLatency += Latency;
+			MaxLatency = FMath::Max(MaxLatency, Latency);
+			++NumHandled;
+
+			Handler(Item.Time, Item.Sample);
+		}
+
+		Item.Sample->Release();
+	}
+
+	return 0;
+}
+
+
+void FDirectShowMediaCaptureWorker::Stop()
+{
+	bStopping = true;
+
+	if (WorkEvent != nullptr)
+	{
+		WorkEvent->Trigger();
+	}
+}
+
+
+/* FDirectShowMediaCaptureWorker implementation
+ *****************************************************************************/
+
+void FDirectShowMediaCaptureWorker::Drain()
+{
+	uint32 CurrentHead = Head;
+
+	while (CurrentHead != Tail)
+	{
+		Ring[CurrentHead & (Ring.Num() - 1)].Sample->Release();
+		++CurrentHead;
+	}
+
+	Head = CurrentHead;
+}
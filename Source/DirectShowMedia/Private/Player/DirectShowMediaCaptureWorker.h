@@ -0,0 +1,173 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include <atomic>
+
+#include "CoreTypes.h"
+#include "Containers/Array.h"
+#include "GenericPlatform/GenericPlatformAffinity.h"
+#include "HAL/Runnable.h"
+#include "Templates/Function.h"
+
+#include "Windows/AllowWindowsPlatformTypes.h"
+#include <strmif.h>
+#include "Windows/HideWindowsPlatformTypes.h"
+
+class FEvent;
+class FRunnableThread;
+
+
+/**
+ * Handles captured samples on a dedicated thread instead of the DirectShow streaming thread.
+ *
+ * The streaming thread only takes a reference on the sample and posts it into a bounded single producer,
+ * single consumer ring; the worker thread hands it to the handler and releases it. A referenced sample keeps
+ * its buffer out of the upstream allocator, so the queue is kept shorter than the allocator (a few buffers).
+ * When the queue is full, the new sample is dropped right away instead of stalling the device.
+ *
+ * Post must only be called from one producer thread, all other methods from the owner's thread.
+ */
+class FDirectShowMediaCaptureWorker
+	: public FRunnable
+{
+public:
+
+	/** Handler called on the worker thread for each posted sample. */
+	typedef TFunction<void(double Time, IMediaSample* Sample)> FHandler;
+
+	/** Default constructor. */
+	FDirectShowMediaCaptureWorker();
+
+	/** Virtual destructor. */
+	virtual ~FDirectShowMediaCaptureWorker();
+
+public:
+
+	/**
+	 * Start the worker thread, stopping the previous one if needed.
+	 *
+	 * @param InHandler The handler to call for each sample.
+	 * @param InQueueDepth Maximum number of samples waiting for the handler.
+	 * @param Priority The priority of the worker thread.
+	 * @param AffinityMask The cores the worker thread may run on.
+	 * @return true on success, false if the thread couldn't be created.
+	 */
+	bool Start(FHandler InHandler, int32 InQueueDepth, EThreadPriority Priority, uint64 AffinityMask);
+
+	/** Stop the worker thread and release the samples it didn't handle (waits for the handler to return). */
+	void Shutdown();
+
+	/** Drop the samples posted so far without handling them (i.e. after the device's format changed). */
+	void Flush();
+
+	/**
+	 * Post a sample to the worker thread (producer thread).
+	 *
+	 * @param Time The sample time reported by the sample grabber.
+	 * @param Sample The sample, which is referenced until it was handled.
+	 * @return true if the sample was queued, false if it was dropped.
+	 */
+	bool Post(double Time, IMediaSample* Sample);
+
+	/** Whether the worker thread is running. */
+	bool IsRunning() const
+	{
+		return bRunning;
+	}
+
+	/** Number of samples queued since the worker was started. */
+	uint64 GetNumPosted() const
+	{
+		return NumPosted;
+	}
+
+	/** Number of samples dropped because the queue was full. */
+	uint64 GetNumDropped() const
+	{
+		return NumDropped;
+	}
+
+	/** Average time samples waited in the queue (in seconds). */
+	double GetAverageLatency() const
+	{
+		return (NumHandled > 0) ? TotalLatency / (double)NumHandled : 0.0;
+	}
+
+	/** Longest time a sample waited in the queue (in seconds). */
+	double GetMaxLatency() const
+	{
+		return MaxLatency;
+	}
+
+public:
+
+	//~ FRunnable interface
+
+	virtual uint32 Run() override;
+	virtual void Stop() override;
+
+private:
+
+	/** A posted sample. */
+	struct FItem
+	{
+		IMediaSample* Sample;
+		double Time;
+		double PostTime;
+		uint32 Generation;
+	};
+
+	/** Release the samples left in the queue. */
+	void Drain();
+
+private:
+
+	/** Ring storage, a power of two in size. */
+	TArray<FItem> Ring;
+
+	/** Maximum number of queued samples. */
+	uint32 QueueDepth;
+
+	/** Index of the next sample to handle (written by the worker thread). */
+	std::atomic<uint32> Head;
+
+	/** Index of the next sample to post (written by the producer thread). */
+	std::atomic<uint32> Tail;
+
+	/** Samples posted before a change of this are dropped. */
+	std::atomic<uint32> Generation;
+
+	/** Whether samples are accepted. */
+	std::atomic<bool> bRunning;
+
+	/** Whether the worker thread should exit. */
+	std::atomic<bool> bStopping;
+
+	/** Number of Post calls in progress, waited for before the queue is torn down. */
+	std::atomic<int32> NumPosting;
+
+	/** The handler. */
+	FHandler Handler;
+
+	/** Signaled when a sample was posted or the worker should exit. */
+	FEvent* WorkEvent;
+
+	/** The worker thread. */
+	FRunnableThread* Thread;
+
+	/** Number of samples queued (producer thread). */
+	uint64 NumPosted;
+
+	/** Number of samples dropped because the queue was full (producer thread). */
+	uint64 NumDropped;
+
+	/** Number of samples handled (worker thread). */
+	uint64 NumHandled;
+
+	/** Total time handled samples waited in the queue (worker thread). */
+	double TotalLatency;
+
+	/** Longest time a sample waited in the queue (worker thread). */
+	double MaxLatency;
+};
@@ -0,0 +1,219 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "DirectShowMediaColorConverter.h"
+
+#include "DirectShowMediaVideoKernels.h"
+#include "Math/UnrealMathUtility.h"
+
+#include "Windows/AllowWindowsPlatformTypes.h"
+#include <dshow.h>
+#include <dvdmedia.h>
+#include "Windows/HideWindowsPlatformTypes.h"
+
+
+/* FDirectShowMediaColorimetry interface
+ *****************************************************************************/
+
+FDirectShowMediaColorimetry FDirectShowMediaColorimetry::GetDefault(int32 Height)
+{
+	FDirectShowMediaColorimetry Result;
+	Result.Matrix = (Height >= 720) ? EDirectShowMediaColorMatrix::BT709 : EDirectShowMediaColorMatrix::BT601;
+
+	return Result;
+}
+
+
+bool FDirectShowMediaColorimetry::ApplyControlFlags(uint32 ControlFlags)
+{
+	if ((ControlFlags & AMCONTROL_COLORINFO_PRESENT) == 0)
+	{
+		return false;
+	}
+
+	const uint32 NominalRange = (ControlFlags >> 12) & 0x7;
+	const uint32 TransferMatrix = (ControlFlags >> 15) & 0x7;
+	const uint32 Transfer = (ControlFlags >> 27) & 0x1f;
+
+	// NominalRange: 1 = 0-255, 2 = 16-235
+	if ((NominalRange == 1) || (NominalRange == 2))
+	{
+		bFullRange = (NominalRange == 1);
+	}
+
+	// TransferMatrix: 1 = BT.709, 2 = BT.601, 3 = SMPTE 240M (close to 709), 4/5 = BT.2020
+	if ((TransferMatrix == 1) || (TransferMatrix == 3))
+	{
+		Matrix = EDirectShowMediaColorMatrix::BT709;
+	}
+	else if (TransferMatrix == 2)
+	{
+		Matrix = EDirectShowMediaColorMatrix::BT601;
+	}
+	else if ((TransferMatrix == 4) || (TransferMatrix == 5))
+	{
+		Matrix = EDirectShowMediaColorMatrix::BT2020;
+	}
+
+	// TransferFunction: 1 = linear, 7 = sRGB, everything else is treated as video gamma
+	if (Transfer == 1)
+	{
+		TransferFunction = EDirectShowMediaTransferFunction::Linear;
+	}
+	else if (Transfer == 7)
+	{
+		TransferFunction = EDirectShowMediaTransferFunction::sRGB;
+	}
+
+	return true;
+}
+
+
+void FDirectShowMediaColorimetry::GetLumaCoefficients(double& OutKr, double& OutKb) const
+{
+	switch (Matrix)
+	{
+	case EDirectShowMediaColorMatrix::BT601:
+		OutKr = 0.299;
+		OutKb = 0.114;
+		break;
+
+	case EDirectShowMediaColorMatrix::BT2020:
+		OutKr = 0.2627;
+		OutKb = 0.0593;
+		break;
+
+	default:
+		OutKr = 0.2126;
+		OutKb = 0.0722;
+	}
+}
+
+
+FMatrix FDirectShowMediaColorimetry::GetYUVToRGBMatrix() const
+{
+	double Kr, Kb;
+	GetLumaCoefficients(Kr, Kb);
+
+	const double Kg = 1.0 - Kr - Kb;
+	const double LumaScale = bFullRange ? 1.0 : 255.0 / 219.0;
+	const double ChromaScale = bFullRange ? 1.0 : 255.0 / 224.0;
+
+	const double RedV = 2.0 * (1.0 - Kr) * ChromaScale;
+	const double GreenU = -2.0 * Kb * (1.0 - Kb) / Kg * ChromaScale;
+	const double GreenV = -2.0 * Kr * (1.0 - Kr) / Kg * ChromaScale;
+	const double BlueU = 2.0 * (1.0 - Kb) * ChromaScale;
+
+	return FMatrix(
+		FPlane(LumaScale, 0.0, RedV, 0.0),
+		FPlane(LumaScale, GreenU, GreenV, 0.0),
+		FPlane(LumaScale, BlueU, 0.0, 0.0),
+		FPlane(0.0, 0.0, 0.0, 0.0));
+}
+
+
+FString FDirectShowMediaColorimetry::ToString() const
+{
+	const TCHAR* MatrixName = (Matrix == EDirectShowMediaColorMatrix::BT601) ? TEXT("BT.601") : (Matrix == EDirectShowMediaColorMatrix::BT2020) ? TEXT("BT.2020") : TEXT("BT.709");
+	const TCHAR* TransferName = (TransferFunction == EDirectShowMediaTransferFunction::sRGB) ? TEXT(", sRGB") : (TransferFunction == EDirectShowMediaTransferFunction::Linear) ? TEXT(", linear") : TEXT("");
+
+	return FString::Printf(TEXT("%s %s%s"), MatrixName, bFullRange ? TEXT("full") : TEXT("limited"), TransferName);
+}
+
+
+/* FDirectShowMediaColorConverter structors
+ *****************************************************************************/
+
+FDirectShowMediaColorConverter::FDirectShowMediaColorConverter()
+{
+	BuildTables();
+}
+
+
+/* FDirectShowMediaColorConverter interface
+ *****************************************************************************/
+
+bool FDirectShowMediaColorConverter::IsSupportedFormat(EMediaTextureSampleFormat Format)
+{
+	return (Format == EMediaTextureSampleFormat::CharYUY2) || (Format == EMediaTextureSampleFormat::CharUYVY) || (Format == EMediaTextureSampleFormat::CharNV12);
+}
+
+
+void FDirectShowMediaColorConverter::Configure(const FDirectShowMediaColorimetry& InColorimetry)
+{
+	if (InColorimetry != Colorimetry)
+	{
+		Colorimetry = InColorimetry;
+		BuildTables();
+	}
+}
+
+
+bool FDirectShowMediaColorConverter::Convert(EMediaTextureSampleFormat Format, const uint8* InBuffer, uint32 InSize, uint32 InStride, const FIntPoint& Dim, uint8* OutBuffer, uint32 OutStride) const
+{
+	if ((InBuffer == nullptr) || (OutBuffer == nullptr) || (Dim.X <= 0) || (Dim.Y <= 0) || (OutStride < (uint32)Dim.X * 4))
+	{
+		return false;
+	}
+
+	const FDirectShowMediaVideoKernel Kernel = FDirectShowMediaVideoKernels::Find(Format, EMediaTextureSampleFormat::CharBGRA, false, FDirectShowMediaVideoKernels::IsAligned(Format, EMediaTextureSampleFormat::CharBGRA, Dim.X, InStride, OutStride));
+
+	if (Kernel == nullptr)
+	{
+		return false;
+	}
+
+	FDirectShowMediaVideoKernelArgs Args;
+	Args.Source = InBuffer;
+	Args.SourceSize = InSize;
+	Args.SourceStride = InStride;
+	Args.Dest = OutBuffer;
+	Args.DestStride = OutStride;
+	Args.Width = Dim.X;
+	Args.Height = Dim.Y;
+	Args.Converter = this;
+
+	return Kernel(Args);
+}
+
+
+/* FDirectShowMediaColorConverter implementation
+ *****************************************************************************/
+
+void FDirectShowMediaColorConverter::BuildTables()
+{
+	YUVToRGBMatrix = Colorimetry.GetYUVToRGBMatrix();
+
+	const double One = (double)(1 << FractionBits);
+	const double LumaOffset = Colorimetry.bFullRange ? 0.0 : 16.0;
+	const double LumaScale = YUVToRGBMatrix.M[0][0];
+
+	for (int32 Value = 0; Value < 256; ++Value)
+	{
+		const double Chroma = Value - 128.0;
+
+		// the rounding term rides along with luma, which is part of every channel
+		LumaTable[Value] = FMath::RoundToInt32(((Value - LumaOffset) * LumaScale + 0.5) * One);
+		RedVTable[Value] = FMath::RoundToInt32(Chroma * YUVToRGBMatrix.M[0][2] * One);
+		GreenUTable[Value] = FMath::RoundToInt32(Chroma * YUVToRGBMatrix.M[1][1] * One);
+		GreenVTable[Value] = FMath::RoundToInt32(Chroma * YUVToRGBMatrix.M[1][2] * One);
+		BlueUTable[Value] = FMath::RoundToInt32(Chroma * YUVToRGBMatrix.M[2][1] * One);
+	}
+
+	for (int32 Index = 0; Index < UE_ARRAY_COUNT(ClampTable); ++Index)
+	{
+		const int32 Value = FMath::Clamp(Index - ClampTableOffset, 0, 255);
+
+		if (Colorimetry.TransferFunction == EDirectShowMediaTransferFunction::Linear)
+		{
+			// the engine expects sRGB encoded samples
+			const double Linear = Value / 255.0;
+			const double Encoded = (Linear <= 0.0031308) ? Linear * 12.92 : 1.055 * FMath::Pow(Linear, 1.0 / 2.4) - 0.055;
+
+			ClampTable[Index] = (uint8)FMath::Clamp(FMath::RoundToInt32(Encoded * 255.0), 0, 255);
+		}
+		else
+		{
+			ClampTable[Index] = (uint8)Value;
+		}
+	}
+}
@@ -0,0 +1,227 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreTypes.h"
+#include "Containers/UnrealString.h"
+#include "IMediaTextureSample.h"
+#include "Math/IntPoint.h"
+#include "Math/Matrix.h"
+
+
+/** YUV to RGB matrix coefficients. */
+enum class EDirectShowMediaColorMatrix : uint8
+{
+	BT601,
+	BT709,
+	BT2020
+};
+
+
+/** Transfer function the RGB values are encoded with. */
+enum class EDirectShowMediaTransferFunction : uint8
+{
+	/** BT.601/709/2020 camera gamma, displayed as is. */
+	Video,
+
+	/** sRGB. */
+	sRGB,
+
+	/** Linear light. */
+	Linear
+};
+
+
+/** Describes how the samples of a video format map to colors. */
+struct FDirectShowMediaColorimetry
+{
+	/** YUV to RGB matrix. */
+	EDirectShowMediaColorMatrix Matrix = EDirectShowMediaColorMatrix::BT709;
+
+	/** Whether YUV uses the full 0-255 range instead of 16-235 (16-240 for chroma). */
+	bool bFullRange = false;
+
+	/** Transfer function. */
+	EDirectShowMediaTransferFunction TransferFunction = EDirectShowMediaTransferFunction::Video;
+
+	/**
+	 * Get the colorimetry to assume for a format that doesn't describe its own.
+	 *
+	 * Follows the usual convention: BT.601 for standard definition, BT.709 otherwise, limited range.
+	 *
+	 * @param Height The frame height (in pixels).
+	 * @return The colorimetry.
+	 */
+	static FDirectShowMediaColorimetry GetDefault(int32 Height);
+
+	/**
+	 * Apply the color information of a VIDEOINFOHEADER2's control flags.
+	 *
+	 * The flags hold a DXVA_ExtendedFormat: nominal range at bit 12, transfer matrix at bit 15 and transfer
+	 * function at bit 27. Values without an equivalent leave the corresponding field unchanged.
+	 *
+	 * @param ControlFlags The format's dwControlFlags.
+	 * @return true if the flags carry color information (AMCONTROL_COLORINFO_PRESENT), false otherwise.
+	 */
+	bool ApplyControlFlags(uint32 ControlFlags);
+
+	/** Get the luma weights of the matrix. */
+	void GetLumaCoefficients(double& OutKr, double& OutKb) const;
+
+	/**
+	 * Get the matrix the engine's converters apply to 8 bit YUV.
+	 *
+	 * For limited range the matrix includes the range expansion; the engine subtracts the black level
+	 * offset itself (see IMediaTextureSample::GetFullRange).
+	 */
+	FMatrix GetYUVToRGBMatrix() const;
+
+	/** Get a human readable description, i.e. "BT.709 limited". */
+	FString ToString() const;
+
+	bool operator==(const FDirectShowMediaColorimetry& Other) const
+	{
+		return (Matrix == Other.Matrix) && (bFullRange == Other.bFullRange) && (TransferFunction == Other.TransferFunction);
+	}
+
+	bool operator!=(const FDirectShowMediaColorimetry& Other) const
+	{
+		return !(*this == Other);
+	}
+};
+
+
+/**
+ * Converts 8 bit YUV video to BGRA on the CPU.
+ *
+ * All colorimetry dependent math is baked into lookup tables when the colorimetry changes: per component
+ * fixed point contributions of Y, U and V to each output channel, and a clamp table that also applies the
+ * transfer function. Converting a pixel then takes a handful of table reads and integer adds. The row loops
+ * live in the video kernels (see FDirectShowMediaVideoKernels), which are specialized per format.
+ */
+class FDirectShowMediaColorConverter
+{
+public:
+
+	/** Default constructor. */
+	FDirectShowMediaColorConverter();
+
+public:
+
+	/**
+	 * Check whether the converter can read the given sample format.
+	 *
+	 * @param Format The sample format.
+	 * @return true for YUY2, UYVY and NV12, false otherwise.
+	 */
+	static bool IsSupportedFormat(EMediaTextureSampleFormat Format);
+
+	/**
+	 * Set the colorimetry of the input, rebuilding the tables if it changed.
+	 *
+	 * @param InColorimetry The input's colorimetry.
+	 */
+	void Configure(const FDirectShowMediaColorimetry& InColorimetry);
+
+	/**
+	 * Convert a frame.
+	 *
+	 * @param Format The input sample format.
+	 * @param InBuffer The input frame.
+	 * @param InSize Size of the input frame (in bytes).
+	 * @param InStride Number of bytes per input row (of the luma plane for NV12).
+	 * @param Dim Width and height of the frame (in pixels).
+	 * @param OutBuffer The BGRA output, at least OutStride * Dim.Y bytes.
+	 * @param OutStride Number of bytes per output row.
+	 * @return true if the frame was converted, false if the format isn't supported or the input is too small.
+	 */
+	bool Convert(EMediaTextureSampleFormat Format, const uint8* InBuffer, uint32 InSize, uint32 InStride, const FIntPoint& Dim, uint8* OutBuffer, uint32 OutStride) const;
+
+	/** Get the colorimetry the tables were built for. */
+	const FDirectShowMediaColorimetry& GetColorimetry() const
+	{
+		return Colorimetry;
+	}
+
+	/** Get the matrix matching the current colorimetry. */
+	const FMatrix& GetYUVToRGBMatrix() const
+	{
+		return YUVToRGBMatrix;
+	}
+
+	/**
+	 * Convert two horizontally adjacent pixels that share their chroma.
+	 *
+	 * @param Luma0 Luma of the left pixel.
+	 * @param Luma1 Luma of the right pixel.
+	 * @param U Shared U.
+	 * @param V Shared V.
+	 * @param OutPixels The two BGRA output pixels.
+	 */
+	FORCEINLINE void ConvertPair(uint8 Luma0, uint8 Luma1, uint8 U, uint8 V, uint8* OutPixels) const
+	{
+		const int32 RedChroma = RedVTable[V];
+		const int32 GreenChroma = GreenUTable[U] + GreenVTable[V];
+		const int32 BlueChroma = BlueUTable[U];
+
+		WritePixel(LumaTable[Luma0], RedChroma, GreenChroma, BlueChroma, OutPixels);
+		WritePixel(LumaTable[Luma1], RedChroma, GreenChroma, BlueChroma, OutPixels + 4);
+	}
+
+	/**
+	 * Convert a single pixel (i.e. the last one of an odd width row).
+	 *
+	 * @param Luma Luma of the pixel.
+	 * @param U U of the pixel.
+	 * @param V V of the pixel.
+	 * @param OutPixel The BGRA output pixel.
+	 */
+	FORCEINLINE void ConvertPixel(uint8 Luma, uint8 U, uint8 V, uint8* OutPixel) const
+	{
+		WritePixel(LumaTable[Luma], RedVTable[V], GreenUTable[U] + GreenVTable[V], BlueUTable[U], OutPixel);
+	}
+
+private:
+
+	/** Fractional bits of the fixed point tables. */
+	static constexpr int32 FractionBits = 16;
+
+	/** Index of the value zero in the clamp table. */
+	static constexpr int32 ClampTableOffset = 384;
+
+	/** Rebuild all tables. */
+	void BuildTables();
+
+	/** Write one BGRA pixel. */
+	FORCEINLINE void WritePixel(int32 Luma, int32 RedChroma, int32 GreenChroma, int32 BlueChroma, uint8* OutPixel) const
+	{
+		OutPixel[0] = ClampTable[((Luma + BlueChroma) >> FractionBits) + ClampTableOffset];
+		OutPixel[1] = ClampTable[((Luma + GreenChroma) >> FractionBits) + ClampTableOffset];
+		OutPixel[2] = ClampTable[((Luma + RedChroma) >> FractionBits) + ClampTableOffset];
+		OutPixel[3] = 0xff;
+	}
+
+private:
+
+	/** The colorimetry the tables were built for. */
+	FDirectShowMediaColorimetry Colorimetry;
+
+	/** Matrix matching the colorimetry. */
+	FMatrix YUVToRGBMatrix;
+
+	/** Luma contribution to all channels (fixed point). */
+	int32 LumaTable[256];
+
+	/** V contribution to red (fixed point). */
+	int32 RedVTable[256];
+
+	/** U and V contributions to green (fixed point). */
+	int32 GreenUTable[256];
+	int32 GreenVTable[256];
+
+	/** U contribution to blue (fixed point). */
+	int32 BlueUTable[256];
+
+	/** Clamps a channel to 0-255 and applies the transfer function, indexed by integer value plus ClampTableOffset. */
+	uint8 ClampTable[1024];
+};
@@ -0,0 +1,216 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "DirectShowMediaFrameArena.h"
+
+#include "HAL/UnrealMemory.h"
+#include "Misc/ScopeLock.h"
+#include "Templates/AlignmentTemplates.h"
+
+#if PLATFORM_WINDOWS
+	#include "Windows/AllowWindowsPlatformTypes.h"
+	#include "Windows/WindowsHWrapper.h"
+	#include "Windows/HideWindowsPlatformTypes.h"
+#endif
+
+
+std::atomic<bool> FDirectShowMediaFrameArena::bLargePagesEnabled(false);
+
+
+namespace DirectShowMediaFrameArena
+{
+	/** Size of regular pages. */
+	const uint64 PageSize = 4096;
+
+#if PLATFORM_WINDOWS
+	/** Enable the "Lock pages in memory" right in the process token, if the account holds it. */
+	bool EnableLockMemoryPrivilege()
+	{
+		HANDLE Token = nullptr;
+
+		if (!::OpenProcessToken(::GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &Token))
+		{
+			return false;
+		}
+
+		TOKEN_PRIVILEGES Privileges;
+		Privileges.PrivilegeCount = 1;
+		Privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+
+		// AdjustTokenPrivileges succeeds with ERROR_NOT_ALL_ASSIGNED if the account doesn't hold the right
+		const bool bEnabled = ::LookupPrivilegeValue(nullptr, SE_LOCK_MEMORY_NAME, &Privileges.Privileges[0].Luid)
+			&& ::AdjustTokenPrivileges(Token, FALSE, &Privileges, 0, nullptr, nullptr)
+			&& (::GetLastError() == ERROR_SUCCESS);
+
+		::CloseHandle(Token);
+
+		return bEnabled;
+	}
+#endif
+}
+
+
+/* FDirectShowMediaFrameArena static functions
+ *****************************************************************************/
+
+TSharedPtr<FDirectShowMediaFrameArena, ESPMode::ThreadSafe> FDirectShowMediaFrameArena::Create(uint64 FrameSize, int32 NumSlots, bool bLargePages, int32 Node)
+{
+	if ((FrameSize == 0) || (NumSlots <= 0))
+	{
+		return nullptr;
+	}
+
+	const uint64 LargePageSize = GetLargePageSize();
+	const bool bTryLargePages = bLargePages && bLargePagesEnabled.load(std::memory_order_relaxed) && (LargePageSize > 0);
+
+	// slots start on large page boundaries
+	const uint64 SlotSize = Align(FrameSize, bTryLargePages ? LargePageSize : DirectShowMediaFrameArena::PageSize);
+	const uint64 Size = SlotSize * NumSlots;
+
+	EDirectShowMediaFramePages Pages = EDirectShowMediaFramePages::Regular;
+	uint8* Data = AllocatePages(Size, bTryLargePages, Node, Pages);
+
+	if (Data == nullptr)
+	{
+		return nullptr;
+	}
+
+	return MakeShareable(new FDirectShowMediaFrameArena(Data, Size, SlotSize, NumSlots, Pages, Node));
+}
+
+
+bool FDirectShowMediaFrameArena::EnableLargePages()
+{
+#if PLATFORM_WINDOWS
+	if (!bLargePagesEnabled.load(std::memory_order_relaxed) && (GetLargePageSize() > 0) && DirectShowMediaFrameArena::EnableLockMemoryPrivilege())
+	{
+		bLargePagesEnabled.store(true, std::memory_order_relaxed);
+	}
+#endif
+
+	return bLargePagesEnabled.load(std::memory_order_relaxed);
+}
+
+
+uint64 FDirectShowMediaFrameArena::GetLargePageSize()
+{
+#if PLATFORM_WINDOWS
+	return (uint64)::GetLargePageMinimum();
+#else
+	return 0;
+#endif
+}
+
+
+uint8* FDirectShowMediaFrameArena::AllocatePages(uint64 Size, bool bLargePages, int32 Node, EDirectShowMediaFramePages& OutPages)
+{
+	uint8* Data = nullptr;
+
+#if PLATFORM_WINDOWS
+	// the node is only preferred, the pages come from other nodes when it runs out
+	const DWORD PreferredNode = (Node >= 0) ? (DWORD)Node : NUMA_NO_PREFERRED_NODE;
+
+	if (bLargePages)
+	{
+		Data = (uint8*)::VirtualAllocExNuma(::GetCurrentProcess(), nullptr, Size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE, PreferredNode);
+
+		// large pages are locked and committed up front
+		if (Data != nullptr)
+		{
+			OutPages = EDirectShowMediaFramePages::Large;
+
+			return Data;
+		}
+	}
+
+	Data = (uint8*)::VirtualAllocExNuma(::GetCurrentProcess(), nullptr, Size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE, PreferredNode);
+	OutPages = EDirectShowMediaFramePages::Regular;
+#else
+	Data = (uint8*)FMemory::Malloc(Size, DirectShowMediaFrameArena::PageSize);
+	OutPages = EDirectShowMediaFramePages::Regular;
+#endif
+
+	// fault the pages in now rather than in the copy loops
+	if (Data != nullptr)
+	{
+		FMemory::Memzero(Data, Size);
+	}
+
+	return Data;
+}
+
+
+void FDirectShowMediaFrameArena::FreePages(uint8* Data, uint64 Size, EDirectShowMediaFramePages Pages)
+{
+#if PLATFORM_WINDOWS
+	::VirtualFree(Data, 0, MEM_RELEASE);
+#else
+	FMemory::Free(Data);
+#endif
+}
+
+
+/* FDirectShowMediaFrameArena structors
+ *****************************************************************************/
+
+FDirectShowMediaFrameArena::FDirectShowMediaFrameArena(uint8* InData, uint64 InSize, uint64 InSlotSize, int32 InNumSlots, EDirectShowMediaFramePages InPages, int32 InNode)
+	: Data(InData)
+	, Size(InSize)
+	, SlotSize(InSlotSize)
+	, NumSlots(InNumSlots)
+	, Pages(InPages)
+	, Node(InNode)
+	, NumMissed(0)
+{
+	// the first slots are handed out first
+	FreeSlots.Reserve(NumSlots);
+
+	for (int32 Slot = NumSlots - 1; Slot >= 0; --Slot)
+	{
+		FreeSlots.Add(Slot);
+	}
+}
+
+
+FDirectShowMediaFrameArena::~FDirectShowMediaFrameArena()
+{
+	FreePages(Data, Size, Pages);
+}
+
+
+/* FDirectShowMediaFrameArena interface
+ *****************************************************************************/
+
+uint8* FDirectShowMediaFrameArena::Acquire(uint64 FrameSize, int32& OutSlot)
+{
+	if (FrameSize > SlotSize)
+	{
+		++NumMissed;
+
+		return nullptr;
+	}
+
+	{
+		FScopeLock Lock(&CriticalSection);
+
+		// the most recently released slot is the most likely to still be in the caches and the TLB
+		if (FreeSlots.Num() > 0)
+		{
+			OutSlot = FreeSlots.Pop();
+
+			return Data + SlotSize * OutSlot;
+		}
+	}
+
+	++NumMissed;
+
+	return nullptr;
+}
+
+
+void FDirectShowMediaFrameArena::Release(int32 Slot)
+{
+	check((Slot >= 0) && (Slot < NumSlots));
+
+	FScopeLock Lock(&CriticalSection);
+	FreeSlots.Add(Slot);
+}
@@ -0,0 +1,174 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include <atomic>
+
+#include "CoreTypes.h"
+#include "Containers/Array.h"
+#include "HAL/CriticalSection.h"
+#include "Templates/SharedPointer.h"
+
+
+/** Kinds of pages backing a frame arena. */
+enum class EDirectShowMediaFramePages : uint8
+{
+	/** Large pages (2 MB on x64), locked in memory. */
+	Large,
+
+	/** Regular pages. */
+	Regular
+};
+
+
+/**
+ * One contiguous region that video frames are carved from.
+ *
+ * At 4K a frame spans thousands of regular pages, so the copy and convert loops miss the TLB on every few
+ * rows. The arena reserves all frames of a format at once, on large pages once they were enabled (see
+ * EnableLargePages), and falls back to regular pages when the OS denies them. The region can be bound to a
+ * NUMA node, so frames stay local to the cores that write them. Slots are aligned to the large page size, and
+ * the region is touched once when it is created so the loops never page fault.
+ *
+ * The arena is shared by the player and its samples, and released with the last of them. When all slots are
+ * taken, or a frame doesn't fit, Acquire fails and the sample allocates its own buffer.
+ */
+class FDirectShowMediaFrameArena
+{
+public:
+
+	/**
+	 * Create an arena.
+	 *
+	 * @param FrameSize The size of a frame (in bytes).
+	 * @param NumSlots The number of frames.
+	 * @param bLargePages Whether to ask the OS for large pages.
+	 * @param Node The NUMA node to allocate from, or INDEX_NONE for any node.
+	 * @return The arena, or nullptr if the region couldn't be reserved at all.
+	 */
+	static TSharedPtr<FDirectShowMediaFrameArena, ESPMode::ThreadSafe> Create(uint64 FrameSize, int32 NumSlots, bool bLargePages, int32 Node = INDEX_NONE);
+
+	/**
+	 * Get the size of large pages.
+	 *
+	 * @return The size (in bytes), or zero if the platform has none.
+	 */
+	static uint64 GetLargePageSize();
+
+	/**
+	 * Let arenas use large pages.
+	 *
+	 * Large pages are locked in memory, so Windows only hands them to processes that enabled the
+	 * "Lock pages in memory" right, which the account must hold (Local Security Policy). Enabling it
+	 * changes the token of the whole process, so it is never done implicitly: the module calls this at
+	 * startup if bLockPagesInMemory is set in the [DirectShowMedia] section of the engine configuration.
+	 * Until then, arenas are on regular pages.
+	 *
+	 * @return true if arenas may use large pages, false if the right couldn't be enabled or the platform has none.
+	 */
+	static bool EnableLargePages();
+
+	/** Destructor. */
+	~FDirectShowMediaFrameArena();
+
+public:
+
+	/**
+	 * Acquire a free slot.
+	 *
+	 * @param FrameSize The size of the frame to store (in bytes).
+	 * @param OutSlot Will contain the slot.
+	 * @return The slot's memory, or nullptr if no slot is free or the frame doesn't fit.
+	 */
+	uint8* Acquire(uint64 FrameSize, int32& OutSlot);
+
+	/**
+	 * Release a slot.
+	 *
+	 * @param Slot The slot returned by Acquire.
+	 */
+	void Release(int32 Slot);
+
+	/** Get the kind of pages backing the arena. */
+	EDirectShowMediaFramePages GetPages() const
+	{
+		return Pages;
+	}
+
+	/** Get the NUMA node the arena was allocated from, INDEX_NONE if any. */
+	int32 GetNode() const
+	{
+		return Node;
+	}
+
+	/** Get the size of a slot (in bytes). */
+	uint64 GetSlotSize() const
+	{
+		return SlotSize;
+	}
+
+	/** Get the number of slots. */
+	int32 GetNumSlots() const
+	{
+		return NumSlots;
+	}
+
+	/** Number of frames that found no free slot. */
+	uint64 GetNumMissed() const
+	{
+		return NumMissed;
+	}
+
+private:
+
+	/** Create and initialize an arena (see Create). */
+	FDirectShowMediaFrameArena(uint8* InData, uint64 InSize, uint64 InSlotSize, int32 InNumSlots, EDirectShowMediaFramePages InPages, int32 InNode);
+
+	/**
+	 * Reserve and commit a region.
+	 *
+	 * @param Size The size of the region (a multiple of the large page size if bLargePages is set).
+	 * @param bLargePages Whether to try large pages first.
+	 * @param Node The NUMA node to allocate from, or INDEX_NONE for any node.
+	 * @param OutPages Will contain the kind of pages the region got.
+	 * @return The region, or nullptr on failure.
+	 */
+	static uint8* AllocatePages(uint64 Size, bool bLargePages, int32 Node, EDirectShowMediaFramePages& OutPages);
+
+	/** Free a region returned by AllocatePages. */
+	static void FreePages(uint8* Data, uint64 Size, EDirectShowMediaFramePages Pages);
+
+private:
+
+	/** Whether arenas may use large pages (see EnableLargePages). */
+	static std::atomic<bool> bLargePagesEnabled;
+
+private:
+
+	/** The region. */
+	uint8* Data;
+
+	/** Size of the region (in bytes). */
+	uint64 Size;
+
+	/** Size of a slot (in bytes). */
+	uint64 SlotSize;
+
+	/** Number of slots. */
+	int32 NumSlots;
+
+	/** The kind of pages backing the region. */
+	EDirectShowMediaFramePages Pages;
+
+	/** The NUMA node the region was allocated from, INDEX_NONE if any. */
+	int32 Node;
+
+	/** The free slots, the most recently released last. */
+	TArray<int32> FreeSlots;
+
+	/** Protects the free slots. */
+	FCriticalSection CriticalSection;
+
+	/** Number of frames that found no free slot. */
+	std::atomic<uint64> NumMissed;
+};
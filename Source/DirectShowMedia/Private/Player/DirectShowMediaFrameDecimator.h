@@ -0,0 +1,122 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreTypes.h"
+#include "Math/UnrealMathUtility.h"
+#include "Misc/Timespan.h"
+
+
+/**
+ * Drops video frames on the producer side so that a consumer only receives the cadence it asked for.
+ *
+ * Output frames are placed on an ideal grid (Anchor + N * Interval) that is recomputed from the frame
+ * index every time, so rounding never accumulates and a 59.94 fps source decimated to 10 fps stays at
+ * exactly 10 fps instead of drifting like an every-Nth-frame filter would. Each grid slot is served by
+ * the source frame closest to it, and the emitted sample is re-stamped with the slot time.
+ */
+class FDirectShowMediaFrameDecimator
+{
+public:
+
+	/** Default constructor. */
+	FDirectShowMediaFrameDecimator()
+		: TargetInterval(0.0)
+		, AnchorTime(FTimespan::MinValue())
+		, NextFrameIndex(0)
+		, NumDroppedFrames(0)
+	{ }
+
+public:
+
+	/**
+	 * Set the output cadence.
+	 *
+	 * @param InTargetFrameRate Frames per second to deliver, or zero (or less) to disable decimation.
+	 * @see Reset
+	 */
+	void SetTargetFrameRate(double InTargetFrameRate)
+	{
+		TargetInterval = (InTargetFrameRate > 0.0) ? (double)ETimespan::TicksPerSecond / InTargetFrameRate : 0.0;
+		Reset();
+	}
+
+	/** Whether frames are being decimated at all. */
+	bool IsEnabled() const
+	{
+		return TargetInterval > 0.0;
+	}
+
+	/** Forget the current grid, the next accepted frame will anchor a new one. */
+	void Reset()
+	{
+		AnchorTime = FTimespan::MinValue();
+		NextFrameIndex = 0;
+	}
+
+	/** Number of source frames dropped since the decimator was created. */
+	uint64 GetNumDroppedFrames() const
+	{
+		return NumDroppedFrames;
+	}
+
+	/**
+	 * Decide whether a source frame should be delivered.
+	 *
+	 * @param SourceTime Presentation time of the source frame.
+	 * @param SourceDuration Duration of the source frame.
+	 * @param OutTime Will contain the paced presentation time if the frame is accepted.
+	 * @param OutDuration Will contain the paced duration if the frame is accepted.
+	 * @return true if the frame should be delivered, false if it should be dropped before any copy.
+	 */
+	bool Accept(FTimespan SourceTime, FTimespan SourceDuration, FTimespan& OutTime, FTimespan& OutDuration)
+	{
+		OutTime = SourceTime;
+		OutDuration = SourceDuration;
+
+		// nothing to do if the source is already at or below the requested rate (durations are rounded to ticks)
+		if (!IsEnabled() || ((double)SourceDuration.GetTicks() + 1.0 > TargetInterval))
+		{
+			return true;
+		}
+
+		// (re)anchor on the first frame and whenever the stream clock restarts
+		if ((AnchorTime == FTimespan::MinValue()) || (SourceTime < AnchorTime))
+		{
+			AnchorTime = SourceTime;
+			NextFrameIndex = 0;
+		}
+
+		// a source frame serves the grid slot it is closest to
+		const double Position = (double)(SourceTime - AnchorTime).GetTicks() + 0.5 * (double)SourceDuration.GetTicks();
+
+		if (Position < (double)NextFrameIndex * TargetInterval)
+		{
+			++NumDroppedFrames;
+			return false;
+		}
+
+		// skip slots the source never reached (i.e. after a stall)
+		const int64 FrameIndex = FMath::Max(NextFrameIndex, (int64)FMath::FloorToDouble(Position / TargetInterval));
+		NextFrameIndex = FrameIndex + 1;
+
+		OutTime = AnchorTime + FTimespan((int64)FMath::RoundToDouble((double)FrameIndex * TargetInterval));
+		OutDuration = FTimespan((int64)FMath::RoundToDouble(TargetInterval));
+
+		return true;
+	}
+
+private:
+
+	/** Output frame interval (in ticks), or zero if disabled. */
+	double TargetInterval;
+
+	/** Presentation time of the first grid slot. */
+	FTimespan AnchorTime;
+
+	/** Index of the next grid slot to fill. */
+	int64 NextFrameIndex;
+
+	/** Number of source frames that were dropped. */
+	uint64 NumDroppedFrames;
+};
@@ -0,0 +1,322 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "DirectShowMediaFrameTracer.h"
+
+#include "Algo/Sort.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformTLS.h"
+#include "HAL/ThreadManager.h"
+#include "Math/UnrealMathUtility.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Misc/ScopeLock.h"
+
+#include "DirectShowMedia.h"
+
+
+std::atomic<bool> FDirectShowMediaFrameTracer::bEnabled(false);
+
+static_assert((FDirectShowMediaFrameTracer::EventsPerThread & (FDirectShowMediaFrameTracer::EventsPerThread - 1)) == 0, "Rings are indexed with a mask");
+
+
+namespace DirectShowMediaFrameTracer
+{
+	/** Whether events are recorded. */
+	int32 Enabled = 0;
+
+	FAutoConsoleVariableRef CVarEnabled(
+		TEXT("DirectShowMedia.FrameTrace"),
+		Enabled,
+		TEXT("Record the video frames' way through the DirectShow players (0 = off, 1 = on).\n")
+		TEXT("Enabling discards the events recorded so far; DirectShowMedia.FrameTrace.Save writes them."),
+		FConsoleVariableDelegate::CreateLambda([](IConsoleVariable*)
+		{
+			FDirectShowMediaFrameTracer::Get().SetEnabled(Enabled != 0);
+		}),
+		ECVF_Default);
+
+	FAutoConsoleCommand CommandSave(
+		TEXT("DirectShowMedia.FrameTrace.Save"),
+		TEXT("Write the recorded video frame events as a Chrome trace.\n")
+		TEXT("Usage: DirectShowMedia.FrameTrace.Save [File] (relative to Saved, default DirectShowMediaFrames.json)"),
+		FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+		{
+			const FString Filename = (Args.Num() > 0) ? Args[0] : FString(TEXT("DirectShowMediaFrames.json"));
+
+			if (FDirectShowMediaFrameTracer::Get().SaveChromeTrace(Filename))
+			{
+				UE_LOG(LogDirectShowMedia, Display, TEXT("Wrote the frame trace to %s"), *Filename);
+			}
+			else
+			{
+				UE_LOG(LogDirectShowMedia, Warning, TEXT("Failed to write the frame trace to %s"), *Filename);
+			}
+		}));
+
+	/** Names of the events, in EDirectShowMediaFrameEvent order. */
+	const TCHAR* const EventNames[] =
+	{
+		TEXT("Callback"),
+		TEXT("Handle"),
+		TEXT("LockWait"),
+		TEXT("Copy"),
+		TEXT("Enqueue"),
+		TEXT("Dequeue"),
+		TEXT("PoolReturn"),
+	};
+
+	static_assert(UE_ARRAY_COUNT(EventNames) == (int32)EDirectShowMediaFrameEvent::Num, "Every event needs a name");
+
+	/** Returns a thread's ring to the tracer when the thread exits. */
+	struct FThreadBufferOwner
+	{
+		/** The thread's ring. */
+		std::atomic<bool>* bRetired = nullptr;
+
+		~FThreadBufferOwner()
+		{
+			if (bRetired != nullptr)
+			{
+				bRetired->store(true, std::memory_order_release);
+			}
+		}
+	};
+
+	/** The calling thread's ring. */
+	thread_local void* ThreadBuffer = nullptr;
+
+	/** Retires the calling thread's ring on exit. */
+	thread_local FThreadBufferOwner ThreadBufferOwner;
+
+	/** An event of a thread, for sorting the flows. */
+	struct FFlowEvent
+	{
+		uint64 Flow;
+		uint64 Start;
+		uint32 ThreadId;
+	};
+}
+
+
+/* FDirectShowMediaFrameTracer static functions
+ *****************************************************************************/
+
+FDirectShowMediaFrameTracer& FDirectShowMediaFrameTracer::Get()
+{
+	static FDirectShowMediaFrameTracer Tracer;
+	return Tracer;
+}
+
+
+uint32 FDirectShowMediaFrameTracer::NewTrack()
+{
+	static std::atomic<uint32> NextTrack(1);
+	return NextTrack.fetch_add(1, std::memory_order_relaxed);
+}
+
+
+/* FDirectShowMediaFrameTracer structors
+ *****************************************************************************/
+
+FDirectShowMediaFrameTracer::FDirectShowMediaFrameTracer()
+	: EnableTime(0)
+{ }
+
+
+/* FDirectShowMediaFrameTracer interface
+ *****************************************************************************/
+
+void FDirectShowMediaFrameTracer::SetEnabled(bool bInEnabled)
+{
+	// the rings are left alone, their writers don't lock; older events are skipped on export instead
+	if (bInEnabled)
+	{
+		EnableTime.store(Now(), std::memory_order_relaxed);
+	}
+
+	bEnabled.store(bInEnabled, std::memory_order_relaxed);
+}
+
+
+void FDirectShowMediaFrameTracer::Record(EDirectShowMediaFrameEvent Event, uint64 Start, uint64 End, uint64 Flow)
+{
+	FThreadBuffer& Buffer = GetThreadBuffer();
+
+	// single writer: nobody else stores the count, the release publishes the record to the exporter
+	const uint64 Index = Buffer.NumRecorded.load(std::memory_order_relaxed);
+	FDirectShowMediaFrameTraceRecord& Record = Buffer.Records[Index & (EventsPerThread - 1)];
+
+	Record.Start = Start;
+	Record.End = End;
+	Record.Flow = Flow;
+	Record.Event = Event;
+
+	Buffer.NumRecorded.store(Index + 1, std::memory_order_release);
+}
+
+
+FString FDirectShowMediaFrameTracer::ToChromeTrace() const
+{
+	const uint64 FirstTime = EnableTime.load(std::memory_order_relaxed);
+
+	struct FThreadEvents
+	{
+		uint32 ThreadId;
+		TArray<FDirectShowMediaFrameTraceRecord> Records;
+	};
+
+	TArray<FThreadEvents> Threads;
+	{
+		FScopeLock Lock(&CriticalSection);
+
+		for (const TUniquePtr<FThreadBuffer>& Buffer : Buffers)
+		{
+			const uint64 NumRecorded = Buffer->NumRecorded.load(std::memory_order_acquire);
+			const uint64 First = (NumRecorded > EventsPerThread) ? NumRecorded - EventsPerThread : 0;
+
+			FThreadEvents& Thread = Threads.AddDefaulted_GetRef();
+			Thread.ThreadId = Buffer->ThreadId;
+			Thread.Records.Reserve((int32)(NumRecorded - First));
+
+			for (uint64 Index = First; Index < NumRecorded; ++Index)
+			{
+				Thread.Records.Add(Buffer->Records[Index & (EventsPerThread - 1)]);
+			}
+
+			// the owner kept recording while the ring was copied, drop what it may have overwritten (an exited owner doesn't)
+			const uint64 NumRecordedAfter = Buffer->NumRecorded.load(std::memory_order_acquire);
+			const uint64 NumOverwritten = (!Buffer->bRetired.load(std::memory_order_acquire) && (NumRecordedAfter >= First + EventsPerThread)) ? NumRecordedAfter - EventsPerThread - First + 1 : 0;
+
+			Thread.Records.RemoveAt(0, (int32)FMath::Min<uint64>(NumOverwritten, Thread.Records.Num()));
+			Thread.Records.RemoveAll([FirstTime](const FDirectShowMediaFrameTraceRecord& Record) { return Record.Start < FirstTime; });
+		}
+	}
+
+	const double MicrosecondsPerCycle = FPlatformTime::GetSecondsPerCycle64() * 1.0e6;
+
+	FString Trace = TEXT("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	Trace += TEXT("{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"DirectShowMedia frames\"}}");
+
+	TArray<DirectShowMediaFrameTracer::FFlowEvent> FlowEvents;
+
+	for (const FThreadEvents& Thread : Threads)
+	{
+		if (Thread.Records.Num() == 0)
+		{
+			continue;
+		}
+
+		FString ThreadName = FThreadManager::GetThreadName(Thread.ThreadId);
+
+		if (ThreadName.IsEmpty())
+		{
+			// DirectShow's streaming threads aren't known to the engine
+			ThreadName = FString::Printf(TEXT("Thread %u"), Thread.ThreadId);
+		}
+
+		Trace += FString::Printf(TEXT(",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}"), Thread.ThreadId, *ThreadName.Replace(TEXT("\\"), TEXT("\\\\")).Replace(TEXT("\""), TEXT("\\\"")));
+
+		for (const FDirectShowMediaFrameTraceRecord& Record : Thread.Records)
+		{
+			// instant events get a sliver of duration, flows only bind to slices that enclose them
+			Trace += FString::Printf(TEXT(",\n{\"name\":\"%s\",\"cat\":\"DirectShowMedia\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"player\":%u,\"frame\":%llu}}"),
+				DirectShowMediaFrameTracer::EventNames[(int32)Record.Event], Thread.ThreadId,
+				(double)(Record.Start - FirstTime) * MicrosecondsPerCycle, FMath::Max(0.001, (double)(Record.End - Record.Start) * MicrosecondsPerCycle),
+				(uint32)(Record.Flow >> 40), Record.Flow & ((1ull << 40) - 1));
+
+			if (Record.Flow != 0)
+			{
+				FlowEvents.Add({ Record.Flow, Record.Start, Thread.ThreadId });
+			}
+		}
+	}
+
+	// each frame's events in time order, linked by flow arrows across threads
+	Algo::Sort(FlowEvents, [](const DirectShowMediaFrameTracer::FFlowEvent& A, const DirectShowMediaFrameTracer::FFlowEvent& B)
+	{
+		return (A.Flow != B.Flow) ? (A.Flow < B.Flow) : (A.Start < B.Start);
+	});
+
+	for (int32 EventIndex = 0; EventIndex < FlowEvents.Num(); ++EventIndex)
+	{
+		const DirectShowMediaFrameTracer::FFlowEvent& FlowEvent = FlowEvents[EventIndex];
+		const bool bFirst = (EventIndex == 0) || (FlowEvents[EventIndex - 1].Flow != FlowEvent.Flow);
+		const bool bLast = (EventIndex == FlowEvents.Num() - 1) || (FlowEvents[EventIndex + 1].Flow != FlowEvent.Flow);
+
+		if (bFirst && bLast)
+		{
+			continue;
+		}
+
+		// a phase binds to the innermost slice enclosing its timestamp, which is the one starting there
+		const double Time = (double)(FlowEvent.Start - FirstTime) * MicrosecondsPerCycle;
+
+		Trace += FString::Printf(TEXT(",\n{\"name\":\"frame\",\"cat\":\"DirectShowMedia\",\"ph\":\"%s\",%s\"id\":%llu,\"pid\":1,\"tid\":%u,\"ts\":%.3f}"),
+			bFirst ? TEXT("s") : (bLast ? TEXT("f") : TEXT("t")), bLast ? TEXT("\"bp\":\"e\",") : TEXT(""),
+			FlowEvent.Flow, FlowEvent.ThreadId, Time);
+	}
+
+	Trace += TEXT("\n]}\n");
+
+	return Trace;
+}
+
+
+bool FDirectShowMediaFrameTracer::SaveChromeTrace(const FString& Filename) const
+{
+	const FString Path = FPaths::IsRelative(Filename) ? FPaths::Combine(FPaths::ProjectSavedDir(), Filename) : Filename;
+
+	return FFileHelper::SaveStringToFile(ToChromeTrace(), *Path);
+}
+
+
+/* FDirectShowMediaFrameTracer implementation
+ *****************************************************************************/
+
+FDirectShowMediaFrameTracer::FThreadBuffer& FDirectShowMediaFrameTracer::GetThreadBuffer()
+{
+	if (DirectShowMediaFrameTracer::ThreadBuffer != nullptr)
+	{
+		return *static_cast<FThreadBuffer*>(DirectShowMediaFrameTracer::ThreadBuffer);
+	}
+
+	FScopeLock Lock(&CriticalSection);
+
+	FThreadBuffer* Buffer = nullptr;
+
+	const uint64 FirstTime = EnableTime.load(std::memory_order_relaxed);
+
+	// capture workers come and go with every open, their rings are reused rather than piling up,
+	// unless they still hold events of the current trace
+	for (const TUniquePtr<FThreadBuffer>& Retired : Buffers)
+	{
+		if (!Retired->bRetired.load(std::memory_order_acquire))
+		{
+			continue;
+		}
+
+		const uint64 NumRecorded = Retired->NumRecorded.load(std::memory_order_relaxed);
+
+		if ((NumRecorded == 0) || (Retired->Records[(NumRecorded - 1) & (EventsPerThread - 1)].Start < FirstTime))
+		{
+			Buffer = Retired.Get();
+			Buffer->bRetired.store(false, std::memory_order_relaxed);
+			Buffer->NumRecorded.store(0, std::memory_order_relaxed);
+
+			break;
+		}
+	}
+
+	if (Buffer == nullptr)
+	{
+		Buffer = Buffers.Add_GetRef(MakeUnique<FThreadBuffer>()).Get();
+		Buffer->Records.SetNumUninitialized(EventsPerThread);
+	}
+
+	Buffer->ThreadId = FPlatformTLS::GetCurrentThreadId();
+
+	DirectShowMediaFrameTracer::ThreadBuffer = Buffer;
+	DirectShowMediaFrameTracer::ThreadBufferOwner.bRetired = &Buffer->bRetired;
+
+	return *Buffer;
+}
@@ -0,0 +1,244 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include <atomic>
+
+#include "CoreTypes.h"
+#include "Containers/Array.h"
+#include "Containers/UnrealString.h"
+#include "HAL/CriticalSection.h"
+#include "HAL/PlatformTime.h"
+#include "Templates/UniquePtr.h"
+
+
+/** Steps of a video frame's way through a player. */
+enum class EDirectShowMediaFrameEvent : uint8
+{
+	/** The sample callback on the graph's streaming thread, from entry to return. */
+	Callback,
+
+	/** Handling the sample, on the streaming thread or the capture worker. */
+	Handle,
+
+	/** Waiting for the sample lock while handling the sample. */
+	LockWait,
+
+	/** Copying or converting the frame into the sample. */
+	Copy,
+
+	/** The sample was queued for the game thread. */
+	Enqueue,
+
+	/** FetchVideo handed the sample to the engine. */
+	Dequeue,
+
+	/** The sample went back to the pool. */
+	PoolReturn,
+
+	Num
+};
+
+
+/** A recorded event, a slice from Start to End (equal for instant events). */
+struct FDirectShowMediaFrameTraceRecord
+{
+	/** Time the event began (in cycles). */
+	uint64 Start;
+
+	/** Time the event ended (in cycles). */
+	uint64 End;
+
+	/** The frame's flow (see MakeFlow), zero if the event isn't tied to a frame. */
+	uint64 Flow;
+
+	/** The event. */
+	EDirectShowMediaFrameEvent Event;
+};
+
+
+/**
+ * Process wide tracer of the video frames' way through the players, across threads.
+ *
+ * Every thread records into its own ring of the most recent events, so recording takes no lock: one relaxed
+ * load while tracing is disabled, and a clock read plus a store into the thread's ring while it is enabled.
+ * A thread's ring is registered the first time it records (the only time the tracer locks on that thread),
+ * and handed to a new thread once the thread that owned it exited and its events predate the current trace.
+ *
+ * Tracing is toggled with DirectShowMedia.FrameTrace, and DirectShowMedia.FrameTrace.Save writes the events
+ * recorded since it was enabled as a Chrome trace (chrome://tracing, Perfetto), with one slice per event and
+ * flow arrows following each frame from the sample callback to the pool.
+ */
+class FDirectShowMediaFrameTracer
+{
+public:
+
+	/** Get the shared tracer. */
+	static FDirectShowMediaFrameTracer& Get();
+
+	/** Whether events are recorded. */
+	static bool IsEnabled()
+	{
+		return bEnabled.load(std::memory_order_relaxed);
+	}
+
+	/** Get the current time (in cycles). */
+	static uint64 Now()
+	{
+		return FPlatformTime::Cycles64();
+	}
+
+	/**
+	 * Make the flow of a frame, unique across players.
+	 *
+	 * @param Track The player's track (see NewTrack).
+	 * @param FrameNumber The frame's number within the player.
+	 * @return The flow.
+	 */
+	static uint64 MakeFlow(uint32 Track, uint64 FrameNumber)
+	{
+		return ((uint64)Track << 40) | (FrameNumber & ((1ull << 40) - 1));
+	}
+
+	/** Get a new track, to tell the frames of different players apart. */
+	static uint32 NewTrack();
+
+	/**
+	 * Record an instant event if tracing is enabled.
+	 *
+	 * @param Event The event.
+	 * @param Flow The frame's flow.
+	 */
+	static void Mark(EDirectShowMediaFrameEvent Event, uint64 Flow)
+	{
+		if (IsEnabled())
+		{
+			const uint64 Time = Now();
+			Get().Record(Event, Time, Time, Flow);
+		}
+	}
+
+	/** Number of events each thread keeps. */
+	static const int32 EventsPerThread = 8192;
+
+public:
+
+	/** Default constructor. */
+	FDirectShowMediaFrameTracer();
+
+public:
+
+	/**
+	 * Enable or disable tracing, discarding the events recorded so far when enabled.
+	 *
+	 * @param bInEnabled Whether to record events.
+	 */
+	void SetEnabled(bool bInEnabled);
+
+	/**
+	 * Record an event on the calling thread.
+	 *
+	 * @param Event The event.
+	 * @param Start Time the event began (in cycles).
+	 * @param End Time the event ended (in cycles).
+	 * @param Flow The frame's flow, or zero.
+	 */
+	void Record(EDirectShowMediaFrameEvent Event, uint64 Start, uint64 End, uint64 Flow);
+
+	/**
+	 * Convert the events recorded since tracing was enabled to a Chrome trace.
+	 *
+	 * Events recorded while the trace is built may be missing; events overwritten while it is built are left out.
+	 *
+	 * @return The trace (JSON).
+	 */
+	FString ToChromeTrace() const;
+
+	/**
+	 * Write the events recorded since tracing was enabled as a Chrome trace.
+	 *
+	 * @param Filename The file, relative to the project's Saved directory.
+	 * @return true on success, false otherwise.
+	 */
+	bool SaveChromeTrace(const FString& Filename) const;
+
+private:
+
+	/** A thread's ring of events. */
+	struct FThreadBuffer
+	{
+		/** The events, EventsPerThread in size. */
+		TArray<FDirectShowMediaFrameTraceRecord> Records;
+
+		/** Number of events recorded, written by the owning thread only. */
+		std::atomic<uint64> NumRecorded{ 0 };
+
+		/** The owning thread. */
+		uint32 ThreadId = 0;
+
+		/** Whether the owning thread exited, so the ring can be handed to another thread. */
+		std::atomic<bool> bRetired{ false };
+	};
+
+	/** Get the calling thread's ring, registering one on first use. */
+	FThreadBuffer& GetThreadBuffer();
+
+private:
+
+	/** Whether events are recorded. */
+	static std::atomic<bool> bEnabled;
+
+	/** Time tracing was last enabled (in cycles), events before it are left out. */
+	std::atomic<uint64> EnableTime;
+
+	/** Protects the list of rings (registration and export only). */
+	mutable FCriticalSection CriticalSection;
+
+	/** The rings of all threads that recorded. */
+	TArray<TUniquePtr<FThreadBuffer>> Buffers;
+};
+
+
+/** Records an event from construction to destruction if tracing is enabled. */
+class FDirectShowMediaFrameTraceScope
+{
+public:
+
+	/**
+	 * Begin the event.
+	 *
+	 * @param InEvent The event.
+	 * @param InFlow The frame's flow, or zero if it isn't known yet (see SetFlow).
+	 */
+	explicit FDirectShowMediaFrameTraceScope(EDirectShowMediaFrameEvent InEvent, uint64 InFlow = 0)
+		: Start(FDirectShowMediaFrameTracer::IsEnabled() ? FDirectShowMediaFrameTracer::Now() : 0)
+		, Flow(InFlow)
+		, Event(InEvent)
+	{ }
+
+	/** End the event. */
+	~FDirectShowMediaFrameTraceScope()
+	{
+		if (Start != 0)
+		{
+			FDirectShowMediaFrameTracer::Get().Record(Event, Start, FDirectShowMediaFrameTracer::Now(), Flow);
+		}
+	}
+
+	/** Set the frame's flow once it is known. */
+	void SetFlow(uint64 InFlow)
+	{
+		Flow = InFlow;
+	}
+
+private:
+
+	/** Time the event began (in cycles), zero if tracing was disabled. */
+	uint64 Start;
+
+	/** The frame's flow. */
+	uint64 Flow;
+
+	/** The event. */
+	EDirectShowMediaFrameEvent Event;
+};
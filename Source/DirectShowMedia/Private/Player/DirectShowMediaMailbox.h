@@ -0,0 +1,134 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include <atomic>
+
+#include "CoreTypes.h"
+#include "Templates/SharedPointer.h"
+
+
+/**
+ * Lock-free "latest sample only" triple buffer.
+ *
+ * The producer always writes into its private back slot and publishes it by swapping it with the shared
+ * middle slot; the consumer swaps the middle slot with its private front slot when a new sample is
+ * available. Samples that were published but never fetched are released as soon as they are superseded,
+ * which hands pooled samples straight back to their pool.
+ *
+ * Publish and Retract must only be called from one producer thread, Fetch and Flush from one consumer thread.
+ */
+template<typename SampleType>
+class TDirectShowMediaMailbox
+{
+public:
+
+	typedef TSharedPtr<SampleType, ESPMode::ThreadSafe> FSamplePtr;
+
+	/** Default constructor. */
+	TDirectShowMediaMailbox()
+		: State(1)
+		, BackIndex(0)
+		, FrontIndex(2)
+		, NumSuperseded(0)
+	{ }
+
+public:
+
+	/**
+	 * Publish a new sample, replacing any sample that hasn't been fetched yet.
+	 *
+	 * @param Sample The sample to publish.
+	 * @see Fetch
+	 */
+	void Publish(const FSamplePtr& Sample)
+	{
+		Slots[BackIndex] = Sample;
+
+		const uint32 Previous = State.exchange(BackIndex | DirtyFlag, std::memory_order_acq_rel);
+		BackIndex = Previous & IndexMask;
+
+		if ((Previous & DirtyFlag) != 0)
+		{
+			++NumSuperseded;
+		}
+
+		// either a superseded sample or an empty slot the consumer already moved out of
+		Slots[BackIndex].Reset();
+	}
+
+	/**
+	 * Drop the pending sample from the producer side, if any.
+	 *
+	 * Publishes an empty sample, so the consumer's next Fetch finds nothing without the producer touching the
+	 * consumer's slot.
+	 *
+	 * @see Flush
+	 */
+	void Retract()
+	{
+		Publish(FSamplePtr());
+	}
+
+	/**
+	 * Take the most recently published sample.
+	 *
+	 * @param OutSample Will contain the sample.
+	 * @return true if a sample was published since the last fetch, false otherwise.
+	 * @see Publish
+	 */
+	bool Fetch(FSamplePtr& OutSample)
+	{
+		if ((State.load(std::memory_order_acquire) & DirtyFlag) == 0)
+		{
+			return false;
+		}
+
+		const uint32 Previous = State.exchange(FrontIndex, std::memory_order_acq_rel);
+		FrontIndex = Previous & IndexMask;
+
+		OutSample = MoveTemp(Slots[FrontIndex]);
+
+		return OutSample.IsValid();
+	}
+
+	/**
+	 * Drop the pending sample from the consumer side, if any.
+	 *
+	 * @see Retract
+	 */
+	void Flush()
+	{
+		FSamplePtr Discarded;
+		Fetch(Discarded);
+	}
+
+	/** Number of published samples that were replaced before anybody fetched them. */
+	uint64 GetNumSuperseded() const
+	{
+		return NumSuperseded;
+	}
+
+private:
+
+	/** State bit that is set when the middle slot holds a sample that hasn't been fetched. */
+	static constexpr uint32 DirtyFlag = 0x4;
+
+	/** State bits that contain the index of the middle slot. */
+	static constexpr uint32 IndexMask = 0x3;
+
+	/** The three sample slots. */
+	FSamplePtr Slots[3];
+
+	/** Index of the shared middle slot and its dirty flag. */
+	std::atomic<uint32> State;
+
+	/** Index of the slot owned by the producer. */
+	uint32 BackIndex;
+
+	/** Index of the slot owned by the consumer. */
+	uint32 FrontIndex;
+
+	/** Number of samples that were superseded (producer side). */
+	uint64 NumSuperseded;
+};
@@ -0,0 +1,196 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "DirectShowMediaMemoryBudget.h"
+
+#include "HAL/IConsoleManager.h"
+#include "Misc/ScopeLock.h"
+
+
+namespace DirectShowMediaMemoryBudget
+{
+	/** Capture memory budget in megabytes, zero for no limit. */
+	int32 BudgetMB = 0;
+
+	/** Get the budget in bytes. */
+	uint64 GetBudgetBytes()
+	{
+		return (uint64)FMath::Max(0, BudgetMB) << 20;
+	}
+
+	FAutoConsoleVariableRef CVarBudgetMB(
+		TEXT("DirectShowMedia.MemoryBudgetMB"),
+		BudgetMB,
+		TEXT("Memory all DirectShow players may commit to video frames, in megabytes (0 = no limit).\n")
+		TEXT("Over budget, players shrink their video queue, then switch to mailbox mode, then reduce resolution."),
+		FConsoleVariableDelegate::CreateLambda([](IConsoleVariable*)
+		{
+			FDirectShowMediaMemoryBudget::Get().SetBudget(GetBudgetBytes());
+		}),
+		ECVF_Default);
+}
+
+
+/* FDirectShowMediaMemoryBudget static functions
+ *****************************************************************************/
+
+FDirectShowMediaMemoryBudget& FDirectShowMediaMemoryBudget::Get()
+{
+	static FDirectShowMediaMemoryBudget Budget;
+	return Budget;
+}
+
+
+uint64 FDirectShowMediaMemoryBudget::GetFootprint(const FDirectShowMediaMemoryDemand& Demand, EDirectShowMediaMemoryLevel Level)
+{
+	uint64 FrameBytes = Demand.FrameBytes;
+	int32 QueueDepth = Demand.QueueDepth;
+
+	if (Level >= EDirectShowMediaMemoryLevel::ShrinkQueue)
+	{
+		QueueDepth = FMath::Min(QueueDepth, Demand.MinQueueDepth);
+	}
+
+	if ((Level >= EDirectShowMediaMemoryLevel::Mailbox) && Demand.bCanUseMailbox)
+	{
+		QueueDepth = FMath::Min(QueueDepth, 1);
+	}
+
+	if ((Level >= EDirectShowMediaMemoryLevel::ReduceResolution) && (Demand.ReducedFrameBytes > 0))
+	{
+		FrameBytes = FMath::Min(FrameBytes, Demand.ReducedFrameBytes);
+	}
+
+	return (FrameBytes > 0) ? FrameBytes * (uint64)(FMath::Max(0, QueueDepth) + FramesInFlight) : 0;
+}
+
+
+/* FDirectShowMediaMemoryBudget structors
+ *****************************************************************************/
+
+FDirectShowMediaMemoryBudget::FDirectShowMediaMemoryBudget()
+	: BudgetBytes(DirectShowMediaMemoryBudget::GetBudgetBytes())
+	, CommittedBytes(0)
+	, PeakBytes(0)
+{ }
+
+
+/* FDirectShowMediaMemoryBudget interface
+ *****************************************************************************/
+
+void FDirectShowMediaMemoryBudget::Open(FDirectShowMediaMemoryAccount& Account)
+{
+	FScopeLock Lock(&CriticalSection);
+
+	Account.Demand = FDirectShowMediaMemoryDemand();
+	Accounts.AddUnique(&Account);
+	Rebalance();
+}
+
+
+void FDirectShowMediaMemoryBudget::Close(FDirectShowMediaMemoryAccount& Account)
+{
+	FScopeLock Lock(&CriticalSection);
+
+	Accounts.RemoveSingleSwap(&Account);
+	Account.Level.store((uint8)EDirectShowMediaMemoryLevel::Full, std::memory_order_release);
+	Account.CommittedBytes.store(0, std::memory_order_relaxed);
+	Rebalance();
+}
+
+
+void FDirectShowMediaMemoryBudget::SetDemand(FDirectShowMediaMemoryAccount& Account, const FDirectShowMediaMemoryDemand& Demand)
+{
+	FScopeLock Lock(&CriticalSection);
+
+	Account.Demand = Demand;
+	Rebalance();
+}
+
+
+void FDirectShowMediaMemoryBudget::SetBudget(uint64 InBudgetBytes)
+{
+	FScopeLock Lock(&CriticalSection);
+
+	BudgetBytes.store(InBudgetBytes, std::memory_order_relaxed);
+	Rebalance();
+}
+
+
+int32 FDirectShowMediaMemoryBudget::GetNumAccounts() const
+{
+	FScopeLock Lock(&CriticalSection);
+	return Accounts.Num();
+}
+
+
+/* FDirectShowMediaMemoryBudget implementation
+ *****************************************************************************/
+
+void FDirectShowMediaMemoryBudget::Rebalance()
+{
+	struct FCandidate
+	{
+		FDirectShowMediaMemoryAccount* Account;
+		EDirectShowMediaMemoryLevel Level;
+		uint64 Footprint;
+	};
+
+	TArray<FCandidate, TInlineAllocator<16>> Candidates;
+	uint64 Total = 0;
+
+	for (FDirectShowMediaMemoryAccount* Account : Accounts)
+	{
+		const uint64 Footprint = GetFootprint(Account->Demand, EDirectShowMediaMemoryLevel::Full);
+		Candidates.Add({ Account, EDirectShowMediaMemoryLevel::Full, Footprint });
+		Total += Footprint;
+	}
+
+	const uint64 Budget = BudgetBytes.load(std::memory_order_relaxed);
+
+	if (Budget > 0)
+	{
+		const EDirectShowMediaMemoryLevel Steps[] = { EDirectShowMediaMemoryLevel::ShrinkQueue, EDirectShowMediaMemoryLevel::Mailbox, EDirectShowMediaMemoryLevel::ReduceResolution };
+
+		for (const EDirectShowMediaMemoryLevel Step : Steps)
+		{
+			if (Total <= Budget)
+			{
+				break;
+			}
+
+			// the largest players go first, so the fewest players degrade
+			Candidates.Sort([](const FCandidate& A, const FCandidate& B) { return A.Footprint > B.Footprint; });
+
+			for (FCandidate& Candidate : Candidates)
+			{
+				if (Total <= Budget)
+				{
+					break;
+				}
+
+				const uint64 Footprint = GetFootprint(Candidate.Account->Demand, Step);
+
+				// steps that don't apply to the player (i.e. no lower resolution) are skipped
+				if (Footprint < Candidate.Footprint)
+				{
+					Total -= Candidate.Footprint - Footprint;
+					Candidate.Level = Step;
+					Candidate.Footprint = Footprint;
+				}
+			}
+		}
+	}
+
+	for (const FCandidate& Candidate : Candidates)
+	{
+		Candidate.Account->CommittedBytes.store(Candidate.Footprint, std::memory_order_relaxed);
+		Candidate.Account->Level.store((uint8)Candidate.Level, std::memory_order_release);
+	}
+
+	CommittedBytes.store(Total, std::memory_order_relaxed);
+
+	if (Total > PeakBytes.load(std::memory_order_relaxed))
+	{
+		PeakBytes.store(Total, std::memory_order_relaxed);
+	}
+}
@@ -0,0 +1,196 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include <atomic>
+
+#include "CoreTypes.h"
+#include "Containers/Array.h"
+#include "HAL/CriticalSection.h"
+
+
+/** Steps a player degrades through when the capture memory budget is exceeded, in the order they are taken. */
+enum class EDirectShowMediaMemoryLevel : uint8
+{
+	/** The full video queue. */
+	Full,
+
+	/** The video queue is shrunk to its minimum depth. */
+	ShrinkQueue,
+
+	/** Only the newest video frame is kept (mailbox mode). */
+	Mailbox,
+
+	/** A lower resolution format of the video track is captured, in mailbox mode. */
+	ReduceResolution
+};
+
+
+/** The memory a player needs to hold its video frames. */
+struct FDirectShowMediaMemoryDemand
+{
+	/** Size of a frame at the player's preferred format (zero if the player holds no frames). */
+	uint64 FrameBytes = 0;
+
+	/** Number of frames queued at full depth. */
+	int32 QueueDepth = 0;
+
+	/** Number of frames queued once the queue is shrunk. */
+	int32 MinQueueDepth = 0;
+
+	/** Whether the player can switch to mailbox mode. */
+	bool bCanUseMailbox = false;
+
+	/** Size of a frame at the reduced resolution, or zero if the track has no lower resolution format. */
+	uint64 ReducedFrameBytes = 0;
+};
+
+
+/**
+ * A player's share of the capture memory budget.
+ *
+ * The budget assigns a level to the account whenever the demand of any player or the budget changes. The
+ * player polls the level on its streaming thread and applies it to its queues.
+ *
+ * @see FDirectShowMediaMemoryBudget
+ */
+class FDirectShowMediaMemoryAccount
+{
+public:
+
+	/** Get the level assigned by the budget. */
+	EDirectShowMediaMemoryLevel GetLevel() const
+	{
+		return (EDirectShowMediaMemoryLevel)Level.load(std::memory_order_acquire);
+	}
+
+	/** Get the number of bytes committed to the player at its level. */
+	uint64 GetCommittedBytes() const
+	{
+		return CommittedBytes.load(std::memory_order_relaxed);
+	}
+
+private:
+
+	friend class FDirectShowMediaMemoryBudget;
+
+	/** The player's demand (budget lock). */
+	FDirectShowMediaMemoryDemand Demand;
+
+	/** The assigned level. */
+	std::atomic<uint8> Level{ (uint8)EDirectShowMediaMemoryLevel::Full };
+
+	/** Number of bytes committed at the assigned level. */
+	std::atomic<uint64> CommittedBytes{ 0 };
+};
+
+
+/**
+ * Process wide capture memory budget with per player accounting.
+ *
+ * Every player accounts for the frames its video queue, the frame being captured and the frame being
+ * rendered can hold. While the committed total exceeds the budget (DirectShowMedia.MemoryBudgetMB, zero for
+ * no limit), players are degraded one step at a time in a fixed order: all queues are shrunk first, then
+ * switched to mailbox mode, then reduced in resolution. Within a step the players with the largest footprint
+ * go first, so as few players as possible degrade. Levels are recomputed from scratch on every change, so
+ * players recover in the reverse order when memory frees up.
+ */
+class FDirectShowMediaMemoryBudget
+{
+public:
+
+	/** Get the shared budget. */
+	static FDirectShowMediaMemoryBudget& Get();
+
+	/**
+	 * Get the number of bytes a demand commits at a level.
+	 *
+	 * @param Demand The player's demand.
+	 * @param Level The level.
+	 * @return The number of bytes.
+	 */
+	static uint64 GetFootprint(const FDirectShowMediaMemoryDemand& Demand, EDirectShowMediaMemoryLevel Level);
+
+	/** Number of frames a player holds beyond its queue (the one being captured and the one being rendered). */
+	static const int32 FramesInFlight = 2;
+
+public:
+
+	/** Default constructor. */
+	FDirectShowMediaMemoryBudget();
+
+public:
+
+	/**
+	 * Add a player's account.
+	 *
+	 * @param Account The account, which must stay valid until it is closed.
+	 * @see Close
+	 */
+	void Open(FDirectShowMediaMemoryAccount& Account);
+
+	/**
+	 * Remove a player's account, giving its memory to the remaining players.
+	 *
+	 * @param Account The account.
+	 */
+	void Close(FDirectShowMediaMemoryAccount& Account);
+
+	/**
+	 * Update a player's demand.
+	 *
+	 * @param Account The player's account.
+	 * @param Demand The new demand (default constructed when the player holds no frames).
+	 */
+	void SetDemand(FDirectShowMediaMemoryAccount& Account, const FDirectShowMediaMemoryDemand& Demand);
+
+	/**
+	 * Change the budget.
+	 *
+	 * @param InBudgetBytes The budget (in bytes), or zero for no limit.
+	 */
+	void SetBudget(uint64 InBudgetBytes);
+
+	/** Get the budget (in bytes), zero if there is no limit. */
+	uint64 GetBudget() const
+	{
+		return BudgetBytes.load(std::memory_order_relaxed);
+	}
+
+	/** Get the number of bytes committed to all players. */
+	uint64 GetCommittedBytes() const
+	{
+		return CommittedBytes.load(std::memory_order_relaxed);
+	}
+
+	/** Get the highest number of bytes committed to all players at once. */
+	uint64 GetPeakBytes() const
+	{
+		return PeakBytes.load(std::memory_order_relaxed);
+	}
+
+	/** Get the number of players with an account. */
+	int32 GetNumAccounts() const;
+
+private:
+
+	/** Assign the levels of all accounts (budget lock). */
+	void Rebalance();
+
+private:
+
+	/** Synchronizes the players' streaming threads and the game thread. */
+	mutable FCriticalSection CriticalSection;
+
+	/** The open accounts. */
+	TArray<FDirectShowMediaMemoryAccount*> Accounts;
+
+	/** The budget (in bytes), zero for no limit. */
+	std::atomic<uint64> BudgetBytes;
+
+	/** Number of bytes committed to all players. */
+	std::atomic<uint64> CommittedBytes;
+
+	/** Highest number of bytes committed to all players at once. */
+	std::atomic<uint64> PeakBytes;
+};
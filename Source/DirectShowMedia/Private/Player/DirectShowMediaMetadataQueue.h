@@ -0,0 +1,150 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreTypes.h"
+#include "DirectShowMediaFrameMetadata.h"
+#include "DirectShowMediaMetadataSample.h"
+#include "IMediaBinarySample.h"
+#include "Math/Range.h"
+#include "MediaSampleQueue.h"
+#include "Misc/Timespan.h"
+#include "Templates/SharedPointer.h"
+
+
+/**
+ * The samples of a player's metadata track.
+ *
+ * Frame side data is copied into pooled samples that hold it inline, so once the pool has as many samples as
+ * the consumer keeps in flight, queuing a frame's side data reuses one of them instead of allocating.
+ *
+ * Add may be called from the capture thread while Fetch is called from the consumer, as with TMediaSampleQueue.
+ */
+class FDirectShowMediaMetadataQueue
+{
+public:
+
+	/**
+	 * Create and initialize a new instance.
+	 *
+	 * @param InMaxDepth Maximum number of samples waiting to be fetched.
+	 */
+	explicit FDirectShowMediaMetadataQueue(int32 InMaxDepth)
+		: MaxDepth(InMaxDepth)
+	{ }
+
+public:
+
+	/**
+	 * Queue the side data of a frame.
+	 *
+	 * @param FrameMetadata The side data.
+	 * @param Time The frame time (relative to presentation clock).
+	 * @param Duration The duration for which the frame is valid.
+	 * @return true if the side data was queued, false if the queue is full.
+	 */
+	bool Add(const FDirectShowMediaFrameMetadata& FrameMetadata, FTimespan Time, FTimespan Duration)
+	{
+		if (Queue.Num() >= MaxDepth)
+		{
+			return false;
+		}
+
+		const TSharedRef<FDirectShowMediaMetadataSample, ESPMode::ThreadSafe> Sample = SamplePool.AcquireShared();
+		Sample->Initialize(FrameMetadata, Time, Duration);
+
+		return Queue.Enqueue(Sample);
+	}
+
+	/**
+	 * Queue a binary sample of another source.
+	 *
+	 * @param Sample The sample.
+	 * @return true if the sample was queued, false if the queue is full.
+	 */
+	bool Add(const TSharedRef<IMediaBinarySample, ESPMode::ThreadSafe>& Sample)
+	{
+		if (Queue.Num() >= MaxDepth)
+		{
+			return false;
+		}
+
+		return Queue.Enqueue(Sample);
+	}
+
+	/**
+	 * Take the oldest sample if it overlaps a time range.
+	 *
+	 * @param TimeRange The time range.
+	 * @param OutSample Will contain the sample.
+	 * @return true if a sample was taken, false otherwise.
+	 */
+	bool Fetch(TRange<FTimespan> TimeRange, TSharedPtr<IMediaBinarySample, ESPMode::ThreadSafe>& OutSample)
+	{
+		TSharedPtr<IMediaBinarySample, ESPMode::ThreadSafe> Sample;
+
+		if (!Queue.Peek(Sample))
+		{
+			return false;
+		}
+
+		const FTimespan SampleTime = Sample->GetTime().Time;
+
+		if (!TimeRange.Overlaps(TRange<FTimespan>(SampleTime, SampleTime + Sample->GetDuration())))
+		{
+			return false;
+		}
+
+		if (!Queue.Dequeue(Sample))
+		{
+			return false;
+		}
+
+		OutSample = Sample;
+
+		return true;
+	}
+
+	/** Drop the queued samples. */
+	void Flush()
+	{
+		Queue.RequestFlush();
+	}
+
+	/** Free the pooled samples that aren't in use. */
+	void Reset()
+	{
+		SamplePool.Reset();
+	}
+
+	/**
+	 * Get the number of queued samples.
+	 *
+	 * @return Number of samples.
+	 */
+	int32 Num() const
+	{
+		return Queue.Num();
+	}
+
+	/**
+	 * Get the number of pooled samples that aren't in use.
+	 *
+	 * @return Number of samples.
+	 */
+	int32 GetNumPooled() const
+	{
+		return SamplePool.Num();
+	}
+
+private:
+
+	/** Maximum number of samples waiting to be fetched. */
+	int32 MaxDepth;
+
+	/** Frame side data samples. */
+	FDirectShowMediaMetadataSamplePool SamplePool;
+
+	/** Samples waiting to be fetched. */
+	TMediaSampleQueue<IMediaBinarySample> Queue;
+};
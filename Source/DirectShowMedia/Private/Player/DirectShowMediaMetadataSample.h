@@ -0,0 +1,90 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreTypes.h"
+#include "DirectShowMediaFrameMetadata.h"
+#include "IMediaBinarySample.h"
+#include "MediaObjectPool.h"
+#include "MediaSampleQueue.h"
+#include "Misc/Timespan.h"
+
+
+/**
+ * Implements a frame metadata sample for DirectShowMedia.
+ *
+ * The side data is held in the sample itself, so pooled samples are reused without allocating.
+ */
+class FDirectShowMediaMetadataSample
+	: public IMediaBinarySample
+	, public IMediaPoolable
+{
+public:
+
+	/** Default constructor. */
+	FDirectShowMediaMetadataSample()
+		: Duration(FTimespan::Zero())
+		, Time(FTimespan::Zero())
+	{ }
+
+	/** Virtual destructor. */
+	virtual ~FDirectShowMediaMetadataSample() { }
+
+public:
+
+	/**
+	 * Initialize the sample.
+	 *
+	 * @param InFrameMetadata The side data of the frame.
+	 * @param InTime The sample time (relative to presentation clock).
+	 * @param InDuration The duration for which the sample is valid.
+	 */
+	void Initialize(
+		const FDirectShowMediaFrameMetadata& InFrameMetadata,
+		FTimespan InTime,
+		FTimespan InDuration)
+	{
+		FrameMetadata = InFrameMetadata;
+		Duration = InDuration;
+		Time = InTime;
+	}
+
+public:
+
+	//~ IMediaBinarySample interface
+
+	virtual const void* GetData() override
+	{
+		return &FrameMetadata;
+	}
+
+	virtual FTimespan GetDuration() const override
+	{
+		return Duration;
+	}
+
+	virtual uint32 GetSize() const override
+	{
+		return sizeof(FDirectShowMediaFrameMetadata);
+	}
+
+	virtual FMediaTimeStamp GetTime() const override
+	{
+		return FMediaTimeStamp(Time);
+	}
+
+private:
+
+	/** Duration for which the sample is valid. */
+	FTimespan Duration;
+
+	/** The side data. */
+	FDirectShowMediaFrameMetadata FrameMetadata;
+
+	/** Presentation time for which the sample was generated. */
+	FTimespan Time;
+};
+
+
+/** Implements a pool for DirectShow metadata samples. */
+class FDirectShowMediaMetadataSamplePool : public TMediaObjectPool<FDirectShowMediaMetadataSample> { };
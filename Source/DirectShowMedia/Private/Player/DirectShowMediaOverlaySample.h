@@ -3,8 +3,9 @@
 #pragma once
 
 #include "CoreTypes.h"
+#include "Containers/Array.h"
 #include "IMediaOverlaySample.h"
-#include "Internationalization/Regex.h"
+#include "MediaObjectPool.h"
 #include "MediaSampleQueue.h"
 #include "Misc/Timespan.h"
 
@@ -14,6 +15,7 @@
  */
 class FDirectShowMediaOverlaySample
 	: public IMediaOverlaySample
+	, public IMediaPoolable
 {
 public:
 
@@ -21,6 +23,7 @@ public:
 	FDirectShowMediaOverlaySample()
 		: Duration(FTimespan::Zero())
 		, Time(FTimespan::Zero())
+		, bTextValid(false)
 	{ }
 
 	/** Virtual destructor. */
@@ -31,48 +34,30 @@ public:
 	/**
 	 * Initialize the sample.
 	 *
-	 * @param InBuffer The sample's data buffer.
+	 * The text is copied into the sample's buffer, which is kept when the sample goes back to its pool.
+	 *
+	 * @param InText The caption text (markup already removed).
+	 * @param InLength Length of the text (in characters).
 	 * @param InTime The sample time (relative to presentation clock).
 	 * @param InDuration The duration for which the sample is valid.
+	 * @see FDirectShowMediaCaptionDecoder
 	 */
 	bool Initialize(
-		const char* InBuffer,
+		const TCHAR* InText,
+		int32 InLength,
 		FTimespan InTime,
 		FTimespan InDuration)
 	{
-		if (InBuffer == nullptr)
+		if ((InText == nullptr) || (InLength < 0))
 		{
 			return false;
 		}
 
-		// simply strip all formatting for now
-		FString StrippedText;
-		{
-			static const FRegexPattern StripHtmlPattern(TEXT("<(?:[^>=]|='[^']*'|=\"[^\"]*\"|=[^'\"][^\\s>]*)*>"));
-
-			const FString InputText = ANSI_TO_TCHAR(InBuffer);
-			FRegexMatcher Matcher(StripHtmlPattern, InputText);
-
-			int32 TextBegin = INDEX_NONE;
-
-			while (Matcher.FindNext())
-			{
-				if (TextBegin != INDEX_NONE)
-				{
-					StrippedText += InputText.Mid(TextBegin, Matcher.GetMatchBeginning() - TextBegin);
-				}
-
-				TextBegin = Matcher.GetMatchEnding();
-			}
-
-			if (TextBegin > INDEX_NONE)
-			{
-				StrippedText += InputText.Mid(TextBegin);
-			}
-		}
+		TextBuffer.Reset(InLength);
+		TextBuffer.Append(InText, InLength);
+		bTextValid = false;
 
 		Duration = (InDuration < FTimespan::Zero()) ? FTimespan::MaxValue() : InDuration;
-		Text = FText::FromString(StrippedText);
 		Time = InTime;
 
 		return true;
@@ -94,6 +79,13 @@ public:
 
 	virtual FText GetText() const override
 	{
+		// built on first use by the consumer, not on the capture thread
+		if (!bTextValid)
+		{
+			Text = FText::FromString(FString(TextBuffer.Num(), TextBuffer.GetData()));
+			bTextValid = true;
+		}
+
 		return Text;
 	}
 
@@ -112,9 +104,19 @@ private:
 	/** The duration for which the sample is valid. */
 	FTimespan Duration;
 
-	/** The overlay text. */
-	FText Text;
+	/** The caption text. */
+	TArray<TCHAR> TextBuffer;
+
+	/** The overlay text, built from TextBuffer when first requested. */
+	mutable FText Text;
+
+	/** Whether Text matches TextBuffer. */
+	mutable bool bTextValid;
 
 	/** Presentation time for which the sample was generated. */
 	FTimespan Time;
 };
+
+
+/** Implements a pool for DirectShow overlay samples. */
+class FDirectShowMediaOverlaySamplePool : public TMediaObjectPool<FDirectShowMediaOverlaySample> { };
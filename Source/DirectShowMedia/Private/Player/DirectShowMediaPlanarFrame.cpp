@@ -0,0 +1,143 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "DirectShowMediaPlanarFrame.h"
+
+#include "HAL/UnrealMemory.h"
+#include "Math/UnrealMathUtility.h"
+
+
+/* FDirectShowMediaPlanarFrame interface
+ *****************************************************************************/
+
+bool FDirectShowMediaPlanarFrame::GetPlanes(EDirectShowMediaPlanarFormat Format, const uint8* InBuffer, uint32 InSize, const FIntPoint& Dim, uint32 Pitch, FDirectShowMediaPlane* OutPlanes, int32& OutNumPlanes)
+{
+	OutNumPlanes = 0;
+
+	if (Pitch == 0)
+	{
+		Pitch = Dim.X;
+	}
+
+	if ((InBuffer == nullptr) || (OutPlanes == nullptr) || (Dim.X <= 0) || (Dim.Y <= 0) || (Pitch < (uint32)Dim.X))
+	{
+		return false;
+	}
+
+	const FIntPoint ChromaDim((Dim.X + 1) / 2, (Dim.Y + 1) / 2);
+	const uint32 LumaSize = Pitch * Dim.Y;
+
+	FDirectShowMediaPlane& Luma = OutPlanes[0];
+	Luma.Data = InBuffer;
+	Luma.Pitch = Pitch;
+	Luma.Offset = 0;
+	Luma.Dim = Dim;
+
+	switch (Format)
+	{
+	case EDirectShowMediaPlanarFormat::I420:
+	case EDirectShowMediaPlanarFormat::YV12:
+		{
+			const uint32 ChromaPitch = (Pitch + 1) / 2;
+			const uint32 ChromaSize = ChromaPitch * ChromaDim.Y;
+
+			if ((uint64)LumaSize + 2 * (uint64)ChromaSize > InSize)
+			{
+				return false;
+			}
+
+			// YV12 stores V before U
+			const bool bUFirst = (Format == EDirectShowMediaPlanarFormat::I420);
+
+			for (int32 PlaneIndex = 1; PlaneIndex < 3; ++PlaneIndex)
+			{
+				const bool bFirstInMemory = ((PlaneIndex == 1) == bUFirst);
+
+				FDirectShowMediaPlane& Chroma = OutPlanes[PlaneIndex];
+				Chroma.Offset = LumaSize + (bFirstInMemory ? 0 : ChromaSize);
+				Chroma.Data = InBuffer + Chroma.Offset;
+				Chroma.Pitch = ChromaPitch;
+				Chroma.Dim = ChromaDim;
+			}
+
+			OutNumPlanes = 3;
+		}
+		break;
+
+	case EDirectShowMediaPlanarFormat::NV12:
+	case EDirectShowMediaPlanarFormat::NV21:
+		{
+			const uint32 ChromaPitch = FMath::Max(Pitch, (uint32)ChromaDim.X * 2);
+
+			if ((uint64)LumaSize + (uint64)ChromaPitch * ChromaDim.Y > InSize)
+			{
+				return false;
+			}
+
+			FDirectShowMediaPlane& Chroma = OutPlanes[1];
+			Chroma.Offset = LumaSize;
+			Chroma.Data = InBuffer + LumaSize;
+			Chroma.Pitch = ChromaPitch;
+			Chroma.Dim = ChromaDim;
+
+			OutNumPlanes = 2;
+		}
+		break;
+
+	default:
+		return false;
+	}
+
+	return true;
+}
+
+
+uint32 FDirectShowMediaPlanarFrame::GetSemiPlanarLayout(const FIntPoint& Dim, FIntPoint& OutDim, uint32& OutStride)
+{
+	OutStride = (Dim.X + 1) & ~1;
+	OutDim = FIntPoint(OutStride, Dim.Y + (Dim.Y + 1) / 2);
+
+	return OutStride * OutDim.Y;
+}
+
+
+EDirectShowMediaPlanarFormat FDirectShowMediaPlanarFrame::GetSemiPlanarFormat(EDirectShowMediaPlanarFormat Format)
+{
+	return (Format == EDirectShowMediaPlanarFormat::NV21) ? EDirectShowMediaPlanarFormat::NV21 : EDirectShowMediaPlanarFormat::NV12;
+}
+
+
+void FDirectShowMediaPlanarFrame::CopyToSemiPlanar(EDirectShowMediaPlanarFormat Format, const FDirectShowMediaPlane* Planes, const FIntPoint& Dim, uint8* OutBuffer)
+{
+	FIntPoint OutDim;
+	uint32 OutStride = 0;
+	GetSemiPlanarLayout(Dim, OutDim, OutStride);
+
+	for (int32 Row = 0; Row < Dim.Y; ++Row)
+	{
+		FMemory::Memcpy(OutBuffer + (SIZE_T)Row * OutStride, Planes[0].Data + (SIZE_T)Row * Planes[0].Pitch, Dim.X);
+	}
+
+	uint8* OutChroma = OutBuffer + (SIZE_T)OutStride * Dim.Y;
+	const FIntPoint& ChromaDim = Planes[1].Dim;
+
+	for (int32 Row = 0; Row < ChromaDim.Y; ++Row)
+	{
+		uint8* OutRow = OutChroma + (SIZE_T)Row * OutStride;
+
+		if ((Format == EDirectShowMediaPlanarFormat::NV12) || (Format == EDirectShowMediaPlanarFormat::NV21))
+		{
+			FMemory::Memcpy(OutRow, Planes[1].Data + (SIZE_T)Row * Planes[1].Pitch, ChromaDim.X * 2);
+		}
+		else
+		{
+			const uint8* InURow = Planes[1].Data + (SIZE_T)Row * Planes[1].Pitch;
+			const uint8* InVRow = Planes[2].Data + (SIZE_T)Row * Planes[2].Pitch;
+
+			for (int32 X = 0; X < ChromaDim.X; ++X)
+			{
+				OutRow[X * 2 + 0] = InURow[X];
+				OutRow[X * 2 + 1] = InVRow[X];
+			}
+		}
+	}
+}
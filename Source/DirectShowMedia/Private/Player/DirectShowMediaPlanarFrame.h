@@ -0,0 +1,133 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreTypes.h"
+#include "IDirectShowMediaPlanarSample.h"
+#include "HAL/ThreadSafeCounter.h"
+#include "Math/IntPoint.h"
+
+
+/**
+ * Describes and converts planar 4:2:0 capture frames.
+ *
+ * Frames are laid out as delivered by capture filters: a luma plane with one byte per pixel, followed by the
+ * chroma planes at half width and half height (rounded up), the interleaved chroma plane of NV12 and NV21
+ * having two bytes per chroma sample. Drivers may pad the rows; the chroma planes of three plane layouts
+ * then have half the luma pitch, as DirectShow specifies for YV12.
+ */
+class FDirectShowMediaPlanarFrame
+{
+public:
+
+	/**
+	 * Get the plane views of a frame.
+	 *
+	 * @param Format The frame's layout.
+	 * @param InBuffer The frame.
+	 * @param InSize Size of the frame (in bytes).
+	 * @param Dim The frame's width and height (in pixels).
+	 * @param Pitch Number of bytes per luma row, or 0 if the rows are tightly packed.
+	 * @param OutPlanes Will contain the planes in component order, IDirectShowMediaPlanarSample::MaxPlanes entries.
+	 * @param OutNumPlanes Will contain the number of planes.
+	 * @return true if the planes were found, false if the format is unknown or the frame too small.
+	 */
+	static bool GetPlanes(EDirectShowMediaPlanarFormat Format, const uint8* InBuffer, uint32 InSize, const FIntPoint& Dim, uint32 Pitch, FDirectShowMediaPlane* OutPlanes, int32& OutNumPlanes);
+
+	/**
+	 * Get the buffer layout of a frame copied to a semi-planar layout.
+	 *
+	 * @param Dim The frame's width and height (in pixels).
+	 * @param OutDim Will contain the sample buffer's width and height (in texels).
+	 * @param OutStride Will contain the number of bytes per row.
+	 * @return Size of the sample buffer (in bytes).
+	 */
+	static uint32 GetSemiPlanarLayout(const FIntPoint& Dim, FIntPoint& OutDim, uint32& OutStride);
+
+	/**
+	 * Get the semi-planar layout a frame is copied to.
+	 *
+	 * @param Format The frame's layout.
+	 * @return NV21 for NV21, NV12 otherwise.
+	 */
+	static EDirectShowMediaPlanarFormat GetSemiPlanarFormat(EDirectShowMediaPlanarFormat Format);
+
+	/**
+	 * Copy a frame to a semi-planar layout the engine can display.
+	 *
+	 * The planes are copied row by row to an even stride; three plane layouts have their chroma planes
+	 * interleaved into NV12.
+	 *
+	 * @param Format The frame's layout.
+	 * @param Planes The frame's planes, as returned by GetPlanes.
+	 * @param Dim The frame's width and height (in pixels).
+	 * @param OutBuffer The output, GetSemiPlanarLayout bytes.
+	 */
+	static void CopyToSemiPlanar(EDirectShowMediaPlanarFormat Format, const FDirectShowMediaPlane* Planes, const FIntPoint& Dim, uint8* OutBuffer);
+};
+
+
+/**
+ * Limits the number of plane views holding captured frames.
+ *
+ * A view keeps its capture buffer out of the device's allocator until the view is released. Once the views
+ * hold all buffers but one, further frames are copied, so the device always has a buffer to capture into.
+ */
+class FDirectShowMediaPlanarViewBudget
+{
+public:
+
+	/**
+	 * Create and initialize a new instance.
+	 *
+	 * @param InMaxViews Number of views that may hold a capture buffer at the same time.
+	 */
+	explicit FDirectShowMediaPlanarViewBudget(int32 InMaxViews)
+		: MaxViews(InMaxViews)
+	{ }
+
+public:
+
+	/**
+	 * Reserve a capture buffer for a view.
+	 *
+	 * @return true if the frame can be viewed, false if it must be copied.
+	 * @see Release
+	 */
+	bool TryAcquire()
+	{
+		if (NumViews.Increment() > MaxViews)
+		{
+			NumViews.Decrement();
+			return false;
+		}
+
+		return true;
+	}
+
+	/** Hand back a buffer reserved by TryAcquire, once its view released the frame. */
+	void Release()
+	{
+		NumViews.Decrement();
+	}
+
+	/** Number of views holding a capture buffer. */
+	int32 GetNumViews() const
+	{
+		return NumViews.GetValue();
+	}
+
+	/** Number of views that may hold a capture buffer at the same time. */
+	int32 GetMaxViews() const
+	{
+		return MaxViews;
+	}
+
+private:
+
+	/** Number of views that may hold a capture buffer at the same time. */
+	const int32 MaxViews;
+
+	/** Number of views holding a capture buffer. */
+	FThreadSafeCounter NumViews;
+};
@@ -181,6 +181,39 @@ void FDirectShowMediaPlayer::TickFetch(FTimespan DeltaTime, FTimespan Timecode)
 void FDirectShowMediaPlayer::TickInput(FTimespan DeltaTime, FTimespan Timecode)
 {
     Tracks->TickInput(DeltaTime, Timecode);
+
+    // resizing the device audio buffer restarts the graph, keep that off the game thread
+    float AudioBufferMs = 0.0f;
+
+    if (Tracks->ShouldRenegotiateAudioBuffer(AudioBufferMs))
+    {
+        AsyncTask(ENamedThreads::AnyBackgroundThreadNormalTask, [AudioBufferMs, TracksPtr = TWeakPtr<FDirectShowMediaTracks, ESPMode::ThreadSafe>(Tracks)]()
+        {
+            TSharedPtr<FDirectShowMediaTracks, ESPMode::ThreadSafe> PinnedTracks = TracksPtr.Pin();
+
+            if (PinnedTracks.IsValid())
+            {
+                PinnedTracks->RenegotiateAudioBuffer(AudioBufferMs);
+            }
+        });
+    }
+
+    // the capture memory budget reduces (and restores) the resolution by switching the video format
+    int32 VideoFormatIndex = INDEX_NONE;
+
+    if (Tracks->ShouldChangeVideoFormat(VideoFormatIndex))
+    {
+        // switching rebuilds the graph, like the audio renegotiation it runs off the game thread
+        AsyncTask(ENamedThreads::AnyBackgroundThreadNormalTask, [VideoFormatIndex, TracksPtr = TWeakPtr<FDirectShowMediaTracks, ESPMode::ThreadSafe>(Tracks)]()
+        {
+            TSharedPtr<FDirectShowMediaTracks, ESPMode::ThreadSafe> PinnedTracks = TracksPtr.Pin();
+
+            if (PinnedTracks.IsValid())
+            {
+                PinnedTracks->ApplyVideoFormatBudget(VideoFormatIndex);
+            }
+        });
+    }
 	
     // forward session events
     TArray<EMediaEvent> OutEvents;
@@ -0,0 +1,150 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "DirectShowMediaRHIUploadBackend.h"
+
+#include "Misc/App.h"
+#include "RenderingThread.h"
+#include "RHI.h"
+#include "RHICommandList.h"
+
+
+/* FDirectShowMediaRHIUploadBackend structors
+ *****************************************************************************/
+
+FDirectShowMediaRHIUploadBackend::FDirectShowMediaRHIUploadBackend()
+	: State(MakeShared<FSlots, ESPMode::ThreadSafe>())
+{ }
+
+
+FDirectShowMediaRHIUploadBackend::~FDirectShowMediaRHIUploadBackend()
+{
+	ReleaseSlots();
+}
+
+
+/* IDirectShowMediaUploadBackend interface
+ *****************************************************************************/
+
+bool FDirectShowMediaRHIUploadBackend::CreateSlots(int32 NumSlots, const FIntPoint& Dim, EMediaTextureSampleFormat Format)
+{
+	const bool bFourBytesPerTexel = (Format == EMediaTextureSampleFormat::CharBGRA) || (Format == EMediaTextureSampleFormat::CharYUY2) || (Format == EMediaTextureSampleFormat::CharUYVY);
+
+	if (!bFourBytesPerTexel || !FApp::CanEverRender() || (NumSlots <= 0))
+	{
+		return false;
+	}
+
+	ReleaseSlots();
+
+	for (int32 SlotIndex = 0; SlotIndex < NumSlots; ++SlotIndex)
+	{
+		State->Slots.Add(MakeUnique<FSlot>());
+	}
+
+	ENQUEUE_RENDER_COMMAND(DirectShowMediaCreateUploadSlots)(
+		[State = State, Dim](FRHICommandListImmediate& RHICmdList)
+		{
+			const FRHITextureCreateDesc Desc = FRHITextureCreateDesc::Create2D(TEXT("DirectShowMediaUpload"), Dim.X, Dim.Y, PF_B8G8R8A8)
+				.SetFlags(ETextureCreateFlags::Dynamic | ETextureCreateFlags::ShaderResource);
+
+			for (TUniquePtr<FSlot>& Slot : State->Slots)
+			{
+				Slot->Texture = RHICreateTexture(Desc);
+			}
+		});
+
+	return true;
+}
+
+
+void FDirectShowMediaRHIUploadBackend::ReleaseSlots()
+{
+	if (State->Slots.Num() == 0)
+	{
+		return;
+	}
+
+	for (TUniquePtr<FSlot>& Slot : State->Slots)
+	{
+		Slot->Data = nullptr;
+	}
+
+	// pending commands of the old slots keep them alive until they ran
+	TSharedRef<FSlots, ESPMode::ThreadSafe> OldState = State;
+	State = MakeShared<FSlots, ESPMode::ThreadSafe>();
+
+	ENQUEUE_RENDER_COMMAND(DirectShowMediaReleaseUploadSlots)(
+		[OldState](FRHICommandListImmediate& RHICmdList)
+		{
+			for (TUniquePtr<FSlot>& Slot : OldState->Slots)
+			{
+				if (Slot->bLocked)
+				{
+					RHICmdList.UnlockTexture2D(Slot->Texture, 0, false);
+					Slot->bLocked = false;
+				}
+
+				Slot->Texture.SafeRelease();
+			}
+		});
+}
+
+
+void FDirectShowMediaRHIUploadBackend::MapSlot(int32 SlotIndex)
+{
+	ENQUEUE_RENDER_COMMAND(DirectShowMediaMapUploadSlot)(
+		[State = State, SlotIndex](FRHICommandListImmediate& RHICmdList)
+		{
+			FSlot& Slot = *State->Slots[SlotIndex];
+
+			if (!Slot.Texture.IsValid() || Slot.bLocked)
+			{
+				return;
+			}
+
+			uint32 Stride = 0;
+			uint8* Data = (uint8*)RHICmdList.LockTexture2D(Slot.Texture, 0, RLM_WriteOnly, Stride, false);
+
+			if (Data != nullptr)
+			{
+				Slot.bLocked = true;
+				Slot.Stride.store(Stride, std::memory_order_relaxed);
+				Slot.Data.store(Data, std::memory_order_release);
+			}
+		});
+}
+
+
+uint8* FDirectShowMediaRHIUploadBackend::GetMappedData(int32 SlotIndex, uint32& OutStride) const
+{
+	const FSlot& Slot = *State->Slots[SlotIndex];
+	uint8* Data = Slot.Data.load(std::memory_order_acquire);
+	OutStride = Slot.Stride.load(std::memory_order_relaxed);
+
+	return Data;
+}
+
+
+void FDirectShowMediaRHIUploadBackend::SubmitSlot(int32 SlotIndex)
+{
+	// the memory goes away with the unlock, which may run before the slot is released
+	State->Slots[SlotIndex]->Data = nullptr;
+
+	ENQUEUE_RENDER_COMMAND(DirectShowMediaSubmitUploadSlot)(
+		[State = State, SlotIndex](FRHICommandListImmediate& RHICmdList)
+		{
+			FSlot& Slot = *State->Slots[SlotIndex];
+
+			if (Slot.bLocked)
+			{
+				RHICmdList.UnlockTexture2D(Slot.Texture, 0, false);
+				Slot.bLocked = false;
+			}
+		});
+}
+
+
+FRHITexture* FDirectShowMediaRHIUploadBackend::GetTexture(int32 SlotIndex) const
+{
+	return State->Slots.IsValidIndex(SlotIndex) ? State->Slots[SlotIndex]->Texture.GetReference() : nullptr;
+}
@@ -0,0 +1,74 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include <atomic>
+
+#include "CoreTypes.h"
+#include "Containers/Array.h"
+#include "IDirectShowMediaUploadBackend.h"
+#include "RHIResources.h"
+#include "Templates/SharedPointer.h"
+#include "Templates/UniquePtr.h"
+
+
+/**
+ * Upload backend that writes frames into locked RHI textures.
+ *
+ * Each slot is a dynamic texture that is locked for writing on the render thread ahead of time. The RHI
+ * hands out staging memory for the lock (an upload heap allocation on D3D12, a mapped staging texture on
+ * D3D11) that stays valid until the unlock, which copies it into the texture on the GPU. Locking is ordered
+ * behind the previous unlock and every render command that used the texture before the slot was released.
+ *
+ * Only formats with four bytes per texel are uploaded (CharBGRA, and CharYUY2 and CharUYVY as two pixels per
+ * BGRA texel, the way the engine reads them from buffers).
+ */
+class FDirectShowMediaRHIUploadBackend
+	: public IDirectShowMediaUploadBackend
+{
+public:
+
+	/** Default constructor. */
+	FDirectShowMediaRHIUploadBackend();
+
+	/** Virtual destructor. */
+	virtual ~FDirectShowMediaRHIUploadBackend();
+
+public:
+
+	//~ IDirectShowMediaUploadBackend interface
+
+	virtual bool CreateSlots(int32 NumSlots, const FIntPoint& Dim, EMediaTextureSampleFormat Format) override;
+	virtual void ReleaseSlots() override;
+	virtual void MapSlot(int32 SlotIndex) override;
+	virtual uint8* GetMappedData(int32 SlotIndex, uint32& OutStride) const override;
+	virtual void SubmitSlot(int32 SlotIndex) override;
+	virtual FRHITexture* GetTexture(int32 SlotIndex) const override;
+
+private:
+
+	/** A texture and its lock. */
+	struct FSlot
+	{
+		/** The texture (render thread, read by samples once the slot was submitted). */
+		FTextureRHIRef Texture;
+
+		/** The locked memory, or nullptr while the texture isn't locked for the streaming thread. */
+		std::atomic<uint8*> Data{ nullptr };
+
+		/** Number of bytes per row of the locked memory. */
+		std::atomic<uint32> Stride{ 0 };
+
+		/** Whether the texture is locked (render thread). */
+		bool bLocked = false;
+	};
+
+	/** The slots, shared with the render commands that outlive the backend. */
+	struct FSlots
+	{
+		TArray<TUniquePtr<FSlot>> Slots;
+	};
+
+	/** The slots. */
+	TSharedRef<FSlots, ESPMode::ThreadSafe> State;
+};
@@ -0,0 +1,295 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreTypes.h"
+#include "Containers/Array.h"
+#include "HAL/CriticalSection.h"
+#include "Math/Range.h"
+#include "Misc/ScopeLock.h"
+#include "Misc/Timespan.h"
+#include "Templates/SharedPointer.h"
+
+
+/**
+ * Fixed capacity ring of media samples kept sorted by presentation time.
+ *
+ * Unlike a plain FIFO, fetching looks up the newest sample that overlaps the requested time range with a
+ * binary search, so a consumer that fell behind (i.e. after a game thread hitch) skips straight to the
+ * matching frame instead of stalling on the stale head. Everything older than the returned sample is
+ * released in one go, which hands pooled samples back to their pool.
+ */
+template<typename SampleType>
+class TDirectShowMediaSampleWindow
+{
+public:
+
+	typedef TSharedPtr<SampleType, ESPMode::ThreadSafe> FSamplePtr;
+
+	/**
+	 * Create and initialize a new instance.
+	 *
+	 * @param InCapacity Maximum number of samples held by the window.
+	 */
+	explicit TDirectShowMediaSampleWindow(int32 InCapacity)
+		: Head(0)
+		, Count(0)
+		, NumOverflowed(0)
+		, NumStale(0)
+	{
+		SetCapacity(InCapacity);
+	}
+
+public:
+
+	/**
+	 * Change the maximum number of samples, dropping all current samples.
+	 *
+	 * @param InCapacity The new capacity (at least one).
+	 */
+	void SetCapacity(int32 InCapacity)
+	{
+		FScopeLock Lock(&CriticalSection);
+
+		Entries.Reset();
+		Entries.SetNum(FMath::Max(1, InCapacity));
+		Head = 0;
+		Count = 0;
+	}
+
+	/** Get the maximum number of samples. */
+	int32 GetCapacity() const
+	{
+		return Entries.Num();
+	}
+
+	/** Get the number of samples currently held. */
+	int32 Num() const
+	{
+		FScopeLock Lock(&CriticalSection);
+		return Count;
+	}
+
+	/**
+	 * Add a sample, keeping the window sorted by presentation time.
+	 *
+	 * If the window is full the oldest sample is dropped.
+	 *
+	 * @param Sample The sample to add.
+	 */
+	void Add(const FSamplePtr& Sample)
+	{
+		if (!Sample.IsValid())
+		{
+			return;
+		}
+
+		const FTimespan Time = Sample->GetTime().Time;
+
+		FScopeLock Lock(&CriticalSection);
+
+		if (Count == Entries.Num())
+		{
+			Evict(1);
+			++NumOverflowed;
+		}
+
+		// samples normally arrive in order, so this is almost always an append
+		const int32 InsertIndex = FindFirstAfter(Time);
+
+		for (int32 Index = Count; Index > InsertIndex; --Index)
+		{
+			At(Index) = MoveTemp(At(Index - 1));
+		}
+
+		FEntry& Entry = At(InsertIndex);
+		Entry.Time = Time;
+		Entry.Sample = Sample;
+
+		++Count;
+	}
+
+	/**
+	 * Take the newest sample that overlaps the given time range.
+	 *
+	 * All older samples are dropped and counted as stale. If every sample is older than the range they are
+	 * all dropped, if every sample is newer than the range nothing is changed.
+	 *
+	 * @param TimeRange The requested presentation time range.
+	 * @param OutSample Will contain the sample.
+	 * @return true if a sample was returned, false otherwise.
+	 */
+	bool FetchBest(const TRange<FTimespan>& TimeRange, FSamplePtr& OutSample)
+	{
+		const FTimespan RangeStart = TimeRange.HasLowerBound() ? TimeRange.GetLowerBoundValue() : FTimespan::MinValue();
+		const FTimespan RangeEnd = TimeRange.HasUpperBound() ? TimeRange.GetUpperBoundValue() : FTimespan::MaxValue();
+
+		FScopeLock Lock(&CriticalSection);
+
+		// newest sample that starts before the end of the range
+		const int32 BestIndex = FindFirstAtOrAfter(RangeEnd) - 1;
+
+		if (BestIndex < 0)
+		{
+			return false; // all samples are in the future
+		}
+
+		const FEntry& Best = At(BestIndex);
+
+		if (Best.Time + Best.Sample->GetDuration() <= RangeStart)
+		{
+			// even the best candidate is too old
+			NumStale += BestIndex + 1;
+			Evict(BestIndex + 1);
+
+			return false;
+		}
+
+		NumStale += BestIndex;
+		Evict(BestIndex);
+
+		OutSample = MoveTemp(At(0).Sample);
+		Evict(1);
+
+		return OutSample.IsValid();
+	}
+
+	/**
+	 * Get the presentation time of the oldest sample.
+	 *
+	 * @param OutTime Will contain the time.
+	 * @return true if the window holds a sample, false otherwise.
+	 */
+	bool PeekTime(FTimespan& OutTime) const
+	{
+		FScopeLock Lock(&CriticalSection);
+
+		if (Count == 0)
+		{
+			return false;
+		}
+
+		OutTime = At(0).Time;
+
+		return true;
+	}
+
+	/** Drop all samples. */
+	void Flush()
+	{
+		FScopeLock Lock(&CriticalSection);
+		Evict(Count);
+	}
+
+	/** Number of samples dropped because the window was full. */
+	uint64 GetNumOverflowed() const
+	{
+		return NumOverflowed;
+	}
+
+	/** Number of samples skipped because a newer one matched the requested time range. */
+	uint64 GetNumStale() const
+	{
+		return NumStale;
+	}
+
+private:
+
+	/** A sample and its presentation time. */
+	struct FEntry
+	{
+		FTimespan Time;
+		FSamplePtr Sample;
+	};
+
+	/** Get an entry by its position relative to the oldest sample. */
+	FEntry& At(int32 Index)
+	{
+		return Entries[(Head + Index) % Entries.Num()];
+	}
+
+	const FEntry& At(int32 Index) const
+	{
+		return Entries[(Head + Index) % Entries.Num()];
+	}
+
+	/** Release the given number of oldest samples. */
+	void Evict(int32 NumToEvict)
+	{
+		NumToEvict = FMath::Min(NumToEvict, Count);
+
+		for (int32 Index = 0; Index < NumToEvict; ++Index)
+		{
+			At(Index).Sample.Reset();
+		}
+
+		Head = (Head + NumToEvict) % Entries.Num();
+		Count -= NumToEvict;
+	}
+
+	/** Binary search for the first sample whose time is greater than or equal to the given time. */
+	int32 FindFirstAtOrAfter(FTimespan Time) const
+	{
+		int32 Low = 0;
+		int32 High = Count;
+
+		while (Low < High)
+		{
+			const int32 Mid = (Low + High) / 2;
+
+			if (At(Mid).Time < Time)
+			{
+				Low = Mid + 1;
+			}
+			else
+			{
+				High = Mid;
+			}
+		}
+
+		return Low;
+	}
+
+	/** Binary search for the first sample whose time is greater than the given time. */
+	int32 FindFirstAfter(FTimespan Time) const
+	{
+		int32 Low = 0;
+		int32 High = Count;
+
+		while (Low < High)
+		{
+			const int32 Mid = (Low + High) / 2;
+
+			if (At(Mid).Time <= Time)
+			{
+				Low = Mid + 1;
+			}
+			else
+			{
+				High = Mid;
+			}
+		}
+
+		return Low;
+	}
+
+private:
+
+	/** Synchronizes access between the producer and the consumer. */
+	mutable FCriticalSection CriticalSection;
+
+	/** Ring storage. */
+	TArray<FEntry> Entries;
+
+	/** Storage index of the oldest sample. */
+	int32 Head;
+
+	/** Number of samples held. */
+	int32 Count;
+
+	/** Number of samples dropped because the window was full. */
+	uint64 NumOverflowed;
+
+	/** Number of samples skipped as stale. */
+	uint64 NumStale;
+};
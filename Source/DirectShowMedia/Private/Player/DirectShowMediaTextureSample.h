@@ -4,33 +4,60 @@
 
 #include "CoreTypes.h"
 #include "Containers/Array.h"
+#include "DirectShowMediaColorConverter.h"
+#include "DirectShowMediaFrameArena.h"
+#include "DirectShowMediaFrameTracer.h"
+#include "DirectShowMediaPlanarFrame.h"
+#include "DirectShowMediaUploadRing.h"
+#include "DirectShowMediaVideoKernels.h"
+#include "DirectShowMediaVideoUnpacker.h"
+#include "IDirectShowMediaPlanarSample.h"
 #include "IMediaTextureSample.h"
 #include "MediaObjectPool.h"
 #include "MediaSampleQueue.h"
 #include "Math/IntPoint.h"
+#include "Microsoft/COMPointer.h"
+#include "Misc/Timecode.h"
 #include "Misc/Timespan.h"
 
+#include "Windows/AllowWindowsPlatformTypes.h"
+#include "Windows/WindowsHWrapper.h"
+#include "Windows/HideWindowsPlatformTypes.h"
+
 /**
  * Texture sample generated by DirectShowMedia player.
  */
 class FDirectShowMediaTextureSample
-	: public IMediaTextureSample
+	: public IDirectShowMediaPlanarSample
 	, public IMediaPoolable
 {
 public:
 
 	/** Default constructor. */
 	FDirectShowMediaTextureSample()
-		: Dim(FIntPoint::ZeroValue)
+		: FrameSlot(INDEX_NONE)
+		, FrameData(nullptr)
+		, Dim(FIntPoint::ZeroValue)
 		, Duration(FTimespan::Zero())
 		, OutputDim(FIntPoint::ZeroValue)
 		, SampleFormat(EMediaTextureSampleFormat::Undefined)
 		, Stride(0)
 		, Time(FTimespan::Zero())
+		, YUVToRGBMatrix(FDirectShowMediaColorimetry().GetYUVToRGBMatrix())
+		, bFullRange(false)
+		, PlanarFormat(EDirectShowMediaPlanarFormat::None)
+		, NumPlanes(0)
+		, ViewData(nullptr)
+		, UploadSlot(INDEX_NONE)
+		, TraceFlow(0)
 	{ }
 
 	/** Virtual destructor. */
-	virtual ~FDirectShowMediaTextureSample() { }
+	virtual ~FDirectShowMediaTextureSample()
+	{
+		ResetBuffer();
+		ResetUpload();
+	}
 
 public:
 
@@ -67,8 +94,8 @@ public:
 			return false;
 		}
 
-		Buffer.Reset(InSize);
-		Buffer.Append((uint8*)InBuffer, InSize);
+		ResetPlanes();
+		FMemory::Memcpy(AllocateBuffer(InSize), InBuffer, InSize);
 
 		Duration = InDuration;
 		Dim = InDim;
@@ -80,6 +107,389 @@ public:
 		return true;
 	}
 
+	/**
+	 * Initialize the sample with a frame copied or converted by a video kernel.
+	 *
+	 * @param Kernel The kernel, picked when the frame's format was negotiated (see FDirectShowMediaVideoKernels).
+	 * @param Converter The converter used by YUV to BGRA kernels (configured for the frame's colorimetry).
+	 * @param InBuffer The frame.
+	 * @param InSize Size of the frame.
+	 * @param InSourceStride Number of bytes per row of the frame (of the luma plane for NV12).
+	 * @param InRowSize Number of bytes of pixels in a row of the frame.
+	 * @param InDim The sample buffer's width and height (in texels of InSampleFormat).
+	 * @param InOutputDim The sample's width and height (in pixels).
+	 * @param InSampleFormat The sample format the kernel outputs.
+	 * @param InStride Number of bytes per sample buffer row.
+	 * @param InTime The sample time (relative to presentation clock).
+	 * @param InDuration The duration for which the sample is valid.
+	 */
+	bool Initialize(
+		FDirectShowMediaVideoKernel Kernel,
+		const FDirectShowMediaColorConverter& Converter,
+		const void* InBuffer,
+		uint32 InSize,
+		uint32 InSourceStride,
+		uint32 InRowSize,
+		const FIntPoint& InDim,
+		const FIntPoint& InOutputDim,
+		EMediaTextureSampleFormat InSampleFormat,
+		uint32 InStride,
+		FTimespan InTime,
+		FTimespan InDuration)
+	{
+		if ((Kernel == nullptr) || (InBuffer == nullptr) || (InDim.X <= 0) || (InDim.Y <= 0) || (InOutputDim.X <= 0) || (InOutputDim.Y <= 0) || (InStride <= 0))
+		{
+			return false;
+		}
+
+		ResetPlanes();
+
+		FDirectShowMediaVideoKernelArgs Args;
+		Args.Source = (const uint8*)InBuffer;
+		Args.SourceSize = InSize;
+		Args.SourceStride = InSourceStride;
+		Args.RowSize = InRowSize;
+		Args.Dest = AllocateBuffer(InStride * InDim.Y);
+		Args.DestStride = InStride;
+		Args.Width = InOutputDim.X;
+		Args.Height = InOutputDim.Y;
+		Args.Converter = &Converter;
+
+		if (!Kernel(Args))
+		{
+			return false;
+		}
+
+		Duration = InDuration;
+		Dim = InDim;
+		OutputDim = InOutputDim;
+		SampleFormat = InSampleFormat;
+		Stride = InStride;
+		Time = InTime;
+
+		return true;
+	}
+
+	/**
+	 * Initialize the sample with a frame copied or converted by a video kernel straight into upload memory.
+	 *
+	 * The sample carries the slot's texture instead of a buffer, and holds on to the slot until it is released.
+	 *
+	 * The aligned kernel is only used if it fits the slot's pitch, which is the texture's lock pitch.
+	 *
+	 * @param InSourceFormat The frame's format.
+	 * @param AlignedKernel The aligned variant of the kernel, picked when the frame's format was negotiated (see FDirectShowMediaVideoKernels).
+	 * @param RowKernel The row by row variant of the kernel.
+	 * @param Converter The converter used by YUV to BGRA kernels (configured for the frame's colorimetry).
+	 * @param InUploadRing The ring to write the frame into.
+	 * @param InBuffer The frame.
+	 * @param InSize Size of the frame.
+	 * @param InSourceStride Number of bytes per row of the frame.
+	 * @param InRowSize Number of bytes of pixels in a row of the frame.
+	 * @param InDim The texture's width and height (in texels of InSampleFormat).
+	 * @param InOutputDim The sample's width and height (in pixels).
+	 * @param InSampleFormat The sample format the kernel outputs.
+	 * @param InTime The sample time (relative to presentation clock).
+	 * @param InDuration The duration for which the sample is valid.
+	 * @return true on success, false if no slot was free or the frame is too small.
+	 */
+	bool Initialize(
+		EMediaTextureSampleFormat InSourceFormat,
+		FDirectShowMediaVideoKernel AlignedKernel,
+		FDirectShowMediaVideoKernel RowKernel,
+		const FDirectShowMediaColorConverter& Converter,
+		const TSharedRef<FDirectShowMediaUploadRing, ESPMode::ThreadSafe>& InUploadRing,
+		const void* InBuffer,
+		uint32 InSize,
+		uint32 InSourceStride,
+		uint32 InRowSize,
+		const FIntPoint& InDim,
+		const FIntPoint& InOutputDim,
+		EMediaTextureSampleFormat InSampleFormat,
+		FTimespan InTime,
+		FTimespan InDuration)
+	{
+		if ((AlignedKernel == nullptr) || (RowKernel == nullptr) || (InBuffer == nullptr) || (InDim.X <= 0) || (InDim.Y <= 0) || (InOutputDim.X <= 0) || (InOutputDim.Y <= 0))
+		{
+			return false;
+		}
+
+		uint8* Data = nullptr;
+		uint32 DataStride = 0;
+		const int32 SlotIndex = InUploadRing->Acquire(Data, DataStride);
+
+		if (SlotIndex == INDEX_NONE)
+		{
+			return false;
+		}
+
+		// the aligned variant writes the frame as one run at the source pitch, which the lock pitch may not match
+		const FDirectShowMediaVideoKernel Kernel = FDirectShowMediaVideoKernels::IsAligned(InSourceFormat, InSampleFormat, InOutputDim.X, InSourceStride, DataStride) ? AlignedKernel : RowKernel;
+
+		FDirectShowMediaVideoKernelArgs Args;
+		Args.Source = (const uint8*)InBuffer;
+		Args.SourceSize = InSize;
+		Args.SourceStride = InSourceStride;
+		Args.RowSize = InRowSize;
+		Args.Dest = Data;
+		Args.DestStride = DataStride;
+		Args.Width = InOutputDim.X;
+		Args.Height = InOutputDim.Y;
+		Args.Converter = &Converter;
+
+		if (!Kernel(Args))
+		{
+			InUploadRing->Cancel(SlotIndex);
+
+			return false;
+		}
+
+		InUploadRing->Submit(SlotIndex);
+
+		ResetPlanes();
+		ResetBuffer();
+		UploadRing = InUploadRing;
+		UploadSlot = SlotIndex;
+
+		Duration = InDuration;
+		Dim = InDim;
+		OutputDim = InOutputDim;
+		SampleFormat = InSampleFormat;
+		Stride = DataStride;
+		Time = InTime;
+
+		return true;
+	}
+
+	/**
+	 * Initialize the sample with an unpacked high bit depth frame.
+	 *
+	 * @param InSourceFormat The frame's format.
+	 * @param bTo8Bit Whether to dither the frame to 8 bit.
+	 * @param InBuffer The frame.
+	 * @param InSize Size of the frame.
+	 * @param InSourceStride Number of bytes per row of the frame (of the luma plane for P010), or 0 if tightly packed.
+	 * @param InOutputDim The sample's width and height (in pixels).
+	 * @param InTime The sample time (relative to presentation clock).
+	 * @param InDuration The duration for which the sample is valid.
+	 * @see FDirectShowMediaVideoUnpacker
+	 */
+	bool Initialize(
+		EDirectShowMediaHighBitDepthFormat InSourceFormat,
+		bool bTo8Bit,
+		const void* InBuffer,
+		uint32 InSize,
+		uint32 InSourceStride,
+		const FIntPoint& InOutputDim,
+		FTimespan InTime,
+		FTimespan InDuration)
+	{
+		const EMediaTextureSampleFormat OutFormat = FDirectShowMediaVideoUnpacker::GetOutputFormat(InSourceFormat, bTo8Bit);
+
+		FIntPoint OutDim;
+		uint32 OutStride = 0;
+		const uint32 OutSize = FDirectShowMediaVideoUnpacker::GetOutputLayout(OutFormat, InOutputDim, OutDim, OutStride);
+
+		if (OutSize == 0)
+		{
+			return false;
+		}
+
+		ResetPlanes();
+
+		if (!FDirectShowMediaVideoUnpacker::Unpack(InSourceFormat, bTo8Bit, (const uint8*)InBuffer, InSize, InSourceStride, InOutputDim, AllocateBuffer(OutSize)))
+		{
+			return false;
+		}
+
+		Duration = InDuration;
+		Dim = OutDim;
+		OutputDim = InOutputDim;
+		SampleFormat = OutFormat;
+		Stride = OutStride;
+		Time = InTime;
+
+		return true;
+	}
+
+	/**
+	 * Initialize the sample with a planar 4:2:0 frame.
+	 *
+	 * As a view, the sample references the frame's planes in place and keeps the frame alive until the sample
+	 * is released. Otherwise the frame is copied, with three plane layouts converted to NV12. Views fall back
+	 * to the copy when the view budget has no capture buffer left.
+	 *
+	 * @param InPlanarFormat The frame's layout.
+	 * @param bView Whether to reference the frame instead of copying it.
+	 * @param InSourceFrame The object owning the frame's memory, referenced by views.
+	 * @param InViewBudget The budget views reserve their capture buffer from, or nullptr for no limit.
+	 * @param InBuffer The frame.
+	 * @param InSize Size of the frame.
+	 * @param InSourceStride Number of bytes per luma row of the frame, or 0 if tightly packed.
+	 * @param InOutputDim The sample's width and height (in pixels).
+	 * @param InTime The sample time (relative to presentation clock).
+	 * @param InDuration The duration for which the sample is valid.
+	 */
+	bool Initialize(
+		EDirectShowMediaPlanarFormat InPlanarFormat,
+		bool bView,
+		IUnknown* InSourceFrame,
+		const TSharedPtr<FDirectShowMediaPlanarViewBudget, ESPMode::ThreadSafe>& InViewBudget,
+		const void* InBuffer,
+		uint32 InSize,
+		uint32 InSourceStride,
+		const FIntPoint& InOutputDim,
+		FTimespan InTime,
+		FTimespan InDuration)
+	{
+		ResetPlanes();
+
+		FDirectShowMediaPlane SourcePlanes[MaxPlanes];
+		int32 NumSourcePlanes = 0;
+
+		if (!FDirectShowMediaPlanarFrame::GetPlanes(InPlanarFormat, (const uint8*)InBuffer, InSize, InOutputDim, InSourceStride, SourcePlanes, NumSourcePlanes))
+		{
+			return false;
+		}
+
+		if (bView && (InSourceFrame == nullptr))
+		{
+			return false;
+		}
+
+		if (bView && (!InViewBudget.IsValid() || InViewBudget->TryAcquire()))
+		{
+			// the engine displays both semi-planar layouts, but neither of the three plane ones
+			const bool bEngineFormat = (InPlanarFormat == EDirectShowMediaPlanarFormat::NV12) || (InPlanarFormat == EDirectShowMediaPlanarFormat::NV21);
+
+			SourceFrame = InSourceFrame;
+			ViewBudget = InViewBudget;
+			ViewData = (const uint8*)InBuffer;
+			PlanarFormat = InPlanarFormat;
+			NumPlanes = NumSourcePlanes;
+
+			for (int32 PlaneIndex = 0; PlaneIndex < NumSourcePlanes; ++PlaneIndex)
+			{
+				Planes[PlaneIndex] = SourcePlanes[PlaneIndex];
+			}
+
+			ResetBuffer();
+			Dim = FIntPoint(InOutputDim.X, InOutputDim.Y + (InOutputDim.Y + 1) / 2);
+			SampleFormat = !bEngineFormat ? EMediaTextureSampleFormat::Undefined : (InPlanarFormat == EDirectShowMediaPlanarFormat::NV12) ? EMediaTextureSampleFormat::CharNV12 : EMediaTextureSampleFormat::CharNV21;
+			Stride = SourcePlanes[0].Pitch;
+		}
+		else
+		{
+			const EDirectShowMediaPlanarFormat OutPlanarFormat = FDirectShowMediaPlanarFrame::GetSemiPlanarFormat(InPlanarFormat);
+
+			FIntPoint OutDim;
+			uint32 OutStride = 0;
+			const uint32 OutSize = FDirectShowMediaPlanarFrame::GetSemiPlanarLayout(InOutputDim, OutDim, OutStride);
+
+			uint8* Data = AllocateBuffer(OutSize);
+			FDirectShowMediaPlanarFrame::CopyToSemiPlanar(InPlanarFormat, SourcePlanes, InOutputDim, Data);
+
+			// the copy can be viewed as well
+			if (FDirectShowMediaPlanarFrame::GetPlanes(OutPlanarFormat, Data, OutSize, FIntPoint(OutStride, InOutputDim.Y), OutStride, Planes, NumPlanes))
+			{
+				PlanarFormat = OutPlanarFormat;
+				Planes[0].Dim = InOutputDim;
+			}
+
+			Dim = OutDim;
+			SampleFormat = (OutPlanarFormat == EDirectShowMediaPlanarFormat::NV21) ? EMediaTextureSampleFormat::CharNV21 : EMediaTextureSampleFormat::CharNV12;
+			Stride = OutStride;
+		}
+
+		Duration = InDuration;
+		OutputDim = InOutputDim;
+		Time = InTime;
+
+		return true;
+	}
+
+	/**
+	 * Set how the engine should convert the sample's YUV data.
+	 *
+	 * @param Converter The converter configured for the sample's colorimetry.
+	 */
+	void SetColorimetry(const FDirectShowMediaColorConverter& Converter)
+	{
+		YUVToRGBMatrix = Converter.GetYUVToRGBMatrix();
+		bFullRange = Converter.GetColorimetry().bFullRange;
+	}
+
+	/**
+	 * Set the side data of the sample's frame.
+	 *
+	 * @param InFrameMetadata The side data.
+	 */
+	void SetFrameMetadata(const FDirectShowMediaFrameMetadata& InFrameMetadata)
+	{
+		FrameMetadata = InFrameMetadata;
+	}
+
+	/**
+	 * Set the timecode of the sample's frame.
+	 *
+	 * @param InTimecode The timecode.
+	 */
+	void SetTimecode(const FTimecode& InTimecode)
+	{
+		Timecode = InTimecode;
+	}
+
+	/**
+	 * Set the frame's flow in the frame trace, recorded when the sample goes back to the pool.
+	 *
+	 * @param InTraceFlow The flow (see FDirectShowMediaFrameTracer::MakeFlow), or zero.
+	 */
+	void SetTraceFlow(uint64 InTraceFlow)
+	{
+		TraceFlow = InTraceFlow;
+	}
+
+	/** Get the frame's flow in the frame trace, zero if it has none. */
+	uint64 GetTraceFlow() const
+	{
+		return TraceFlow;
+	}
+
+	/**
+	 * Set the arena that copied and converted frames are stored in.
+	 *
+	 * @param InFrameArena The arena, or nullptr to store frames in the sample's own buffer.
+	 */
+	void SetFrameArena(const TSharedPtr<FDirectShowMediaFrameArena, ESPMode::ThreadSafe>& InFrameArena)
+	{
+		FrameArena = InFrameArena;
+	}
+
+
+public:
+
+	//~ IDirectShowMediaPlanarSample interface
+
+	virtual EDirectShowMediaPlanarFormat GetPlanarFormat() const override
+	{
+		return PlanarFormat;
+	}
+
+	virtual int32 GetNumPlanes() const override
+	{
+		return NumPlanes;
+	}
+
+	virtual const FDirectShowMediaPlane& GetPlane(int32 PlaneIndex) const override
+	{
+		check((PlaneIndex >= 0) && (PlaneIndex < NumPlanes));
+		return Planes[PlaneIndex];
+	}
+
+	virtual const FDirectShowMediaFrameMetadata& GetFrameMetadata() const override
+	{
+		return FrameMetadata;
+	}
 
 public:
 
@@ -87,7 +497,7 @@ public:
 
 	virtual const void* GetBuffer() override
 	{
-		return Buffer.GetData();
+		return (ViewData != nullptr) ? ViewData : (FrameData != nullptr) ? FrameData : Buffer.GetData();
 	}
 
 	virtual FIntPoint GetDim() const override
@@ -118,7 +528,7 @@ public:
 #if WITH_ENGINE
 	virtual FRHITexture* GetTexture() const override
 	{
-		return nullptr;
+		return UploadRing.IsValid() ? UploadRing->GetTexture(UploadSlot) : nullptr;
 	}
 #endif //WITH_ENGINE
 
@@ -127,9 +537,15 @@ public:
 		return FMediaTimeStamp(Time);
 	}
 
+	virtual TOptional<FTimecode> GetTimecode() const override
+	{
+		return Timecode;
+	}
+
 	virtual bool IsCacheable() const override
 	{
-		return true;
+		// views pin the capture buffer
+		return (ViewData == nullptr);
 	}
 
 	virtual bool IsOutputSrgb() const override
@@ -137,11 +553,120 @@ public:
 		return true;
 	}
 
+	virtual const FMatrix& GetYUVToRGBMatrix() const override
+	{
+		return YUVToRGBMatrix;
+	}
+
+	virtual bool GetFullRange() const override
+	{
+		return bFullRange;
+	}
+
+public:
+
+	//~ IMediaPoolable interface
+
+	virtual void ShutdownPoolable() override
+	{
+		// hand the capture buffer back to the device, the frame slot to the arena and the upload slot to the ring
+		ResetPlanes();
+		ResetBuffer();
+		ResetUpload();
+
+		if (TraceFlow != 0)
+		{
+			FDirectShowMediaFrameTracer::Mark(EDirectShowMediaFrameEvent::PoolReturn, TraceFlow);
+			TraceFlow = 0;
+		}
+	}
+
+protected:
+
+	/**
+	 * Get memory for a frame, from the frame arena if it has a free slot the frame fits in.
+	 *
+	 * @param Size The size of the frame (in bytes).
+	 * @return The memory.
+	 */
+	uint8* AllocateBuffer(uint32 Size)
+	{
+		ResetBuffer();
+
+		if (FrameArena.IsValid())
+		{
+			FrameData = FrameArena->Acquire(Size, FrameSlot);
+
+			if (FrameData != nullptr)
+			{
+				FrameSlotArena = FrameArena;
+
+				return FrameData;
+			}
+		}
+
+		Buffer.AddUninitialized(Size);
+
+		return Buffer.GetData();
+	}
+
+	/** Give the frame slot back to its arena, and empty the buffer (keeping its memory for the next frame). */
+	void ResetBuffer()
+	{
+		if (FrameSlotArena.IsValid())
+		{
+			FrameSlotArena->Release(FrameSlot);
+			FrameSlotArena.Reset();
+			FrameSlot = INDEX_NONE;
+		}
+
+		FrameData = nullptr;
+		Buffer.Reset();
+	}
+
+	/** Drop the plane views and the reference to the viewed frame. */
+	void ResetPlanes()
+	{
+		PlanarFormat = EDirectShowMediaPlanarFormat::None;
+		NumPlanes = 0;
+		ViewData = nullptr;
+		SourceFrame.Reset();
+
+		if (ViewBudget.IsValid())
+		{
+			ViewBudget->Release();
+			ViewBudget.Reset();
+		}
+	}
+
+	/** Give the upload slot back to its ring. */
+	void ResetUpload()
+	{
+		if (UploadRing.IsValid())
+		{
+			UploadRing->Release(UploadSlot);
+			UploadRing.Reset();
+			UploadSlot = INDEX_NONE;
+		}
+	}
+
 protected:
 
 	/** The sample's data buffer. */
 	TArray<uint8> Buffer;
 
+	/** The arena new frames are stored in, or nullptr to use the buffer. */
+	TSharedPtr<FDirectShowMediaFrameArena, ESPMode::ThreadSafe> FrameArena;
+
+	/** The arena holding the sample's frame, or nullptr if the frame is in the buffer. */
+	TSharedPtr<FDirectShowMediaFrameArena, ESPMode::ThreadSafe> FrameSlotArena;
+
+	/** The frame's slot in FrameSlotArena. */
+	int32 FrameSlot;
+
+	/** The frame's memory in FrameSlotArena, or nullptr. */
+	uint8* FrameData;
+
 	/** Width and height of the texture sample. */
 	FIntPoint Dim;
 
@@ -160,6 +685,45 @@ protected:
 	/** Presentation for which the sample was generated. */
 	FMediaTimeStamp Time;
 
+	/** Matrix the engine converts YUV samples with. */
+	FMatrix YUVToRGBMatrix;
+
+	/** Whether YUV samples use the full range. */
+	bool bFullRange;
+
+	/** The planar layout of the sample. */
+	EDirectShowMediaPlanarFormat PlanarFormat;
+
+	/** The planes, in component order. */
+	FDirectShowMediaPlane Planes[MaxPlanes];
+
+	/** Number of valid entries in Planes. */
+	int32 NumPlanes;
+
+	/** The viewed frame, or nullptr if the sample owns its data. */
+	const uint8* ViewData;
+
+	/** Keeps the viewed frame alive. */
+	TComPtr<IUnknown> SourceFrame;
+
+	/** The budget the viewed frame's capture buffer is reserved from, or nullptr. */
+	TSharedPtr<FDirectShowMediaPlanarViewBudget, ESPMode::ThreadSafe> ViewBudget;
+
+	/** The ring of the upload slot holding the sample's texture, or nullptr if the sample has a buffer. */
+	TSharedPtr<FDirectShowMediaUploadRing, ESPMode::ThreadSafe> UploadRing;
+
+	/** The upload slot holding the sample's texture. */
+	int32 UploadSlot;
+
+	/** Side data of the frame. */
+	FDirectShowMediaFrameMetadata FrameMetadata;
+
+	/** Timecode of the frame. */
+	TOptional<FTimecode> Timecode;
+
+	/** The frame's flow in the frame trace, zero if it has none. */
+	uint64 TraceFlow;
+
 };
 
 
@@ -0,0 +1,115 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "DirectShowMediaTimecode.h"
+
+#include "Math/UnrealMathUtility.h"
+
+#include "Windows/AllowWindowsPlatformTypes.h"
+#include <dshow.h>
+#include "Windows/HideWindowsPlatformTypes.h"
+
+
+namespace DirectShowMediaTimecode
+{
+	/** Decode a two digit binary coded decimal, returning -1 if it isn't one. */
+	int32 DecodeBCD(uint32 Value)
+	{
+		const uint32 Tens = (Value >> 4) & 0xf;
+		const uint32 Ones = Value & 0xf;
+
+		return ((Tens > 9) || (Ones > 9)) ? -1 : (int32)(Tens * 10 + Ones);
+	}
+}
+
+
+/* FDirectShowMediaTimecode interface
+ *****************************************************************************/
+
+FFrameRate FDirectShowMediaTimecode::GetFrameRate(float FrameRate)
+{
+	if (FrameRate <= 0.0f)
+	{
+		return FFrameRate(30, 1);
+	}
+
+	const int32 Whole = FMath::RoundToInt(FrameRate);
+
+	if (FMath::Abs(FrameRate - (float)Whole) < 0.005f)
+	{
+		return FFrameRate(Whole, 1);
+	}
+
+	const int32 Ntsc = FMath::RoundToInt(FrameRate * 1.001f);
+
+	if (FMath::Abs(FrameRate - (float)Ntsc / 1.001f) < 0.005f)
+	{
+		return FFrameRate(Ntsc * 1000, 1001);
+	}
+
+	return FFrameRate(FMath::RoundToInt(FrameRate * 1000.0f), 1000);
+}
+
+
+bool FDirectShowMediaTimecode::FromFrameMetadata(const FDirectShowMediaFrameMetadata& Metadata, FTimecode& OutTimecode, FFrameRate& OutFrameRate)
+{
+	using namespace DirectShowMediaTimecode;
+
+	if (!EnumHasAnyFlags(Metadata.Flags, EDirectShowMediaFrameMetadataFlags::Timecode))
+	{
+		return false;
+	}
+
+	bool bDropFrame = false;
+
+	switch (Metadata.TimecodeFormat)
+	{
+	case ED_FORMAT_SMPTE_30DROP:
+		OutFrameRate = FFrameRate(30000, 1001);
+		bDropFrame = true;
+		break;
+
+	case ED_FORMAT_SMPTE_30:
+		OutFrameRate = FFrameRate(30, 1);
+		break;
+
+	case ED_FORMAT_SMPTE_25:
+		OutFrameRate = FFrameRate(25, 1);
+		break;
+
+	case ED_FORMAT_SMPTE_24:
+		OutFrameRate = FFrameRate(24, 1);
+		break;
+
+	default:
+		return false;
+	}
+
+	// hhmmssff
+	const int32 Hours = DecodeBCD(Metadata.TimecodeFrames >> 24);
+	const int32 Minutes = DecodeBCD(Metadata.TimecodeFrames >> 16);
+	const int32 Seconds = DecodeBCD(Metadata.TimecodeFrames >> 8);
+	const int32 Frames = DecodeBCD(Metadata.TimecodeFrames);
+
+	if ((Hours < 0) || (Hours > 23) || (Minutes < 0) || (Minutes > 59) || (Seconds < 0) || (Seconds > 59) || (Frames < 0) || (Frames >= FMath::CeilToInt(OutFrameRate.AsDecimal())))
+	{
+		return false;
+	}
+
+	// drop frame timecode skips frames 0 and 1 at the start of every minute but every tenth
+	if (bDropFrame && (Seconds == 0) && (Frames < 2) && ((Minutes % 10) != 0))
+	{
+		return false;
+	}
+
+	OutTimecode = FTimecode(Hours, Minutes, Seconds, Frames, bDropFrame);
+
+	return true;
+}
+
+
+FTimecode FDirectShowMediaTimecode::FromTime(FTimespan Time, const FFrameRate& FrameRate)
+{
+	const bool bDropFrame = FTimecode::IsDropFormatTimecodeSupported(FrameRate) && FTimecode::UseDropFormatTimecodeByDefaultWhenSupported();
+
+	return FTimecode::FromTimespan(Time, FrameRate, bDropFrame, true);
+}
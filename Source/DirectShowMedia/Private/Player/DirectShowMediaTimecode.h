@@ -0,0 +1,52 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreTypes.h"
+#include "DirectShowMediaFrameMetadata.h"
+#include "Misc/FrameRate.h"
+#include "Misc/Timecode.h"
+#include "Misc/Timespan.h"
+
+
+/**
+ * SMPTE timecode for captured frames.
+ *
+ * Frames get the timecode the device reads from its input (i.e. LTC or VITC on capture cards) if it reports
+ * one, otherwise a timecode derived from the sample's presentation time at the device's frame rate.
+ */
+class FDirectShowMediaTimecode
+{
+public:
+
+	/**
+	 * Get the exact frame rate of a frame rate reported by DirectShow.
+	 *
+	 * DirectShow reports frame durations in 100 ns units, so NTSC rates (i.e. 29.97) are only approximate.
+	 *
+	 * @param FrameRate The frame rate (in frames per second).
+	 * @return The frame rate, with a 1001 denominator for NTSC rates.
+	 */
+	static FFrameRate GetFrameRate(float FrameRate);
+
+	/**
+	 * Decode the timecode a device reported for a frame.
+	 *
+	 * @param Metadata The frame's side data.
+	 * @param OutTimecode Will contain the timecode.
+	 * @param OutFrameRate Will contain the frame rate of the timecode.
+	 * @return true if the side data holds a valid timecode, false otherwise.
+	 */
+	static bool FromFrameMetadata(const FDirectShowMediaFrameMetadata& Metadata, FTimecode& OutTimecode, FFrameRate& OutFrameRate);
+
+	/**
+	 * Derive the timecode of a frame from its presentation time.
+	 *
+	 * Drop frame timecode is used for NTSC rates if the project uses it by default.
+	 *
+	 * @param Time The presentation time.
+	 * @param FrameRate The frame rate.
+	 * @return The timecode, rolled over at 24 hours.
+	 */
+	static FTimecode FromTime(FTimespan Time, const FFrameRate& FrameRate);
+};
@@ -0,0 +1,264 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreTypes.h"
+#include "Containers/Array.h"
+#include "HAL/CriticalSection.h"
+#include "Misc/FrameRate.h"
+#include "Misc/QualifiedFrameTime.h"
+#include "Misc/ScopeLock.h"
+#include "Misc/Timecode.h"
+#include "Templates/SharedPointer.h"
+
+
+/**
+ * Fixed capacity index of media samples by timecode.
+ *
+ * Samples are stored in a ring slot picked by their timecode's frame number, so looking up the sample for a
+ * given frame is a single slot compare. A sample stays in the index until it is fetched or its slot is
+ * taken by a frame one capacity later. Requests that can't be served are counted by cause:
+ * late if the frame hasn't been captured yet, early if it was captured but already overwritten by newer
+ * frames (the index runs ahead of the requests), and missing if it was never captured (i.e. dropped).
+ */
+template<typename SampleType>
+class TDirectShowMediaTimecodeIndex
+{
+public:
+
+	typedef TSharedPtr<SampleType, ESPMode::ThreadSafe> FSamplePtr;
+
+	/**
+	 * Create and initialize a new instance.
+	 *
+	 * @param InCapacity Maximum number of samples held by the index.
+	 */
+	explicit TDirectShowMediaTimecodeIndex(int32 InCapacity)
+		: NumHits(0)
+		, NumLate(0)
+		, NumEarly(0)
+		, NumMissing(0)
+	{
+		Entries.SetNum(FMath::Max(1, InCapacity));
+		Clear();
+	}
+
+public:
+
+	/**
+	 * Add a sample.
+	 *
+	 * If the frame rate differs from the one of the samples already indexed, they are dropped.
+	 *
+	 * @param Timecode The sample's timecode.
+	 * @param FrameRate The frame rate of the timecode.
+	 * @param Sample The sample to add.
+	 */
+	void Add(const FTimecode& Timecode, const FFrameRate& FrameRate, const FSamplePtr& Sample)
+	{
+		if (!Sample.IsValid())
+		{
+			return;
+		}
+
+		const int64 FrameNumber = Timecode.ToFrameNumber(FrameRate).Value;
+
+		FScopeLock Lock(&CriticalSection);
+
+		if (FrameRate != IndexRate)
+		{
+			Clear();
+			IndexRate = FrameRate;
+		}
+
+		FEntry& Entry = At(FrameNumber);
+		Entry.FrameNumber = FrameNumber;
+		Entry.Sample = Sample;
+
+		NewestFrameNumber = (NewestFrameNumber == INDEX_NONE) ? FrameNumber : FMath::Max(NewestFrameNumber, FrameNumber);
+	}
+
+	/**
+	 * Take the sample of the frame at the given time.
+	 *
+	 * Each frame is only returned once. Asking for a frame again, whether it was returned or missed, doesn't
+	 * count another miss; a missed frame is still returned if it arrived since.
+	 *
+	 * @param Time The time (i.e. the engine's timecode), converted to the frame rate of the samples.
+	 * @param OutSample Will contain the sample.
+	 * @return true if a sample was returned, false otherwise.
+	 */
+	bool Fetch(const FQualifiedFrameTime& Time, FSamplePtr& OutSample)
+	{
+		FScopeLock Lock(&CriticalSection);
+
+		const int64 FrameNumber = Time.ConvertTo(IndexRate).FloorToFrame().Value;
+
+		if (FrameNumber == LastFetchedFrameNumber)
+		{
+			return false;
+		}
+
+		FEntry& Entry = At(FrameNumber);
+
+		if (Entry.FrameNumber == FrameNumber)
+		{
+			if (!Entry.Sample.IsValid())
+			{
+				return false; // fetched before
+			}
+
+			OutSample = MoveTemp(Entry.Sample);
+			LastFetchedFrameNumber = FrameNumber;
+			++NumHits;
+
+			return true;
+		}
+
+		if (FrameNumber == LastMissedFrameNumber)
+		{
+			return false;
+		}
+
+		LastMissedFrameNumber = FrameNumber;
+
+		if ((NewestFrameNumber == INDEX_NONE) || (FrameNumber > NewestFrameNumber))
+		{
+			++NumLate;
+		}
+		else if (FrameNumber <= NewestFrameNumber - Entries.Num())
+		{
+			++NumEarly;
+		}
+		else
+		{
+			++NumMissing;
+		}
+
+		return false;
+	}
+
+	/**
+	 * Take the sample of the newest frame, if it wasn't fetched yet.
+	 *
+	 * Used when there is no time to look up (i.e. the engine has no timecode provider).
+	 *
+	 * @param OutSample Will contain the sample.
+	 * @return true if a sample was returned, false otherwise.
+	 */
+	bool FetchNewest(FSamplePtr& OutSample)
+	{
+		FScopeLock Lock(&CriticalSection);
+
+		if ((NewestFrameNumber == INDEX_NONE) || (NewestFrameNumber == LastFetchedFrameNumber))
+		{
+			return false;
+		}
+
+		FEntry& Entry = At(NewestFrameNumber);
+
+		if ((Entry.FrameNumber != NewestFrameNumber) || !Entry.Sample.IsValid())
+		{
+			return false;
+		}
+
+		OutSample = MoveTemp(Entry.Sample);
+		LastFetchedFrameNumber = NewestFrameNumber;
+		++NumHits;
+
+		return true;
+	}
+
+	/** Drop all samples. */
+	void Flush()
+	{
+		FScopeLock Lock(&CriticalSection);
+		Clear();
+	}
+
+	/** Number of requests that returned the exact frame, including requests for the newest frame. */
+	uint64 GetNumHits() const
+	{
+		return NumHits;
+	}
+
+	/** Number of requests for frames that weren't captured yet. */
+	uint64 GetNumLate() const
+	{
+		return NumLate;
+	}
+
+	/** Number of requests for frames that were already overwritten. */
+	uint64 GetNumEarly() const
+	{
+		return NumEarly;
+	}
+
+	/** Number of requests for frames the device never delivered. */
+	uint64 GetNumMissing() const
+	{
+		return NumMissing;
+	}
+
+private:
+
+	/** A sample and the frame number of its timecode. */
+	struct FEntry
+	{
+		int64 FrameNumber;
+		FSamplePtr Sample;
+	};
+
+	/** Drop all samples (lock held). */
+	void Clear()
+	{
+		for (FEntry& Entry : Entries)
+		{
+			Entry.FrameNumber = INDEX_NONE;
+			Entry.Sample.Reset();
+		}
+
+		NewestFrameNumber = INDEX_NONE;
+		LastFetchedFrameNumber = INDEX_NONE;
+		LastMissedFrameNumber = INDEX_NONE;
+	}
+
+	/** Get the slot of a frame. */
+	FEntry& At(int64 FrameNumber)
+	{
+		const int64 Capacity = Entries.Num();
+		return Entries[(int32)(((FrameNumber % Capacity) + Capacity) % Capacity)];
+	}
+
+private:
+
+	/** Synchronizes access between the producer and the consumer. */
+	mutable FCriticalSection CriticalSection;
+
+	/** Ring storage, indexed by frame number. */
+	TArray<FEntry> Entries;
+
+	/** Frame rate of the indexed timecodes. */
+	FFrameRate IndexRate;
+
+	/** Frame number of the newest sample, or INDEX_NONE if the index is empty. */
+	int64 NewestFrameNumber;
+
+	/** Frame number of the last sample returned, or INDEX_NONE. */
+	int64 LastFetchedFrameNumber;
+
+	/** Frame number of the last request that couldn't be served, or INDEX_NONE. */
+	int64 LastMissedFrameNumber;
+
+	/** Number of requests that returned the exact frame. */
+	uint64 NumHits;
+
+	/** Number of requests for frames that weren't captured yet. */
+	uint64 NumLate;
+
+	/** Number of requests for frames that were already overwritten. */
+	uint64 NumEarly;
+
+	/** Number of requests for frames the device never delivered. */
+	uint64 NumMissing;
+};
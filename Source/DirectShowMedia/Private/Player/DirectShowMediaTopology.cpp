@@ -0,0 +1,147 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "DirectShowMediaTopology.h"
+
+#include "HAL/PlatformMisc.h"
+#include "Math/UnrealMathUtility.h"
+
+#if PLATFORM_WINDOWS
+	#include "Windows/AllowWindowsPlatformTypes.h"
+	#include "Windows/WindowsHWrapper.h"
+	#include "Windows/HideWindowsPlatformTypes.h"
+#endif
+
+
+namespace DirectShowMediaTopology
+{
+	/** Number of cores a core mask can hold. */
+	const int32 MaxCores = 64;
+
+	/** Get the mask of a range of cores, clipped to the first 64. */
+	uint64 GetRangeMask(int32 First, int32 Last)
+	{
+		uint64 Mask = 0;
+
+		for (int32 Core = FMath::Max(0, First); Core <= FMath::Min(Last, MaxCores - 1); ++Core)
+		{
+			Mask |= 1ull << Core;
+		}
+
+		return Mask;
+	}
+}
+
+
+/* FDirectShowMediaTopology static functions
+ *****************************************************************************/
+
+const FDirectShowMediaTopology& FDirectShowMediaTopology::Get()
+{
+	static FDirectShowMediaTopology Topology;
+	return Topology;
+}
+
+
+/* FDirectShowMediaTopology structors
+ *****************************************************************************/
+
+FDirectShowMediaTopology::FDirectShowMediaTopology()
+	: bFlat(false)
+{
+	if (!DiscoverNodes() || (NodeMasks.Num() == 0))
+	{
+		MakeFlat();
+	}
+}
+
+
+FDirectShowMediaTopology::FDirectShowMediaTopology(const TArray<uint64>& InNodeMasks)
+	: NodeMasks(InNodeMasks)
+	, bFlat(false)
+{
+	if (NodeMasks.Num() == 0)
+	{
+		MakeFlat();
+	}
+}
+
+
+/* FDirectShowMediaTopology interface
+ *****************************************************************************/
+
+int32 FDirectShowMediaTopology::FindNode(uint64 CoreMask) const
+{
+	if (CoreMask == 0)
+	{
+		return INDEX_NONE;
+	}
+
+	for (int32 Node = 0; Node < NodeMasks.Num(); ++Node)
+	{
+		if ((CoreMask & ~NodeMasks[Node]) == 0)
+		{
+			return Node;
+		}
+	}
+
+	return INDEX_NONE;
+}
+
+
+FDirectShowMediaPlacement FDirectShowMediaTopology::Place(int64 Node, int64 CoreMask) const
+{
+	FDirectShowMediaPlacement Placement;
+	const uint64 RequestedMask = (uint64)CoreMask;
+
+	if (Node < 0)
+	{
+		Placement.Node = FindNode(RequestedMask);
+		Placement.CoreMask = RequestedMask;
+	}
+	else if ((Node < NodeMasks.Num()) && (NodeMasks[(int32)Node] != 0))
+	{
+		const uint64 NodeMask = NodeMasks[(int32)Node];
+
+		Placement.Node = (int32)Node;
+		Placement.CoreMask = ((NodeMask & RequestedMask) != 0) ? (NodeMask & RequestedMask) : NodeMask;
+	}
+
+	return Placement;
+}
+
+
+/* FDirectShowMediaTopology implementation
+ *****************************************************************************/
+
+bool FDirectShowMediaTopology::DiscoverNodes()
+{
+#if PLATFORM_WINDOWS
+	ULONG HighestNode = 0;
+
+	if (!::GetNumaHighestNodeNumber(&HighestNode))
+	{
+		return false;
+	}
+
+	for (USHORT Node = 0; Node <= HighestNode; ++Node)
+	{
+		GROUP_AFFINITY Affinity = { };
+
+		// thread affinity masks only reach processor group 0
+		const bool bGroupZero = ::GetNumaNodeProcessorMaskEx(Node, &Affinity) && (Affinity.Group == 0);
+		NodeMasks.Add(bGroupZero ? (uint64)Affinity.Mask : 0);
+	}
+
+	return true;
+#else
+	return false;
+#endif
+}
+
+
+void FDirectShowMediaTopology::MakeFlat()
+{
+	NodeMasks.Reset();
+	NodeMasks.Add(DirectShowMediaTopology::GetRangeMask(0, FPlatformMisc::NumberOfCoresIncludingHyperthreads() - 1));
+	bFlat = true;
+}
@@ -0,0 +1,120 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreTypes.h"
+#include "Containers/Array.h"
+
+
+/** Where a player's capture threads run and its frames live. */
+struct FDirectShowMediaPlacement
+{
+	/** The NUMA node frame memory is allocated from, or INDEX_NONE for any node. */
+	int32 Node = INDEX_NONE;
+
+	/** The cores the capture threads may run on, or zero for any core. */
+	uint64 CoreMask = 0;
+
+	/** Whether the player is placed at all. */
+	bool IsSet() const
+	{
+		return (Node != INDEX_NONE) || (CoreMask != 0);
+	}
+};
+
+
+/**
+ * The machine's NUMA nodes and the cores in each.
+ *
+ * Nodes are discovered once, from the OS's NUMA API on Windows. Elsewhere, or if the node list can't be read,
+ * the machine is treated as a single node holding every core. Core masks cover the first 64 logical processors (processor group 0 on
+ * Windows), as do thread affinity masks.
+ */
+class FDirectShowMediaTopology
+{
+public:
+
+	/** Get the machine's topology. */
+	static const FDirectShowMediaTopology& Get();
+
+public:
+
+	/** Default constructor (discovers the nodes). */
+	FDirectShowMediaTopology();
+
+	/**
+	 * Create a topology of the given nodes (i.e. a fixed machine in tests).
+	 *
+	 * @param InNodeMasks The cores in each node, or an empty array to treat the machine as a single node.
+	 */
+	explicit FDirectShowMediaTopology(const TArray<uint64>& InNodeMasks);
+
+public:
+
+	/** Get the number of nodes. */
+	int32 GetNumNodes() const
+	{
+		return NodeMasks.Num();
+	}
+
+	/**
+	 * Get the cores in a node.
+	 *
+	 * @param Node The node.
+	 * @return The core mask, or zero if the node doesn't exist or has no cores in the first 64.
+	 */
+	uint64 GetCoreMask(int32 Node) const
+	{
+		return NodeMasks.IsValidIndex(Node) ? NodeMasks[Node] : 0;
+	}
+
+	/**
+	 * Find the node that holds a set of cores.
+	 *
+	 * @param CoreMask The cores.
+	 * @return The node holding all of them, or INDEX_NONE if they span several nodes.
+	 */
+	int32 FindNode(uint64 CoreMask) const;
+
+	/** Whether the topology was not discovered and the machine is treated as a single node. */
+	bool IsFlat() const
+	{
+		return bFlat;
+	}
+
+	/**
+	 * Resolve a player's placement.
+	 *
+	 * The capture threads run on the requested cores within the node. If no cores are requested, or none of
+	 * them are in the node, they run on all of the node's cores. If no node is requested, the node is the
+	 * one holding the requested cores, if any.
+	 *
+	 * The values are taken as the media options hold them, so any negative node means none was requested,
+	 * and a negative core mask is a mask that includes core 63.
+	 *
+	 * @param Node The requested node (VideoNumaNode media option), or a negative value.
+	 * @param CoreMask The requested cores (VideoCaptureWorkerAffinity media option, a bit per core), or zero.
+	 * @return The placement (not set if nothing was requested, or the node doesn't exist).
+	 */
+	FDirectShowMediaPlacement Place(int64 Node, int64 CoreMask) const;
+
+private:
+
+	/**
+	 * Read the nodes from the OS.
+	 *
+	 * @return true on success, false if the platform doesn't report its nodes.
+	 */
+	bool DiscoverNodes();
+
+	/** Treat the machine as a single node holding every core. */
+	void MakeFlat();
+
+private:
+
+	/** The cores in each node. */
+	TArray<uint64> NodeMasks;
+
+	/** Whether the machine is treated as a single node. */
+	bool bFlat;
+};
@@ -8,6 +8,10 @@
 #include "MediaHelpers.h"
 #include "MediaSampleQueueDepths.h"
 #include "MediaPlayerOptions.h"
+#include "HAL/PlatformProcess.h"
+#include "HAL/PlatformTime.h"
+#include "HAL/PlatformTLS.h"
+#include "Misc/App.h"
 #include "Misc/ScopeLock.h"
 #include "UObject/Class.h"
 
@@ -18,10 +22,13 @@
 
 
 #include "DirectShowCallbackHandler.h"
+#include "Player/DirectShowMediaFrameTracer.h"
+#include "Player/DirectShowMediaRHIUploadBackend.h"
 #include "Player/DirectShowMediaTextureSample.h"
 
 #include "DirectShowMediaAudioSample.h"
 #include "DirectShowMediaBinarySample.h"
+#include "DirectShowMediaTimecode.h"
 #include "DirectShowMediaOverlaySample.h"
 #include "IMediaOptions.h"
 
@@ -36,6 +43,115 @@
 #define AV_SYNC_THRESHOLD_MAX 0.1
 
 
+namespace DirectShowMediaTracks
+{
+	/** Map the VideoSinkFormat media option to the subtype compressed video is decoded to. */
+	GUID GetSinkSubtype(const FString& SinkFormat)
+	{
+		if (SinkFormat.Equals(TEXT("NV12"), ESearchCase::IgnoreCase))
+		{
+			return MEDIASUBTYPE_NV12;
+		}
+
+		if (SinkFormat.Equals(TEXT("YUY2"), ESearchCase::IgnoreCase))
+		{
+			return MEDIASUBTYPE_YUY2;
+		}
+
+		return MEDIASUBTYPE_ARGB32;
+	}
+
+	/** Map the VideoCaptureWorkerPriority media option to a thread priority. */
+	EThreadPriority GetCaptureWorkerPriority(const FString& Priority)
+	{
+		if (Priority.Equals(TEXT("Normal"), ESearchCase::IgnoreCase))
+		{
+			return TPri_Normal;
+		}
+
+		if (Priority.Equals(TEXT("Highest"), ESearchCase::IgnoreCase))
+		{
+			return TPri_Highest;
+		}
+
+		if (Priority.Equals(TEXT("TimeCritical"), ESearchCase::IgnoreCase))
+		{
+			return TPri_TimeCritical;
+		}
+
+		return TPri_AboveNormal;
+	}
+
+	/** Number of video frames queued once the capture memory budget shrinks the queue. */
+	const int32 MinVideoQueueDepth = 2;
+
+	/** Get the display name of the pages backing a frame arena. */
+	const TCHAR* GetFramePagesName(EDirectShowMediaFramePages Pages)
+	{
+		switch (Pages)
+		{
+		case EDirectShowMediaFramePages::Large: return TEXT("large pages");
+		default: return TEXT("regular pages");
+		}
+	}
+
+	/** Get the display name of a capture memory budget level. */
+	const TCHAR* GetMemoryLevelName(EDirectShowMediaMemoryLevel Level)
+	{
+		switch (Level)
+		{
+		case EDirectShowMediaMemoryLevel::ShrinkQueue: return TEXT("queue shrunk");
+		case EDirectShowMediaMemoryLevel::Mailbox: return TEXT("mailbox");
+		case EDirectShowMediaMemoryLevel::ReduceResolution: return TEXT("resolution reduced");
+		default: return TEXT("full");
+		}
+	}
+
+	/**
+	 * Find the format captured at the ReduceResolution budget level.
+	 *
+	 * That is the largest format of the same subtype with at most half the pixels, or the smallest one with
+	 * fewer pixels if there is none that small.
+	 */
+	int32 FindReducedVideoFormat(const FDShowTrack& Track, int32 FormatIndex)
+	{
+		if (!Track.Formats.IsValidIndex(FormatIndex))
+		{
+			return INDEX_NONE;
+		}
+
+		const FDShowFormat& Format = Track.Formats[FormatIndex];
+		const int64 NumPixels = (int64)Format.Video.OutputDim.X * Format.Video.OutputDim.Y;
+
+		int32 BestIndex = INDEX_NONE;
+		int64 BestNumPixels = 0;
+		bool bBestHalved = false;
+
+		for (int32 Index = 0; Index < Track.Formats.Num(); ++Index)
+		{
+			const FDShowFormat& Candidate = Track.Formats[Index];
+			const int64 CandidateNumPixels = (int64)Candidate.Video.OutputDim.X * Candidate.Video.OutputDim.Y;
+
+			if ((Candidate.MinorType != Format.MinorType) || (CandidateNumPixels <= 0) || (CandidateNumPixels >= NumPixels))
+			{
+				continue;
+			}
+
+			const bool bHalved = (CandidateNumPixels * 2 <= NumPixels);
+
+			if ((BestIndex == INDEX_NONE) || (bHalved && (!bBestHalved || (CandidateNumPixels > BestNumPixels))) || (!bHalved && !bBestHalved && (CandidateNumPixels < BestNumPixels)))
+			{
+				BestIndex = Index;
+				BestNumPixels = CandidateNumPixels;
+				bBestHalved = bHalved;
+			}
+		}
+
+		return BestIndex;
+	}
+}
+
+
 
 /* FDirectShowMediaTracks structors
  *****************************************************************************/
@@ -48,7 +164,35 @@ FDirectShowMediaTracks::FDirectShowMediaTracks() :
 	DesiredAudioDevice(""),
 	SelectionChanged(false),
 	AudioSamplePool(new FDirectShowMediaAudioSamplePool),
+	AudioOutputSampleRate(48000),
+	AudioOutputChannels(0),
+	LastAudioFetchTime(0.0),
+	bAudioStarved(false),
+	CaptionSamplePool(new FDirectShowMediaOverlaySamplePool),
+	MetadataQueue(FMediaPlayerQueueDepths::MaxMetadataSinkDepth),
 	VideoSamplePool(new FDirectShowMediaTextureSamplePool),
+	VideoSampleWindow(FMediaPlayerQueueDepths::MaxVideoSinkDepth),
+	bVideoMailboxMode(false),
+	bVideoConvertToBGRA(false),
+	bVideoConvertTo8Bit(false),
+	bVideoAcceptPlanar(false),
+	bVideoFlipVertically(false),
+	VideoRowAlignment(256),
+	VideoFormatSerial(MAX_uint32),
+	VideoFrameNumber(0),
+	VideoTraceTrack(FDirectShowMediaFrameTracer::NewTrack()),
+	VideoTimecodeIndex(FMediaPlayerQueueDepths::MaxVideoSinkDepth),
+	bVideoTimecodeLookup(false),
+	bVideoCaptureWorker(false),
+	VideoPinnedThreadId(0),
+	bVideoDirectUpload(false),
+	VideoUploadSlots(6),
+	bVideoFrameArena(false),
+	VideoFrameArenaSlots(12),
+	VideoMemoryLevel(EDirectShowMediaMemoryLevel::Full),
+	VideoPreferredFormat(INDEX_NONE),
+	VideoReducedFormat(INDEX_NONE),
+	VideoRejectedFormat(INDEX_NONE),
 	SelectedAudioTrack(INDEX_NONE),
 	SelectedCaptionTrack(INDEX_NONE),
     SelectedMetadataTrack(INDEX_NONE),
@@ -62,17 +206,34 @@ FDirectShowMediaTracks::FDirectShowMediaTracks() :
 	CurrentVideoDevice(nullptr)
 	//CurrentAudioDevice(nullptr)
  {
-
+	FDirectShowMediaMemoryBudget::Get().Open(VideoMemoryAccount);
  }
 
 
 FDirectShowMediaTracks::~FDirectShowMediaTracks()
 {
+	// Shutdown holds off while an open is in flight, but nothing may deliver into the pools once they are deleted
+	{
+		FScopeLock DeviceLock(&DeviceSection);
+
+		if (CurrentVideoDevice)
+		{
+			CurrentVideoDevice->Stop();
+		}
+	}
+
+	VideoCaptureWorker.Shutdown();
+
 	Shutdown();
 
+	FDirectShowMediaMemoryBudget::Get().Close(VideoMemoryAccount);
+
 	delete AudioSamplePool;
 	AudioSamplePool = nullptr;
 
+	delete CaptionSamplePool;
+	CaptionSamplePool = nullptr;
+
 	delete VideoSamplePool;
 	VideoSamplePool = nullptr;
 
@@ -90,6 +251,10 @@ void FDirectShowMediaTracks::Initialize(const FString& Url, const IMediaOptions*
 		return;
 	//Shutdown();
 
+	// the worker takes the sample lock, so it is stopped before the locks are taken
+	VideoCaptureWorker.Shutdown();
+
+	FScopeLock DeviceLock(&DeviceSection);
 	FScopeLock Lock(&CriticalSection);
 	if(CurrentVideoDevice)
 	{
@@ -99,16 +264,95 @@ void FDirectShowMediaTracks::Initialize(const FString& Url, const IMediaOptions*
 	bShuttingDown = false;
 	SourceUrl = Url;
 	DesiredAudioDevice = indesiredAudioDevice;
+	VideoDecimator.SetTargetFrameRate((Options) ? Options->GetMediaOption(FName("VideoDecimationFramerate"), 0.0) : 0.0);
+	bVideoMailboxMode = (Options) ? Options->GetMediaOption(FName("VideoMailboxMode"), false) : false;
+	bVideoConvertToBGRA = (Options) ? Options->GetMediaOption(FName("VideoConvertToBGRA"), false) : false;
+	bVideoConvertTo8Bit = (Options) ? Options->GetMediaOption(FName("VideoConvertTo8Bit"), false) : false;
+	bVideoAcceptPlanar = (Options) ? Options->GetMediaOption(FName("VideoAcceptPlanar"), false) : false;
+	bVideoFlipVertically = (Options) ? Options->GetMediaOption(FName("VideoFlipVertically"), false) : false;
+	VideoRowAlignment = FMath::RoundUpToPowerOfTwo((uint32)FMath::Clamp<int64>((Options) ? Options->GetMediaOption(FName("VideoRowAlignment"), (int64)256) : 256, 1, 4096));
+	VideoLayout.Reset();
+	VideoUploadRing.Reset();
+	bVideoDirectUpload = (Options) ? Options->GetMediaOption(FName("VideoDirectUpload"), false) : false;
+	VideoUploadSlots = (int32)FMath::Clamp<int64>((Options) ? Options->GetMediaOption(FName("VideoUploadSlots"), (int64)6) : 6, 2, 16);
+	VideoFrameArena.Reset();
+	bVideoFrameArena = (Options) ? Options->GetMediaOption(FName("VideoFrameArena"), false) : false;
+	VideoFrameArenaSlots = (int32)FMath::Clamp<int64>((Options) ? Options->GetMediaOption(FName("VideoFrameArenaSlots"), (int64)12) : 12, 2, 64);
+	VideoMemoryLevel = EDirectShowMediaMemoryLevel::Full;
+	bVideoBudgetMailbox = false;
+	VideoPreferredFormat = INDEX_NONE;
+	VideoReducedFormat = INDEX_NONE;
+	VideoRejectedFormat = INDEX_NONE;
+	VideoSampleWindow.SetCapacity(FMediaPlayerQueueDepths::MaxVideoSinkDepth);
+	FDirectShowMediaMemoryBudget::Get().SetDemand(VideoMemoryAccount, FDirectShowMediaMemoryDemand());
+	VideoFormatSerial = MAX_uint32;
+	VideoFrameNumber = 0;
+	VideoTraceTrack = FDirectShowMediaFrameTracer::NewTrack();
+	bVideoTimecodeLookup = (Options) ? Options->GetMediaOption(FName("VideoTimecodeLookup"), false) : false;
+	VideoTimecodeIndex.Flush();
+	bVideoCaptureWorker = (Options) ? Options->GetMediaOption(FName("VideoCaptureWorker"), false) : false;
+	const int64 VideoNumaNode = (Options) ? Options->GetMediaOption(FName("VideoNumaNode"), (int64)INDEX_NONE) : INDEX_NONE;
+	VideoPlacement = FDirectShowMediaTopology::Get().Place(VideoNumaNode, (Options) ? Options->GetMediaOption(FName("VideoCaptureWorkerAffinity"), (int64)0) : 0);
+	VideoPinnedThreadId = 0;
+
+	if ((VideoNumaNode >= 0) && (VideoPlacement.Node != VideoNumaNode))
+	{
+		UE_LOG(LogDirectShowMedia, Warning, TEXT("Tracks: %p: NUMA node %lld doesn't exist or has no cores, video capture is not placed"), this, VideoNumaNode);
+	}
+	AudioSync.Reset();
+	CaptionDecoder.Reset();
+	AudioOutputSampleRate = (uint32)FMath::Max<int64>(0, (Options) ? Options->GetMediaOption(FName("AudioOutputSampleRate"), (int64)48000) : 48000);
+	AudioOutputChannels = (uint32)FMath::Max<int64>(0, (Options) ? Options->GetMediaOption(FName("AudioOutputChannels"), (int64)0) : 0);
+	const float AudioBufferMs = (float)((Options) ? Options->GetMediaOption(FName("AudioBufferMs"), 20.0) : 20.0);
+	AudioBufferController.Reset(
+		AudioBufferMs,
+		(float)((Options) ? Options->GetMediaOption(FName("AudioBufferMinMs"), 10.0) : 10.0),
+		(float)((Options) ? Options->GetMediaOption(FName("AudioBufferMaxMs"), 200.0) : 200.0),
+		(Options) ? Options->GetMediaOption(FName("AudioAdaptiveBuffer"), false) : false);
+	LastAudioFetchTime = 0.0;
+	bAudioStarved = false;
 	MediaSourceChanged = true;
 	SelectionChanged = true;
 	
 	/// Setup video device ///
 	CurrentVideoDevice = new FDirectShowVideoDevice();
+	CurrentVideoDevice->SetAudioBufferDuration(AudioBufferMs);
+	CurrentVideoDevice->SetGraphTraceFile((Options) ? Options->GetMediaOption(FName("GraphTraceFile"), FString()) : FString());
+	CurrentVideoDevice->SetPreferredSinkSubtype(DirectShowMediaTracks::GetSinkSubtype((Options) ? Options->GetMediaOption(FName("VideoSinkFormat"), FString()) : FString()));
 	if(FDirectShowCallbackHandler* VideoCallback = CurrentVideoDevice->GetVideoCallbackHandler())
 	{
-		VideoCallback->OnSampleCB.BindLambda([this](double Time, IMediaSample* Sample) {
-			this->HandleMediaSamplerVideoSample(Time, Sample);
-		});
+		if (bVideoCaptureWorker)
+		{
+			VideoCaptureWorker.Start(
+				[this](double Time, IMediaSample* Sample) {
+					this->HandleMediaSamplerVideoSample(Time, Sample);
+				},
+				(int32)((Options) ? Options->GetMediaOption(FName("VideoCaptureQueueDepth"), (int64)2) : 2),
+				DirectShowMediaTracks::GetCaptureWorkerPriority((Options) ? Options->GetMediaOption(FName("VideoCaptureWorkerPriority"), FString()) : FString()),
+				VideoPlacement.CoreMask);
+		}
+
+		// called for every frame, so it bypasses the delegate
+		VideoCallback->SetSampleHandler([](void* Context, double Time, IMediaSample* Sample) {
+			FDirectShowMediaTracks* Tracks = static_cast<FDirectShowMediaTracks*>(Context);
+			FDirectShowMediaFrameTraceScope CallbackTrace(EDirectShowMediaFrameEvent::Callback);
+
+			// the streaming thread belongs to this player's graph, so it can join the node its frames live on
+			if (Tracks->VideoPlacement.Node != INDEX_NONE)
+			{
+				Tracks->PinVideoStreamingThread();
+			}
+
+			// the streaming thread only references the sample when the worker handles it
+			if (Tracks->bVideoCaptureWorker)
+			{
+				Tracks->VideoCaptureWorker.Post(Time, Sample);
+			}
+			else
+			{
+				Tracks->HandleMediaSamplerVideoSample(Time, Sample);
+			}
+		}, this);
 	}
 	if(FDirectShowCallbackHandler* VideoCallback = CurrentVideoDevice->GetAudioCallbackHandler())
 	{
@@ -233,11 +477,18 @@ void FDirectShowMediaTracks::Shutdown()
 	UE_LOG(LogDirectShowMedia, Verbose, TEXT("Tracks: %p: Shutting down (media source)"), this);
 	if(bIsInitializing)
 		return;
-	if(CurrentVideoDevice)
 	{
-		CurrentVideoDevice->Stop();
-		delete CurrentVideoDevice;
-		CurrentVideoDevice = nullptr;
+		FScopeLock DeviceLock(&DeviceSection);
+		if(CurrentVideoDevice)
+		{
+			CurrentVideoDevice->Stop();
+
+			// the device no longer delivers, finish with the samples the worker still references before it goes away
+			VideoCaptureWorker.Shutdown();
+
+			delete CurrentVideoDevice;
+			CurrentVideoDevice = nullptr;
+		}
 	}
 	FScopeLock Lock(&CriticalSection);
 	// if(CurrentAudioDevice)
@@ -255,8 +506,15 @@ void FDirectShowMediaTracks::Shutdown()
 	SourceUrl = "";
 	DesiredAudioDevice = "";
 
+	// a closed player gives its share of the capture memory budget to the others
+	FDirectShowMediaMemoryBudget::Get().SetDemand(VideoMemoryAccount, FDirectShowMediaMemoryDemand());
+
 	AudioSamplePool->Reset();
+	CaptionSamplePool->Reset();
+	MetadataQueue.Reset();
 	VideoSamplePool->Reset();
+
+	CaptionDecoder.Reset();
 	
 	AudioTracks.Empty();
 	MetadataTracks.Empty();
@@ -285,6 +543,14 @@ void FDirectShowMediaTracks::AppendStats(FString& OutStats) const
 			OutStats += FString::Printf(TEXT("\t%s\n"), *Track.DisplayName.ToString());
 			OutStats += TEXT("\t\tNot implemented yet");
 		}
+
+		OutStats += FString::Printf(TEXT("\tA/V sync error: %.2f ms\n"), AudioSync.GetSyncError() * 1000.0);
+		OutStats += FString::Printf(TEXT("\tAudio clock drift: %.1f ppm\n"), AudioSync.GetDriftPpm());
+		OutStats += FString::Printf(TEXT("\tA/V resyncs: %u\n"), AudioSync.GetNumResyncs());
+		OutStats += FString::Printf(TEXT("\tDevice buffer: %.0f ms\n"), AudioBufferController.GetBufferMs());
+		OutStats += FString::Printf(TEXT("\tCallback jitter: %.1f ms\n"), AudioBufferController.GetJitterMs());
+		OutStats += FString::Printf(TEXT("\tUnderruns: %u\n"), AudioBufferController.GetNumUnderruns());
+		OutStats += FString::Printf(TEXT("\tBuffer renegotiations: %u\n"), AudioBufferController.GetNumRenegotiations());
 	}
 
 	// video tracks
@@ -301,6 +567,96 @@ void FDirectShowMediaTracks::AppendStats(FString& OutStats) const
 			OutStats += FString::Printf(TEXT("\t%s\n"), *Track.DisplayName.ToString());
 			OutStats += TEXT("\t\tNot implemented yet");
 		}
+
+		OutStats += FString::Printf(TEXT("\tColorimetry: %s%s\n"), *VideoColorConverter.GetColorimetry().ToString(), bVideoConvertToBGRA ? TEXT(" (converted to BGRA)") : TEXT(""));
+
+		if (bVideoConvertTo8Bit)
+		{
+			OutStats += TEXT("\t10 bit formats: dithered to 8 bit\n");
+		}
+
+		if (bVideoAcceptPlanar)
+		{
+			OutStats += TEXT("\tPlanar formats: plane views\n");
+		}
+
+		if (CurrentVideoDevice != nullptr && CurrentVideoDevice->GetSampleSubtype() != CurrentVideoDevice->GetCurrentSubtype())
+		{
+			OutStats += FString::Printf(TEXT("\tDecoded from %s to %s\n"), *CurrentVideoDevice->GetFormatTypeFromGUID(CurrentVideoDevice->GetCurrentSubtype()), *CurrentVideoDevice->GetFormatTypeFromGUID(CurrentVideoDevice->GetSampleSubtype()));
+		}
+
+		if (VideoDecimator.IsEnabled())
+		{
+			OutStats += FString::Printf(TEXT("\tDecimated frames: %llu\n"), VideoDecimator.GetNumDroppedFrames());
+		}
+
+		if (VideoPlacement.IsSet())
+		{
+			const FDirectShowMediaTopology& Topology = FDirectShowMediaTopology::Get();
+			OutStats += FString::Printf(TEXT("\tPlacement: node %d of %d%s, capture cores 0x%llx\n"), VideoPlacement.Node, Topology.GetNumNodes(), Topology.IsFlat() ? TEXT(" (flat topology)") : TEXT(""), VideoPlacement.CoreMask);
+		}
+
+		if (FDirectShowMediaFrameTracer::IsEnabled())
+		{
+			OutStats += FString::Printf(TEXT("\tFrame trace: recording as player %u\n"), VideoTraceTrack);
+		}
+
+		if (bVideoCaptureWorker)
+		{
+			OutStats += FString::Printf(TEXT("\tCapture worker: %llu queued, %llu dropped, %.2f ms average wait, %.2f ms max wait\n"), VideoCaptureWorker.GetNumPosted(), VideoCaptureWorker.GetNumDropped(), VideoCaptureWorker.GetAverageLatency() * 1000.0, VideoCaptureWorker.GetMaxLatency() * 1000.0);
+		}
+
+		const FDirectShowMediaMemoryBudget& MemoryBudget = FDirectShowMediaMemoryBudget::Get();
+		OutStats += FString::Printf(TEXT("\tCapture memory: %.1f MB committed (%s); all %d players %.1f MB, peak %.1f MB, budget %s\n"),
+			VideoMemoryAccount.GetCommittedBytes() / 1048576.0, DirectShowMediaTracks::GetMemoryLevelName(VideoMemoryAccount.GetLevel()),
+			MemoryBudget.GetNumAccounts(), MemoryBudget.GetCommittedBytes() / 1048576.0, MemoryBudget.GetPeakBytes() / 1048576.0,
+			(MemoryBudget.GetBudget() > 0) ? *FString::Printf(TEXT("%.1f MB"), MemoryBudget.GetBudget() / 1048576.0) : TEXT("none"));
+
+		if (VideoFrameArena.IsValid())
+		{
+			OutStats += FString::Printf(TEXT("\tFrame arena: %d slots of %.1f MB on %s, %llu frames allocated outside\n"), VideoFrameArena->GetNumSlots(), VideoFrameArena->GetSlotSize() / 1048576.0, DirectShowMediaTracks::GetFramePagesName(VideoFrameArena->GetPages()), VideoFrameArena->GetNumMissed());
+		}
+
+		if (VideoUploadRing.IsValid())
+		{
+			OutStats += FString::Printf(TEXT("\tDirect upload: %d slots, %llu uploaded, %llu copied to buffers (no free slot)\n"), VideoUploadRing->GetNumSlots(), VideoUploadRing->GetNumUploaded(), VideoUploadRing->GetNumMissed());
+		}
+
+		if (bVideoTimecodeLookup)
+		{
+			OutStats += FString::Printf(TEXT("\tTimecode lookups: %llu exact, %llu late, %llu early, %llu missing\n"), VideoTimecodeIndex.GetNumHits(), VideoTimecodeIndex.GetNumLate(), VideoTimecodeIndex.GetNumEarly(), VideoTimecodeIndex.GetNumMissing());
+		}
+		else if (bVideoMailboxMode || bVideoBudgetMailbox)
+		{
+			OutStats += FString::Printf(TEXT("\tSuperseded frames: %llu\n"), VideoMailbox.GetNumSuperseded());
+		}
+		else
+		{
+			OutStats += FString::Printf(TEXT("\tStale frames skipped: %llu\n"), VideoSampleWindow.GetNumStale());
+			OutStats += FString::Printf(TEXT("\tOverflowed frames: %llu\n"), VideoSampleWindow.GetNumOverflowed());
+		}
+	}
+
+	// graph open timeline
+	if (CurrentVideoDevice != nullptr)
+	{
+		const FDirectShowGraphTimeline& OpenTimeline = CurrentVideoDevice->GetOpenTimeline();
+		TArray<FDirectShowGraphStep> Steps;
+		OpenTimeline.GetSteps(Steps);
+
+		OutStats += FString::Printf(TEXT("Graph Open (%u opens)\n"), OpenTimeline.GetNumOpens());
+
+		if (Steps.Num() == 0)
+		{
+			OutStats += TEXT("\tnone\n");
+		}
+
+		for (const FDirectShowGraphStep& Step : Steps)
+		{
+			OutStats += FString::Printf(TEXT("\t%s%s: "), *FString::ChrN(Step.Depth, TEXT('\t')), Step.Name);
+			OutStats += (Step.Duration < 0.0) ? FString(TEXT("running")) : FString::Printf(TEXT("%.2f ms at +%.2f ms, %s"), Step.Duration * 1000.0, Step.StartTime * 1000.0, Step.bSucceeded ? TEXT("succeeded") : TEXT("failed"));
+			OutStats += (Step.Result != S_OK) ? FString::Printf(TEXT(" (0x%08x)\n"), (uint32)Step.Result) : FString(TEXT("\n"));
+		}
 	}
 }
 
@@ -363,6 +719,16 @@ void FDirectShowMediaTracks::OnVideoTracksUpdated(uint32 SelectedIndex)
 	if(VideoTracks.Num() > 0)
 		SelectedVideoTrack = 0;
 
+	// every video frame produces a metadata sample while this track is selected
+	if(MetadataTracks.Num() == 0)
+	{
+		FDShowTrack& MetadataTrack = MetadataTracks.AddDefaulted_GetRef();
+		MetadataTrack.DisplayName = LOCTEXT("FrameMetadataTrack", "Frame Metadata");
+		MetadataTrack.Name = TEXT("FrameMetadata");
+		MetadataTrack.Protected = false;
+		MetadataTrack.SelectedFormat = INDEX_NONE;
+	}
+
 	VideoTracks[SelectedVideoTrack].SelectedFormat = (SelectedIndex < 0) ? 0 : SelectedIndex;
 	UE_LOG(LogDirectShowMedia, Log, TEXT("VideoTracks[SelectedVideoTrack].SelectedFormat = %d"), SelectedIndex)
 }
@@ -400,49 +766,186 @@ void FDirectShowMediaTracks::TickInput(FTimespan DeltaTime, FTimespan Timecode)
 {
 	TargetTime = Timecode;
 
+	// FetchVideo is called on the game thread too, after input was ticked
+	VideoTimecodeTarget = FApp::GetCurrentFrameTime();
+
 	double time = Timecode.GetTotalSeconds();
 	UE_LOG(LogDirectShowMedia, VeryVerbose, TEXT("Tracks: %p: TimeCode %.3f"), this, (float)time);
 }
 
+bool FDirectShowMediaTracks::ShouldRenegotiateAudioBuffer(float& OutBufferMs)
+{
+	if (bAudioRenegotiationPending || bShuttingDown || CurrentState != EMediaState::Playing)
+	{
+		return false;
+	}
 
-/* IMediaSamples interface
- *****************************************************************************/
-
+	if (!AudioBufferController.PollRenegotiation(FPlatformTime::Seconds(), OutBufferMs))
+	{
+		return false;
+	}
 
+	bAudioRenegotiationPending = true;
 
+	return true;
+}
 
-bool FDirectShowMediaTracks::FetchCaption(TRange<FTimespan> TimeRange, TSharedPtr<IMediaOverlaySample, ESPMode::ThreadSafe>& OutSample)
+void FDirectShowMediaTracks::RenegotiateAudioBuffer(float BufferMs)
 {
-	TSharedPtr<IMediaOverlaySample, ESPMode::ThreadSafe> Sample;
+	// CriticalSection can't be held while the graph stops, the streaming threads need it to finish their callbacks
+	FScopeLock DeviceLock(&DeviceSection);
 
-	if (!CaptionSampleQueue.Peek(Sample))
+	FDirectShowVideoDevice* Device = nullptr;
+	{
+		FScopeLock Lock(&CriticalSection);
+		Device = bShuttingDown ? nullptr : CurrentVideoDevice;
+	}
+
+	if (Device != nullptr)
+	{
+		if (Device->RenegotiateAudioBuffer(BufferMs))
+		{
+			UE_LOG(LogDirectShowMedia, Verbose, TEXT("Tracks: %p: Audio buffer renegotiated to %.0f ms"), this, BufferMs);
+		}
+
+		// the graph clock restarted, drop everything stamped on the old timeline
+		FScopeLock Lock(&CriticalSection);
+		AudioSync.Reset();
+		AudioConverter.Reset();
+		AudioSampleQueue.RequestFlush();
+		VideoSampleWindow.Flush();
+		VideoTimecodeIndex.Flush();
+		VideoCaptureWorker.Flush();
+	}
+
+	// also on failure, so it isn't retried right away
+	AudioBufferController.OnRenegotiated(FPlatformTime::Seconds(), (Device != nullptr) ? Device->GetAudioBufferDuration() : BufferMs);
+	bAudioRenegotiationPending = false;
+}
+
+bool FDirectShowMediaTracks::ShouldChangeVideoFormat(int32& OutFormatIndex)
+{
+	if (bVideoFormatChangePending || bShuttingDown || CurrentState != EMediaState::Playing)
 	{
 		return false;
 	}
 
-	const FTimespan SampleTime = Sample->GetTime().Time;
+	FScopeLock Lock(&CriticalSection);
 
-	if (!TimeRange.Overlaps(TRange<FTimespan>(SampleTime, SampleTime + Sample->GetDuration())))
+	if (!VideoTracks.IsValidIndex(SelectedVideoTrack))
 	{
 		return false;
 	}
 
-	if (!CaptionSampleQueue.Dequeue(Sample))
+	// the preferred format comes back once the budget no longer needs the reduced one
+	const FDShowTrack& Track = VideoTracks[SelectedVideoTrack];
+	const bool bReduce = (VideoMemoryAccount.GetLevel() == EDirectShowMediaMemoryLevel::ReduceResolution) && Track.Formats.IsValidIndex(VideoReducedFormat);
+	const int32 FormatIndex = bReduce ? VideoReducedFormat : VideoPreferredFormat;
+
+	if (!Track.Formats.IsValidIndex(FormatIndex) || (FormatIndex == Track.SelectedFormat) || (FormatIndex == VideoRejectedFormat))
 	{
 		return false;
 	}
 
-	OutSample = Sample;
+	OutFormatIndex = FormatIndex;
+	bVideoFormatChangePending = true;
 
 	return true;
 }
 
+bool FDirectShowMediaTracks::ApplyVideoFormatBudget(int32 FormatIndex)
+{
+	// like the audio renegotiation, Shutdown waits on DeviceSection while the graph is rebuilt
+	FScopeLock DeviceLock(&DeviceSection);
 
-bool FDirectShowMediaTracks::FetchMetadata(TRange<FTimespan> TimeRange, TSharedPtr<IMediaBinarySample, ESPMode::ThreadSafe>& OutSample)
+	FDirectShowVideoDevice* Device = nullptr;
+	FString Url;
+	FDShowFormat Format;
+	FDShowFormat PreviousFormat;
+	int32 PreviousFormatIndex = INDEX_NONE;
+	{
+		FScopeLock Lock(&CriticalSection);
+
+		if (!bShuttingDown && (CurrentVideoDevice != nullptr) && VideoTracks.IsValidIndex(SelectedVideoTrack))
+		{
+			const FDShowTrack& Track = VideoTracks[SelectedVideoTrack];
+
+			if (Track.Formats.IsValidIndex(FormatIndex) && Track.Formats.IsValidIndex(Track.SelectedFormat))
+			{
+				Device = CurrentVideoDevice;
+				Url = SourceUrl;
+				Format = Track.Formats[FormatIndex];
+				PreviousFormatIndex = Track.SelectedFormat;
+				PreviousFormat = Track.Formats[PreviousFormatIndex];
+			}
+		}
+	}
+
+	if (Device == nullptr)
+	{
+		bVideoFormatChangePending = false;
+		return false;
+	}
+
+	UE_LOG(LogDirectShowMedia, Log, TEXT("Tracks: %p: Switching to video format %i for the capture memory budget"), this, FormatIndex);
+
+	// the switch is invisible to the player, its state is left alone and only the sample handlers are held off
+	bVideoFormatSwitching = true;
+
+	{
+		FScopeLock Lock(&CriticalSection);
+		VideoSampleWindow.Flush();
+		VideoTimecodeIndex.Flush();
+		VideoCaptureWorker.Flush();
+		AudioSampleQueue.RequestFlush();
+	}
+
+	// CriticalSection can't be held while the graph is rebuilt, the streaming threads need it to finish their callbacks
+	const bool bSucceeded = Device->SetFormatInfo(Url, Format);
+
+	if (!bSucceeded)
+	{
+		UE_LOG(LogDirectShowMedia, Warning, TEXT("Tracks: %p: Failed to switch to video format %i, keeping format %i"), this, FormatIndex, PreviousFormatIndex);
+
+		// the failed attempt tore the graph down, build it again for the format it had
+		if (!Device->SetFormatInfo(Url, PreviousFormat))
+		{
+			UE_LOG(LogDirectShowMedia, Error, TEXT("Tracks: %p: Failed to restore video format %i"), this, PreviousFormatIndex);
+		}
+	}
+
+	{
+		FScopeLock Lock(&CriticalSection);
+
+		if (bSucceeded)
+		{
+			VideoTracks[SelectedVideoTrack].SelectedFormat = FormatIndex;
+			SelectionChanged = true;
+		}
+		else
+		{
+			VideoRejectedFormat = FormatIndex;
+		}
+	}
+
+	bVideoFormatSwitching = false;
+	bVideoFormatChangePending = false;
+
+	return bSucceeded;
+}
+
+
+/* IMediaSamples interface
+ *****************************************************************************/
+
+
+
+
+bool FDirectShowMediaTracks::FetchCaption(TRange<FTimespan> TimeRange, TSharedPtr<IMediaOverlaySample, ESPMode::ThreadSafe>& OutSample)
 {
-	TSharedPtr<IMediaBinarySample, ESPMode::ThreadSafe> Sample;
+	TSharedPtr<IMediaOverlaySample, ESPMode::ThreadSafe> Sample;
 
-	if (!MetadataSampleQueue.Peek(Sample))
+	if (!CaptionSampleQueue.Peek(Sample))
 	{
 		return false;
 	}
@@ -454,7 +957,7 @@ bool FDirectShowMediaTracks::FetchMetadata(TRange<FTimespan> TimeRange, TSharedP
 		return false;
 	}
 
-	if (!MetadataSampleQueue.Dequeue(Sample))
+	if (!CaptionSampleQueue.Dequeue(Sample))
 	{
 		return false;
 	}
@@ -464,12 +967,28 @@ bool FDirectShowMediaTracks::FetchMetadata(TRange<FTimespan> TimeRange, TSharedP
 	return true;
 }
 
+
+bool FDirectShowMediaTracks::FetchMetadata(TRange<FTimespan> TimeRange, TSharedPtr<IMediaBinarySample, ESPMode::ThreadSafe>& OutSample)
+{
+	return MetadataQueue.Fetch(TimeRange, OutSample);
+}
+
 bool FDirectShowMediaTracks::FetchAudio(TRange<FTimespan> TimeRange, TSharedPtr<IMediaAudioSample, ESPMode::ThreadSafe>& OutSample)
 {
 	TSharedPtr<IMediaAudioSample, ESPMode::ThreadSafe> Sample;
 
 	if (!AudioSampleQueue.Peek(Sample))
 	{
+		// count every starved stretch once, as soon as more than a device buffer went by without audio
+		const double Now = FPlatformTime::Seconds();
+
+		if (!bAudioStarved && (CurrentState == EMediaState::Playing) && (LastAudioFetchTime > 0.0) &&
+			((Now - LastAudioFetchTime) * 1000.0 > 1.5 * AudioBufferController.GetBufferMs()))
+		{
+			bAudioStarved = true;
+			AudioBufferController.AddUnderrun();
+		}
+
 		return false;
 	}
 
@@ -485,6 +1004,9 @@ bool FDirectShowMediaTracks::FetchAudio(TRange<FTimespan> TimeRange, TSharedPtr<
 		return false;
 	}
 
+	LastAudioFetchTime = FPlatformTime::Seconds();
+	bAudioStarved = false;
+
 	OutSample = Sample;
 
 	return true;
@@ -492,28 +1014,31 @@ bool FDirectShowMediaTracks::FetchAudio(TRange<FTimespan> TimeRange, TSharedPtr<
 
 bool FDirectShowMediaTracks::FetchVideo(TRange<FTimespan> TimeRange, TSharedPtr<IMediaTextureSample, ESPMode::ThreadSafe>& OutSample)
 {
-	TSharedPtr<IMediaTextureSample, ESPMode::ThreadSafe> Sample;
+	bool bFetched = false;
 
-	if (!VideoSampleQueue.Peek(Sample))
+	// genlocked playback shows the frame captured for the engine's timecode
+	if (bVideoTimecodeLookup)
 	{
-		return false;
+		bFetched = VideoTimecodeTarget.IsSet() ? VideoTimecodeIndex.Fetch(VideoTimecodeTarget.GetValue(), OutSample) : VideoTimecodeIndex.FetchNewest(OutSample);
 	}
-
-	const FTimespan SampleTime = Sample->GetTime().Time;
-	
-	if (!TimeRange.Overlaps(TRange<FTimespan>(SampleTime, SampleTime + Sample->GetDuration())))
+	// the newest frame is always the right one in mailbox mode
+	else if (bVideoMailboxMode || bVideoBudgetMailbox)
 	{
-		return false;
+		bFetched = VideoMailbox.Fetch(OutSample);
+	}
+	// skips frames that went stale while the game thread wasn't fetching
+	else
+	{
+		bFetched = VideoSampleWindow.FetchBest(TimeRange, OutSample);
 	}
 
-	if (!VideoSampleQueue.Dequeue(Sample))
+	// every video sample of the player is a texture sample
+	if (bFetched && FDirectShowMediaFrameTracer::IsEnabled())
 	{
-		return false;
+		FDirectShowMediaFrameTracer::Mark(EDirectShowMediaFrameEvent::Dequeue, static_cast<FDirectShowMediaTextureSample*>(OutSample.Get())->GetTraceFlow());
 	}
-	
-	OutSample = Sample;
 
-	return true;
+	return bFetched;
 }
 
 
@@ -522,19 +1047,27 @@ void FDirectShowMediaTracks::FlushSamples()
 	UE_LOG(LogDirectShowMedia, VeryVerbose, TEXT("FDirectShowMediaTracks::FlushSamples"));
 	AudioSampleQueue.RequestFlush();
 	CaptionSampleQueue.RequestFlush();
-	MetadataSampleQueue.RequestFlush();
-	VideoSampleQueue.RequestFlush();
+	MetadataQueue.Flush();
+	VideoSampleWindow.Flush();
+	VideoMailbox.Flush();
+	VideoTimecodeIndex.Flush();
+	VideoCaptureWorker.Flush();
 }
 
 
 bool FDirectShowMediaTracks::PeekVideoSampleTime(FMediaTimeStamp & TimeStamp)
 {
-	TSharedPtr<IMediaTextureSample, ESPMode::ThreadSafe> Sample;
-	if (!VideoSampleQueue.Peek(Sample))
+	if (bVideoMailboxMode || bVideoBudgetMailbox || bVideoTimecodeLookup)
 	{
 		return false;
 	}
-	TimeStamp = FMediaTimeStamp(Sample->GetTime());
+
+	FTimespan SampleTime;
+	if (!VideoSampleWindow.PeekTime(SampleTime))
+	{
+		return false;
+	}
+	TimeStamp = FMediaTimeStamp(SampleTime);
 	return true;
 }
 
@@ -906,6 +1439,8 @@ bool FDirectShowMediaTracks::SelectTrack(EMediaTrackType TrackType, int32 TrackI
 
 		return false;
 	}
+
+	*SelectedTrack = TrackIndex;
 	
 
 	return true;
@@ -913,6 +1448,25 @@ bool FDirectShowMediaTracks::SelectTrack(EMediaTrackType TrackType, int32 TrackI
 
 
 bool FDirectShowMediaTracks::SetTrackFormat(EMediaTrackType TrackType, int32 TrackIndex, int32 FormatIndex)
+{
+	if (!SelectTrackFormat(TrackType, TrackIndex, FormatIndex))
+	{
+		return false;
+	}
+
+	// the capture memory budget reduces the resolution relative to the format chosen here
+	if (TrackType == EMediaTrackType::Video)
+	{
+		FScopeLock Lock(&CriticalSection);
+		VideoPreferredFormat = FormatIndex;
+		VideoRejectedFormat = INDEX_NONE;
+	}
+
+	return true;
+}
+
+
+bool FDirectShowMediaTracks::SelectTrackFormat(EMediaTrackType TrackType, int32 TrackIndex, int32 FormatIndex)
 {
 	UE_LOG(LogDirectShowMedia, Verbose, TEXT("Tracks %p: Setting format on %s track %i to %i"), this, *MediaUtils::TrackTypeToString(TrackType), TrackIndex, FormatIndex);
 	if (!CurrentVideoDevice)
@@ -971,7 +1525,9 @@ bool FDirectShowMediaTracks::SetTrackFormat(EMediaTrackType TrackType, int32 Tra
 
 	{
 		FScopeLock Lock(&CriticalSection);
-		VideoSampleQueue.RequestFlush();
+		VideoSampleWindow.Flush();
+		VideoTimecodeIndex.Flush();
+		VideoCaptureWorker.Flush();
 		AudioSampleQueue.RequestFlush();
 	}
 
@@ -1200,6 +1756,84 @@ const FDShowFormat* FDirectShowMediaTracks::GetVideoFormat(int32 TrackIndex, int
 }
 
 
+void FDirectShowMediaTracks::UpdateVideoMemoryDemand()
+{
+	FDirectShowMediaMemoryDemand Demand;
+
+	const FDShowTrack* Track = VideoTracks.IsValidIndex(SelectedVideoTrack) ? &VideoTracks[SelectedVideoTrack] : nullptr;
+
+	if ((Track != nullptr) && Track->Formats.IsValidIndex(Track->SelectedFormat) && VideoLayout.IsValid())
+	{
+		if (!Track->Formats.IsValidIndex(VideoPreferredFormat))
+		{
+			VideoPreferredFormat = Track->SelectedFormat;
+		}
+
+		VideoReducedFormat = DirectShowMediaTracks::FindReducedVideoFormat(*Track, VideoPreferredFormat);
+
+		// frames scale with the pixel count, and the current format may be the reduced one
+		const FIntPoint& CurrentDim = Track->Formats[Track->SelectedFormat].Video.OutputDim;
+		const double BytesPerPixel = (double)VideoLayout.GetFrameSize() / FMath::Max<int64>(1, (int64)CurrentDim.X * CurrentDim.Y);
+
+		auto GetFrameBytes = [Track, BytesPerPixel](int32 FormatIndex)
+		{
+			const FIntPoint& Dim = Track->Formats[FormatIndex].Video.OutputDim;
+			return (uint64)(BytesPerPixel * Dim.X * Dim.Y);
+		};
+
+		Demand.FrameBytes = GetFrameBytes(VideoPreferredFormat);
+		Demand.ReducedFrameBytes = (VideoReducedFormat != INDEX_NONE) ? GetFrameBytes(VideoReducedFormat) : 0;
+		Demand.QueueDepth = bVideoMailboxMode ? 1 : FMediaPlayerQueueDepths::MaxVideoSinkDepth;
+		Demand.MinQueueDepth = bVideoTimecodeLookup ? Demand.QueueDepth : FMath::Min(Demand.QueueDepth, DirectShowMediaTracks::MinVideoQueueDepth);
+		Demand.bCanUseMailbox = !bVideoTimecodeLookup;
+	}
+
+	FDirectShowMediaMemoryBudget::Get().SetDemand(VideoMemoryAccount, Demand);
+}
+
+
+void FDirectShowMediaTracks::ApplyVideoMemoryLevel(EDirectShowMediaMemoryLevel Level)
+{
+	VideoMemoryLevel = Level;
+
+	// resizing drops the queued frames, which only happens when the budget changes
+	const int32 QueueDepth = (Level >= EDirectShowMediaMemoryLevel::ShrinkQueue) ? DirectShowMediaTracks::MinVideoQueueDepth : FMediaPlayerQueueDepths::MaxVideoSinkDepth;
+
+	if (VideoSampleWindow.GetCapacity() != QueueDepth)
+	{
+		VideoSampleWindow.SetCapacity(QueueDepth);
+	}
+
+	// timecode lookup needs its history, it only degrades in resolution
+	const bool bMailbox = (Level >= EDirectShowMediaMemoryLevel::Mailbox) && !bVideoTimecodeLookup;
+
+	// this runs on the producer side, the mailbox's consumer side belongs to FetchVideo
+	if (bMailbox != bVideoBudgetMailbox)
+	{
+		VideoSampleWindow.Flush();
+		VideoMailbox.Retract();
+		bVideoBudgetMailbox = bMailbox;
+	}
+
+	UE_LOG(LogDirectShowMedia, Verbose, TEXT("Tracks: %p: Capture memory budget level %s, %llu bytes committed"), this, DirectShowMediaTracks::GetMemoryLevelName(Level), VideoMemoryAccount.GetCommittedBytes());
+}
+
+
+void FDirectShowMediaTracks::PinVideoStreamingThread()
+{
+	// the graph may hand its streaming thread over after a format change
+	const uint32 ThreadId = FPlatformTLS::GetCurrentThreadId();
+
+	if (ThreadId != VideoPinnedThreadId)
+	{
+		FPlatformProcess::SetThreadAffinityMask(FDirectShowMediaTopology::Get().GetCoreMask(VideoPlacement.Node));
+		VideoPinnedThreadId = ThreadId;
+
+		UE_LOG(LogDirectShowMedia, Verbose, TEXT("Tracks: %p: Pinned streaming thread %u to NUMA node %d"), this, ThreadId, VideoPlacement.Node);
+	}
+}
+
+
 /* FDirectShowMediaTracks callbacks
  *****************************************************************************/
 
@@ -1213,7 +1847,7 @@ void FDirectShowMediaTracks::HandleMediaSamplerClock(EDirectShowMediaSamplerCloc
 
 
 
-void FDirectShowMediaTracks::HandleMediaSamplerCaptionSample(const uint8* Buffer, uint32 Size, FTimespan inDuration, FTimespan Time)
+void FDirectShowMediaTracks::HandleMediaSamplerCaptionSample(EDirectShowMediaCaptionFormat Format, const uint8* Buffer, uint32 Size, FTimespan inDuration, FTimespan Time)
 {
 	if (Buffer == nullptr)
 	{
@@ -1227,19 +1861,22 @@ void FDirectShowMediaTracks::HandleMediaSamplerCaptionSample(const uint8* Buffer
 		return; // invalid track index
 	}
 
-	if (CaptionSampleQueue.Num() >= FMediaPlayerQueueDepths::MaxCaptionSinkDepth)
+	// decode even if the queue is full, 608/708 state spans samples
+	CaptionDecoder.Decode(Format, Buffer, Size, [&](const TCHAR* Text, int32 Length)
 	{
-		return;
-	}
+		if (CaptionSampleQueue.Num() >= FMediaPlayerQueueDepths::MaxCaptionSinkDepth)
+		{
+			return;
+		}
 
-	// create & add sample to queue
-	const FDShowTrack& Track = CaptionTracks[SelectedCaptionTrack];
-	const auto CaptionSample = MakeShared<FDirectShowMediaOverlaySample, ESPMode::ThreadSafe>();
+		// create & add sample to queue
+		const TSharedRef<FDirectShowMediaOverlaySample, ESPMode::ThreadSafe> CaptionSample = CaptionSamplePool->AcquireShared();
 
-	if (CaptionSample->Initialize((char*)Buffer, Time, inDuration))
-	{
-		CaptionSampleQueue.Enqueue(CaptionSample);
-	}
+		if (CaptionSample->Initialize(Text, Length, Time, inDuration))
+		{
+			CaptionSampleQueue.Enqueue(CaptionSample);
+		}
+	});
 }
 
 
@@ -1257,7 +1894,7 @@ void FDirectShowMediaTracks::HandleMediaSamplerMetadataSample(const uint8* Buffe
 		return; // invalid track index
 	}
 
-	if (MetadataSampleQueue.Num() >= FMediaPlayerQueueDepths::MaxMetadataSinkDepth)
+	if (MetadataQueue.Num() >= FMediaPlayerQueueDepths::MaxMetadataSinkDepth)
 	{
 		return;
 	}
@@ -1268,13 +1905,13 @@ void FDirectShowMediaTracks::HandleMediaSamplerMetadataSample(const uint8* Buffe
 
 	if (BinarySample->Initialize(Buffer, Size, Time, inDuration))
 	{
-		MetadataSampleQueue.Enqueue(BinarySample);
+		MetadataQueue.Add(BinarySample);
 	}
 }
 
 void FDirectShowMediaTracks::HandleMediaSamplerAudioSample(double Time, IMediaSample* Sample)
 {
-	if (!Sample || !CurrentVideoDevice || !CurrentVideoDevice->bIsInitialized || CurrentState == EMediaState::Stopped)
+	if (!Sample || !CurrentVideoDevice || !CurrentVideoDevice->bIsInitialized || CurrentState == EMediaState::Stopped || bVideoFormatSwitching)
 	{
 		return;
 	}
@@ -1286,50 +1923,56 @@ void FDirectShowMediaTracks::HandleMediaSamplerAudioSample(double Time, IMediaSa
 	
 	long Size = Sample->GetActualDataLength();
 
-	REFERENCE_TIME start, stop;
- // duration in 100-nanosecond units
-	hr = Sample->GetTime(&start, &stop);
-	if (hr != S_OK) {
-		return;
-	}
-	float diff = (float) (stop - start) / 10000000.0f;
-	FTimespan durationTimespan = FTimespan(diff * ETimespan::TicksPerSecond);
-
 	FScopeLock Lock(&CriticalSection);
+
+	// stamp the buffer on the video timeline, correcting for the audio device's clock drift;
+	// every buffer has to go through the loop, even the ones that get dropped below
+	const uint32 NumChannels = CurrentVideoDevice->GetNumChannels();
+	const uint32 SampleRate = CurrentVideoDevice->GetSampleRate();
+	const uint32 FrameSize = NumChannels * CurrentVideoDevice->GetBitsPerSample() / 8;
+	const uint32 NumFrames = (FrameSize > 0) ? (uint32)Size / FrameSize : 0;
+
+	FTimespan inTime;
+	FTimespan inDuration;
+	AudioSync.ProcessAudio(Time, NumFrames, SampleRate, inTime, inDuration);
+
+	const double Now = FPlatformTime::Seconds();
+
+	if (SampleRate > 0)
+	{
+		AudioBufferController.AddCallback(Now, (double)NumFrames / SampleRate);
+	}
 	
-	if (AudioSampleQueue.Num() >= 1)
+	// convert to float at the engine's rate here instead of on the game thread; dropped buffers still
+	// have to go through the converter to keep its filter history contiguous
+	if (!AudioConverter.Configure(CurrentVideoDevice->GetCurrentAudioSampleFormat(), CurrentVideoDevice->GetBitsPerSample(), NumChannels, SampleRate, AudioOutputChannels, AudioOutputSampleRate))
 	{
-		AudioSampleQueue.RequestFlush();
-		
 		return;
 	}
 
-	long long startTime, stopTime;
-	hr = Sample->GetTime(&startTime, &stopTime);
-	if(hr != S_OK)
-		return;
-	
-	FTimespan startTimespan(startTime);
-	FTimespan stopTimespan(stopTime);
-	FTimespan duration = stopTimespan - startTimespan;
-	
-	// UE_LOG(LogDirectShowMedia, Warning, TEXT("Audio cbTime: %f startTime: %s, stopTime: %s, Duraition: %s"),Time, *startTimespan.ToString(), *stopTimespan.ToString(), *duration.ToString())
-
-	// create & add sample to queue
 	const TSharedRef<FDirectShowMediaAudioSample, ESPMode::ThreadSafe> AudioSample = AudioSamplePool->AcquireShared();
 
+	if (!AudioSample->Initialize(AudioConverter, pBuffer, Size, inTime - AudioConverter.GetLatency(), inDuration))
+	{
+		return;
+	}
 	
-	// TODO: finish this
-	if (AudioSample->Initialize(pBuffer, Size, CurrentVideoDevice->GetNumChannels(), CurrentVideoDevice->GetSampleRate(), CurrentVideoDevice->GetCurrentAudioSampleFormat(), Time, durationTimespan))
+	// keep as many buffers queued as the measured jitter calls for, drop the backlog beyond that
+	if (AudioSampleQueue.Num() >= AudioBufferController.GetJitterBufferDepth(Now))
 	{
-		AudioSampleQueue.Enqueue(AudioSample);
+		AudioSampleQueue.RequestFlush();
 		
+		return;
 	}
+
+	AudioSampleQueue.Enqueue(AudioSample);
 }
 
 void FDirectShowMediaTracks::HandleMediaSamplerVideoSample(double Time, IMediaSample* Sample)
 {
-	if (!Sample || !CurrentVideoDevice|| !CurrentVideoDevice->bIsInitialized || CurrentState == EMediaState::Stopped)
+	FDirectShowMediaFrameTraceScope HandleTrace(EDirectShowMediaFrameEvent::Handle);
+
+	if (!Sample || !CurrentVideoDevice|| !CurrentVideoDevice->bIsInitialized || CurrentState == EMediaState::Stopped || bVideoFormatSwitching)
 		return;
 	
 	BYTE* pBuffer = nullptr;
@@ -1340,79 +1983,79 @@ void FDirectShowMediaTracks::HandleMediaSamplerVideoSample(double Time, IMediaSa
 	long Size = Sample->GetActualDataLength();
 	void* inBuffer = pBuffer;		
 	
-	// DirectShow doesn't report durations for some formats
-	if (Duration.IsZero())
+	// the layout is resolved once per negotiated format, not per frame
+	const uint32 FormatSerial = CurrentVideoDevice->GetFormatSerial();
+
+	if (FormatSerial != VideoFormatSerial)
 	{
-		float FrameRate = CurrentVideoDevice->GetFramerate();
-		if (FrameRate <= 0.0f)
+		VideoFormatSerial = FormatSerial;
+
+		// YUV samples carry the device's colorimetry
+		VideoColorConverter.Configure(CurrentVideoDevice->GetColorimetry());
+		VideoLayout.Resolve(CurrentVideoDevice->GetSampleSubtype(), CurrentVideoDevice->GetTextureSize(), CurrentVideoDevice->GetSamplePitch(), CurrentVideoDevice->GetFramerate(), VideoColorConverter, bVideoAcceptPlanar, bVideoConvertTo8Bit, bVideoConvertToBGRA, bVideoFlipVertically, VideoRowAlignment);
+
+		if (Duration.IsZero())
 		{
-			FrameRate = 30.0f;
+			Duration = VideoLayout.GetFrameDuration();
 		}
-	
-		Duration = FTimespan((int64)((float)ETimespan::TicksPerSecond / FrameRate));
-	}
-	
-	FIntPoint Dim;
-	uint32 Stride = 0;
-	EMediaTextureSampleFormat Format;
-	FIntPoint Resolution =  CurrentVideoDevice->GetTextureSize();
-	GUID subtype = CurrentVideoDevice->GetCurrentSubtype();
-	
-	
-	// Handle decoding of compressed formats (e.g. MJPG)
-	if(subtype == MEDIASUBTYPE_MJPG)
-	{			
-		Dim = Resolution;
-		Stride = Resolution.X * 4;
-		Format = EMediaTextureSampleFormat::CharBGRA;
 
-	}
-	else if(subtype == MEDIASUBTYPE_NV12)
-	{
-		Dim = FIntPoint(Resolution.X, Resolution.Y * 3 / 2);
-		Stride = Resolution.X;
-		Format = EMediaTextureSampleFormat::CharNV12;
-	}
-	else if (subtype == MEDIASUBTYPE_RGB32 || subtype == MEDIASUBTYPE_ARGB32)
-	{
-		Dim = Resolution;
-		Stride = Resolution.X * 4;
-		Format = EMediaTextureSampleFormat::CharBGRA;
-	}
-	else if (subtype == MEDIASUBTYPE_UYVY)
-	{
-		Dim = FIntPoint(Resolution.X / 2, Resolution.Y);
-		Stride = Resolution.X * 2;
-		Format = EMediaTextureSampleFormat::CharUYVY;
-	}
-	else if (subtype == MEDIASUBTYPE_H264)
-	{
-		Dim = Resolution;
-		Stride = Resolution.X * 4;
-		Format = EMediaTextureSampleFormat::CharBGRA;
-	}
-	else if (subtype == MEDIASUBTYPE_YUY2)
-	{
-		int32 AlignedOutputX = Resolution.X;
+		// samples of the previous format keep their ring until they are released
+		TSharedPtr<FDirectShowMediaUploadRing, ESPMode::ThreadSafe> UploadRing;
+
+		if (bVideoDirectUpload && VideoLayout.IsValid())
+		{
+			UploadRing = FDirectShowMediaUploadRing::Create(MakeUnique<FDirectShowMediaRHIUploadBackend>(), VideoUploadSlots, VideoLayout.GetDim(), VideoLayout.GetFormat());
+		}
+
+		VideoLayout.SetUploadRing(UploadRing);
+
+		// one region for all frames of the format, allocated before the first frame is copied
+		TSharedPtr<FDirectShowMediaFrameArena, ESPMode::ThreadSafe> FrameArena;
+
+		if (bVideoFrameArena && VideoLayout.IsCopied())
+		{
+			FrameArena = FDirectShowMediaFrameArena::Create(VideoLayout.GetFrameSize(), VideoFrameArenaSlots, true, VideoPlacement.Node);
 
-		int32 SampleStride = AlignedOutputX * 2; // 2 bytes per pixel
+			if (FrameArena.IsValid())
+			{
+				UE_LOG(LogDirectShowMedia, Verbose, TEXT("Tracks: %p: Frame arena of %d slots of %llu bytes on %s, NUMA node %d"), this, FrameArena->GetNumSlots(), FrameArena->GetSlotSize(), DirectShowMediaTracks::GetFramePagesName(FrameArena->GetPages()), FrameArena->GetNode());
+			}
+		}
+
+		VideoLayout.SetFrameArena(FrameArena);
 
-		if (SampleStride < 0)
+		// plane views hold capture buffers, the device must keep one to capture into
+		VideoLayout.SetCaptureBuffers(CurrentVideoDevice->GetSampleBufferCount());
+
+		if (VideoLayout.GetMaxPlanarViews() != INDEX_NONE)
 		{
-			SampleStride = -SampleStride;
+			UE_LOG(LogDirectShowMedia, Verbose, TEXT("Tracks: %p: Up to %d frames are viewed in the capture buffers, the others copied"), this, VideoLayout.GetMaxPlanarViews());
 		}
-		
-		Dim = FIntPoint(AlignedOutputX / 2, Resolution.Y);
-		Stride = SampleStride;
-		Format = EMediaTextureSampleFormat::CharYUY2;
+
+		FScopeLock Lock(&CriticalSection);
+		VideoUploadRing = UploadRing;
+		VideoFrameArena = FrameArena;
+		UpdateVideoMemoryDemand();
 	}
-	else
+
+	if (!VideoLayout.IsValid())
 	{
 		// Don't process any unsupported formats, unexpected bahaviors can come
 		return;
 	}
-	
-	FTimespan inTime(ETimespan::TicksPerSecond * Time);
+
+	const uint64 FrameNumber = VideoFrameNumber++;
+	const uint64 TraceFlow = FDirectShowMediaFrameTracer::MakeFlow(VideoTraceTrack, FrameNumber);
+
+	HandleTrace.SetFlow(TraceFlow);
+
+	// drop frames the consumer doesn't want before paying for the copy
+	FTimespan inTime;
+	FTimespan inDuration;
+	if (!VideoDecimator.Accept(FTimespan(ETimespan::TicksPerSecond * Time), Duration, inTime, inDuration))
+	{
+		return;
+	}
 
 	long long startTime, stopTime;
 	hr = Sample->GetTime(&startTime, &stopTime);
@@ -1422,33 +2065,93 @@ void FDirectShowMediaTracks::HandleMediaSamplerVideoSample(double Time, IMediaSa
 	 FTimespan startTimespan(startTime);
 	 FTimespan stopTimespan(stopTime);
 	 FTimespan duration = stopTimespan - startTimespan;
+
+	// side data travels with the frame, and as a metadata sample while the metadata track is selected
+	FDirectShowMediaFrameMetadata FrameMetadata;
+	FrameMetadata.Flags = EDirectShowMediaFrameMetadataFlags::DeviceTime;
+	FrameMetadata.FrameNumber = FrameNumber;
+	FrameMetadata.DeviceStartTime = startTime;
+	FrameMetadata.DeviceStopTime = stopTime;
+
+	if (Sample->GetMediaTime(&FrameMetadata.MediaStartTime, &FrameMetadata.MediaStopTime) == S_OK)
+	{
+		FrameMetadata.Flags |= EDirectShowMediaFrameMetadataFlags::MediaTime;
+	}
+
+	if (Sample->IsDiscontinuity() == S_OK)
+	{
+		FrameMetadata.Flags |= EDirectShowMediaFrameMetadataFlags::Discontinuity;
+	}
+
+	CurrentVideoDevice->GetFrameSideData(FrameMetadata);
+
+	// timecode from the device's input if it reads one, otherwise from the normalized clock
+	FTimecode SampleTimecode;
+	FFrameRate TimecodeRate;
+
+	if (!FDirectShowMediaTimecode::FromFrameMetadata(FrameMetadata, SampleTimecode, TimecodeRate))
+	{
+		TimecodeRate = VideoLayout.GetFrameRate();
+		SampleTimecode = FDirectShowMediaTimecode::FromTime(inTime, TimecodeRate);
+	}
 	
 	// UE_LOG(LogDirectShowMedia, Warning, TEXT("Video cbTime: %f startTime: %s, stopTime: %s, Duraition: %s"),Time, *startTimespan.ToString(), *stopTimespan.ToString(), *duration.ToString())
 	
 	//UE_LOG(LogDirectShowMedia, Warning, TEXT("Handle incoming sample:\nstartTime: %s    EndTime: %s    Duration: %s\nResolution:%s\nSize: %d\nDim: %s\nStride: %d\n %d * %d > %d\nType: %s"), *startTimespan.ToString(), *stopTimespan.ToString(), *duration.ToString(), *Resolution.ToString(), Size, *Dim.ToString(), Stride, Stride, Dim.Y, Size, *CurrentVideoDevice->GetFormatTypeFromGUID(subtype))
 	
+	const uint64 LockWaitStart = FDirectShowMediaFrameTracer::IsEnabled() ? FDirectShowMediaFrameTracer::Now() : 0;
+
 	FScopeLock Lock(&CriticalSection);
 
+	if (LockWaitStart != 0)
+	{
+		FDirectShowMediaFrameTracer::Get().Record(EDirectShowMediaFrameEvent::LockWait, LockWaitStart, FDirectShowMediaFrameTracer::Now(), TraceFlow);
+	}
+
 	CurrentTime = FTimespan((int64)((float)ETimespan::TicksPerSecond * Time));
-	
-	if(VideoSampleQueue.Num() >= FMediaPlayerQueueDepths::MaxVideoSinkDepth)
+
+	// the budget reassigns levels whenever any player's demand changes
+	const EDirectShowMediaMemoryLevel MemoryLevel = VideoMemoryAccount.GetLevel();
+
+	if (MemoryLevel != VideoMemoryLevel)
 	{
-		VideoSampleQueue.RequestFlush();
-		return;
+		ApplyVideoMemoryLevel(MemoryLevel);
 	}
 	
 	const TSharedRef<FDirectShowMediaTextureSample, ESPMode::ThreadSafe> TextureSample = VideoSamplePool->AcquireShared();
-	if (TextureSample->Initialize(
-		inBuffer,
-		Size,
-		Dim,
-		Resolution,
-		Format,
-		Stride,
-		inTime, 
-		Duration))
-	{
-		VideoSampleQueue.Enqueue(TextureSample);
+	bool bInitialized = false;
+	{
+		FDirectShowMediaFrameTraceScope CopyTrace(EDirectShowMediaFrameEvent::Copy, TraceFlow);
+		bInitialized = VideoLayout.InitializeSample(*TextureSample, Sample, inBuffer, Size, inTime, inDuration);
+	}
+
+	if (bInitialized)
+	{
+		TextureSample->SetTraceFlow(TraceFlow);
+		TextureSample->SetColorimetry(VideoColorConverter);
+		TextureSample->SetFrameMetadata(FrameMetadata);
+		TextureSample->SetTimecode(SampleTimecode);
+
+		if (MetadataTracks.IsValidIndex(SelectedMetadataTrack))
+		{
+			MetadataQueue.Add(FrameMetadata, inTime, inDuration);
+		}
+
+		// marked before the sample is published, so the consumer's events always follow it
+		FDirectShowMediaFrameTracer::Mark(EDirectShowMediaFrameEvent::Enqueue, TraceFlow);
+
+		if (bVideoTimecodeLookup)
+		{
+			VideoTimecodeIndex.Add(SampleTimecode, TimecodeRate, TextureSample);
+		}
+		else if (bVideoMailboxMode || bVideoBudgetMailbox)
+		{
+			VideoMailbox.Publish(TextureSample);
+		}
+		else
+		{
+			VideoSampleWindow.Add(TextureSample);
+		}
 	} 	
 }
 
@@ -2,6 +2,7 @@
 
 #pragma once
 
+#include <atomic>
 #include <dsound.h>
 
 #include "CoreTypes.h"
@@ -15,6 +16,20 @@
 #include "MediaSampleQueue.h"
 #include "Microsoft/COMPointer.h"
 #include "Templates/SharedPointer.h"
+#include "DirectShowMediaAudioBufferController.h"
+#include "DirectShowMediaAudioConverter.h"
+#include "DirectShowMediaAVSync.h"
+#include "DirectShowMediaCaptureWorker.h"
+#include "DirectShowMediaCaptionDecoder.h"
+#include "DirectShowMediaColorConverter.h"
+#include "DirectShowMediaFrameDecimator.h"
+#include "DirectShowMediaMailbox.h"
+#include "DirectShowMediaMemoryBudget.h"
+#include "DirectShowMediaMetadataQueue.h"
+#include "DirectShowMediaSampleWindow.h"
+#include "DirectShowMediaTimecodeIndex.h"
+#include "DirectShowMediaTopology.h"
+#include "DirectShowMediaVideoLayout.h"
   #include "Windows/AllowWindowsPlatformTypes.h"
   #include "Windows/WindowsHWrapper.h"
   #include "Windows/HideWindowsPlatformTypes.h"
@@ -23,6 +38,7 @@ class FDirectShowVideoDevice;
 class FDirectShowAudioDevice;
 enum class EMediaEvent;
 class FDirectShowMediaAudioSamplePool;
+class FDirectShowMediaOverlaySamplePool;
 class FDirectShowMediaSampler;
 class FDirectShowMediaTextureSamplePool;
 class IMediaAudioSample;
@@ -151,6 +167,41 @@ public:
 	*
 	*/
 	void TickInput(FTimespan DeltaTime, FTimespan Timecode);
+
+	/**
+	 * Check whether the device audio buffer should be resized (game thread).
+	 *
+	 * @param OutBufferMs Will contain the new buffer size (in milliseconds).
+	 * @return true if RenegotiateAudioBuffer should be called, false otherwise.
+	 */
+	bool ShouldRenegotiateAudioBuffer(float& OutBufferMs);
+
+	/**
+	 * Resize the device audio buffer. Restarts the graph, so don't call it on the game thread.
+	 *
+	 * @param BufferMs The new buffer size (in milliseconds).
+	 */
+	void RenegotiateAudioBuffer(float BufferMs);
+
+	/**
+	 * Check whether the video format should change for the capture memory budget (game thread).
+	 *
+	 * @param OutFormatIndex Will contain the format to select.
+	 * @return true if ApplyVideoFormatBudget should be called, false otherwise.
+	 */
+	bool ShouldChangeVideoFormat(int32& OutFormatIndex);
+
+	/**
+	 * Select a video format for the capture memory budget, keeping the format chosen through SetTrackFormat
+	 * to return to. Rebuilds the graph, so don't call it on the game thread.
+	 *
+	 * If the device can't be set to the format, the current format is restored and the format isn't
+	 * tried again until the next open or SetTrackFormat.
+	 *
+	 * @param FormatIndex The format to select.
+	 * @return true on success, false otherwise.
+	 */
+	bool ApplyVideoFormatBudget(int32 FormatIndex);
 public:
 
 	//~ IMediaSamples interface
@@ -225,6 +276,30 @@ private:
 	FDShowFormat* GetVideoFormat(int32 TrackIndex, int32 FormatIndex);
 	const FDShowFormat* GetVideoFormat(int32 TrackIndex, int32 FormatIndex) const;
 
+	/**
+	 * Switch a track to the specified format.
+	 *
+	 * @param TrackType The type of track.
+	 * @param TrackIndex Index of the track.
+	 * @param FormatIndex Index of the format to select.
+	 * @return true on success, false otherwise.
+	 * @see SetTrackFormat
+	 */
+	bool SelectTrackFormat(EMediaTrackType TrackType, int32 TrackIndex, int32 FormatIndex);
+
+	/** Report the memory the video queue needs to the capture memory budget (streaming thread, sample lock held). */
+	void UpdateVideoMemoryDemand();
+
+	/**
+	 * Resize the video queue for a capture memory budget level (streaming thread, sample lock held).
+	 *
+	 * @param Level The level assigned by the budget.
+	 */
+	void ApplyVideoMemoryLevel(EDirectShowMediaMemoryLevel Level);
+
+	/** Pin the calling DirectShow streaming thread to the cores of the video placement's node, once per thread (streaming thread). */
+	void PinVideoStreamingThread();
+
 private:
 
 	/** Callback for handling media sampler pauses. */
@@ -233,8 +308,16 @@ private:
 	/** Callback for handling new samples from the streams' media sample buffers. */
 	void HandleMediaSamplerAudioSample(double Time, IMediaSample* Sample);
 
-	/** Callback for handling new caption samples. */
-	void HandleMediaSamplerCaptionSample(const uint8* Buffer, uint32 Size, FTimespan inDuration, FTimespan Time);
+	/**
+	 * Callback for handling new caption samples.
+	 *
+	 * The data is decoded as it arrives, and a caption sample is queued for every caption it completes.
+	 *
+	 * Nothing calls this yet: no closed caption pin (MEDIASUBTYPE_Line21_BytePair or a VBI pin) is connected
+	 * into the graph and no caption track is listed, so captured captions are not delivered. It is the entry
+	 * point for such a pin's sample callback.
+	 */
+	void HandleMediaSamplerCaptionSample(EDirectShowMediaCaptionFormat Format, const uint8* Buffer, uint32 Size, FTimespan inDuration, FTimespan Time);
 
 	/** Callback for handling new metadata samples. */
 	void HandleMediaSamplerMetadataSample(const uint8* Buffer, uint32 Size, FTimespan inDuration, FTimespan Time);
@@ -276,17 +359,146 @@ private:
 	/** Audio sample queue. */
 	TMediaSampleQueue<IMediaAudioSample> AudioSampleQueue;
 
+	/** Locks audio sample times to the video timeline. */
+	FDirectShowMediaAVSync AudioSync;
+
+	/** Converts device audio to float at the output rate. */
+	FDirectShowMediaAudioConverter AudioConverter;
+
+	/** Requested audio output sample rate (zero keeps the device rate). */
+	uint32 AudioOutputSampleRate;
+
+	/** Requested number of audio output channels (zero keeps the device layout). */
+	uint32 AudioOutputChannels;
+
+	/** Sizes the device audio buffer and our queue depth from measured jitter and underruns. */
+	FDirectShowMediaAudioBufferController AudioBufferController;
+
+	/** Wall clock time of the last audio sample handed to the consumer. */
+	double LastAudioFetchTime;
+
+	/** Whether the consumer is currently starved of audio (consumer thread). */
+	bool bAudioStarved;
+
+	/** Whether a buffer renegotiation has been requested and not finished yet. */
+	FThreadSafeBool bAudioRenegotiationPending = false;
+
+	/** Decodes caption data into caption text. */
+	FDirectShowMediaCaptionDecoder CaptionDecoder;
+
+	/** Caption sample object pool. */
+	FDirectShowMediaOverlaySamplePool* CaptionSamplePool;
+
 	/** Overlay sample queue. */
 	TMediaSampleQueue<IMediaOverlaySample> CaptionSampleQueue;
 
-	/** Metadata sample queue. */
-	TMediaSampleQueue<IMediaBinarySample> MetadataSampleQueue;
+	/** Metadata samples waiting to be fetched, frame side data in pooled samples. */
+	FDirectShowMediaMetadataQueue MetadataQueue;
 	
 	/** Video sample object pool. */
 	FDirectShowMediaTextureSamplePool* VideoSamplePool;
 
-	/** Video sample queue. */
-	TMediaSampleQueue<IMediaTextureSample> VideoSampleQueue;
+	/** Video samples, sorted by presentation time. */
+	TDirectShowMediaSampleWindow<IMediaTextureSample> VideoSampleWindow;
+
+	/** Latest video sample, used instead of the sample window in mailbox mode. */
+	TDirectShowMediaMailbox<IMediaTextureSample> VideoMailbox;
+
+	/** Whether FetchVideo always returns the newest frame (VideoMailboxMode media option). */
+	bool bVideoMailboxMode;
+
+	/** Tags video samples with the device's colorimetry, and converts YUV to BGRA if requested. */
+	FDirectShowMediaColorConverter VideoColorConverter;
+
+	/** Whether YUV video is converted to BGRA on the CPU (VideoConvertToBGRA media option). */
+	bool bVideoConvertToBGRA;
+
+	/** Whether 10 bit video is reduced to 8 bit instead of going to the engine's 16 bit formats (VideoConvertTo8Bit media option). */
+	bool bVideoConvertTo8Bit;
+
+	/** Whether planar video is delivered as plane views into the capture buffer (VideoAcceptPlanar media option). */
+	bool bVideoAcceptPlanar;
+
+	/** Whether packed video is flipped vertically, i.e. for bottom-up RGB (VideoFlipVertically media option). */
+	bool bVideoFlipVertically;
+
+	/** Alignment of the rows of copied and converted video samples, in bytes (VideoRowAlignment media option). */
+	uint32 VideoRowAlignment;
+
+	/** Layout of the negotiated video format (streaming thread). */
+	FDirectShowMediaVideoLayout VideoLayout;
+
+	/** Format serial of the device the video layout was resolved for. */
+	uint32 VideoFormatSerial;
+
+	/** Number of frames the device delivered since the media was opened. */
+	uint64 VideoFrameNumber;
+
+	/** Tells the frames of this open apart from other opens' and players' in the frame trace. */
+	uint32 VideoTraceTrack;
+
+	/** Video samples by timecode, used instead of the sample window in timecode lookup mode. */
+	TDirectShowMediaTimecodeIndex<IMediaTextureSample> VideoTimecodeIndex;
+
+	/** Whether FetchVideo returns the frame matching the engine's timecode (VideoTimecodeLookup media option). */
+	bool bVideoTimecodeLookup;
+
+	/** The engine's frame time when input was last ticked (game thread). */
+	TOptional<FQualifiedFrameTime> VideoTimecodeTarget;
+
+	/** Handles video samples off the DirectShow streaming thread. */
+	FDirectShowMediaCaptureWorker VideoCaptureWorker;
+
+	/** Whether video samples are posted to the capture worker instead of handled on the streaming thread (VideoCaptureWorker media option). */
+	bool bVideoCaptureWorker;
+
+	/** Node and cores the video capture threads and frame arena are placed on (VideoNumaNode and VideoCaptureWorkerAffinity media options). */
+	FDirectShowMediaPlacement VideoPlacement;
+
+	/** The streaming thread last pinned to the video placement's node (streaming thread). */
+	uint32 VideoPinnedThreadId;
+
+	/** Upload slots the video kernels write frames into, or nullptr if frames go to sample buffers. */
+	TSharedPtr<FDirectShowMediaUploadRing, ESPMode::ThreadSafe> VideoUploadRing;
+
+	/** Whether copied and converted video is written straight into upload memory (VideoDirectUpload media option). */
+	bool bVideoDirectUpload;
+
+	/** Number of upload slots (VideoUploadSlots media option). */
+	int32 VideoUploadSlots;
+
+	/** Region copied and converted video frames are carved from, or nullptr if samples allocate their own. */
+	TSharedPtr<FDirectShowMediaFrameArena, ESPMode::ThreadSafe> VideoFrameArena;
+
+	/** Whether video frames are stored in a frame arena, on large pages if they are enabled (VideoFrameArena media option). */
+	bool bVideoFrameArena;
+
+	/** Number of frames in the frame arena (VideoFrameArenaSlots media option). */
+	int32 VideoFrameArenaSlots;
+
+	/** This player's share of the capture memory budget. */
+	FDirectShowMediaMemoryAccount VideoMemoryAccount;
+
+	/** Budget level applied to the video queue (streaming thread). */
+	EDirectShowMediaMemoryLevel VideoMemoryLevel;
+
+	/** Whether the budget switched the video queue to mailbox mode. */
+	FThreadSafeBool bVideoBudgetMailbox = false;
+
+	/** Whether a budget format switch has been requested and not finished yet. */
+	FThreadSafeBool bVideoFormatChangePending = false;
+
+	/** Whether a budget format switch is rebuilding the graph, the sample handlers drop samples meanwhile. */
+	std::atomic<bool> bVideoFormatSwitching{ false };
+
+	/** The video format chosen through SetTrackFormat (or at open), restored when the budget allows it. */
+	int32 VideoPreferredFormat;
+
+	/** The lower resolution video format selected at the ReduceResolution budget level, or INDEX_NONE. */
+	int32 VideoReducedFormat;
+
+	/** A video format the budget failed to switch to, or INDEX_NONE. */
+	int32 VideoRejectedFormat;
 
 	/** Index of the selected audio track. */
 	int32 SelectedAudioTrack;
@@ -328,11 +540,17 @@ private:
 	FTimespan Duration;
 
 	FTimespan TargetTime;
+
+	/** Drops video frames down to the cadence requested through the VideoDecimationFramerate media option. */
+	FDirectShowMediaFrameDecimator VideoDecimator;
 	
 	FDirectShowVideoDevice* CurrentVideoDevice;
 
 	FThreadSafeBool bShuttingDown = false;
 	FThreadSafeBool bIsInitializing = false;
+
+	/** Keeps the video device alive while a graph restart runs outside of CriticalSection. */
+	FCriticalSection DeviceSection;
 	//FDirectShowAudioDevice* CurrentAudioDevice;
 
 	//AVCodecContext* CodecContext;
@@ -0,0 +1,117 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "DirectShowMediaUploadRing.h"
+
+#include "Misc/ScopeLock.h"
+
+
+/* FDirectShowMediaUploadRing structors
+ *****************************************************************************/
+
+FDirectShowMediaUploadRing::FDirectShowMediaUploadRing(TUniquePtr<IDirectShowMediaUploadBackend>&& InBackend)
+	: Backend(MoveTemp(InBackend))
+	, NextSlot(0)
+	, NumUploaded(0)
+	, NumMissed(0)
+{ }
+
+
+FDirectShowMediaUploadRing::~FDirectShowMediaUploadRing()
+{
+	if (States.Num() > 0)
+	{
+		Backend->ReleaseSlots();
+	}
+}
+
+
+TSharedPtr<FDirectShowMediaUploadRing, ESPMode::ThreadSafe> FDirectShowMediaUploadRing::Create(TUniquePtr<IDirectShowMediaUploadBackend>&& InBackend, int32 NumSlots, const FIntPoint& Dim, EMediaTextureSampleFormat Format)
+{
+	if (!InBackend.IsValid() || (NumSlots <= 0) || (Dim.X <= 0) || (Dim.Y <= 0) || !InBackend->CreateSlots(NumSlots, Dim, Format))
+	{
+		return nullptr;
+	}
+
+	TSharedPtr<FDirectShowMediaUploadRing, ESPMode::ThreadSafe> Ring = MakeShareable(new FDirectShowMediaUploadRing(MoveTemp(InBackend)));
+	Ring->States.Init(ESlotState::Mapping, NumSlots);
+
+	for (int32 SlotIndex = 0; SlotIndex < NumSlots; ++SlotIndex)
+	{
+		Ring->Backend->MapSlot(SlotIndex);
+	}
+
+	return Ring;
+}
+
+
+/* FDirectShowMediaUploadRing interface
+ *****************************************************************************/
+
+int32 FDirectShowMediaUploadRing::Acquire(uint8*& OutData, uint32& OutStride)
+{
+	FScopeLock Lock(&CriticalSection);
+
+	const int32 NumSlots = States.Num();
+
+	for (int32 Offset = 0; Offset < NumSlots; ++Offset)
+	{
+		const int32 SlotIndex = (NextSlot + Offset) % NumSlots;
+
+		if (States[SlotIndex] != ESlotState::Mapping)
+		{
+			continue;
+		}
+
+		uint8* Data = Backend->GetMappedData(SlotIndex, OutStride);
+
+		if (Data != nullptr)
+		{
+			States[SlotIndex] = ESlotState::Writing;
+			NextSlot = (SlotIndex + 1) % NumSlots;
+			OutData = Data;
+
+			return SlotIndex;
+		}
+	}
+
+	++NumMissed;
+
+	return INDEX_NONE;
+}
+
+
+void FDirectShowMediaUploadRing::Submit(int32 SlotIndex)
+{
+	{
+		FScopeLock Lock(&CriticalSection);
+
+		check(States[SlotIndex] == ESlotState::Writing);
+		States[SlotIndex] = ESlotState::InFlight;
+	}
+
+	Backend->SubmitSlot(SlotIndex);
+	++NumUploaded;
+}
+
+
+void FDirectShowMediaUploadRing::Cancel(int32 SlotIndex)
+{
+	FScopeLock Lock(&CriticalSection);
+
+	check(States[SlotIndex] == ESlotState::Writing);
+	States[SlotIndex] = ESlotState::Mapping;
+}
+
+
+void FDirectShowMediaUploadRing::Release(int32 SlotIndex)
+{
+	{
+		FScopeLock Lock(&CriticalSection);
+
+		check(States[SlotIndex] == ESlotState::InFlight);
+		States[SlotIndex] = ESlotState::Mapping;
+	}
+
+	// the backend maps the slot behind the upload and the sample's last use of the texture
+	Backend->MapSlot(SlotIndex);
+}
@@ -0,0 +1,146 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include <atomic>
+
+#include "CoreTypes.h"
+#include "Containers/Array.h"
+#include "HAL/CriticalSection.h"
+#include "IDirectShowMediaUploadBackend.h"
+#include "Templates/SharedPointer.h"
+#include "Templates/UniquePtr.h"
+
+class FRHITexture;
+
+
+/**
+ * Ring of upload slots that video kernels write converted frames into.
+ *
+ * Each slot is a texture with staging memory that stays mapped while the slot is free, so a kernel writes
+ * the frame straight into upload memory instead of into the sample's buffer, and the engine gets a texture
+ * rather than copying the buffer into one. A slot cycles through three states:
+ *
+ *  - Mapping: free, waiting for the backend to map its staging memory (the slot's fence)
+ *  - Writing: acquired by a kernel (streaming thread)
+ *  - InFlight: submitted for upload and held by a sample until the sample is released
+ *
+ * Slots are acquired round robin among the mapped ones. When none is mapped, Acquire fails and the caller
+ * falls back to the sample's buffer, so a consumer holding on to samples never stalls the device.
+ *
+ * The ring is shared by the player and its samples, and released with the last of them. Acquire, Submit and
+ * Cancel are called from the streaming thread, Release from any thread.
+ */
+class FDirectShowMediaUploadRing
+{
+public:
+
+	/**
+	 * Create a ring.
+	 *
+	 * @param InBackend The backend owning the slots' textures and memory.
+	 * @param NumSlots The number of slots.
+	 * @param Dim The textures' width and height (in texels of Format).
+	 * @param Format The sample format of the frames.
+	 * @return The ring, or nullptr if the backend can't upload the format.
+	 */
+	static TSharedPtr<FDirectShowMediaUploadRing, ESPMode::ThreadSafe> Create(TUniquePtr<IDirectShowMediaUploadBackend>&& InBackend, int32 NumSlots, const FIntPoint& Dim, EMediaTextureSampleFormat Format);
+
+	/** Destructor. */
+	~FDirectShowMediaUploadRing();
+
+public:
+
+	/**
+	 * Acquire a mapped slot for writing.
+	 *
+	 * @param OutData Will contain the slot's staging memory.
+	 * @param OutStride Will contain the number of bytes per row of the staging memory.
+	 * @return The slot, or INDEX_NONE if no slot is mapped.
+	 */
+	int32 Acquire(uint8*& OutData, uint32& OutStride);
+
+	/**
+	 * Submit a written slot for upload.
+	 *
+	 * @param SlotIndex The slot returned by Acquire.
+	 * @see Release
+	 */
+	void Submit(int32 SlotIndex);
+
+	/**
+	 * Give back an acquired slot that wasn't written, keeping it mapped.
+	 *
+	 * @param SlotIndex The slot returned by Acquire.
+	 */
+	void Cancel(int32 SlotIndex);
+
+	/**
+	 * Release a submitted slot once its sample is done with the texture, mapping it for the next frame.
+	 *
+	 * @param SlotIndex The submitted slot.
+	 */
+	void Release(int32 SlotIndex);
+
+	/**
+	 * Get the texture of a slot.
+	 *
+	 * @param SlotIndex The slot.
+	 * @return The texture.
+	 */
+	FRHITexture* GetTexture(int32 SlotIndex) const
+	{
+		return Backend->GetTexture(SlotIndex);
+	}
+
+	/** Number of slots. */
+	int32 GetNumSlots() const
+	{
+		return States.Num();
+	}
+
+	/** Number of frames submitted for upload. */
+	uint64 GetNumUploaded() const
+	{
+		return NumUploaded;
+	}
+
+	/** Number of frames that found no mapped slot. */
+	uint64 GetNumMissed() const
+	{
+		return NumMissed;
+	}
+
+private:
+
+	/** States of a slot. */
+	enum class ESlotState : uint8
+	{
+		Mapping,
+		Writing,
+		InFlight
+	};
+
+	/** Create and initialize a ring (see Create). */
+	explicit FDirectShowMediaUploadRing(TUniquePtr<IDirectShowMediaUploadBackend>&& InBackend);
+
+private:
+
+	/** The backend owning the slots. */
+	TUniquePtr<IDirectShowMediaUploadBackend> Backend;
+
+	/** The state of each slot. */
+	TArray<ESlotState> States;
+
+	/** The slot the next search for a mapped slot starts at. */
+	int32 NextSlot;
+
+	/** Protects the slot states. */
+	mutable FCriticalSection CriticalSection;
+
+	/** Number of frames submitted for upload. */
+	std::atomic<uint64> NumUploaded;
+
+	/** Number of frames that found no mapped slot. */
+	std::atomic<uint64> NumMissed;
+};
@@ -0,0 +1,249 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "DirectShowMediaVideoKernels.h"
+
+#include "DirectShowMediaColorConverter.h"
+#include "HAL/UnrealMemory.h"
+
+
+namespace DirectShowMediaVideoKernels
+{
+	/** Get the source row that goes to the given destination row. */
+	template<bool bFlip>
+	FORCEINLINE int32 GetSourceRow(int32 Row, int32 Height)
+	{
+		return bFlip ? (Height - 1 - Row) : Row;
+	}
+
+
+	/** Check that a frame of NumRows rows holds its pixels, the padding of the last row being optional. */
+	FORCEINLINE bool HasRows(const FDirectShowMediaVideoKernelArgs& Args, int32 NumRows, uint32 RowSize)
+	{
+		return (Args.SourceStride >= RowSize) && ((uint64)Args.SourceStride * (NumRows - 1) + RowSize <= Args.SourceSize);
+	}
+
+
+	/** Copies packed frames (rows of RowSize bytes). */
+	struct FCopyPacked
+	{
+		template<bool bFlip, bool bAligned>
+		static bool Run(const FDirectShowMediaVideoKernelArgs& Args)
+		{
+			if (!HasRows(Args, Args.Height, Args.RowSize) || (Args.DestStride < Args.RowSize))
+			{
+				return false;
+			}
+
+			if (bAligned && !bFlip)
+			{
+				// same pitch on both sides, padding included
+				FMemory::Memcpy(Args.Dest, Args.Source, (SIZE_T)Args.SourceStride * (Args.Height - 1) + Args.RowSize);
+
+				return true;
+			}
+
+			for (int32 Row = 0; Row < Args.Height; ++Row)
+			{
+				FMemory::Memcpy(Args.Dest + (SIZE_T)Row * Args.DestStride, Args.Source + (SIZE_T)GetSourceRow<bFlip>(Row, Args.Height) * Args.SourceStride, Args.RowSize);
+			}
+
+			return true;
+		}
+	};
+
+
+	/** Copies NV12 frames (luma rows followed by half as many chroma rows). */
+	struct FCopyNV12
+	{
+		template<bool bFlip, bool bAligned>
+		static bool Run(const FDirectShowMediaVideoKernelArgs& Args)
+		{
+			const int32 ChromaRows = (Args.Height + 1) / 2;
+
+			if (!HasRows(Args, Args.Height + ChromaRows, Args.RowSize) || (Args.DestStride < Args.RowSize))
+			{
+				return false;
+			}
+
+			if (bAligned && !bFlip)
+			{
+				FMemory::Memcpy(Args.Dest, Args.Source, (SIZE_T)Args.SourceStride * (Args.Height + ChromaRows - 1) + Args.RowSize);
+
+				return true;
+			}
+
+			const uint8* SourceChroma = Args.Source + (SIZE_T)Args.SourceStride * Args.Height;
+			uint8* DestChroma = Args.Dest + (SIZE_T)Args.DestStride * Args.Height;
+
+			for (int32 Row = 0; Row < Args.Height; ++Row)
+			{
+				FMemory::Memcpy(Args.Dest + (SIZE_T)Row * Args.DestStride, Args.Source + (SIZE_T)GetSourceRow<bFlip>(Row, Args.Height) * Args.SourceStride, Args.RowSize);
+			}
+
+			for (int32 Row = 0; Row < ChromaRows; ++Row)
+			{
+				FMemory::Memcpy(DestChroma + (SIZE_T)Row * Args.DestStride, SourceChroma + (SIZE_T)GetSourceRow<bFlip>(Row, ChromaRows) * Args.SourceStride, Args.RowSize);
+			}
+
+			return true;
+		}
+	};
+
+
+	/** Converts packed 4:2:2 frames to BGRA, with the given byte offsets of Y, U and V in a pixel pair. */
+	template<int32 YOffset, int32 UOffset, int32 VOffset>
+	struct TPacked422ToBGRA
+	{
+		/** Convert the pixel pairs of a run (and the lone pixel at the end of odd width rows if unaligned). */
+		template<bool bAligned>
+		static FORCEINLINE void ConvertRun(const FDirectShowMediaColorConverter& Converter, const uint8* Source, int32 Width, uint8* Dest)
+		{
+			const uint8* const SourceEnd = Source + (SIZE_T)(Width / 2) * 4;
+
+			for (; Source != SourceEnd; Source += 4, Dest += 8)
+			{
+				Converter.ConvertPair(Source[YOffset], Source[YOffset + 2], Source[UOffset], Source[VOffset], Dest);
+			}
+
+			if (!bAligned && (Width & 1))
+			{
+				Converter.ConvertPixel(Source[YOffset], Source[UOffset], Source[VOffset], Dest);
+			}
+		}
+
+		template<bool bFlip, bool bAligned>
+		static bool Run(const FDirectShowMediaVideoKernelArgs& Args)
+		{
+			if (!HasRows(Args, Args.Height, (uint32)((Args.Width + 1) / 2) * 4) || (Args.DestStride < (uint32)Args.Width * 4))
+			{
+				return false;
+			}
+
+			if (bAligned && !bFlip)
+			{
+				// rows are contiguous on both sides, so the frame is one run
+				ConvertRun<true>(*Args.Converter, Args.Source, Args.Width * Args.Height, Args.Dest);
+
+				return true;
+			}
+
+			for (int32 Row = 0; Row < Args.Height; ++Row)
+			{
+				ConvertRun<bAligned>(*Args.Converter, Args.Source + (SIZE_T)GetSourceRow<bFlip>(Row, Args.Height) * Args.SourceStride, Args.Width, Args.Dest + (SIZE_T)Row * Args.DestStride);
+			}
+
+			return true;
+		}
+	};
+
+
+	/** Converts NV12 frames to BGRA. */
+	struct FNV12ToBGRA
+	{
+		template<bool bFlip, bool bAligned>
+		static bool Run(const FDirectShowMediaVideoKernelArgs& Args)
+		{
+			const int32 ChromaRows = (Args.Height + 1) / 2;
+
+			if (!HasRows(Args, Args.Height + ChromaRows, (uint32)((Args.Width + 1) & ~1)) || (Args.DestStride < (uint32)Args.Width * 4))
+			{
+				return false;
+			}
+
+			const FDirectShowMediaColorConverter& Converter = *Args.Converter;
+			const uint8* ChromaPlane = Args.Source + (SIZE_T)Args.SourceStride * Args.Height;
+
+			for (int32 Row = 0; Row < Args.Height; ++Row)
+			{
+				const int32 SourceRow = GetSourceRow<bFlip>(Row, Args.Height);
+				const uint8* Luma = Args.Source + (SIZE_T)SourceRow * Args.SourceStride;
+				const uint8* Chroma = ChromaPlane + (SIZE_T)(SourceRow / 2) * Args.SourceStride;
+				const uint8* const LumaEnd = Luma + (Args.Width & ~1);
+				uint8* Dest = Args.Dest + (SIZE_T)Row * Args.DestStride;
+
+				for (; Luma != LumaEnd; Luma += 2, Chroma += 2, Dest += 8)
+				{
+					Converter.ConvertPair(Luma[0], Luma[1], Chroma[0], Chroma[1], Dest);
+				}
+
+				if (!bAligned && (Args.Width & 1))
+				{
+					Converter.ConvertPixel(Luma[0], Chroma[0], Chroma[1], Dest);
+				}
+			}
+
+			return true;
+		}
+	};
+
+
+	/** The kernels of a format pair, indexed by flip and alignment. */
+	struct FKernelSet
+	{
+		EMediaTextureSampleFormat SourceFormat;
+		EMediaTextureSampleFormat DestFormat;
+		FDirectShowMediaVideoKernel Kernels[2][2];
+	};
+
+	/** Instantiate the kernels of a format pair. */
+	template<typename KernelType>
+	constexpr FKernelSet MakeKernelSet(EMediaTextureSampleFormat SourceFormat, EMediaTextureSampleFormat DestFormat)
+	{
+		return {
+			SourceFormat,
+			DestFormat,
+			{
+				{ &KernelType::template Run<false, false>, &KernelType::template Run<false, true> },
+				{ &KernelType::template Run<true, false>, &KernelType::template Run<true, true> }
+			}
+		};
+	}
+
+	/** All supported format pairs. */
+	const FKernelSet KernelSets[] =
+	{
+		MakeKernelSet<FCopyPacked>(EMediaTextureSampleFormat::CharBGRA, EMediaTextureSampleFormat::CharBGRA),
+		MakeKernelSet<FCopyPacked>(EMediaTextureSampleFormat::CharYUY2, EMediaTextureSampleFormat::CharYUY2),
+		MakeKernelSet<FCopyPacked>(EMediaTextureSampleFormat::CharUYVY, EMediaTextureSampleFormat::CharUYVY),
+		MakeKernelSet<FCopyPacked>(EMediaTextureSampleFormat::YUVv210, EMediaTextureSampleFormat::YUVv210),
+		MakeKernelSet<FCopyNV12>(EMediaTextureSampleFormat::CharNV12, EMediaTextureSampleFormat::CharNV12),
+		MakeKernelSet<TPacked422ToBGRA<0, 1, 3>>(EMediaTextureSampleFormat::CharYUY2, EMediaTextureSampleFormat::CharBGRA),
+		MakeKernelSet<TPacked422ToBGRA<1, 0, 2>>(EMediaTextureSampleFormat::CharUYVY, EMediaTextureSampleFormat::CharBGRA),
+		MakeKernelSet<FNV12ToBGRA>(EMediaTextureSampleFormat::CharNV12, EMediaTextureSampleFormat::CharBGRA)
+	};
+}
+
+
+/* FDirectShowMediaVideoKernels interface
+ *****************************************************************************/
+
+FDirectShowMediaVideoKernel FDirectShowMediaVideoKernels::Find(EMediaTextureSampleFormat SourceFormat, EMediaTextureSampleFormat DestFormat, bool bFlip, bool bAligned)
+{
+	using namespace DirectShowMediaVideoKernels;
+
+	for (const FKernelSet& KernelSet : KernelSets)
+	{
+		if ((KernelSet.SourceFormat == SourceFormat) && (KernelSet.DestFormat == DestFormat))
+		{
+			return KernelSet.Kernels[bFlip ? 1 : 0][bAligned ? 1 : 0];
+		}
+	}
+
+	return nullptr;
+}
+
+
+bool FDirectShowMediaVideoKernels::IsAligned(EMediaTextureSampleFormat SourceFormat, EMediaTextureSampleFormat DestFormat, int32 Width, uint32 SourceStride, uint32 DestStride)
+{
+	if (SourceFormat == DestFormat)
+	{
+		return (SourceStride == DestStride);
+	}
+
+	if (SourceFormat == EMediaTextureSampleFormat::CharNV12)
+	{
+		return ((Width & 1) == 0);
+	}
+
+	return ((Width & 1) == 0) && (SourceStride == (uint32)Width * 2) && (DestStride == (uint32)Width * 4);
+}
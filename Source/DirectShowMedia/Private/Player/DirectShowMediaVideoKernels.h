@@ -0,0 +1,92 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreTypes.h"
+#include "IMediaTextureSample.h"
+
+class FDirectShowMediaColorConverter;
+
+
+/** Arguments of a video kernel. */
+struct FDirectShowMediaVideoKernelArgs
+{
+	/** The captured frame. */
+	const uint8* Source = nullptr;
+
+	/** Size of the captured frame (in bytes). */
+	uint32 SourceSize = 0;
+
+	/** Number of bytes per row of the captured frame (of the luma plane for NV12), the pitch reported by the driver. */
+	uint32 SourceStride = 0;
+
+	/** Number of bytes copied per row by the copy kernels, at most SourceStride (the last row may end there). */
+	uint32 RowSize = 0;
+
+	/** The sample buffer, at least DestStride bytes per row. */
+	uint8* Dest = nullptr;
+
+	/** Number of bytes per row of the sample buffer, which may be padded for the texture upload. */
+	uint32 DestStride = 0;
+
+	/** Frame width (in pixels). */
+	int32 Width = 0;
+
+	/** Frame height (in pixels). */
+	int32 Height = 0;
+
+	/** The converter used by YUV to BGRA kernels. */
+	const FDirectShowMediaColorConverter* Converter = nullptr;
+};
+
+
+/**
+ * Copies or converts a captured frame into a sample buffer.
+ *
+ * @param Args The frame and the sample buffer.
+ * @return true on success, false if the frame is smaller than its format requires.
+ */
+typedef bool (*FDirectShowMediaVideoKernel)(const FDirectShowMediaVideoKernelArgs& Args);
+
+
+/**
+ * Table of frame copy and conversion kernels.
+ *
+ * Kernels are generated from templates for each source and destination format pair, vertical flip, and
+ * whether rows are aligned: strides that match the packed row size and an even width, so a frame can be
+ * handled as one run and no row ends with half a chroma pair. The kernel is picked once when a format is
+ * negotiated; its loops have no per pixel branches.
+ *
+ * Rows are read at the pitch of the captured frame and written at the stride of the sample buffer in the same
+ * pass, so padding on either side costs nothing beyond the per row loop.
+ */
+class FDirectShowMediaVideoKernels
+{
+public:
+
+	/**
+	 * Find the kernel for a format pair.
+	 *
+	 * Packed formats are copied to themselves (CharBGRA, CharYUY2, CharUYVY, YUVv210) as is NV12; CharYUY2, CharUYVY
+	 * and CharNV12 are also converted to CharBGRA.
+	 *
+	 * @param SourceFormat The format of the captured frame.
+	 * @param DestFormat The format of the sample.
+	 * @param bFlip Whether to flip the frame vertically (i.e. for bottom-up frames).
+	 * @param bAligned Whether the rows are aligned (see IsAligned).
+	 * @return The kernel, or nullptr if the pair isn't supported.
+	 */
+	static FDirectShowMediaVideoKernel Find(EMediaTextureSampleFormat SourceFormat, EMediaTextureSampleFormat DestFormat, bool bFlip, bool bAligned);
+
+	/**
+	 * Check whether the aligned kernel of a format pair can be used.
+	 *
+	 * @param SourceFormat The format of the captured frame.
+	 * @param DestFormat The format of the sample.
+	 * @param Width The frame width (in pixels).
+	 * @param SourceStride Number of bytes per row of the captured frame.
+	 * @param DestStride Number of bytes per row of the sample buffer.
+	 * @return true if the rows are aligned, false otherwise.
+	 */
+	static bool IsAligned(EMediaTextureSampleFormat SourceFormat, EMediaTextureSampleFormat DestFormat, int32 Width, uint32 SourceStride, uint32 DestStride);
+};
@@ -0,0 +1,222 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "DirectShowMediaVideoLayout.h"
+
+#include "DirectShowMediaColorConverter.h"
+#include "DirectShowMediaCommon.h"
+#include "DirectShowMediaTextureSample.h"
+#include "DirectShowMediaTimecode.h"
+#include "Math/UnrealMathUtility.h"
+#include "Templates/AlignmentTemplates.h"
+
+
+/* FDirectShowMediaVideoLayout structors
+ *****************************************************************************/
+
+FDirectShowMediaVideoLayout::FDirectShowMediaVideoLayout()
+{
+	Reset();
+}
+
+
+/* FDirectShowMediaVideoLayout interface
+ *****************************************************************************/
+
+bool FDirectShowMediaVideoLayout::Resolve(const GUID& Subtype, const FIntPoint& InResolution, int32 InPitch, float FrameRate, const FDirectShowMediaColorConverter& InConverter, bool bInAcceptPlanar, bool bInConvertTo8Bit, bool bConvertToBGRA, bool bFlip, uint32 RowAlignment)
+{
+	Reset();
+
+	if ((InResolution.X <= 0) || (InResolution.Y == 0))
+	{
+		return false; // not negotiated yet
+	}
+
+	// the sign of the height is the row order of RGB formats, not part of the size
+	Resolution = FIntPoint(InResolution.X, FMath::Abs(InResolution.Y));
+	bAcceptPlanar = bInAcceptPlanar;
+	bConvertTo8Bit = bInConvertTo8Bit;
+	Converter = &InConverter;
+
+	// drivers may pad the captured rows beyond the frame width
+	const int32 Pitch = FMath::Max(InPitch, Resolution.X);
+
+	// DirectShow doesn't report durations for some formats
+	FrameDuration = FTimespan((int64)((float)ETimespan::TicksPerSecond / ((FrameRate > 0.0f) ? FrameRate : 30.0f)));
+	TimecodeRate = FDirectShowMediaTimecode::GetFrameRate(FrameRate);
+
+	if ((Subtype == MEDIASUBTYPE_MJPG) || (Subtype == MEDIASUBTYPE_H264) || (Subtype == MEDIASUBTYPE_RGB32) || (Subtype == MEDIASUBTYPE_ARGB32))
+	{
+		// compressed formats reach the callback decoded to BGRA unless a YUV sink was negotiated
+		Dim = Resolution;
+		SourceStride = Pitch * 4;
+		RowSize = Resolution.X * 4;
+		Format = EMediaTextureSampleFormat::CharBGRA;
+	}
+	else if (Subtype == MEDIASUBTYPE_NV12)
+	{
+		Dim = FIntPoint(Resolution.X, Resolution.Y + (Resolution.Y + 1) / 2);
+		SourceStride = Pitch;
+		RowSize = Resolution.X;
+		Format = EMediaTextureSampleFormat::CharNV12;
+
+		if (bAcceptPlanar)
+		{
+			PlanarFormat = EDirectShowMediaPlanarFormat::NV12;
+		}
+	}
+	else if ((Subtype == MEDIASUBTYPE_IYUV) || (Subtype == DSMEDIASUBTYPE_I420) || (Subtype == MEDIASUBTYPE_YV12) || (Subtype == DSMEDIASUBTYPE_NV21))
+	{
+		PlanarFormat = (Subtype == MEDIASUBTYPE_YV12) ? EDirectShowMediaPlanarFormat::YV12 : (Subtype == DSMEDIASUBTYPE_NV21) ? EDirectShowMediaPlanarFormat::NV21 : EDirectShowMediaPlanarFormat::I420;
+		SourceStride = Pitch;
+		Format = (Subtype == DSMEDIASUBTYPE_NV21) ? EMediaTextureSampleFormat::CharNV21 : EMediaTextureSampleFormat::CharNV12;
+	}
+	else if (Subtype == MEDIASUBTYPE_UYVY)
+	{
+		Dim = FIntPoint(Resolution.X / 2, Resolution.Y);
+		SourceStride = Pitch * 2;
+		RowSize = Resolution.X * 2;
+		Format = EMediaTextureSampleFormat::CharUYVY;
+	}
+	else if (Subtype == MEDIASUBTYPE_YUY2)
+	{
+		Dim = FIntPoint(Resolution.X / 2, Resolution.Y);
+		SourceStride = Pitch * 2;
+		RowSize = Resolution.X * 2;
+		Format = EMediaTextureSampleFormat::CharYUY2;
+	}
+	else if ((Subtype == DSMEDIASUBTYPE_v210) && !bConvertTo8Bit)
+	{
+		// the engine reads v210 natively, one 128 bit texel per six pixels
+		SourceStride = FDirectShowMediaVideoUnpacker::GetSourceStride(EDirectShowMediaHighBitDepthFormat::V210, Pitch);
+		RowSize = FDirectShowMediaVideoUnpacker::GetSourceStride(EDirectShowMediaHighBitDepthFormat::V210, Resolution.X);
+		Dim = FIntPoint(RowSize / 16, Resolution.Y);
+		Format = EMediaTextureSampleFormat::YUVv210;
+	}
+	else if ((Subtype == DSMEDIASUBTYPE_P010) || (Subtype == DSMEDIASUBTYPE_Y210) || (Subtype == DSMEDIASUBTYPE_v210))
+	{
+		HighBitDepthFormat = (Subtype == DSMEDIASUBTYPE_P010) ? EDirectShowMediaHighBitDepthFormat::P010 : (Subtype == DSMEDIASUBTYPE_Y210) ? EDirectShowMediaHighBitDepthFormat::Y210 : EDirectShowMediaHighBitDepthFormat::V210;
+		SourceStride = FDirectShowMediaVideoUnpacker::GetSourceStride(HighBitDepthFormat, Pitch);
+		Format = FDirectShowMediaVideoUnpacker::GetOutputFormat(HighBitDepthFormat, bConvertTo8Bit);
+		InitializeFunc = &InitializeUnpacked;
+
+		return true;
+	}
+	else
+	{
+		// Don't process any unsupported formats, unexpected bahaviors can come
+		return false;
+	}
+
+	if (PlanarFormat != EDirectShowMediaPlanarFormat::None)
+	{
+		InitializeFunc = &InitializePlanar;
+
+		return true;
+	}
+
+	// the kernel reads the captured rows at their pitch and writes the sample's layout in one pass
+	SourceFormat = Format;
+	Stride = RowSize;
+
+	if (bConvertToBGRA && FDirectShowMediaColorConverter::IsSupportedFormat(SourceFormat))
+	{
+		Dim = Resolution;
+		Stride = Resolution.X * 4;
+		Format = EMediaTextureSampleFormat::CharBGRA;
+	}
+
+	// the texture upload copies aligned rows without restaging them
+	if ((RowAlignment > 1) && FMath::IsPowerOfTwo(RowAlignment))
+	{
+		Stride = Align(Stride, RowAlignment);
+	}
+
+	// upload slots are written at the texture's lock pitch, only known per slot, so both variants are kept
+	AlignedKernel = FDirectShowMediaVideoKernels::Find(SourceFormat, Format, bFlip, true);
+	RowKernel = FDirectShowMediaVideoKernels::Find(SourceFormat, Format, bFlip, false);
+
+	if ((AlignedKernel == nullptr) || (RowKernel == nullptr))
+	{
+		return false;
+	}
+
+	Kernel = FDirectShowMediaVideoKernels::IsAligned(SourceFormat, Format, Resolution.X, SourceStride, Stride) ? AlignedKernel : RowKernel;
+
+	InitializeFunc = &InitializeWithKernel;
+
+	return true;
+}
+
+
+void FDirectShowMediaVideoLayout::Reset()
+{
+	Dim = FIntPoint::ZeroValue;
+	Resolution = FIntPoint::ZeroValue;
+	Stride = 0;
+	Format = EMediaTextureSampleFormat::Undefined;
+	SourceStride = 0;
+	RowSize = 0;
+	SourceFormat = EMediaTextureSampleFormat::Undefined;
+	Kernel = nullptr;
+	AlignedKernel = nullptr;
+	RowKernel = nullptr;
+	PlanarFormat = EDirectShowMediaPlanarFormat::None;
+	HighBitDepthFormat = EDirectShowMediaHighBitDepthFormat::P010;
+	bAcceptPlanar = false;
+	bConvertTo8Bit = false;
+	Converter = nullptr;
+	FrameDuration = FTimespan::Zero();
+	TimecodeRate = FFrameRate(30, 1);
+	InitializeFunc = nullptr;
+	UploadRing.Reset();
+	FrameArena.Reset();
+	PlanarViewBudget.Reset();
+}
+
+
+uint64 FDirectShowMediaVideoLayout::GetFrameSize() const
+{
+	FIntPoint OutDim;
+	uint32 OutStride = 0;
+
+	if (InitializeFunc == &InitializeUnpacked)
+	{
+		return FDirectShowMediaVideoUnpacker::GetOutputLayout(Format, Resolution, OutDim, OutStride);
+	}
+
+	if (InitializeFunc == &InitializePlanar)
+	{
+		// views hold the captured frame, copies a semi-planar one
+		return bAcceptPlanar ? (uint64)SourceStride * (Resolution.Y + (Resolution.Y + 1) / 2) : FDirectShowMediaPlanarFrame::GetSemiPlanarLayout(Resolution, OutDim, OutStride);
+	}
+
+	return (uint64)Stride * Dim.Y;
+}
+
+
+/* FDirectShowMediaVideoLayout implementation
+ *****************************************************************************/
+
+bool FDirectShowMediaVideoLayout::InitializeWithKernel(const FDirectShowMediaVideoLayout& Layout, FDirectShowMediaTextureSample& TextureSample, IMediaSample* SourceSample, const void* Buffer, uint32 Size, FTimespan Time, FTimespan Duration)
+{
+	// straight into upload memory if a slot is free
+	if (Layout.UploadRing.IsValid() && TextureSample.Initialize(Layout.SourceFormat, Layout.AlignedKernel, Layout.RowKernel, *Layout.Converter, Layout.UploadRing.ToSharedRef(), Buffer, Size, Layout.SourceStride, Layout.RowSize, Layout.Dim, Layout.Resolution, Layout.Format, Time, Duration))
+	{
+		return true;
+	}
+
+	return TextureSample.Initialize(Layout.Kernel, *Layout.Converter, Buffer, Size, Layout.SourceStride, Layout.RowSize, Layout.Dim, Layout.Resolution, Layout.Format, Layout.Stride, Time, Duration);
+}
+
+
+bool FDirectShowMediaVideoLayout::InitializeUnpacked(const FDirectShowMediaVideoLayout& Layout, FDirectShowMediaTextureSample& TextureSample, IMediaSample* SourceSample, const void* Buffer, uint32 Size, FTimespan Time, FTimespan Duration)
+{
+	return TextureSample.Initialize(Layout.HighBitDepthFormat, Layout.bConvertTo8Bit, Buffer, Size, Layout.SourceStride, Layout.Resolution, Time, Duration);
+}
+
+
+bool FDirectShowMediaVideoLayout::InitializePlanar(const FDirectShowMediaVideoLayout& Layout, FDirectShowMediaTextureSample& TextureSample, IMediaSample* SourceSample, const void* Buffer, uint32 Size, FTimespan Time, FTimespan Duration)
+{
+	// views keep the capture sample out of the allocator until the consumer releases them
+	return TextureSample.Initialize(Layout.PlanarFormat, Layout.bAcceptPlanar, SourceSample, Layout.PlanarViewBudget, Buffer, Size, Layout.SourceStride, Layout.Resolution, Time, Duration);
+}
@@ -0,0 +1,247 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreTypes.h"
+#include "IDirectShowMediaPlanarSample.h"
+#include "IMediaTextureSample.h"
+#include "Math/IntPoint.h"
+#include "Math/UnrealMathUtility.h"
+#include "Misc/FrameRate.h"
+#include "Misc/Timespan.h"
+#include "DirectShowMediaFrameArena.h"
+#include "DirectShowMediaPlanarFrame.h"
+#include "DirectShowMediaTextureSample.h"
+#include "DirectShowMediaUploadRing.h"
+#include "DirectShowMediaVideoKernels.h"
+#include "DirectShowMediaVideoUnpacker.h"
+
+#include "Windows/AllowWindowsPlatformTypes.h"
+#include <strmif.h>
+#include "Windows/HideWindowsPlatformTypes.h"
+
+class FDirectShowMediaColorConverter;
+
+
+/**
+ * Layout of the video samples of a negotiated format.
+ *
+ * Resolved once when the device negotiates a format: the pitch of the captured rows, the sample dimensions,
+ * stride and texture format, the frame duration, and the routine that turns a captured buffer into a texture
+ * sample (a copy or BGRA conversion kernel, high bit depth unpacking or plane views). Handling a frame is then
+ * a single call through that routine. Kernels can write into an upload ring instead of the sample's buffer.
+ */
+class FDirectShowMediaVideoLayout
+{
+public:
+
+	/** Default constructor. */
+	FDirectShowMediaVideoLayout();
+
+public:
+
+	/**
+	 * Resolve the layout of a format.
+	 *
+	 * @param Subtype The subtype of the samples handed to the callback.
+	 * @param InResolution The frame size (in pixels).
+	 * @param InPitch The width of the captured rows (in pixels), which drivers may pad beyond the frame width.
+	 * @param FrameRate The frame rate reported by the device.
+	 * @param InConverter The converter used for BGRA conversion, configured for the format's colorimetry.
+	 * @param bInAcceptPlanar Whether planar formats are delivered as views into the capture buffer.
+	 * @param bInConvertTo8Bit Whether 10 bit formats are reduced to 8 bit.
+	 * @param bConvertToBGRA Whether YUV formats are converted to BGRA.
+	 * @param bFlip Whether copied and converted frames are flipped vertically.
+	 * @param RowAlignment The alignment of the rows of copied and converted samples (in bytes, a power of two), or 0 for tightly packed rows.
+	 * @return true if the format is supported, false otherwise.
+	 */
+	bool Resolve(const GUID& Subtype, const FIntPoint& InResolution, int32 InPitch, float FrameRate, const FDirectShowMediaColorConverter& InConverter, bool bInAcceptPlanar, bool bInConvertTo8Bit, bool bConvertToBGRA, bool bFlip, uint32 RowAlignment);
+
+	/** Forget the resolved format. */
+	void Reset();
+
+	/**
+	 * Have the kernel write frames straight into an upload ring.
+	 *
+	 * Frames go to the sample's buffer when no slot is free, and always for formats that aren't copied or
+	 * converted by a kernel.
+	 *
+	 * @param InUploadRing The ring, created for the resolved sample dimensions and format, or nullptr.
+	 */
+	void SetUploadRing(const TSharedPtr<FDirectShowMediaUploadRing, ESPMode::ThreadSafe>& InUploadRing)
+	{
+		UploadRing = (InitializeFunc == &InitializeWithKernel) ? InUploadRing : nullptr;
+	}
+
+	/**
+	 * Store copied and converted frames in a frame arena.
+	 *
+	 * Frames go to the sample's buffer when no slot is free.
+	 *
+	 * @param InFrameArena The arena, created for the resolved frame size, or nullptr.
+	 * @see GetFrameSize
+	 */
+	void SetFrameArena(const TSharedPtr<FDirectShowMediaFrameArena, ESPMode::ThreadSafe>& InFrameArena)
+	{
+		FrameArena = IsCopied() ? InFrameArena : nullptr;
+	}
+
+	/**
+	 * Limit the plane views to the device's capture buffers.
+	 *
+	 * Views hold all buffers but one, further frames are copied until a view is released.
+	 *
+	 * @param NumCaptureBuffers Number of buffers of the device's allocator, or 0 if unknown (frames are then always copied).
+	 */
+	void SetCaptureBuffers(int32 NumCaptureBuffers)
+	{
+		PlanarViewBudget.Reset();
+
+		if ((InitializeFunc == &InitializePlanar) && bAcceptPlanar)
+		{
+			PlanarViewBudget = MakeShared<FDirectShowMediaPlanarViewBudget, ESPMode::ThreadSafe>(FMath::Max(0, NumCaptureBuffers - 1));
+		}
+	}
+
+	/**
+	 * Initialize a texture sample with a captured frame.
+	 *
+	 * @param TextureSample The sample to initialize.
+	 * @param SourceSample The captured sample, referenced by plane views.
+	 * @param Buffer The captured frame.
+	 * @param Size Size of the frame (in bytes).
+	 * @param Time The sample time (relative to presentation clock).
+	 * @param Duration The duration for which the sample is valid.
+	 * @return true on success, false otherwise.
+	 */
+	FORCEINLINE bool InitializeSample(FDirectShowMediaTextureSample& TextureSample, IMediaSample* SourceSample, const void* Buffer, uint32 Size, FTimespan Time, FTimespan Duration) const
+	{
+		TextureSample.SetFrameArena(FrameArena);
+
+		return InitializeFunc(*this, TextureSample, SourceSample, Buffer, Size, Time, Duration);
+	}
+
+	/** Whether a supported format was resolved. */
+	bool IsValid() const
+	{
+		return (InitializeFunc != nullptr);
+	}
+
+	/** The sample buffer's width and height (in texels of the sample format). */
+	const FIntPoint& GetDim() const
+	{
+		return Dim;
+	}
+
+	/** The sample format of copied and converted frames. */
+	EMediaTextureSampleFormat GetFormat() const
+	{
+		return Format;
+	}
+
+	/** Number of bytes a sample holds per frame. */
+	uint64 GetFrameSize() const;
+
+	/** Number of plane views that may hold a capture buffer, or INDEX_NONE if frames aren't viewed. */
+	int32 GetMaxPlanarViews() const
+	{
+		return PlanarViewBudget.IsValid() ? PlanarViewBudget->GetMaxViews() : INDEX_NONE;
+	}
+
+	/** Whether frames are copied into sample memory, rather than viewed in the capture buffer. */
+	bool IsCopied() const
+	{
+		return (InitializeFunc != nullptr) && !((InitializeFunc == &InitializePlanar) && bAcceptPlanar);
+	}
+
+	/** Duration of a frame, used when the device doesn't report one. */
+	FTimespan GetFrameDuration() const
+	{
+		return FrameDuration;
+	}
+
+	/** Exact frame rate of the format, used for timecodes derived from sample times. */
+	const FFrameRate& GetFrameRate() const
+	{
+		return TimecodeRate;
+	}
+
+private:
+
+	/** Routine that initializes a texture sample with a captured frame. */
+	typedef bool (*FInitializeFunc)(const FDirectShowMediaVideoLayout& Layout, FDirectShowMediaTextureSample& TextureSample, IMediaSample* SourceSample, const void* Buffer, uint32 Size, FTimespan Time, FTimespan Duration);
+
+	/** Copy or convert frames with the kernel. */
+	static bool InitializeWithKernel(const FDirectShowMediaVideoLayout& Layout, FDirectShowMediaTextureSample& TextureSample, IMediaSample* SourceSample, const void* Buffer, uint32 Size, FTimespan Time, FTimespan Duration);
+
+	/** Unpack high bit depth frames. */
+	static bool InitializeUnpacked(const FDirectShowMediaVideoLayout& Layout, FDirectShowMediaTextureSample& TextureSample, IMediaSample* SourceSample, const void* Buffer, uint32 Size, FTimespan Time, FTimespan Duration);
+
+	/** Split planar frames into planes. */
+	static bool InitializePlanar(const FDirectShowMediaVideoLayout& Layout, FDirectShowMediaTextureSample& TextureSample, IMediaSample* SourceSample, const void* Buffer, uint32 Size, FTimespan Time, FTimespan Duration);
+
+private:
+
+	/** The sample buffer's width and height (in texels of Format). */
+	FIntPoint Dim;
+
+	/** The frame size (in pixels). */
+	FIntPoint Resolution;
+
+	/** Number of bytes per row of the sample buffer. */
+	uint32 Stride;
+
+	/** Texture format of copied and converted samples. */
+	EMediaTextureSampleFormat Format;
+
+	/** Number of bytes per row of the captured frames (of the luma plane for planar formats). */
+	uint32 SourceStride;
+
+	/** Number of bytes of pixels in a captured row. */
+	uint32 RowSize;
+
+	/** Format of the captured frames copied or converted by a kernel. */
+	EMediaTextureSampleFormat SourceFormat;
+
+	/** Copies or converts the captured frames into sample buffers. */
+	FDirectShowMediaVideoKernel Kernel;
+
+	/** The aligned variant of the kernel, for upload slots whose pitch it fits. */
+	FDirectShowMediaVideoKernel AlignedKernel;
+
+	/** The row by row variant of the kernel, for upload slots of any pitch. */
+	FDirectShowMediaVideoKernel RowKernel;
+
+	/** Layout of planar formats. */
+	EDirectShowMediaPlanarFormat PlanarFormat;
+
+	/** Layout of high bit depth formats. */
+	EDirectShowMediaHighBitDepthFormat HighBitDepthFormat;
+
+	/** Whether planar formats are delivered as views into the capture buffer. */
+	bool bAcceptPlanar;
+
+	/** Whether 10 bit formats are reduced to 8 bit. */
+	bool bConvertTo8Bit;
+
+	/** The converter used for BGRA conversion. */
+	const FDirectShowMediaColorConverter* Converter;
+
+	/** Duration of a frame. */
+	FTimespan FrameDuration;
+
+	/** Exact frame rate of the format. */
+	FFrameRate TimecodeRate;
+
+	/** The routine for this format, or nullptr if the format isn't supported. */
+	FInitializeFunc InitializeFunc;
+
+	/** The ring kernels write frames into, or nullptr for the sample's buffer. */
+	TSharedPtr<FDirectShowMediaUploadRing, ESPMode::ThreadSafe> UploadRing;
+
+	/** The arena copied and converted frames are stored in, or nullptr for the sample's buffer. */
+	TSharedPtr<FDirectShowMediaFrameArena, ESPMode::ThreadSafe> FrameArena;
+
+	/** The budget plane views reserve their capture buffer from, or nullptr if frames aren't viewed. */
+	TSharedPtr<FDirectShowMediaPlanarViewBudget, ESPMode::ThreadSafe> PlanarViewBudget;
+};
@@ -0,0 +1,279 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "DirectShowMediaVideoUnpacker.h"
+
+#include "Math/UnrealMathUtility.h"
+
+
+namespace DirectShowMediaVideoUnpacker
+{
+	/** 4x4 ordered dither thresholds for dropping the low byte of a 16 bit component. */
+	static const uint16 DitherPattern[4][4] =
+	{
+		{   8, 136,  40, 168 },
+		{ 200,  72, 232, 104 },
+		{  56, 184,  24, 152 },
+		{ 248, 120, 216,  88 }
+	};
+
+	FORCEINLINE uint8 Dither(uint32 Value, uint32 Threshold)
+	{
+		const uint32 Result = (Value + Threshold) >> 8;
+		return (uint8)(Result > 255 ? 255 : Result);
+	}
+}
+
+
+/* FDirectShowMediaVideoUnpacker interface
+ *****************************************************************************/
+
+uint32 FDirectShowMediaVideoUnpacker::GetSourceStride(EDirectShowMediaHighBitDepthFormat Format, int32 Width)
+{
+	switch (Format)
+	{
+	case EDirectShowMediaHighBitDepthFormat::P010:
+		return Width * 2;
+
+	case EDirectShowMediaHighBitDepthFormat::Y210:
+		return Width * 4;
+
+	case EDirectShowMediaHighBitDepthFormat::V210:
+		return ((Width + 47) / 48) * 128; // groups of 48 pixels in 128 bytes
+
+	default:
+		return 0;
+	}
+}
+
+
+EMediaTextureSampleFormat FDirectShowMediaVideoUnpacker::GetOutputFormat(EDirectShowMediaHighBitDepthFormat Format, bool bTo8Bit)
+{
+	switch (Format)
+	{
+	case EDirectShowMediaHighBitDepthFormat::P010:
+		return bTo8Bit ? EMediaTextureSampleFormat::CharNV12 : EMediaTextureSampleFormat::Y416;
+
+	case EDirectShowMediaHighBitDepthFormat::Y210:
+		return bTo8Bit ? EMediaTextureSampleFormat::CharYUY2 : EMediaTextureSampleFormat::Y416;
+
+	case EDirectShowMediaHighBitDepthFormat::V210:
+		return bTo8Bit ? EMediaTextureSampleFormat::CharYUY2 : EMediaTextureSampleFormat::YUVv210;
+
+	default:
+		return EMediaTextureSampleFormat::Undefined;
+	}
+}
+
+
+uint32 FDirectShowMediaVideoUnpacker::GetOutputLayout(EMediaTextureSampleFormat OutputFormat, const FIntPoint& Dim, FIntPoint& OutDim, uint32& OutStride)
+{
+	switch (OutputFormat)
+	{
+	case EMediaTextureSampleFormat::CharNV12:
+		OutDim = FIntPoint(Dim.X, Dim.Y * 3 / 2);
+		OutStride = Dim.X;
+		break;
+
+	case EMediaTextureSampleFormat::CharYUY2:
+		OutDim = FIntPoint(Dim.X / 2, Dim.Y);
+		OutStride = Dim.X * 2;
+		break;
+
+	case EMediaTextureSampleFormat::Y416:
+		OutDim = Dim;
+		OutStride = Dim.X * 8;
+		break;
+
+	default:
+		return 0;
+	}
+
+	return OutStride * OutDim.Y;
+}
+
+
+bool FDirectShowMediaVideoUnpacker::Unpack(EDirectShowMediaHighBitDepthFormat Format, bool bTo8Bit, const uint8* InBuffer, uint32 InSize, uint32 InStride, const FIntPoint& Dim, uint8* OutBuffer)
+{
+	// all three formats subsample chroma horizontally
+	if ((InBuffer == nullptr) || (OutBuffer == nullptr) || (Dim.X <= 0) || (Dim.Y <= 0) || ((Dim.X & 1) != 0))
+	{
+		return false;
+	}
+
+	// drivers may pad the rows beyond the packed row size
+	InStride = FMath::Max(InStride, GetSourceStride(Format, Dim.X));
+	const uint32 NumRows = (Format == EDirectShowMediaHighBitDepthFormat::P010) ? Dim.Y + Dim.Y / 2 : Dim.Y;
+
+	if ((uint64)InStride * NumRows > InSize)
+	{
+		return false;
+	}
+
+	FIntPoint OutDim;
+	uint32 OutStride = 0;
+
+	if (GetOutputLayout(GetOutputFormat(Format, bTo8Bit), Dim, OutDim, OutStride) == 0)
+	{
+		return false; // v210 is handed to the engine as is
+	}
+
+	switch (Format)
+	{
+	case EDirectShowMediaHighBitDepthFormat::P010:
+		if (bTo8Bit)
+		{
+			// both planes have the same row size in bytes, so NV12 is just the dithered high bytes
+			for (uint32 Row = 0; Row < NumRows; ++Row)
+			{
+				DitherRow((const uint16*)(InBuffer + (SIZE_T)Row * InStride), Dim.X, Row, OutBuffer + (SIZE_T)Row * OutStride);
+			}
+		}
+		else
+		{
+			const uint8* ChromaPlane = InBuffer + (SIZE_T)InStride * Dim.Y;
+
+			for (int32 Row = 0; Row < Dim.Y; ++Row)
+			{
+				UnpackP010RowToY416((const uint16*)(InBuffer + (SIZE_T)Row * InStride), (const uint16*)(ChromaPlane + (SIZE_T)(Row / 2) * InStride), Dim.X, (uint16*)(OutBuffer + (SIZE_T)Row * OutStride));
+			}
+		}
+		break;
+
+	case EDirectShowMediaHighBitDepthFormat::Y210:
+		for (int32 Row = 0; Row < Dim.Y; ++Row)
+		{
+			const uint16* InRow = (const uint16*)(InBuffer + (SIZE_T)Row * InStride);
+
+			// Y210 has the component order of YUY2
+			if (bTo8Bit)
+			{
+				DitherRow(InRow, Dim.X * 2, Row, OutBuffer + (SIZE_T)Row * OutStride);
+			}
+			else
+			{
+				UnpackY210RowToY416(InRow, Dim.X, (uint16*)(OutBuffer + (SIZE_T)Row * OutStride));
+			}
+		}
+		break;
+
+	case EDirectShowMediaHighBitDepthFormat::V210:
+		for (int32 Row = 0; Row < Dim.Y; ++Row)
+		{
+			UnpackV210RowToYUY2((const uint32*)(InBuffer + (SIZE_T)Row * InStride), Dim.X, Row, OutBuffer + (SIZE_T)Row * OutStride);
+		}
+		break;
+
+	default:
+		return false;
+	}
+
+	return true;
+}
+
+
+/* FDirectShowMediaVideoUnpacker implementation
+ *****************************************************************************/
+
+void FDirectShowMediaVideoUnpacker::DitherRow(const uint16* InRow, int32 Count, int32 Row, uint8* OutRow)
+{
+	using namespace DirectShowMediaVideoUnpacker;
+
+	const uint32 T0 = DitherPattern[Row & 3][0];
+	const uint32 T1 = DitherPattern[Row & 3][1];
+	const uint32 T2 = DitherPattern[Row & 3][2];
+	const uint32 T3 = DitherPattern[Row & 3][3];
+
+	int32 Index = 0;
+
+	for (; Index + 4 <= Count; Index += 4)
+	{
+		OutRow[Index + 0] = Dither(InRow[Index + 0], T0);
+		OutRow[Index + 1] = Dither(InRow[Index + 1], T1);
+		OutRow[Index + 2] = Dither(InRow[Index + 2], T2);
+		OutRow[Index + 3] = Dither(InRow[Index + 3], T3);
+	}
+
+	for (; Index < Count; ++Index)
+	{
+		OutRow[Index] = Dither(InRow[Index], DitherPattern[Row & 3][Index & 3]);
+	}
+}
+
+
+void FDirectShowMediaVideoUnpacker::UnpackP010RowToY416(const uint16* InLumaRow, const uint16* InChromaRow, int32 Width, uint16* OutRow)
+{
+	for (int32 X = 0; X < Width; X += 2, InLumaRow += 2, InChromaRow += 2, OutRow += 8)
+	{
+		const uint16 U = InChromaRow[0];
+		const uint16 V = InChromaRow[1];
+
+		OutRow[0] = U;
+		OutRow[1] = InLumaRow[0];
+		OutRow[2] = V;
+		OutRow[3] = 0xffff;
+		OutRow[4] = U;
+		OutRow[5] = InLumaRow[1];
+		OutRow[6] = V;
+		OutRow[7] = 0xffff;
+	}
+}
+
+
+void FDirectShowMediaVideoUnpacker::UnpackY210RowToY416(const uint16* InRow, int32 Width, uint16* OutRow)
+{
+	for (int32 X = 0; X < Width; X += 2, InRow += 4, OutRow += 8)
+	{
+		const uint16 U = InRow[1];
+		const uint16 V = InRow[3];
+
+		OutRow[0] = U;
+		OutRow[1] = InRow[0];
+		OutRow[2] = V;
+		OutRow[3] = 0xffff;
+		OutRow[4] = U;
+		OutRow[5] = InRow[2];
+		OutRow[6] = V;
+		OutRow[7] = 0xffff;
+	}
+}
+
+
+void FDirectShowMediaVideoUnpacker::UnpackV210RowToYUY2(const uint32* InRow, int32 Width, int32 Row, uint8* OutRow)
+{
+	using namespace DirectShowMediaVideoUnpacker;
+
+	// a group is twelve output bytes, so every group starts at the same dither phase
+	const uint16* Thresholds = DitherPattern[Row & 3];
+
+	for (int32 X = 0; X < Width; X += 6, InRow += 4, OutRow += 12)
+	{
+		const uint32 W0 = InRow[0];
+		const uint32 W1 = InRow[1];
+		const uint32 W2 = InRow[2];
+		const uint32 W3 = InRow[3];
+
+		// w0 = Cb0 Y0 Cr0, w1 = Y1 Cb1 Y2, w2 = Cr1 Y3 Cb2, w3 = Y4 Cr2 Y5 (10 bits each, lowest first)
+		const uint32 Components[12] =
+		{
+			((W0 >> 10) & 0x3ff) << 6,  // Y0
+			(W0 & 0x3ff) << 6,          // Cb0
+			(W1 & 0x3ff) << 6,          // Y1
+			((W0 >> 20) & 0x3ff) << 6,  // Cr0
+			((W1 >> 20) & 0x3ff) << 6,  // Y2
+			((W1 >> 10) & 0x3ff) << 6,  // Cb1
+			((W2 >> 10) & 0x3ff) << 6,  // Y3
+			(W2 & 0x3ff) << 6,          // Cr1
+			(W3 & 0x3ff) << 6,          // Y4
+			((W2 >> 20) & 0x3ff) << 6,  // Cb2
+			((W3 >> 20) & 0x3ff) << 6,  // Y5
+			((W3 >> 10) & 0x3ff) << 6   // Cr2
+		};
+
+		const int32 Count = FMath::Min(Width - X, 6) * 2;
+
+		for (int32 Index = 0; Index < Count; ++Index)
+		{
+			OutRow[Index] = Dither(Components[Index], Thresholds[Index & 3]);
+		}
+	}
+}
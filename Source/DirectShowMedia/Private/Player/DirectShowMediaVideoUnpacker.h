@@ -0,0 +1,93 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreTypes.h"
+#include "IMediaTextureSample.h"
+#include "Math/IntPoint.h"
+
+
+/** High bit depth YUV formats delivered by capture devices. */
+enum class EDirectShowMediaHighBitDepthFormat : uint8
+{
+	/** 4:2:0, a 16 bit luma plane followed by an interleaved 16 bit UV plane (10 significant bits). */
+	P010,
+
+	/** 4:2:2, packed 16 bit Y0 U Y1 V (10 significant bits). */
+	Y210,
+
+	/** 4:2:2, six pixels packed into four little endian 32 bit words of three 10 bit components. */
+	V210
+};
+
+
+/**
+ * Unpacks high bit depth YUV frames into formats the engine can display.
+ *
+ * By default frames go to the engine's 16 bit Y416 format (U, Y, V, A words, chroma replicated to every pixel),
+ * except v210 which the engine reads natively. When 8 bit output is requested, P010 becomes NV12 and Y210 and
+ * v210 become YUY2, rounded with a 4x4 ordered dither so that gradients don't band.
+ *
+ * The kernels work on whole rows with a fixed dither phase per lane, so compilers vectorize the inner loops.
+ */
+class FDirectShowMediaVideoUnpacker
+{
+public:
+
+	/**
+	 * Get the number of bytes per row of a source frame.
+	 *
+	 * @param Format The source format.
+	 * @param Width The frame width (in pixels).
+	 * @return Row size (of the luma plane for P010).
+	 */
+	static uint32 GetSourceStride(EDirectShowMediaHighBitDepthFormat Format, int32 Width);
+
+	/**
+	 * Get the sample format a source format is unpacked to.
+	 *
+	 * @param Format The source format.
+	 * @param bTo8Bit Whether 8 bit output was requested.
+	 * @return The sample format.
+	 */
+	static EMediaTextureSampleFormat GetOutputFormat(EDirectShowMediaHighBitDepthFormat Format, bool bTo8Bit);
+
+	/**
+	 * Get the buffer layout of an unpacked frame.
+	 *
+	 * @param OutputFormat The sample format.
+	 * @param Dim The frame's width and height (in pixels).
+	 * @param OutDim Will contain the sample buffer's width and height (in texels).
+	 * @param OutStride Will contain the number of bytes per row.
+	 * @return Size of the sample buffer (in bytes), or zero if the format isn't produced by the unpacker.
+	 */
+	static uint32 GetOutputLayout(EMediaTextureSampleFormat OutputFormat, const FIntPoint& Dim, FIntPoint& OutDim, uint32& OutStride);
+
+	/**
+	 * Unpack a frame.
+	 *
+	 * @param Format The source format.
+	 * @param bTo8Bit Whether to unpack to 8 bit.
+	 * @param InBuffer The source frame.
+	 * @param InSize Size of the source frame (in bytes).
+	 * @param InStride Number of bytes per source row (of the luma plane for P010), or 0 if the rows are tightly packed.
+	 * @param Dim The frame's width and height (in pixels).
+	 * @param OutBuffer The output, GetOutputLayout bytes.
+	 * @return true if the frame was unpacked, false if the source is too small or can't be unpacked to the requested depth.
+	 */
+	static bool Unpack(EDirectShowMediaHighBitDepthFormat Format, bool bTo8Bit, const uint8* InBuffer, uint32 InSize, uint32 InStride, const FIntPoint& Dim, uint8* OutBuffer);
+
+private:
+
+	/** Reduce a row of 16 bit components to 8 bit with the dither phase of the given row. */
+	static void DitherRow(const uint16* InRow, int32 Count, int32 Row, uint8* OutRow);
+
+	/** Expand a row of P010 to Y416. */
+	static void UnpackP010RowToY416(const uint16* InLumaRow, const uint16* InChromaRow, int32 Width, uint16* OutRow);
+
+	/** Expand a row of Y210 to Y416. */
+	static void UnpackY210RowToY416(const uint16* InRow, int32 Width, uint16* OutRow);
+
+	/** Unpack a row of v210 to YUY2 with the dither phase of the given row. */
+	static void UnpackV210RowToYUY2(const uint32* InRow, int32 Width, int32 Row, uint8* OutRow);
+};
@@ -0,0 +1,77 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreTypes.h"
+#include "IMediaTextureSample.h"
+#include "Math/IntPoint.h"
+
+class FRHITexture;
+
+
+/**
+ * Interface for the staging memory and textures behind an upload ring.
+ *
+ * A backend owns a fixed number of slots, each a texture and staging memory that can be mapped for writing.
+ * Mapping and submitting may complete asynchronously (i.e. on the render thread), in the order they were
+ * requested per slot: a slot's mapped memory is only reported once the previous submission of the slot was
+ * consumed. The ring does all bookkeeping; backends only carry out the requests.
+ *
+ * @see FDirectShowMediaUploadRing
+ */
+class IDirectShowMediaUploadBackend
+{
+public:
+
+	/**
+	 * Create the slots.
+	 *
+	 * @param NumSlots The number of slots.
+	 * @param Dim The textures' width and height (in texels of Format).
+	 * @param Format The sample format the textures hold.
+	 * @return true on success, false if the format can't be uploaded.
+	 */
+	virtual bool CreateSlots(int32 NumSlots, const FIntPoint& Dim, EMediaTextureSampleFormat Format) = 0;
+
+	/** Release the slots, unmapping the mapped ones (slots must not be written anymore). */
+	virtual void ReleaseSlots() = 0;
+
+	/**
+	 * Request the mapping of a slot's staging memory.
+	 *
+	 * @param SlotIndex The slot to map.
+	 * @see GetMappedData
+	 */
+	virtual void MapSlot(int32 SlotIndex) = 0;
+
+	/**
+	 * Get the mapped staging memory of a slot.
+	 *
+	 * @param SlotIndex The slot.
+	 * @param OutStride Will contain the number of bytes per row of the staging memory.
+	 * @return The staging memory, or nullptr if the mapping didn't complete yet.
+	 */
+	virtual uint8* GetMappedData(int32 SlotIndex, uint32& OutStride) const = 0;
+
+	/**
+	 * Unmap a slot and request the upload of its staging memory into its texture.
+	 *
+	 * The mapped memory is no longer reported once this returns.
+	 *
+	 * @param SlotIndex The slot to submit.
+	 */
+	virtual void SubmitSlot(int32 SlotIndex) = 0;
+
+	/**
+	 * Get the texture of a slot.
+	 *
+	 * @param SlotIndex The slot.
+	 * @return The texture, or nullptr if the backend doesn't create any.
+	 */
+	virtual FRHITexture* GetTexture(int32 SlotIndex) const = 0;
+
+public:
+
+	/** Virtual destructor. */
+	virtual ~IDirectShowMediaUploadBackend() { }
+};
@@ -0,0 +1,382 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "CoreTypes.h"
+#include "HAL/PlatformTime.h"
+#include "IMediaCaptureSupport.h"
+#include "Misc/AutomationTest.h"
+
+#include "DirectShowDeviceTable.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+
+namespace DirectShowDeviceTableTest
+{
+	/** The properties a device's moniker reports. */
+	struct FFakeDevice
+	{
+		const TCHAR* FriendlyName;
+		const TCHAR* Description;
+		const TCHAR* DevicePath;
+
+		/** Whether the device's filter has a capture pin. */
+		bool bHasCapturePin = true;
+	};
+
+	/** The devices a fake system reports, per device class. */
+	struct FFakeSystem
+	{
+		TArray<FFakeDevice> Devices[(int32)EDirectShowDeviceClass::Num];
+
+		/** Route a table's enumeration to this system. */
+		void Install(FDirectShowDeviceTable& Table)
+		{
+			Table.SetEnumerator([this, &Table](EDirectShowDeviceClass DeviceClass)
+			{
+				for (const FFakeDevice& Device : Devices[(int32)DeviceClass])
+				{
+					Table.AddDevice(DeviceClass, Device.FriendlyName, Device.Description, Device.DevicePath, nullptr, Device.bHasCapturePin);
+				}
+			});
+		}
+	};
+
+	const TCHAR* CamLinkPath = TEXT("\\\\?\\usb#vid_0fd9&pid_0066&mi_00#7&1b2a3c4d&0&0000#{65e8773d-8f56-11d0-a3b9-00a0c9223196}\\global");
+	const TCHAR* LaptopCameraPath = TEXT("\\\\?\\usb#vid_04f2&pid_b6d9&mi_00#6&2c3d4e5f&0&0000#{65e8773d-8f56-11d0-a3b9-00a0c9223196}\\global");
+	const TCHAR* GrabberPath = TEXT("\\\\?\\usb#vid_534d&pid_2109&mi_00#8&3d4e5f60&0&0000#{65e8773d-8f56-11d0-a3b9-00a0c9223196}\\global");
+	const TCHAR* GrabberAudioPath = TEXT("\\\\?\\usb#vid_534d&pid_2109&mi_02#8&3d4e5f60&0&0002#{33d9a762-90c8-11d0-bd43-00a0c911ce86}\\global");
+	const TCHAR* HeadsetPath = TEXT("\\\\?\\usb#vid_1b1c&pid_0a51&mi_00#9&4e5f6071&0&0000#{33d9a762-90c8-11d0-bd43-00a0c911ce86}\\global");
+
+	/** A system with a capture card, a laptop camera, a virtual camera and a USB grabber, and their audio inputs. */
+	void MakeSystem(FFakeSystem& OutSystem)
+	{
+		OutSystem.Devices[(int32)EDirectShowDeviceClass::Video] =
+		{
+			{ TEXT("Cam Link 4K"), nullptr, CamLinkPath },
+			{ TEXT("Integrated Camera"), TEXT("Lenovo EasyCamera"), LaptopCameraPath },
+			{ TEXT("OBS Virtual Camera"), nullptr, nullptr },
+			{ TEXT("USB Video"), nullptr, GrabberPath },
+		};
+
+		OutSystem.Devices[(int32)EDirectShowDeviceClass::Audio] =
+		{
+			{ TEXT("Microphone Array (Realtek(R) Audio)"), nullptr, nullptr },
+			{ TEXT("Digital Audio Interface"), TEXT("Digital Audio Interface (Cam Link 4K)"), nullptr },
+			{ TEXT("USB Video"), nullptr, HeadsetPath },
+			{ TEXT("Line In (MS2109)"), nullptr, GrabberAudioPath },
+		};
+	}
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDirectShowDeviceTableResolveTest, "DirectShowMedia.DeviceTable.Resolve", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FDirectShowDeviceTableResolveTest::RunTest(const FString& Parameters)
+{
+	using namespace DirectShowDeviceTableTest;
+
+	FFakeSystem System;
+	MakeSystem(System);
+
+	FDirectShowDeviceTable Table;
+	System.Install(Table);
+
+	struct FCase
+	{
+		const TCHAR* UrlOrName;
+		int32 Index;
+	};
+
+	const FCase Cases[] =
+	{
+		// urls are matched exactly
+		{ CamLinkPath, 0 },
+		{ GrabberPath, 3 },
+		{ TEXT("OBS Virtual Camera"), 2 }, // no device path, the name is the url
+
+		// names case insensitively, the friendly name and the description
+		{ TEXT("Integrated Camera"), 1 },
+		{ TEXT("integrated CAMERA"), 1 },
+		{ TEXT("lenovo easycamera"), 1 },
+		{ TEXT("usb video"), 3 },
+
+		// then the first device that contains the string
+		{ TEXT("Virtual"), 2 },
+		{ TEXT("cam"), 0 },
+		{ TEXT("EasyCam"), 1 },
+
+		// nothing
+		{ TEXT("Elgato HD60 S+"), INDEX_NONE },
+		{ TEXT(""), INDEX_NONE },
+	};
+
+	for (const FCase& Case : Cases)
+	{
+		FDirectShowDeviceId DeviceId;
+		const bool bResolved = Table.Resolve(EDirectShowDeviceClass::Video, Case.UrlOrName, DeviceId);
+
+		TestEqual(FString::Printf(TEXT("'%s' resolves"), Case.UrlOrName), bResolved, Case.Index != INDEX_NONE);
+
+		if (bResolved)
+		{
+			TestEqual(FString::Printf(TEXT("'%s' resolves to device %d"), Case.UrlOrName, Case.Index), DeviceId.Index, Case.Index);
+			TestTrue(FString::Printf(TEXT("'%s' resolves to a video device"), Case.UrlOrName), DeviceId.DeviceClass == EDirectShowDeviceClass::Video);
+		}
+	}
+
+	// the media framework sees urls and friendly names
+	TArray<FMediaCaptureDeviceInfo> DeviceInfos;
+	Table.GetDeviceInfos(EDirectShowDeviceClass::Video, DeviceInfos);
+
+	if (TestEqual(TEXT("All video devices are listed"), DeviceInfos.Num(), 4))
+	{
+		TestEqual(TEXT("Devices are listed by their path"), DeviceInfos[0].Url, FString(CamLinkPath));
+		TestEqual(TEXT("Devices are listed by their friendly name"), DeviceInfos[1].DisplayName.ToString(), FString(TEXT("Integrated Camera")));
+		TestEqual(TEXT("Devices without a path are listed by name"), DeviceInfos[2].Url, FString(TEXT("OBS Virtual Camera")));
+	}
+
+	// devices the table hasn't seen are enumerated
+	System.Devices[(int32)EDirectShowDeviceClass::Video].Add({ TEXT("Elgato HD60 S+"), nullptr, nullptr });
+
+	FDirectShowDeviceId DeviceId;
+
+	if (TestTrue(TEXT("A device plugged in since is found"), Table.Resolve(EDirectShowDeviceClass::Video, TEXT("Elgato HD60 S+"), DeviceId)))
+	{
+		TestEqual(TEXT("A device plugged in since is added"), DeviceId.Index, 4);
+	}
+
+	return true;
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDirectShowDeviceTableAudioPairTest, "DirectShowMedia.DeviceTable.AudioPairs", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FDirectShowDeviceTableAudioPairTest::RunTest(const FString& Parameters)
+{
+	using namespace DirectShowDeviceTableTest;
+
+	FFakeSystem System;
+	MakeSystem(System);
+
+	FDirectShowDeviceTable Table;
+	System.Install(Table);
+
+	struct FCase
+	{
+		const TCHAR* VideoName;
+		const TCHAR* AudioName;
+	};
+
+	const FCase Cases[] =
+	{
+		// the video name in the audio description
+		{ TEXT("Cam Link 4K"), TEXT("Digital Audio Interface") },
+
+		// the same USB vendor and product wins over a device with the same name
+		{ TEXT("USB Video"), TEXT("Line In (MS2109)") },
+
+		// no shared words
+		{ TEXT("Integrated Camera"), nullptr },
+		{ TEXT("OBS Virtual Camera"), nullptr },
+	};
+
+	for (const FCase& Case : Cases)
+	{
+		FDirectShowDeviceId VideoDeviceId;
+
+		if (!TestTrue(FString::Printf(TEXT("'%s' resolves"), Case.VideoName), Table.Resolve(EDirectShowDeviceClass::Video, Case.VideoName, VideoDeviceId)))
+		{
+			continue;
+		}
+
+		FDirectShowDeviceId AudioDeviceId;
+		const bool bPaired = Table.FindAudioDevice(VideoDeviceId, AudioDeviceId);
+
+		TestEqual(FString::Printf(TEXT("'%s' is paired"), Case.VideoName), bPaired, Case.AudioName != nullptr);
+
+		FString AudioName;
+
+		if (bPaired && Table.GetFriendlyName(AudioDeviceId, AudioName))
+		{
+			TestEqual(FString::Printf(TEXT("'%s' is paired with '%s'"), Case.VideoName, Case.AudioName), AudioName, FString(Case.AudioName));
+		}
+	}
+
+	FDirectShowDeviceId AudioDeviceId;
+	TestFalse(TEXT("Audio devices don't pair"), Table.FindAudioDevice(FDirectShowDeviceId{ EDirectShowDeviceClass::Audio, 0 }, AudioDeviceId));
+
+	return true;
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDirectShowDeviceTableIdentityTest, "DirectShowMedia.DeviceTable.Identity", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FDirectShowDeviceTableIdentityTest::RunTest(const FString& Parameters)
+{
+	using namespace DirectShowDeviceTableTest;
+
+	FFakeSystem System;
+	MakeSystem(System);
+
+	FDirectShowDeviceTable Table;
+	System.Install(Table);
+
+	TArray<FDirectShowDeviceId> DeviceIds;
+
+	for (const FFakeDevice& Device : System.Devices[(int32)EDirectShowDeviceClass::Video])
+	{
+		FDirectShowDeviceId DeviceId;
+		TestTrue(FString::Printf(TEXT("'%s' resolves"), Device.FriendlyName), Table.Resolve(EDirectShowDeviceClass::Video, Device.FriendlyName, DeviceId));
+		DeviceIds.Add(DeviceId);
+	}
+
+	// adding a known device again updates it in place
+	Table.AddDevice(EDirectShowDeviceClass::Video, TEXT("Cam Link 4K (renamed)"), nullptr, CamLinkPath, nullptr);
+
+	FDirectShowDeviceId DeviceId;
+	FString FriendlyName;
+
+	TestTrue(TEXT("A re-added device resolves by url"), Table.Resolve(EDirectShowDeviceClass::Video, CamLinkPath, DeviceId) && (DeviceId.Index == DeviceIds[0].Index));
+	TestTrue(TEXT("A re-added device takes its new name"), Table.GetFriendlyName(DeviceIds[0], FriendlyName) && (FriendlyName == TEXT("Cam Link 4K (renamed)")));
+	TestTrue(TEXT("A re-added device resolves by its new name"), Table.Resolve(EDirectShowDeviceClass::Video, TEXT("cam link 4k (RENAMED)"), DeviceId) && (DeviceId.Index == DeviceIds[0].Index));
+
+	TArray<FMediaCaptureDeviceInfo> DeviceInfos;
+	Table.GetDeviceInfos(EDirectShowDeviceClass::Video, DeviceInfos);
+	TestEqual(TEXT("A re-added device is listed once"), DeviceInfos.Num(), 4);
+
+	// unplugged devices keep their identity but no longer resolve
+	const FFakeDevice LaptopCamera = System.Devices[(int32)EDirectShowDeviceClass::Video][1];
+	System.Devices[(int32)EDirectShowDeviceClass::Video].RemoveAt(1);
+	Table.Refresh(EDirectShowDeviceClass::Video);
+
+	TestFalse(TEXT("An unplugged device doesn't resolve"), Table.Resolve(EDirectShowDeviceClass::Video, TEXT("Integrated Camera"), DeviceId));
+	TestTrue(TEXT("An unplugged device keeps its name"), Table.GetFriendlyName(DeviceIds[1], FriendlyName) && (FriendlyName == TEXT("Integrated Camera")));
+
+	DeviceInfos.Reset();
+	Table.GetDeviceInfos(EDirectShowDeviceClass::Video, DeviceInfos);
+	TestEqual(TEXT("An unplugged device isn't listed"), DeviceInfos.Num(), 3);
+
+	// plugged back in, enumerated in another order
+	System.Devices[(int32)EDirectShowDeviceClass::Video].Insert(LaptopCamera, 0);
+	Table.Refresh(EDirectShowDeviceClass::Video);
+
+	for (int32 Index = 0; Index < DeviceIds.Num(); ++Index)
+	{
+		const FFakeDevice& Device = System.Devices[(int32)EDirectShowDeviceClass::Video][(Index == 1) ? 0 : ((Index == 0) ? 1 : Index)];
+		const TCHAR* UrlOrName = (Device.DevicePath != nullptr) ? Device.DevicePath : Device.FriendlyName;
+
+		TestTrue(FString::Printf(TEXT("'%s' keeps its identity"), Device.FriendlyName), Table.Resolve(EDirectShowDeviceClass::Video, UrlOrName, DeviceId) && (DeviceId.Index == DeviceIds[Index].Index));
+	}
+
+	// a reset invalidates the identities
+	Table.Reset(EDirectShowDeviceClass::Video);
+	TestFalse(TEXT("Identities are invalid after a reset"), Table.GetFriendlyName(DeviceIds[0], FriendlyName));
+
+	return true;
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDirectShowDeviceTableListingTest, "DirectShowMedia.DeviceTable.Listing", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FDirectShowDeviceTableListingTest::RunTest(const FString& Parameters)
+{
+	using namespace DirectShowDeviceTableTest;
+
+	// a studio machine with 64 video devices, every fourth one a filter without a capture pin (i.e. a crossbar)
+	const int32 NumDevices = 64;
+
+	TArray<FString> Names;
+	TArray<FString> Paths;
+
+	for (int32 Index = 0; Index < NumDevices; ++Index)
+	{
+		Names.Add(FString::Printf(TEXT("Capture Card %d Input %d"), Index / 4, Index % 4));
+		Paths.Add(FString::Printf(TEXT("\\\\?\\pci#ven_1cd7&dev_0010&subsys_%04x#4&1b2a3c4d&0&%04x#{65e8773d-8f56-11d0-a3b9-00a0c9223196}\\global"), Index / 4, Index));
+	}
+
+	FFakeSystem System;
+
+	for (int32 Index = 0; Index < NumDevices; ++Index)
+	{
+		System.Devices[(int32)EDirectShowDeviceClass::Video].Add({ *Names[Index], nullptr, *Paths[Index], (Index % 4) != 3 });
+	}
+
+	FDirectShowDeviceTable Table;
+	System.Install(Table);
+
+	TArray<FMediaCaptureDeviceInfo> DeviceInfos;
+	Table.Refresh(EDirectShowDeviceClass::Video);
+	Table.GetDeviceInfos(EDirectShowDeviceClass::Video, DeviceInfos);
+
+	int32 NumMismatches = 0;
+
+	for (const FMediaCaptureDeviceInfo& Info : DeviceInfos)
+	{
+		const int32 Index = Paths.Find(Info.Url);
+
+		if ((Index == INDEX_NONE) || (Index % 4 == 3) || !Info.DisplayName.ToString().Equals(Names[Index]))
+		{
+			++NumMismatches;
+		}
+	}
+
+	TestEqual(TEXT("Devices with a capture pin are listed"), DeviceInfos.Num(), NumDevices * 3 / 4);
+	TestEqual(TEXT("Devices without a capture pin aren't listed"), NumMismatches, 0);
+
+	FDirectShowDeviceId DeviceId;
+	TestTrue(TEXT("Devices without a capture pin still resolve"), Table.Resolve(EDirectShowDeviceClass::Video, Paths[3], DeviceId));
+
+	// the flag follows the latest enumeration
+	System.Devices[(int32)EDirectShowDeviceClass::Video][3].bHasCapturePin = true;
+	System.Devices[(int32)EDirectShowDeviceClass::Video][0].bHasCapturePin = false;
+
+	DeviceInfos.Reset();
+	Table.Refresh(EDirectShowDeviceClass::Video);
+	Table.GetDeviceInfos(EDirectShowDeviceClass::Video, DeviceInfos);
+
+	TestTrue(TEXT("A device that gained a capture pin is listed"), DeviceInfos.ContainsByPredicate([&Paths](const FMediaCaptureDeviceInfo& Info) { return Info.Url == Paths[3]; }));
+	TestFalse(TEXT("A device that lost its capture pin isn't listed"), DeviceInfos.ContainsByPredicate([&Paths](const FMediaCaptureDeviceInfo& Info) { return Info.Url == Paths[0]; }));
+
+	// listing as the module does, and as it did with a lookup per listed device before binding its filter
+	const int32 NumListings = 2000;
+
+	auto MeasureMicrosecondsPerListing = [&Table, NumListings](bool bResolveEach, int32& OutNumListed)
+	{
+		int32 NumListed = 0;
+		const double StartTime = FPlatformTime::Seconds();
+
+		for (int32 Listing = 0; Listing < NumListings; ++Listing)
+		{
+			TArray<FMediaCaptureDeviceInfo> Infos;
+			Table.Refresh(EDirectShowDeviceClass::Video);
+			Table.GetDeviceInfos(EDirectShowDeviceClass::Video, Infos);
+
+			for (const FMediaCaptureDeviceInfo& Info : Infos)
+			{
+				FDirectShowDeviceId InfoDeviceId;
+				NumListed += (!bResolveEach || Table.Resolve(EDirectShowDeviceClass::Video, Info.Url, InfoDeviceId)) ? 1 : 0;
+			}
+		}
+
+		OutNumListed = NumListed / NumListings;
+
+		return (FPlatformTime::Seconds() - StartTime) * 1.0e6 / NumListings;
+	};
+
+	int32 NumListed = 0;
+	int32 NumResolved = 0;
+
+	const double ListingCost = MeasureMicrosecondsPerListing(false, NumListed);
+	const double ResolvedListingCost = MeasureMicrosecondsPerListing(true, NumResolved);
+
+	AddInfo(FString::Printf(TEXT("Listing %d of %d devices costs %.1f us, %.1f us with a lookup per device (not counting the filter bind it was for)"), NumListed, NumDevices, ListingCost, ResolvedListingCost));
+
+	// generous bounds, so debug builds and loaded machines pass while a pass over the system per device doesn't
+	TestEqual(TEXT("Every listed device resolves"), NumResolved, NumListed);
+	TestTrue(FString::Printf(TEXT("Listing is a single pass over the devices (%.1f us)"), ListingCost), ListingCost < 1000.0);
+
+	return true;
+}
+
+
+#endif //WITH_DEV_AUTOMATION_TESTS
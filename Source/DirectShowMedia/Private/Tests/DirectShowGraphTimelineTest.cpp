@@ -0,0 +1,221 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "CoreTypes.h"
+#include "Misc/AutomationTest.h"
+
+#include "DirectShowGraphTimeline.h"
+#include "HAL/PlatformProcess.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+
+namespace DirectShowGraphTimelineTest
+{
+	/** A step of the fake device's open: how long it takes and what it reports. */
+	struct FFakeStep
+	{
+		const TCHAR* Name;
+		float Seconds;
+		HRESULT Result;
+	};
+
+	/**
+	 * Opens a fake device, recording the steps the way FDirectShowVideoDevice::Initialize does.
+	 *
+	 * Each step sleeps for its time and reports its HRESULT; the open stops at the first failing step.
+	 */
+	class FFakeDevice
+	{
+	public:
+
+		/** Open the device with the given steps, nested in InitializeGraph like the device's graph setup. */
+		bool Open(const FString& Url, const TArray<FFakeStep>& GraphSteps, const FFakeStep& StartStep)
+		{
+			OpenTimeline.SetLabel(Url);
+			FDirectShowGraphScopedStep OpenStep(OpenTimeline, TEXT("Open"));
+
+			{
+				HRESULT HResult = S_OK;
+				FDirectShowGraphScopedStep GraphStep(OpenTimeline, TEXT("InitializeGraph"), HResult);
+
+				for (const FFakeStep& Step : GraphSteps)
+				{
+					HResult = RunStep(Step);
+
+					if (FAILED(HResult))
+					{
+						return false;
+					}
+				}
+			}
+
+			if (FAILED(RunStep(StartStep)))
+			{
+				return false;
+			}
+
+			return OpenStep.SetSucceeded(true);
+		}
+
+		/** The device's timeline. */
+		FDirectShowGraphTimeline OpenTimeline;
+
+	private:
+
+		/** Run a step in its own scope. */
+		HRESULT RunStep(const FFakeStep& FakeStep)
+		{
+			FDirectShowGraphScopedStep Step(OpenTimeline, FakeStep.Name);
+			FPlatformProcess::Sleep(FakeStep.Seconds);
+
+			return Step.SetResult(FakeStep.Result);
+		}
+	};
+
+	/** Find a recorded step by name. */
+	const FDirectShowGraphStep* FindStep(const TArray<FDirectShowGraphStep>& Steps, const TCHAR* Name)
+	{
+		return Steps.FindByPredicate([Name](const FDirectShowGraphStep& Step) { return FCString::Strcmp(Step.Name, Name) == 0; });
+	}
+
+	/** Slack allowed on top of a step's time for the scheduler (in seconds). */
+	const double Slack = 0.05;
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDirectShowGraphTimelineStepsTest, "DirectShowMedia.GraphTimeline.Steps", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FDirectShowGraphTimelineStepsTest::RunTest(const FString& Parameters)
+{
+	using namespace DirectShowGraphTimelineTest;
+
+	const TArray<FFakeStep> GraphSteps =
+	{
+		{ TEXT("ResolveDevice"), 0.005f, S_OK },
+		{ TEXT("BindDevice"), 0.02f, S_OK },
+		{ TEXT("SetFormat"), 0.01f, S_OK },
+		{ TEXT("ConnectVideoGraph"), 0.03f, S_FALSE },
+	};
+
+	FFakeDevice Device;
+	TestTrue(TEXT("The fake device opens"), Device.Open(TEXT("video://Fake Camera"), GraphSteps, { TEXT("Start"), 0.015f, S_OK }));
+
+	TArray<FDirectShowGraphStep> Steps;
+	Device.OpenTimeline.GetSteps(Steps);
+
+	TestEqual(TEXT("Every step is recorded"), Steps.Num(), 7);
+	TestEqual(TEXT("The open is counted"), Device.OpenTimeline.GetNumOpens(), 1u);
+	TestEqual(TEXT("The label is kept"), Device.OpenTimeline.GetLabel(), FString(TEXT("video://Fake Camera")));
+
+	if (Steps.Num() != 7)
+	{
+		return false;
+	}
+
+	// the steps take the time the device spent in them
+	for (const FFakeStep& FakeStep : GraphSteps)
+	{
+		const FDirectShowGraphStep* Step = FindStep(Steps, FakeStep.Name);
+
+		if (TestNotNull(FString::Printf(TEXT("%s is recorded"), FakeStep.Name), Step))
+		{
+			TestTrue(FString::Printf(TEXT("%s takes its time (%.1f ms)"), FakeStep.Name, Step->Duration * 1000.0), (Step->Duration >= FakeStep.Seconds - 0.001) && (Step->Duration < FakeStep.Seconds + Slack));
+			TestEqual(FString::Printf(TEXT("%s is nested in InitializeGraph"), FakeStep.Name), Step->Depth, 2);
+			TestTrue(FString::Printf(TEXT("%s succeeded"), FakeStep.Name), Step->bSucceeded);
+			TestEqual(FString::Printf(TEXT("%s keeps its HRESULT"), FakeStep.Name), (uint32)Step->Result, (uint32)FakeStep.Result);
+		}
+	}
+
+	// the tree: the open contains the graph and the start, the graph its steps, in the order they began
+	const FDirectShowGraphStep& Open = Steps[0];
+	const FDirectShowGraphStep& Graph = Steps[1];
+	const FDirectShowGraphStep& Start = Steps[6];
+
+	TestTrue(TEXT("The open is the outermost step"), (FCString::Strcmp(Open.Name, TEXT("Open")) == 0) && (Open.Depth == 0) && (Open.StartTime == 0.0));
+	TestTrue(TEXT("The open succeeded"), Open.bSucceeded);
+	TestEqual(TEXT("The graph is a step of the open"), Graph.Depth, 1);
+	TestEqual(TEXT("The start is a step of the open"), Start.Depth, 1);
+
+	double Children = 0.0;
+
+	for (int32 Index = 1; Index < Steps.Num(); ++Index)
+	{
+		TestTrue(FString::Printf(TEXT("%s begins after %s"), Steps[Index].Name, Steps[Index - 1].Name), Steps[Index].StartTime >= Steps[Index - 1].StartTime);
+		Children += (Steps[Index].Depth == 2) ? Steps[Index].Duration : 0.0;
+	}
+
+	TestTrue(TEXT("The graph step covers its steps"), Graph.Duration >= Children);
+	TestTrue(TEXT("The open covers the graph and the start"), Open.Duration >= Graph.Duration + Start.Duration);
+	TestTrue(FString::Printf(TEXT("The open takes the time of its steps (%.1f ms)"), Open.Duration * 1000.0), (Open.Duration >= 0.079) && (Open.Duration < 0.08 + 2.0 * Slack));
+
+	return true;
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDirectShowGraphTimelineFailureTest, "DirectShowMedia.GraphTimeline.Failure", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FDirectShowGraphTimelineFailureTest::RunTest(const FString& Parameters)
+{
+	using namespace DirectShowGraphTimelineTest;
+
+	FFakeDevice Device;
+	Device.Open(TEXT("video://First"), { { TEXT("ResolveDevice"), 0.0f, S_OK } }, { TEXT("Start"), 0.0f, S_OK });
+
+	// the device can't be bound, which fails the graph and the open
+	const TArray<FFakeStep> GraphSteps =
+	{
+		{ TEXT("ResolveDevice"), 0.0f, S_OK },
+		{ TEXT("BindDevice"), 0.01f, E_FAIL },
+		{ TEXT("SetFormat"), 0.0f, S_OK },
+	};
+
+	TestFalse(TEXT("The open fails"), Device.Open(TEXT("video://\"Broken\" Camera"), GraphSteps, { TEXT("Start"), 0.0f, S_OK }));
+
+	TArray<FDirectShowGraphStep> Steps;
+	Device.OpenTimeline.GetSteps(Steps);
+
+	TestEqual(TEXT("Both opens are counted"), Device.OpenTimeline.GetNumOpens(), 2u);
+	TestEqual(TEXT("A new open replaces the previous one, and stops at the failing step"), Steps.Num(), 4);
+
+	const FDirectShowGraphStep* Bind = FindStep(Steps, TEXT("BindDevice"));
+
+	if (TestNotNull(TEXT("The failing step is recorded"), Bind))
+	{
+		TestFalse(TEXT("The failing step failed"), Bind->bSucceeded);
+		TestEqual(TEXT("The failing step keeps its HRESULT"), (uint32)Bind->Result, (uint32)E_FAIL);
+		TestTrue(FString::Printf(TEXT("The failing step is timed (%.1f ms)"), Bind->Duration * 1000.0), (Bind->Duration >= 0.009) && (Bind->Duration < 0.01 + Slack));
+	}
+
+	const FDirectShowGraphStep* Graph = FindStep(Steps, TEXT("InitializeGraph"));
+
+	if (TestNotNull(TEXT("The graph step is recorded"), Graph))
+	{
+		TestFalse(TEXT("The graph step failed with the tracked HRESULT"), Graph->bSucceeded);
+		TestEqual(TEXT("The graph step reports the tracked HRESULT"), (uint32)Graph->Result, (uint32)E_FAIL);
+	}
+
+	TestFalse(TEXT("The open failed"), Steps[0].bSucceeded);
+	TestNull(TEXT("Steps after the failure don't run"), FindStep(Steps, TEXT("SetFormat")));
+	TestNull(TEXT("The graph isn't started"), FindStep(Steps, TEXT("Start")));
+
+	// the trace has a complete event per step with the outcome, and the label escaped
+	const FString Trace = Device.OpenTimeline.ToChromeTrace();
+
+	TestTrue(TEXT("The trace names the open"), Trace.Contains(TEXT("DirectShowMedia open video://\\\"Broken\\\" Camera")));
+	TestTrue(TEXT("The trace has the failing step"), Trace.Contains(TEXT("{\"name\":\"BindDevice\",\"cat\":\"DirectShowMedia\",\"ph\":\"X\"")));
+	TestTrue(TEXT("The trace has the HRESULT"), Trace.Contains(TEXT("\"succeeded\":false,\"hresult\":\"0x80004005\",\"depth\":2")));
+
+	int32 NumEvents = 0;
+
+	for (int32 Index = Trace.Find(TEXT("\"ph\":\"X\"")); Index != INDEX_NONE; Index = Trace.Find(TEXT("\"ph\":\"X\""), ESearchCase::CaseSensitive, ESearchDir::FromStart, Index + 1))
+	{
+		++NumEvents;
+	}
+
+	TestEqual(TEXT("The trace has an event per step"), NumEvents, Steps.Num());
+
+	return true;
+}
+
+
+#endif //WITH_DEV_AUTOMATION_TESTS
@@ -0,0 +1,144 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "CoreTypes.h"
+#include "Misc/AutomationTest.h"
+
+#include "Player/DirectShowMediaAVSync.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+
+namespace DirectShowMediaAVSyncTest
+{
+	/** Nominal rate of the synthetic audio device. */
+	const uint32 SampleRate = 48000;
+
+	/** Frames per audio buffer (10 ms). */
+	const uint32 FramesPerBuffer = 480;
+
+	/** Result of a synthetic session. */
+	struct FSession
+	{
+		double FinalError = 0.0;
+		double MaxLateError = 0.0;
+		double MaxGap = 0.0;
+		double UncorrectedError = 0.0;
+	};
+
+	/**
+	 * Deliver audio buffers from a device whose clock is skewed against the video timeline.
+	 *
+	 * The callbacks carry up to two milliseconds of jitter. Errors are measured against the time each buffer
+	 * was actually captured on the video timeline.
+	 *
+	 * @param Sync The controller to feed.
+	 * @param SkewPpm How much faster the audio clock runs (in ppm).
+	 * @param Seconds Length of the session.
+	 */
+	FSession Run(FDirectShowMediaAVSync& Sync, double SkewPpm, double Seconds)
+	{
+		FSession Session;
+
+		const double TruePeriod = (double)FramesPerBuffer / ((double)SampleRate * (1.0 + SkewPpm * 1.0e-6));
+		const int32 NumBuffers = (int32)(Seconds / TruePeriod);
+		const double StartTime = 1.0;
+
+		uint32 Seed = 12345;
+		double PreviousEnd = 0.0;
+
+		for (int32 Buffer = 0; Buffer < NumBuffers; ++Buffer)
+		{
+			Seed = Seed * 1664525u + 1013904223u;
+			const double Jitter = ((double)(Seed >> 8) / (double)(1 << 24) - 0.5) * 0.004;
+			const double TrueTime = StartTime + Buffer * TruePeriod;
+
+			FTimespan Time;
+			FTimespan Duration;
+			Sync.ProcessAudio(TrueTime + Jitter, FramesPerBuffer, SampleRate, Time, Duration);
+
+			const double Error = Time.GetTotalSeconds() - TrueTime;
+
+			// consecutive buffers stay contiguous while the error is slewed away
+			if (Buffer > 0)
+			{
+				Session.MaxGap = FMath::Max(Session.MaxGap, FMath::Abs(Time.GetTotalSeconds() - PreviousEnd));
+			}
+
+			// once locked, the timeline follows the video clock
+			if (Buffer * TruePeriod > 60.0)
+			{
+				Session.MaxLateError = FMath::Max(Session.MaxLateError, FMath::Abs(Error));
+			}
+
+			PreviousEnd = (Time + Duration).GetTotalSeconds();
+			Session.FinalError = Error;
+		}
+
+		// counting samples from the first callback, as without the controller
+		Session.UncorrectedError = (StartTime + (double)NumBuffers * FramesPerBuffer / SampleRate) - (StartTime + NumBuffers * TruePeriod);
+
+		return Session;
+	}
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDirectShowMediaAVSyncSkewTest, "DirectShowMedia.AVSync.ClockSkew", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FDirectShowMediaAVSyncSkewTest::RunTest(const FString& Parameters)
+{
+	// ten minutes at each skew, counting samples would be off by 120 ms at the end
+	for (const double SkewPpm : { -200.0, 0.0, 200.0 })
+	{
+		FDirectShowMediaAVSync Sync;
+		const DirectShowMediaAVSyncTest::FSession Session = DirectShowMediaAVSyncTest::Run(Sync, SkewPpm, 600.0);
+
+		// video seconds per audio second, so a fast audio clock gives a negative drift
+		TestTrue(FString::Printf(TEXT("%+.0f ppm is estimated (%.1f ppm)"), SkewPpm, Sync.GetDriftPpm()), FMath::Abs(Sync.GetDriftPpm() + SkewPpm) < 10.0);
+		TestTrue(FString::Printf(TEXT("%+.0f ppm stays in sync (%.3f ms)"), SkewPpm, Session.MaxLateError * 1000.0), Session.MaxLateError < 0.001);
+		TestTrue(FString::Printf(TEXT("%+.0f ppm ends in sync (%.3f ms)"), SkewPpm, Session.FinalError * 1000.0), FMath::Abs(Session.FinalError) < 0.001);
+		TestTrue(FString::Printf(TEXT("%+.0f ppm keeps the buffers contiguous (%.3f ms)"), SkewPpm, Session.MaxGap * 1000.0), Session.MaxGap < 0.0001);
+		TestTrue(FString::Printf(TEXT("%+.0f ppm reports the sync error (%.3f ms)"), SkewPpm, Sync.GetSyncError() * 1000.0), FMath::Abs(Sync.GetSyncError()) < 0.001);
+		TestEqual(FString::Printf(TEXT("%+.0f ppm doesn't resync"), SkewPpm), Sync.GetNumResyncs(), 0u);
+
+		if (SkewPpm != 0.0)
+		{
+			TestTrue(FString::Printf(TEXT("%+.0f ppm would drift without correction"), SkewPpm), FMath::Abs(Session.UncorrectedError) > 0.1);
+		}
+	}
+
+	return true;
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDirectShowMediaAVSyncResyncTest, "DirectShowMedia.AVSync.Resync", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FDirectShowMediaAVSyncResyncTest::RunTest(const FString& Parameters)
+{
+	const double Period = (double)DirectShowMediaAVSyncTest::FramesPerBuffer / DirectShowMediaAVSyncTest::SampleRate;
+
+	FDirectShowMediaAVSync Sync;
+	FTimespan Time;
+	FTimespan Duration;
+
+	Sync.ProcessAudio(1.0, DirectShowMediaAVSyncTest::FramesPerBuffer, DirectShowMediaAVSyncTest::SampleRate, Time, Duration);
+	TestEqual(TEXT("The first buffer anchors the timeline"), Time, FTimespan::FromSeconds(1.0));
+	TestEqual(TEXT("The duration is nominal before any drift is measured"), Duration, FTimespan::FromSeconds(Period));
+
+	Sync.ProcessAudio(1.0 + Period, DirectShowMediaAVSyncTest::FramesPerBuffer, DirectShowMediaAVSyncTest::SampleRate, Time, Duration);
+	TestEqual(TEXT("An on time buffer follows the previous one"), Time, FTimespan::FromSeconds(1.0 + Period));
+
+	// a gap in the stream, i.e. after the graph was paused, re-anchors instead of slewing for minutes
+	Sync.ProcessAudio(5.0, DirectShowMediaAVSyncTest::FramesPerBuffer, DirectShowMediaAVSyncTest::SampleRate, Time, Duration);
+	TestEqual(TEXT("A discontinuity re-anchors the timeline"), Time, FTimespan::FromSeconds(5.0));
+	TestEqual(TEXT("The resync is counted"), Sync.GetNumResyncs(), 1u);
+
+	Sync.Reset();
+	Sync.ProcessAudio(0.5, DirectShowMediaAVSyncTest::FramesPerBuffer, DirectShowMediaAVSyncTest::SampleRate, Time, Duration);
+	TestEqual(TEXT("A reset anchors on the next buffer"), Time, FTimespan::FromSeconds(0.5));
+	TestEqual(TEXT("A reset isn't a resync"), Sync.GetNumResyncs(), 1u);
+
+	return true;
+}
+
+
+#endif //WITH_DEV_AUTOMATION_TESTS
@@ -0,0 +1,184 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "CoreTypes.h"
+#include "Misc/AutomationTest.h"
+
+#include "Player/DirectShowMediaAudioBufferController.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+
+namespace DirectShowMediaAudioBufferControllerTest
+{
+	/** A phase of the synthetic callback timing trace. */
+	struct FPhase
+	{
+		/** Length of the phase (in seconds). */
+		double Duration;
+
+		/** Largest callback lateness (in seconds). */
+		double MaxLateness;
+	};
+
+	/** What the simulation saw in a phase. */
+	struct FPhaseResult
+	{
+		float MinBufferMs = 1.0e9f;
+		float MaxBufferMs = 0.0f;
+		float FinalBufferMs = 0.0f;
+		int32 MaxDepth = 0;
+		uint32 NumUnderruns = 0;
+		uint32 NumLateUnderruns = 0;
+		uint32 NumRenegotiations = 0;
+		double FirstRenegotiation = -1.0;
+	};
+
+	/**
+	 * Simulate a capture device against the controller, the way the player drives it.
+	 *
+	 * The device delivers a buffer every BufferMs, late by a pseudo random amount up to the phase's maximum.
+	 * The consumer underruns when a buffer is later than what the device buffer covers. The game thread polls
+	 * every 100 ms, and a renegotiation restarts the graph, which delivers nothing for 200 ms.
+	 *
+	 * @param Controller The controller, already reset.
+	 * @param Phases The timing trace.
+	 * @param OutResults Will contain what happened in each phase.
+	 */
+	void Run(FDirectShowMediaAudioBufferController& Controller, const TArray<FPhase>& Phases, TArray<FPhaseResult>& OutResults)
+	{
+		uint32 Seed = 4711;
+		double Now = 0.0;
+		double NextCallback = 0.0;
+		double NextPoll = 0.1;
+
+		for (const FPhase& Phase : Phases)
+		{
+			FPhaseResult& Result = OutResults.AddDefaulted_GetRef();
+
+			const double PhaseStart = Now;
+			const double PhaseEnd = Now + Phase.Duration;
+			const uint32 UnderrunsBefore = Controller.GetNumUnderruns();
+			const uint32 RenegotiationsBefore = Controller.GetNumRenegotiations();
+
+			while (Now < PhaseEnd)
+			{
+				const double Period = Controller.GetBufferMs() / 1000.0;
+
+				if (NextCallback <= NextPoll)
+				{
+					// the callback is due every period, but the streaming thread may get to it late
+					Seed = Seed * 1664525u + 1013904223u;
+					const double Lateness = Phase.MaxLateness * (double)(Seed >> 8) / (double)(1 << 24);
+
+					Now = NextCallback;
+					Controller.AddCallback(Now + Lateness, Period);
+
+					if (Lateness > Period)
+					{
+						Controller.AddUnderrun();
+
+						// underruns in the second half of a phase mean the controller didn't adapt
+						if (Now - PhaseStart > 0.5 * Phase.Duration)
+						{
+							++Result.NumLateUnderruns;
+						}
+					}
+
+					NextCallback += Period;
+				}
+				else
+				{
+					Now = NextPoll;
+					NextPoll += 0.1;
+
+					float NewBufferMs = 0.0f;
+
+					if (Controller.PollRenegotiation(Now, NewBufferMs))
+					{
+						Controller.OnRenegotiated(Now, NewBufferMs);
+						NextCallback = Now + 0.2;
+
+						if (Result.FirstRenegotiation < 0.0)
+						{
+							Result.FirstRenegotiation = Now - PhaseStart;
+						}
+					}
+
+					const float BufferMs = Controller.GetBufferMs();
+					Result.MinBufferMs = FMath::Min(Result.MinBufferMs, BufferMs);
+					Result.MaxBufferMs = FMath::Max(Result.MaxBufferMs, BufferMs);
+					Result.MaxDepth = FMath::Max(Result.MaxDepth, Controller.GetJitterBufferDepth(Now));
+				}
+			}
+
+			Result.FinalBufferMs = Controller.GetBufferMs();
+			Result.NumUnderruns = Controller.GetNumUnderruns() - UnderrunsBefore;
+			Result.NumRenegotiations = Controller.GetNumRenegotiations() - RenegotiationsBefore;
+		}
+	}
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDirectShowMediaAudioBufferControllerTraceTest, "DirectShowMedia.AudioBufferController.Trace", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FDirectShowMediaAudioBufferControllerTraceTest::RunTest(const FString& Parameters)
+{
+	using namespace DirectShowMediaAudioBufferControllerTest;
+
+	// an idle machine, a loaded one, and idle again
+	const TArray<FPhase> Phases = { { 60.0, 0.001 }, { 120.0, 0.025 }, { 120.0, 0.001 } };
+
+	FDirectShowMediaAudioBufferController Controller;
+	Controller.Reset(40.0f, 10.0f, 200.0f, true);
+
+	TArray<FPhaseResult> Results;
+	Run(Controller, Phases, Results);
+
+	const FPhaseResult& Idle = Results[0];
+	const FPhaseResult& Loaded = Results[1];
+	const FPhaseResult& Recovered = Results[2];
+
+	// an oversized buffer shrinks once the idle machine proved stable
+	TestTrue(FString::Printf(TEXT("The idle buffer shrinks (%.0f ms)"), Idle.FinalBufferMs), Idle.FinalBufferMs <= 20.0f);
+	TestTrue(FString::Printf(TEXT("The buffer doesn't shrink before it was observed (%.1f s)"), Idle.FirstRenegotiation), Idle.FirstRenegotiation >= 20.0);
+	TestEqual(TEXT("The idle machine doesn't underrun"), Idle.NumUnderruns, 0u);
+
+	// the load grows the buffer within seconds to cover the 25 ms peaks with margin, and then the consumer stops underrunning
+	TestTrue(FString::Printf(TEXT("The load grows the buffer (%.0f ms)"), Loaded.MaxBufferMs), Loaded.MaxBufferMs >= 45.0f);
+	TestTrue(FString::Printf(TEXT("The buffer grows quickly (%.1f s)"), Loaded.FirstRenegotiation), (Loaded.FirstRenegotiation >= 0.0) && (Loaded.FirstRenegotiation < 5.0));
+	TestEqual(TEXT("No underruns once the buffer grew"), Loaded.NumLateUnderruns, 0u);
+	TestTrue(FString::Printf(TEXT("The buffer doesn't oscillate under load (%u renegotiations)"), Loaded.NumRenegotiations), Loaded.NumRenegotiations <= 3);
+	TestTrue(FString::Printf(TEXT("Our jitter buffer deepens under load (%d)"), Loaded.MaxDepth), Loaded.MaxDepth >= 2);
+
+	// the buffer comes back down after the load, but not right away
+	TestTrue(FString::Printf(TEXT("The buffer shrinks after the load (%.0f ms)"), Recovered.FinalBufferMs), Recovered.FinalBufferMs <= 20.0f);
+	TestTrue(FString::Printf(TEXT("The buffer doesn't shrink right after the load (%.1f s)"), Recovered.FirstRenegotiation), Recovered.FirstRenegotiation >= 20.0);
+	TestEqual(TEXT("Shrinking doesn't cause underruns"), Recovered.NumUnderruns, 0u);
+
+	return true;
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDirectShowMediaAudioBufferControllerFixedTest, "DirectShowMedia.AudioBufferController.Fixed", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FDirectShowMediaAudioBufferControllerFixedTest::RunTest(const FString& Parameters)
+{
+	using namespace DirectShowMediaAudioBufferControllerTest;
+
+	FDirectShowMediaAudioBufferController Controller;
+	Controller.Reset(20.0f, 10.0f, 200.0f, false);
+
+	TArray<FPhaseResult> Results;
+	Run(Controller, { { 60.0, 0.025 } }, Results);
+
+	// without adaptation the buffer stays, but jitter and underruns are still measured
+	TestEqual(TEXT("The buffer isn't renegotiated"), Controller.GetNumRenegotiations(), 0u);
+	TestEqual(TEXT("The buffer keeps its size"), Controller.GetBufferMs(), 20.0f);
+	TestTrue(TEXT("Underruns are counted"), Controller.GetNumUnderruns() > 0);
+	TestTrue(FString::Printf(TEXT("The jitter is measured (%.1f ms)"), Controller.GetJitterMs()), Controller.GetJitterMs() > 15.0f);
+
+	return true;
+}
+
+
+#endif //WITH_DEV_AUTOMATION_TESTS
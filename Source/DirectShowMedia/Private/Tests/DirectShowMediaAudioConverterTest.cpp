@@ -0,0 +1,452 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "CoreTypes.h"
+#include "Misc/AutomationTest.h"
+
+#include "HAL/PlatformTime.h"
+#include "Math/UnrealMathUtility.h"
+#include "Player/DirectShowMediaAudioConverter.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+
+namespace DirectShowMediaAudioConverterTest
+{
+	/** An input sample format. */
+	struct FFormat
+	{
+		const TCHAR* Name;
+		EMediaAudioSampleFormat Format;
+		uint32 BitsPerSample;
+	};
+
+	const FFormat Formats[] =
+	{
+		{ TEXT("8 bit"), EMediaAudioSampleFormat::Int8, 8 },
+		{ TEXT("16 bit"), EMediaAudioSampleFormat::Int16, 16 },
+		{ TEXT("24 bit"), EMediaAudioSampleFormat::Int32, 24 },
+		{ TEXT("32 bit"), EMediaAudioSampleFormat::Int32, 32 },
+		{ TEXT("float"), EMediaAudioSampleFormat::Float, 32 },
+	};
+
+	/** Append a sample in [-1, 1) in the given format. */
+	void WriteSample(const FFormat& Format, double Value, TArray<uint8>& OutBuffer)
+	{
+		if (Format.Format == EMediaAudioSampleFormat::Float)
+		{
+			const float Sample = (float)Value;
+			OutBuffer.Append((const uint8*)&Sample, sizeof(Sample));
+			return;
+		}
+
+		const int64 Scale = (int64)1 << (Format.BitsPerSample - 1);
+		const int64 Sample = FMath::Clamp<int64>((int64)FMath::RoundToDouble(Value * Scale), -Scale, Scale - 1) + ((Format.BitsPerSample == 8) ? 128 : 0);
+
+		for (uint32 Byte = 0; Byte < Format.BitsPerSample / 8; ++Byte)
+		{
+			OutBuffer.Add((uint8)(Sample >> (Byte * 8)));
+		}
+	}
+
+	/** Read a sample the way the converter did before it decoded whole buffers. */
+	float ReadSample(const FFormat& Format, const uint8* Sample)
+	{
+		switch (Format.BitsPerSample)
+		{
+		case 8:
+			return ((int32)Sample[0] - 128) * (1.0f / 128.0f);
+
+		case 16:
+			return (int16)(Sample[0] | (Sample[1] << 8)) * (1.0f / 32768.0f);
+
+		case 24:
+			return ((int32)(((uint32)Sample[0] << 8) | ((uint32)Sample[1] << 16) | ((uint32)Sample[2] << 24)) >> 8) * (1.0f / 8388608.0f);
+
+		default:
+			{
+				const uint32 Bits = (uint32)Sample[0] | ((uint32)Sample[1] << 8) | ((uint32)Sample[2] << 16) | ((uint32)Sample[3] << 24);
+
+				if (Format.Format == EMediaAudioSampleFormat::Float)
+				{
+					float Value;
+					FMemory::Memcpy(&Value, &Bits, sizeof(Value));
+
+					return Value;
+				}
+
+				return (int32)Bits * (1.0f / 2147483648.0f);
+			}
+		}
+	}
+
+	/** Fill a buffer with noise over the full range of the format. */
+	void MakeNoise(const FFormat& Format, uint32 NumSamples, TArray<uint8>& OutBuffer)
+	{
+		uint32 Seed = 12345;
+
+		for (uint32 Index = 0; Index < NumSamples; ++Index)
+		{
+			Seed = Seed * 1664525u + 1013904223u;
+			WriteSample(Format, ((int32)Seed) / 2147483648.0, OutBuffer);
+		}
+	}
+
+	/**
+	 * Measure the distortion and noise of a converted sine wave.
+	 *
+	 * Fits a sine of the given frequency (with any phase and offset) to the signal by least squares and
+	 * compares the residual to the fitted sine.
+	 *
+	 * @return The THD+N in dB, and the fitted amplitude.
+	 */
+	double MeasureThdN(const TArray<float>& Signal, double Frequency, double SampleRate, double& OutAmplitude)
+	{
+		double Normal[3][3] = { };
+		double Right[3] = { };
+
+		auto Basis = [Frequency, SampleRate](int32 Index, double (&OutBasis)[3])
+		{
+			const double Phase = 2.0 * PI * Frequency * Index / SampleRate;
+
+			OutBasis[0] = FMath::Sin(Phase);
+			OutBasis[1] = FMath::Cos(Phase);
+			OutBasis[2] = 1.0;
+		};
+
+		for (int32 Index = 0; Index < Signal.Num(); ++Index)
+		{
+			double B[3];
+			Basis(Index, B);
+
+			for (int32 Row = 0; Row < 3; ++Row)
+			{
+				for (int32 Column = 0; Column < 3; ++Column)
+				{
+					Normal[Row][Column] += B[Row] * B[Column];
+				}
+
+				Right[Row] += B[Row] * Signal[Index];
+			}
+		}
+
+		// Gaussian elimination, the normal matrix is well conditioned over many periods
+		for (int32 Pivot = 0; Pivot < 3; ++Pivot)
+		{
+			for (int32 Row = Pivot + 1; Row < 3; ++Row)
+			{
+				const double Factor = Normal[Row][Pivot] / Normal[Pivot][Pivot];
+
+				for (int32 Column = Pivot; Column < 3; ++Column)
+				{
+					Normal[Row][Column] -= Factor * Normal[Pivot][Column];
+				}
+
+				Right[Row] -= Factor * Right[Pivot];
+			}
+		}
+
+		double Fit[3];
+
+		for (int32 Row = 2; Row >= 0; --Row)
+		{
+			double Sum = Right[Row];
+
+			for (int32 Column = Row + 1; Column < 3; ++Column)
+			{
+				Sum -= Normal[Row][Column] * Fit[Column];
+			}
+
+			Fit[Row] = Sum / Normal[Row][Row];
+		}
+
+		double ResidualEnergy = 0.0;
+
+		for (int32 Index = 0; Index < Signal.Num(); ++Index)
+		{
+			double B[3];
+			Basis(Index, B);
+
+			const double Residual = Signal[Index] - (Fit[0] * B[0] + Fit[1] * B[1] + Fit[2] * B[2]);
+			ResidualEnergy += Residual * Residual;
+		}
+
+		OutAmplitude = FMath::Sqrt(Fit[0] * Fit[0] + Fit[1] * Fit[1]);
+
+		const double SignalEnergy = 0.5 * OutAmplitude * OutAmplitude * Signal.Num();
+
+		return 10.0 * FMath::Loge(FMath::Max(ResidualEnergy, 1.0e-30) / SignalEnergy) / FMath::Loge(10.0);
+	}
+
+	/** Convert a stream in device sized buffers, returning the output. */
+	void ConvertStream(FDirectShowMediaAudioConverter& Converter, const TArray<uint8>& Input, uint32 BufferSize, TArray<float>& OutOutput)
+	{
+		TArray<uint8> OutBuffer;
+
+		for (int32 Offset = 0; Offset < Input.Num(); Offset += BufferSize)
+		{
+			const uint32 Size = FMath::Min<uint32>(BufferSize, Input.Num() - Offset);
+			const uint32 NumFrames = Converter.Convert(Input.GetData() + Offset, Size, OutBuffer);
+
+			OutOutput.Append(reinterpret_cast<const float*>(OutBuffer.GetData()), NumFrames * Converter.GetOutputChannels());
+		}
+	}
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDirectShowMediaAudioConverterFormatsTest, "DirectShowMedia.AudioConverter.Formats", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FDirectShowMediaAudioConverterFormatsTest::RunTest(const FString& Parameters)
+{
+	using namespace DirectShowMediaAudioConverterTest;
+
+	// channel layouts: passed through, mono spread, downmixed to mono, and dropped or added by index
+	const uint32 Layouts[][2] = { { 1, 1 }, { 2, 2 }, { 6, 6 }, { 1, 2 }, { 2, 1 }, { 6, 2 }, { 2, 6 } };
+
+	// buffer lengths that leave a tail after the vector loops and cross the remapping blocks
+	const uint32 FrameCounts[] = { 1, 3, 7, 128, 129, 1001 };
+
+	for (const FFormat& Format : Formats)
+	{
+		for (const auto& Layout : Layouts)
+		{
+			const uint32 InChannels = Layout[0];
+			const uint32 OutChannels = Layout[1];
+
+			FDirectShowMediaAudioConverter Converter;
+
+			if (!TestTrue(FString::Printf(TEXT("%s, %u to %u channels is supported"), Format.Name, InChannels, OutChannels), Converter.Configure(Format.Format, Format.BitsPerSample, InChannels, 48000, OutChannels, 48000)))
+			{
+				continue;
+			}
+
+			int32 NumMismatches = 0;
+
+			for (const uint32 NumFrames : FrameCounts)
+			{
+				TArray<uint8> Input;
+				MakeNoise(Format, NumFrames * InChannels, Input);
+
+				TArray<uint8> Output;
+				const uint32 NumOutputFrames = Converter.Convert(Input.GetData(), Input.Num(), Output);
+
+				if ((NumOutputFrames != NumFrames) || (Output.Num() != NumFrames * OutChannels * sizeof(float)))
+				{
+					++NumMismatches;
+					continue;
+				}
+
+				const float* Samples = reinterpret_cast<const float*>(Output.GetData());
+				const uint32 BytesPerSample = Format.BitsPerSample / 8;
+
+				for (uint32 Frame = 0; Frame < NumFrames; ++Frame)
+				{
+					const uint8* InFrame = Input.GetData() + Frame * InChannels * BytesPerSample;
+
+					for (uint32 OutChannel = 0; OutChannel < OutChannels; ++OutChannel)
+					{
+						float Expected = 0.0f;
+
+						if (InChannels == OutChannels)
+						{
+							Expected = ReadSample(Format, InFrame + OutChannel * BytesPerSample);
+						}
+						else if (InChannels == 1)
+						{
+							Expected = ReadSample(Format, InFrame);
+						}
+						else if (OutChannels == 1)
+						{
+							for (uint32 InChannel = 0; InChannel < InChannels; ++InChannel)
+							{
+								Expected += (1.0f / InChannels) * ReadSample(Format, InFrame + InChannel * BytesPerSample);
+							}
+						}
+						else if (OutChannel < InChannels)
+						{
+							Expected = ReadSample(Format, InFrame + OutChannel * BytesPerSample);
+						}
+
+						if (Samples[Frame * OutChannels + OutChannel] != Expected)
+						{
+							++NumMismatches;
+						}
+					}
+				}
+			}
+
+			TestEqual(FString::Printf(TEXT("%s, %u to %u channels converts like a sample at a time"), Format.Name, InChannels, OutChannels), NumMismatches, 0);
+		}
+	}
+
+	// the resampling path decodes into the filter's channel planes, a DC level has to come out unchanged
+	for (const FFormat& Format : Formats)
+	{
+		FDirectShowMediaAudioConverter Converter;
+		Converter.Configure(Format.Format, Format.BitsPerSample, 2, 44100, 2, 48000);
+
+		TArray<uint8> Input;
+
+		for (int32 Frame = 0; Frame < 4410; ++Frame)
+		{
+			WriteSample(Format, 0.5, Input);
+			WriteSample(Format, -0.25, Input);
+		}
+
+		TArray<float> Output;
+		ConvertStream(Converter, Input, 441 * 2 * Format.BitsPerSample / 8, Output);
+
+		double MaxError = 0.0;
+
+		for (int32 Index = 200; Index < Output.Num(); Index += 2)
+		{
+			MaxError = FMath::Max(MaxError, FMath::Max(FMath::Abs(Output[Index] - 0.5), FMath::Abs(Output[Index + 1] + 0.25)));
+		}
+
+		TestTrue(FString::Printf(TEXT("%s resampled keeps the levels of its channels (%g)"), Format.Name, MaxError), MaxError < 0.01);
+	}
+
+	return true;
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDirectShowMediaAudioConverterThdNTest, "DirectShowMedia.AudioConverter.ThdN", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FDirectShowMediaAudioConverterThdNTest::RunTest(const FString& Parameters)
+{
+	using namespace DirectShowMediaAudioConverterTest;
+
+	struct FCase
+	{
+		uint32 InputRate;
+		uint32 OutputRate;
+		const FFormat& Format;
+		double MaxThdN;
+	};
+
+	// 16 bit input is limited by its own quantization noise, float input by the filter
+	const FCase Cases[] =
+	{
+		{ 48000, 48000, Formats[1], -90.0 },
+		{ 44100, 48000, Formats[1], -80.0 },
+		{ 48000, 44100, Formats[1], -80.0 },
+		{ 44100, 48000, Formats[4], -80.0 },
+		{ 32000, 48000, Formats[2], -75.0 },
+	};
+
+	const double Frequencies[] = { 50.0, 220.0, 1000.0, 3150.0, 8000.0, 12500.0 };
+
+	for (const FCase& Case : Cases)
+	{
+		FString Results;
+
+		for (const double Frequency : Frequencies)
+		{
+			if (Frequency > 0.4 * FMath::Min(Case.InputRate, Case.OutputRate))
+			{
+				continue;
+			}
+
+			FDirectShowMediaAudioConverter Converter;
+			Converter.Configure(Case.Format.Format, Case.Format.BitsPerSample, 1, Case.InputRate, 1, Case.OutputRate);
+
+			// half a second at -6 dBFS
+			TArray<uint8> Input;
+
+			for (uint32 Frame = 0; Frame < Case.InputRate / 2; ++Frame)
+			{
+				WriteSample(Case.Format, 0.5 * FMath::Sin(2.0 * PI * Frequency * Frame / Case.InputRate), Input);
+			}
+
+			TArray<float> Output;
+			ConvertStream(Converter, Input, (Case.InputRate / 100) * Case.Format.BitsPerSample / 8, Output);
+
+			// skip the filter's start up
+			TArray<float> Steady(Output.GetData() + 256, Output.Num() - 256);
+
+			double Amplitude = 0.0;
+			const double ThdN = MeasureThdN(Steady, Frequency, Case.OutputRate, Amplitude);
+
+			Results += FString::Printf(TEXT(" %.0f Hz: %.1f dB"), Frequency, ThdN);
+
+			TestTrue(FString::Printf(TEXT("%s %u to %u Hz at %.0f Hz: THD+N %.1f dB"), Case.Format.Name, Case.InputRate, Case.OutputRate, Frequency, ThdN), ThdN < Case.MaxThdN);
+			TestTrue(FString::Printf(TEXT("%s %u to %u Hz at %.0f Hz: gain %.4f"), Case.Format.Name, Case.InputRate, Case.OutputRate, Frequency, Amplitude / 0.5), FMath::Abs(Amplitude / 0.5 - 1.0) < 0.01);
+		}
+
+		AddInfo(FString::Printf(TEXT("%s, %u to %u Hz:%s"), Case.Format.Name, Case.InputRate, Case.OutputRate, *Results));
+	}
+
+	return true;
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDirectShowMediaAudioConverterThroughputTest, "DirectShowMedia.AudioConverter.Throughput", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FDirectShowMediaAudioConverterThroughputTest::RunTest(const FString& Parameters)
+{
+	using namespace DirectShowMediaAudioConverterTest;
+
+	// ten seconds of stereo in 10 ms device buffers
+	const uint32 InputRate = 48000;
+	const uint32 NumSeconds = 10;
+	const uint32 BufferFrames = InputRate / 100;
+
+	for (const FFormat& Format : Formats)
+	{
+		TArray<uint8> Input;
+		MakeNoise(Format, BufferFrames * 2, Input);
+
+		const uint32 NumBuffers = NumSeconds * 100;
+		TArray<uint8> Output;
+
+		// one sample at a time, as the converter did before it decoded whole buffers
+		TArray<float> ReferenceOutput;
+		ReferenceOutput.SetNumUninitialized(BufferFrames * 2);
+
+		const uint32 BytesPerSample = Format.BitsPerSample / 8;
+
+		double StartTime = FPlatformTime::Seconds();
+
+		for (uint32 Buffer = 0; Buffer < NumBuffers; ++Buffer)
+		{
+			for (uint32 Sample = 0; Sample < BufferFrames * 2; ++Sample)
+			{
+				ReferenceOutput[Sample] = ReadSample(Format, Input.GetData() + Sample * BytesPerSample);
+			}
+		}
+
+		const double ReferenceTime = FPlatformTime::Seconds() - StartTime;
+
+		auto Measure = [&](uint32 OutChannels, uint32 OutputRate)
+		{
+			FDirectShowMediaAudioConverter Converter;
+			Converter.Configure(Format.Format, Format.BitsPerSample, 2, InputRate, OutChannels, OutputRate);
+
+			const double MeasureStartTime = FPlatformTime::Seconds();
+
+			for (uint32 Buffer = 0; Buffer < NumBuffers; ++Buffer)
+			{
+				Converter.Convert(Input.GetData(), Input.Num(), Output);
+			}
+
+			// times faster than real time
+			return NumSeconds / FMath::Max(FPlatformTime::Seconds() - MeasureStartTime, 1.0e-9);
+		};
+
+		const double DirectSpeed = Measure(2, InputRate);
+		const double RemapSpeed = Measure(6, InputRate);
+		const double ResampleSpeed = Measure(2, 44100);
+
+		AddInfo(FString::Printf(TEXT("%s stereo, times real time: %.0fx converted (%.0fx a sample at a time), %.0fx remapped to 5.1, %.0fx resampled to 44.1 kHz"),
+			Format.Name, DirectSpeed, NumSeconds / FMath::Max(ReferenceTime, 1.0e-9), RemapSpeed, ResampleSpeed));
+
+		// generous bounds, so debug builds and loaded machines pass while a conversion that can't keep up with a handful of devices doesn't
+		TestTrue(FString::Printf(TEXT("%s converts fast enough (%.0fx real time)"), Format.Name, DirectSpeed), DirectSpeed > 100.0);
+		TestTrue(FString::Printf(TEXT("%s remaps fast enough (%.0fx real time)"), Format.Name, RemapSpeed), RemapSpeed > 50.0);
+		TestTrue(FString::Printf(TEXT("%s resamples fast enough (%.0fx real time)"), Format.Name, ResampleSpeed), ResampleSpeed > 10.0);
+	}
+
+	return true;
+}
+
+
+#endif //WITH_DEV_AUTOMATION_TESTS
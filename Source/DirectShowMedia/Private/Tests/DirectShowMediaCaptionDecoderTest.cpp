@@ -0,0 +1,601 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "CoreTypes.h"
+#include "Misc/AutomationTest.h"
+
+#include "HAL/PlatformTime.h"
+#include "Internationalization/Regex.h"
+#include "Player/DirectShowMediaCaptionDecoder.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+
+namespace DirectShowMediaCaptionDecoderTest
+{
+	/** Add the odd parity bit to a 7 bit CEA-608 byte. */
+	uint8 WithParity(uint8 Byte)
+	{
+		uint8 Bits = Byte;
+		Bits ^= Bits >> 4;
+		Bits ^= Bits >> 2;
+		Bits ^= Bits >> 1;
+
+		return (Bits & 1) ? Byte : (Byte | 0x80);
+	}
+
+	/** Add a CEA-608 byte pair. */
+	void AddPair(TArray<uint8>& Data, uint8 Byte1, uint8 Byte2)
+	{
+		Data.Add(WithParity(Byte1));
+		Data.Add(WithParity(Byte2));
+	}
+
+	/** Add a CEA-608 control code, sent twice as caption encoders do. */
+	void AddControl(TArray<uint8>& Data, uint8 Code1, uint8 Code2)
+	{
+		AddPair(Data, Code1, Code2);
+		AddPair(Data, Code1, Code2);
+	}
+
+	/** Add CEA-608 text, the last pair padded with a null if needed. */
+	void AddText(TArray<uint8>& Data, const ANSICHAR* Text)
+	{
+		for (; *Text != 0; Text += 2)
+		{
+			AddPair(Data, (uint8)Text[0], (uint8)Text[1]);
+
+			if (Text[1] == 0)
+			{
+				break;
+			}
+		}
+	}
+
+	/** CEA-608 channel 1 control codes. */
+	const uint8 RCL[] = { 0x14, 0x20 };
+	const uint8 BS[] = { 0x14, 0x21 };
+	const uint8 RU2[] = { 0x14, 0x25 };
+	const uint8 RU3[] = { 0x14, 0x26 };
+	const uint8 RDC[] = { 0x14, 0x29 };
+	const uint8 EDM[] = { 0x14, 0x2c };
+	const uint8 CR[] = { 0x14, 0x2d };
+	const uint8 EOC[] = { 0x14, 0x2f };
+
+	/** Add a CEA-608 control code from the table above. */
+	void AddControl(TArray<uint8>& Data, const uint8 (&Code)[2])
+	{
+		AddControl(Data, Code[0], Code[1]);
+	}
+
+	/**
+	 * Build a CEA-708 caption channel packet as cc_data triplets.
+	 *
+	 * @param ServiceBlocks The service blocks of the packet (headers included).
+	 * @return The triplets, the first one starting the packet.
+	 */
+	TArray<uint8> MakePacket(const TArray<uint8>& ServiceBlocks)
+	{
+		TArray<uint8> Packet;
+		Packet.Add(0);
+		Packet.Append(ServiceBlocks);
+
+		if (Packet.Num() & 1)
+		{
+			Packet.Add(0); // null block
+		}
+
+		Packet[0] = (uint8)(Packet.Num() / 2) & 0x3f; // sequence 0, size code
+
+		TArray<uint8> Triplets;
+
+		for (int32 Index = 0; Index < Packet.Num(); Index += 2)
+		{
+			Triplets.Add((Index == 0) ? 0xff : 0xfe); // cc_valid, packet start or data
+			Triplets.Add(Packet[Index]);
+			Triplets.Add(Packet[Index + 1]);
+		}
+
+		return Triplets;
+	}
+
+	/** Add a CEA-708 service block. */
+	void AddServiceBlock(TArray<uint8>& Data, int32 ServiceNumber, const TArray<uint8>& Block)
+	{
+		if (ServiceNumber < 7)
+		{
+			Data.Add((uint8)((ServiceNumber << 5) | Block.Num()));
+		}
+		else
+		{
+			Data.Add((uint8)((7 << 5) | Block.Num()));
+			Data.Add((uint8)ServiceNumber);
+		}
+
+		Data.Append(Block);
+	}
+
+	/** Decode data, returning the captions it completes. */
+	TArray<FString> Decode(FDirectShowMediaCaptionDecoder& Decoder, EDirectShowMediaCaptionFormat Format, const TArray<uint8>& Data)
+	{
+		TArray<FString> Captions;
+
+		Decoder.Decode(Format, Data.GetData(), Data.Num(), [&Captions](const TCHAR* Text, int32 Length)
+		{
+			Captions.Add(FString(Length, Text));
+		});
+
+		return Captions;
+	}
+
+	/** Join captions for test messages. */
+	FString Join(const TArray<FString>& Captions)
+	{
+		FString Result;
+
+		for (const FString& Caption : Captions)
+		{
+			Result += FString(TEXT("[")) + Caption.Replace(TEXT("\n"), TEXT("|")) + TEXT("]");
+		}
+
+		return Result;
+	}
+
+	/**
+	 * Strip markup the way overlay samples did before the decoder: a regex over a converted copy of the text,
+	 * with the text between the matches concatenated.
+	 */
+	FString StripWithRegex(const ANSICHAR* Buffer)
+	{
+		static const FRegexPattern StripHtmlPattern(TEXT("<(?:[^>=]|='[^']*'|=\"[^\"]*\"|=[^'\"][^\\s>]*)*>"));
+
+		const FString InputText = ANSI_TO_TCHAR(Buffer);
+		FRegexMatcher Matcher(StripHtmlPattern, InputText);
+
+		FString StrippedText;
+		int32 TextBegin = INDEX_NONE;
+
+		while (Matcher.FindNext())
+		{
+			if (TextBegin != INDEX_NONE)
+			{
+				StrippedText += InputText.Mid(TextBegin, Matcher.GetMatchBeginning() - TextBegin);
+			}
+
+			TextBegin = Matcher.GetMatchEnding();
+		}
+
+		if (TextBegin > INDEX_NONE)
+		{
+			StrippedText += InputText.Mid(TextBegin);
+		}
+
+		return StrippedText;
+	}
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDirectShowMediaCaptionDecoderCEA608Test, "DirectShowMedia.CaptionDecoder.CEA608", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FDirectShowMediaCaptionDecoderCEA608Test::RunTest(const FString& Parameters)
+{
+	using namespace DirectShowMediaCaptionDecoderTest;
+
+	FDirectShowMediaCaptionDecoder Decoder;
+
+	auto Check = [this, &Decoder](const TCHAR* What, const TArray<uint8>& Data, const TArray<FString>& Expected)
+	{
+		const TArray<FString> Captions = Decode(Decoder, EDirectShowMediaCaptionFormat::CEA608, Data);
+		TestEqual(FString::Printf(TEXT("%s: %s"), What, *Join(Captions)), Join(Captions), Join(Expected));
+	};
+
+	// pop-on captions are built off screen and shown once, whole
+	{
+		TArray<uint8> Data;
+		AddControl(Data, RCL);
+		AddText(Data, "HELLO");
+		AddControl(Data, EOC);
+		Check(TEXT("Pop-on"), Data, { TEXT("HELLO") });
+	}
+
+	// a control code sent once still counts, its repetition doesn't count twice
+	{
+		TArray<uint8> Data;
+		AddPair(Data, RCL[0], RCL[1]);
+		AddText(Data, "ONCE");
+		AddControl(Data, EOC);
+		AddControl(Data, EOC);
+		Check(TEXT("Repeated control codes"), Data, { TEXT("ONCE") });
+	}
+
+	{
+		TArray<uint8> Data;
+		AddControl(Data, RCL);
+		AddText(Data, "HELLX");
+		AddControl(Data, BS);
+		AddText(Data, "O");
+		AddControl(Data, EOC);
+		Check(TEXT("Backspace"), Data, { TEXT("HELLO") });
+	}
+
+	// preamble address codes start rows
+	{
+		TArray<uint8> Data;
+		AddControl(Data, RCL);
+		AddControl(Data, 0x14, 0x50);
+		AddText(Data, "AB");
+		AddControl(Data, 0x14, 0x70);
+		AddText(Data, "CD");
+		AddControl(Data, EOC);
+		Check(TEXT("Preamble address codes"), Data, { TEXT("AB\nCD") });
+	}
+
+	// a special character, and an extended character replacing the standard one sent before it
+	{
+		TArray<uint8> Data;
+		AddControl(Data, RCL);
+		AddText(Data, "A");
+		AddControl(Data, 0x11, 0x37);
+		AddText(Data, "E");
+		AddControl(Data, 0x12, 0x20);
+		AddControl(Data, EOC);
+
+		const TCHAR Expected[] = { TEXT('A'), (TCHAR)0x266A, (TCHAR)0x00C1 };
+		Check(TEXT("Special and extended characters"), Data, { FString(3, Expected) });
+	}
+
+	// pairs with a parity error are dropped
+	{
+		TArray<uint8> Data;
+		AddControl(Data, RCL);
+		AddText(Data, "HE");
+		Data.Add(WithParity('L'));
+		Data.Add(WithParity('X') ^ 0x80);
+		AddText(Data, "LO");
+		AddControl(Data, EOC);
+		Check(TEXT("Parity errors"), Data, { TEXT("HELO") });
+	}
+
+	// channel 2 shares the field, its text doesn't show
+	{
+		TArray<uint8> Data;
+		AddControl(Data, 0x1c, 0x20);
+		AddText(Data, "XX");
+		AddControl(Data, 0x1c, 0x2f);
+		AddControl(Data, RCL);
+		AddText(Data, "OK");
+		AddControl(Data, EOC);
+		Check(TEXT("Channel 2"), Data, { TEXT("OK") });
+	}
+
+	// roll-up captions show each row as it is completed, keeping the given number of rows
+	{
+		TArray<uint8> Data;
+		AddControl(Data, RU2);
+
+		for (const ANSICHAR* Line : { "LINE1", "LINE2", "LINE3" })
+		{
+			AddText(Data, Line);
+			AddControl(Data, CR);
+		}
+
+		Check(TEXT("Two row roll-up"), Data, { TEXT("LINE1"), TEXT("LINE1\nLINE2"), TEXT("LINE2\nLINE3") });
+	}
+
+	{
+		TArray<uint8> Data;
+		AddControl(Data, RU3);
+
+		for (const ANSICHAR* Line : { "ROW4", "ROW5" })
+		{
+			AddText(Data, Line);
+			AddControl(Data, CR);
+		}
+
+		Check(TEXT("Three row roll-up continues the rows shown"), Data, { TEXT("LINE3\nROW4"), TEXT("LINE3\nROW4\nROW5") });
+	}
+
+	{
+		TArray<uint8> Data;
+		AddControl(Data, EDM);
+		AddControl(Data, RU2);
+		AddText(Data, "NEW");
+		AddControl(Data, CR);
+		Check(TEXT("Erasing the displayed memory drops the rows"), Data, { TEXT("NEW") });
+	}
+
+	// paint-on captions update as they are drawn, one caption per call
+	Decoder.Reset();
+	{
+		TArray<uint8> Data;
+		AddControl(Data, RDC);
+		AddText(Data, "AB");
+		Check(TEXT("Paint-on"), Data, { TEXT("AB") });
+	}
+
+	{
+		TArray<uint8> Data;
+		AddControl(Data, BS);
+		Check(TEXT("Paint-on backspace"), Data, { TEXT("A") });
+	}
+
+	// state spans calls, so pairs may arrive one field at a time
+	Decoder.Reset();
+	{
+		TArray<uint8> Data;
+		AddControl(Data, RCL);
+		AddText(Data, "SPLIT");
+		AddControl(Data, EOC);
+
+		TArray<FString> Captions;
+
+		for (int32 Index = 0; Index < Data.Num(); Index += 2)
+		{
+			Captions.Append(Decode(Decoder, EDirectShowMediaCaptionFormat::CEA608, TArray<uint8>(Data.GetData() + Index, 2)));
+		}
+
+		TestEqual(TEXT("Pairs decoded one at a time"), Join(Captions), Join({ TEXT("SPLIT") }));
+	}
+
+	return true;
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDirectShowMediaCaptionDecoderCEA708Test, "DirectShowMedia.CaptionDecoder.CEA708", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FDirectShowMediaCaptionDecoderCEA708Test::RunTest(const FString& Parameters)
+{
+	using namespace DirectShowMediaCaptionDecoderTest;
+
+	FDirectShowMediaCaptionDecoder Decoder;
+
+	// each case starts with a fresh window
+	auto Check = [this, &Decoder](const TCHAR* What, const TArray<uint8>& ServiceBlocks, const TArray<FString>& Expected)
+	{
+		Decoder.Reset();
+
+		const TArray<FString> Captions = Decode(Decoder, EDirectShowMediaCaptionFormat::CEA708, MakePacket(ServiceBlocks));
+		TestEqual(FString::Printf(TEXT("%s: %s"), What, *Join(Captions)), Join(Captions), Join(Expected));
+	};
+
+	{
+		TArray<uint8> Blocks;
+		AddServiceBlock(Blocks, 1, { 'H', 'I', 0x03 });
+		Check(TEXT("End of text"), Blocks, { TEXT("HI") });
+	}
+
+	// the window keeps its text until cleared
+	{
+		TArray<uint8> Blocks;
+		AddServiceBlock(Blocks, 1, { 'A', 0x03, 'B', 0x03, 0x0c, 'C', 0x03 });
+		Check(TEXT("Form feed"), Blocks, { TEXT("A"), TEXT("AB"), TEXT("C") });
+	}
+
+	{
+		TArray<uint8> Blocks;
+		AddServiceBlock(Blocks, 1, { 'A', 0x0d, 'B', 'X', 0x08, 0x03 });
+		Check(TEXT("Carriage return and backspace"), Blocks, { TEXT("A\nB") });
+	}
+
+	// window commands carry parameters that must not show as text
+	{
+		TArray<uint8> Blocks;
+		AddServiceBlock(Blocks, 1, { 0x98, 'A', 'B', 'C', 'D', 'E', 'F', 'O', 'K', 0x89, 0x01 });
+		Check(TEXT("Define and display windows"), Blocks, { TEXT("OK") });
+	}
+
+	{
+		TArray<uint8> Blocks;
+		AddServiceBlock(Blocks, 1, { 'O', 'L', 'D', 0x88, 0x01, 'N', 'E', 'W', 0x03 });
+		Check(TEXT("Clear windows"), Blocks, { TEXT("NEW") });
+	}
+
+	{
+		TArray<uint8> Blocks;
+		AddServiceBlock(Blocks, 1, { 0x7f, 0x10, 0x20, 0xe9, 0x03 });
+
+		const TCHAR Expected[] = { (TCHAR)0x266A, TEXT(' '), (TCHAR)0x00E9 };
+		Check(TEXT("Music note, extended space and Latin-1"), Blocks, { FString(3, Expected) });
+	}
+
+	// only service 1 is shown, including after other services in the same packet
+	{
+		TArray<uint8> Blocks;
+		AddServiceBlock(Blocks, 2, { 'N', 'O', 0x03 });
+		AddServiceBlock(Blocks, 8, { 'N', 'O', 0x03 });
+		AddServiceBlock(Blocks, 1, { 'Y', 'E', 'S', 0x03 });
+		Check(TEXT("Other services"), Blocks, { TEXT("YES") });
+	}
+
+	// packets may span calls
+	Decoder.Reset();
+	{
+		TArray<uint8> Blocks;
+		AddServiceBlock(Blocks, 1, { 'S', 'P', 'L', 'I', 'T', 0x03 });
+		const TArray<uint8> Triplets = MakePacket(Blocks);
+
+		TArray<FString> Captions;
+
+		for (int32 Index = 0; Index < Triplets.Num(); Index += 3)
+		{
+			Captions.Append(Decode(Decoder, EDirectShowMediaCaptionFormat::CEA708, TArray<uint8>(Triplets.GetData() + Index, 3)));
+		}
+
+		TestEqual(TEXT("Packet decoded one triplet at a time"), Join(Captions), Join({ TEXT("SPLIT") }));
+	}
+
+	// 608 captions carried in cc_data field 1 triplets
+	Decoder.Reset();
+	{
+		TArray<uint8> Pairs;
+		AddControl(Pairs, RCL);
+		AddText(Pairs, "CC1");
+		AddControl(Pairs, EOC);
+
+		TArray<uint8> Triplets;
+
+		for (int32 Index = 0; Index < Pairs.Num(); Index += 2)
+		{
+			Triplets.Add(0xfc); // cc_valid, field 1
+			Triplets.Add(Pairs[Index]);
+			Triplets.Add(Pairs[Index + 1]);
+
+			Triplets.Add(0xf8); // not valid, ignored
+			Triplets.Add('X');
+			Triplets.Add('X');
+		}
+
+		const TArray<FString> Captions = Decode(Decoder, EDirectShowMediaCaptionFormat::CEA708, Triplets);
+		TestEqual(TEXT("608 in cc_data"), Join(Captions), Join({ TEXT("CC1") }));
+	}
+
+	return true;
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDirectShowMediaCaptionDecoderMarkupTest, "DirectShowMedia.CaptionDecoder.Markup", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FDirectShowMediaCaptionDecoderMarkupTest::RunTest(const FString& Parameters)
+{
+	using namespace DirectShowMediaCaptionDecoderTest;
+
+	struct FCase
+	{
+		const ANSICHAR* Text;
+		const TCHAR* Expected;
+	};
+
+	const FCase Cases[] =
+	{
+		{ "<i>Hello</i> world", TEXT("Hello world") },
+		{ "No tags", TEXT("No tags") },
+		{ "Lead <b>bold</b>", TEXT("Lead bold") },
+		{ "<font color=\"a>b\">Hi</font>", TEXT("Hi") },
+		{ "<font face='x > y'>Hi</font>", TEXT("Hi") },
+		{ "a < b", TEXT("a < b") },
+		{ "<unterminated", TEXT("<unterminated") },
+	};
+
+	TCHAR Buffer[FDirectShowMediaCaptionDecoder::MaxCaptionLength];
+
+	for (const FCase& Case : Cases)
+	{
+		const int32 Length = FDirectShowMediaCaptionDecoder::StripMarkup(Case.Text, FCStringAnsi::Strlen(Case.Text), Buffer, UE_ARRAY_COUNT(Buffer));
+		TestEqual(FString::Printf(TEXT("'%s' is stripped"), ANSI_TO_TCHAR(Case.Text)), FString(Length, Buffer), FString(Case.Expected));
+	}
+
+	TestEqual(TEXT("Stripping stops at the capacity"), FDirectShowMediaCaptionDecoder::StripMarkup("<i>abcdef</i>", 13, Buffer, 3), 3);
+	TestEqual(TEXT("Stripping keeps the first characters"), FString(3, Buffer), FString(TEXT("abc")));
+
+	// text captions go through the same pass
+	FDirectShowMediaCaptionDecoder Decoder;
+	const ANSICHAR Text[] = "<i>Text</i> caption";
+
+	TestEqual(TEXT("Text captions are stripped"), Join(Decode(Decoder, EDirectShowMediaCaptionFormat::Text, TArray<uint8>((const uint8*)Text, sizeof(Text)))), Join({ TEXT("Text caption") }));
+
+	return true;
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDirectShowMediaCaptionDecoderThroughputTest, "DirectShowMedia.CaptionDecoder.Throughput", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FDirectShowMediaCaptionDecoderThroughputTest::RunTest(const FString& Parameters)
+{
+	using namespace DirectShowMediaCaptionDecoderTest;
+
+	// styled subtitle lines, each starting with a tag so both paths keep all of their text
+	TArray<TArray<uint8>> Lines;
+
+	for (int32 Index = 0; Index < 64; ++Index)
+	{
+		const FString Line = FString::Printf(TEXT("<font color=\"#ffff00\"><i>Line %d of the caption</i> spoken by <b>someone</b></font>"), Index);
+		TArray<uint8>& Data = Lines.AddDefaulted_GetRef();
+
+		for (int32 CharIndex = 0; CharIndex < Line.Len(); ++CharIndex)
+		{
+			Data.Add((uint8)Line[CharIndex]);
+		}
+
+		Data.Add(0);
+	}
+
+	FDirectShowMediaCaptionDecoder Decoder;
+	int32 NumMismatches = 0;
+
+	for (const TArray<uint8>& Data : Lines)
+	{
+		const TArray<FString> Captions = Decode(Decoder, EDirectShowMediaCaptionFormat::Text, Data);
+
+		if ((Captions.Num() != 1) || !Captions[0].Equals(StripWithRegex((const ANSICHAR*)Data.GetData())))
+		{
+			++NumMismatches;
+		}
+	}
+
+	TestEqual(TEXT("The decoder strips like the regex path"), NumMismatches, 0);
+
+	const int32 NumRounds = 200;
+	int32 NumChars = 0;
+
+	double StartTime = FPlatformTime::Seconds();
+
+	for (int32 Round = 0; Round < NumRounds; ++Round)
+	{
+		for (const TArray<uint8>& Data : Lines)
+		{
+			NumChars += StripWithRegex((const ANSICHAR*)Data.GetData()).Len();
+		}
+	}
+
+	const double RegexCost = (FPlatformTime::Seconds() - StartTime) * 1.0e6 / (NumRounds * Lines.Num());
+
+	StartTime = FPlatformTime::Seconds();
+
+	for (int32 Round = 0; Round < NumRounds; ++Round)
+	{
+		for (const TArray<uint8>& Data : Lines)
+		{
+			Decoder.Decode(EDirectShowMediaCaptionFormat::Text, Data.GetData(), Data.Num(), [&NumChars](const TCHAR* Text, int32 Length)
+			{
+				NumChars += Length;
+			});
+		}
+	}
+
+	const double DecoderCost = (FPlatformTime::Seconds() - StartTime) * 1.0e6 / (NumRounds * Lines.Num());
+
+	// a minute of roll-up captions at field rate
+	TArray<uint8> Field;
+	AddControl(Field, RU3);
+
+	for (int32 Index = 0; Index < 16; ++Index)
+	{
+		AddText(Field, "THE QUICK BROWN FOX");
+		AddControl(Field, CR);
+	}
+
+	const int32 NumPairs = Field.Num() / 2;
+	const int32 NumFieldRounds = 3600 * 2 / NumPairs + 1;
+
+	StartTime = FPlatformTime::Seconds();
+
+	for (int32 Round = 0; Round < NumFieldRounds; ++Round)
+	{
+		Decoder.Decode(EDirectShowMediaCaptionFormat::CEA608, Field.GetData(), Field.Num(), [&NumChars](const TCHAR* Text, int32 Length)
+		{
+			NumChars += Length;
+		});
+	}
+
+	const double PairCost = (FPlatformTime::Seconds() - StartTime) * 1.0e9 / (NumFieldRounds * NumPairs);
+
+	AddInfo(FString::Printf(TEXT("Stripping a styled line costs %.2f us with the regex path, %.2f us with the decoder; a 608 pair costs %.1f ns (%d characters)"), RegexCost, DecoderCost, PairCost, NumChars));
+
+	// generous bounds, so debug builds and loaded machines pass while a regex or an allocation per caption doesn't
+	TestTrue(FString::Printf(TEXT("The decoder is faster than the regex path (%.2f us against %.2f us)"), DecoderCost, RegexCost), DecoderCost < RegexCost);
+	TestTrue(FString::Printf(TEXT("A 608 pair decodes in well under a field (%.1f ns)"), PairCost), PairCost < 1000.0);
+
+	return true;
+}
+
+
+#endif //WITH_DEV_AUTOMATION_TESTS
@@ -0,0 +1,363 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "CoreTypes.h"
+#include "Misc/AutomationTest.h"
+
+#include <atomic>
+
+#include "Async/Async.h"
+#include "HAL/PlatformMisc.h"
+#include "HAL/PlatformProcess.h"
+#include "HAL/PlatformTime.h"
+#include "HAL/UnrealMemory.h"
+#include "Player/DirectShowMediaCaptureWorker.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+
+namespace DirectShowMediaCaptureWorkerTest
+{
+	/** A buffer of the sample grabber's allocator, referenced from both the streaming and the worker thread. */
+	class FFakeMediaSample
+		: public IMediaSample
+	{
+	public:
+
+		explicit FFakeMediaSample(int32 Size = 0)
+			: NumRefs(1)
+		{
+			Frame.SetNumZeroed(Size);
+		}
+
+		virtual ~FFakeMediaSample() { }
+
+		/** Whether the buffer is back in the allocator. */
+		bool IsFree() const
+		{
+			return (NumRefs.load() == 1);
+		}
+
+	public:
+
+		virtual HRESULT STDMETHODCALLTYPE QueryInterface(REFIID, void** Object) override { *Object = nullptr; return E_NOINTERFACE; }
+		virtual ULONG STDMETHODCALLTYPE AddRef() override { return ++NumRefs; }
+		virtual ULONG STDMETHODCALLTYPE Release() override { return --NumRefs; }
+
+		virtual HRESULT STDMETHODCALLTYPE GetPointer(BYTE** Buffer) override { *Buffer = Frame.GetData(); return S_OK; }
+		virtual long STDMETHODCALLTYPE GetSize() override { return Frame.Num(); }
+		virtual HRESULT STDMETHODCALLTYPE GetTime(REFERENCE_TIME*, REFERENCE_TIME*) override { return E_NOTIMPL; }
+		virtual HRESULT STDMETHODCALLTYPE SetTime(REFERENCE_TIME*, REFERENCE_TIME*) override { return E_NOTIMPL; }
+		virtual HRESULT STDMETHODCALLTYPE IsSyncPoint() override { return S_OK; }
+		virtual HRESULT STDMETHODCALLTYPE SetSyncPoint(BOOL) override { return E_NOTIMPL; }
+		virtual HRESULT STDMETHODCALLTYPE IsPreroll() override { return S_FALSE; }
+		virtual HRESULT STDMETHODCALLTYPE SetPreroll(BOOL) override { return E_NOTIMPL; }
+		virtual long STDMETHODCALLTYPE GetActualDataLength() override { return Frame.Num(); }
+		virtual HRESULT STDMETHODCALLTYPE SetActualDataLength(long) override { return E_NOTIMPL; }
+		virtual HRESULT STDMETHODCALLTYPE GetMediaType(AM_MEDIA_TYPE** MediaType) override { *MediaType = nullptr; return S_FALSE; }
+		virtual HRESULT STDMETHODCALLTYPE SetMediaType(AM_MEDIA_TYPE*) override { return E_NOTIMPL; }
+		virtual HRESULT STDMETHODCALLTYPE IsDiscontinuity() override { return S_FALSE; }
+		virtual HRESULT STDMETHODCALLTYPE SetDiscontinuity(BOOL) override { return E_NOTIMPL; }
+		virtual HRESULT STDMETHODCALLTYPE GetMediaTime(LONGLONG*, LONGLONG*) override { return E_NOTIMPL; }
+		virtual HRESULT STDMETHODCALLTYPE SetMediaTime(LONGLONG*, LONGLONG*) override { return E_NOTIMPL; }
+
+	public:
+
+		/** The captured frame. */
+		TArray<uint8> Frame;
+
+		/** Number of references, one held by the allocator. */
+		std::atomic<ULONG> NumRefs;
+	};
+
+	/** Wait until a condition holds, or give up after a few seconds. */
+	template<typename ConditionType>
+	bool WaitFor(ConditionType Condition)
+	{
+		const double Timeout = FPlatformTime::Seconds() + 5.0;
+
+		while (!Condition())
+		{
+			if (FPlatformTime::Seconds() > Timeout)
+			{
+				return false;
+			}
+
+			FPlatformProcess::Sleep(0.0f);
+		}
+
+		return true;
+	}
+
+	/** Timings of a synthetic streaming thread. */
+	struct FDriverResult
+	{
+		/** Median time the callback took (in seconds). */
+		double MedianCallback;
+
+		/** Longest time the callback took (in seconds). */
+		double MaxCallback;
+
+		/** Number of frames that found no free buffer and had to wait for one. */
+		int32 NumStarved;
+	};
+
+	/**
+	 * Emulate the DirectShow streaming thread: fill a free buffer of the allocator and call back for each frame.
+	 *
+	 * @param Allocator The allocator's buffers.
+	 * @param NumFrames Number of frames to capture.
+	 * @param Interval Time between frames (in seconds), or zero to capture as fast as possible.
+	 * @param Callback The sample grabber callback.
+	 */
+	FDriverResult Drive(TArray<FFakeMediaSample*>& Allocator, int32 NumFrames, double Interval, TFunction<void(double, IMediaSample*)> Callback)
+	{
+		TArray<double> Costs;
+		Costs.Reserve(NumFrames);
+
+		FDriverResult Result = { 0.0, 0.0, 0 };
+		const double StartTime = FPlatformTime::Seconds();
+
+		for (int32 FrameIndex = 0; FrameIndex < NumFrames; ++FrameIndex)
+		{
+			// the device is idle until its next frame, which leaves the core to the worker
+			for (double Remaining = StartTime + FrameIndex * Interval - FPlatformTime::Seconds(); Remaining > 0.0; Remaining = StartTime + FrameIndex * Interval - FPlatformTime::Seconds())
+			{
+				FPlatformProcess::Sleep((float)Remaining);
+			}
+
+			FFakeMediaSample* const* Free = Allocator.FindByPredicate([](const FFakeMediaSample* Buffer) { return Buffer->IsFree(); });
+
+			if (Free == nullptr)
+			{
+				// the device stalls until a buffer comes back
+				++Result.NumStarved;
+
+				if (!WaitFor([&Allocator, &Free]() { Free = Allocator.FindByPredicate([](const FFakeMediaSample* Buffer) { return Buffer->IsFree(); }); return (Free != nullptr); }))
+				{
+					break;
+				}
+			}
+
+			FFakeMediaSample* Sample = *Free;
+
+			Sample->Frame[0] = (uint8)FrameIndex;
+
+			const double CallbackStart = FPlatformTime::Seconds();
+			Callback(FrameIndex * Interval, Sample);
+			Costs.Add(FPlatformTime::Seconds() - CallbackStart);
+		}
+
+		if (Costs.Num() == 0)
+		{
+			return Result;
+		}
+
+		Costs.Sort();
+
+		Result.MedianCallback = Costs[Costs.Num() / 2];
+		Result.MaxCallback = Costs.Last();
+
+		return Result;
+	}
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDirectShowMediaCaptureWorkerQueueTest, "DirectShowMedia.CaptureWorker.Queue", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FDirectShowMediaCaptureWorkerQueueTest::RunTest(const FString& Parameters)
+{
+	using namespace DirectShowMediaCaptureWorkerTest;
+
+	FFakeMediaSample Samples[5];
+	TArray<double> Handled;
+	std::atomic<int32> NumEntered(0);
+	std::atomic<bool> bBlocked(true);
+
+	FDirectShowMediaCaptureWorker Worker;
+
+	// a handler that can be held up, like a slow conversion
+	const bool bStarted = Worker.Start([&Handled, &NumEntered, &bBlocked](double Time, IMediaSample* Sample)
+	{
+		++NumEntered;
+
+		while (bBlocked)
+		{
+			FPlatformProcess::Sleep(0.0f);
+		}
+
+		Handled.Add(Time);
+	}, 2, TPri_Normal, 0);
+
+	if (!TestTrue(TEXT("The worker starts"), bStarted && Worker.IsRunning()))
+	{
+		return false;
+	}
+
+	TestTrue(TEXT("A sample is posted"), Worker.Post(0.0, &Samples[0]));
+	TestTrue(TEXT("The worker handles it"), WaitFor([&NumEntered]() { return (NumEntered == 1); }));
+
+	// two samples wait behind the one being handled, the next one is dropped without being referenced
+	TestTrue(TEXT("A sample is queued"), Worker.Post(1.0, &Samples[1]));
+	TestTrue(TEXT("Another sample is queued"), Worker.Post(2.0, &Samples[2]));
+	TestFalse(TEXT("A sample past the queue depth is dropped"), Worker.Post(3.0, &Samples[3]));
+
+	TestEqual(TEXT("Queued samples are counted"), Worker.GetNumPosted(), (uint64)3);
+	TestEqual(TEXT("Dropped samples are counted"), Worker.GetNumDropped(), (uint64)1);
+	TestTrue(TEXT("Queued samples are referenced"), !Samples[0].IsFree() && !Samples[1].IsFree() && !Samples[2].IsFree());
+	TestTrue(TEXT("Dropped samples aren't referenced"), Samples[3].IsFree());
+
+	// a format change drops what's queued, but not the sample being handled
+	Worker.Flush();
+	bBlocked = false;
+
+	TestTrue(TEXT("Flushed samples are released"), WaitFor([&Samples]() { return Samples[0].IsFree() && Samples[1].IsFree() && Samples[2].IsFree(); }));
+
+	TestTrue(TEXT("Samples posted after a flush are handled"), Worker.Post(4.0, &Samples[4]));
+	TestTrue(TEXT("Handled samples are released"), WaitFor([&Samples]() { return Samples[4].IsFree(); }));
+
+	// samples left in the queue at shutdown are released, whether or not the worker got to them
+	bBlocked = true;
+
+	for (int32 Index = 0; Index < 3; ++Index)
+	{
+		Worker.Post(5.0 + Index, &Samples[Index]);
+	}
+
+	bBlocked = false;
+	Worker.Shutdown();
+
+	TestFalse(TEXT("The worker stopped"), Worker.IsRunning());
+	TestFalse(TEXT("Samples aren't posted after shutdown"), Worker.Post(8.0, &Samples[3]));
+
+	int32 NumReferenced = 0;
+
+	for (const FFakeMediaSample& Sample : Samples)
+	{
+		NumReferenced += Sample.IsFree() ? 0 : 1;
+	}
+
+	TestEqual(TEXT("All samples are released"), NumReferenced, 0);
+
+	if (TestTrue(TEXT("Flushed samples aren't handled"), (Handled.Num() >= 2) && (Handled[0] == 0.0) && (Handled[1] == 4.0)))
+	{
+		int32 NumOutOfOrder = 0;
+
+		for (int32 Index = 1; Index < Handled.Num(); ++Index)
+		{
+			NumOutOfOrder += (Handled[Index] <= Handled[Index - 1]) ? 1 : 0;
+		}
+
+		TestEqual(TEXT("Samples are handled in order"), NumOutOfOrder, 0);
+	}
+
+	return true;
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDirectShowMediaCaptureWorkerLatencyTest, "DirectShowMedia.CaptureWorker.Latency", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FDirectShowMediaCaptureWorkerLatencyTest::RunTest(const FString& Parameters)
+{
+	using namespace DirectShowMediaCaptureWorkerTest;
+
+	// a 720p BGRA device with a six buffer allocator, converted by copying the frame out
+	const int32 FrameSize = 1280 * 720 * 4;
+	const int32 NumBuffers = 6;
+	const int32 QueueDepth = 3;
+	const int32 NumFrames = 120;
+
+	TArray<FFakeMediaSample*> Allocator;
+	TArray<uint8> Converted;
+	std::atomic<int32> NumHandled(0);
+
+	for (int32 Index = 0; Index < NumBuffers; ++Index)
+	{
+		Allocator.Add(new FFakeMediaSample(FrameSize));
+	}
+
+	Converted.SetNumUninitialized(FrameSize);
+
+	auto Convert = [&Converted, &NumHandled](double Time, IMediaSample* Sample)
+	{
+		BYTE* Buffer = nullptr;
+		Sample->GetPointer(&Buffer);
+		FMemory::Memcpy(Converted.GetData(), Buffer, Sample->GetActualDataLength());
+		++NumHandled;
+	};
+
+	// the conversion on the streaming thread, as without a worker
+	const FDriverResult Inline = Drive(Allocator, NumFrames, 0.0, Convert);
+
+	// the same conversion on the worker, with frames arriving at a steady rate of about twice the conversion time
+	FDirectShowMediaCaptureWorker Worker;
+
+	if (!TestTrue(TEXT("The worker starts"), Worker.Start(Convert, QueueDepth, TPri_AboveNormal, 0)))
+	{
+		return false;
+	}
+
+	NumHandled = 0;
+
+	const double Interval = FMath::Max(2.0 * Inline.MedianCallback, 0.001);
+	const FDriverResult Paced = Async(EAsyncExecution::Thread, [&Allocator, &Worker, NumFrames, Interval]()
+	{
+		return Drive(Allocator, NumFrames, Interval, [&Worker](double Time, IMediaSample* Sample) { Worker.Post(Time, Sample); });
+	}).Get();
+
+	const bool bPacedDrained = WaitFor([&Allocator]() { return Allocator.FindByPredicate([](const FFakeMediaSample* Sample) { return !Sample->IsFree(); }) == nullptr; });
+	const uint64 NumPacedDropped = Worker.GetNumDropped();
+	const int32 NumPacedHandled = NumHandled;
+	const double AverageLatency = Worker.GetAverageLatency();
+	const double MaxLatency = Worker.GetMaxLatency();
+
+	// and with frames arriving faster than they can be converted
+	Worker.Start(Convert, QueueDepth, TPri_AboveNormal, 0);
+	NumHandled = 0;
+
+	const double BurstStart = FPlatformTime::Seconds();
+	const FDriverResult Burst = Async(EAsyncExecution::Thread, [&Allocator, &Worker, NumFrames]()
+	{
+		return Drive(Allocator, NumFrames, 0.0, [&Worker](double Time, IMediaSample* Sample) { Worker.Post(Time, Sample); });
+	}).Get();
+
+	const bool bBurstDrained = WaitFor([&Allocator]() { return Allocator.FindByPredicate([](const FFakeMediaSample* Sample) { return !Sample->IsFree(); }) == nullptr; });
+	const double BurstTime = FPlatformTime::Seconds() - BurstStart;
+	const uint64 NumBurstPosted = Worker.GetNumPosted();
+	const uint64 NumBurstDropped = Worker.GetNumDropped();
+	const int32 NumBurstHandled = NumHandled;
+
+	Worker.Shutdown();
+
+	for (FFakeMediaSample* Sample : Allocator)
+	{
+		delete Sample;
+	}
+
+	AddInfo(FString::Printf(TEXT("Callback on the streaming thread: %.1f us converting inline, %.1f us posting (%.1f us at most)"), Inline.MedianCallback * 1e6, Paced.MedianCallback * 1e6, Paced.MaxCallback * 1e6));
+	AddInfo(FString::Printf(TEXT("Frames every %.0f us: %d handled, %llu dropped, %.1f us queue latency on average (%.1f us at most)"), Interval * 1e6, NumPacedHandled, NumPacedDropped, AverageLatency * 1e6, MaxLatency * 1e6));
+	AddInfo(FString::Printf(TEXT("Frames back to back: %d handled, %llu dropped, %.0f frames per second converted"), NumBurstHandled, NumBurstDropped, NumBurstHandled / BurstTime));
+
+	TestTrue(TEXT("The worker catches up with paced frames"), bPacedDrained);
+	TestTrue(TEXT("The worker catches up with a burst"), bBurstDrained);
+	TestEqual(TEXT("Every burst frame is either handled or dropped"), (uint64)NumBurstHandled + NumBurstDropped, (uint64)NumFrames);
+	TestEqual(TEXT("Every queued burst frame is handled"), (uint64)NumBurstHandled, NumBurstPosted);
+
+	// the queue is shorter than the allocator, so the device never finds its buffers referenced
+	TestEqual(TEXT("Paced frames always find a free buffer"), Paced.NumStarved, 0);
+	TestEqual(TEXT("Burst frames always find a free buffer"), Burst.NumStarved, 0);
+
+	// generous bounds, so debug builds and loaded machines pass while a copy on the streaming thread doesn't
+	TestTrue(TEXT("Paced frames are rarely dropped"), NumPacedDropped <= (uint64)(NumFrames / 10));
+
+	// with a single core, waking the worker preempts the streaming thread for the whole conversion
+	if (FPlatformMisc::NumberOfCoresIncludingHyperthreads() > 1)
+	{
+		TestTrue(TEXT("Posting is cheaper than converting"), Paced.MedianCallback < 0.5 * Inline.MedianCallback);
+		TestTrue(TEXT("Posting a burst is cheaper than converting"), Burst.MedianCallback < 0.5 * Inline.MedianCallback);
+	}
+
+	return true;
+}
+
+
+#endif //WITH_DEV_AUTOMATION_TESTS
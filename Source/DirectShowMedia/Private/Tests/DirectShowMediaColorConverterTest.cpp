@@ -0,0 +1,208 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "CoreTypes.h"
+#include "Misc/AutomationTest.h"
+
+#include "Player/DirectShowMediaColorConverter.h"
+
+#include "Windows/AllowWindowsPlatformTypes.h"
+#include <dshow.h>
+#include <dvdmedia.h>
+#include "Windows/HideWindowsPlatformTypes.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+
+namespace DirectShowMediaColorConverterTest
+{
+	/**
+	 * Convert a YUV triplet to 8 bit RGB with the equations of the standards.
+	 *
+	 * @param Kr Red luma weight.
+	 * @param Kb Blue luma weight.
+	 * @param bFullRange Whether YUV uses the full range.
+	 * @param Y Luma.
+	 * @param U Blue difference.
+	 * @param V Red difference.
+	 * @param OutRGB Will contain red, green and blue, clamped to 0-255 and rounded.
+	 */
+	void ConvertReference(double Kr, double Kb, bool bFullRange, int32 Y, int32 U, int32 V, int32 OutRGB[3])
+	{
+		const double Luma = bFullRange ? Y / 255.0 : (Y - 16) / 219.0;
+		const double Pb = bFullRange ? (U - 128) / 255.0 : (U - 128) / 224.0;
+		const double Pr = bFullRange ? (V - 128) / 255.0 : (V - 128) / 224.0;
+
+		const double Red = Luma + 2.0 * (1.0 - Kr) * Pr;
+		const double Blue = Luma + 2.0 * (1.0 - Kb) * Pb;
+		const double Green = (Luma - Kr * Red - Kb * Blue) / (1.0 - Kr - Kb);
+
+		OutRGB[0] = FMath::Clamp(FMath::RoundToInt32(Red * 255.0), 0, 255);
+		OutRGB[1] = FMath::Clamp(FMath::RoundToInt32(Green * 255.0), 0, 255);
+		OutRGB[2] = FMath::Clamp(FMath::RoundToInt32(Blue * 255.0), 0, 255);
+	}
+
+	/** Build a VIDEOINFOHEADER2 control flags value with color information. */
+	uint32 MakeControlFlags(uint32 NominalRange, uint32 TransferMatrix, uint32 TransferFunction)
+	{
+		return AMCONTROL_COLORINFO_PRESENT | (NominalRange << 12) | (TransferMatrix << 15) | (TransferFunction << 27);
+	}
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDirectShowMediaColorConverterMatrixTest, "DirectShowMedia.ColorConverter.Matrix", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FDirectShowMediaColorConverterMatrixTest::RunTest(const FString& Parameters)
+{
+	using namespace DirectShowMediaColorConverterTest;
+
+	struct FCase
+	{
+		EDirectShowMediaColorMatrix Matrix;
+		double Kr;
+		double Kb;
+	};
+
+	// luma weights as published in the standards
+	const FCase Cases[] =
+	{
+		{ EDirectShowMediaColorMatrix::BT601, 0.299, 0.114 },
+		{ EDirectShowMediaColorMatrix::BT709, 0.2126, 0.0722 },
+		{ EDirectShowMediaColorMatrix::BT2020, 0.2627, 0.0593 },
+	};
+
+	for (const FCase& Case : Cases)
+	{
+		for (int32 FullRange = 0; FullRange < 2; ++FullRange)
+		{
+			FDirectShowMediaColorimetry Colorimetry;
+			Colorimetry.Matrix = Case.Matrix;
+			Colorimetry.bFullRange = (FullRange != 0);
+
+			FDirectShowMediaColorConverter Converter;
+			Converter.Configure(Colorimetry);
+
+			int32 NumOff = 0;
+			int32 MaxError = 0;
+
+			// every third value of each component, including both ends of the range
+			for (int32 Y = 0; Y < 256; Y += (Y == 255) ? 1 : FMath::Min(3, 255 - Y))
+			{
+				for (int32 U = 0; U < 256; U += (U == 255) ? 1 : FMath::Min(3, 255 - U))
+				{
+					for (int32 V = 0; V < 256; V += (V == 255) ? 1 : FMath::Min(3, 255 - V))
+					{
+						int32 Expected[3];
+						ConvertReference(Case.Kr, Case.Kb, Colorimetry.bFullRange, Y, U, V, Expected);
+
+						uint8 Pixel[4];
+						Converter.ConvertPixel((uint8)Y, (uint8)U, (uint8)V, Pixel);
+
+						// BGRA
+						const int32 Error = FMath::Max3(FMath::Abs(Pixel[2] - Expected[0]), FMath::Abs(Pixel[1] - Expected[1]), FMath::Abs(Pixel[0] - Expected[2]));
+
+						if ((Error > 1) && (NumOff++ < 4))
+						{
+							AddError(FString::Printf(TEXT("%s: YUV %d %d %d is RGB %d %d %d instead of %d %d %d"), *Colorimetry.ToString(), Y, U, V, Pixel[2], Pixel[1], Pixel[0], Expected[0], Expected[1], Expected[2]));
+						}
+
+						MaxError = FMath::Max(MaxError, Error);
+					}
+				}
+			}
+
+			TestTrue(FString::Printf(TEXT("%s is within 1 LSB of the reference (max error %d)"), *Colorimetry.ToString(), MaxError), MaxError <= 1);
+
+			// the pair path shares chroma but must match the single pixel path
+			uint8 Pair[8];
+			uint8 Single[8];
+			Converter.ConvertPair(40, 200, 90, 170, Pair);
+			Converter.ConvertPixel(40, 90, 170, Single);
+			Converter.ConvertPixel(200, 90, 170, Single + 4);
+
+			TestTrue(FString::Printf(TEXT("%s converts pairs like single pixels"), *Colorimetry.ToString()), FMemory::Memcmp(Pair, Single, sizeof(Pair)) == 0);
+		}
+	}
+
+	// reference black and white
+	FDirectShowMediaColorConverter Converter;
+	FDirectShowMediaColorimetry Colorimetry;
+	uint8 Pixel[4];
+
+	Converter.Configure(Colorimetry);
+	Converter.ConvertPixel(16, 128, 128, Pixel);
+	TestTrue(TEXT("Limited range black is black"), (Pixel[0] == 0) && (Pixel[1] == 0) && (Pixel[2] == 0) && (Pixel[3] == 255));
+	Converter.ConvertPixel(235, 128, 128, Pixel);
+	TestTrue(TEXT("Limited range white is white"), (Pixel[0] == 255) && (Pixel[1] == 255) && (Pixel[2] == 255));
+
+	// linear light is encoded to sRGB, mid gray lands at 188
+	Colorimetry.bFullRange = true;
+	Colorimetry.TransferFunction = EDirectShowMediaTransferFunction::Linear;
+	Converter.Configure(Colorimetry);
+	Converter.ConvertPixel(128, 128, 128, Pixel);
+	TestTrue(FString::Printf(TEXT("Linear mid gray is sRGB 188 (got %d %d %d)"), Pixel[2], Pixel[1], Pixel[0]), (Pixel[0] == 188) && (Pixel[1] == 188) && (Pixel[2] == 188));
+
+	return true;
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDirectShowMediaColorConverterControlFlagsTest, "DirectShowMedia.ColorConverter.ControlFlags", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FDirectShowMediaColorConverterControlFlagsTest::RunTest(const FString& Parameters)
+{
+	using namespace DirectShowMediaColorConverterTest;
+
+	struct FCase
+	{
+		uint32 NominalRange;
+		uint32 TransferMatrix;
+		uint32 TransferFunction;
+		EDirectShowMediaColorMatrix Matrix;
+		bool bFullRange;
+		EDirectShowMediaTransferFunction Transfer;
+	};
+
+	// starting from BT.601 limited video gamma, unknown values leave the field as is
+	const FCase Cases[] =
+	{
+		{ 1, 1, 0, EDirectShowMediaColorMatrix::BT709, true, EDirectShowMediaTransferFunction::Video },
+		{ 2, 2, 5, EDirectShowMediaColorMatrix::BT601, false, EDirectShowMediaTransferFunction::Video },
+		{ 1, 3, 1, EDirectShowMediaColorMatrix::BT709, true, EDirectShowMediaTransferFunction::Linear },
+		{ 2, 4, 7, EDirectShowMediaColorMatrix::BT2020, false, EDirectShowMediaTransferFunction::sRGB },
+		{ 0, 5, 0, EDirectShowMediaColorMatrix::BT2020, false, EDirectShowMediaTransferFunction::Video },
+		{ 3, 0, 8, EDirectShowMediaColorMatrix::BT601, false, EDirectShowMediaTransferFunction::Video },
+		{ 7, 7, 31, EDirectShowMediaColorMatrix::BT601, false, EDirectShowMediaTransferFunction::Video },
+	};
+
+	// chroma siting (bits 8-11), lighting (18-21) and primaries (22-26) must not leak into the fields
+	const uint32 Neighbors = (0xf << 8) | (0xf << 18) | (0x1f << 22);
+
+	for (const FCase& Case : Cases)
+	{
+		for (int32 WithNeighbors = 0; WithNeighbors < 2; ++WithNeighbors)
+		{
+			const uint32 ControlFlags = MakeControlFlags(Case.NominalRange, Case.TransferMatrix, Case.TransferFunction) | (WithNeighbors ? Neighbors : 0);
+
+			FDirectShowMediaColorimetry Colorimetry = FDirectShowMediaColorimetry::GetDefault(480);
+
+			if (!TestTrue(FString::Printf(TEXT("Flags 0x%08x carry color information"), ControlFlags), Colorimetry.ApplyControlFlags(ControlFlags)))
+			{
+				continue;
+			}
+
+			TestEqual(FString::Printf(TEXT("Flags 0x%08x select matrix"), ControlFlags), (int32)Colorimetry.Matrix, (int32)Case.Matrix);
+			TestEqual(FString::Printf(TEXT("Flags 0x%08x select range"), ControlFlags), Colorimetry.bFullRange, Case.bFullRange);
+			TestEqual(FString::Printf(TEXT("Flags 0x%08x select transfer function"), ControlFlags), (int32)Colorimetry.TransferFunction, (int32)Case.Transfer);
+		}
+	}
+
+	FDirectShowMediaColorimetry Colorimetry = FDirectShowMediaColorimetry::GetDefault(1080);
+	const uint32 NoColorInfo = MakeControlFlags(1, 2, 7) & ~(uint32)AMCONTROL_COLORINFO_PRESENT;
+
+	TestFalse(TEXT("Flags without color information are ignored"), Colorimetry.ApplyControlFlags(NoColorInfo));
+	TestTrue(TEXT("Flags without color information leave the colorimetry as is"), Colorimetry == FDirectShowMediaColorimetry::GetDefault(1080));
+
+	return true;
+}
+
+
+#endif //WITH_DEV_AUTOMATION_TESTS
@@ -0,0 +1,156 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "CoreTypes.h"
+#include "Misc/AutomationTest.h"
+
+#include "Player/DirectShowMediaFrameArena.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+
+namespace DirectShowMediaFrameArenaTest
+{
+	/** Size of regular pages. */
+	const uint64 PageSize = 4096;
+
+	/** A 1080p BGRA frame. */
+	const uint64 FrameSize = 1920 * 1080 * 4;
+
+	/** The alignment the slots of an arena must have. */
+	uint64 GetSlotAlignment(const FDirectShowMediaFrameArena& Arena)
+	{
+		return (Arena.GetPages() == EDirectShowMediaFramePages::Large) ? FDirectShowMediaFrameArena::GetLargePageSize() : PageSize;
+	}
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDirectShowMediaFrameArenaPagesTest, "DirectShowMedia.FrameArena.Pages", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FDirectShowMediaFrameArenaPagesTest::RunTest(const FString& Parameters)
+{
+	using namespace DirectShowMediaFrameArenaTest;
+
+	// without the right (or without large pages at all) arenas asking for large pages get regular ones
+	const bool bLargePagesEnabled = FDirectShowMediaFrameArena::EnableLargePages();
+	const uint64 LargePageSize = FDirectShowMediaFrameArena::GetLargePageSize();
+
+	AddInfo(FString::Printf(TEXT("Large pages are %s (%llu bytes)"), bLargePagesEnabled ? TEXT("enabled") : TEXT("refused"), LargePageSize));
+
+	if (LargePageSize == 0)
+	{
+		TestFalse(TEXT("Large pages can't be enabled without large pages"), bLargePagesEnabled);
+	}
+
+	for (const bool bLargePages : { true, false })
+	{
+		const TSharedPtr<FDirectShowMediaFrameArena, ESPMode::ThreadSafe> Arena = FDirectShowMediaFrameArena::Create(FrameSize, 4, bLargePages);
+
+		if (!TestTrue(FString::Printf(TEXT("An arena is created (large pages %s)"), bLargePages ? TEXT("requested") : TEXT("not requested")), Arena.IsValid()))
+		{
+			continue;
+		}
+
+		const bool bExpectLargeSlots = bLargePages && bLargePagesEnabled;
+
+		if (!bExpectLargeSlots)
+		{
+			TestTrue(TEXT("The arena falls back to regular pages"), Arena->GetPages() == EDirectShowMediaFramePages::Regular);
+		}
+
+		// large page sized slots even if the region fell back to regular pages, so a retry isn't needed to grow them
+		const uint64 SlotAlignment = bExpectLargeSlots ? LargePageSize : PageSize;
+
+		TestEqual(TEXT("Slots are the frame size, rounded up to the page size"), Arena->GetSlotSize(), ((FrameSize + SlotAlignment - 1) / SlotAlignment) * SlotAlignment);
+		TestEqual(TEXT("Slots are counted"), Arena->GetNumSlots(), 4);
+
+		int32 NumMisaligned = 0;
+		int32 NumDirty = 0;
+
+		for (int32 Index = 0; Index < Arena->GetNumSlots(); ++Index)
+		{
+			int32 Slot = INDEX_NONE;
+			uint8* Memory = Arena->Acquire(FrameSize, Slot);
+
+			if (!TestNotNull(TEXT("A free slot is acquired"), Memory))
+			{
+				break;
+			}
+
+			if (((UPTRINT)Memory % GetSlotAlignment(*Arena)) != 0)
+			{
+				++NumMisaligned;
+			}
+
+			// the region was touched when it was created
+			if ((Memory[0] != 0) || (Memory[FrameSize - 1] != 0))
+			{
+				++NumDirty;
+			}
+		}
+
+		TestEqual(TEXT("Slots start on page boundaries"), NumMisaligned, 0);
+		TestEqual(TEXT("Slots are zeroed"), NumDirty, 0);
+	}
+
+	// slot sizes round up to regular pages when large pages aren't requested
+	const uint64 Sizes[][2] = { { 1, PageSize }, { PageSize, PageSize }, { PageSize + 1, 2 * PageSize }, { 1920 * 1080 * 2 + 100, 1013 * PageSize } };
+
+	for (const auto& Size : Sizes)
+	{
+		const TSharedPtr<FDirectShowMediaFrameArena, ESPMode::ThreadSafe> Arena = FDirectShowMediaFrameArena::Create(Size[0], 2, false);
+		TestTrue(FString::Printf(TEXT("A %llu byte frame takes a %llu byte slot"), Size[0], Size[1]), Arena.IsValid() && (Arena->GetSlotSize() == Size[1]));
+	}
+
+	TestFalse(TEXT("Empty frames have no arena"), FDirectShowMediaFrameArena::Create(0, 4, false).IsValid());
+	TestFalse(TEXT("Arenas need slots"), FDirectShowMediaFrameArena::Create(FrameSize, 0, false).IsValid());
+
+	return true;
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDirectShowMediaFrameArenaSlotsTest, "DirectShowMedia.FrameArena.Slots", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FDirectShowMediaFrameArenaSlotsTest::RunTest(const FString& Parameters)
+{
+	using namespace DirectShowMediaFrameArenaTest;
+
+	const TSharedPtr<FDirectShowMediaFrameArena, ESPMode::ThreadSafe> Arena = FDirectShowMediaFrameArena::Create(FrameSize, 3, false, 0);
+
+	if (!TestTrue(TEXT("An arena is created"), Arena.IsValid()))
+	{
+		return false;
+	}
+
+	TestEqual(TEXT("The arena keeps its node"), Arena->GetNode(), 0);
+
+	// the first slots are handed out first, back to back
+	uint8* Memory[3] = { };
+	int32 Slots[3] = { };
+
+	for (int32 Index = 0; Index < 3; ++Index)
+	{
+		Memory[Index] = Arena->Acquire(FrameSize, Slots[Index]);
+		TestEqual(FString::Printf(TEXT("Slot %d is handed out in order"), Index), Slots[Index], Index);
+	}
+
+	TestTrue(TEXT("Slots don't overlap"), (Memory[1] - Memory[0] == (PTRINT)Arena->GetSlotSize()) && (Memory[2] - Memory[1] == (PTRINT)Arena->GetSlotSize()));
+
+	// a full arena and a frame that doesn't fit are both misses
+	int32 Slot = INDEX_NONE;
+	TestNull(TEXT("A full arena has no slot"), Arena->Acquire(FrameSize, Slot));
+
+	Arena->Release(Slots[0]);
+	Arena->Release(Slots[2]);
+
+	TestNull(TEXT("A frame larger than a slot has no slot"), Arena->Acquire(Arena->GetSlotSize() + 1, Slot));
+	TestEqual(TEXT("Misses are counted"), Arena->GetNumMissed(), (uint64)2);
+
+	// the most recently released slot is reused first
+	TestTrue(TEXT("The last released slot is reused"), (Arena->Acquire(FrameSize, Slot) == Memory[2]) && (Slot == Slots[2]));
+	TestTrue(TEXT("Then the one before"), (Arena->Acquire(Arena->GetSlotSize(), Slot) == Memory[0]) && (Slot == Slots[0]));
+
+	return true;
+}
+
+
+#endif //WITH_DEV_AUTOMATION_TESTS
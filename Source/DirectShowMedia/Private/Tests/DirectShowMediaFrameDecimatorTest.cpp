@@ -0,0 +1,212 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "CoreTypes.h"
+#include "Misc/AutomationTest.h"
+
+#include "Player/DirectShowMediaFrameDecimator.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+
+namespace DirectShowMediaFrameDecimatorTest
+{
+	/** Statistics of a decimated synthetic stream. */
+	struct FDecimatedStream
+	{
+		int32 NumAccepted = 0;
+		int32 NumDropped = 0;
+		FTimespan FirstTime;
+		FTimespan LastTime;
+		FTimespan MinGap = FTimespan::MaxValue();
+		FTimespan MaxGap = FTimespan::Zero();
+		bool bRestamped = true;
+	};
+
+	/**
+	 * Feed a decimator frames at an exact rational rate, stamped as the device would (rounded to ticks).
+	 *
+	 * @param Decimator The decimator to feed.
+	 * @param Numerator Source frame rate numerator.
+	 * @param Denominator Source frame rate denominator.
+	 * @param NumFrames Number of source frames.
+	 * @param TargetRate The decimator's target frame rate.
+	 */
+	FDecimatedStream Run(FDirectShowMediaFrameDecimator& Decimator, int64 Numerator, int64 Denominator, int64 NumFrames, double TargetRate)
+	{
+		FDecimatedStream Stream;
+		FTimespan PreviousTime;
+
+		const double TargetInterval = (double)ETimespan::TicksPerSecond / TargetRate;
+		Decimator.SetTargetFrameRate(TargetRate);
+
+		for (int64 Frame = 0; Frame < NumFrames; ++Frame)
+		{
+			const FTimespan SourceTime(Frame * Denominator * ETimespan::TicksPerSecond / Numerator);
+			const FTimespan NextTime((Frame + 1) * Denominator * ETimespan::TicksPerSecond / Numerator);
+
+			FTimespan Time;
+			FTimespan Duration;
+
+			if (!Decimator.Accept(SourceTime, NextTime - SourceTime, Time, Duration))
+			{
+				++Stream.NumDropped;
+				continue;
+			}
+
+			if (Stream.NumAccepted == 0)
+			{
+				Stream.FirstTime = Time;
+			}
+			else
+			{
+				const FTimespan Gap = Time - PreviousTime;
+				Stream.MinGap = FMath::Min(Stream.MinGap, Gap);
+				Stream.MaxGap = FMath::Max(Stream.MaxGap, Gap);
+			}
+
+			// paced frames sit on the grid, whatever the source time was
+			const int64 Slot = (int64)FMath::RoundToDouble((double)(Time - Stream.FirstTime).GetTicks() / TargetInterval);
+
+			if ((Duration.GetTicks() != (int64)FMath::RoundToDouble(TargetInterval)) || ((Time - Stream.FirstTime).GetTicks() != (int64)FMath::RoundToDouble(Slot * TargetInterval)))
+			{
+				Stream.bRestamped = false;
+			}
+
+			PreviousTime = Time;
+			Stream.LastTime = Time;
+			++Stream.NumAccepted;
+		}
+
+		return Stream;
+	}
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDirectShowMediaFrameDecimatorCadenceTest, "DirectShowMedia.FrameDecimator.Cadence", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FDirectShowMediaFrameDecimatorCadenceTest::RunTest(const FString& Parameters)
+{
+	const int64 TenFpsInterval = ETimespan::TicksPerSecond / 10;
+
+	// ten minutes of each source, decimated to 10 fps
+	struct FSource
+	{
+		const TCHAR* Name;
+		int64 Numerator;
+		int64 Denominator;
+	};
+
+	const FSource Sources[] =
+	{
+		{ TEXT("59.94"), 60000, 1001 },
+		{ TEXT("60"), 60, 1 },
+		{ TEXT("30"), 30, 1 },
+	};
+
+	for (const FSource& Source : Sources)
+	{
+		const int64 NumFrames = 600 * Source.Numerator / Source.Denominator;
+
+		FDirectShowMediaFrameDecimator Decimator;
+		const DirectShowMediaFrameDecimatorTest::FDecimatedStream Stream = DirectShowMediaFrameDecimatorTest::Run(Decimator, Source.Numerator, Source.Denominator, NumFrames, 10.0);
+
+		// the grid doesn't drift: ten minutes of source give 6000 frames, give or take the last slot
+		TestTrue(FString::Printf(TEXT("%s fps gives 10 fps (%d frames)"), Source.Name, Stream.NumAccepted), FMath::Abs(Stream.NumAccepted - 6000) <= 1);
+		TestEqual(FString::Printf(TEXT("%s fps counts the dropped frames"), Source.Name), Decimator.GetNumDroppedFrames(), (uint64)Stream.NumDropped);
+		TestEqual(FString::Printf(TEXT("%s fps delivers or drops every frame"), Source.Name), (int64)(Stream.NumAccepted + Stream.NumDropped), NumFrames);
+		TestTrue(FString::Printf(TEXT("%s fps is paced evenly"), Source.Name), (Stream.MinGap.GetTicks() == TenFpsInterval) && (Stream.MaxGap.GetTicks() == TenFpsInterval));
+		TestTrue(FString::Printf(TEXT("%s fps is stamped on the grid"), Source.Name), Stream.bRestamped);
+		TestEqual(FString::Printf(TEXT("%s fps ends where the source ends"), Source.Name), Stream.LastTime.GetTicks() / TenFpsInterval, (int64)(Stream.NumAccepted - 1));
+	}
+
+	// 59.94 to 30 isn't every other frame, 1002 seconds of source give 30 frames for each second
+	{
+		FDirectShowMediaFrameDecimator Decimator;
+		const DirectShowMediaFrameDecimatorTest::FDecimatedStream Stream = DirectShowMediaFrameDecimatorTest::Run(Decimator, 60000, 1001, 60060, 30.0);
+
+		TestTrue(FString::Printf(TEXT("59.94 fps gives 30 fps (%d frames)"), Stream.NumAccepted), FMath::Abs(Stream.NumAccepted - 30060) <= 1);
+		TestTrue(TEXT("59.94 fps to 30 fps is stamped on the grid"), Stream.bRestamped);
+		TestTrue(TEXT("59.94 fps to 30 fps is paced within a tick"), (Stream.MaxGap - Stream.MinGap).GetTicks() <= 1);
+	}
+
+	return true;
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDirectShowMediaFrameDecimatorPassThroughTest, "DirectShowMedia.FrameDecimator.PassThrough", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FDirectShowMediaFrameDecimatorPassThroughTest::RunTest(const FString& Parameters)
+{
+	const FTimespan SourceDuration(ETimespan::TicksPerSecond / 30);
+
+	FTimespan Time;
+	FTimespan Duration;
+
+	// disabled, every frame passes with its own time
+	FDirectShowMediaFrameDecimator Decimator;
+	TestFalse(TEXT("Decimation is off by default"), Decimator.IsEnabled());
+	TestTrue(TEXT("Frames pass while disabled"), Decimator.Accept(FTimespan(12345), SourceDuration, Time, Duration));
+	TestEqual(TEXT("Frames keep their time while disabled"), Time, FTimespan(12345));
+
+	// a 30 fps source at a 30 or 60 fps target is already at or below the rate
+	for (const double TargetRate : { 30.0, 60.0 })
+	{
+		Decimator.SetTargetFrameRate(TargetRate);
+
+		int32 NumAccepted = 0;
+
+		for (int64 Frame = 0; Frame < 300; ++Frame)
+		{
+			const FTimespan SourceTime(Frame * SourceDuration.GetTicks() + 17);
+
+			if (Decimator.Accept(SourceTime, SourceDuration, Time, Duration) && (Time == SourceTime) && (Duration == SourceDuration))
+			{
+				++NumAccepted;
+			}
+		}
+
+		TestEqual(FString::Printf(TEXT("30 fps passes unchanged at %.0f fps"), TargetRate), NumAccepted, 300);
+	}
+
+	TestEqual(TEXT("Nothing was dropped"), Decimator.GetNumDroppedFrames(), (uint64)0);
+
+	return true;
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDirectShowMediaFrameDecimatorRestartTest, "DirectShowMedia.FrameDecimator.Restart", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FDirectShowMediaFrameDecimatorRestartTest::RunTest(const FString& Parameters)
+{
+	const int64 SourceInterval = ETimespan::TicksPerSecond / 60;
+	const int64 TargetInterval = ETimespan::TicksPerSecond / 10;
+
+	FDirectShowMediaFrameDecimator Decimator;
+	Decimator.SetTargetFrameRate(10.0);
+
+	FTimespan Time;
+	FTimespan Duration;
+
+	// one second of source anchors the grid at its first frame
+	const FTimespan Start(5 * ETimespan::TicksPerSecond);
+
+	for (int64 Frame = 0; Frame < 60; ++Frame)
+	{
+		Decimator.Accept(Start + FTimespan(Frame * SourceInterval), FTimespan(SourceInterval), Time, Duration);
+	}
+
+	// a stall skips the slots the source never reached instead of catching up
+	TestTrue(TEXT("The first frame after a stall is delivered"), Decimator.Accept(Start + FTimespan(3 * ETimespan::TicksPerSecond), FTimespan(SourceInterval), Time, Duration));
+	TestEqual(TEXT("The frame after a stall is stamped on its slot"), Time, Start + FTimespan(30 * TargetInterval));
+	TestFalse(TEXT("The next frame doesn't fill a skipped slot"), Decimator.Accept(Start + FTimespan(3 * ETimespan::TicksPerSecond + SourceInterval), FTimespan(SourceInterval), Time, Duration));
+
+	// a stream clock that restarts anchors a new grid
+	TestTrue(TEXT("The first frame after a restart is delivered"), Decimator.Accept(FTimespan(SourceInterval), FTimespan(SourceInterval), Time, Duration));
+	TestEqual(TEXT("The new grid starts at the restarted clock"), Time, FTimespan(SourceInterval));
+	TestFalse(TEXT("The following frame is dropped"), Decimator.Accept(FTimespan(2 * SourceInterval), FTimespan(SourceInterval), Time, Duration));
+
+	return true;
+}
+
+
+#endif //WITH_DEV_AUTOMATION_TESTS
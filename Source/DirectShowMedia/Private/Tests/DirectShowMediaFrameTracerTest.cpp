@@ -0,0 +1,334 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "CoreTypes.h"
+#include "Async/Async.h"
+#include "HAL/PlatformProcess.h"
+#include "HAL/PlatformTime.h"
+#include "Misc/AutomationTest.h"
+#include "Misc/ScopeLock.h"
+
+#include "Player/DirectShowMediaFrameTracer.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+
+namespace DirectShowMediaFrameTracerTest
+{
+	/** Split a Chrome trace into its events, one per line. */
+	TArray<FString> GetTraceLines()
+	{
+		TArray<FString> Lines;
+		FDirectShowMediaFrameTracer::Get().ToChromeTrace().ParseIntoArray(Lines, TEXT("\n"), true);
+
+		return Lines;
+	}
+
+	/** Parse the number following a key within a trace event, or return INDEX_NONE if the key is missing. */
+	int64 ParseValue(const FString& Line, const TCHAR* Key)
+	{
+		const int32 Index = Line.Find(Key);
+
+		return (Index == INDEX_NONE) ? INDEX_NONE : FCString::Atoi64(*Line + Index + FCString::Strlen(Key));
+	}
+
+	/** Count the slices of an event recorded for a track's frames. */
+	int32 CountSlices(const TArray<FString>& Lines, const TCHAR* Event, uint32 Track)
+	{
+		const FString EventPattern = FString::Printf(TEXT("{\"name\":\"%s\",\"cat\""), Event);
+		int32 Count = 0;
+
+		for (const FString& Line : Lines)
+		{
+			if (Line.Contains(EventPattern) && (ParseValue(Line, TEXT("\"player\":")) == Track))
+			{
+				++Count;
+			}
+		}
+
+		return Count;
+	}
+
+	/** Count the flow phases ("s", "t" or "f") of a track's frames. */
+	int32 CountFlowPhases(const TArray<FString>& Lines, const TCHAR* Phase, uint32 Track)
+	{
+		const FString PhasePattern = FString::Printf(TEXT("{\"name\":\"frame\",\"cat\":\"DirectShowMedia\",\"ph\":\"%s\""), Phase);
+		int32 Count = 0;
+
+		for (const FString& Line : Lines)
+		{
+			if (Line.Contains(PhasePattern) && (((uint64)ParseValue(Line, TEXT("\"id\":")) >> 40) == Track))
+			{
+				++Count;
+			}
+		}
+
+		return Count;
+	}
+
+	/** Restores the tracer's state when a test is done. */
+	struct FTracerStateGuard
+	{
+		FTracerStateGuard()
+			: bWasEnabled(FDirectShowMediaFrameTracer::IsEnabled())
+		{ }
+
+		~FTracerStateGuard()
+		{
+			FDirectShowMediaFrameTracer::Get().SetEnabled(bWasEnabled);
+		}
+
+		bool bWasEnabled;
+	};
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDirectShowMediaFrameTracerLoadTest, "DirectShowMedia.FrameTracer.Load", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FDirectShowMediaFrameTracerLoadTest::RunTest(const FString& Parameters)
+{
+	using namespace DirectShowMediaFrameTracerTest;
+
+	const FTracerStateGuard StateGuard;
+
+	// four players' streaming threads hand their frames to one consumer, like the game thread fetching them
+	const int32 NumPlayers = 4;
+	const int32 NumFrames = 1000;
+
+	TArray<uint32> Tracks;
+	TArray<uint64> Queued;
+	FCriticalSection QueueSection;
+	std::atomic<int32> NumProducing(NumPlayers);
+
+	for (int32 PlayerIndex = 0; PlayerIndex < NumPlayers; ++PlayerIndex)
+	{
+		Tracks.Add(FDirectShowMediaFrameTracer::NewTrack());
+	}
+
+	FDirectShowMediaFrameTracer::Get().SetEnabled(true);
+
+	TArray<TFuture<void>> Producers;
+
+	for (int32 PlayerIndex = 0; PlayerIndex < NumPlayers; ++PlayerIndex)
+	{
+		Producers.Add(Async(EAsyncExecution::Thread, [Track = Tracks[PlayerIndex], NumFrames, &Queued, &QueueSection, &NumProducing]()
+		{
+			for (int32 FrameNumber = 1; FrameNumber <= NumFrames; ++FrameNumber)
+			{
+				const uint64 Flow = FDirectShowMediaFrameTracer::MakeFlow(Track, FrameNumber);
+
+				FDirectShowMediaFrameTraceScope CallbackScope(EDirectShowMediaFrameEvent::Callback, Flow);
+				FDirectShowMediaFrameTraceScope HandleScope(EDirectShowMediaFrameEvent::Handle, Flow);
+				{
+					FDirectShowMediaFrameTraceScope LockWaitScope(EDirectShowMediaFrameEvent::LockWait, Flow);
+				}
+				{
+					FDirectShowMediaFrameTraceScope CopyScope(EDirectShowMediaFrameEvent::Copy, Flow);
+				}
+
+				FDirectShowMediaFrameTracer::Mark(EDirectShowMediaFrameEvent::Enqueue, Flow);
+
+				FScopeLock Lock(&QueueSection);
+				Queued.Add(Flow);
+			}
+
+			--NumProducing;
+		}));
+	}
+
+	TFuture<void> Consumer = Async(EAsyncExecution::Thread, [&Queued, &QueueSection, &NumProducing]()
+	{
+		while (true)
+		{
+			const bool bDone = (NumProducing.load() == 0);
+			TArray<uint64> Fetched;
+			{
+				FScopeLock Lock(&QueueSection);
+				Swap(Fetched, Queued);
+			}
+
+			for (uint64 Flow : Fetched)
+			{
+				FDirectShowMediaFrameTracer::Mark(EDirectShowMediaFrameEvent::Dequeue, Flow);
+				FDirectShowMediaFrameTracer::Mark(EDirectShowMediaFrameEvent::PoolReturn, Flow);
+			}
+
+			if (bDone && (Fetched.Num() == 0))
+			{
+				break;
+			}
+
+			FPlatformProcess::Sleep(0.0f);
+		}
+	});
+
+	for (const TFuture<void>& Producer : Producers)
+	{
+		Producer.Wait();
+	}
+
+	Consumer.Wait();
+
+	const TArray<FString> Lines = GetTraceLines();
+
+	// no event of any frame was lost, and every frame is linked from its callback to the pool
+	const TCHAR* const EventNames[] = { TEXT("Callback"), TEXT("Handle"), TEXT("LockWait"), TEXT("Copy"), TEXT("Enqueue"), TEXT("Dequeue"), TEXT("PoolReturn") };
+
+	for (uint32 Track : Tracks)
+	{
+		for (const TCHAR* EventName : EventNames)
+		{
+			TestEqual(FString::Printf(TEXT("Every frame of track %u has a %s slice"), Track, EventName), CountSlices(Lines, EventName, Track), NumFrames);
+		}
+
+		TestEqual(FString::Printf(TEXT("Every frame of track %u starts a flow"), Track), CountFlowPhases(Lines, TEXT("s"), Track), NumFrames);
+		TestEqual(FString::Printf(TEXT("Every frame of track %u steps through the other events"), Track), CountFlowPhases(Lines, TEXT("t"), Track), NumFrames * 5);
+		TestEqual(FString::Printf(TEXT("Every frame of track %u ends its flow"), Track), CountFlowPhases(Lines, TEXT("f"), Track), NumFrames);
+	}
+
+	int32 NumThreadNames = 0;
+
+	for (const FString& Line : Lines)
+	{
+		if (Line.Contains(TEXT("{\"name\":\"thread_name\"")))
+		{
+			++NumThreadNames;
+		}
+	}
+
+	TestTrue(FString::Printf(TEXT("Every recording thread is named (%d names)"), NumThreadNames), NumThreadNames >= NumPlayers + 1);
+
+	return true;
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDirectShowMediaFrameTracerRingTest, "DirectShowMedia.FrameTracer.Ring", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FDirectShowMediaFrameTracerRingTest::RunTest(const FString& Parameters)
+{
+	using namespace DirectShowMediaFrameTracerTest;
+
+	const FTracerStateGuard StateGuard;
+	const uint32 Track = FDirectShowMediaFrameTracer::NewTrack();
+	const int32 NumFrames = FDirectShowMediaFrameTracer::EventsPerThread * 2 + 100;
+
+	FDirectShowMediaFrameTracer::Get().SetEnabled(true);
+
+	// a thread recording more than its ring holds keeps the most recent events
+	Async(EAsyncExecution::Thread, [Track, NumFrames]()
+	{
+		for (int32 FrameNumber = 1; FrameNumber <= NumFrames; ++FrameNumber)
+		{
+			FDirectShowMediaFrameTracer::Mark(EDirectShowMediaFrameEvent::Enqueue, FDirectShowMediaFrameTracer::MakeFlow(Track, FrameNumber));
+		}
+	}).Wait();
+
+	const TArray<FString> Lines = GetTraceLines();
+	int64 OldestFrame = MAX_int64;
+	int64 NewestFrame = 0;
+
+	for (const FString& Line : Lines)
+	{
+		if (Line.Contains(TEXT("{\"name\":\"Enqueue\",\"cat\"")) && (ParseValue(Line, TEXT("\"player\":")) == Track))
+		{
+			const int64 Frame = ParseValue(Line, TEXT("\"frame\":"));
+
+			OldestFrame = FMath::Min(OldestFrame, Frame);
+			NewestFrame = FMath::Max(NewestFrame, Frame);
+		}
+	}
+
+	TestEqual(TEXT("The ring keeps as many events as it holds"), CountSlices(Lines, TEXT("Enqueue"), Track), FDirectShowMediaFrameTracer::EventsPerThread);
+	TestEqual(TEXT("The oldest events were overwritten"), OldestFrame, (int64)(NumFrames - FDirectShowMediaFrameTracer::EventsPerThread + 1));
+	TestEqual(TEXT("The newest event was kept"), NewestFrame, (int64)NumFrames);
+
+	return true;
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDirectShowMediaFrameTracerEnableTest, "DirectShowMedia.FrameTracer.Enable", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FDirectShowMediaFrameTracerEnableTest::RunTest(const FString& Parameters)
+{
+	using namespace DirectShowMediaFrameTracerTest;
+
+	const FTracerStateGuard StateGuard;
+	const uint32 Track = FDirectShowMediaFrameTracer::NewTrack();
+	FDirectShowMediaFrameTracer& Tracer = FDirectShowMediaFrameTracer::Get();
+
+	// nothing is recorded while tracing is disabled
+	Tracer.SetEnabled(false);
+	{
+		FDirectShowMediaFrameTraceScope Scope(EDirectShowMediaFrameEvent::Handle, FDirectShowMediaFrameTracer::MakeFlow(Track, 1));
+		FDirectShowMediaFrameTracer::Mark(EDirectShowMediaFrameEvent::Enqueue, FDirectShowMediaFrameTracer::MakeFlow(Track, 1));
+	}
+
+	Tracer.SetEnabled(true);
+	TestEqual(TEXT("Disabled tracing records nothing"), CountSlices(GetTraceLines(), TEXT("Handle"), Track) + CountSlices(GetTraceLines(), TEXT("Enqueue"), Track), 0);
+
+	// a scope begun while disabled isn't recorded once tracing is enabled
+	{
+		Tracer.SetEnabled(false);
+		FDirectShowMediaFrameTraceScope Scope(EDirectShowMediaFrameEvent::Copy, FDirectShowMediaFrameTracer::MakeFlow(Track, 2));
+		Tracer.SetEnabled(true);
+	}
+
+	TestEqual(TEXT("Scopes begun while disabled aren't recorded"), CountSlices(GetTraceLines(), TEXT("Copy"), Track), 0);
+
+	// enabling again discards what was recorded so far
+	FDirectShowMediaFrameTracer::Mark(EDirectShowMediaFrameEvent::Dequeue, FDirectShowMediaFrameTracer::MakeFlow(Track, 3));
+	TestEqual(TEXT("Enabled tracing records"), CountSlices(GetTraceLines(), TEXT("Dequeue"), Track), 1);
+
+	FPlatformProcess::Sleep(0.001f);
+	Tracer.SetEnabled(true);
+	FDirectShowMediaFrameTracer::Mark(EDirectShowMediaFrameEvent::PoolReturn, FDirectShowMediaFrameTracer::MakeFlow(Track, 4));
+
+	const TArray<FString> Lines = GetTraceLines();
+	TestEqual(TEXT("Enabling discards the earlier events"), CountSlices(Lines, TEXT("Dequeue"), Track), 0);
+	TestEqual(TEXT("Events after enabling are kept"), CountSlices(Lines, TEXT("PoolReturn"), Track), 1);
+
+	return true;
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDirectShowMediaFrameTracerOverheadTest, "DirectShowMedia.FrameTracer.Overhead", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FDirectShowMediaFrameTracerOverheadTest::RunTest(const FString& Parameters)
+{
+	using namespace DirectShowMediaFrameTracerTest;
+
+	const FTracerStateGuard StateGuard;
+	const uint32 Track = FDirectShowMediaFrameTracer::NewTrack();
+	const int32 NumFrames = 1 << 20;
+
+	// each frame records a slice and an instant event, as the streaming thread does per sample
+	auto MeasureNanosecondsPerEvent = [Track, NumFrames](bool bEnabled)
+	{
+		FDirectShowMediaFrameTracer::Get().SetEnabled(bEnabled);
+
+		const double StartTime = FPlatformTime::Seconds();
+
+		for (int32 FrameNumber = 1; FrameNumber <= NumFrames; ++FrameNumber)
+		{
+			const uint64 Flow = FDirectShowMediaFrameTracer::MakeFlow(Track, FrameNumber);
+
+			FDirectShowMediaFrameTraceScope Scope(EDirectShowMediaFrameEvent::Copy, Flow);
+			FDirectShowMediaFrameTracer::Mark(EDirectShowMediaFrameEvent::Enqueue, Flow);
+		}
+
+		return (FPlatformTime::Seconds() - StartTime) * 1.0e9 / (NumFrames * 2.0);
+	};
+
+	const double DisabledCost = MeasureNanosecondsPerEvent(false);
+	const double EnabledCost = MeasureNanosecondsPerEvent(true);
+
+	AddInfo(FString::Printf(TEXT("Recording costs %.1f ns per event while disabled, %.1f ns while enabled"), DisabledCost, EnabledCost));
+
+	// generous bounds, so debug builds and loaded machines pass while a lock or an allocation per event doesn't
+	TestTrue(FString::Printf(TEXT("Disabled tracing is a load per event (%.1f ns)"), DisabledCost), DisabledCost < 50.0);
+	TestTrue(FString::Printf(TEXT("Enabled tracing is a clock read and a store per event (%.1f ns)"), EnabledCost), EnabledCost < 1000.0);
+
+	return true;
+}
+
+
+#endif //WITH_DEV_AUTOMATION_TESTS
@@ -0,0 +1,232 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "CoreTypes.h"
+#include "Misc/AutomationTest.h"
+
+#include <atomic>
+
+#include "Async/Async.h"
+#include "HAL/PlatformProcess.h"
+#include "MediaObjectPool.h"
+#include "Player/DirectShowMediaMailbox.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+
+namespace DirectShowMediaMailboxTest
+{
+	/** Number of samples that were ever created. */
+	std::atomic<int32> NumCreated(0);
+
+	/** Number of samples taken from the pool and not returned yet. */
+	std::atomic<int32> NumOutstanding(0);
+
+	/** A pooled sample that checks it wasn't overwritten while in use. */
+	struct FSample
+		: public IMediaPoolable
+	{
+		int64 Sequence = 0;
+		int64 Check = 0;
+
+		FSample()
+		{
+			++NumCreated;
+		}
+
+		void Set(int64 InSequence)
+		{
+			Sequence = InSequence;
+			Check = ~InSequence;
+		}
+
+		bool IsIntact() const
+		{
+			return (Check == ~Sequence);
+		}
+
+		virtual void InitializePoolable() override
+		{
+			++NumOutstanding;
+		}
+
+		virtual void ShutdownPoolable() override
+		{
+			Set(0);
+			--NumOutstanding;
+		}
+	};
+
+	typedef TDirectShowMediaMailbox<FSample> FMailbox;
+
+	/** Publish a new sample from the pool. */
+	void Publish(FMailbox& Mailbox, TMediaObjectPool<FSample>& Pool, int64 Sequence)
+	{
+		const TSharedRef<FSample, ESPMode::ThreadSafe> Sample = Pool.AcquireShared();
+		Sample->Set(Sequence);
+		Mailbox.Publish(Sample);
+	}
+
+	/** Fetch a sample's sequence number, or zero if there is none. */
+	int64 Fetch(FMailbox& Mailbox)
+	{
+		FMailbox::FSamplePtr Sample;
+		return Mailbox.Fetch(Sample) ? Sample->Sequence : 0;
+	}
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDirectShowMediaMailboxLatestTest, "DirectShowMedia.Mailbox.Latest", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FDirectShowMediaMailboxLatestTest::RunTest(const FString& Parameters)
+{
+	using namespace DirectShowMediaMailboxTest;
+
+	NumOutstanding = 0;
+	{
+		TMediaObjectPool<FSample> Pool;
+		FMailbox Mailbox;
+
+		TestEqual(TEXT("An empty mailbox has nothing"), Fetch(Mailbox), (int64)0);
+
+		Publish(Mailbox, Pool, 1);
+		TestEqual(TEXT("A published sample is fetched"), Fetch(Mailbox), (int64)1);
+		TestEqual(TEXT("A sample is fetched once"), Fetch(Mailbox), (int64)0);
+
+		// only the newest of several samples is fetched, the others go back to the pool right away
+		Publish(Mailbox, Pool, 2);
+		Publish(Mailbox, Pool, 3);
+		Publish(Mailbox, Pool, 4);
+
+		TestEqual(TEXT("Superseded samples are counted"), Mailbox.GetNumSuperseded(), (uint64)2);
+		TestEqual(TEXT("Superseded samples are back in the pool"), (int32)NumOutstanding, 1);
+
+		FMailbox::FSamplePtr Held;
+		TestTrue(TEXT("The newest sample is fetched"), Mailbox.Fetch(Held) && (Held->Sequence == 4));
+		TestEqual(TEXT("The consumer's sample stays out of the pool"), (int32)NumOutstanding, 1);
+
+		Held.Reset();
+		TestEqual(TEXT("A released sample is back in the pool"), (int32)NumOutstanding, 0);
+
+		// the producer takes back a pending sample
+		Publish(Mailbox, Pool, 5);
+		Mailbox.Retract();
+
+		TestEqual(TEXT("A retracted sample is back in the pool"), (int32)NumOutstanding, 0);
+		TestFalse(TEXT("A retracted sample isn't fetched"), Mailbox.Fetch(Held));
+		TestFalse(TEXT("A retraction leaves no sample"), Held.IsValid());
+
+		Publish(Mailbox, Pool, 6);
+		TestEqual(TEXT("Samples published after a retraction are fetched"), Fetch(Mailbox), (int64)6);
+
+		// the consumer drops a pending sample
+		Publish(Mailbox, Pool, 7);
+		Mailbox.Flush();
+
+		TestEqual(TEXT("A flushed sample isn't fetched"), Fetch(Mailbox), (int64)0);
+		TestEqual(TEXT("A flushed sample is back in the pool"), (int32)NumOutstanding, 0);
+		TestTrue(TEXT("Samples are reused"), Pool.Num() <= 3);
+	}
+
+	return true;
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDirectShowMediaMailboxThreadsTest, "DirectShowMedia.Mailbox.Threads", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FDirectShowMediaMailboxThreadsTest::RunTest(const FString& Parameters)
+{
+	using namespace DirectShowMediaMailboxTest;
+
+	NumCreated = 0;
+	NumOutstanding = 0;
+
+	const int64 NumSamples = 200000;
+	const int64 RetractInterval = 997;
+
+	TMediaObjectPool<FSample> Pool;
+	FMailbox Mailbox;
+	std::atomic<bool> bProducing(true);
+
+	// a capture thread publishing as fast as it can, taking back a pending sample now and then like a format change does
+	TFuture<int32> Producer = Async(EAsyncExecution::Thread, [&Mailbox, &Pool, &bProducing, NumSamples, RetractInterval]()
+	{
+		int32 MaxOutstanding = 0;
+
+		for (int64 Sequence = 1; Sequence <= NumSamples; ++Sequence)
+		{
+			Publish(Mailbox, Pool, Sequence);
+			MaxOutstanding = FMath::Max(MaxOutstanding, NumOutstanding.load());
+
+			if ((Sequence % RetractInterval) == 0)
+			{
+				Mailbox.Retract();
+			}
+
+			// give the consumer a chance to fetch between bursts
+			if ((Sequence % 64) == 0)
+			{
+				FPlatformProcess::Sleep(0.0f);
+			}
+		}
+
+		bProducing = false;
+
+		return MaxOutstanding;
+	});
+
+	// a render thread holding on to each sample until it fetches the next
+	int64 LastSequence = 0;
+	int64 NumFetched = 0;
+	int32 NumOutOfOrder = 0;
+	int32 NumTorn = 0;
+	FMailbox::FSamplePtr Held;
+
+	while (true)
+	{
+		const bool bDone = !bProducing;
+		FMailbox::FSamplePtr Sample;
+
+		if (Mailbox.Fetch(Sample))
+		{
+			NumOutOfOrder += (Sample->Sequence <= LastSequence) ? 1 : 0;
+			NumTorn += Sample->IsIntact() ? 0 : 1;
+			LastSequence = Sample->Sequence;
+			++NumFetched;
+
+			Held = Sample;
+		}
+		else if (bDone)
+		{
+			break;
+		}
+		else
+		{
+			FPlatformProcess::Sleep(0.0f);
+		}
+	}
+
+	const int32 MaxOutstanding = Producer.Get();
+	const int64 NumRetracts = NumSamples / RetractInterval;
+	const int64 NumSuperseded = (int64)Mailbox.GetNumSuperseded();
+
+	AddInfo(FString::Printf(TEXT("%lld samples published, %lld fetched, %lld superseded, %d created"), NumSamples, NumFetched, NumSuperseded, NumCreated.load()));
+
+	TestEqual(TEXT("Samples are fetched newest first and never twice"), NumOutOfOrder, 0);
+	TestEqual(TEXT("Fetched samples are intact"), NumTorn, 0);
+	TestEqual(TEXT("The last sample is fetched"), LastSequence, NumSamples);
+
+	// every publication (retractions included) is either fetched or superseded, retractions fetch nothing
+	TestTrue(TEXT("Every sample is fetched or superseded"), (NumFetched + NumSuperseded >= NumSamples) && (NumFetched + NumSuperseded <= NumSamples + NumRetracts));
+
+	// the three slots, the consumer's sample and the one being filled
+	TestTrue(FString::Printf(TEXT("Superseded samples go back to the pool (%d out at most)"), MaxOutstanding), MaxOutstanding <= 4);
+	TestTrue(FString::Printf(TEXT("The pool stays small (%d samples)"), NumCreated.load()), NumCreated.load() <= 5);
+
+	Held.Reset();
+	TestEqual(TEXT("All samples are back in the pool"), NumOutstanding.load(), 0);
+
+	return true;
+}
+
+
+#endif //WITH_DEV_AUTOMATION_TESTS
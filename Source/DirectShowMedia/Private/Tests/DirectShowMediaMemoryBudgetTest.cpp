@@ -0,0 +1,297 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "CoreTypes.h"
+#include "Misc/AutomationTest.h"
+
+#include "Player/DirectShowMediaMemoryBudget.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+
+namespace DirectShowMediaMemoryBudgetTest
+{
+	/** A synthetic player: its account and the demand it last reported. */
+	struct FPlayer
+	{
+		FDirectShowMediaMemoryAccount Account;
+		FDirectShowMediaMemoryDemand Demand;
+		bool bOpen = false;
+	};
+
+	/** The demand of a capture at the given size, 4 bytes per pixel, with a half size format to reduce to. */
+	FDirectShowMediaMemoryDemand MakeDemand(int32 Width, int32 Height, bool bCanReduce = true)
+	{
+		FDirectShowMediaMemoryDemand Demand;
+		Demand.FrameBytes = (uint64)Width * Height * 4;
+		Demand.QueueDepth = 8;
+		Demand.MinQueueDepth = 2;
+		Demand.bCanUseMailbox = true;
+		Demand.ReducedFrameBytes = bCanReduce ? Demand.FrameBytes / 4 : 0;
+
+		return Demand;
+	}
+
+	/**
+	 * Check what the budget must guarantee, whatever the players did before.
+	 *
+	 * @param Test The test reporting failures.
+	 * @param Budget The budget.
+	 * @param Players The players, open or not.
+	 * @param Context Describes the step that was checked.
+	 */
+	void CheckInvariants(FAutomationTestBase& Test, const FDirectShowMediaMemoryBudget& Budget, const TArray<TUniquePtr<FPlayer>>& Players, const FString& Context)
+	{
+		uint64 Committed = 0;
+		uint64 Minimum = 0;
+		EDirectShowMediaMemoryLevel Deepest = EDirectShowMediaMemoryLevel::Full;
+
+		for (const TUniquePtr<FPlayer>& Player : Players)
+		{
+			if (!Player->bOpen)
+			{
+				continue;
+			}
+
+			const EDirectShowMediaMemoryLevel Level = Player->Account.GetLevel();
+
+			Committed += Player->Account.GetCommittedBytes();
+			Minimum += FDirectShowMediaMemoryBudget::GetFootprint(Player->Demand, EDirectShowMediaMemoryLevel::ReduceResolution);
+			Deepest = FMath::Max(Deepest, Level);
+
+			if (Player->Account.GetCommittedBytes() != FDirectShowMediaMemoryBudget::GetFootprint(Player->Demand, Level))
+			{
+				Test.AddError(FString::Printf(TEXT("%s: a player's committed bytes don't match its level"), *Context));
+			}
+		}
+
+		if (Committed != Budget.GetCommittedBytes())
+		{
+			Test.AddError(FString::Printf(TEXT("%s: the players' committed bytes don't add up to the total"), *Context));
+		}
+
+		if ((Budget.GetBudget() > 0) && (Minimum <= Budget.GetBudget()) && (Committed > Budget.GetBudget()))
+		{
+			Test.AddError(FString::Printf(TEXT("%s: %llu bytes committed over a budget of %llu"), *Context, Committed, Budget.GetBudget()));
+		}
+
+		if (Budget.GetPeakBytes() < Committed)
+		{
+			Test.AddError(FString::Printf(TEXT("%s: the peak is below the committed bytes"), *Context));
+		}
+
+		// the fixed order: nobody takes a step while a player that could take the previous one hasn't
+		for (const TUniquePtr<FPlayer>& Player : Players)
+		{
+			if (!Player->bOpen)
+			{
+				continue;
+			}
+
+			const EDirectShowMediaMemoryLevel Level = Player->Account.GetLevel();
+
+			for (EDirectShowMediaMemoryLevel Step : { EDirectShowMediaMemoryLevel::ShrinkQueue, EDirectShowMediaMemoryLevel::Mailbox })
+			{
+				const bool bStepApplies = FDirectShowMediaMemoryBudget::GetFootprint(Player->Demand, Step) < FDirectShowMediaMemoryBudget::GetFootprint(Player->Demand, (EDirectShowMediaMemoryLevel)((uint8)Step - 1));
+
+				if ((Deepest > Step) && bStepApplies && (Level < Step))
+				{
+					Test.AddError(FString::Printf(TEXT("%s: a player degraded past step %d while another didn't take it"), *Context, (int32)Step));
+				}
+			}
+		}
+	}
+
+	/** Count the open players at a level. */
+	int32 CountAtLevel(const TArray<TUniquePtr<FPlayer>>& Players, EDirectShowMediaMemoryLevel Level)
+	{
+		int32 Count = 0;
+
+		for (const TUniquePtr<FPlayer>& Player : Players)
+		{
+			Count += (Player->bOpen && (Player->Account.GetLevel() == Level)) ? 1 : 0;
+		}
+
+		return Count;
+	}
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDirectShowMediaMemoryBudgetOrderTest, "DirectShowMedia.MemoryBudget.Order", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FDirectShowMediaMemoryBudgetOrderTest::RunTest(const FString& Parameters)
+{
+	using namespace DirectShowMediaMemoryBudgetTest;
+
+	// eight 4K cameras on a render node, 332 MB each at full depth
+	FDirectShowMediaMemoryBudget Budget;
+	Budget.SetBudget(0);
+
+	TArray<TUniquePtr<FPlayer>> Players;
+
+	for (int32 Index = 0; Index < 8; ++Index)
+	{
+		FPlayer& Player = *Players.Add_GetRef(MakeUnique<FPlayer>());
+		Player.Demand = MakeDemand(3840, 2160);
+		Player.bOpen = true;
+
+		Budget.Open(Player.Account);
+		Budget.SetDemand(Player.Account, Player.Demand);
+	}
+
+	const uint64 FrameBytes = Players[0]->Demand.FrameBytes;
+	const uint64 FullBytes = 8 * FrameBytes * 10;
+
+	TestEqual(TEXT("Without a limit every player holds its full queue"), CountAtLevel(Players, EDirectShowMediaMemoryLevel::Full), 8);
+	TestEqual(TEXT("The committed bytes are reported"), Budget.GetCommittedBytes(), FullBytes);
+	CheckInvariants(*this, Budget, Players, TEXT("No limit"));
+
+	// tightening the budget walks the steps in order
+	struct FExpectation
+	{
+		uint64 BudgetBytes;
+		EDirectShowMediaMemoryLevel Deepest;
+	};
+
+	const FExpectation Expectations[] =
+	{
+		{ FullBytes, EDirectShowMediaMemoryLevel::Full },
+		{ 8 * FrameBytes * 6, EDirectShowMediaMemoryLevel::ShrinkQueue },
+		{ 8 * FrameBytes * 4, EDirectShowMediaMemoryLevel::ShrinkQueue },
+		{ 8 * FrameBytes * 3 + FrameBytes, EDirectShowMediaMemoryLevel::Mailbox },
+		{ 8 * FrameBytes * 3, EDirectShowMediaMemoryLevel::Mailbox },
+		{ 8 * FrameBytes * 2, EDirectShowMediaMemoryLevel::ReduceResolution },
+		{ 8 * FrameBytes * 3 / 4, EDirectShowMediaMemoryLevel::ReduceResolution },
+	};
+
+	for (const FExpectation& Expectation : Expectations)
+	{
+		Budget.SetBudget(Expectation.BudgetBytes);
+
+		const FString Context = FString::Printf(TEXT("Budget of %llu MB"), Expectation.BudgetBytes >> 20);
+		EDirectShowMediaMemoryLevel Deepest = EDirectShowMediaMemoryLevel::Full;
+
+		for (const TUniquePtr<FPlayer>& Player : Players)
+		{
+			Deepest = FMath::Max(Deepest, Player->Account.GetLevel());
+		}
+
+		TestEqual(FString::Printf(TEXT("%s degrades to step %d"), *Context, (int32)Expectation.Deepest), (int32)Deepest, (int32)Expectation.Deepest);
+		CheckInvariants(*this, Budget, Players, Context);
+	}
+
+	// players that can't reduce their resolution are skipped by that step
+	Players[0]->Demand = MakeDemand(3840, 2160, false);
+	Budget.SetDemand(Players[0]->Account, Players[0]->Demand);
+	TestTrue(TEXT("A player without a lower resolution stays in mailbox mode"), Players[0]->Account.GetLevel() == EDirectShowMediaMemoryLevel::Mailbox);
+	CheckInvariants(*this, Budget, Players, TEXT("No lower resolution"));
+
+	// closing players gives their memory back, the others recover in reverse order
+	for (int32 Index = 7; Index >= 2; --Index)
+	{
+		Budget.Close(Players[Index]->Account);
+		Players[Index]->bOpen = false;
+		CheckInvariants(*this, Budget, Players, FString::Printf(TEXT("Closed player %d"), Index));
+	}
+
+	Budget.SetBudget(FullBytes);
+	TestEqual(TEXT("The remaining players recover"), CountAtLevel(Players, EDirectShowMediaMemoryLevel::Full), 2);
+	TestEqual(TEXT("The peak is kept"), Budget.GetPeakBytes(), FullBytes);
+	TestEqual(TEXT("Closed accounts commit nothing"), Players[7]->Account.GetCommittedBytes(), (uint64)0);
+
+	Budget.Close(Players[0]->Account);
+	Budget.Close(Players[1]->Account);
+	TestEqual(TEXT("No accounts are left"), Budget.GetNumAccounts(), 0);
+	TestEqual(TEXT("Nothing is committed"), Budget.GetCommittedBytes(), (uint64)0);
+
+	return true;
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDirectShowMediaMemoryBudgetManyPlayersTest, "DirectShowMedia.MemoryBudget.ManyPlayers", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FDirectShowMediaMemoryBudgetManyPlayersTest::RunTest(const FString& Parameters)
+{
+	using namespace DirectShowMediaMemoryBudgetTest;
+
+	const FIntPoint Sizes[] = { FIntPoint(640, 480), FIntPoint(1280, 720), FIntPoint(1920, 1080), FIntPoint(3840, 2160) };
+
+	// 64 players opening, closing, changing formats and budgets at random
+	FDirectShowMediaMemoryBudget Budget;
+	Budget.SetBudget(1024ull << 20);
+
+	TArray<TUniquePtr<FPlayer>> Players;
+
+	for (int32 Index = 0; Index < 64; ++Index)
+	{
+		Players.Add(MakeUnique<FPlayer>());
+	}
+
+	uint32 Seed = 2024;
+	uint64 Peak = 0;
+	int32 NumDegraded = 0;
+
+	for (int32 Step = 0; Step < 5000; ++Step)
+	{
+		Seed = Seed * 1664525u + 1013904223u;
+		const uint32 Random = Seed >> 8;
+
+		FPlayer& Player = *Players[Random % Players.Num()];
+		const FIntPoint& Size = Sizes[(Random >> 8) % UE_ARRAY_COUNT(Sizes)];
+
+		switch ((Random >> 12) % 8)
+		{
+		case 0:
+			if (Player.bOpen)
+			{
+				Budget.Close(Player.Account);
+				Player.bOpen = false;
+			}
+			break;
+
+		case 1:
+			Budget.SetBudget((uint64)(256 + (Random >> 16) % 4096) << 20);
+			break;
+
+		default:
+			if (!Player.bOpen)
+			{
+				Budget.Open(Player.Account);
+				Player.Demand = FDirectShowMediaMemoryDemand();
+				Player.bOpen = true;
+			}
+
+			// some players hold no frames yet, some have no lower resolution
+			Player.Demand = ((Random >> 20) % 10 == 0) ? FDirectShowMediaMemoryDemand() : MakeDemand(Size.X, Size.Y, (Random >> 24) % 4 != 0);
+			Budget.SetDemand(Player.Account, Player.Demand);
+			break;
+		}
+
+		Peak = FMath::Max(Peak, Budget.GetCommittedBytes());
+		NumDegraded += (CountAtLevel(Players, EDirectShowMediaMemoryLevel::Full) < Budget.GetNumAccounts()) ? 1 : 0;
+
+		CheckInvariants(*this, Budget, Players, FString::Printf(TEXT("Step %d"), Step));
+
+		if (HasAnyErrors())
+		{
+			return false;
+		}
+	}
+
+	TestEqual(TEXT("The peak is the highest total committed"), Budget.GetPeakBytes(), Peak);
+	TestTrue(TEXT("The budget was exceeded at times"), NumDegraded > 0);
+
+	for (const TUniquePtr<FPlayer>& Player : Players)
+	{
+		if (Player->bOpen)
+		{
+			Budget.Close(Player->Account);
+		}
+	}
+
+	TestEqual(TEXT("Every player closed its account"), Budget.GetNumAccounts(), 0);
+
+	return true;
+}
+
+
+#endif //WITH_DEV_AUTOMATION_TESTS
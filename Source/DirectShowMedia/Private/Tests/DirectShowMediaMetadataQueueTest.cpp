@@ -0,0 +1,260 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "CoreTypes.h"
+#include "Misc/AutomationTest.h"
+
+#include "DirectShowMediaFrameMetadata.h"
+#include "Player/DirectShowMediaMetadataQueue.h"
+#include "Player/DirectShowMediaMetadataSample.h"
+
+#include "Windows/AllowWindowsPlatformTypes.h"
+#include <dshow.h>
+#include "Windows/HideWindowsPlatformTypes.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+
+namespace DirectShowMediaMetadataQueueTest
+{
+	/** Frame rate of the synthetic source. */
+	const int32 FrameRate = 60;
+
+	/** The synthetic source drops a frame after every this many frames. */
+	const int32 DropInterval = 50;
+
+	/** Get the presentation time of a frame of the synthetic source. */
+	FTimespan GetFrameTime(int32 Frame)
+	{
+		return FTimespan(ETimespan::TicksPerSecond * Frame / FrameRate);
+	}
+
+	/** Get the duration of the frames of the synthetic source. */
+	FTimespan GetFrameDuration()
+	{
+		return FTimespan(ETimespan::TicksPerSecond / FrameRate);
+	}
+
+	/**
+	 * Build the side data a capture device would report for a frame.
+	 *
+	 * @param Frame Index of the delivered frame.
+	 * @return The side data, with every field set.
+	 */
+	FDirectShowMediaFrameMetadata MakeMetadata(int32 Frame)
+	{
+		const int32 NumDropped = Frame / DropInterval;
+		const int32 FrameNumber = Frame + NumDropped;
+		const int32 Seconds = FrameNumber / 30;
+
+		FDirectShowMediaFrameMetadata Metadata;
+		Metadata.Flags = EDirectShowMediaFrameMetadataFlags::DeviceTime | EDirectShowMediaFrameMetadataFlags::MediaTime | EDirectShowMediaFrameMetadataFlags::Exposure | EDirectShowMediaFrameMetadataFlags::Gain | EDirectShowMediaFrameMetadataFlags::Timecode;
+		Metadata.FrameNumber = FrameNumber;
+		Metadata.DeviceStartTime = (int64)FrameNumber * 166667;
+		Metadata.DeviceStopTime = Metadata.DeviceStartTime + 166667;
+		Metadata.MediaStartTime = FrameNumber;
+		Metadata.MediaStopTime = FrameNumber + 1;
+		Metadata.Exposure = -5 - (FrameNumber / 120) % 3;
+		Metadata.Gain = (FrameNumber % 7) * 10;
+		Metadata.TimecodeFrames = (((Seconds / 60) % 10) << 16) | (((Seconds % 60) / 10) << 12) | ((Seconds % 10) << 8) | (((FrameNumber % 30) / 10) << 4) | (FrameNumber % 10);
+		Metadata.TimecodeFormat = ED_FORMAT_SMPTE_30;
+		Metadata.TimecodeFrameFraction = (uint16)(FrameNumber & 0xff);
+		Metadata.TimecodeUserBits = 0xabc00000 | FrameNumber;
+
+		if ((NumDropped > 0) && (Frame % DropInterval == 0))
+		{
+			Metadata.Flags |= EDirectShowMediaFrameMetadataFlags::Discontinuity;
+		}
+
+		return Metadata;
+	}
+
+	/** Read a field of a metadata sample's data at the offset consumers read it from. */
+	template<typename FieldType>
+	FieldType ReadField(const void* Data, SIZE_T Offset)
+	{
+		FieldType Value;
+		FMemory::Memcpy(&Value, (const uint8*)Data + Offset, sizeof(FieldType));
+
+		return Value;
+	}
+
+	/**
+	 * Count the fields of a metadata sample's data that differ from a frame's side data.
+	 *
+	 * @param Data The sample's data.
+	 * @param Expected The side data of the frame.
+	 * @return Number of mismatching fields.
+	 */
+	int32 CountMismatches(const void* Data, const FDirectShowMediaFrameMetadata& Expected)
+	{
+		// the published layout, field by field
+		const bool Matches[] =
+		{
+			ReadField<uint32>(Data, 0) == FDirectShowMediaFrameMetadata::CurrentVersion,
+			ReadField<uint32>(Data, 4) == (uint32)Expected.Flags,
+			ReadField<uint64>(Data, 8) == Expected.FrameNumber,
+			ReadField<int64>(Data, 16) == Expected.DeviceStartTime,
+			ReadField<int64>(Data, 24) == Expected.DeviceStopTime,
+			ReadField<int64>(Data, 32) == Expected.MediaStartTime,
+			ReadField<int64>(Data, 40) == Expected.MediaStopTime,
+			ReadField<int32>(Data, 48) == Expected.Exposure,
+			ReadField<int32>(Data, 52) == Expected.Gain,
+			ReadField<uint32>(Data, 56) == Expected.TimecodeFrames,
+			ReadField<uint16>(Data, 60) == Expected.TimecodeFormat,
+			ReadField<uint16>(Data, 62) == Expected.TimecodeFrameFraction,
+			ReadField<uint32>(Data, 64) == Expected.TimecodeUserBits,
+			ReadField<uint32>(Data, 68) == 0,
+		};
+
+		int32 NumMismatches = 0;
+
+		for (bool bMatches : Matches)
+		{
+			NumMismatches += bMatches ? 0 : 1;
+		}
+
+		return NumMismatches;
+	}
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDirectShowMediaMetadataQueueLayoutTest, "DirectShowMedia.MetadataQueue.Layout", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FDirectShowMediaMetadataQueueLayoutTest::RunTest(const FString& Parameters)
+{
+	using namespace DirectShowMediaMetadataQueueTest;
+
+	FDirectShowMediaMetadataQueue Queue(4);
+	const int32 Frame = 2 * DropInterval;
+	const FDirectShowMediaFrameMetadata Metadata = MakeMetadata(Frame);
+
+	TestTrue(TEXT("The side data is queued"), Queue.Add(Metadata, GetFrameTime(Frame), GetFrameDuration()));
+
+	TSharedPtr<IMediaBinarySample, ESPMode::ThreadSafe> Sample;
+
+	TestFalse(TEXT("Side data isn't fetched before its frame"), Queue.Fetch(TRange<FTimespan>(FTimespan::Zero(), GetFrameTime(Frame)), Sample));
+
+	if (!TestTrue(TEXT("Side data is fetched during its frame"), Queue.Fetch(TRange<FTimespan>(GetFrameTime(Frame), GetFrameTime(Frame + 1)), Sample)))
+	{
+		return false;
+	}
+
+	const void* Data = Sample->GetData();
+
+	TestEqual(TEXT("The sample time is the frame time"), Sample->GetTime().Time, GetFrameTime(Frame));
+	TestEqual(TEXT("The sample duration is the frame duration"), Sample->GetDuration(), GetFrameDuration());
+	TestEqual(TEXT("The sample holds one slab"), Sample->GetSize(), 72u);
+	TestEqual(TEXT("The slab is 8 byte aligned"), (int32)((UPTRINT)Data % 8), 0);
+	TestEqual(TEXT("Every field is at its published offset"), CountMismatches(Data, Metadata), 0);
+	TestTrue(TEXT("The frame is flagged as following a discontinuity"), (ReadField<uint32>(Data, 4) & (uint32)EDirectShowMediaFrameMetadataFlags::Discontinuity) != 0);
+
+	// the slab is held inline, no buffer of its own
+	const uint8* SampleBegin = (const uint8*)StaticCastSharedPtr<FDirectShowMediaMetadataSample>(Sample).Get();
+	TestTrue(TEXT("The slab is held in the sample"), ((const uint8*)Data >= SampleBegin) && ((const uint8*)Data + Sample->GetSize() <= SampleBegin + sizeof(FDirectShowMediaMetadataSample)));
+
+	// the fetched sample goes back to the pool, and a full queue refuses side data without touching it
+	Sample.Reset();
+	TestEqual(TEXT("A released sample is pooled"), Queue.GetNumPooled(), 1);
+
+	for (int32 Index = 0; Index < 4; ++Index)
+	{
+		Queue.Add(MakeMetadata(Index), GetFrameTime(Index), GetFrameDuration());
+	}
+
+	const int32 NumPooled = Queue.GetNumPooled();
+
+	TestFalse(TEXT("A full queue refuses side data"), Queue.Add(MakeMetadata(4), GetFrameTime(4), GetFrameDuration()));
+	TestEqual(TEXT("A full queue holds its depth"), Queue.Num(), 4);
+	TestEqual(TEXT("A full queue takes no sample from the pool"), Queue.GetNumPooled(), NumPooled);
+
+	return true;
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDirectShowMediaMetadataQueueSteadyStateTest, "DirectShowMedia.MetadataQueue.SteadyState", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FDirectShowMediaMetadataQueueSteadyStateTest::RunTest(const FString& Parameters)
+{
+	using namespace DirectShowMediaMetadataQueueTest;
+
+	// the consumer ticks at 30 Hz and keeps what it fetched for three ticks
+	const int32 FramesPerTick = FrameRate / 30;
+	const int32 NumHeldTicks = 3;
+	const int32 NumWarmUpFrames = 300;
+	const int32 NumFrames = 60 * FrameRate;
+
+	FDirectShowMediaMetadataQueue Queue(256);
+	TArray<TArray<TSharedPtr<IMediaBinarySample, ESPMode::ThreadSafe>>> Held;
+	Held.SetNum(NumHeldTicks);
+
+	TArray<const IMediaBinarySample*> WarmUpSamples;
+	int32 NumNewSamples = 0;
+	int32 NumMismatches = 0;
+	int32 NumFetched = 0;
+	int32 NumDiscontinuities = 0;
+	int32 NextFrame = 0;
+
+	for (int32 Frame = 0; Frame < NumFrames; ++Frame)
+	{
+		Queue.Add(MakeMetadata(Frame), GetFrameTime(Frame), GetFrameDuration());
+
+		if ((Frame + 1) % FramesPerTick != 0)
+		{
+			continue;
+		}
+
+		// a tick releases its oldest samples and fetches everything up to now
+		const int32 Tick = Frame / FramesPerTick;
+		TArray<TSharedPtr<IMediaBinarySample, ESPMode::ThreadSafe>>& TickSamples = Held[Tick % NumHeldTicks];
+		TickSamples.Reset();
+
+		// after warm-up, every sample there is was seen during warm-up and is pooled, queued or held
+		if (Frame >= NumWarmUpFrames)
+		{
+			int32 NumSamples = Queue.GetNumPooled() + Queue.Num();
+
+			for (const TArray<TSharedPtr<IMediaBinarySample, ESPMode::ThreadSafe>>& HeldSamples : Held)
+			{
+				NumSamples += HeldSamples.Num();
+			}
+
+			NumNewSamples += (NumSamples != WarmUpSamples.Num()) ? 1 : 0;
+		}
+
+		TSharedPtr<IMediaBinarySample, ESPMode::ThreadSafe> Sample;
+
+		while (Queue.Fetch(TRange<FTimespan>(FTimespan::Zero(), GetFrameTime(Frame + 1)), Sample))
+		{
+			if (Frame < NumWarmUpFrames)
+			{
+				WarmUpSamples.AddUnique(Sample.Get());
+			}
+			else if (!WarmUpSamples.Contains(Sample.Get()))
+			{
+				++NumNewSamples;
+			}
+
+			if ((Sample->GetSize() != sizeof(FDirectShowMediaFrameMetadata)) || (CountMismatches(Sample->GetData(), MakeMetadata(NextFrame)) != 0))
+			{
+				++NumMismatches;
+			}
+
+			NumDiscontinuities += (ReadField<uint32>(Sample->GetData(), 4) & (uint32)EDirectShowMediaFrameMetadataFlags::Discontinuity) ? 1 : 0;
+
+			TickSamples.Add(Sample);
+			++NextFrame;
+			++NumFetched;
+		}
+	}
+
+	TestEqual(TEXT("Every frame's side data is fetched"), NumFetched, NumFrames);
+	TestEqual(TEXT("Every slab holds its frame's side data"), NumMismatches, 0);
+	TestEqual(TEXT("Every dropped frame is flagged"), NumDiscontinuities, (NumFrames - 1) / DropInterval);
+	TestEqual(FString::Printf(TEXT("No sample is created after warm-up (%d warm-up samples)"), WarmUpSamples.Num()), NumNewSamples, 0);
+	TestTrue(FString::Printf(TEXT("The pool holds what the consumer keeps in flight (%d samples)"), WarmUpSamples.Num()), WarmUpSamples.Num() <= (NumHeldTicks + 1) * FramesPerTick);
+
+	return true;
+}
+
+
+#endif //WITH_DEV_AUTOMATION_TESTS
@@ -0,0 +1,359 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "CoreTypes.h"
+#include "Misc/AutomationTest.h"
+
+#include "DirectShowMediaCommon.h"
+#include "Player/DirectShowMediaColorConverter.h"
+#include "Player/DirectShowMediaPlanarFrame.h"
+#include "Player/DirectShowMediaTextureSample.h"
+#include "Player/DirectShowMediaVideoLayout.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+
+namespace DirectShowMediaPlanarFrameTest
+{
+	/** Value of padding bytes, which must never reach a sample. */
+	const uint8 Padding = 0xee;
+
+	/** Value of a component at a position, never the padding value. */
+	uint8 GetComponent(int32 Component, int32 X, int32 Y)
+	{
+		return (uint8)((Component * 64 + Y * 11 + X) & 0x7f);
+	}
+
+	/**
+	 * Build a padded 4:2:0 frame in a capture filter's layout.
+	 *
+	 * @param Format The frame's layout.
+	 * @param Dim The frame's width and height (in pixels).
+	 * @param Pitch Number of bytes per luma row.
+	 * @return The frame, with every padding byte set to Padding.
+	 */
+	TArray<uint8> MakeFrame(EDirectShowMediaPlanarFormat Format, const FIntPoint& Dim, int32 Pitch)
+	{
+		const FIntPoint ChromaDim((Dim.X + 1) / 2, (Dim.Y + 1) / 2);
+		const bool bSemiPlanar = (Format == EDirectShowMediaPlanarFormat::NV12) || (Format == EDirectShowMediaPlanarFormat::NV21);
+		const int32 ChromaPitch = bSemiPlanar ? FMath::Max(Pitch, ChromaDim.X * 2) : (Pitch + 1) / 2;
+		const int32 ChromaSize = ChromaPitch * ChromaDim.Y;
+
+		TArray<uint8> Frame;
+		Frame.Init(Padding, Pitch * Dim.Y + (bSemiPlanar ? ChromaSize : ChromaSize * 2));
+
+		for (int32 Y = 0; Y < Dim.Y; ++Y)
+		{
+			for (int32 X = 0; X < Dim.X; ++X)
+			{
+				Frame[Y * Pitch + X] = GetComponent(0, X, Y);
+			}
+		}
+
+		uint8* Chroma = Frame.GetData() + Pitch * Dim.Y;
+
+		for (int32 Y = 0; Y < ChromaDim.Y; ++Y)
+		{
+			for (int32 X = 0; X < ChromaDim.X; ++X)
+			{
+				const uint8 U = GetComponent(1, X, Y);
+				const uint8 V = GetComponent(2, X, Y);
+
+				switch (Format)
+				{
+				case EDirectShowMediaPlanarFormat::I420:
+					Chroma[Y * ChromaPitch + X] = U;
+					Chroma[ChromaSize + Y * ChromaPitch + X] = V;
+					break;
+
+				case EDirectShowMediaPlanarFormat::YV12:
+					Chroma[Y * ChromaPitch + X] = V;
+					Chroma[ChromaSize + Y * ChromaPitch + X] = U;
+					break;
+
+				case EDirectShowMediaPlanarFormat::NV12:
+					Chroma[Y * ChromaPitch + X * 2 + 0] = U;
+					Chroma[Y * ChromaPitch + X * 2 + 1] = V;
+					break;
+
+				case EDirectShowMediaPlanarFormat::NV21:
+					Chroma[Y * ChromaPitch + X * 2 + 0] = V;
+					Chroma[Y * ChromaPitch + X * 2 + 1] = U;
+					break;
+
+				default:
+					break;
+				}
+			}
+		}
+
+		return Frame;
+	}
+
+	/** A captured sample, as the sample grabber hands it to the callback. */
+	class FFakeMediaSample
+		: public IMediaSample
+	{
+	public:
+
+		explicit FFakeMediaSample(const TArray<uint8>& InFrame)
+			: Frame(InFrame)
+			, NumRefs(1)
+		{ }
+
+		virtual ~FFakeMediaSample() { }
+
+	public:
+
+		virtual HRESULT STDMETHODCALLTYPE QueryInterface(REFIID, void** Object) override { *Object = nullptr; return E_NOINTERFACE; }
+		virtual ULONG STDMETHODCALLTYPE AddRef() override { return ++NumRefs; }
+		virtual ULONG STDMETHODCALLTYPE Release() override { return --NumRefs; }
+
+		virtual HRESULT STDMETHODCALLTYPE GetPointer(BYTE** Buffer) override { *Buffer = Frame.GetData(); return S_OK; }
+		virtual long STDMETHODCALLTYPE GetSize() override { return Frame.Num(); }
+		virtual HRESULT STDMETHODCALLTYPE GetTime(REFERENCE_TIME*, REFERENCE_TIME*) override { return E_NOTIMPL; }
+		virtual HRESULT STDMETHODCALLTYPE SetTime(REFERENCE_TIME*, REFERENCE_TIME*) override { return E_NOTIMPL; }
+		virtual HRESULT STDMETHODCALLTYPE IsSyncPoint() override { return S_OK; }
+		virtual HRESULT STDMETHODCALLTYPE SetSyncPoint(BOOL) override { return E_NOTIMPL; }
+		virtual HRESULT STDMETHODCALLTYPE IsPreroll() override { return S_FALSE; }
+		virtual HRESULT STDMETHODCALLTYPE SetPreroll(BOOL) override { return E_NOTIMPL; }
+		virtual long STDMETHODCALLTYPE GetActualDataLength() override { return Frame.Num(); }
+		virtual HRESULT STDMETHODCALLTYPE SetActualDataLength(long) override { return E_NOTIMPL; }
+		virtual HRESULT STDMETHODCALLTYPE GetMediaType(AM_MEDIA_TYPE** MediaType) override { *MediaType = nullptr; return S_FALSE; }
+		virtual HRESULT STDMETHODCALLTYPE SetMediaType(AM_MEDIA_TYPE*) override { return E_NOTIMPL; }
+		virtual HRESULT STDMETHODCALLTYPE IsDiscontinuity() override { return S_FALSE; }
+		virtual HRESULT STDMETHODCALLTYPE SetDiscontinuity(BOOL) override { return E_NOTIMPL; }
+		virtual HRESULT STDMETHODCALLTYPE GetMediaTime(LONGLONG*, LONGLONG*) override { return E_NOTIMPL; }
+		virtual HRESULT STDMETHODCALLTYPE SetMediaTime(LONGLONG*, LONGLONG*) override { return E_NOTIMPL; }
+
+	public:
+
+		/** The captured frame. */
+		TArray<uint8> Frame;
+
+		/** Number of references, one held by the test. */
+		ULONG NumRefs;
+	};
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDirectShowMediaPlanarFramePlanesTest, "DirectShowMedia.PlanarFrame.Planes", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FDirectShowMediaPlanarFramePlanesTest::RunTest(const FString& Parameters)
+{
+	struct FCase
+	{
+		EDirectShowMediaPlanarFormat Format;
+		FIntPoint Dim;
+		uint32 Pitch;
+		int32 NumPlanes;
+		uint32 Offsets[3];
+		uint32 Pitches[3];
+	};
+
+	// chroma planes are half the size rounded up, three plane layouts have half the luma pitch (rounded up)
+	const FCase Cases[] =
+	{
+		{ EDirectShowMediaPlanarFormat::I420, FIntPoint(8, 4), 0, 3, { 0, 32, 40 }, { 8, 4, 4 } },
+		{ EDirectShowMediaPlanarFormat::I420, FIntPoint(7, 5), 0, 3, { 0, 35, 47 }, { 7, 4, 4 } },
+		{ EDirectShowMediaPlanarFormat::I420, FIntPoint(7, 5), 10, 3, { 0, 50, 65 }, { 10, 5, 5 } },
+		{ EDirectShowMediaPlanarFormat::YV12, FIntPoint(7, 5), 0, 3, { 0, 47, 35 }, { 7, 4, 4 } },
+		{ EDirectShowMediaPlanarFormat::YV12, FIntPoint(7, 5), 10, 3, { 0, 65, 50 }, { 10, 5, 5 } },
+		{ EDirectShowMediaPlanarFormat::NV21, FIntPoint(8, 4), 0, 2, { 0, 32, 0 }, { 8, 8, 0 } },
+		{ EDirectShowMediaPlanarFormat::NV21, FIntPoint(7, 5), 0, 2, { 0, 35, 0 }, { 7, 8, 0 } },
+		{ EDirectShowMediaPlanarFormat::NV21, FIntPoint(7, 5), 12, 2, { 0, 60, 0 }, { 12, 12, 0 } },
+	};
+
+	for (const FCase& Case : Cases)
+	{
+		const FString Name = FString::Printf(TEXT("%s %dx%d pitch %u"), (Case.Format == EDirectShowMediaPlanarFormat::I420) ? TEXT("I420") : (Case.Format == EDirectShowMediaPlanarFormat::YV12) ? TEXT("YV12") : TEXT("NV21"), Case.Dim.X, Case.Dim.Y, Case.Pitch);
+		const TArray<uint8> Frame = DirectShowMediaPlanarFrameTest::MakeFrame(Case.Format, Case.Dim, (Case.Pitch != 0) ? Case.Pitch : Case.Dim.X);
+
+		FDirectShowMediaPlane Planes[IDirectShowMediaPlanarSample::MaxPlanes];
+		int32 NumPlanes = 0;
+
+		if (!TestTrue(Name + TEXT(": planes found"), FDirectShowMediaPlanarFrame::GetPlanes(Case.Format, Frame.GetData(), Frame.Num(), Case.Dim, Case.Pitch, Planes, NumPlanes)))
+		{
+			continue;
+		}
+
+		TestEqual(Name + TEXT(": number of planes"), NumPlanes, Case.NumPlanes);
+
+		for (int32 PlaneIndex = 0; PlaneIndex < Case.NumPlanes; ++PlaneIndex)
+		{
+			const FIntPoint ExpectedDim = (PlaneIndex == 0) ? Case.Dim : FIntPoint((Case.Dim.X + 1) / 2, (Case.Dim.Y + 1) / 2);
+
+			TestEqual(FString::Printf(TEXT("%s: offset of plane %d"), *Name, PlaneIndex), Planes[PlaneIndex].Offset, Case.Offsets[PlaneIndex]);
+			TestEqual(FString::Printf(TEXT("%s: pitch of plane %d"), *Name, PlaneIndex), Planes[PlaneIndex].Pitch, Case.Pitches[PlaneIndex]);
+			TestTrue(FString::Printf(TEXT("%s: data of plane %d"), *Name, PlaneIndex), Planes[PlaneIndex].Data == Frame.GetData() + Case.Offsets[PlaneIndex]);
+			TestTrue(FString::Printf(TEXT("%s: size of plane %d"), *Name, PlaneIndex), Planes[PlaneIndex].Dim == ExpectedDim);
+		}
+
+		// the U plane comes first, whichever order the frame stores them in
+		if (Case.Format != EDirectShowMediaPlanarFormat::NV21)
+		{
+			TestEqual(Name + TEXT(": first U sample"), Planes[1].Data[0], DirectShowMediaPlanarFrameTest::GetComponent(1, 0, 0));
+			TestEqual(Name + TEXT(": first V sample"), Planes[2].Data[0], DirectShowMediaPlanarFrameTest::GetComponent(2, 0, 0));
+		}
+
+		TestFalse(Name + TEXT(": truncated frames are refused"), FDirectShowMediaPlanarFrame::GetPlanes(Case.Format, Frame.GetData(), Frame.Num() - 1, Case.Dim, Case.Pitch, Planes, NumPlanes));
+	}
+
+	FDirectShowMediaPlane Planes[IDirectShowMediaPlanarSample::MaxPlanes];
+	int32 NumPlanes = 0;
+	uint8 Frame[64] = { };
+
+	TestFalse(TEXT("Pitches below the width are refused"), FDirectShowMediaPlanarFrame::GetPlanes(EDirectShowMediaPlanarFormat::I420, Frame, sizeof(Frame), FIntPoint(8, 4), 6, Planes, NumPlanes));
+	TestFalse(TEXT("Packed formats are refused"), FDirectShowMediaPlanarFrame::GetPlanes(EDirectShowMediaPlanarFormat::None, Frame, sizeof(Frame), FIntPoint(8, 4), 0, Planes, NumPlanes));
+
+	return true;
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDirectShowMediaPlanarFrameCopyTest, "DirectShowMedia.PlanarFrame.Copy", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FDirectShowMediaPlanarFrameCopyTest::RunTest(const FString& Parameters)
+{
+	using namespace DirectShowMediaPlanarFrameTest;
+
+	const EDirectShowMediaPlanarFormat Formats[] = { EDirectShowMediaPlanarFormat::I420, EDirectShowMediaPlanarFormat::YV12, EDirectShowMediaPlanarFormat::NV21 };
+	const FIntPoint Dims[] = { FIntPoint(8, 4), FIntPoint(7, 5), FIntPoint(1, 1) };
+
+	for (EDirectShowMediaPlanarFormat Format : Formats)
+	{
+		for (const FIntPoint& Dim : Dims)
+		{
+			const int32 Pitch = Dim.X + 3;
+			const FString Name = FString::Printf(TEXT("%s %dx%d"), (Format == EDirectShowMediaPlanarFormat::I420) ? TEXT("I420") : (Format == EDirectShowMediaPlanarFormat::YV12) ? TEXT("YV12") : TEXT("NV21"), Dim.X, Dim.Y);
+			const TArray<uint8> Frame = MakeFrame(Format, Dim, Pitch);
+
+			FDirectShowMediaPlane Planes[IDirectShowMediaPlanarSample::MaxPlanes];
+			int32 NumPlanes = 0;
+
+			if (!TestTrue(Name + TEXT(": planes found"), FDirectShowMediaPlanarFrame::GetPlanes(Format, Frame.GetData(), Frame.Num(), Dim, Pitch, Planes, NumPlanes)))
+			{
+				continue;
+			}
+
+			FIntPoint OutDim;
+			uint32 OutStride = 0;
+			const uint32 OutSize = FDirectShowMediaPlanarFrame::GetSemiPlanarLayout(Dim, OutDim, OutStride);
+			const FIntPoint ChromaDim((Dim.X + 1) / 2, (Dim.Y + 1) / 2);
+
+			TestEqual(Name + TEXT(": the stride is the width rounded up to even"), OutStride, (uint32)((Dim.X + 1) & ~1));
+			TestEqual(Name + TEXT(": the buffer holds the luma and chroma rows"), OutDim.Y, Dim.Y + ChromaDim.Y);
+
+			TArray<uint8> Out;
+			Out.Init(0, OutSize);
+			FDirectShowMediaPlanarFrame::CopyToSemiPlanar(Format, Planes, Dim, Out.GetData());
+
+			// NV21 stays NV21, the three plane layouts become NV12
+			const bool bVFirst = (FDirectShowMediaPlanarFrame::GetSemiPlanarFormat(Format) == EDirectShowMediaPlanarFormat::NV21);
+			int32 NumMismatches = 0;
+
+			for (int32 Y = 0; Y < Dim.Y; ++Y)
+			{
+				for (int32 X = 0; X < Dim.X; ++X)
+				{
+					NumMismatches += (Out[Y * OutStride + X] != GetComponent(0, X, Y)) ? 1 : 0;
+				}
+			}
+
+			for (int32 Y = 0; Y < ChromaDim.Y; ++Y)
+			{
+				for (int32 X = 0; X < ChromaDim.X; ++X)
+				{
+					const uint8* Pair = Out.GetData() + OutStride * (Dim.Y + Y) + X * 2;
+
+					NumMismatches += (Pair[0] != GetComponent(bVFirst ? 2 : 1, X, Y)) ? 1 : 0;
+					NumMismatches += (Pair[1] != GetComponent(bVFirst ? 1 : 2, X, Y)) ? 1 : 0;
+				}
+			}
+
+			TestEqual(Name + TEXT(": every component is copied to its place"), NumMismatches, 0);
+			TestFalse(Name + TEXT(": no padding is copied"), Out.Contains(Padding));
+		}
+	}
+
+	return true;
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDirectShowMediaPlanarFrameViewBudgetTest, "DirectShowMedia.PlanarFrame.ViewBudget", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FDirectShowMediaPlanarFrameViewBudgetTest::RunTest(const FString& Parameters)
+{
+	using namespace DirectShowMediaPlanarFrameTest;
+
+	const FIntPoint Dim(8, 4);
+	const int32 NumCaptureBuffers = 4;
+
+	FDirectShowMediaColorConverter Converter;
+	FDirectShowMediaVideoLayout Layout;
+
+	if (!TestTrue(TEXT("The I420 layout is resolved"), Layout.Resolve(DSMEDIASUBTYPE_I420, Dim, Dim.X, 30.0f, Converter, true, false, false, false, 1)))
+	{
+		return false;
+	}
+
+	Layout.SetCaptureBuffers(NumCaptureBuffers);
+	TestEqual(TEXT("Views may hold all capture buffers but one"), Layout.GetMaxPlanarViews(), NumCaptureBuffers - 1);
+
+	// the device's allocator hands out its buffers in turn, the consumer holds on to every sample
+	TArray<TUniquePtr<FFakeMediaSample>> CaptureBuffers;
+	TArray<TUniquePtr<FDirectShowMediaTextureSample>> Samples;
+
+	for (int32 FrameIndex = 0; FrameIndex < NumCaptureBuffers; ++FrameIndex)
+	{
+		CaptureBuffers.Add(MakeUnique<FFakeMediaSample>(MakeFrame(EDirectShowMediaPlanarFormat::I420, Dim, Dim.X)));
+		Samples.Add(MakeUnique<FDirectShowMediaTextureSample>());
+
+		FFakeMediaSample& CaptureBuffer = *CaptureBuffers.Last();
+		FDirectShowMediaTextureSample& Sample = *Samples.Last();
+
+		if (!TestTrue(FString::Printf(TEXT("Frame %d is initialized"), FrameIndex), Layout.InitializeSample(Sample, &CaptureBuffer, CaptureBuffer.Frame.GetData(), CaptureBuffer.Frame.Num(), FTimespan::Zero(), FTimespan::Zero())))
+		{
+			return false;
+		}
+
+		const bool bView = (FrameIndex < NumCaptureBuffers - 1);
+
+		TestEqual(FString::Printf(TEXT("Frame %d keeps its layout only if viewed"), FrameIndex), Sample.GetPlanarFormat(), bView ? EDirectShowMediaPlanarFormat::I420 : EDirectShowMediaPlanarFormat::NV12);
+		TestEqual(FString::Printf(TEXT("Frame %d holds its capture buffer only if viewed"), FrameIndex), CaptureBuffer.NumRefs, bView ? (ULONG)2 : (ULONG)1);
+		TestTrue(FString::Printf(TEXT("Frame %d views the capture buffer only if viewed"), FrameIndex), (Sample.GetPlane(0).Data == CaptureBuffer.Frame.GetData()) == bView);
+	}
+
+	// a released view hands its buffer back, the next frame is viewed again
+	Samples[0]->ShutdownPoolable();
+	TestEqual(TEXT("The released view dropped its capture buffer"), CaptureBuffers[0]->NumRefs, (ULONG)1);
+
+	FFakeMediaSample CaptureBuffer(MakeFrame(EDirectShowMediaPlanarFormat::I420, Dim, Dim.X));
+	FDirectShowMediaTextureSample Sample;
+
+	TestTrue(TEXT("The next frame is initialized"), Layout.InitializeSample(Sample, &CaptureBuffer, CaptureBuffer.Frame.GetData(), CaptureBuffer.Frame.Num(), FTimespan::Zero(), FTimespan::Zero()));
+	TestEqual(TEXT("The next frame is viewed"), Sample.GetPlanarFormat(), EDirectShowMediaPlanarFormat::I420);
+
+	for (TUniquePtr<FDirectShowMediaTextureSample>& Viewed : Samples)
+	{
+		Viewed->ShutdownPoolable();
+	}
+
+	Sample.ShutdownPoolable();
+
+	// without knowing the allocator, or with a single buffer, every frame is copied
+	const int32 NoViewBuffers[] = { 0, 1 };
+
+	for (int32 NumBuffers : NoViewBuffers)
+	{
+		Layout.SetCaptureBuffers(NumBuffers);
+
+		FDirectShowMediaTextureSample Copied;
+		TestTrue(FString::Printf(TEXT("A frame is initialized with %d capture buffers"), NumBuffers), Layout.InitializeSample(Copied, &CaptureBuffer, CaptureBuffer.Frame.GetData(), CaptureBuffer.Frame.Num(), FTimespan::Zero(), FTimespan::Zero()));
+		TestEqual(FString::Printf(TEXT("The frame is copied with %d capture buffers"), NumBuffers), Copied.GetPlanarFormat(), EDirectShowMediaPlanarFormat::NV12);
+		TestEqual(FString::Printf(TEXT("The capture buffer isn't held with %d capture buffers"), NumBuffers), CaptureBuffer.NumRefs, (ULONG)1);
+	}
+
+	return true;
+}
+
+
+#endif //WITH_DEV_AUTOMATION_TESTS
@@ -0,0 +1,167 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "CoreTypes.h"
+#include "Misc/AutomationTest.h"
+
+#include "Player/DirectShowMediaSampleWindow.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+
+namespace DirectShowMediaSampleWindowTest
+{
+	/** A sample with just the presentation time and duration the window looks at. */
+	class FTimedSample
+	{
+	public:
+
+		FTimedSample(FTimespan InTime, FTimespan InDuration)
+			: Time(InTime)
+			, Duration(InDuration)
+		{ }
+
+		FMediaTimeStamp GetTime() const
+		{
+			return FMediaTimeStamp(Time);
+		}
+
+		FTimespan GetDuration() const
+		{
+			return Duration;
+		}
+
+	private:
+
+		FTimespan Time;
+		FTimespan Duration;
+	};
+
+	typedef TDirectShowMediaSampleWindow<FTimedSample> FWindow;
+
+	/** Add a sample, keeping a weak reference to see when the window releases it. */
+	void Add(FWindow& Window, FTimespan Time, FTimespan Duration, TArray<TWeakPtr<FTimedSample, ESPMode::ThreadSafe>>& OutAdded)
+	{
+		const TSharedPtr<FTimedSample, ESPMode::ThreadSafe> Sample = MakeShared<FTimedSample, ESPMode::ThreadSafe>(Time, Duration);
+		OutAdded.Add(Sample);
+		Window.Add(Sample);
+	}
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDirectShowMediaSampleWindowHitchTest, "DirectShowMedia.SampleWindow.Hitches", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FDirectShowMediaSampleWindowHitchTest::RunTest(const FString& Parameters)
+{
+	using namespace DirectShowMediaSampleWindowTest;
+
+	const FTimespan FrameDuration(ETimespan::TicksPerSecond / 60);
+
+	FWindow Window(8);
+	TArray<TWeakPtr<FTimedSample, ESPMode::ThreadSafe>> Added;
+
+	// game ticks at 60 fps with the producer a frame ahead, stalling for 100 ms at tick 100 and 300 ms at tick 200
+	int64 NextFrame = 0;
+	int32 NumFetched = 0;
+	int32 NumMissed = 0;
+	uint64 PreviousStale = 0;
+	FTimespan Clock = FTimespan::Zero();
+
+	for (int32 Tick = 0; Tick < 300; ++Tick)
+	{
+		const FTimespan Hitch = (Tick == 100) ? FTimespan::FromMilliseconds(100.0) : (Tick == 200) ? FTimespan::FromMilliseconds(300.0) : FTimespan::Zero();
+		Clock += FrameDuration + Hitch;
+
+		while (NextFrame * FrameDuration.GetTicks() <= (Clock + FrameDuration).GetTicks())
+		{
+			Add(Window, FTimespan(NextFrame * FrameDuration.GetTicks()), FrameDuration, Added);
+			++NextFrame;
+		}
+
+		TSharedPtr<FTimedSample, ESPMode::ThreadSafe> Sample;
+
+		if (!Window.FetchBest(TRange<FTimespan>(Clock, Clock + FrameDuration), Sample))
+		{
+			++NumMissed;
+			continue;
+		}
+
+		++NumFetched;
+
+		// the consumer gets the newest frame of the tick, never a stale head
+		const FTimespan SampleTime = Sample->GetTime().Time;
+		TestTrue(FString::Printf(TEXT("Tick %d gets a frame of the tick"), Tick), (SampleTime + FrameDuration > Clock) && (SampleTime < Clock + FrameDuration));
+
+		if ((Tick == 100) || (Tick == 200))
+		{
+			TestTrue(FString::Printf(TEXT("The hitch at tick %d skipped frames"), Tick), Window.GetNumStale() > PreviousStale);
+		}
+
+		PreviousStale = Window.GetNumStale();
+	}
+
+	TestEqual(TEXT("Every tick after a hitch finds its frame"), NumMissed, 0);
+	TestEqual(TEXT("Every tick gets a frame"), NumFetched, 300);
+	TestTrue(TEXT("The 300 ms hitch overflowed the window"), Window.GetNumOverflowed() > 0);
+
+	// skipped samples go back to their pool, only the frames ahead of the clock are held
+	int32 NumHeld = 0;
+
+	for (const TWeakPtr<FTimedSample, ESPMode::ThreadSafe>& Sample : Added)
+	{
+		NumHeld += Sample.IsValid() ? 1 : 0;
+	}
+
+	TestEqual(TEXT("Skipped samples are released"), NumHeld, Window.Num());
+
+	return true;
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDirectShowMediaSampleWindowOrderTest, "DirectShowMedia.SampleWindow.Order", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FDirectShowMediaSampleWindowOrderTest::RunTest(const FString& Parameters)
+{
+	using namespace DirectShowMediaSampleWindowTest;
+
+	const FTimespan Duration(100);
+
+	FWindow Window(4);
+	TArray<TWeakPtr<FTimedSample, ESPMode::ThreadSafe>> Added;
+
+	// out of order samples are sorted
+	Add(Window, FTimespan(300), Duration, Added);
+	Add(Window, FTimespan(100), Duration, Added);
+	Add(Window, FTimespan(200), Duration, Added);
+
+	FTimespan OldestTime;
+	TestTrue(TEXT("The oldest sample can be peeked"), Window.PeekTime(OldestTime));
+	TestEqual(TEXT("Samples are sorted by time"), OldestTime, FTimespan(100));
+
+	// samples in the future stay
+	TSharedPtr<FTimedSample, ESPMode::ThreadSafe> Sample;
+	TestFalse(TEXT("Nothing is returned before the first sample"), Window.FetchBest(TRange<FTimespan>(FTimespan(0), FTimespan(50)), Sample));
+	TestEqual(TEXT("Future samples are kept"), Window.Num(), 3);
+
+	// a full window drops its oldest sample
+	Add(Window, FTimespan(400), Duration, Added);
+	Add(Window, FTimespan(500), Duration, Added);
+	TestEqual(TEXT("The window doesn't grow"), Window.Num(), 4);
+	TestEqual(TEXT("The overflow is counted"), Window.GetNumOverflowed(), (uint64)1);
+	TestFalse(TEXT("The oldest sample was released"), Added[1].IsValid());
+
+	// the best sample is the newest overlapping the range, the older ones are stale
+	TestTrue(TEXT("A sample overlaps the range"), Window.FetchBest(TRange<FTimespan>(FTimespan(350), FTimespan(450)), Sample));
+	TestEqual(TEXT("The newest overlapping sample is returned"), Sample->GetTime().Time, FTimespan(400));
+	TestEqual(TEXT("The older samples are counted as stale"), Window.GetNumStale(), (uint64)2);
+	TestEqual(TEXT("Only the newer sample is left"), Window.Num(), 1);
+
+	// a range past every sample drops them all
+	TestFalse(TEXT("Nothing overlaps a later range"), Window.FetchBest(TRange<FTimespan>(FTimespan(1000), FTimespan(1100)), Sample));
+	TestEqual(TEXT("Stale samples are dropped"), Window.Num(), 0);
+	TestEqual(TEXT("All of them are counted as stale"), Window.GetNumStale(), (uint64)3);
+
+	return true;
+}
+
+
+#endif //WITH_DEV_AUTOMATION_TESTS
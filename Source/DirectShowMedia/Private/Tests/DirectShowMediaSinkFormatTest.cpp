@@ -0,0 +1,123 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "CoreTypes.h"
+#include "Misc/AutomationTest.h"
+
+#include "DirectShowMediaCommon.h"
+#include "HAL/PlatformTime.h"
+#include "Player/DirectShowMediaColorConverter.h"
+#include "Player/DirectShowMediaTextureSample.h"
+#include "Player/DirectShowMediaVideoLayout.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+
+namespace DirectShowMediaSinkFormatTest
+{
+	/** A format compressed video can be decoded to (see the VideoSinkFormat media option). */
+	struct FSinkFormat
+	{
+		const TCHAR* Name;
+		const GUID* Subtype;
+		EMediaTextureSampleFormat Format;
+		uint64 FrameSize;
+	};
+
+	/** Build a decoded frame, different for every frame of the stream. */
+	TArray<uint8> MakeFrame(uint64 Size, int32 FrameIndex)
+	{
+		TArray<uint8> Frame;
+		Frame.SetNumUninitialized((int32)Size);
+
+		for (int32 Offset = 0; Offset < Frame.Num(); ++Offset)
+		{
+			Frame[Offset] = (uint8)(FrameIndex * 31 + Offset / 4096);
+		}
+
+		return Frame;
+	}
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDirectShowMediaSinkFormatBandwidthTest, "DirectShowMedia.SinkFormat.Bandwidth", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FDirectShowMediaSinkFormatBandwidthTest::RunTest(const FString& Parameters)
+{
+	using namespace DirectShowMediaSinkFormatTest;
+
+	// a 1080p MJPG or H264 stream, as the sample grabber hands it over for each negotiated decoder output
+	const FIntPoint Resolution(1920, 1080);
+	const uint64 NumPixels = (uint64)Resolution.X * Resolution.Y;
+	const int32 NumStreamFrames = 4;
+	const int32 NumFrames = 60;
+
+	const FSinkFormat SinkFormats[] =
+	{
+		{ TEXT("BGRA"), &MEDIASUBTYPE_ARGB32, EMediaTextureSampleFormat::CharBGRA, NumPixels * 4 },
+		{ TEXT("YUY2"), &MEDIASUBTYPE_YUY2, EMediaTextureSampleFormat::CharYUY2, NumPixels * 2 },
+		{ TEXT("NV12"), &MEDIASUBTYPE_NV12, EMediaTextureSampleFormat::CharNV12, NumPixels * 3 / 2 },
+	};
+
+	const FDirectShowMediaColorConverter Converter;
+	double FrameTimes[UE_ARRAY_COUNT(SinkFormats)] = { };
+
+	for (int32 FormatIndex = 0; FormatIndex < UE_ARRAY_COUNT(SinkFormats); ++FormatIndex)
+	{
+		const FSinkFormat& SinkFormat = SinkFormats[FormatIndex];
+		FDirectShowMediaVideoLayout Layout;
+
+		if (!TestTrue(FString::Printf(TEXT("%s frames are resolved"), SinkFormat.Name), Layout.Resolve(*SinkFormat.Subtype, Resolution, Resolution.X, 60.0f, Converter, false, false, false, false, 0)))
+		{
+			continue;
+		}
+
+		TestEqual(FString::Printf(TEXT("%s frames take their decoded size in the queue"), SinkFormat.Name), Layout.GetFrameSize(), SinkFormat.FrameSize);
+
+		TArray<TArray<uint8>> Stream;
+
+		for (int32 FrameIndex = 0; FrameIndex < NumStreamFrames; ++FrameIndex)
+		{
+			Stream.Add(MakeFrame(SinkFormat.FrameSize, FrameIndex));
+		}
+
+		// a queue of samples filled in turn, like the video sample pool
+		FDirectShowMediaTextureSample Samples[3];
+		int32 NumFailed = 0;
+
+		const double StartTime = FPlatformTime::Seconds();
+
+		for (int32 FrameIndex = 0; FrameIndex < NumFrames; ++FrameIndex)
+		{
+			const TArray<uint8>& Frame = Stream[FrameIndex % NumStreamFrames];
+
+			if (!Layout.InitializeSample(Samples[FrameIndex % UE_ARRAY_COUNT(Samples)], nullptr, Frame.GetData(), Frame.Num(), FTimespan::Zero(), Layout.GetFrameDuration()))
+			{
+				++NumFailed;
+			}
+		}
+
+		FrameTimes[FormatIndex] = (FPlatformTime::Seconds() - StartTime) / NumFrames;
+
+		// the last frame reaches its sample as decoded, without expansion
+		FDirectShowMediaTextureSample& Sample = Samples[(NumFrames - 1) % UE_ARRAY_COUNT(Samples)];
+		const TArray<uint8>& LastFrame = Stream[(NumFrames - 1) % NumStreamFrames];
+
+		TestEqual(FString::Printf(TEXT("%s frames are queued"), SinkFormat.Name), NumFailed, 0);
+		TestTrue(FString::Printf(TEXT("%s samples keep the decoded format"), SinkFormat.Name), Sample.GetFormat() == SinkFormat.Format);
+		TestEqual(FString::Printf(TEXT("%s samples have the frame size"), SinkFormat.Name), Sample.GetOutputDim(), Resolution);
+		TestTrue(FString::Printf(TEXT("%s samples hold the decoded frame"), SinkFormat.Name), (Sample.GetBuffer() != nullptr) && (FMemory::Memcmp(Sample.GetBuffer(), LastFrame.GetData(), LastFrame.Num()) == 0));
+
+		AddInfo(FString::Printf(TEXT("%s: %.1f MB per frame, %.2f ms per frame queued, %.0f MB/s at 60 fps"), SinkFormat.Name, SinkFormat.FrameSize / 1e6, FrameTimes[FormatIndex] * 1e3, SinkFormat.FrameSize * 60 / 1e6));
+	}
+
+	AddInfo(FString::Printf(TEXT("Decoding to NV12 instead of BGRA queues %.2fx less data, %.2fx faster"), (double)SinkFormats[0].FrameSize / SinkFormats[2].FrameSize, (FrameTimes[2] > 0.0) ? FrameTimes[0] / FrameTimes[2] : 0.0));
+
+	// generous bounds, so debug builds and loaded machines pass while a sink format that gets expanded doesn't
+	TestTrue(TEXT("YUY2 frames are queued faster than BGRA frames"), FrameTimes[1] < FrameTimes[0]);
+	TestTrue(TEXT("NV12 frames are queued faster than BGRA frames"), FrameTimes[2] < FrameTimes[0]);
+
+	return true;
+}
+
+
+#endif //WITH_DEV_AUTOMATION_TESTS
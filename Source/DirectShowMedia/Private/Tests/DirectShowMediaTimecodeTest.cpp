@@ -0,0 +1,323 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "CoreTypes.h"
+#include "Misc/AutomationTest.h"
+
+#include "DirectShowMediaFrameMetadata.h"
+#include "Player/DirectShowMediaTimecode.h"
+#include "Player/DirectShowMediaTimecodeIndex.h"
+
+#include "Windows/AllowWindowsPlatformTypes.h"
+#include <dshow.h>
+#include "Windows/HideWindowsPlatformTypes.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+
+namespace DirectShowMediaTimecodeTest
+{
+	/** Build the side data of a frame whose device reported a timecode. */
+	FDirectShowMediaFrameMetadata MakeMetadata(uint32 TimecodeFrames, uint16 TimecodeFormat)
+	{
+		FDirectShowMediaFrameMetadata Metadata;
+		Metadata.Flags = EDirectShowMediaFrameMetadataFlags::Timecode;
+		Metadata.TimecodeFrames = TimecodeFrames;
+		Metadata.TimecodeFormat = TimecodeFormat;
+
+		return Metadata;
+	}
+
+	/** The presentation time of the middle of a frame. */
+	FTimespan GetFrameTime(int64 FrameNumber, const FFrameRate& FrameRate)
+	{
+		return FTimespan::FromSeconds(((double)FrameNumber + 0.5) * FrameRate.AsInterval());
+	}
+
+	typedef TDirectShowMediaTimecodeIndex<int32> FIndex;
+
+	/** Index a sample for a frame number, the sample holding the frame number. */
+	void Add(FIndex& Index, int32 FrameNumber, const FFrameRate& FrameRate)
+	{
+		Index.Add(FTimecode::FromFrameNumber(FFrameNumber(FrameNumber), FrameRate, false), FrameRate, MakeShared<int32, ESPMode::ThreadSafe>(FrameNumber));
+	}
+
+	/** Fetch the sample of a frame number, returning the frame number it holds or INDEX_NONE. */
+	int32 Fetch(FIndex& Index, int32 FrameNumber, const FFrameRate& FrameRate)
+	{
+		FIndex::FSamplePtr Sample;
+		return Index.Fetch(FQualifiedFrameTime(FFrameTime(FFrameNumber(FrameNumber)), FrameRate), Sample) ? *Sample : INDEX_NONE;
+	}
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDirectShowMediaTimecodeFrameRateTest, "DirectShowMedia.Timecode.FrameRate", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FDirectShowMediaTimecodeFrameRateTest::RunTest(const FString& Parameters)
+{
+	struct FCase
+	{
+		float FrameRate;
+		FFrameRate Expected;
+	};
+
+	// frame rates as computed from AvgTimePerFrame
+	const FCase Cases[] =
+	{
+		{ 10000000.0f / 333667.0f, FFrameRate(30000, 1001) },
+		{ 10000000.0f / 166833.0f, FFrameRate(60000, 1001) },
+		{ 10000000.0f / 417083.0f, FFrameRate(24000, 1001) },
+		{ 30.0f, FFrameRate(30, 1) },
+		{ 25.0f, FFrameRate(25, 1) },
+		{ 10000000.0f / 166666.0f, FFrameRate(60, 1) },
+		{ 12.5f, FFrameRate(12500, 1000) },
+		{ 0.0f, FFrameRate(30, 1) },
+	};
+
+	for (const FCase& Case : Cases)
+	{
+		const FFrameRate FrameRate = FDirectShowMediaTimecode::GetFrameRate(Case.FrameRate);
+		TestTrue(FString::Printf(TEXT("%f fps is %d/%d (got %d/%d)"), Case.FrameRate, Case.Expected.Numerator, Case.Expected.Denominator, FrameRate.Numerator, FrameRate.Denominator), FrameRate == Case.Expected);
+	}
+
+	return true;
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDirectShowMediaTimecodeMetadataTest, "DirectShowMedia.Timecode.Metadata", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FDirectShowMediaTimecodeMetadataTest::RunTest(const FString& Parameters)
+{
+	using namespace DirectShowMediaTimecodeTest;
+
+	FTimecode Timecode;
+	FFrameRate FrameRate;
+
+	// valid codes
+	if (TestTrue(TEXT("A 30 fps timecode is decoded"), FDirectShowMediaTimecode::FromFrameMetadata(MakeMetadata(0x23594529, ED_FORMAT_SMPTE_30), Timecode, FrameRate)))
+	{
+		TestTrue(FString::Printf(TEXT("The 30 fps timecode is 23:59:45:29 (got %s)"), *Timecode.ToString()), Timecode == FTimecode(23, 59, 45, 29, false));
+		TestTrue(TEXT("The 30 fps timecode's rate is 30/1"), FrameRate == FFrameRate(30, 1));
+	}
+
+	if (TestTrue(TEXT("A 25 fps timecode is decoded"), FDirectShowMediaTimecode::FromFrameMetadata(MakeMetadata(0x01020324, ED_FORMAT_SMPTE_25), Timecode, FrameRate)))
+	{
+		TestTrue(FString::Printf(TEXT("The 25 fps timecode is 01:02:03:24 (got %s)"), *Timecode.ToString()), Timecode == FTimecode(1, 2, 3, 24, false));
+		TestTrue(TEXT("The 25 fps timecode's rate is 25/1"), FrameRate == FFrameRate(25, 1));
+	}
+
+	if (TestTrue(TEXT("A drop frame timecode is decoded"), FDirectShowMediaTimecode::FromFrameMetadata(MakeMetadata(0x00010002, ED_FORMAT_SMPTE_30DROP), Timecode, FrameRate)))
+	{
+		TestTrue(FString::Printf(TEXT("The drop frame timecode is 00:01:00;02 (got %s)"), *Timecode.ToString()), Timecode == FTimecode(0, 1, 0, 2, true));
+		TestTrue(TEXT("The drop frame timecode's rate is 30000/1001"), FrameRate == FFrameRate(30000, 1001));
+	}
+
+	// invalid codes
+	struct FCase
+	{
+		const TCHAR* Name;
+		uint32 TimecodeFrames;
+		uint16 TimecodeFormat;
+	};
+
+	const FCase Rejected[] =
+	{
+		{ TEXT("Frame digit above 9"), 0x0000000a, ED_FORMAT_SMPTE_30 },
+		{ TEXT("Frame tens above 9"), 0x000000a0, ED_FORMAT_SMPTE_30 },
+		{ TEXT("Second digit above 9"), 0x00000f00, ED_FORMAT_SMPTE_30 },
+		{ TEXT("Minute tens above 9"), 0x00b00000, ED_FORMAT_SMPTE_30 },
+		{ TEXT("Hour digit above 9"), 0x0c000000, ED_FORMAT_SMPTE_30 },
+		{ TEXT("Hour 24"), 0x24000000, ED_FORMAT_SMPTE_30 },
+		{ TEXT("Minute 60"), 0x00600000, ED_FORMAT_SMPTE_30 },
+		{ TEXT("Second 60"), 0x00006000, ED_FORMAT_SMPTE_30 },
+		{ TEXT("Frame 30 at 30 fps"), 0x00000030, ED_FORMAT_SMPTE_30 },
+		{ TEXT("Frame 25 at 25 fps"), 0x00000025, ED_FORMAT_SMPTE_25 },
+		{ TEXT("Frame 24 at 24 fps"), 0x00000024, ED_FORMAT_SMPTE_24 },
+		{ TEXT("Dropped frame 00:01:00;00"), 0x00010000, ED_FORMAT_SMPTE_30DROP },
+		{ TEXT("Dropped frame 00:01:00;01"), 0x00010001, ED_FORMAT_SMPTE_30DROP },
+		{ TEXT("Dropped frame 12:59:00;01"), 0x12590001, ED_FORMAT_SMPTE_30DROP },
+		{ TEXT("Unknown format"), 0x00000000, 0 },
+	};
+
+	for (const FCase& Case : Rejected)
+	{
+		TestFalse(FString::Printf(TEXT("%s is rejected"), Case.Name), FDirectShowMediaTimecode::FromFrameMetadata(MakeMetadata(Case.TimecodeFrames, Case.TimecodeFormat), Timecode, FrameRate));
+	}
+
+	// frames 0 and 1 exist in every tenth minute, and without drop frame
+	const FCase Accepted[] =
+	{
+		{ TEXT("00:00:00;00"), 0x00000000, ED_FORMAT_SMPTE_30DROP },
+		{ TEXT("00:10:00;00"), 0x00100000, ED_FORMAT_SMPTE_30DROP },
+		{ TEXT("00:50:00;01"), 0x00500001, ED_FORMAT_SMPTE_30DROP },
+		{ TEXT("00:01:01;00"), 0x00010100, ED_FORMAT_SMPTE_30DROP },
+		{ TEXT("00:01:00:00"), 0x00010000, ED_FORMAT_SMPTE_30 },
+	};
+
+	for (const FCase& Case : Accepted)
+	{
+		TestTrue(FString::Printf(TEXT("%s is accepted"), Case.Name), FDirectShowMediaTimecode::FromFrameMetadata(MakeMetadata(Case.TimecodeFrames, Case.TimecodeFormat), Timecode, FrameRate));
+	}
+
+	FDirectShowMediaFrameMetadata Metadata = MakeMetadata(0x00000000, ED_FORMAT_SMPTE_30);
+	Metadata.Flags = EDirectShowMediaFrameMetadataFlags::None;
+	TestFalse(TEXT("Side data without a timecode is rejected"), FDirectShowMediaTimecode::FromFrameMetadata(Metadata, Timecode, FrameRate));
+
+	return true;
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDirectShowMediaTimecodeDropFrameTest, "DirectShowMedia.Timecode.DropFrame", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FDirectShowMediaTimecodeDropFrameTest::RunTest(const FString& Parameters)
+{
+	using namespace DirectShowMediaTimecodeTest;
+
+	struct FCase
+	{
+		uint32 TimecodeFrames;
+		int32 FrameNumber;
+	};
+
+	// the last frame of a minute and the first of the next, frames 0 and 1 only exist in every tenth minute
+	const FCase Cases[] =
+	{
+		{ 0x00005929, 1799 },
+		{ 0x00010002, 1800 },
+		{ 0x00015929, 3597 },
+		{ 0x00020002, 3598 },
+		{ 0x00095929, 17981 },
+		{ 0x00100000, 17982 },
+		{ 0x00100100, 18012 },
+		{ 0x00105929, 19781 },
+		{ 0x00110002, 19782 },
+		{ 0x00595929, 107891 },
+		{ 0x01000000, 107892 },
+	};
+
+	const FFrameRate FrameRate(30000, 1001);
+
+	for (const FCase& Case : Cases)
+	{
+		FTimecode Timecode;
+		FFrameRate TimecodeRate;
+
+		if (!TestTrue(FString::Printf(TEXT("%08x is decoded"), Case.TimecodeFrames), FDirectShowMediaTimecode::FromFrameMetadata(MakeMetadata(Case.TimecodeFrames, ED_FORMAT_SMPTE_30DROP), Timecode, TimecodeRate)))
+		{
+			continue;
+		}
+
+		TestEqual(FString::Printf(TEXT("%s is frame %d"), *Timecode.ToString(), Case.FrameNumber), Timecode.ToFrameNumber(TimecodeRate).Value, Case.FrameNumber);
+
+		// frames without a device timecode are labeled the same way
+		const FTimecode Derived = FDirectShowMediaTimecode::FromTime(GetFrameTime(Case.FrameNumber, FrameRate), FrameRate);
+		TestTrue(FString::Printf(TEXT("Frame %d is labeled %s (got %s)"), Case.FrameNumber, *Timecode.ToString(), *Derived.ToString()), Derived == Timecode);
+	}
+
+	// the label of every frame follows the one of the frame before
+	int32 NumSkips = 0;
+	FTimecode Previous = FDirectShowMediaTimecode::FromTime(GetFrameTime(0, FrameRate), FrameRate);
+
+	for (int32 FrameNumber = 1; FrameNumber < 18000 * 2; ++FrameNumber)
+	{
+		const FTimecode Timecode = FDirectShowMediaTimecode::FromTime(GetFrameTime(FrameNumber, FrameRate), FrameRate);
+		const int32 Step = (Timecode.Minutes * 60 + Timecode.Seconds) * 30 + Timecode.Frames - ((Previous.Minutes * 60 + Previous.Seconds) * 30 + Previous.Frames);
+
+		if (Step != 1)
+		{
+			++NumSkips;
+
+			if (!TestTrue(FString::Printf(TEXT("%s follows %s"), *Timecode.ToString(), *Previous.ToString()), (Step == 3) && (Timecode.Seconds == 0) && (Timecode.Frames == 2) && ((Timecode.Minutes % 10) != 0)))
+			{
+				break;
+			}
+		}
+
+		Previous = Timecode;
+	}
+
+	TestEqual(TEXT("Two frame labels are skipped in 18 of 20 minutes"), NumSkips, 18);
+
+	return true;
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDirectShowMediaTimecodeIndexTest, "DirectShowMedia.Timecode.Index", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FDirectShowMediaTimecodeIndexTest::RunTest(const FString& Parameters)
+{
+	using namespace DirectShowMediaTimecodeTest;
+
+	const FFrameRate FrameRate(30, 1);
+
+	FIndex Index(4);
+
+	TestEqual(TEXT("An empty index has nothing to fetch"), Fetch(Index, 10, FrameRate), (int32)INDEX_NONE);
+	TestEqual(TEXT("Requests before the first frame are late"), Index.GetNumLate(), (uint64)1);
+
+	for (int32 FrameNumber = 10; FrameNumber < 14; ++FrameNumber)
+	{
+		Add(Index, FrameNumber, FrameRate);
+	}
+
+	// requests ahead of the device
+	TestEqual(TEXT("Frame 14 wasn't captured yet"), Fetch(Index, 14, FrameRate), (int32)INDEX_NONE);
+	TestEqual(TEXT("Frame 14 is late"), Index.GetNumLate(), (uint64)2);
+	TestEqual(TEXT("Frame 14 isn't counted twice"), Fetch(Index, 14, FrameRate), (int32)INDEX_NONE);
+	TestEqual(TEXT("Frame 14 is late once"), Index.GetNumLate(), (uint64)2);
+
+	// exact requests
+	TestEqual(TEXT("Frame 10 is fetched"), Fetch(Index, 10, FrameRate), 10);
+	TestEqual(TEXT("Frame 10 is a hit"), Index.GetNumHits(), (uint64)1);
+	TestEqual(TEXT("Frame 10 is only returned once"), Fetch(Index, 10, FrameRate), (int32)INDEX_NONE);
+	TestEqual(TEXT("Frame 10 is a hit once"), Index.GetNumHits(), (uint64)1);
+
+	// requests behind the device, frames 14 and 15 take the slots of 10 and 11
+	Add(Index, 14, FrameRate);
+	Add(Index, 15, FrameRate);
+
+	TestEqual(TEXT("Frame 11 was overwritten"), Fetch(Index, 11, FrameRate), (int32)INDEX_NONE);
+	TestEqual(TEXT("Frame 11 is early"), Index.GetNumEarly(), (uint64)1);
+
+	// dropped frames, 16 never arrives
+	Add(Index, 17, FrameRate);
+
+	TestEqual(TEXT("Frame 16 was dropped"), Fetch(Index, 16, FrameRate), (int32)INDEX_NONE);
+	TestEqual(TEXT("Frame 16 is missing"), Index.GetNumMissing(), (uint64)1);
+	TestEqual(TEXT("Frame 16 isn't counted twice"), Fetch(Index, 16, FrameRate), (int32)INDEX_NONE);
+	TestEqual(TEXT("Frame 16 is missing once"), Index.GetNumMissing(), (uint64)1);
+
+	// requests that were missed are still served once the frame arrives
+	TestEqual(TEXT("Frame 14 arrived since"), Fetch(Index, 14, FrameRate), 14);
+	TestEqual(TEXT("Frame 14 is a hit"), Index.GetNumHits(), (uint64)2);
+
+	// requests without a time
+	FIndex::FSamplePtr Sample;
+
+	if (TestTrue(TEXT("The newest frame is fetched"), Index.FetchNewest(Sample)))
+	{
+		TestEqual(TEXT("The newest frame is 17"), *Sample, 17);
+	}
+
+	TestEqual(TEXT("The newest frame is a hit"), Index.GetNumHits(), (uint64)3);
+	TestFalse(TEXT("The newest frame is only returned once"), Index.FetchNewest(Sample));
+	TestEqual(TEXT("The newest frame is a hit once"), Index.GetNumHits(), (uint64)3);
+
+	// frames indexed at another rate replace the samples
+	Add(Index, 15, FFrameRate(25, 1));
+	TestEqual(TEXT("Frame 15 at 30 fps was dropped with the rate change"), Fetch(Index, 15, FrameRate), (int32)INDEX_NONE);
+	TestEqual(TEXT("Frame 12 at 25 fps was never captured"), Index.GetNumMissing(), (uint64)2);
+	TestEqual(TEXT("Frame 15 at 25 fps is found at its time at 30 fps"), Fetch(Index, 18, FrameRate), 15);
+
+	Index.Flush();
+	TestEqual(TEXT("A flushed index has nothing to fetch"), Fetch(Index, 15, FrameRate), (int32)INDEX_NONE);
+
+	TestEqual(TEXT("Number of hits"), Index.GetNumHits(), (uint64)4);
+	TestEqual(TEXT("Number of late requests"), Index.GetNumLate(), (uint64)3);
+	TestEqual(TEXT("Number of early requests"), Index.GetNumEarly(), (uint64)1);
+	TestEqual(TEXT("Number of missing requests"), Index.GetNumMissing(), (uint64)2);
+
+	return true;
+}
+
+
+#endif //WITH_DEV_AUTOMATION_TESTS
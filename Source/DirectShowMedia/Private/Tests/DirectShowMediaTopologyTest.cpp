@@ -0,0 +1,138 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "CoreTypes.h"
+#include "Misc/AutomationTest.h"
+
+#include "HAL/PlatformMisc.h"
+#include "Math/UnrealMathUtility.h"
+#include "Player/DirectShowMediaTopology.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+
+namespace DirectShowMediaTopologyTest
+{
+	/** A requested placement, as the media options hold it, and the expected result. */
+	struct FPlacementCase
+	{
+		const TCHAR* Name;
+		int64 Node;
+		int64 CoreMask;
+		int32 ExpectedNode;
+		uint64 ExpectedCoreMask;
+	};
+
+	/** Check placements against a topology. */
+	void CheckPlacements(FAutomationTestBase& Test, const FDirectShowMediaTopology& Topology, const TArray<FPlacementCase>& Cases)
+	{
+		for (const FPlacementCase& Case : Cases)
+		{
+			const FDirectShowMediaPlacement Placement = Topology.Place(Case.Node, Case.CoreMask);
+			const bool bExpectSet = (Case.ExpectedNode != INDEX_NONE) || (Case.ExpectedCoreMask != 0);
+
+			Test.TestEqual(FString::Printf(TEXT("%s: node"), Case.Name), Placement.Node, Case.ExpectedNode);
+			Test.TestEqual(FString::Printf(TEXT("%s: cores"), Case.Name), Placement.CoreMask, Case.ExpectedCoreMask);
+			Test.TestEqual(FString::Printf(TEXT("%s: placed"), Case.Name), Placement.IsSet(), bExpectSet);
+		}
+	}
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDirectShowMediaTopologyPlaceTest, "DirectShowMedia.Topology.Place", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FDirectShowMediaTopologyPlaceTest::RunTest(const FString& Parameters)
+{
+	using namespace DirectShowMediaTopologyTest;
+
+	// two sockets of eight cores, and a third node whose cores are all outside processor group 0
+	const FDirectShowMediaTopology Topology(TArray<uint64>({ 0x00ffull, 0xff00ull, 0 }));
+
+	TestFalse(TEXT("A discovered topology isn't flat"), Topology.IsFlat());
+	TestEqual(TEXT("Nodes are counted"), Topology.GetNumNodes(), 3);
+	TestEqual(TEXT("Nodes that don't exist have no cores"), Topology.GetCoreMask(3), (uint64)0);
+
+	TestEqual(TEXT("Cores of one node are found"), Topology.FindNode(0x0030), 0);
+	TestEqual(TEXT("Cores of the other node are found"), Topology.FindNode(0x0300), 1);
+	TestEqual(TEXT("Cores across nodes have no node"), Topology.FindNode(0x0180), (int32)INDEX_NONE);
+	TestEqual(TEXT("Cores outside all nodes have no node"), Topology.FindNode(0x10000), (int32)INDEX_NONE);
+	TestEqual(TEXT("No cores have no node"), Topology.FindNode(0), (int32)INDEX_NONE);
+
+	CheckPlacements(*this, Topology,
+	{
+		{ TEXT("Nothing requested"), INDEX_NONE, 0, INDEX_NONE, 0 },
+		{ TEXT("Any negative node is none"), -7, 0x0030, 0, 0x0030 },
+		{ TEXT("Cores pick their node"), INDEX_NONE, 0x0030, 0, 0x0030 },
+		{ TEXT("Cores across nodes are kept without a node"), INDEX_NONE, 0x0180, INDEX_NONE, 0x0180 },
+		{ TEXT("All cores"), INDEX_NONE, -1, INDEX_NONE, ~0ull },
+		{ TEXT("A node runs on all of its cores"), 1, 0, 1, 0xff00 },
+		{ TEXT("A node runs on the requested cores"), 1, 0x0300, 1, 0x0300 },
+		{ TEXT("A node keeps its part of the requested cores"), 1, 0x0180, 1, 0x0100 },
+		{ TEXT("A node ignores cores that are all elsewhere"), 1, 0x0003, 1, 0xff00 },
+		{ TEXT("A node without cores in group 0 isn't placed"), 2, 0x0003, INDEX_NONE, 0 },
+		{ TEXT("A node that doesn't exist isn't placed"), 3, 0, INDEX_NONE, 0 },
+		{ TEXT("A node past 32 bits isn't placed"), 1ll << 32, 0x0003, INDEX_NONE, 0 },
+	});
+
+	// masks reach core 63, which the media options hold as a negative number
+	const FDirectShowMediaTopology LargeTopology(TArray<uint64>({ 0x00000000ffffffffull, 0xffffffff00000000ull }));
+
+	CheckPlacements(*this, LargeTopology,
+	{
+		{ TEXT("Core 63 picks its node"), INDEX_NONE, MIN_int64, 1, 1ull << 63 },
+		{ TEXT("Core 63 within its node"), 1, MIN_int64 | 1, 1, 1ull << 63 },
+	});
+
+	return true;
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDirectShowMediaTopologyFlatTest, "DirectShowMedia.Topology.Flat", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FDirectShowMediaTopologyFlatTest::RunTest(const FString& Parameters)
+{
+	using namespace DirectShowMediaTopologyTest;
+
+	// the fallback when the nodes can't be read: a single node with every core in the first 64
+	const FDirectShowMediaTopology Topology((TArray<uint64>()));
+
+	const int32 NumCores = FMath::Min(FPlatformMisc::NumberOfCoresIncludingHyperthreads(), 64);
+	const uint64 AllCores = (NumCores >= 64) ? ~0ull : ((1ull << NumCores) - 1);
+
+	TestTrue(TEXT("The topology is flat"), Topology.IsFlat());
+	TestEqual(TEXT("A flat topology has one node"), Topology.GetNumNodes(), 1);
+	TestEqual(TEXT("The node holds every core"), Topology.GetCoreMask(0), AllCores);
+
+	CheckPlacements(*this, Topology,
+	{
+		{ TEXT("Nothing requested"), INDEX_NONE, 0, INDEX_NONE, 0 },
+		{ TEXT("Node 0 runs on every core"), 0, 0, 0, AllCores },
+		{ TEXT("Node 0 runs on the requested cores"), 0, 0x1, 0, 0x1 },
+		{ TEXT("Cores are on node 0"), INDEX_NONE, 0x1, 0, 0x1 },
+		{ TEXT("Other nodes aren't placed"), 1, 0x1, INDEX_NONE, 0 },
+	});
+
+	// the machine's own topology is either discovered or flat, with disjoint nodes
+	const FDirectShowMediaTopology& Machine = FDirectShowMediaTopology::Get();
+	uint64 SeenCores = 0;
+	int32 NumOverlapping = 0;
+
+	for (int32 Node = 0; Node < Machine.GetNumNodes(); ++Node)
+	{
+		NumOverlapping += ((SeenCores & Machine.GetCoreMask(Node)) != 0) ? 1 : 0;
+		SeenCores |= Machine.GetCoreMask(Node);
+	}
+
+	AddInfo(FString::Printf(TEXT("This machine has %d node(s)%s, cores 0x%llx"), Machine.GetNumNodes(), Machine.IsFlat() ? TEXT(" (flat)") : TEXT(""), SeenCores));
+
+	TestTrue(TEXT("The machine has a node"), Machine.GetNumNodes() > 0);
+	TestEqual(TEXT("The machine's nodes don't share cores"), NumOverlapping, 0);
+
+#if !PLATFORM_WINDOWS
+	TestTrue(TEXT("Only Windows reports its nodes"), Machine.IsFlat());
+#endif
+
+	return true;
+}
+
+
+#endif //WITH_DEV_AUTOMATION_TESTS
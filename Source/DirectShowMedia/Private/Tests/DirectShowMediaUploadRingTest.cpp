@@ -0,0 +1,185 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "CoreTypes.h"
+#include "Misc/AutomationTest.h"
+
+#include "Player/DirectShowMediaColorConverter.h"
+#include "Player/DirectShowMediaCPUUploadBackend.h"
+#include "Player/DirectShowMediaTextureSample.h"
+#include "Player/DirectShowMediaUploadRing.h"
+#include "Player/DirectShowMediaVideoKernels.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+
+namespace DirectShowMediaUploadRingTest
+{
+	/** Create a ring of CPU slots, keeping a pointer to its backend. */
+	TSharedPtr<FDirectShowMediaUploadRing, ESPMode::ThreadSafe> CreateRing(int32 NumSlots, const FIntPoint& Dim, EMediaTextureSampleFormat Format, uint32 PitchAlignment, bool bDeferMapping, FDirectShowMediaCPUUploadBackend*& OutBackend)
+	{
+		TUniquePtr<FDirectShowMediaCPUUploadBackend> Backend = MakeUnique<FDirectShowMediaCPUUploadBackend>(PitchAlignment, bDeferMapping);
+		OutBackend = Backend.Get();
+
+		return FDirectShowMediaUploadRing::Create(MoveTemp(Backend), NumSlots, Dim, Format);
+	}
+
+	/** Make a YUY2 frame whose bytes encode their row and column. */
+	TArray<uint8> MakeYUY2Frame(int32 Width, int32 Height)
+	{
+		TArray<uint8> Frame;
+		Frame.SetNumUninitialized(Width * 2 * Height);
+
+		for (int32 Row = 0; Row < Height; ++Row)
+		{
+			for (int32 Column = 0; Column < Width * 2; ++Column)
+			{
+				Frame[Row * Width * 2 + Column] = (uint8)(Row * 7 + Column);
+			}
+		}
+
+		return Frame;
+	}
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDirectShowMediaUploadRingSlotsTest, "DirectShowMedia.UploadRing.Slots", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FDirectShowMediaUploadRingSlotsTest::RunTest(const FString& Parameters)
+{
+	FDirectShowMediaCPUUploadBackend* Backend = nullptr;
+	TSharedPtr<FDirectShowMediaUploadRing, ESPMode::ThreadSafe> Ring = DirectShowMediaUploadRingTest::CreateRing(3, FIntPoint(16, 4), EMediaTextureSampleFormat::CharBGRA, 256, false, Backend);
+
+	if (!TestTrue(TEXT("Ring created"), Ring.IsValid()))
+	{
+		return false;
+	}
+
+	FDirectShowMediaCPUUploadBackend* RefusedBackend = nullptr;
+	TestFalse(TEXT("Unsupported formats are refused"), DirectShowMediaUploadRingTest::CreateRing(3, FIntPoint(16, 4), EMediaTextureSampleFormat::CharNV12, 256, false, RefusedBackend).IsValid());
+
+	uint8* Data = nullptr;
+	uint32 Stride = 0;
+	int32 Slots[3];
+
+	// round robin over the mapped slots
+	for (int32 Index = 0; Index < 3; ++Index)
+	{
+		Slots[Index] = Ring->Acquire(Data, Stride);
+		TestEqual(TEXT("Slots are acquired round robin"), Slots[Index], Index);
+		TestEqual(TEXT("The stride is the padded pitch"), Stride, 256u);
+		Ring->Submit(Slots[Index]);
+	}
+
+	TestEqual(TEXT("No slot is free while all are in flight"), Ring->Acquire(Data, Stride), (int32)INDEX_NONE);
+	TestEqual(TEXT("The miss is counted"), Ring->GetNumMissed(), (uint64)1);
+	TestEqual(TEXT("The uploads are counted"), Ring->GetNumUploaded(), (uint64)3);
+
+	// cancelled slots stay mapped and are handed out again
+	Ring->Release(Slots[1]);
+	const int32 Cancelled = Ring->Acquire(Data, Stride);
+	TestEqual(TEXT("The released slot is acquired"), Cancelled, Slots[1]);
+	Ring->Cancel(Cancelled);
+	TestEqual(TEXT("The cancelled slot is acquired again"), Ring->Acquire(Data, Stride), Slots[1]);
+	TestEqual(TEXT("Cancelling doesn't remap"), Backend->GetNumMaps(Slots[1]), 2);
+
+	return true;
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDirectShowMediaUploadRingFenceTest, "DirectShowMedia.UploadRing.Fences", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FDirectShowMediaUploadRingFenceTest::RunTest(const FString& Parameters)
+{
+	FDirectShowMediaCPUUploadBackend* Backend = nullptr;
+	TSharedPtr<FDirectShowMediaUploadRing, ESPMode::ThreadSafe> Ring = DirectShowMediaUploadRingTest::CreateRing(2, FIntPoint(16, 4), EMediaTextureSampleFormat::CharBGRA, 256, true, Backend);
+
+	if (!TestTrue(TEXT("Ring created"), Ring.IsValid()))
+	{
+		return false;
+	}
+
+	uint8* Data = nullptr;
+	uint32 Stride = 0;
+
+	TestEqual(TEXT("Slots can't be acquired before their mapping completes"), Ring->Acquire(Data, Stride), (int32)INDEX_NONE);
+
+	Backend->SignalFences();
+
+	const int32 First = Ring->Acquire(Data, Stride);
+	TestNotEqual(TEXT("A slot is acquired once its fence signaled"), First, (int32)INDEX_NONE);
+	Ring->Submit(First);
+
+	// a released slot waits for its fence again, the other one is still mapped
+	Ring->Release(First);
+	const int32 Second = Ring->Acquire(Data, Stride);
+	TestTrue(TEXT("The other mapped slot is acquired"), (Second != INDEX_NONE) && (Second != First));
+	Ring->Submit(Second);
+
+	TestEqual(TEXT("The released slot isn't acquired before its fence signaled"), Ring->Acquire(Data, Stride), (int32)INDEX_NONE);
+
+	Backend->SignalFences();
+	TestEqual(TEXT("The released slot is acquired after its fence signaled"), Ring->Acquire(Data, Stride), First);
+
+	return true;
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDirectShowMediaUploadRingRecycleTest, "DirectShowMedia.UploadRing.Recycle", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FDirectShowMediaUploadRingRecycleTest::RunTest(const FString& Parameters)
+{
+	const int32 Width = 64;
+	const int32 Height = 8;
+
+	// the frame's rows are 128 bytes, the slots' 256, so the frame can't be written as one run
+	FDirectShowMediaCPUUploadBackend* Backend = nullptr;
+	TSharedPtr<FDirectShowMediaUploadRing, ESPMode::ThreadSafe> Ring = DirectShowMediaUploadRingTest::CreateRing(2, FIntPoint(Width / 2, Height), EMediaTextureSampleFormat::CharYUY2, 256, false, Backend);
+
+	if (!TestTrue(TEXT("Ring created"), Ring.IsValid()))
+	{
+		return false;
+	}
+
+	const TArray<uint8> Frame = DirectShowMediaUploadRingTest::MakeYUY2Frame(Width, Height);
+	const FDirectShowMediaVideoKernel AlignedKernel = FDirectShowMediaVideoKernels::Find(EMediaTextureSampleFormat::CharYUY2, EMediaTextureSampleFormat::CharYUY2, false, true);
+	const FDirectShowMediaVideoKernel RowKernel = FDirectShowMediaVideoKernels::Find(EMediaTextureSampleFormat::CharYUY2, EMediaTextureSampleFormat::CharYUY2, false, false);
+	const FDirectShowMediaColorConverter Converter;
+
+	// more frames than slots, each sample hands its slot back when it is released
+	for (int32 FrameIndex = 0; FrameIndex < 5; ++FrameIndex)
+	{
+		FDirectShowMediaTextureSample Sample;
+
+		const bool bInitialized = Sample.Initialize(EMediaTextureSampleFormat::CharYUY2, AlignedKernel, RowKernel, Converter, Ring.ToSharedRef(),
+			Frame.GetData(), Frame.Num(), Width * 2, Width * 2, FIntPoint(Width / 2, Height), FIntPoint(Width, Height), EMediaTextureSampleFormat::CharYUY2, FTimespan::Zero(), FTimespan::Zero());
+
+		if (!TestTrue(TEXT("The frame is written into a slot"), bInitialized))
+		{
+			return false;
+		}
+
+		TestEqual(TEXT("The sample has the slot's stride"), Sample.GetStride(), 256u);
+		Sample.ShutdownPoolable();
+	}
+
+	TestEqual(TEXT("Every frame was uploaded"), Ring->GetNumUploaded(), (uint64)5);
+	TestEqual(TEXT("No frame missed a slot"), Ring->GetNumMissed(), (uint64)0);
+	TestEqual(TEXT("The slots were recycled"), Backend->GetNumSubmits(0) + Backend->GetNumSubmits(1), 5);
+
+	// every row lands at the slot's pitch, none runs past the end of the slot
+	uint32 Stride = 0;
+	const uint8* Uploaded = Backend->GetUploadedData(0, Stride);
+
+	if (TestNotNull(TEXT("The slot was uploaded"), Uploaded))
+	{
+		for (int32 Row = 0; Row < Height; ++Row)
+		{
+			TestTrue(FString::Printf(TEXT("Row %d is intact"), Row), FMemory::Memcmp(Uploaded + Row * Stride, Frame.GetData() + Row * Width * 2, Width * 2) == 0);
+		}
+	}
+
+	return true;
+}
+
+
+#endif //WITH_DEV_AUTOMATION_TESTS
@@ -0,0 +1,560 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "CoreTypes.h"
+#include "Misc/AutomationTest.h"
+
+#include "DirectShowMediaCommon.h"
+#include "HAL/PlatformTime.h"
+#include "Player/DirectShowMediaColorConverter.h"
+#include "Player/DirectShowMediaTextureSample.h"
+#include "Player/DirectShowMediaVideoKernels.h"
+#include "Player/DirectShowMediaVideoLayout.h"
+#include "Player/DirectShowMediaVideoUnpacker.h"
+#include "Templates/AlignmentTemplates.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+
+namespace DirectShowMediaVideoKernelsTest
+{
+	/** Value of the padding bytes of captured frames, which must never reach a sample's pixels. */
+	const uint8 Padding = 0xee;
+
+	/** Value of the bytes of sample buffers that kernels must not write. */
+	const uint8 Guard = 0xdd;
+
+	/** Number of guard bytes after a sample buffer. */
+	const int32 NumGuardBytes = 64;
+
+	/** Value of a byte of a captured frame, never the padding or guard value. */
+	uint8 GetByte(int32 Row, int32 Offset)
+	{
+		return (uint8)(1 + (Row * 13 + Offset * 7) % 0xd0);
+	}
+
+	/**
+	 * Build a captured frame with padded rows.
+	 *
+	 * @param NumRows Number of rows (luma and chroma rows for NV12).
+	 * @param RowSize Number of bytes of pixels per row.
+	 * @param Pitch Number of bytes per row.
+	 * @return The frame, with every padding byte set to Padding.
+	 */
+	TArray<uint8> MakeFrame(int32 NumRows, uint32 RowSize, uint32 Pitch)
+	{
+		TArray<uint8> Frame;
+		Frame.Init(Padding, Pitch * NumRows);
+
+		for (int32 Row = 0; Row < NumRows; ++Row)
+		{
+			for (uint32 Offset = 0; Offset < RowSize; ++Offset)
+			{
+				Frame[Row * Pitch + Offset] = GetByte(Row, Offset);
+			}
+		}
+
+		return Frame;
+	}
+
+	/**
+	 * Get the captured row that goes to a row of a sample, planes being flipped separately.
+	 *
+	 * @param Row The row of the sample.
+	 * @param Height The frame height (in pixels).
+	 * @param bNV12 Whether the frame has a chroma plane after its luma rows.
+	 * @param bFlip Whether the frame is flipped.
+	 * @return The row of the captured frame.
+	 */
+	int32 GetSourceRow(int32 Row, int32 Height, bool bNV12, bool bFlip)
+	{
+		if (!bFlip)
+		{
+			return Row;
+		}
+
+		if (bNV12 && (Row >= Height))
+		{
+			const int32 ChromaRows = (Height + 1) / 2;
+			return Height + (ChromaRows - 1 - (Row - Height));
+		}
+
+		return Height - 1 - Row;
+	}
+
+	/**
+	 * Convert a pixel of a captured YUV frame with the converter's single pixel path.
+	 *
+	 * @param Format The frame's format (CharYUY2, CharUYVY or CharNV12).
+	 * @param Frame The frame.
+	 * @param Pitch Number of bytes per row of the frame (of the luma plane for NV12).
+	 * @param Height The frame height (in pixels).
+	 * @param X The pixel's column.
+	 * @param Y The pixel's row.
+	 * @param Converter The converter.
+	 * @param OutPixel Will contain the BGRA pixel.
+	 */
+	void ConvertReference(EMediaTextureSampleFormat Format, const uint8* Frame, uint32 Pitch, int32 Height, int32 X, int32 Y, const FDirectShowMediaColorConverter& Converter, uint8 OutPixel[4])
+	{
+		if (Format == EMediaTextureSampleFormat::CharNV12)
+		{
+			const uint8* Chroma = Frame + Pitch * Height + Pitch * (Y / 2) + (X & ~1);
+			Converter.ConvertPixel(Frame[Pitch * Y + X], Chroma[0], Chroma[1], OutPixel);
+
+			return;
+		}
+
+		const uint8* Pair = Frame + Pitch * Y + (X / 2) * 4;
+		const bool bUYVY = (Format == EMediaTextureSampleFormat::CharUYVY);
+
+		Converter.ConvertPixel(Pair[(bUYVY ? 1 : 0) + (X & 1) * 2], Pair[bUYVY ? 0 : 1], Pair[bUYVY ? 2 : 3], OutPixel);
+	}
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDirectShowMediaVideoKernelsCopyTest, "DirectShowMedia.VideoKernels.Copy", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FDirectShowMediaVideoKernelsCopyTest::RunTest(const FString& Parameters)
+{
+	using namespace DirectShowMediaVideoKernelsTest;
+
+	struct FCase
+	{
+		EMediaTextureSampleFormat Format;
+		int32 Width;
+		uint32 RowSize;
+	};
+
+	const FCase Cases[] =
+	{
+		{ EMediaTextureSampleFormat::CharBGRA, 7, 7 * 4 },
+		{ EMediaTextureSampleFormat::CharBGRA, 48, 48 * 4 },
+		{ EMediaTextureSampleFormat::CharYUY2, 6, 6 * 2 },
+		{ EMediaTextureSampleFormat::CharYUY2, 50, 50 * 2 },
+		{ EMediaTextureSampleFormat::CharUYVY, 6, 6 * 2 },
+		{ EMediaTextureSampleFormat::CharUYVY, 50, 50 * 2 },
+		{ EMediaTextureSampleFormat::YUVv210, 50, FDirectShowMediaVideoUnpacker::GetSourceStride(EDirectShowMediaHighBitDepthFormat::V210, 50) },
+		{ EMediaTextureSampleFormat::CharNV12, 6, 6 },
+		{ EMediaTextureSampleFormat::CharNV12, 48, 48 },
+	};
+
+	// the row alignments of sample buffers, 0 being the captured pitch so the single run path is taken
+	const uint32 Alignments[] = { 1, 16, 64, 256, 0 };
+	const uint32 PitchPaddings[] = { 0, 8, 100 };
+	const int32 Heights[] = { 1, 5, 6 };
+
+	int32 NumRuns = 0;
+	int32 NumAlignedRuns = 0;
+
+	for (const FCase& Case : Cases)
+	{
+		const bool bNV12 = (Case.Format == EMediaTextureSampleFormat::CharNV12);
+
+		for (int32 Height : Heights)
+		{
+			const int32 NumRows = bNV12 ? Height + (Height + 1) / 2 : Height;
+
+			for (uint32 PitchPadding : PitchPaddings)
+			{
+				const uint32 Pitch = Case.RowSize + PitchPadding;
+				const TArray<uint8> Frame = MakeFrame(NumRows, Case.RowSize, Pitch);
+
+				for (uint32 Alignment : Alignments)
+				{
+					const uint32 DestStride = (Alignment == 0) ? Pitch : Align(Case.RowSize, Alignment);
+					const bool bAligned = FDirectShowMediaVideoKernels::IsAligned(Case.Format, Case.Format, Case.Width, Pitch, DestStride);
+
+					if (Alignment != 0)
+					{
+						TestEqual(FString::Printf(TEXT("Stride %u is aligned to %u"), DestStride, Alignment), DestStride % Alignment, 0u);
+					}
+
+					for (int32 Flip = 0; Flip < 2; ++Flip)
+					{
+						const FString Name = FString::Printf(TEXT("Format %d, %dx%d, pitch %u, stride %u%s"), (int32)Case.Format, Case.Width, Height, Pitch, DestStride, Flip ? TEXT(", flipped") : TEXT(""));
+
+						FDirectShowMediaVideoKernel Kernel = FDirectShowMediaVideoKernels::Find(Case.Format, Case.Format, Flip != 0, bAligned);
+
+						if (!TestNotNull(*FString::Printf(TEXT("%s has a kernel"), *Name), Kernel))
+						{
+							continue;
+						}
+
+						TArray<uint8> Dest;
+						Dest.Init(Guard, DestStride * NumRows + NumGuardBytes);
+
+						FDirectShowMediaVideoKernelArgs Args;
+						Args.Source = Frame.GetData();
+						Args.SourceSize = Frame.Num();
+						Args.SourceStride = Pitch;
+						Args.RowSize = Case.RowSize;
+						Args.Dest = Dest.GetData();
+						Args.DestStride = DestStride;
+						Args.Width = Case.Width;
+						Args.Height = Height;
+
+						if (!TestTrue(*FString::Printf(TEXT("%s is copied"), *Name), Kernel(Args)))
+						{
+							continue;
+						}
+
+						int32 NumMismatches = 0;
+						int32 NumPaddingWrites = 0;
+
+						for (int32 Row = 0; Row < NumRows; ++Row)
+						{
+							const uint8* SourceRow = Frame.GetData() + Pitch * GetSourceRow(Row, Height, bNV12, Flip != 0);
+							const uint8* DestRow = Dest.GetData() + DestStride * Row;
+
+							if (FMemory::Memcmp(DestRow, SourceRow, Case.RowSize) != 0)
+							{
+								++NumMismatches;
+							}
+
+							// the single run path copies the pitch, so a row keeps the padding of its own captured row
+							const uint32 PaddingSize = (Row == NumRows - 1) ? 0 : DestStride - Case.RowSize;
+
+							for (uint32 Offset = 0; Offset < PaddingSize; ++Offset)
+							{
+								const uint8 Expected = (bAligned && !Flip) ? SourceRow[Case.RowSize + Offset] : Guard;
+
+								if (DestRow[Case.RowSize + Offset] != Expected)
+								{
+									++NumPaddingWrites;
+								}
+							}
+						}
+
+						// nothing is written after the last row's pixels
+						const int32 End = DestStride * (NumRows - 1) + Case.RowSize;
+
+						for (int32 Offset = End; Offset < Dest.Num(); ++Offset)
+						{
+							if (Dest[Offset] != Guard)
+							{
+								++NumPaddingWrites;
+							}
+						}
+
+						TestEqual(*FString::Printf(TEXT("%s copies every row"), *Name), NumMismatches, 0);
+						TestEqual(*FString::Printf(TEXT("%s writes no padding"), *Name), NumPaddingWrites, 0);
+
+						++NumRuns;
+						NumAlignedRuns += bAligned ? 1 : 0;
+					}
+				}
+			}
+		}
+	}
+
+	TestTrue(FString::Printf(TEXT("Both kernel variants are run (%d of %d runs aligned)"), NumAlignedRuns, NumRuns), (NumAlignedRuns > 0) && (NumAlignedRuns < NumRuns));
+
+	return true;
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDirectShowMediaVideoKernelsLayoutTest, "DirectShowMedia.VideoKernels.Layout", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FDirectShowMediaVideoKernelsLayoutTest::RunTest(const FString& Parameters)
+{
+	using namespace DirectShowMediaVideoKernelsTest;
+
+	struct FCase
+	{
+		GUID Subtype;
+		EMediaTextureSampleFormat SourceFormat;
+		int32 Width;
+		bool bConvertToBGRA;
+	};
+
+	const FCase Cases[] =
+	{
+		{ MEDIASUBTYPE_RGB32, EMediaTextureSampleFormat::CharBGRA, 60, false },
+		{ MEDIASUBTYPE_RGB32, EMediaTextureSampleFormat::CharBGRA, 61, false },
+		{ MEDIASUBTYPE_YUY2, EMediaTextureSampleFormat::CharYUY2, 60, false },
+		{ MEDIASUBTYPE_UYVY, EMediaTextureSampleFormat::CharUYVY, 60, false },
+		{ DSMEDIASUBTYPE_v210, EMediaTextureSampleFormat::YUVv210, 60, false },
+		{ MEDIASUBTYPE_NV12, EMediaTextureSampleFormat::CharNV12, 61, false },
+		{ MEDIASUBTYPE_YUY2, EMediaTextureSampleFormat::CharYUY2, 60, true },
+		{ MEDIASUBTYPE_UYVY, EMediaTextureSampleFormat::CharUYVY, 60, true },
+		{ MEDIASUBTYPE_NV12, EMediaTextureSampleFormat::CharNV12, 60, true },
+		{ MEDIASUBTYPE_NV12, EMediaTextureSampleFormat::CharNV12, 61, true },
+	};
+
+	const uint32 Alignments[] = { 0, 16, 64, 256 };
+	const int32 Height = 5;
+
+	FDirectShowMediaColorConverter Converter;
+	Converter.Configure(FDirectShowMediaColorimetry());
+
+	for (const FCase& Case : Cases)
+	{
+		const bool bNV12 = (Case.SourceFormat == EMediaTextureSampleFormat::CharNV12);
+		const int32 NumRows = bNV12 ? Height + (Height + 1) / 2 : Height;
+
+		// tight (chroma rows of odd width NV12 frames end with a whole pair), padded, and padded to a multiple of 64 pixels
+		const int32 Pitches[] = { bNV12 ? Align(Case.Width, 2) : Case.Width, Case.Width + 10, Align(Case.Width, 64) };
+
+		for (int32 PitchInPixels : Pitches)
+		{
+			uint32 Pitch = 0;
+			uint32 RowSize = 0;
+
+			switch (Case.SourceFormat)
+			{
+			case EMediaTextureSampleFormat::CharBGRA:
+				Pitch = PitchInPixels * 4;
+				RowSize = Case.Width * 4;
+				break;
+
+			case EMediaTextureSampleFormat::YUVv210:
+				Pitch = FDirectShowMediaVideoUnpacker::GetSourceStride(EDirectShowMediaHighBitDepthFormat::V210, PitchInPixels);
+				RowSize = FDirectShowMediaVideoUnpacker::GetSourceStride(EDirectShowMediaHighBitDepthFormat::V210, Case.Width);
+				break;
+
+			case EMediaTextureSampleFormat::CharNV12:
+				Pitch = PitchInPixels;
+				RowSize = Case.Width;
+				break;
+
+			default:
+				Pitch = PitchInPixels * 2;
+				RowSize = Case.Width * 2;
+				break;
+			}
+
+			const TArray<uint8> Frame = MakeFrame(NumRows, RowSize, Pitch);
+
+			for (uint32 Alignment : Alignments)
+			{
+				for (int32 Flip = 0; Flip < 2; ++Flip)
+				{
+					const FString Name = FString::Printf(TEXT("Format %d%s, %dx%d, pitch %u, alignment %u%s"), (int32)Case.SourceFormat, Case.bConvertToBGRA ? TEXT(" to BGRA") : TEXT(""), Case.Width, Height, Pitch, Alignment, Flip ? TEXT(", flipped") : TEXT(""));
+
+					FDirectShowMediaVideoLayout Layout;
+
+					if (!TestTrue(*FString::Printf(TEXT("%s is resolved"), *Name), Layout.Resolve(Case.Subtype, FIntPoint(Case.Width, Height), PitchInPixels, 30.0f, Converter, false, false, Case.bConvertToBGRA, Flip != 0, Alignment)))
+					{
+						continue;
+					}
+
+					FDirectShowMediaTextureSample Sample;
+
+					if (!TestTrue(*FString::Printf(TEXT("%s is initialized"), *Name), Layout.InitializeSample(Sample, nullptr, Frame.GetData(), Frame.Num(), FTimespan::Zero(), FTimespan::Zero())))
+					{
+						continue;
+					}
+
+					const uint32 Stride = Sample.GetStride();
+					const uint32 OutRowSize = Case.bConvertToBGRA ? Case.Width * 4 : RowSize;
+
+					if (Alignment > 1)
+					{
+						TestEqual(*FString::Printf(TEXT("%s has an aligned stride (%u)"), *Name, Stride), Stride % Alignment, 0u);
+					}
+
+					if (!TestTrue(*FString::Printf(TEXT("%s has a stride that holds a row (%u)"), *Name, Stride), Stride >= OutRowSize))
+					{
+						continue;
+					}
+
+					const uint8* Buffer = (const uint8*)Sample.GetBuffer();
+					int32 NumMismatches = 0;
+
+					if (Case.bConvertToBGRA)
+					{
+						for (int32 Y = 0; Y < Height; ++Y)
+						{
+							const int32 SourceRow = GetSourceRow(Y, Height, false, Flip != 0);
+
+							for (int32 X = 0; X < Case.Width; ++X)
+							{
+								uint8 Expected[4];
+								ConvertReference(Case.SourceFormat, Frame.GetData(), Pitch, Height, X, SourceRow, Converter, Expected);
+
+								if (FMemory::Memcmp(Buffer + Stride * Y + X * 4, Expected, 4) != 0)
+								{
+									++NumMismatches;
+								}
+							}
+						}
+					}
+					else
+					{
+						for (int32 Row = 0; Row < NumRows; ++Row)
+						{
+							if (FMemory::Memcmp(Buffer + Stride * Row, Frame.GetData() + Pitch * GetSourceRow(Row, Height, bNV12, Flip != 0), RowSize) != 0)
+							{
+								++NumMismatches;
+							}
+						}
+					}
+
+					TestEqual(*FString::Printf(TEXT("%s has the captured pixels only"), *Name), NumMismatches, 0);
+				}
+			}
+		}
+	}
+
+	return true;
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDirectShowMediaVideoKernelsBenchmarkTest, "DirectShowMedia.VideoKernels.Benchmark", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FDirectShowMediaVideoKernelsBenchmarkTest::RunTest(const FString& Parameters)
+{
+	using namespace DirectShowMediaVideoKernelsTest;
+
+	struct FPair
+	{
+		const TCHAR* Name;
+		EMediaTextureSampleFormat SourceFormat;
+		EMediaTextureSampleFormat DestFormat;
+	};
+
+	// every pair the table generates kernels for
+	const FPair Pairs[] =
+	{
+		{ TEXT("BGRA copy"), EMediaTextureSampleFormat::CharBGRA, EMediaTextureSampleFormat::CharBGRA },
+		{ TEXT("YUY2 copy"), EMediaTextureSampleFormat::CharYUY2, EMediaTextureSampleFormat::CharYUY2 },
+		{ TEXT("UYVY copy"), EMediaTextureSampleFormat::CharUYVY, EMediaTextureSampleFormat::CharUYVY },
+		{ TEXT("v210 copy"), EMediaTextureSampleFormat::YUVv210, EMediaTextureSampleFormat::YUVv210 },
+		{ TEXT("NV12 copy"), EMediaTextureSampleFormat::CharNV12, EMediaTextureSampleFormat::CharNV12 },
+		{ TEXT("YUY2 to BGRA"), EMediaTextureSampleFormat::CharYUY2, EMediaTextureSampleFormat::CharBGRA },
+		{ TEXT("UYVY to BGRA"), EMediaTextureSampleFormat::CharUYVY, EMediaTextureSampleFormat::CharBGRA },
+		{ TEXT("NV12 to BGRA"), EMediaTextureSampleFormat::CharNV12, EMediaTextureSampleFormat::CharBGRA },
+	};
+
+	// 1080p frames, the rows that aren't aligned padded like a driver and a texture upload would
+	const int32 Width = 1920;
+	const int32 Height = 1080;
+	const uint32 PitchPadding = 64;
+	const uint32 RowAlignment = 256;
+	const int32 NumRuns = 5;
+
+	FDirectShowMediaColorConverter Converter;
+	Converter.Configure(FDirectShowMediaColorimetry());
+
+	TArray<uint8> Dest;
+	int32 NumKernels = 0;
+	int32 NumSlow = 0;
+
+	for (const FPair& Pair : Pairs)
+	{
+		const bool bNV12 = (Pair.SourceFormat == EMediaTextureSampleFormat::CharNV12);
+		const bool bConvert = (Pair.SourceFormat != Pair.DestFormat);
+		const int32 NumRows = bNV12 ? Height + (Height + 1) / 2 : Height;
+		const int32 NumOutRows = bConvert ? Height : NumRows;
+
+		FString Results;
+
+		for (int32 Aligned = 1; Aligned >= 0; --Aligned)
+		{
+			// NV12 is converted a pair of pixels at a time whatever the pitches, so only an odd width isn't aligned
+			const int32 RunWidth = (!Aligned && bNV12 && bConvert) ? Width - 1 : Width;
+
+			uint32 RowSize = RunWidth * 4;
+
+			switch (Pair.SourceFormat)
+			{
+			case EMediaTextureSampleFormat::CharYUY2:
+			case EMediaTextureSampleFormat::CharUYVY:
+				RowSize = RunWidth * 2;
+				break;
+
+			case EMediaTextureSampleFormat::YUVv210:
+				RowSize = FDirectShowMediaVideoUnpacker::GetSourceStride(EDirectShowMediaHighBitDepthFormat::V210, RunWidth);
+				break;
+
+			case EMediaTextureSampleFormat::CharNV12:
+				RowSize = RunWidth;
+				break;
+
+			default:
+				break;
+			}
+
+			const uint32 OutRowSize = bConvert ? RunWidth * 4 : RowSize;
+			const uint32 Pitch = Aligned ? RowSize : RowSize + PitchPadding;
+			const uint32 DestStride = Aligned ? OutRowSize : Align(OutRowSize + 1, RowAlignment);
+			const TArray<uint8> Frame = MakeFrame(NumRows, RowSize, Pitch);
+
+			if (!TestEqual(FString::Printf(TEXT("%s rows are %s"), Pair.Name, Aligned ? TEXT("aligned") : TEXT("not aligned")), FDirectShowMediaVideoKernels::IsAligned(Pair.SourceFormat, Pair.DestFormat, RunWidth, Pitch, DestStride), Aligned != 0))
+			{
+				continue;
+			}
+
+			Dest.SetNumUninitialized(DestStride * NumOutRows);
+
+			FDirectShowMediaVideoKernelArgs Args;
+			Args.Source = Frame.GetData();
+			Args.SourceSize = Frame.Num();
+			Args.SourceStride = Pitch;
+			Args.RowSize = RowSize;
+			Args.Dest = Dest.GetData();
+			Args.DestStride = DestStride;
+			Args.Width = RunWidth;
+			Args.Height = Height;
+			Args.Converter = &Converter;
+
+			for (int32 Flip = 0; Flip < 2; ++Flip)
+			{
+				const FDirectShowMediaVideoKernel Kernel = FDirectShowMediaVideoKernels::Find(Pair.SourceFormat, Pair.DestFormat, Flip != 0, Aligned != 0);
+				const FString Name = FString::Printf(TEXT("%s%s%s"), Pair.Name, Aligned ? TEXT(", aligned") : TEXT(", not aligned"), Flip ? TEXT(", flipped") : TEXT(""));
+
+				if (!TestNotNull(*FString::Printf(TEXT("%s has a kernel"), *Name), Kernel))
+				{
+					continue;
+				}
+
+				// the best of a few runs, so a preempted run doesn't count
+				double BestTime = MAX_dbl;
+				int32 NumFailed = 0;
+
+				for (int32 Run = 0; Run < NumRuns; ++Run)
+				{
+					const double StartTime = FPlatformTime::Seconds();
+					NumFailed += Kernel(Args) ? 0 : 1;
+					BestTime = FMath::Min(BestTime, FPlatformTime::Seconds() - StartTime);
+				}
+
+				TestEqual(*FString::Printf(TEXT("%s runs"), *Name), NumFailed, 0);
+
+				// spot check the last row written, which is the first captured row when flipped
+				const int32 LastRow = NumOutRows - 1;
+				const int32 SourceRow = bConvert ? GetSourceRow(LastRow, Height, false, Flip != 0) : GetSourceRow(LastRow, Height, bNV12, Flip != 0);
+
+				if (!bConvert)
+				{
+					TestTrue(*FString::Printf(TEXT("%s copies the last row"), *Name), FMemory::Memcmp(Dest.GetData() + DestStride * LastRow, Frame.GetData() + Pitch * SourceRow, RowSize) == 0);
+				}
+				else
+				{
+					uint8 Expected[4];
+					ConvertReference(Pair.SourceFormat, Frame.GetData(), Pitch, Height, RunWidth - 1, SourceRow, Converter, Expected);
+					TestTrue(*FString::Printf(TEXT("%s converts the last row"), *Name), FMemory::Memcmp(Dest.GetData() + DestStride * LastRow + (RunWidth - 1) * 4, Expected, 4) == 0);
+				}
+
+				Results += FString::Printf(TEXT(" %.2f ms %s%s (%.1f GB/s),"), BestTime * 1e3, Aligned ? TEXT("aligned") : TEXT("not aligned"), Flip ? TEXT(" flipped") : TEXT(""), (double)Frame.Num() / BestTime / 1e9);
+
+				++NumKernels;
+
+				// generous bounds, so debug builds and loaded machines pass while a per pixel branch in a copy doesn't
+				if (BestTime > (bConvert ? 0.1 : 0.02))
+				{
+					++NumSlow;
+				}
+			}
+		}
+
+		AddInfo(FString::Printf(TEXT("%s 1080p:%s"), Pair.Name, *Results.LeftChop(1)));
+	}
+
+	TestEqual(TEXT("Every specialization is benchmarked"), NumKernels, (int32)UE_ARRAY_COUNT(Pairs) * 4);
+	TestEqual(TEXT("1080p frames are copied in 20 ms and converted in 100 ms"), NumSlow, 0);
+
+	return true;
+}
+
+
+#endif //WITH_DEV_AUTOMATION_TESTS
@@ -0,0 +1,296 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "CoreTypes.h"
+#include "Misc/AutomationTest.h"
+
+#include "DirectShowMediaCommon.h"
+#include "HAL/PlatformTime.h"
+#include "Player/DirectShowMediaColorConverter.h"
+#include "Player/DirectShowMediaTextureSample.h"
+#include "Player/DirectShowMediaVideoLayout.h"
+#include "Player/DirectShowMediaVideoUnpacker.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+
+namespace DirectShowMediaVideoLayoutTest
+{
+	/** A negotiated format, as the video device reports it. */
+	class FFakeDevice
+	{
+	public:
+
+		FFakeDevice(const GUID& InSubtype, const FIntPoint& InTextureSize, float InFramerate)
+			: Subtype(InSubtype)
+			, TextureSize(InTextureSize)
+			, Framerate(InFramerate)
+		{ }
+
+		virtual ~FFakeDevice() { }
+
+		// virtual, so the per-frame queries aren't hoisted out of the benchmark loop
+		virtual GUID GetSampleSubtype() const { return Subtype; }
+		virtual FIntPoint GetTextureSize() const { return TextureSize; }
+		virtual float GetFramerate() const { return Framerate; }
+
+	private:
+
+		GUID Subtype;
+		FIntPoint TextureSize;
+		float Framerate;
+	};
+
+	/** The layout of a copied format, as the video handler picked it for every frame before it was resolved once. */
+	struct FLegacyLayout
+	{
+		FIntPoint Dim;
+		uint32 Stride;
+		EMediaTextureSampleFormat Format;
+		FTimespan Duration;
+	};
+
+	/** The video handler's per-frame if-chain over the subtype, for the formats it copied. */
+	bool ResolveLegacy(const FFakeDevice& Device, bool bConvertTo8Bit, FLegacyLayout& OutLayout)
+	{
+		float FrameRate = Device.GetFramerate();
+
+		if (FrameRate <= 0.0f)
+		{
+			FrameRate = 30.0f;
+		}
+
+		OutLayout.Duration = FTimespan((int64)((float)ETimespan::TicksPerSecond / FrameRate));
+
+		const FIntPoint Resolution = Device.GetTextureSize();
+		const GUID Subtype = Device.GetSampleSubtype();
+
+		if (Subtype == MEDIASUBTYPE_MJPG)
+		{
+			OutLayout.Dim = Resolution;
+			OutLayout.Stride = Resolution.X * 4;
+			OutLayout.Format = EMediaTextureSampleFormat::CharBGRA;
+		}
+		else if (Subtype == MEDIASUBTYPE_NV12)
+		{
+			OutLayout.Dim = FIntPoint(Resolution.X, Resolution.Y * 3 / 2);
+			OutLayout.Stride = Resolution.X;
+			OutLayout.Format = EMediaTextureSampleFormat::CharNV12;
+		}
+		else if ((Subtype == MEDIASUBTYPE_IYUV) || (Subtype == DSMEDIASUBTYPE_I420) || (Subtype == MEDIASUBTYPE_YV12) || (Subtype == DSMEDIASUBTYPE_NV21))
+		{
+			return false; // split into planes
+		}
+		else if ((Subtype == MEDIASUBTYPE_RGB32) || (Subtype == MEDIASUBTYPE_ARGB32))
+		{
+			OutLayout.Dim = Resolution;
+			OutLayout.Stride = Resolution.X * 4;
+			OutLayout.Format = EMediaTextureSampleFormat::CharBGRA;
+		}
+		else if (Subtype == MEDIASUBTYPE_UYVY)
+		{
+			OutLayout.Dim = FIntPoint(Resolution.X / 2, Resolution.Y);
+			OutLayout.Stride = Resolution.X * 2;
+			OutLayout.Format = EMediaTextureSampleFormat::CharUYVY;
+		}
+		else if (Subtype == MEDIASUBTYPE_H264)
+		{
+			OutLayout.Dim = Resolution;
+			OutLayout.Stride = Resolution.X * 4;
+			OutLayout.Format = EMediaTextureSampleFormat::CharBGRA;
+		}
+		else if (Subtype == MEDIASUBTYPE_YUY2)
+		{
+			OutLayout.Dim = FIntPoint(Resolution.X / 2, Resolution.Y);
+			OutLayout.Stride = Resolution.X * 2;
+			OutLayout.Format = EMediaTextureSampleFormat::CharYUY2;
+		}
+		else if ((Subtype == DSMEDIASUBTYPE_v210) && !bConvertTo8Bit)
+		{
+			OutLayout.Stride = FDirectShowMediaVideoUnpacker::GetSourceStride(EDirectShowMediaHighBitDepthFormat::V210, Resolution.X);
+			OutLayout.Dim = FIntPoint(OutLayout.Stride / 16, Resolution.Y);
+			OutLayout.Format = EMediaTextureSampleFormat::YUVv210;
+		}
+		else
+		{
+			return false; // unpacked or unsupported
+		}
+
+		return true;
+	}
+
+	/** A copied format. */
+	struct FFormatCase
+	{
+		const TCHAR* Name;
+		const GUID* Subtype;
+		int32 BytesPerRow;
+	};
+
+	/** The copied formats, in the order of the old if-chain. */
+	const FFormatCase CopiedFormats[] =
+	{
+		{ TEXT("MJPG"), &MEDIASUBTYPE_MJPG, 4 },
+		{ TEXT("NV12"), &MEDIASUBTYPE_NV12, 1 },
+		{ TEXT("RGB32"), &MEDIASUBTYPE_RGB32, 4 },
+		{ TEXT("ARGB32"), &MEDIASUBTYPE_ARGB32, 4 },
+		{ TEXT("UYVY"), &MEDIASUBTYPE_UYVY, 2 },
+		{ TEXT("H264"), &MEDIASUBTYPE_H264, 4 },
+		{ TEXT("YUY2"), &MEDIASUBTYPE_YUY2, 2 },
+	};
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDirectShowMediaVideoLayoutFormatsTest, "DirectShowMedia.VideoLayout.Formats", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FDirectShowMediaVideoLayoutFormatsTest::RunTest(const FString& Parameters)
+{
+	using namespace DirectShowMediaVideoLayoutTest;
+
+	const FIntPoint Resolution(1920, 1080);
+	const FDirectShowMediaColorConverter Converter;
+	FDirectShowMediaVideoLayout Layout;
+
+	// copied formats are laid out as the per-frame chain laid them out
+	TArray<FFormatCase> Cases(CopiedFormats, UE_ARRAY_COUNT(CopiedFormats));
+	Cases.Add({ TEXT("v210"), &DSMEDIASUBTYPE_v210, 0 });
+
+	for (const FFormatCase& Case : Cases)
+	{
+		const FFakeDevice Device(*Case.Subtype, Resolution, 60.0f);
+		FLegacyLayout Legacy;
+
+		if (!TestTrue(FString::Printf(TEXT("%s was copied"), Case.Name), ResolveLegacy(Device, false, Legacy)))
+		{
+			continue;
+		}
+
+		if (!TestTrue(FString::Printf(TEXT("%s is resolved"), Case.Name), Layout.Resolve(*Case.Subtype, Resolution, Resolution.X, 60.0f, Converter, false, false, false, false, 0)))
+		{
+			continue;
+		}
+
+		TestTrue(FString::Printf(TEXT("%s is copied"), Case.Name), Layout.IsCopied());
+		TestEqual(FString::Printf(TEXT("%s dimensions"), Case.Name), Layout.GetDim(), Legacy.Dim);
+		TestTrue(FString::Printf(TEXT("%s format"), Case.Name), Layout.GetFormat() == Legacy.Format);
+		TestEqual(FString::Printf(TEXT("%s frame size"), Case.Name), Layout.GetFrameSize(), (uint64)Legacy.Stride * Legacy.Dim.Y);
+		TestEqual(FString::Printf(TEXT("%s frame duration"), Case.Name), Layout.GetFrameDuration(), Legacy.Duration);
+	}
+
+	// the other formats pick their routine once as well
+	struct FOtherCase
+	{
+		const TCHAR* Name;
+		const GUID* Subtype;
+		bool bConvertTo8Bit;
+		EMediaTextureSampleFormat Format;
+	};
+
+	const FOtherCase OtherCases[] =
+	{
+		{ TEXT("I420"), &DSMEDIASUBTYPE_I420, false, EMediaTextureSampleFormat::CharNV12 },
+		{ TEXT("IYUV"), &MEDIASUBTYPE_IYUV, false, EMediaTextureSampleFormat::CharNV12 },
+		{ TEXT("YV12"), &MEDIASUBTYPE_YV12, false, EMediaTextureSampleFormat::CharNV12 },
+		{ TEXT("NV21"), &DSMEDIASUBTYPE_NV21, false, EMediaTextureSampleFormat::CharNV21 },
+		{ TEXT("P010"), &DSMEDIASUBTYPE_P010, false, FDirectShowMediaVideoUnpacker::GetOutputFormat(EDirectShowMediaHighBitDepthFormat::P010, false) },
+		{ TEXT("Y210"), &DSMEDIASUBTYPE_Y210, false, FDirectShowMediaVideoUnpacker::GetOutputFormat(EDirectShowMediaHighBitDepthFormat::Y210, false) },
+		{ TEXT("v210 to 8 bit"), &DSMEDIASUBTYPE_v210, true, FDirectShowMediaVideoUnpacker::GetOutputFormat(EDirectShowMediaHighBitDepthFormat::V210, true) },
+	};
+
+	for (const FOtherCase& Case : OtherCases)
+	{
+		const bool bResolved = Layout.Resolve(*Case.Subtype, Resolution, Resolution.X, 60.0f, Converter, false, Case.bConvertTo8Bit, false, false, 0);
+		TestTrue(FString::Printf(TEXT("%s is resolved"), Case.Name), bResolved && (Layout.GetFormat() == Case.Format));
+	}
+
+	// frame durations default to 30 fps, like the handler did when the device reported none
+	TestTrue(TEXT("A format without a frame rate is resolved"), Layout.Resolve(MEDIASUBTYPE_YUY2, Resolution, Resolution.X, 0.0f, Converter, false, false, false, false, 0));
+	TestEqual(TEXT("A format without a frame rate lasts a 30th of a second"), Layout.GetFrameDuration(), FTimespan(ETimespan::TicksPerSecond / 30));
+
+	TestFalse(TEXT("Unsupported formats aren't resolved"), Layout.Resolve(MEDIASUBTYPE_None, Resolution, Resolution.X, 60.0f, Converter, false, false, false, false, 0));
+	TestFalse(TEXT("An unsupported format leaves no layout"), Layout.IsValid());
+	TestFalse(TEXT("Formats aren't resolved before they're negotiated"), Layout.Resolve(MEDIASUBTYPE_YUY2, FIntPoint::ZeroValue, 0, 60.0f, Converter, false, false, false, false, 0));
+
+	return true;
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDirectShowMediaVideoLayoutOverheadTest, "DirectShowMedia.VideoLayout.Overhead", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FDirectShowMediaVideoLayoutOverheadTest::RunTest(const FString& Parameters)
+{
+	using namespace DirectShowMediaVideoLayoutTest;
+
+	// frames small enough that the per-frame work, not the copy, is measured
+	const FIntPoint Resolution(16, 4);
+	const int32 NumFrames = 200000;
+	const FDirectShowMediaColorConverter Converter;
+
+	double MaxResolvedCost = 0.0;
+	double MinResolvedCost = MAX_dbl;
+	double LastLegacyCost = 0.0;
+	double LastResolvedCost = 0.0;
+
+	for (const FFormatCase& Case : CopiedFormats)
+	{
+		const FFakeDevice Device(*Case.Subtype, Resolution, 60.0f);
+		const int32 FrameSize = Resolution.X * Case.BytesPerRow * ((Case.BytesPerRow == 1) ? Resolution.Y * 3 / 2 : Resolution.Y);
+
+		TArray<uint8> Frame;
+		Frame.SetNumZeroed(FrameSize);
+
+		FDirectShowMediaTextureSample Sample;
+		int32 NumFailed = 0;
+
+		// before: the device queried and the chain walked for every frame, then a generic copy
+		double StartTime = FPlatformTime::Seconds();
+
+		for (int32 FrameIndex = 0; FrameIndex < NumFrames; ++FrameIndex)
+		{
+			FLegacyLayout Legacy;
+
+			if (!ResolveLegacy(Device, false, Legacy) || !Sample.Initialize(Frame.GetData(), Frame.Num(), Legacy.Dim, Resolution, Legacy.Format, Legacy.Stride, FTimespan::Zero(), Legacy.Duration))
+			{
+				++NumFailed;
+			}
+		}
+
+		const double LegacyCost = (FPlatformTime::Seconds() - StartTime) * 1e9 / NumFrames;
+
+		// after: one call through the layout resolved for the format
+		FDirectShowMediaVideoLayout Layout;
+
+		if (!TestTrue(FString::Printf(TEXT("%s is resolved"), Case.Name), Layout.Resolve(Device.GetSampleSubtype(), Device.GetTextureSize(), Resolution.X, Device.GetFramerate(), Converter, false, false, false, false, 0)))
+		{
+			continue;
+		}
+
+		StartTime = FPlatformTime::Seconds();
+
+		for (int32 FrameIndex = 0; FrameIndex < NumFrames; ++FrameIndex)
+		{
+			if (!Layout.InitializeSample(Sample, nullptr, Frame.GetData(), Frame.Num(), FTimespan::Zero(), Layout.GetFrameDuration()))
+			{
+				++NumFailed;
+			}
+		}
+
+		const double ResolvedCost = (FPlatformTime::Seconds() - StartTime) * 1e9 / NumFrames;
+
+		AddInfo(FString::Printf(TEXT("%s: %.1f ns per frame resolved per frame, %.1f ns resolved once"), Case.Name, LegacyCost, ResolvedCost));
+		TestEqual(FString::Printf(TEXT("%s frames are initialized"), Case.Name), NumFailed, 0);
+
+		MaxResolvedCost = FMath::Max(MaxResolvedCost, ResolvedCost);
+		MinResolvedCost = FMath::Min(MinResolvedCost, ResolvedCost);
+		LastLegacyCost = LegacyCost;
+		LastResolvedCost = ResolvedCost;
+	}
+
+	// generous bounds, so debug builds and loaded machines pass while a per-frame chain that grows with the format's position doesn't
+	TestTrue(TEXT("The last format of the chain is cheaper resolved once"), LastResolvedCost < LastLegacyCost);
+	TestTrue(TEXT("The per-frame cost doesn't depend on the format"), MaxResolvedCost < 3.0 * MinResolvedCost);
+
+	return true;
+}
+
+
+#endif //WITH_DEV_AUTOMATION_TESTS
@@ -0,0 +1,402 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "CoreTypes.h"
+#include "Misc/AutomationTest.h"
+
+#include "Player/DirectShowMediaVideoUnpacker.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+
+namespace DirectShowMediaVideoUnpackerTest
+{
+	/** Value of source padding words, which must never reach a sample. */
+	const uint16 Padding = 0xfffe;
+
+	/** Value of output guard bytes, which must never be written. */
+	const uint8 Guard = 0xee;
+
+	/** The unpacker's 4x4 ordered dither thresholds. */
+	const uint16 DitherPattern[4][4] =
+	{
+		{   8, 136,  40, 168 },
+		{ 200,  72, 232, 104 },
+		{  56, 184,  24, 152 },
+		{ 248, 120, 216,  88 }
+	};
+
+	/** Value of a 10 bit component (0 = Y, 1 = U, 2 = V), including both ends of the range. */
+	uint16 GetComponent(int32 Component, int32 X, int32 Y)
+	{
+		if ((Component == 0) && (X == Y))
+		{
+			return 1023;
+		}
+
+		return (uint16)((X * 37 + Y * 101 + Component * 211) % 1023);
+	}
+
+	/** The 8 bit value a 16 bit component is reduced to at a row and byte index. */
+	uint8 Dither(uint16 Value, int32 Row, int32 Index)
+	{
+		return (uint8)FMath::Min<uint32>(((uint32)Value + DitherPattern[Row & 3][Index & 3]) >> 8, 255);
+	}
+
+	/**
+	 * Get the components of a row of a 4:2:2 frame in YUY2 order (Y0 U Y1 V), as 16 bit values.
+	 *
+	 * @param Width The frame width (in pixels).
+	 * @param Y The row.
+	 * @return The components.
+	 */
+	TArray<uint16> GetYUY2Row(int32 Width, int32 Y)
+	{
+		TArray<uint16> Row;
+
+		for (int32 X = 0; X < Width; X += 2)
+		{
+			Row.Add(GetComponent(0, X, Y) << 6);
+			Row.Add(GetComponent(1, X / 2, Y) << 6);
+			Row.Add(GetComponent(0, X + 1, Y) << 6);
+			Row.Add(GetComponent(2, X / 2, Y) << 6);
+		}
+
+		return Row;
+	}
+
+	/** Allocate an output buffer followed by guard bytes. */
+	TArray<uint8> MakeOutput(uint32 Size)
+	{
+		TArray<uint8> Output;
+		Output.Init(Guard, Size + 64);
+
+		return Output;
+	}
+
+	/** Check that the guard bytes after an output buffer are untouched. */
+	bool IsGuardIntact(const TArray<uint8>& Output, uint32 Size)
+	{
+		for (int32 Index = Size; Index < Output.Num(); ++Index)
+		{
+			if (Output[Index] != Guard)
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	/** Count the bytes of an 8 bit row that differ from the dithered 16 bit components. */
+	int32 CountDitherMismatches(const uint8* OutRow, const TArray<uint16>& Expected, int32 Row)
+	{
+		int32 NumMismatches = 0;
+
+		for (int32 Index = 0; Index < Expected.Num(); ++Index)
+		{
+			NumMismatches += (OutRow[Index] != Dither(Expected[Index], Row, Index)) ? 1 : 0;
+		}
+
+		return NumMismatches;
+	}
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDirectShowMediaVideoUnpackerP010Test, "DirectShowMedia.VideoUnpacker.P010", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FDirectShowMediaVideoUnpackerP010Test::RunTest(const FString& Parameters)
+{
+	using namespace DirectShowMediaVideoUnpackerTest;
+
+	const FIntPoint Dim(8, 4);
+	const uint32 Pitch = 24; // 8 padding bytes per row
+	const int32 PitchWords = Pitch / 2;
+
+	// luma plane, then interleaved UV plane of half the rows
+	TArray<uint16> Source;
+	Source.Init(Padding, PitchWords * (Dim.Y + Dim.Y / 2));
+
+	for (int32 Y = 0; Y < Dim.Y; ++Y)
+	{
+		for (int32 X = 0; X < Dim.X; ++X)
+		{
+			Source[Y * PitchWords + X] = GetComponent(0, X, Y) << 6;
+		}
+	}
+
+	for (int32 Y = 0; Y < Dim.Y / 2; ++Y)
+	{
+		for (int32 X = 0; X < Dim.X / 2; ++X)
+		{
+			Source[(Dim.Y + Y) * PitchWords + X * 2 + 0] = GetComponent(1, X, Y) << 6;
+			Source[(Dim.Y + Y) * PitchWords + X * 2 + 1] = GetComponent(2, X, Y) << 6;
+		}
+	}
+
+	const uint8* SourceBytes = (const uint8*)Source.GetData();
+	const uint32 SourceSize = Source.Num() * sizeof(uint16);
+
+	// 16 bit
+	{
+		FIntPoint OutDim;
+		uint32 OutStride = 0;
+		const uint32 OutSize = FDirectShowMediaVideoUnpacker::GetOutputLayout(EMediaTextureSampleFormat::Y416, Dim, OutDim, OutStride);
+		TArray<uint8> Output = MakeOutput(OutSize);
+
+		TestEqual(TEXT("P010 unpacks to Y416"), FDirectShowMediaVideoUnpacker::GetOutputFormat(EDirectShowMediaHighBitDepthFormat::P010, false), EMediaTextureSampleFormat::Y416);
+
+		if (TestTrue(TEXT("P010 is unpacked to 16 bit"), FDirectShowMediaVideoUnpacker::Unpack(EDirectShowMediaHighBitDepthFormat::P010, false, SourceBytes, SourceSize, Pitch, Dim, Output.GetData())))
+		{
+			int32 NumMismatches = 0;
+
+			for (int32 Y = 0; Y < Dim.Y; ++Y)
+			{
+				const uint16* OutRow = (const uint16*)(Output.GetData() + Y * OutStride);
+
+				for (int32 X = 0; X < Dim.X; ++X)
+				{
+					// chroma is shared by pixel pairs and row pairs
+					NumMismatches += (OutRow[X * 4 + 0] != (GetComponent(1, X / 2, Y / 2) << 6)) ? 1 : 0;
+					NumMismatches += (OutRow[X * 4 + 1] != (GetComponent(0, X, Y) << 6)) ? 1 : 0;
+					NumMismatches += (OutRow[X * 4 + 2] != (GetComponent(2, X / 2, Y / 2) << 6)) ? 1 : 0;
+					NumMismatches += (OutRow[X * 4 + 3] != 0xffff) ? 1 : 0;
+				}
+			}
+
+			TestEqual(TEXT("Every Y416 word has its source value"), NumMismatches, 0);
+			TestTrue(TEXT("Nothing is written past the Y416 frame"), IsGuardIntact(Output, OutSize));
+		}
+	}
+
+	// 8 bit
+	{
+		FIntPoint OutDim;
+		uint32 OutStride = 0;
+		const uint32 OutSize = FDirectShowMediaVideoUnpacker::GetOutputLayout(EMediaTextureSampleFormat::CharNV12, Dim, OutDim, OutStride);
+		TArray<uint8> Output = MakeOutput(OutSize);
+
+		TestEqual(TEXT("P010 unpacks to NV12 at 8 bit"), FDirectShowMediaVideoUnpacker::GetOutputFormat(EDirectShowMediaHighBitDepthFormat::P010, true), EMediaTextureSampleFormat::CharNV12);
+
+		if (TestTrue(TEXT("P010 is unpacked to 8 bit"), FDirectShowMediaVideoUnpacker::Unpack(EDirectShowMediaHighBitDepthFormat::P010, true, SourceBytes, SourceSize, Pitch, Dim, Output.GetData())))
+		{
+			int32 NumMismatches = 0;
+
+			// the NV12 rows continue the dither phase of the luma rows
+			for (int32 Row = 0; Row < Dim.Y + Dim.Y / 2; ++Row)
+			{
+				const TArray<uint16> Expected(Source.GetData() + Row * PitchWords, Dim.X);
+				NumMismatches += CountDitherMismatches(Output.GetData() + Row * OutStride, Expected, Row);
+			}
+
+			TestEqual(TEXT("Every NV12 byte is its dithered source value"), NumMismatches, 0);
+			TestTrue(TEXT("Nothing is written past the NV12 frame"), IsGuardIntact(Output, OutSize));
+		}
+	}
+
+	TArray<uint8> Output = MakeOutput(Dim.X * Dim.Y * 8);
+	TestFalse(TEXT("Truncated P010 frames are refused"), FDirectShowMediaVideoUnpacker::Unpack(EDirectShowMediaHighBitDepthFormat::P010, false, SourceBytes, SourceSize - 1, Pitch, Dim, Output.GetData()));
+	TestFalse(TEXT("Odd widths are refused"), FDirectShowMediaVideoUnpacker::Unpack(EDirectShowMediaHighBitDepthFormat::P010, false, SourceBytes, SourceSize, Pitch, FIntPoint(7, 4), Output.GetData()));
+
+	return true;
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDirectShowMediaVideoUnpackerY210Test, "DirectShowMedia.VideoUnpacker.Y210", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FDirectShowMediaVideoUnpackerY210Test::RunTest(const FString& Parameters)
+{
+	using namespace DirectShowMediaVideoUnpackerTest;
+
+	const FIntPoint Dim(8, 4);
+	const uint32 Pitch = 40; // 8 padding bytes per row
+	const int32 PitchWords = Pitch / 2;
+
+	TArray<uint16> Source;
+	Source.Init(Padding, PitchWords * Dim.Y);
+
+	for (int32 Y = 0; Y < Dim.Y; ++Y)
+	{
+		const TArray<uint16> Row = GetYUY2Row(Dim.X, Y);
+		FMemory::Memcpy(Source.GetData() + Y * PitchWords, Row.GetData(), Row.Num() * sizeof(uint16));
+	}
+
+	const uint8* SourceBytes = (const uint8*)Source.GetData();
+	const uint32 SourceSize = Source.Num() * sizeof(uint16);
+
+	// 16 bit
+	{
+		FIntPoint OutDim;
+		uint32 OutStride = 0;
+		const uint32 OutSize = FDirectShowMediaVideoUnpacker::GetOutputLayout(EMediaTextureSampleFormat::Y416, Dim, OutDim, OutStride);
+		TArray<uint8> Output = MakeOutput(OutSize);
+
+		if (TestTrue(TEXT("Y210 is unpacked to 16 bit"), FDirectShowMediaVideoUnpacker::Unpack(EDirectShowMediaHighBitDepthFormat::Y210, false, SourceBytes, SourceSize, Pitch, Dim, Output.GetData())))
+		{
+			int32 NumMismatches = 0;
+
+			for (int32 Y = 0; Y < Dim.Y; ++Y)
+			{
+				const uint16* OutRow = (const uint16*)(Output.GetData() + Y * OutStride);
+
+				for (int32 X = 0; X < Dim.X; ++X)
+				{
+					NumMismatches += (OutRow[X * 4 + 0] != (GetComponent(1, X / 2, Y) << 6)) ? 1 : 0;
+					NumMismatches += (OutRow[X * 4 + 1] != (GetComponent(0, X, Y) << 6)) ? 1 : 0;
+					NumMismatches += (OutRow[X * 4 + 2] != (GetComponent(2, X / 2, Y) << 6)) ? 1 : 0;
+					NumMismatches += (OutRow[X * 4 + 3] != 0xffff) ? 1 : 0;
+				}
+			}
+
+			TestEqual(TEXT("Every Y416 word has its source value"), NumMismatches, 0);
+			TestTrue(TEXT("Nothing is written past the Y416 frame"), IsGuardIntact(Output, OutSize));
+		}
+	}
+
+	// 8 bit
+	{
+		FIntPoint OutDim;
+		uint32 OutStride = 0;
+		const uint32 OutSize = FDirectShowMediaVideoUnpacker::GetOutputLayout(EMediaTextureSampleFormat::CharYUY2, Dim, OutDim, OutStride);
+		TArray<uint8> Output = MakeOutput(OutSize);
+
+		if (TestTrue(TEXT("Y210 is unpacked to 8 bit"), FDirectShowMediaVideoUnpacker::Unpack(EDirectShowMediaHighBitDepthFormat::Y210, true, SourceBytes, SourceSize, Pitch, Dim, Output.GetData())))
+		{
+			int32 NumMismatches = 0;
+
+			for (int32 Y = 0; Y < Dim.Y; ++Y)
+			{
+				NumMismatches += CountDitherMismatches(Output.GetData() + Y * OutStride, GetYUY2Row(Dim.X, Y), Y);
+			}
+
+			TestEqual(TEXT("Every YUY2 byte is its dithered source value"), NumMismatches, 0);
+			TestTrue(TEXT("Nothing is written past the YUY2 frame"), IsGuardIntact(Output, OutSize));
+		}
+	}
+
+	return true;
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDirectShowMediaVideoUnpackerV210Test, "DirectShowMedia.VideoUnpacker.V210", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FDirectShowMediaVideoUnpackerV210Test::RunTest(const FString& Parameters)
+{
+	using namespace DirectShowMediaVideoUnpackerTest;
+
+	TestEqual(TEXT("v210 rows are 128 byte blocks of 48 pixels"), FDirectShowMediaVideoUnpacker::GetSourceStride(EDirectShowMediaHighBitDepthFormat::V210, 50), (uint32)256);
+	TestEqual(TEXT("v210 is handed to the engine at 16 bit"), FDirectShowMediaVideoUnpacker::GetOutputFormat(EDirectShowMediaHighBitDepthFormat::V210, false), EMediaTextureSampleFormat::YUVv210);
+
+	// widths that end in the middle of a group and of a block
+	const int32 Widths[] = { 6, 8, 10, 48, 50 };
+
+	for (int32 Width : Widths)
+	{
+		const FIntPoint Dim(Width, 4);
+		const uint32 Pitch = FDirectShowMediaVideoUnpacker::GetSourceStride(EDirectShowMediaHighBitDepthFormat::V210, Width);
+		const int32 PitchWords = Pitch / 4;
+
+		// groups of six pixels in four words of three components, the remainder of a group is zero
+		TArray<uint32> Source;
+		Source.Init(0, PitchWords * Dim.Y);
+
+		for (int32 Y = 0; Y < Dim.Y; ++Y)
+		{
+			for (int32 X = 0; X < Width; X += 6)
+			{
+				auto Get = [&](int32 Component, int32 PixelX) -> uint32
+				{
+					const int32 ComponentX = (Component == 0) ? PixelX : PixelX / 2;
+					return (PixelX < Width) ? GetComponent(Component, ComponentX, Y) : 0;
+				};
+
+				uint32* Group = Source.GetData() + Y * PitchWords + (X / 6) * 4;
+
+				Group[0] = Get(1, X + 0) | (Get(0, X + 0) << 10) | (Get(2, X + 0) << 20);
+				Group[1] = Get(0, X + 1) | (Get(1, X + 2) << 10) | (Get(0, X + 2) << 20);
+				Group[2] = Get(2, X + 2) | (Get(0, X + 3) << 10) | (Get(1, X + 4) << 20);
+				Group[3] = Get(0, X + 4) | (Get(2, X + 4) << 10) | (Get(0, X + 5) << 20);
+			}
+		}
+
+		FIntPoint OutDim;
+		uint32 OutStride = 0;
+		const uint32 OutSize = FDirectShowMediaVideoUnpacker::GetOutputLayout(EMediaTextureSampleFormat::CharYUY2, Dim, OutDim, OutStride);
+		TArray<uint8> Output = MakeOutput(OutSize);
+
+		TestFalse(FString::Printf(TEXT("v210 at %d pixels isn't unpacked to 16 bit"), Width), FDirectShowMediaVideoUnpacker::Unpack(EDirectShowMediaHighBitDepthFormat::V210, false, (const uint8*)Source.GetData(), Source.Num() * sizeof(uint32), Pitch, Dim, Output.GetData()));
+
+		if (!TestTrue(FString::Printf(TEXT("v210 at %d pixels is unpacked to 8 bit"), Width), FDirectShowMediaVideoUnpacker::Unpack(EDirectShowMediaHighBitDepthFormat::V210, true, (const uint8*)Source.GetData(), Source.Num() * sizeof(uint32), Pitch, Dim, Output.GetData())))
+		{
+			continue;
+		}
+
+		int32 NumMismatches = 0;
+
+		for (int32 Y = 0; Y < Dim.Y; ++Y)
+		{
+			NumMismatches += CountDitherMismatches(Output.GetData() + Y * OutStride, GetYUY2Row(Width, Y), Y);
+		}
+
+		TestEqual(FString::Printf(TEXT("Every YUY2 byte at %d pixels is its dithered source value"), Width), NumMismatches, 0);
+		TestTrue(FString::Printf(TEXT("Nothing is written past the YUY2 frame at %d pixels"), Width), IsGuardIntact(Output, OutSize));
+	}
+
+	return true;
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDirectShowMediaVideoUnpackerDitherTest, "DirectShowMedia.VideoUnpacker.Dither", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FDirectShowMediaVideoUnpackerDitherTest::RunTest(const FString& Parameters)
+{
+	const FIntPoint Dim(4, 4);
+
+	TArray<uint16> Source;
+	Source.SetNum(Dim.X * 2 * Dim.Y);
+
+	TArray<uint8> Output;
+	Output.SetNum(Dim.X * 2 * Dim.Y);
+
+	int32 NumBiased = 0;
+
+	// every 10 bit level of a flat Y210 frame averages to its exact value over a 4x4 tile
+	for (uint32 Level = 0; Level < 1024; ++Level)
+	{
+		for (uint16& Component : Source)
+		{
+			Component = (uint16)(Level << 6);
+		}
+
+		FDirectShowMediaVideoUnpacker::Unpack(EDirectShowMediaHighBitDepthFormat::Y210, true, (const uint8*)Source.GetData(), Source.Num() * sizeof(uint16), 0, Dim, Output.GetData());
+
+		for (int32 Lane = 0; Lane < 2; ++Lane)
+		{
+			double Sum = 0.0;
+
+			for (int32 Y = 0; Y < Dim.Y; ++Y)
+			{
+				for (int32 X = 0; X < 4; ++X)
+				{
+					Sum += Output[Y * Dim.X * 2 + Lane * 4 + X];
+				}
+			}
+
+			// the top levels saturate
+			const double Expected = FMath::Min((Level << 6) / 256.0, 255.0);
+			const double Error = FMath::Abs(Sum / 16.0 - Expected);
+
+			if (Error > 1.0 / 16.0)
+			{
+				++NumBiased;
+				AddError(FString::Printf(TEXT("Level %u averages to %f instead of %f"), Level, Sum / 16.0, Expected));
+			}
+		}
+	}
+
+	TestEqual(TEXT("No level is biased"), NumBiased, 0);
+
+	return true;
+}
+
+
+#endif //WITH_DEV_AUTOMATION_TESTS
@@ -41,6 +41,15 @@ static const CLSID CLSID_VideoEffects2Category = { 0xcc7bfb43, 0xf175, 0x11d1,{
 static const CLSID CLSID_AudioEffects1Category = { 0xcc7bfb44, 0xf175, 0x11d1,{ 0xa3, 0x92, 0x0, 0xe0, 0x29, 0x1f, 0x39, 0x59 } };
 static const CLSID CLSID_AudioEffects2Category = { 0xcc7bfb45, 0xf175, 0x11d1,{ 0xa3, 0x92, 0x0, 0xe0, 0x29, 0x1f, 0x39, 0x59 } };
 
+// high bit depth FOURCC subtypes, not declared by older SDK versions of uuids.h
+static const GUID DSMEDIASUBTYPE_P010 = { 0x30313050, 0x0000, 0x0010,{ 0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71 } };
+static const GUID DSMEDIASUBTYPE_Y210 = { 0x30313259, 0x0000, 0x0010,{ 0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71 } };
+static const GUID DSMEDIASUBTYPE_v210 = { 0x30313276, 0x0000, 0x0010,{ 0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71 } };
+
+// planar FOURCC subtypes without a uuids.h declaration (I420 is the same layout as MEDIASUBTYPE_IYUV)
+static const GUID DSMEDIASUBTYPE_I420 = { 0x30323449, 0x0000, 0x0010,{ 0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71 } };
+static const GUID DSMEDIASUBTYPE_NV21 = { 0x3132564E, 0x0000, 0x0010,{ 0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71 } };
+
 FString GUIDToUEString(const GUID& guid);
 FString CompressionToUEString(DWORD compression);
 void LogAudioMediaType(const AM_MEDIA_TYPE& mt);
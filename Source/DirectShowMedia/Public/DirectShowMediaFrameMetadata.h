@@ -0,0 +1,91 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreTypes.h"
+#include "Misc/EnumClassFlags.h"
+
+
+/** Fields of FDirectShowMediaFrameMetadata that hold values. */
+enum class EDirectShowMediaFrameMetadataFlags : uint32
+{
+	None = 0,
+
+	/** DeviceStartTime and DeviceStopTime were set by the capture filter. */
+	DeviceTime = 1 << 0,
+
+	/** MediaStartTime and MediaStopTime were set by the capture filter. */
+	MediaTime = 1 << 1,
+
+	/** Exposure holds the camera's exposure setting. */
+	Exposure = 1 << 2,
+
+	/** Gain holds the camera's gain setting. */
+	Gain = 1 << 3,
+
+	/** The Timecode fields hold the timecode read from the device. */
+	Timecode = 1 << 4,
+
+	/** Frames were lost between this frame and the previous one. */
+	Discontinuity = 1 << 5
+};
+
+ENUM_CLASS_FLAGS(EDirectShowMediaFrameMetadataFlags);
+
+
+/**
+ * Side data of a captured video frame.
+ *
+ * Video samples of a DirectShow media player carry the side data of their frame (see IDirectShowMediaPlanarSample).
+ * When the player's metadata track is selected, every frame also produces a metadata sample whose data is one of
+ * these. Fields are only valid if their flag is set. Fields added later go at the end and bump the version.
+ */
+struct FDirectShowMediaFrameMetadata
+{
+	/** Version of the layout. */
+	static constexpr uint32 CurrentVersion = 1;
+
+	/** Version of the layout (CurrentVersion when written). */
+	uint32 Version = CurrentVersion;
+
+	/** The fields that hold values. */
+	EDirectShowMediaFrameMetadataFlags Flags = EDirectShowMediaFrameMetadataFlags::None;
+
+	/** Number of frames the device delivered before this one, including frames that were decimated. */
+	uint64 FrameNumber = 0;
+
+	/** Stream time the frame was captured at (in 100 ns units, IMediaSample::GetTime). */
+	int64 DeviceStartTime = 0;
+
+	/** Stream time the frame ends at (in 100 ns units). */
+	int64 DeviceStopTime = 0;
+
+	/** Media time of the frame, which capture filters set to the frame count of the driver (IMediaSample::GetMediaTime). */
+	int64 MediaStartTime = 0;
+
+	/** Media time the frame ends at. */
+	int64 MediaStopTime = 0;
+
+	/** Exposure, as log base 2 of the exposure time in seconds (CameraControl_Exposure). */
+	int32 Exposure = 0;
+
+	/** Gain, in device specific units (VideoProcAmp_Gain). */
+	int32 Gain = 0;
+
+	/** Timecode as binary coded decimal 0xhhmmssff (TIMECODE::dwFrames). */
+	uint32 TimecodeFrames = 0;
+
+	/** Timecode format (TIMECODE::wFrameRate, i.e. ED_FORMAT_SMPTE_30DROP). */
+	uint16 TimecodeFormat = 0;
+
+	/** Timecode frame fraction (TIMECODE::wFrameFraction). */
+	uint16 TimecodeFrameFraction = 0;
+
+	/** Timecode user bits (TIMECODE_SAMPLE::dwUser). */
+	uint32 TimecodeUserBits = 0;
+
+	/** Unused, keeps the size a multiple of 8 bytes. */
+	uint32 Reserved = 0;
+};
+
+static_assert(sizeof(FDirectShowMediaFrameMetadata) == 72, "FDirectShowMediaFrameMetadata is read by consumers, its layout must not change.");
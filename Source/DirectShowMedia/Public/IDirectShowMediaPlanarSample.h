@@ -0,0 +1,102 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "DirectShowMediaFrameMetadata.h"
+#include "IMediaTextureSample.h"
+
+
+/** Planar YUV layouts a video sample can be viewed as. */
+enum class EDirectShowMediaPlanarFormat : uint8
+{
+	/** The sample has no plane views. */
+	None,
+
+	/** 4:2:0, Y plane, U plane, V plane. */
+	I420,
+
+	/** 4:2:0, Y plane, V plane, U plane. */
+	YV12,
+
+	/** 4:2:0, Y plane, interleaved UV plane. */
+	NV12,
+
+	/** 4:2:0, Y plane, interleaved VU plane. */
+	NV21
+};
+
+
+/** One plane of a planar video sample. */
+struct FDirectShowMediaPlane
+{
+	/** The first byte of the plane. */
+	const uint8* Data = nullptr;
+
+	/** Number of bytes per row. */
+	uint32 Pitch = 0;
+
+	/** Offset of the plane from the start of the frame (in bytes). */
+	uint32 Offset = 0;
+
+	/** Width and height of the plane (in samples, an interleaved chroma sample counts once). */
+	FIntPoint Dim = FIntPoint::ZeroValue;
+};
+
+
+/**
+ * Interface for video samples that can be read plane by plane, and that carry the side data of their frame.
+ *
+ * Every video sample delivered by a DirectShow media player implements this interface, so consumers can use
+ * StaticCastSharedRef on the samples they fetch from it. When the player is opened with the VideoAcceptPlanar
+ * media option, I420, YV12 and NV21 frames are delivered as plane views into the capture buffer without being
+ * copied. Such samples report EMediaTextureSampleFormat::Undefined unless the engine can display them as is,
+ * and hold on to the capture buffer until they are released, so they shouldn't be kept for long.
+ * Without the option, these formats are converted to a format the engine can display.
+ */
+class IDirectShowMediaPlanarSample
+	: public IMediaTextureSample
+{
+public:
+
+	/** The maximum number of planes of a sample. */
+	static constexpr int32 MaxPlanes = 3;
+
+	/**
+	 * Get the planar layout of the sample.
+	 *
+	 * @return The layout, or None if the sample has no plane views.
+	 */
+	virtual EDirectShowMediaPlanarFormat GetPlanarFormat() const = 0;
+
+	/**
+	 * Get the number of planes.
+	 *
+	 * @return Number of planes (zero if the sample has no plane views).
+	 */
+	virtual int32 GetNumPlanes() const = 0;
+
+	/**
+	 * Get a plane.
+	 *
+	 * Planes are ordered by component: luma first, then U and V (or the interleaved chroma plane),
+	 * regardless of their order in memory.
+	 *
+	 * @param PlaneIndex Index of the plane.
+	 * @return The plane.
+	 * @see GetNumPlanes
+	 */
+	virtual const FDirectShowMediaPlane& GetPlane(int32 PlaneIndex) const = 0;
+
+	/**
+	 * Get the side data of the sample's frame.
+	 *
+	 * @return The side data (device times, exposure, gain and timecode, where the device reports them).
+	 */
+	virtual const FDirectShowMediaFrameMetadata& GetFrameMetadata() const = 0;
+
+public:
+
+	/** Virtual destructor. */
+	virtual ~IDirectShowMediaPlanarSample() { }
+};